@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aes_cipher.h"
+
+#include "system_error.h"
+
+#include <cstring>
+
+#if AES_CIPHER_AESNI
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if AES_CIPHER_ARMV8_CE
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace particle {
+
+namespace protocol {
+
+namespace {
+
+void secureZero(void* data, size_t size) {
+    volatile uint8_t* p = (volatile uint8_t*)data;
+    while (size-- > 0) {
+        *p++ = 0;
+    }
+}
+
+#if AES_CIPHER_AESNI
+
+#define AESNI_FUNCTION __attribute__((target("aes,sse2")))
+
+AESNI_FUNCTION inline __m128i aesniExpandKey(__m128i key, __m128i gen) {
+    gen = _mm_shuffle_epi32(gen, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, gen);
+}
+
+AESNI_FUNCTION void aesniSetKey(const uint8_t* key, uint8_t (*encKeys)[16], uint8_t (*decKeys)[16]) {
+    __m128i* ek = (__m128i*)encKeys;
+    __m128i* dk = (__m128i*)decKeys;
+    ek[0] = _mm_loadu_si128((const __m128i*)key);
+    // The round constant needs to be an immediate value
+    ek[1] = aesniExpandKey(ek[0], _mm_aeskeygenassist_si128(ek[0], 0x01));
+    ek[2] = aesniExpandKey(ek[1], _mm_aeskeygenassist_si128(ek[1], 0x02));
+    ek[3] = aesniExpandKey(ek[2], _mm_aeskeygenassist_si128(ek[2], 0x04));
+    ek[4] = aesniExpandKey(ek[3], _mm_aeskeygenassist_si128(ek[3], 0x08));
+    ek[5] = aesniExpandKey(ek[4], _mm_aeskeygenassist_si128(ek[4], 0x10));
+    ek[6] = aesniExpandKey(ek[5], _mm_aeskeygenassist_si128(ek[5], 0x20));
+    ek[7] = aesniExpandKey(ek[6], _mm_aeskeygenassist_si128(ek[6], 0x40));
+    ek[8] = aesniExpandKey(ek[7], _mm_aeskeygenassist_si128(ek[7], 0x80));
+    ek[9] = aesniExpandKey(ek[8], _mm_aeskeygenassist_si128(ek[8], 0x1b));
+    ek[10] = aesniExpandKey(ek[9], _mm_aeskeygenassist_si128(ek[9], 0x36));
+    dk[0] = ek[10];
+    for (int i = 1; i < 10; ++i) {
+        dk[i] = _mm_aesimc_si128(ek[10 - i]);
+    }
+    dk[10] = ek[0];
+}
+
+AESNI_FUNCTION void aesniEncryptCbc(const uint8_t (*encKeys)[16], uint8_t* iv, const uint8_t* in, uint8_t* out,
+        size_t size) {
+    const __m128i* k = (const __m128i*)encKeys;
+    __m128i b = _mm_loadu_si128((const __m128i*)iv);
+    for (size_t i = 0; i < size; i += 16) {
+        b = _mm_xor_si128(b, _mm_loadu_si128((const __m128i*)(in + i)));
+        b = _mm_xor_si128(b, k[0]);
+        for (int r = 1; r < 10; ++r) {
+            b = _mm_aesenc_si128(b, k[r]);
+        }
+        b = _mm_aesenclast_si128(b, k[10]);
+        _mm_storeu_si128((__m128i*)(out + i), b);
+    }
+    _mm_storeu_si128((__m128i*)iv, b);
+}
+
+AESNI_FUNCTION void aesniDecryptCbc(const uint8_t (*decKeys)[16], uint8_t* iv, const uint8_t* in, uint8_t* out,
+        size_t size) {
+    const __m128i* k = (const __m128i*)decKeys;
+    __m128i prev = _mm_loadu_si128((const __m128i*)iv);
+    size_t i = 0;
+    // CBC decryption is parallelizable, so interleave 4 blocks to hide the latency of the instructions
+    for (; i + 64 <= size; i += 64) {
+        const __m128i c0 = _mm_loadu_si128((const __m128i*)(in + i));
+        const __m128i c1 = _mm_loadu_si128((const __m128i*)(in + i + 16));
+        const __m128i c2 = _mm_loadu_si128((const __m128i*)(in + i + 32));
+        const __m128i c3 = _mm_loadu_si128((const __m128i*)(in + i + 48));
+        __m128i b0 = _mm_xor_si128(c0, k[0]);
+        __m128i b1 = _mm_xor_si128(c1, k[0]);
+        __m128i b2 = _mm_xor_si128(c2, k[0]);
+        __m128i b3 = _mm_xor_si128(c3, k[0]);
+        for (int r = 1; r < 10; ++r) {
+            b0 = _mm_aesdec_si128(b0, k[r]);
+            b1 = _mm_aesdec_si128(b1, k[r]);
+            b2 = _mm_aesdec_si128(b2, k[r]);
+            b3 = _mm_aesdec_si128(b3, k[r]);
+        }
+        b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, k[10]), prev);
+        b1 = _mm_xor_si128(_mm_aesdeclast_si128(b1, k[10]), c0);
+        b2 = _mm_xor_si128(_mm_aesdeclast_si128(b2, k[10]), c1);
+        b3 = _mm_xor_si128(_mm_aesdeclast_si128(b3, k[10]), c2);
+        _mm_storeu_si128((__m128i*)(out + i), b0);
+        _mm_storeu_si128((__m128i*)(out + i + 16), b1);
+        _mm_storeu_si128((__m128i*)(out + i + 32), b2);
+        _mm_storeu_si128((__m128i*)(out + i + 48), b3);
+        prev = c3;
+    }
+    for (; i < size; i += 16) {
+        const __m128i c = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i b = _mm_xor_si128(c, k[0]);
+        for (int r = 1; r < 10; ++r) {
+            b = _mm_aesdec_si128(b, k[r]);
+        }
+        b = _mm_xor_si128(_mm_aesdeclast_si128(b, k[10]), prev);
+        _mm_storeu_si128((__m128i*)(out + i), b);
+        prev = c;
+    }
+    _mm_storeu_si128((__m128i*)iv, prev);
+}
+
+bool aesniSupported() {
+    return __builtin_cpu_supports("aes");
+}
+
+#endif // AES_CIPHER_AESNI
+
+#if AES_CIPHER_ARMV8_CE
+
+#define ARMV8_CE_FUNCTION __attribute__((target("+crypto")))
+
+// Applies the S-box to each byte of a word. ShiftRows has no effect, since all columns are the same
+ARMV8_CE_FUNCTION inline uint32_t armv8SubWord(uint32_t w) {
+    const uint8x16_t b = vaeseq_u8(vreinterpretq_u8_u32(vdupq_n_u32(w)), vdupq_n_u8(0));
+    return vgetq_lane_u32(vreinterpretq_u32_u8(b), 0);
+}
+
+ARMV8_CE_FUNCTION void armv8SetKey(const uint8_t* key, uint8_t (*encKeys)[16], uint8_t (*decKeys)[16]) {
+    static const uint8_t rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+    uint32_t w[44];
+    memcpy(w, key, 16);
+    for (int i = 4; i < 44; ++i) {
+        uint32_t t = w[i - 1];
+        if (i % 4 == 0) {
+            // Words are little endian, so RotWord is a rotation to the right
+            t = armv8SubWord((t >> 8) | (t << 24)) ^ rcon[i / 4 - 1];
+        }
+        w[i] = w[i - 4] ^ t;
+    }
+    memcpy(encKeys, w, sizeof(w));
+    secureZero(w, sizeof(w));
+    vst1q_u8(decKeys[0], vld1q_u8(encKeys[10]));
+    for (int i = 1; i < 10; ++i) {
+        vst1q_u8(decKeys[i], vaesimcq_u8(vld1q_u8(encKeys[10 - i])));
+    }
+    vst1q_u8(decKeys[10], vld1q_u8(encKeys[0]));
+}
+
+ARMV8_CE_FUNCTION inline uint8x16_t armv8DecryptBlock(const uint8x16_t* k, uint8x16_t b) {
+    for (int r = 0; r < 9; ++r) {
+        b = vaesimcq_u8(vaesdq_u8(b, k[r]));
+    }
+    return veorq_u8(vaesdq_u8(b, k[9]), k[10]);
+}
+
+ARMV8_CE_FUNCTION void armv8EncryptCbc(const uint8_t (*encKeys)[16], uint8_t* iv, const uint8_t* in, uint8_t* out,
+        size_t size) {
+    uint8x16_t k[11];
+    for (int r = 0; r < 11; ++r) {
+        k[r] = vld1q_u8(encKeys[r]);
+    }
+    uint8x16_t b = vld1q_u8(iv);
+    for (size_t i = 0; i < size; i += 16) {
+        b = veorq_u8(b, vld1q_u8(in + i));
+        for (int r = 0; r < 9; ++r) {
+            b = vaesmcq_u8(vaeseq_u8(b, k[r]));
+        }
+        b = veorq_u8(vaeseq_u8(b, k[9]), k[10]);
+        vst1q_u8(out + i, b);
+    }
+    vst1q_u8(iv, b);
+}
+
+ARMV8_CE_FUNCTION void armv8DecryptCbc(const uint8_t (*decKeys)[16], uint8_t* iv, const uint8_t* in, uint8_t* out,
+        size_t size) {
+    uint8x16_t k[11];
+    for (int r = 0; r < 11; ++r) {
+        k[r] = vld1q_u8(decKeys[r]);
+    }
+    uint8x16_t prev = vld1q_u8(iv);
+    size_t i = 0;
+    // Interleave independent blocks to keep the crypto pipeline busy
+    for (; i + 64 <= size; i += 64) {
+        const uint8x16_t c0 = vld1q_u8(in + i);
+        const uint8x16_t c1 = vld1q_u8(in + i + 16);
+        const uint8x16_t c2 = vld1q_u8(in + i + 32);
+        const uint8x16_t c3 = vld1q_u8(in + i + 48);
+        uint8x16_t b0 = c0, b1 = c1, b2 = c2, b3 = c3;
+        for (int r = 0; r < 9; ++r) {
+            b0 = vaesimcq_u8(vaesdq_u8(b0, k[r]));
+            b1 = vaesimcq_u8(vaesdq_u8(b1, k[r]));
+            b2 = vaesimcq_u8(vaesdq_u8(b2, k[r]));
+            b3 = vaesimcq_u8(vaesdq_u8(b3, k[r]));
+        }
+        vst1q_u8(out + i, veorq_u8(veorq_u8(vaesdq_u8(b0, k[9]), k[10]), prev));
+        vst1q_u8(out + i + 16, veorq_u8(veorq_u8(vaesdq_u8(b1, k[9]), k[10]), c0));
+        vst1q_u8(out + i + 32, veorq_u8(veorq_u8(vaesdq_u8(b2, k[9]), k[10]), c1));
+        vst1q_u8(out + i + 48, veorq_u8(veorq_u8(vaesdq_u8(b3, k[9]), k[10]), c2));
+        prev = c3;
+    }
+    for (; i < size; i += 16) {
+        const uint8x16_t c = vld1q_u8(in + i);
+        vst1q_u8(out + i, veorq_u8(armv8DecryptBlock(k, c), prev));
+        prev = c;
+    }
+    vst1q_u8(iv, prev);
+}
+
+bool armv8Supported() {
+    return getauxval(AT_HWCAP) & HWCAP_AES;
+}
+
+#endif // AES_CIPHER_ARMV8_CE
+
+} // namespace
+
+AesCipher::AesCipher() :
+        backend_(DEFAULT) {
+    mbedtls_aes_init(&enc_);
+    mbedtls_aes_init(&dec_);
+}
+
+AesCipher::~AesCipher() {
+    clear();
+    mbedtls_aes_free(&enc_);
+    mbedtls_aes_free(&dec_);
+}
+
+int AesCipher::setKey(const uint8_t* key, Backend backend) {
+    clear();
+    if (backend == DEFAULT) {
+        backend = defaultBackend();
+    }
+    switch (backend) {
+    case TABLE: {
+        if (mbedtls_aes_setkey_enc(&enc_, key, KEY_SIZE * 8) != 0 ||
+                mbedtls_aes_setkey_dec(&dec_, key, KEY_SIZE * 8) != 0) {
+            return SYSTEM_ERROR_UNKNOWN;
+        }
+        break;
+    }
+#if AES_CIPHER_AESNI
+    case AESNI: {
+        if (!aesniSupported()) {
+            return SYSTEM_ERROR_NOT_SUPPORTED;
+        }
+        aesniSetKey(key, encKeys_, decKeys_);
+        break;
+    }
+#endif
+#if AES_CIPHER_ARMV8_CE
+    case ARMV8_CE: {
+        if (!armv8Supported()) {
+            return SYSTEM_ERROR_NOT_SUPPORTED;
+        }
+        armv8SetKey(key, encKeys_, decKeys_);
+        break;
+    }
+#endif
+    default:
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+    backend_ = backend;
+    return 0;
+}
+
+void AesCipher::clear() {
+    switch (backend_) {
+    case TABLE:
+        mbedtls_aes_free(&enc_);
+        mbedtls_aes_free(&dec_);
+        mbedtls_aes_init(&enc_);
+        mbedtls_aes_init(&dec_);
+        break;
+#if AES_CIPHER_AESNI || AES_CIPHER_ARMV8_CE
+    case AESNI:
+    case ARMV8_CE:
+        secureZero(encKeys_, sizeof(encKeys_));
+        secureZero(decKeys_, sizeof(decKeys_));
+        break;
+#endif
+    default:
+        break;
+    }
+    backend_ = DEFAULT;
+}
+
+int AesCipher::encryptCbc(uint8_t* iv, const uint8_t* in, uint8_t* out, size_t size) {
+    if (size % BLOCK_SIZE != 0) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    switch (backend_) {
+    case TABLE:
+        if (mbedtls_aes_crypt_cbc(&enc_, MBEDTLS_AES_ENCRYPT, size, iv, in, out) != 0) {
+            return SYSTEM_ERROR_UNKNOWN;
+        }
+        break;
+#if AES_CIPHER_AESNI
+    case AESNI:
+        aesniEncryptCbc(encKeys_, iv, in, out, size);
+        break;
+#endif
+#if AES_CIPHER_ARMV8_CE
+    case ARMV8_CE:
+        armv8EncryptCbc(encKeys_, iv, in, out, size);
+        break;
+#endif
+    default:
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    return 0;
+}
+
+int AesCipher::decryptCbc(uint8_t* iv, const uint8_t* in, uint8_t* out, size_t size) {
+    if (size % BLOCK_SIZE != 0) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    switch (backend_) {
+    case TABLE:
+        if (mbedtls_aes_crypt_cbc(&dec_, MBEDTLS_AES_DECRYPT, size, iv, in, out) != 0) {
+            return SYSTEM_ERROR_UNKNOWN;
+        }
+        break;
+#if AES_CIPHER_AESNI
+    case AESNI:
+        aesniDecryptCbc(decKeys_, iv, in, out, size);
+        break;
+#endif
+#if AES_CIPHER_ARMV8_CE
+    case ARMV8_CE:
+        armv8DecryptCbc(decKeys_, iv, in, out, size);
+        break;
+#endif
+    default:
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    return 0;
+}
+
+bool AesCipher::isSupported(Backend backend) {
+    switch (backend) {
+    case DEFAULT:
+    case TABLE:
+        return true;
+#if AES_CIPHER_AESNI
+    case AESNI:
+        return aesniSupported();
+#endif
+#if AES_CIPHER_ARMV8_CE
+    case ARMV8_CE:
+        return armv8Supported();
+#endif
+    default:
+        return false;
+    }
+}
+
+AesCipher::Backend AesCipher::defaultBackend() {
+    static const Backend backend = isSupported(AESNI) ? AESNI : (isSupported(ARMV8_CE) ? ARMV8_CE : TABLE);
+    return backend;
+}
+
+const char* AesCipher::backendName(Backend backend) {
+    switch (backend) {
+    case DEFAULT:
+        return "default";
+    case TABLE:
+        return "table";
+    case AESNI:
+        return "aes-ni";
+    case ARMV8_CE:
+        return "armv8-ce";
+    default:
+        return "unknown";
+    }
+}
+
+} // namespace protocol
+
+} // namespace particle
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mbedtls/aes.h"
+
+#include <cstdint>
+#include <cstddef>
+
+#if PLATFORM_ID == 3 && (defined(__x86_64__) || defined(__i386__))
+#define AES_CIPHER_AESNI 1
+#endif
+
+#if PLATFORM_ID == 3 && defined(__aarch64__) && defined(__linux__)
+#define AES_CIPHER_ARMV8_CE 1
+#endif
+
+namespace particle {
+
+namespace protocol {
+
+/**
+ * AES-128 cipher with precomputed encryption and decryption key schedules.
+ *
+ * The key schedules are computed once per key, so that encrypting or decrypting a message only
+ * involves the block cipher itself. The implementation is chosen at runtime: hardware AES
+ * instructions are used when the virtual device runs on a CPU that supports them, otherwise
+ * the cipher falls back to the table-based implementation provided by mbedTLS.
+ */
+class AesCipher {
+public:
+    enum Backend {
+        DEFAULT = 0, // Fastest backend supported by the CPU
+        TABLE = 1, // mbedTLS
+        AESNI = 2, // x86 AES-NI
+        ARMV8_CE = 3 // ARMv8 cryptography extension
+    };
+
+    static const size_t BLOCK_SIZE = 16;
+    static const size_t KEY_SIZE = 16;
+
+    AesCipher();
+    ~AesCipher();
+
+    /**
+     * Sets the key and precomputes the key schedules.
+     *
+     * @param key 128-bit key.
+     * @param backend Backend to use.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int setKey(const uint8_t* key, Backend backend = DEFAULT);
+    /**
+     * Clears the key schedules.
+     */
+    void clear();
+
+    /**
+     * Encrypts data in CBC mode. The input and output buffers may be the same.
+     *
+     * @param iv Initialization vector. On return, contains the last ciphertext block.
+     * @param in Input data.
+     * @param out Output buffer.
+     * @param size Data size. Must be a multiple of the block size.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int encryptCbc(uint8_t* iv, const uint8_t* in, uint8_t* out, size_t size);
+    /**
+     * Decrypts data in CBC mode. The input and output buffers may be the same.
+     *
+     * @param iv Initialization vector. On return, contains the last ciphertext block.
+     * @param in Input data.
+     * @param out Output buffer.
+     * @param size Data size. Must be a multiple of the block size.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int decryptCbc(uint8_t* iv, const uint8_t* in, uint8_t* out, size_t size);
+
+    Backend backend() const;
+
+    static bool isSupported(Backend backend);
+    static Backend defaultBackend();
+    static const char* backendName(Backend backend);
+
+    // This class is non-copyable
+    AesCipher(const AesCipher&) = delete;
+    AesCipher& operator=(const AesCipher&) = delete;
+
+private:
+    mbedtls_aes_context enc_;
+    mbedtls_aes_context dec_;
+#if AES_CIPHER_AESNI || AES_CIPHER_ARMV8_CE
+    // Round keys for the hardware backends. The decryption keys are in the order expected by the
+    // equivalent inverse cipher
+    alignas(16) uint8_t encKeys_[11][BLOCK_SIZE];
+    alignas(16) uint8_t decKeys_[11][BLOCK_SIZE];
+#endif
+    Backend backend_;
+};
+
+inline AesCipher::Backend AesCipher::backend() const {
+    return backend_;
+}
+
+} // namespace protocol
+
+} // namespace particle
@@ -20,6 +20,7 @@ CPPSRC += $(TARGET_SRC_PATH)/communication_dynalib.cpp
 CPPSRC += $(TARGET_SRC_PATH)/dsakeygen.cpp
 CPPSRC += $(TARGET_SRC_PATH)/eckeygen.cpp
 CPPSRC += $(TARGET_SRC_PATH)/lightssl_message_channel.cpp
+CPPSRC += $(TARGET_SRC_PATH)/aes_cipher.cpp
 CPPSRC += $(TARGET_SRC_PATH)/dtls_message_channel.cpp
 CPPSRC += $(TARGET_SRC_PATH)/dtls_protocol.cpp
 CPPSRC += $(TARGET_SRC_PATH)/lightssl_protocol.cpp
@@ -44,6 +44,14 @@ ProtocolError ChunkedTransfer::handle_update_begin(
             DEBUG("Fast OTA: %s", fast_ota_value?"enabled":"disabled");
         }
 
+        // bit 1: the file is compressed, bit 2: the file is a delta against the installed module
+        file.encoding = (flags >> 1) & (FileTransfer::Encoding::COMPRESSED | FileTransfer::Encoding::DELTA);
+        if (file.encoding != FileTransfer::Encoding::NONE && (flags & 1)) {
+            // encoded files are decoded as a stream, so the chunks need to arrive in order
+            flags &= ~(1<<0);
+            DEBUG("Fast OTA: disabled for encoded file");
+        }
+
         file.chunk_size = decode_uint16(queue + 9);
         file.file_length = decode_uint32(queue + 11);
         file.store = FileTransfer::Store::Enum(decode_uint8(queue + 15));
@@ -55,6 +63,7 @@ ProtocolError ChunkedTransfer::handle_update_begin(
         file.chunk_size = 0;
         file.file_length = 0;
         file.store = FileTransfer::Store::FIRMWARE;
+        file.encoding = FileTransfer::Encoding::NONE;
         file.file_address = 0;
         file.chunk_address = 0;
     }
@@ -180,9 +189,9 @@ ProtocolError ChunkedTransfer::handle_chunk(token_t token, Message& message,
         bool crc_valid = (crc == given_crc);
         DEBUG("chunk idx=%d crc=%d fast=%d updating=%d", chunk_index,
                 crc_valid, fast_ota, updating);
-        if (crc_valid)
+        int result = -1;
+        if (crc_valid && (result = callbacks->save_firmware_chunk(file, chunk, NULL)) == 0)
         {
-            callbacks->save_firmware_chunk(file, chunk, NULL);
             if (!fast_ota)
             {
                 // message is confirmable for regular OTA or when
@@ -191,6 +200,13 @@ ProtocolError ChunkedTransfer::handle_chunk(token_t token, Message& message,
             flag_chunk_received(chunk_index);
             chunk_index++;
         }
+        else if (crc_valid)
+        {
+            // a resent chunk can't fix a failed flash write, and the decoder of an encoded
+            // transfer can't be restarted at this chunk, so the whole transfer is aborted
+            ERROR("chunk save failed %d: %d - aborting transfer", chunk_index, result);
+            return INVALID_STATE;
+        }
         else
         {
             WARN("chunk crc bad %d: wanted %x got %x", chunk_index, given_crc, crc);
@@ -88,5 +88,59 @@ size_t CoAP::option_decode(unsigned char **option) {
     return option_length;
 }
 
+namespace {
+
+// Decodes the extended value of an option delta or length
+bool decode_option_value(const uint8_t* message, size_t length, size_t* offset, size_t* value) {
+    if (*value == 13) {
+        if (*offset + 1 > length) {
+            return false;
+        }
+        *value = message[*offset] + 13;
+        *offset += 1;
+    } else if (*value == 14) {
+        if (*offset + 2 > length) {
+            return false;
+        }
+        *value = ((message[*offset] << 8) | message[*offset + 1]) + 269;
+        *offset += 2;
+    } else if (*value == 15) {
+        return false; // Reserved
+    }
+    return true;
+}
+
+} // namespace
+
+bool CoAP::find_option(const uint8_t* message, size_t length, CoAPOption::Enum option,
+        const uint8_t** value, size_t* value_length) {
+    if (length < 4) {
+        return false;
+    }
+    size_t offset = 4 + (message[0] & 0x0f); // Skip header and token
+    size_t number = 0;
+    while (offset < length && message[offset] != 0xff) {
+        size_t delta = message[offset] >> 4;
+        size_t option_length = message[offset] & 0x0f;
+        ++offset;
+        if (!decode_option_value(message, length, &offset, &delta) ||
+                !decode_option_value(message, length, &offset, &option_length) ||
+                option_length > length - offset) {
+            return false;
+        }
+        number += delta;
+        if (number == (size_t)option) {
+            *value = message + offset;
+            *value_length = option_length;
+            return true;
+        }
+        if (number > (size_t)option) {
+            break; // Options are sorted by number
+        }
+        offset += option_length;
+    }
+    return false;
+}
+
 }
 }
@@ -110,10 +110,25 @@ namespace CoAPOption {
 		NONE = 0,
 		LOCATION_PATH = 8,
 		URI_PATH = 11,
-		URI_QUERY = 15
+		URI_QUERY = 15,
+		BLOCK2 = 23,
+		SIZE2 = 28
 	};
 }
 
+/**
+ * Value of a Block2 option (RFC 7959).
+ */
+struct CoAPBlock {
+	unsigned num; // Block number
+	bool more; // Set if there are more blocks
+	unsigned szx; // Block size exponent: block size is 2^(szx + 4)
+
+	size_t size() const {
+		return (size_t)16 << szx;
+	}
+};
+
 namespace CoAPType {
   enum Enum {
     CON,
@@ -188,6 +203,57 @@ public:
     static CoAPType::Enum type(const unsigned char *message);
     static size_t option_decode(unsigned char **option);
 
+    /**
+     * Finds an option in a CoAP message. Returns false if the option is not present or the
+     * message is malformed.
+     */
+    static bool find_option(const uint8_t* message, size_t length, CoAPOption::Enum option,
+            const uint8_t** value, size_t* value_length);
+
+    /**
+     * Adds an option with an unsigned integer value, using the shortest encoding.
+     */
+    static size_t uint_option(uint8_t* buf, CoAPOption::Enum previous, CoAPOption::Enum current, uint32_t value)
+    {
+		uint8_t data[4];
+		size_t length = 0;
+		for (int shift = 24; shift >= 0; shift -= 8)
+		{
+			const uint8_t b = value >> shift;
+			if (b || length)
+			{
+				data[length++] = b;
+			}
+		}
+		return add_option(buf, previous, current, data, length);
+    }
+
+    static size_t block_option(uint8_t* buf, CoAPOption::Enum previous, const CoAPBlock& block)
+    {
+		const uint32_t value = (block.num << 4) | (block.more ? 0x08 : 0x00) | (block.szx & 0x07);
+		return uint_option(buf, previous, CoAPOption::BLOCK2, value);
+    }
+
+    static uint32_t decode_uint(const uint8_t* value, size_t length)
+    {
+		uint32_t v = 0;
+		for (size_t i = 0; i < length && i < 4; ++i)
+		{
+			v = (v << 8) | value[i];
+		}
+		return v;
+    }
+
+    static CoAPBlock decode_block(const uint8_t* value, size_t length)
+    {
+		const uint32_t v = decode_uint(value, length);
+		CoAPBlock block;
+		block.num = v >> 4;
+		block.more = v & 0x08;
+		block.szx = v & 0x07;
+		return block;
+    }
+
     /**
      * Computes the length indicator for a value encoded in CoAP.
      * Values less than 13 are encoded directly. Values between 13 and 268 (inclusive) are encoded as 13 (and later as a single byte extended option)
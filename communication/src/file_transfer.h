@@ -32,6 +32,19 @@ namespace FileTransfer {
         };
     };
 
+    /**
+     * Encoding of the transferred file data. The values can be combined: a compressed delta
+     * is decompressed first and then applied to the currently installed module. The device
+     * advertises support for encoded updates with bit 2 of the hello flags.
+     */
+    namespace Encoding {
+        enum __attribute__ ((__packed__)) Enum {
+            NONE = 0x00,        // raw image
+            COMPRESSED = 0x01,  // raw deflate stream
+            DELTA = 0x02,       // binary delta against the installed module (see delta_patch.h)
+        };
+    };
+
     struct __attribute__((packed)) Chunk
     {
         uint16_t size;
@@ -54,14 +67,18 @@ namespace FileTransfer {
          * 2 means application-provided storage
          */
         Store::Enum store;
-        uint8_t reserved;       // padding
+
+        /**
+         * A combination of `Encoding::Enum` flags.
+         */
+        uint8_t encoding;
     };
 
     PARTICLE_STATIC_ASSERT(Chunk_size, sizeof(Chunk)==12);
 
     struct Descriptor : public Chunk
     {
-        Descriptor() { size = sizeof(*this); }
+        Descriptor() { size = sizeof(*this); encoding = Encoding::NONE; }
 
         /**
          * The length of the file data.
@@ -71,8 +71,7 @@ namespace protocol
 				{
 					unsigned char next_iv[16];
 					memcpy(next_iv, buf, 16);
-					mbedtls_aes_setkey_dec(&aes, key, 128);
-					mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_DECRYPT, packet_size, iv_receive, buf, buf);
+					aes.decryptCbc(iv_receive, buf, buf, packet_size);
 					memcpy(iv_receive, next_iv, 16);
 					message.set_length(packet_size-buf[packet_size-1]);
 				}
@@ -115,7 +114,17 @@ namespace protocol
 			return AUTHENTICATION_ERROR;
 		}
 
-		memcpy(key, credentials, 16);
+		return init_session(credentials);
+	}
+
+	ProtocolError LightSSLMessageChannel::init_session(const unsigned char *credentials, AesCipher::Backend backend)
+	{
+		if (aes.setKey(credentials, backend) != 0)
+		{
+			LOG(ERROR,"Unable to set session key");
+			return DECRYPTION_ERROR;
+		}
+		LOG(TRACE,"AES backend: %s", AesCipher::backendName(aes.backend()));
 		memcpy(iv_send, credentials + 16, 16);
 		memcpy(iv_receive, credentials + 16, 16);
 		memcpy(salt, credentials + 32, 8);
@@ -143,8 +152,7 @@ namespace protocol
 
 	void LightSSLMessageChannel::encrypt(unsigned char *buf, int length)
 	{
-		mbedtls_aes_setkey_enc(&aes, key, 128);
-		mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_ENCRYPT, length, iv_send, buf, buf);
+		aes.encryptCbc(iv_send, buf, buf, length);
 		memcpy(iv_send, buf, 16);
 	}
 
@@ -27,7 +27,7 @@
 #include "device_keys.h"
 #include "message_channel.h"
 #include "buffer_message_channel.h"
-#include "mbedtls/aes.h"
+#include "aes_cipher.h"
 
 namespace particle
 {
@@ -58,11 +58,11 @@ private:
 	unsigned char core_private_key[MAX_DEVICE_PRIVATE_KEY_LENGTH];
 	uint8_t device_id[12];
 
-	unsigned char key[16];
 	unsigned char iv_send[16];
 	unsigned char iv_receive[16];
 	unsigned char salt[8];
-	mbedtls_aes_context aes;
+	// Holds the precomputed encryption and decryption key schedules for the session
+	AesCipher aes;
 
 	Callbacks callbacks;
 	message_id_t* counter;
@@ -71,12 +71,6 @@ public:
 
 	LightSSLMessageChannel()
 	{
-		mbedtls_aes_init(&aes);
-	}
-
-	~LightSSLMessageChannel()
-	{
-		mbedtls_aes_free(&aes);
 	}
 
 	virtual bool is_unreliable() override;
@@ -113,6 +107,11 @@ protected:
 
 	ProtocolError set_key(const unsigned char *signed_encrypted_credentials);
 
+	/**
+	 * Initializes the session key, IVs and salt from the decrypted credentials.
+	 */
+	ProtocolError init_session(const unsigned char *credentials, AesCipher::Backend backend=AesCipher::DEFAULT);
+
 	size_t wrap(unsigned char *buf, size_t msglen);
 	void encrypt(unsigned char *buf, int length);
 
@@ -25,6 +25,8 @@ LOG_SOURCE_CATEGORY("comm.protocol")
 #include "subscriptions.h"
 #include "functions.h"
 
+#include <algorithm>
+
 namespace particle { namespace protocol {
 
 /**
@@ -73,13 +75,23 @@ ProtocolError Protocol::handle_received_message(Message& message,
 	{
 		// 4 bytes header, 1 byte token, 2 bytes location path
 		// 2 bytes optional single character location path for describe flags
+		// the request may also contain a Block2 option if the cloud requests the description
+		// in blocks
+		const uint8_t* block_opt = nullptr;
+		size_t block_opt_len = 0;
+		CoAPBlock block = {};
+		const bool has_block = CoAP::find_option(queue, message.length(), CoAPOption::BLOCK2, &block_opt, &block_opt_len);
+		if (has_block) {
+			block = CoAP::decode_block(block_opt, block_opt_len);
+		}
+		const bool has_flags = message.length() > 8 && (!has_block || queue[7] == 0x01);
 		int descriptor_type = DESCRIBE_DEFAULT;
-		if (message.length()>8 && queue[8] <= DESCRIBE_MAX) {
+		if (has_flags && queue[8] <= DESCRIBE_MAX) {
 			descriptor_type = queue[8];
-		} else if (message.length() > 8) {
+		} else if (has_flags) {
 			LOG(WARN, "Invalid DESCRIBE flags %02x", queue[8]);
 		}
-		error = send_description(token, msg_id, descriptor_type);
+		error = send_description(token, msg_id, descriptor_type, has_block ? &block : nullptr);
 		break;
 	}
 
@@ -291,6 +303,8 @@ int Protocol::begin()
 	// FIXME: Pending completion handlers should be cancelled at the end of a previous session
 	ack_handlers.clear();
 	last_ack_handlers_update = callbacks.millis();
+	// The last batch of diagnostics samples is sent again if its delivery hasn't been confirmed
+	history_pending = false;
 
 	uint32_t channel_flags = 0;
 	ProtocolError error = channel.establish(channel_flags, application_state_checksum());
@@ -349,6 +363,7 @@ ProtocolError Protocol::hello(bool was_ota_upgrade_successful)
 
 	uint8_t flags = was_ota_upgrade_successful ? 1 : 0;
 	flags |= 2;		// diagnostics support
+	flags |= 4;		// compressed and delta firmware updates support (see FileTransfer::Encoding)
 	size_t len = build_hello(message, flags);
 	message.set_length(len);
 	message.set_confirm_received(true);
@@ -433,6 +448,43 @@ ProtocolError Protocol::event_loop(CoAPMessageType::Enum& message_type)
 	return error;
 }
 
+void Protocol::append_function_entry(Appender& appender, int index)
+{
+	if (index)
+	{
+		appender.append(',');
+	}
+	appender.append('"');
+
+	const char* key = descriptor.get_function_key(index);
+	size_t function_name_length = strlen(key);
+	if (MAX_FUNCTION_KEY_LENGTH < function_name_length)
+	{
+		function_name_length = MAX_FUNCTION_KEY_LENGTH;
+	}
+	appender.append((const uint8_t*) key, function_name_length);
+	appender.append('"');
+}
+
+void Protocol::append_variable_entry(Appender& appender, int index)
+{
+	if (index)
+	{
+		appender.append(',');
+	}
+	appender.append('"');
+	const char* key = descriptor.get_variable_key(index);
+	size_t variable_name_length = strlen(key);
+	SparkReturnType::Enum t = descriptor.variable_type(key);
+	if (MAX_VARIABLE_KEY_LENGTH < variable_name_length)
+	{
+		variable_name_length = MAX_VARIABLE_KEY_LENGTH;
+	}
+	appender.append((const uint8_t*) key, variable_name_length);
+	appender.append("\":");
+	appender.append('0' + (char) t);
+}
+
 void Protocol::build_describe_message(Appender& appender, int desc_flags)
 {
 	// diagnostics must be requested in isolation to be a binary packet
@@ -445,6 +497,15 @@ void Protocol::build_describe_message(Appender& appender, int desc_flags)
 		const int page = 0;
 		descriptor.append_metrics(append_instance, &appender, flags, page, nullptr);
 	}
+	else if (descriptor.append_metrics && (desc_flags == DESCRIBE_METRICS_HISTORY))
+	{
+		appender.append(char(0));	// null byte means binary data
+		appender.append(char(DESCRIBE_METRICS_HISTORY));							// uint16 describes the type of binary packet
+		appender.append(char(0));	//
+		const int flags = 1;		// binary
+		const int page = 1;			// batch of recorded samples
+		descriptor.append_metrics(append_instance, &appender, flags, page, nullptr);
+	}
 	else {
 		appender.append("{");
 		bool has_content = false;
@@ -458,20 +519,7 @@ void Protocol::build_describe_message(Appender& appender, int desc_flags)
 			int i;
 			for (i = 0; i < num_keys; ++i)
 			{
-				if (i)
-				{
-					appender.append(',');
-				}
-				appender.append('"');
-
-				const char* key = descriptor.get_function_key(i);
-				size_t function_name_length = strlen(key);
-				if (MAX_FUNCTION_KEY_LENGTH < function_name_length)
-				{
-					function_name_length = MAX_FUNCTION_KEY_LENGTH;
-				}
-				appender.append((const uint8_t*) key, function_name_length);
-				appender.append('"');
+				append_function_entry(appender, i);
 			}
 
 			appender.append("],\"v\":{");
@@ -479,21 +527,7 @@ void Protocol::build_describe_message(Appender& appender, int desc_flags)
 			num_keys = descriptor.num_variables();
 			for (i = 0; i < num_keys; ++i)
 			{
-				if (i)
-				{
-					appender.append(',');
-				}
-				appender.append('"');
-				const char* key = descriptor.get_variable_key(i);
-				size_t variable_name_length = strlen(key);
-				SparkReturnType::Enum t = descriptor.variable_type(key);
-				if (MAX_VARIABLE_KEY_LENGTH < variable_name_length)
-				{
-					variable_name_length = MAX_VARIABLE_KEY_LENGTH;
-				}
-				appender.append((const uint8_t*) key, variable_name_length);
-				appender.append("\":");
-				appender.append('0' + (char) t);
+				append_variable_entry(appender, i);
 			}
 			appender.append('}');
 		}
@@ -512,36 +546,90 @@ void Protocol::build_describe_message(Appender& appender, int desc_flags)
 /**
  * Produces and transmits a describe message.
  * @param desc_flags Flags describing the information to provide. A combination of {@code DESCRIBE_APPLICATION) and {@code DESCRIBE_SYSTEM) flags.
+ * @param block The requested block, or {@code nullptr} if the request didn't contain a Block2 option.
  */
-ProtocolError Protocol::send_description(token_t token, message_id_t msg_id, int desc_flags)
+ProtocolError Protocol::send_description(token_t token, message_id_t msg_id, int desc_flags, const CoAPBlock* block)
 {
+	if (descriptor.append_metrics && desc_flags == DESCRIBE_METRICS_HISTORY && (!block || block->num == 0))
+	{
+		// The cloud only requests the next batch of recorded samples once it has received the previous
+		// one. A retransmitted request has the same message ID and gets the same batch again
+		if (history_pending && msg_id != last_history_msg_id)
+		{
+			const int page = 2;		// the last batch has been received
+			descriptor.append_metrics(nullptr, nullptr, 0, page, nullptr);
+		}
+		last_history_msg_id = msg_id;
+		history_pending = true;
+	}
+
 	Message message;
 	channel.create(message);
 	uint8_t* buf = message.buf();
 	message.set_id(msg_id);
-	size_t desc = Messages::description(buf, msg_id, token);
 
-	BufferAppender appender(buf + desc, message.capacity());
+	bool more = false;
+	CoAPBlock first_block;
+	if (!block)
+	{
+		size_t desc = Messages::description(buf, msg_id, token);
+
+		BufferAppender appender(buf + desc, message.capacity() - desc);
 
-	build_describe_message(appender, desc_flags);
+		build_describe_message(appender, desc_flags);
 
-	int msglen = appender.next() - (uint8_t*) buf;
-	message.set_length(msglen);
-	if (appender.overflowed()) {
-		LOG(ERROR, "Describe message overflowed by %d bytes", appender.overflowed());
-		// There is no point in continuing to run, the device will be constantly reconnecting
-		// to the cloud. It's better to clearly indicate that the describe message is never going
-		// to go through to the cloud by going into a panic state, otherwise one would have to
-		// sift through logs to find 'Describe message overflowed by %d bytes' message to understand
-		// what's going on.
-		SPARK_ASSERT(!appender.overflowed());
+		int msglen = appender.next() - (uint8_t*) buf;
+		message.set_length(msglen);
+		if (appender.overflowed()) {
+			// The description doesn't fit into a single message, send it in blocks. The cloud
+			// requests the remaining blocks with the Block2 option
+			LOG(WARN, "Describe message overflowed by %d bytes, sending first block", appender.overflowed());
+			first_block = { 0, false, DESCRIBE_BLOCK_SZX };
+			block = &first_block;
+		}
+	}
+	if (block)
+	{
+		// Use the largest block size that fits into the message and doesn't exceed the requested size
+		const size_t header_size = 4 /* header */ + 1 /* token */ + 4 /* Block2 */ + 3 /* Size2 */ + 1 /* payload marker */;
+		unsigned szx = std::min(block->szx, (unsigned)DESCRIBE_BLOCK_SZX);
+		while (szx > 0 && ((size_t)16 << szx) > message.capacity() - header_size)
+		{
+			--szx;
+		}
+		// The block number needs to be adjusted if the block size has been reduced
+		const unsigned num = block->num << (block->szx - szx);
+		const size_t block_size = (size_t)16 << szx;
+		BufferAppender2 counter(nullptr, 0);
+		build_describe_message(counter, desc_flags);
+		const size_t total_size = counter.dataSize();
+		const size_t offset = (size_t)num * block_size;
+		if (offset >= total_size && total_size > 0)
+		{
+			LOG(WARN, "Invalid describe block requested: %u", num);
+			message.set_length(Messages::coded_ack(buf, token, CoAPCode::BAD_OPTION, msg_id >> 8, msg_id & 0xff));
+			return channel.send(message);
+		}
+		more = (offset + block_size < total_size);
+		const CoAPBlock b = { num, more, szx };
+		uint8_t* p = buf;
+		p += CoAP::header(p, CoAPType::ACK, CoAPCode::CONTENT, sizeof(token), &token, msg_id);
+		p += CoAP::block_option(p, CoAPOption::NONE, b);
+		p += CoAP::uint_option(p, CoAPOption::BLOCK2, CoAPOption::SIZE2, total_size);
+		*p++ = 0xff;
+		WindowAppender appender((char*)p, block_size, offset);
+		build_describe_message(appender, desc_flags);
+		message.set_length(p - buf + appender.windowSize());
+		LOG(TRACE, "Sending describe block %u (%u of %u bytes)", num, (unsigned)appender.windowSize(), (unsigned)total_size);
 	}
 
-	LOG(INFO,"Sending '%s%s%s' describe message", desc_flags & DESCRIBE_SYSTEM ? "S" : "",
+	LOG(INFO,"Sending '%s%s%s%s' describe message", desc_flags & DESCRIBE_SYSTEM ? "S" : "",
 											  desc_flags & DESCRIBE_APPLICATION ? "A" : "",
-											  desc_flags & DESCRIBE_METRICS ? "M" : "");
+											  desc_flags & DESCRIBE_METRICS ? "M" : "",
+											  desc_flags & DESCRIBE_METRICS_HISTORY ? "H" : "");
 	ProtocolError error = channel.send(message);
-	if (error==NO_ERROR && descriptor.app_state_selector_info &&
+	// The checksums are only updated once the last block has been sent
+	if (error==NO_ERROR && !more && descriptor.app_state_selector_info &&
             (desc_flags & DESCRIBE_APPLICATION || desc_flags & DESCRIBE_SYSTEM))
 	{
         this->channel.command(Channel::SAVE_SESSION);
@@ -589,12 +677,49 @@ system_tick_t Protocol::ChunkedTransferCallbacks::millis()
 int Protocol::get_describe_data(spark_protocol_describe_data* data, void* reserved)
 {
 	data->maximum_size = 768;  // a conservative guess based on dtls and lightssl encryption overhead and the CoAP data
+	if (data->flags == DESCRIBE_APPLICATION)
+	{
+		data->current_size = describe_app_size();
+		return 0;
+	}
 	BufferAppender2 appender(nullptr,  0);	// don't need to store the data, just count the size
 	build_describe_message(appender, data->flags);
 	data->current_size = appender.dataSize();
 	return 0;
 }
 
+/**
+ * Returns the size of the application description. Functions and variables are only ever
+ * appended to the registry, so only the entries added since the last call are measured.
+ */
+size_t Protocol::describe_app_size()
+{
+	const int num_functions = descriptor.num_functions();
+	const int num_variables = descriptor.num_variables();
+	BufferAppender2 appender(nullptr, 0);	// don't need to store the data, just count the size
+	if (describe_app_cache.functions < 0 || num_functions < describe_app_cache.functions ||
+			num_variables < describe_app_cache.variables)
+	{
+		build_describe_message(appender, DESCRIBE_APPLICATION);
+		describe_app_cache.size = appender.dataSize();
+	}
+	else
+	{
+		for (int i = describe_app_cache.functions; i < num_functions; ++i)
+		{
+			append_function_entry(appender, i);
+		}
+		for (int i = describe_app_cache.variables; i < num_variables; ++i)
+		{
+			append_variable_entry(appender, i);
+		}
+		describe_app_cache.size += appender.dataSize();
+	}
+	describe_app_cache.functions = num_functions;
+	describe_app_cache.variables = num_variables;
+	return describe_app_cache.size;
+}
+
 #if HAL_PLATFORM_MESH
 int completion_result(int result, completion_handler_data* completion) {
 	if (completion) {
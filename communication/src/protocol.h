@@ -164,6 +164,12 @@ protected:
 	 */
 	CompletionHandlerMap<message_id_t> ack_handlers;
 
+	/**
+	 * Message ID of the last request for a batch of recorded diagnostics samples.
+	 */
+	message_id_t last_history_msg_id;
+	bool history_pending;
+
 
 	void set_protocol_flags(int flags)
 	{
@@ -241,7 +247,27 @@ protected:
 	 * Produces and transmits a describe message.
 	 * @param desc_flags Flags describing the information to provide. A combination of {@code DESCRIBE_APPLICATION) and {@code DESCRIBE_SYSTEM) flags.
 	 */
-	ProtocolError send_description(token_t token, message_id_t msg_id, int desc_flags);
+	ProtocolError send_description(token_t token, message_id_t msg_id, int desc_flags, const CoAPBlock* block = nullptr);
+
+	/**
+	 * Block size exponent used for describe messages that don't fit into a single message (512 bytes).
+	 */
+	static const unsigned DESCRIBE_BLOCK_SZX = 5;
+
+	/**
+	 * Size of the application description, updated incrementally as functions and variables
+	 * are registered.
+	 */
+	struct DescribeAppCache
+	{
+		int functions = -1;
+		int variables = -1;
+		size_t size = 0;
+	} describe_app_cache;
+
+	size_t describe_app_size();
+	void append_function_entry(Appender& appender, int index);
+	void append_variable_entry(Appender& appender, int index);
 
 	/**
 	 * Decodes and dispatches a received message to its handler.
@@ -285,7 +311,9 @@ public:
 			product_firmware_version(PRODUCT_FIRMWARE_VERSION),
 			publisher(this),
 			last_ack_handlers_update(0),
-			initialized(false)
+			initialized(false),
+			last_history_msg_id(0),
+			history_pending(false)
 	{
 	}
 
@@ -102,8 +102,9 @@ enum DescriptionType {
     DESCRIBE_SYSTEM = 1<<0,            	// modules
     DESCRIBE_APPLICATION = 1<<1,       	// functions and variables
 	DESCRIBE_METRICS = 1<<2,				// metrics/diagnostics
+	DESCRIBE_METRICS_HISTORY = 1<<3,		// recorded diagnostics samples
     DESCRIBE_DEFAULT = DESCRIBE_SYSTEM | DESCRIBE_APPLICATION,
-	DESCRIBE_MAX = (1<<3)-1
+	DESCRIBE_MAX = (1<<4)-1
 };
 
 namespace Connection
@@ -38,7 +38,13 @@ class Publisher
 {
 public:
 	explicit Publisher(Protocol* protocol) :
-			protocol(protocol)
+			protocol(protocol),
+			lastMinute(0),
+			eventsThisMinute(0),
+			recent_event_ticks{ (system_tick_t) -1000, (system_tick_t) -1000,
+					(system_tick_t) -1000, (system_tick_t) -1000,
+					(system_tick_t) -1000 },
+			evt_tick_idx(0)
 	{
 	}
 
@@ -51,9 +57,6 @@ public:
 	{
 		if (is_system_event)
 		{
-			static uint16_t lastMinute = 0;
-			static uint8_t eventsThisMinute = 0;
-
 			uint16_t currentMinute = uint16_t(millis >> 16);
 			if (currentMinute == lastMinute)
 			{      // == handles millis() overflow
@@ -69,12 +72,6 @@ public:
 		}
 		else
 		{
-			static system_tick_t recent_event_ticks[5] =
-			{ (system_tick_t) -1000, (system_tick_t) -1000,
-					(system_tick_t) -1000, (system_tick_t) -1000,
-					(system_tick_t) -1000 };
-			static int evt_tick_idx = 0;
-
 			system_tick_t now = recent_event_ticks[evt_tick_idx] = millis;
 			evt_tick_idx++;
 			evt_tick_idx %= 5;
@@ -124,6 +121,12 @@ public:
 private:
 	Protocol* protocol;
 
+	// Rate limiting state is kept per protocol instance
+	uint16_t lastMinute;
+	uint8_t eventsThisMinute;
+	system_tick_t recent_event_ticks[5];
+	int evt_tick_idx;
+
 	void add_ack_handler(message_id_t msg_id, CompletionHandler handler);
 };
 
@@ -97,7 +97,8 @@ struct SparkDescriptor
      * @param appender	The appender function to call with the "append" data and the string to append
      * @param append		Opaque data to be passed to appender
      * @param flags		0x01 - append as binary daata, otherwise append as json
-     * @param page		A key to select which metrics data to output. Presently unused and should be 0, which means the default metrics.
+     * @param page		A key to select which metrics data to output. 0 - the default metrics, 1 - the oldest batch of samples recorded by
+     * 					the diagnostics sampler, 2 - the cloud has received the last batch of samples (nothing is appended).
      * @param reserved	For future expansion.
      * @return
      */
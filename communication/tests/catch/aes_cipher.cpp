@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+#include "aes_cipher.h"
+#include "system_error.h"
+
+#include <vector>
+#include <cstring>
+
+using namespace particle::protocol;
+
+namespace {
+
+// NIST SP 800-38A, F.2.1 CBC-AES128
+const uint8_t KEY[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+const uint8_t IV[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+const uint8_t PLAINTEXT[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10 };
+const uint8_t CIPHERTEXT[64] = {
+    0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46, 0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+    0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee, 0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+    0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b, 0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+    0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09, 0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7 };
+
+void testBackend(AesCipher::Backend backend) {
+    AesCipher aes;
+    REQUIRE(aes.setKey(KEY, backend) == 0);
+    uint8_t iv[16];
+    uint8_t buf[64];
+
+    // Encrypt in place
+    memcpy(iv, IV, sizeof(iv));
+    memcpy(buf, PLAINTEXT, sizeof(buf));
+    REQUIRE(aes.encryptCbc(iv, buf, buf, sizeof(buf)) == 0);
+    CHECK(memcmp(buf, CIPHERTEXT, sizeof(buf)) == 0);
+    CHECK(memcmp(iv, CIPHERTEXT + 48, sizeof(iv)) == 0);
+
+    // Decrypt in place
+    memcpy(iv, IV, sizeof(iv));
+    REQUIRE(aes.decryptCbc(iv, buf, buf, sizeof(buf)) == 0);
+    CHECK(memcmp(buf, PLAINTEXT, sizeof(buf)) == 0);
+    CHECK(memcmp(iv, CIPHERTEXT + 48, sizeof(iv)) == 0);
+
+    // Chained calls and sizes that are not a multiple of the interleaving factor
+    for (size_t size: { 16, 48, 80, 112, 1536 }) {
+        std::vector<uint8_t> p(size), c(size), d(size);
+        for (size_t i = 0; i < size; ++i) {
+            p[i] = i * 7;
+        }
+        memcpy(iv, IV, sizeof(iv));
+        REQUIRE(aes.encryptCbc(iv, p.data(), c.data(), size) == 0);
+        memcpy(iv, IV, sizeof(iv));
+        for (size_t i = 0; i < size; i += 16) {
+            REQUIRE(aes.decryptCbc(iv, c.data() + i, d.data() + i, 16) == 0);
+        }
+        CHECK(d == p);
+        memcpy(iv, IV, sizeof(iv));
+        REQUIRE(aes.decryptCbc(iv, c.data(), d.data(), size) == 0);
+        CHECK(d == p);
+    }
+
+    CHECK(aes.encryptCbc(iv, buf, buf, 15) == SYSTEM_ERROR_INVALID_ARGUMENT);
+}
+
+} // namespace
+
+TEST_CASE("AesCipher")
+{
+    SECTION("table backend")
+    {
+        testBackend(AesCipher::TABLE);
+    }
+
+    SECTION("AES-NI backend")
+    {
+        if (AesCipher::isSupported(AesCipher::AESNI)) {
+            testBackend(AesCipher::AESNI);
+        }
+    }
+
+    SECTION("ARMv8 backend")
+    {
+        if (AesCipher::isSupported(AesCipher::ARMV8_CE)) {
+            testBackend(AesCipher::ARMV8_CE);
+        }
+    }
+
+    SECTION("the default backend is supported")
+    {
+        const auto backend = AesCipher::defaultBackend();
+        CHECK(backend != AesCipher::DEFAULT);
+        CHECK(AesCipher::isSupported(backend));
+        AesCipher aes;
+        REQUIRE(aes.setKey(KEY) == 0);
+        CHECK(aes.backend() == backend);
+    }
+
+    SECTION("fails without a key")
+    {
+        AesCipher aes;
+        uint8_t iv[16] = {};
+        uint8_t buf[16] = {};
+        CHECK(aes.encryptCbc(iv, buf, buf, sizeof(buf)) == SYSTEM_ERROR_INVALID_STATE);
+        CHECK(aes.decryptCbc(iv, buf, buf, sizeof(buf)) == SYSTEM_ERROR_INVALID_STATE);
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput of the encrypt and decrypt path of the LightSSL channel for each AES backend.
+ *
+ * The benchmark is hidden, run it with: target/runner "[benchmark]"
+ *
+ * Messages larger than the channel buffer are skipped. Define PROTOCOL_BUFFER_SIZE=1600 in the
+ * makefile to measure them as well.
+ */
+
+#include "catch.hpp"
+#include "lightssl_message_channel.h"
+
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+using namespace particle::protocol;
+
+namespace {
+
+const size_t MESSAGE_COUNT = 2000;
+
+// Data sent by the channel and received by its peer
+std::vector<uint8_t> g_wire;
+size_t g_wirePos = 0;
+
+system_tick_t wireMillis() {
+    return 0;
+}
+
+int wireSend(const unsigned char* buf, uint32_t size, void*) {
+    g_wire.insert(g_wire.end(), buf, buf + size);
+    return size;
+}
+
+int wireReceive(unsigned char* buf, uint32_t size, void*) {
+    const size_t n = std::min<size_t>(size, g_wire.size() - g_wirePos);
+    memcpy(buf, g_wire.data() + g_wirePos, n);
+    g_wirePos += n;
+    return n;
+}
+
+class BenchmarkChannel: public LightSSLMessageChannel {
+public:
+    explicit BenchmarkChannel(AesCipher::Backend backend) {
+        static const uint8_t privateKey[MAX_DEVICE_PRIVATE_KEY_LENGTH] = {};
+        static const uint8_t publicKey[MAX_SERVER_PUBLIC_KEY_LENGTH] = {};
+        static const uint8_t deviceId[12] = {};
+        Callbacks cb = {};
+        cb.millis = wireMillis;
+        cb.send = wireSend;
+        cb.receive = wireReceive;
+        init(privateKey, publicKey, deviceId, cb, nullptr);
+        uint8_t credentials[40];
+        for (size_t i = 0; i < sizeof(credentials); ++i) {
+            credentials[i] = i;
+        }
+        REQUIRE(init_session(credentials, backend) == NO_ERROR);
+    }
+
+    size_t capacity() {
+        Message m;
+        REQUIRE(create(m) == NO_ERROR);
+        return m.capacity();
+    }
+};
+
+double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void runBenchmark(AesCipher::Backend backend) {
+    for (size_t size: { 64, 128, 256, 512, 768, 1024, 1500 }) {
+        BenchmarkChannel sender(backend);
+        BenchmarkChannel receiver(backend);
+        if (size > sender.capacity()) {
+            printf("%-8s %5u B: skipped, the channel buffer is %u bytes\n", AesCipher::backendName(backend),
+                    (unsigned)size, (unsigned)sender.capacity());
+            continue;
+        }
+        g_wire.clear();
+        g_wire.reserve(MESSAGE_COUNT * (size + 18));
+        g_wirePos = 0;
+        auto t = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < MESSAGE_COUNT; ++i) {
+            Message m;
+            REQUIRE(sender.create(m, size) == NO_ERROR);
+            memset(m.buf(), (int)i, size);
+            m.set_length(size);
+            REQUIRE(sender.send(m) == NO_ERROR);
+        }
+        const double encTime = seconds(t);
+        t = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < MESSAGE_COUNT; ++i) {
+            Message m;
+            REQUIRE(receiver.receive(m) == NO_ERROR);
+            REQUIRE(m.length() == size);
+            REQUIRE(m.buf()[size - 1] == (uint8_t)i);
+        }
+        const double decTime = seconds(t);
+        const double bytes = (double)MESSAGE_COUNT * size;
+        printf("%-8s %5u B: encrypt %8.1f MB/s, decrypt %8.1f MB/s\n", AesCipher::backendName(backend),
+                (unsigned)size, bytes / encTime / 1e6, bytes / decTime / 1e6);
+    }
+}
+
+} // namespace
+
+TEST_CASE("LightSSL channel throughput", "[.][benchmark]")
+{
+    for (auto backend: { AesCipher::TABLE, AesCipher::AESNI, AesCipher::ARMV8_CE }) {
+        if (AesCipher::isSupported(backend)) {
+            runBenchmark(backend);
+        }
+    }
+}
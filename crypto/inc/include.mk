@@ -8,3 +8,11 @@ include $(CRYPTO_DEPS_INCLUDE_SCRIPTS)
 CRYPTO_LIB_DEP += $(MBEDTLS_LIB_DEP)
 LIBS += $(notdir $(CRYPTO_DEPS))
 LIB_DIRS += $(MBEDTLS_LIB_DIR)
+
+# Crypto profile: "default" or "fast_handshake". The fast handshake profile trades about 1KB of
+# flash for a precomputed secp256r1 base point table, see crypto/src/mbedtls_ecp_comb.cpp
+CRYPTO_PROFILE ?= default
+ifeq ("$(CRYPTO_PROFILE)","fast_handshake")
+CFLAGS += -DCRYPTO_PROFILE_FAST_HANDSHAKE
+LDFLAGS += -Wl,--wrap=mbedtls_ecp_group_load
+endif
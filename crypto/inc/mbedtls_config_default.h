@@ -1389,7 +1389,10 @@
  *
  * This modules adds support for the AES-NI instructions on x86-64
  */
-//#define MBEDTLS_AESNI_C
+#if PLATFORM_ID == 3 && defined(__x86_64__)
+// The virtual device can use AES-NI if the host CPU supports it (detected at runtime)
+#define MBEDTLS_AESNI_C
+#endif
 
 /**
  * \def MBEDTLS_AES_C
@@ -2464,9 +2467,20 @@
 //#define MBEDTLS_HMAC_DRBG_MAX_SEED_INPUT      384 /**< Maximum size of (re)seed buffer */
 
 /* ECP options */
+#if defined(CRYPTO_PROFILE_FAST_HANDSHAKE)
+/*
+ * Fast handshake profile (CRYPTO_PROFILE=fast_handshake): only secp256r1 is enabled, the base
+ * point comb table is kept in flash (see crypto/src/mbedtls_ecp_comb.cpp) and the window
+ * and fixed point settings the table was generated for are set explicitly.
+ */
+#define MBEDTLS_ECP_MAX_BITS             256 /**< Maximum bit size of groups */
+#define MBEDTLS_ECP_WINDOW_SIZE            6 /**< Maximum window size used */
+#define MBEDTLS_ECP_FIXED_POINT_OPTIM      1 /**< Enable fixed-point speed-up */
+#else
 //#define MBEDTLS_ECP_MAX_BITS             521 /**< Maximum bit size of groups */
 //#define MBEDTLS_ECP_WINDOW_SIZE            6 /**< Maximum window size used */
 //#define MBEDTLS_ECP_FIXED_POINT_OPTIM      1 /**< Enable fixed-point speed-up */
+#endif /* defined(CRYPTO_PROFILE_FAST_HANDSHAKE) */
 
 /* Entropy options */
 //#define MBEDTLS_ENTROPY_MAX_SOURCES                20 /**< Maximum number of sources supported */
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MBEDTLS_ECP_COMB_H
+#define MBEDTLS_ECP_COMB_H
+
+#include <stddef.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Enables or disables the precomputed secp256r1 base point table.
+ *
+ * When enabled, every secp256r1 group loaded via `mbedtls_ecp_group_load()` gets its comb table
+ * initialized from flash, so that multiplications of the base point (key generation, ECDSA
+ * signing, half of ECDSA verification) don't need to compute it. The table is enabled by default
+ * in the fast handshake profile.
+ *
+ * @return 0 on success, or -1 if the table is not available in this build.
+ */
+int mbedtls_ecp_comb_table_enable(int enabled);
+
+/**
+ * Returns 1 if the precomputed base point table is in use, or 0 otherwise.
+ */
+int mbedtls_ecp_comb_table_enabled(void);
+
+/**
+ * Returns the size of the precomputed base point table in flash, or 0 if the table is not
+ * available in this build.
+ */
+size_t mbedtls_ecp_comb_table_size(void);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // MBEDTLS_ECP_COMB_H
@@ -0,0 +1,74 @@
+#!/usr/bin/env python
+#
+# Generates the precomputed comb table for the secp256r1 base point used by the fast handshake
+# crypto profile (see crypto/src/mbedtls_ecp_comb.cpp).
+#
+# The table matches the one mbedTLS computes in ecp_precompute_comb() when multiplying the base
+# point with MBEDTLS_ECP_FIXED_POINT_OPTIM enabled: w = 5, d = ceil(256 / w) = 52, and
+# T[i] = G + sum(2^(d * (b + 1)) * G) for each bit b set in i, for i = 0 .. 2^(w - 1) - 1.
+#
+# Usage: python gen_ecp_comb_table.py > table.inc
+
+P = 0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff
+A = P - 3
+B = 0x5ac635d8aa3a93e7b3ebbd55769886bc651d06b0cc53b0f63bce3c3e27d2604b
+GX = 0x6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296
+GY = 0x4fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5
+NBITS = 256
+W = 5
+D = (NBITS + W - 1) // W
+
+def inv(x):
+    return pow(x, P - 2, P)
+
+def add(p1, p2):
+    if p1 is None:
+        return p2
+    if p2 is None:
+        return p1
+    x1, y1 = p1
+    x2, y2 = p2
+    if x1 == x2:
+        if (y1 + y2) % P == 0:
+            return None
+        l = (3 * x1 * x1 + A) * inv(2 * y1) % P
+    else:
+        l = (y2 - y1) * inv(x2 - x1) % P
+    x3 = (l * l - x1 - x2) % P
+    return (x3, (l * (x1 - x3) - y1) % P)
+
+def mul(k, pt):
+    r = None
+    while k:
+        if k & 1:
+            r = add(r, pt)
+        pt = add(pt, pt)
+        k >>= 1
+    return r
+
+def check(pt):
+    x, y = pt
+    assert (y * y - (x * x * x + A * x + B)) % P == 0
+
+def bytes_of(v):
+    return ', '.join('0x%02x' % ((v >> (8 * i)) & 0xff) for i in reversed(range(32)))
+
+def main():
+    g = (GX, GY)
+    check(g)
+    pre_len = 1 << (W - 1)
+    print('// Generated by crypto/scripts/gen_ecp_comb_table.py (w = %d, d = %d)' % (W, D))
+    for i in range(pre_len):
+        k = 1
+        for b in range(W - 1):
+            if i & (1 << b):
+                k += 1 << (D * (b + 1))
+        pt = mul(k, g)
+        check(pt)
+        print('{ // T[%d]' % i)
+        print('    { %s },' % bytes_of(pt[0]))
+        print('    { %s }' % bytes_of(pt[1]))
+        print('},')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mbedtls_ecp_comb.h"
+
+#if defined(CRYPTO_PROFILE_FAST_HANDSHAKE)
+
+#include "mbedtls/ecp.h"
+
+#if !defined(MBEDTLS_ECP_DP_SECP256R1_ENABLED) || MBEDTLS_ECP_FIXED_POINT_OPTIM != 1 || \
+        MBEDTLS_ECP_WINDOW_SIZE < 5 || defined(MBEDTLS_ECP_ALT)
+#error "Fast handshake profile requires the software secp256r1 implementation with fixed point optimization"
+#endif
+
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdlib.h>
+#define mbedtls_calloc calloc
+#define mbedtls_free free
+#endif
+
+namespace {
+
+/*
+ * mbedTLS multiplies the base point using a comb of width w = 5 (one more than for other
+ * points), which needs 2^(w-1) precomputed points. Computing them takes 208 point doublings,
+ * 15 additions and two inversions, which is more than half of the cost of the multiplication
+ * itself, and is repeated for every group instance since the table is owned by the group.
+ *
+ * Here the points are stored in flash in affine coordinates, and copied to the group when it's
+ * loaded. The table is generated by crypto/scripts/gen_ecp_comb_table.py
+ */
+const size_t COMB_POINT_COUNT = 16;
+const size_t COMB_COORD_SIZE = 32;
+
+struct CombPoint {
+    unsigned char x[COMB_COORD_SIZE];
+    unsigned char y[COMB_COORD_SIZE];
+};
+
+const CombPoint SECP256R1_COMB[COMB_POINT_COUNT] = {
+    // Generated by crypto/scripts/gen_ecp_comb_table.py (w = 5, d = 52)
+    { // T[0]
+        { 0x6b, 0x17, 0xd1, 0xf2, 0xe1, 0x2c, 0x42, 0x47, 0xf8, 0xbc, 0xe6, 0xe5, 0x63, 0xa4, 0x40, 0xf2, 0x77, 0x03, 0x7d, 0x81, 0x2d, 0xeb, 0x33, 0xa0, 0xf4, 0xa1, 0x39, 0x45, 0xd8, 0x98, 0xc2, 0x96 },
+        { 0x4f, 0xe3, 0x42, 0xe2, 0xfe, 0x1a, 0x7f, 0x9b, 0x8e, 0xe7, 0xeb, 0x4a, 0x7c, 0x0f, 0x9e, 0x16, 0x2b, 0xce, 0x33, 0x57, 0x6b, 0x31, 0x5e, 0xce, 0xcb, 0xb6, 0x40, 0x68, 0x37, 0xbf, 0x51, 0xf5 }
+    },
+    { // T[1]
+        { 0x3c, 0xfa, 0x0f, 0x87, 0x29, 0x7b, 0xed, 0x02, 0xdf, 0xcc, 0x23, 0x58, 0xf9, 0x4c, 0x9d, 0x1d, 0x59, 0x3a, 0x09, 0xa0, 0x3a, 0x23, 0xc6, 0xab, 0xf7, 0xd2, 0x4b, 0xb7, 0x04, 0xba, 0xc8, 0x70 },
+        { 0xe4, 0xe3, 0x76, 0x94, 0x70, 0xbe, 0x12, 0xc6, 0xa7, 0x58, 0xaa, 0x80, 0x83, 0x09, 0xaf, 0x9b, 0x62, 0x12, 0x1c, 0x0d, 0x02, 0x48, 0xa8, 0xaf, 0xce, 0x98, 0xa3, 0x0b, 0x40, 0xf2, 0x69, 0x40 }
+    },
+    { // T[2]
+        { 0xd6, 0x69, 0x03, 0x37, 0x6d, 0xf0, 0xfd, 0x5e, 0x28, 0xfe, 0x9a, 0x4f, 0x25, 0x4c, 0x54, 0x91, 0xf6, 0xd7, 0x7c, 0x27, 0x08, 0x8b, 0x86, 0xdb, 0xdd, 0x37, 0xe3, 0xff, 0x86, 0xef, 0x7d, 0x7d },
+        { 0x20, 0xe2, 0xa5, 0x3c, 0xe6, 0xd1, 0x3d, 0x22, 0xa1, 0x3e, 0x95, 0x78, 0xdf, 0x07, 0x41, 0x67, 0xf3, 0xd1, 0xa7, 0xaf, 0x9e, 0x43, 0x73, 0xf9, 0x9f, 0xf0, 0x49, 0x92, 0xad, 0xda, 0xd5, 0x96 }
+    },
+    { // T[3]
+        { 0x62, 0x1c, 0x75, 0xd1, 0x02, 0xea, 0xdb, 0x2e, 0xdb, 0x82, 0xb3, 0xea, 0x54, 0x49, 0x20, 0xa4, 0xc3, 0x02, 0xf8, 0xf4, 0x96, 0xbe, 0xa2, 0x5a, 0xae, 0xbf, 0xd7, 0x35, 0x52, 0x5d, 0x6a, 0xbf },
+        { 0xd7, 0xc4, 0xa4, 0xfe, 0xb4, 0xfa, 0x64, 0x9d, 0x4f, 0xda, 0xc9, 0x6f, 0x52, 0x2d, 0x7f, 0x70, 0x22, 0x5d, 0x03, 0xd8, 0x57, 0xc4, 0x6d, 0x63, 0x89, 0x39, 0xdc, 0x4c, 0x9e, 0xf4, 0x85, 0xf0 }
+    },
+    { // T[4]
+        { 0x00, 0xdc, 0x46, 0xe7, 0xc9, 0x9a, 0x73, 0x9d, 0x9f, 0x05, 0xf9, 0x4a, 0x8c, 0x26, 0x7d, 0x88, 0xf7, 0x65, 0x99, 0x58, 0xed, 0xd9, 0x58, 0x3f, 0x8b, 0xc6, 0x59, 0xaa, 0xc0, 0xb9, 0x37, 0x2a },
+        { 0x03, 0x12, 0xa5, 0x57, 0x45, 0x79, 0x34, 0x24, 0x40, 0xd1, 0xe3, 0xab, 0x52, 0x28, 0xc1, 0x11, 0xb5, 0xeb, 0x20, 0x2d, 0x81, 0x56, 0xbf, 0x6a, 0x4a, 0xf5, 0x0a, 0x00, 0xdf, 0x55, 0xd0, 0xf2 }
+    },
+    { // T[5]
+        { 0x3c, 0x53, 0xe2, 0x90, 0x15, 0xb0, 0xa1, 0xe5, 0x76, 0x34, 0x7a, 0x52, 0x84, 0xe3, 0x2e, 0x59, 0x05, 0xe3, 0xf2, 0x23, 0x0d, 0x8c, 0x01, 0x3d, 0x8d, 0x96, 0x92, 0xf7, 0x7e, 0xb8, 0xcf, 0xee },
+        { 0xd3, 0x0e, 0x7c, 0xda, 0x14, 0x0e, 0xfe, 0xb3, 0x11, 0xa9, 0xf0, 0x72, 0x9a, 0x08, 0x69, 0x3f, 0x1b, 0x9f, 0x1b, 0xd1, 0x00, 0xd2, 0x35, 0x91, 0x53, 0x8b, 0x7d, 0xa5, 0xfa, 0xe7, 0x98, 0xd4 }
+    },
+    { // T[6]
+        { 0xed, 0x84, 0xbb, 0x42, 0x5f, 0xe3, 0x9a, 0xad, 0xfd, 0x42, 0x6d, 0x94, 0x2d, 0xf2, 0x32, 0xcf, 0x13, 0xd7, 0x2b, 0x7a, 0x3f, 0x7f, 0xbe, 0x90, 0x6d, 0xfc, 0xf7, 0x87, 0xf8, 0xe8, 0xf6, 0x83 },
+        { 0xa3, 0x23, 0x34, 0x55, 0x58, 0x3c, 0x33, 0xf2, 0x0c, 0xf8, 0x3b, 0x61, 0x97, 0xa1, 0xd7, 0x03, 0x67, 0xdd, 0x0a, 0x8e, 0x35, 0x54, 0x30, 0xe3, 0x02, 0x3e, 0x67, 0xa1, 0x73, 0x29, 0x95, 0xfc }
+    },
+    { // T[7]
+        { 0x95, 0xe1, 0x84, 0x52, 0x66, 0x38, 0x2a, 0xda, 0xb3, 0x1d, 0x23, 0x53, 0x1b, 0x4d, 0x0d, 0x1f, 0x50, 0xcc, 0x51, 0xc1, 0x8a, 0x4e, 0xee, 0x61, 0xce, 0xbb, 0xbc, 0x7b, 0x5f, 0x16, 0x5d, 0x99 },
+        { 0x68, 0xd6, 0x8c, 0x8f, 0x6b, 0x0f, 0xb8, 0xf3, 0x3e, 0xaa, 0x82, 0x89, 0x1f, 0x4f, 0xa1, 0x2f, 0xa0, 0xa2, 0xa9, 0x6e, 0x41, 0x42, 0xff, 0x0f, 0xac, 0xad, 0x4f, 0x81, 0x0a, 0x83, 0x9b, 0x5b }
+    },
+    { // T[8]
+        { 0x54, 0xe2, 0x44, 0xd5, 0x10, 0x1e, 0x5d, 0xe4, 0x9d, 0x3d, 0xc3, 0x34, 0x6b, 0xec, 0xcb, 0xb9, 0xe8, 0x0f, 0x26, 0xbd, 0x8d, 0x0f, 0x4f, 0x65, 0x93, 0x11, 0xa2, 0x69, 0x51, 0xbb, 0xb3, 0xf1 },
+        { 0xd6, 0xbb, 0xec, 0x0e, 0xec, 0x10, 0x6e, 0xb6, 0x19, 0xbd, 0x41, 0x07, 0x35, 0xdf, 0x9c, 0x25, 0x43, 0x34, 0xfb, 0xc0, 0x58, 0xc2, 0xe3, 0xb7, 0xb3, 0xad, 0x4c, 0x6e, 0xf1, 0xb1, 0x9e, 0x28 }
+    },
+    { // T[9]
+        { 0xee, 0x08, 0x16, 0xa3, 0xd4, 0xd0, 0x21, 0xb6, 0x10, 0xb3, 0x7e, 0xcd, 0x77, 0x1e, 0x46, 0x88, 0xae, 0xa3, 0xc9, 0xe0, 0xb9, 0xb5, 0x29, 0x0b, 0xe8, 0x88, 0x1a, 0x83, 0x3f, 0xef, 0xcf, 0xc8 },
+        { 0xc4, 0xa4, 0x38, 0xe3, 0xad, 0x90, 0x06, 0xe1, 0x3a, 0x5f, 0xdf, 0x82, 0xdb, 0x49, 0x01, 0x9f, 0x48, 0x91, 0x5d, 0xcf, 0xc1, 0x05, 0xf2, 0xd1, 0x8e, 0x99, 0x29, 0xbf, 0xb3, 0xa8, 0xca, 0xa1 }
+    },
+    { // T[10]
+        { 0x86, 0x99, 0xdd, 0x31, 0xe0, 0x9c, 0xb9, 0xf0, 0x55, 0x27, 0x88, 0xac, 0xcb, 0xd2, 0x1e, 0x33, 0xca, 0x9f, 0x7a, 0x1d, 0xae, 0xd0, 0x35, 0xbe, 0x5d, 0x6d, 0xc5, 0x03, 0xe8, 0x3a, 0xd2, 0xc9 },
+        { 0x16, 0xe6, 0x54, 0x84, 0xe9, 0x28, 0x59, 0xb7, 0x24, 0x19, 0x99, 0x08, 0xc7, 0x2c, 0x78, 0xc1, 0x4c, 0xb2, 0x0e, 0x96, 0xb8, 0x2a, 0x5a, 0xf9, 0x38, 0x58, 0x41, 0x96, 0x32, 0x9b, 0xf9, 0x61 }
+    },
+    { // T[11]
+        { 0x18, 0x6c, 0x7f, 0x79, 0x3d, 0xf3, 0x24, 0x5e, 0xc9, 0xb9, 0x7d, 0x37, 0x4b, 0x60, 0x0b, 0x83, 0x5f, 0x0b, 0x46, 0xd5, 0xe9, 0x9d, 0x5c, 0x7c, 0xa2, 0x0a, 0x2c, 0x70, 0xdb, 0x30, 0x38, 0xdd },
+        { 0x9c, 0x42, 0x8d, 0xb8, 0x9a, 0xb5, 0x89, 0x13, 0x81, 0x39, 0xb3, 0x6a, 0x8d, 0x2e, 0xa7, 0x97, 0x92, 0x49, 0x89, 0x7f, 0x91, 0xe2, 0xd8, 0xed, 0x2a, 0xf7, 0x24, 0x60, 0x4f, 0x1c, 0xe5, 0x7f }
+    },
+    { // T[12]
+        { 0xc6, 0x2e, 0x15, 0x5c, 0x58, 0xa5, 0xf2, 0x63, 0x5b, 0xc5, 0x34, 0x1e, 0x27, 0x1a, 0x93, 0xf1, 0x5f, 0x72, 0xcc, 0x22, 0x59, 0x5e, 0x65, 0x47, 0x1f, 0x1e, 0x4f, 0x3f, 0x4b, 0xe6, 0x45, 0x8d },
+        { 0xff, 0x9f, 0x23, 0x22, 0x18, 0x26, 0x7e, 0x4e, 0xd3, 0x3a, 0x76, 0x57, 0xee, 0xaa, 0x4d, 0x04, 0x67, 0xe1, 0xf7, 0xdc, 0x7e, 0x36, 0xa6, 0xad, 0x5f, 0x6f, 0x84, 0x5a, 0x58, 0xba, 0x7f, 0xf4 }
+    },
+    { // T[13]
+        { 0x5e, 0x67, 0x7d, 0x0c, 0x95, 0x9c, 0x44, 0xfa, 0xa4, 0x48, 0x69, 0x16, 0xf4, 0x64, 0x6f, 0x9f, 0x40, 0x30, 0xec, 0xc3, 0xbb, 0x90, 0x02, 0xd8, 0xe3, 0x3f, 0x02, 0x55, 0xc7, 0x64, 0x4c, 0x1d },
+        { 0x44, 0x9f, 0x0c, 0xe6, 0x31, 0x00, 0xd3, 0x1e, 0xe3, 0x3d, 0x0b, 0xd5, 0x02, 0x99, 0x3a, 0xea, 0x5d, 0x93, 0xa8, 0x6f, 0x62, 0x48, 0xf9, 0x1f, 0xe2, 0xe7, 0xd7, 0xd0, 0xd8, 0x8b, 0x91, 0x44 }
+    },
+    { // T[14]
+        { 0xe4, 0xda, 0x88, 0xe9, 0x93, 0xd0, 0xcb, 0x92, 0x2a, 0x84, 0x94, 0x71, 0xa5, 0x91, 0xf8, 0x53, 0x68, 0xc0, 0xcd, 0x44, 0x31, 0x27, 0x35, 0x4c, 0x52, 0xdf, 0x15, 0x88, 0xfd, 0xaa, 0xb2, 0x56 },
+        { 0xf7, 0xfa, 0x4d, 0x15, 0x10, 0x06, 0x2e, 0x80, 0x97, 0xfc, 0x50, 0xde, 0xd0, 0xf3, 0xbc, 0x51, 0x60, 0xfe, 0x2a, 0x36, 0x26, 0x37, 0x07, 0xba, 0x6d, 0x1e, 0xa3, 0x5d, 0x16, 0x39, 0xc6, 0x24 }
+    },
+    { // T[15]
+        { 0x82, 0x5f, 0x01, 0x94, 0x8e, 0x83, 0x1d, 0x5b, 0x76, 0xc4, 0xc1, 0x80, 0x42, 0x86, 0xfb, 0x42, 0x1a, 0x25, 0x30, 0xb0, 0x5a, 0x00, 0x16, 0x9c, 0x2e, 0x75, 0xa2, 0x66, 0x5b, 0x69, 0x65, 0x27 },
+        { 0x43, 0x58, 0x72, 0xfe, 0xbc, 0x72, 0x3a, 0x17, 0x61, 0x79, 0x4c, 0x4f, 0x24, 0x11, 0x11, 0x50, 0x10, 0x6f, 0x9b, 0xc4, 0xce, 0x5b, 0x10, 0x6a, 0xdb, 0xf0, 0xa1, 0x1f, 0xef, 0x70, 0x37, 0x39 }
+    },
+};
+
+bool g_enabled = true;
+
+int loadCombTable(mbedtls_ecp_group* grp) {
+    const auto t = (mbedtls_ecp_point*)mbedtls_calloc(COMB_POINT_COUNT, sizeof(mbedtls_ecp_point));
+    if (!t) {
+        return MBEDTLS_ERR_ECP_ALLOC_FAILED;
+    }
+    int ret = 0;
+    for (size_t i = 0; i < COMB_POINT_COUNT; ++i) {
+        mbedtls_ecp_point_init(&t[i]);
+    }
+    for (size_t i = 0; i < COMB_POINT_COUNT; ++i) {
+        const CombPoint& p = SECP256R1_COMB[i];
+        MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&t[i].X, p.x, sizeof(p.x)));
+        MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&t[i].Y, p.y, sizeof(p.y)));
+        MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&t[i].Z, 1));
+    }
+    // The group owns the table and releases it in mbedtls_ecp_group_free()
+    grp->T = t;
+    grp->T_size = COMB_POINT_COUNT;
+    return 0;
+cleanup:
+    for (size_t i = 0; i < COMB_POINT_COUNT; ++i) {
+        mbedtls_ecp_point_free(&t[i]);
+    }
+    mbedtls_free(t);
+    return ret;
+}
+
+} // namespace
+
+extern "C" {
+
+int __real_mbedtls_ecp_group_load(mbedtls_ecp_group* grp, mbedtls_ecp_group_id id);
+
+// Linked in place of mbedtls_ecp_group_load() via -Wl,--wrap (see crypto/inc/include.mk)
+int __wrap_mbedtls_ecp_group_load(mbedtls_ecp_group* grp, mbedtls_ecp_group_id id) {
+    const int ret = __real_mbedtls_ecp_group_load(grp, id);
+    if (ret != 0 || id != MBEDTLS_ECP_DP_SECP256R1 || !g_enabled) {
+        return ret;
+    }
+    if (loadCombTable(grp) != 0) {
+        // Not fatal: mbedTLS will compute the table on first use
+        grp->T = nullptr;
+        grp->T_size = 0;
+    }
+    return 0;
+}
+
+} // extern "C"
+
+int mbedtls_ecp_comb_table_enable(int enabled) {
+    g_enabled = enabled;
+    return 0;
+}
+
+int mbedtls_ecp_comb_table_enabled(void) {
+    return g_enabled;
+}
+
+size_t mbedtls_ecp_comb_table_size(void) {
+    return sizeof(SECP256R1_COMB);
+}
+
+#else // !defined(CRYPTO_PROFILE_FAST_HANDSHAKE)
+
+int mbedtls_ecp_comb_table_enable(int enabled) {
+    return enabled ? -1 : 0;
+}
+
+int mbedtls_ecp_comb_table_enabled(void) {
+    return 0;
+}
+
+size_t mbedtls_ecp_comb_table_size(void) {
+    return 0;
+}
+
+#endif // !defined(CRYPTO_PROFILE_FAST_HANDSHAKE)
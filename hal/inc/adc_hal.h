@@ -29,9 +29,36 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "pinmap_hal.h"
+#include <stddef.h>
 
 /* Exported types ------------------------------------------------------------*/
 
+/**
+ * Callback invoked by the continuous sampler in the ISR context when a half of the sampling
+ * buffer is filled. The half is held by the application until it's passed to
+ * `HAL_ADC_Sampler_Release()`. Note that the DMA keeps running while a half is held: once the
+ * other half is filled, the DMA starts overwriting the held half, see `HAL_ADC_Sampler_Release()`.
+ */
+typedef void (*HAL_ADC_Sampler_Callback)(const uint16_t* samples, size_t count, void* context);
+
+typedef struct HAL_ADC_Sampler_Config {
+    uint16_t size; // sizeof(HAL_ADC_Sampler_Config)
+    pin_t pin;
+    uint32_t sample_rate; // Samples per second
+    uint16_t* buffer; // Sampling buffer, filled by the two halves in turn
+    size_t buffer_size; // Number of samples in the buffer, must be even
+    HAL_ADC_Sampler_Callback callback;
+    void* context;
+} HAL_ADC_Sampler_Config;
+
+typedef struct HAL_ADC_Sampler_Stats {
+    uint16_t size; // sizeof(HAL_ADC_Sampler_Stats)
+    uint32_t sample_rate; // Actual sample rate, which depends on the timer resolution
+    uint32_t buffers; // Number of delivered halves
+    uint32_t overruns; // Number of halves dropped because the application still held the other half
+    uint8_t held_overwritten; // Set if the currently held half is being overwritten
+} HAL_ADC_Sampler_Stats;
+
 /* Exported constants --------------------------------------------------------*/
 
 /* Exported macros -----------------------------------------------------------*/
@@ -46,6 +73,28 @@ void HAL_ADC_Set_Sample_Time(uint8_t ADC_SampleTime);
 int32_t HAL_ADC_Read(pin_t pin);
 void HAL_ADC_DMA_Init();
 
+/**
+ * Starts continuous sampling of a pin.
+ *
+ * Conversions are triggered by a hardware timer and the samples are written to the buffer by DMA,
+ * so the sample timing doesn't depend on the software. The callback is invoked for each filled
+ * half of the buffer, while the other half is being filled. A half that is filled while the
+ * application still holds the other half is not delivered and is counted as an overrun, and the
+ * held half is marked as overwritten. `HAL_ADC_Read()` is not available while the sampler is
+ * running.
+ */
+int HAL_ADC_Sampler_Start(const HAL_ADC_Sampler_Config* config, void* reserved);
+int HAL_ADC_Sampler_Stop(void* reserved);
+/**
+ * Returns a half of the buffer passed to the callback back to the sampler.
+ *
+ * Returns `SYSTEM_ERROR_TIMEOUT` if the half was held for longer than it takes to fill the other
+ * half, in which case the DMA has overwritten some of its samples and the data should be discarded.
+ * The half is released in either case.
+ */
+int HAL_ADC_Sampler_Release(const uint16_t* samples, void* reserved);
+int HAL_ADC_Sampler_Get_Stats(HAL_ADC_Sampler_Stats* stats, void* reserved);
+
 #ifdef __cplusplus
 }
 #endif
@@ -86,6 +86,10 @@ DYNALIB_FN(33, hal_gpio, HAL_PWM_Get_AnalogValue_Ext, uint32_t(uint16_t))
 DYNALIB_FN(34, hal_gpio, HAL_PWM_Get_Max_Frequency, uint32_t(uint16_t))
 DYNALIB_FN(35, hal_gpio, HAL_Interrupts_Detach_Ext, void(uint16_t, uint8_t, void*))
 DYNALIB_FN(36, hal_gpio, HAL_Set_Direct_Interrupt_Handler, int(IRQn_Type irqn, HAL_Direct_Interrupt_Handler handler, uint32_t flags, void* reserved))
+DYNALIB_FN(37, hal_gpio, HAL_ADC_Sampler_Start, int(const HAL_ADC_Sampler_Config*, void*))
+DYNALIB_FN(38, hal_gpio, HAL_ADC_Sampler_Stop, int(void*))
+DYNALIB_FN(39, hal_gpio, HAL_ADC_Sampler_Release, int(const uint16_t*, void*))
+DYNALIB_FN(40, hal_gpio, HAL_ADC_Sampler_Get_Stats, int(HAL_ADC_Sampler_Stats*, void*))
 
 DYNALIB_END(hal_gpio)
 
@@ -78,6 +78,8 @@ DYNALIB_FN(BASE_IDX2 + 0, hal_usart, HAL_USART_BeginConfig, void(HAL_USART_Seria
 DYNALIB_FN(BASE_IDX2 + 1, hal_usart, HAL_USART_Write_NineBitData, uint32_t(HAL_USART_Serial serial, uint16_t data))
 DYNALIB_FN(BASE_IDX2 + 2, hal_usart, HAL_USART_Send_Break, void(HAL_USART_Serial, void*))
 DYNALIB_FN(BASE_IDX2 + 3, hal_usart, HAL_USART_Break_Detected, uint8_t(HAL_USART_Serial))
+DYNALIB_FN(BASE_IDX2 + 4, hal_usart, HAL_USART_Acquire_Read, ssize_t(HAL_USART_Serial, const void**, void*))
+DYNALIB_FN(BASE_IDX2 + 5, hal_usart, HAL_USART_Commit_Read, int(HAL_USART_Serial, size_t, void*))
 
 
 DYNALIB_END(hal_usart)
@@ -143,6 +143,37 @@ typedef enum {
 
 hal_update_complete_t HAL_FLASH_End(hal_module_t* module);
 
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    uint32_t crc;               // CRC-32 of the data that was supposed to be written
+} hal_ota_image_region_t;
+
+/**
+ * Integrity information computed while the OTA image was being written.
+ */
+typedef struct {
+    uint16_t size;              // size of this structure
+    uint16_t region_count;      // number of regions that need to be read back
+    uint32_t address;           // flash address at which the image was written, see HAL_OTA_FlashAddress()
+    uint32_t image_size;        // size of the image without the trailing module CRC
+    uint32_t crc;               // CRC-32 of the first image_size bytes of the image
+    const hal_ota_image_region_t* regions;
+} hal_ota_image_digest_t;
+
+/**
+ * Sets the digest of the OTA image. When the digest matches the module being validated, the
+ * integrity of the module is verified without reading the entire image back from flash: only
+ * the specified regions are read back. Pass NULL to clear the digest.
+ *
+ * The addresses of the digest and the regions are the flash addresses passed to
+ * HAL_FLASH_Update(). The HAL translates them to the addresses at which the module is read, which
+ * differ when the OTA section is in external flash accessed via XIP.
+ *
+ * The digest and the regions must remain valid until the digest is cleared.
+ */
+int HAL_FLASH_OTA_Set_Image_Digest(const hal_ota_image_digest_t* digest, void* reserved);
+
 uint32_t HAL_FLASH_ModuleAddress(uint32_t address);
 uint32_t HAL_FLASH_ModuleLength(uint32_t address);
 bool HAL_FLASH_VerifyCRC32(uint32_t address, uint32_t length);
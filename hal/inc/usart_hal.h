@@ -172,6 +172,20 @@ ssize_t HAL_USART_Write(HAL_USART_Serial serial, const void* buffer, size_t size
 ssize_t HAL_USART_Read(HAL_USART_Serial serial, void* buffer, size_t size, size_t elementSize);
 ssize_t HAL_USART_Peek(HAL_USART_Serial serial, void* buffer, size_t size, size_t elementSize);
 
+/**
+ * Returns a pointer to a contiguous block of received data in the receive buffer, without copying it.
+ * The block remains valid until it's released with HAL_USART_Commit_Read(). Acquiring the data again
+ * without committing it returns the same block.
+ *
+ * @return Size of the block, 0 if no data is available, or a negative error code. Returns
+ *         SYSTEM_ERROR_NOT_SUPPORTED if the platform doesn't support zero-copy reading.
+ */
+ssize_t HAL_USART_Acquire_Read(HAL_USART_Serial serial, const void** data, void* reserved);
+/**
+ * Consumes the specified number of bytes of the block returned by HAL_USART_Acquire_Read().
+ */
+int HAL_USART_Commit_Read(HAL_USART_Serial serial, size_t size, void* reserved);
+
 #ifdef __cplusplus
 }
 #endif
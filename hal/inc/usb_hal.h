@@ -30,6 +30,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 /* Exported types ------------------------------------------------------------*/
 
 /* Exported constants --------------------------------------------------------*/
@@ -196,6 +197,9 @@ void HAL_USB_USART_Flush_Data(HAL_USB_USART_Serial serial);
 bool HAL_USB_USART_Is_Enabled(HAL_USB_USART_Serial serial);
 bool HAL_USB_USART_Is_Connected(HAL_USB_USART_Serial serial);
 int32_t HAL_USB_USART_LineCoding_BitRate_Handler(void (*handler)(uint32_t bitRate), void* reserved);
+// Zero-copy reading, see HAL_USART_Acquire_Read() and HAL_USART_Commit_Read()
+int32_t HAL_USB_USART_Acquire_Read(HAL_USB_USART_Serial serial, const void** data, void* reserved);
+int32_t HAL_USB_USART_Commit_Read(HAL_USB_USART_Serial serial, size_t size, void* reserved);
 #endif
 
 #ifdef USB_HID_ENABLE
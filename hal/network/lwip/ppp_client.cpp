@@ -23,6 +23,7 @@
 extern "C" {
 #include <netif/ppp/pppos.h>
 }
+#include <lwip/stats.h>
 #include <lwip/netifapi.h>
 #include <netif/ppp/pppapi.h>
 #include <mutex>
@@ -33,13 +34,29 @@ extern "C" {
 
 using namespace particle::net::ppp;
 
+namespace {
+
+/* The input is suspended when the number of free buffers in the pbuf pool drops below
+ * INPUT_SUSPEND_THRESHOLD, and resumed when it reaches INPUT_RESUME_THRESHOLD */
+const int INPUT_SUSPEND_THRESHOLD = PBUF_POOL_SIZE / 4;
+const int INPUT_RESUME_THRESHOLD = PBUF_POOL_SIZE / 2;
+/* Interval at which the pbuf pool is checked while the input is suspended */
+const unsigned INPUT_RESUME_CHECK_INTERVAL = 10;
+
+} /* namespace */
+
 std::once_flag Client::once_;
 netif_ext_callback_t Client::netifCb_ = {};
 int Client::netifClientDataIdx_ = -1;
 constexpr const char* Client::eventNames_[];
 constexpr const char* Client::stateNames_[];
 
-Client::Client() {
+Client::Client()
+    : inputBuf_(this),
+      decoder_(&inputBuf_),
+      encoder_(outputBuf_, sizeof(outputBuf_), [](const uint8_t* data, size_t size, void* ctx) -> int {
+        return static_cast<Client*>(ctx)->output(data, size);
+      }, this) {
   std::call_once(once_, []() {
     LOCK_TCPIP_CORE();
     netifClientDataIdx_ = netif_alloc_client_data_id();
@@ -52,6 +69,7 @@ Client::Client() {
 
   exit_ = false;
   running_ = false;
+  inputSuspended_ = false;
 }
 
 Client::~Client() {
@@ -68,6 +86,12 @@ void Client::init() {
     if_.flags &= ~NETIF_FLAG_UP;
 
     LOCK_TCPIP_CORE();
+    /* The outgoing packets are framed by HdlcEncoder instead of pppos */
+    linkCallbacks_ = *pcb_->link_cb;
+    linkCallbacks_.write = &Client::linkWriteCb;
+    linkCallbacks_.netif_output = &Client::linkNetifOutputCb;
+    pcb_->link_cb = &linkCallbacks_;
+
     ipcp_ = std::make_unique<Ipcp>(pcb_);
     SPARK_ASSERT(ipcp_);
     // FIXME hardcoded
@@ -121,6 +145,7 @@ bool Client::prepareConnect() {
   LOCK_TCPIP_CORE();
   if_.ip6_autoconfig_enabled = 1;
   if_.flags |= NETIF_FLAG_MLD6;
+  decoder_.reset();
   UNLOCK_TCPIP_CORE();
 
   // FIXME:
@@ -168,10 +193,14 @@ int Client::input(const uint8_t* data, size_t size) {
       case STATE_CONNECTING:
       case STATE_DISCONNECTING:
       case STATE_CONNECTED: {
-        err_t err = pppos_input_tcpip(pcb_, (u8_t*)data, size);
-        if (err) {
-          return SYSTEM_ERROR_INTERNAL;
+        {
+          /* The data is unescaped straight into pbufs, which are then passed to lwIP in
+           * the context of the calling thread */
+          LwipTcpIpCoreLock lk;
+          decoder_.setAccm(inputAccm());
+          decoder_.input(data, size);
         }
+        updateInputFlow();
         return 0;
       }
     }
@@ -179,6 +208,35 @@ int Client::input(const uint8_t* data, size_t size) {
   return SYSTEM_ERROR_INVALID_STATE;
 }
 
+uint32_t Client::inputAccm() {
+  /* Receive ACCM negotiated by LCP */
+  const auto pppos = (const pppos_pcb*)pcb_->link_ctx_cb;
+  return (uint32_t)pppos->in_accm[0] | ((uint32_t)pppos->in_accm[1] << 8) |
+      ((uint32_t)pppos->in_accm[2] << 16) | ((uint32_t)pppos->in_accm[3] << 24);
+}
+
+void Client::updateInputFlow() {
+#if MEMP_STATS
+  std::unique_lock<std::mutex> lk(mutex_);
+  const auto stats = lwip_stats.memp[MEMP_PBUF_POOL];
+  const int avail = (int)stats->avail - (int)stats->used;
+  if (inputSuspended_ ? avail < INPUT_RESUME_THRESHOLD : avail >= INPUT_SUSPEND_THRESHOLD) {
+    return;
+  }
+  inputSuspended_ = !inputSuspended_;
+  LOG_DEBUG(TRACE, "%s PPP input, %d free pbufs", inputSuspended_ ? "Suspending" : "Resuming", avail);
+  if (ifcCb_) {
+    ifcCb_(inputSuspended_, ifcCbCtx_);
+  }
+#endif /* MEMP_STATS */
+}
+
+void Client::setInputFlowControlCallback(InputFlowControlCallback cb, void* ctx) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  ifcCb_ = cb;
+  ifcCbCtx_ = ctx;
+}
+
 void Client::setNotifyCallback(NotifyCallback cb, void* ctx) {
   std::lock_guard<std::mutex> lk(mutex_);
   cb_ = cb;
@@ -228,6 +286,12 @@ void Client::loop() {
   while(!exit_) {
     unsigned qWait = 100;
 
+    if (inputSuspended_) {
+      /* lwIP doesn't notify when pbufs are freed */
+      updateInputFlow();
+      qWait = INPUT_RESUME_CHECK_INTERVAL;
+    }
+
     switch (state_) {
       case STATE_CONNECT: {
         prepareConnect();
@@ -367,6 +431,54 @@ uint32_t Client::output(const uint8_t* data, size_t len) {
   return 0;
 }
 
+err_t Client::linkWriteCb(ppp_pcb* pcb, void* ctx, pbuf* p) {
+  auto self = static_cast<Client*>(netif_get_client_data(pcb->netif, netifClientDataIdx_));
+  /* The packet includes the address, control and protocol fields */
+  const err_t err = self->linkOutput(p, 0);
+  pbuf_free(p);
+  return err;
+}
+
+err_t Client::linkNetifOutputCb(ppp_pcb* pcb, void* ctx, pbuf* p, u_short protocol) {
+  auto self = static_cast<Client*>(netif_get_client_data(pcb->netif, netifClientDataIdx_));
+  return self->linkOutput(p, protocol);
+}
+
+err_t Client::linkOutput(pbuf* p, uint16_t protocol) {
+  const auto pppos = (const pppos_pcb*)pcb_->link_ctx_cb;
+  /* Transmit ACCM negotiated by LCP */
+  encoder_.setAccm((uint32_t)pppos->out_accm[0] | ((uint32_t)pppos->out_accm[1] << 8) |
+      ((uint32_t)pppos->out_accm[2] << 16) | ((uint32_t)pppos->out_accm[3] << 24));
+  /* Send an opening flag if the link has been idle, to flush any noise */
+  const uint32_t now = sys_now();
+  encoder_.begin(now - lastOutput_ >= PPP_MAXIDLEFLAG);
+  lastOutput_ = now;
+  if (protocol) {
+    uint8_t header[4];
+    size_t size = 0;
+    if (!pppos->accomp) {
+      header[size++] = HDLC_ALLSTATIONS;
+      header[size++] = HDLC_UI;
+    }
+    if (!pppos->pcomp || protocol > 0xff) {
+      header[size++] = protocol >> 8;
+    }
+    header[size++] = protocol & 0xff;
+    encoder_.write(header, size);
+  }
+  for (pbuf* q = p; q; q = q->next) {
+    encoder_.write((const uint8_t*)q->payload, q->len);
+  }
+  if (encoder_.end() != 0) {
+    LINK_STATS_INC(link.err);
+    MIB2_STATS_NETIF_INC(pcb_->netif, ifoutdiscards);
+    return ERR_IF;
+  }
+  LINK_STATS_INC(link.xmit);
+  MIB2_STATS_NETIF_ADD(pcb_->netif, ifoutoctets, p->tot_len);
+  return ERR_OK;
+}
+
 void Client::notifyPhaseCb(ppp_pcb* pcb, uint8_t phase, void* ctx) {
   Client* self = static_cast<Client*>(ctx);
   if (self) {
@@ -401,6 +513,61 @@ void Client::notifyStatus(int err) {
   }
 }
 
+Client::InputBuffer::InputBuffer(Client* client)
+    : client_(client) {
+}
+
+Client::InputBuffer::~InputBuffer() {
+  abort();
+}
+
+uint8_t* Client::InputBuffer::acquire(size_t* size) {
+  if (!next_) {
+    next_ = pbuf_alloc(PBUF_RAW, PBUF_POOL_BUFSIZE, PBUF_POOL);
+    if (!next_) {
+      LINK_STATS_INC(link.memerr);
+      return nullptr;
+    }
+  }
+  *size = next_->len;
+  return (uint8_t*)next_->payload;
+}
+
+void Client::InputBuffer::commit(size_t size) {
+  next_->len = next_->tot_len = size;
+  if (head_) {
+    pbuf_cat(head_, next_);
+  } else {
+    head_ = next_;
+  }
+  next_ = nullptr;
+}
+
+void Client::InputBuffer::complete() {
+  if (next_) {
+    pbuf_free(next_);
+    next_ = nullptr;
+  }
+  /* Trim off the FCS */
+  pbuf_realloc(head_, head_->tot_len - 2);
+  auto p = head_;
+  head_ = nullptr;
+  LINK_STATS_INC(link.recv);
+  ppp_input(client_->pcb_, p);
+}
+
+void Client::InputBuffer::abort() {
+  if (next_) {
+    pbuf_free(next_);
+    next_ = nullptr;
+  }
+  if (head_) {
+    pbuf_free(head_);
+    head_ = nullptr;
+    LINK_STATS_INC(link.drop);
+  }
+}
+
 #if defined(LWIP_NETIF_EXT_STATUS_CALLBACK) && LWIP_NETIF_EXT_STATUS_CALLBACK == 1
 void Client::notifyNetifCb(netif* netif, netif_nsc_reason_t reason, const netif_ext_callback_args_t* args) {
   if (netif) {
@@ -23,6 +23,7 @@
 #include <lwip/netif.h>
 extern "C" {
 #include <netif/ppp/ppp.h>
+#include <netif/ppp/ppp_impl.h>
 }
 
 #if defined(PPP_SUPPORT) && PPP_SUPPORT
@@ -32,6 +33,7 @@ extern "C" {
 #include <mutex>
 #include <atomic>
 #include "stream.h"
+#include "ppp_hdlc.h"
 
 #ifdef __cplusplus
 
@@ -82,6 +84,10 @@ public:
   typedef int (*OutputCallback)(const uint8_t* data, size_t size, void* ctx);
   void setOutputCallback(OutputCallback cb, void* ctx);
 
+  /* Suspends (suspend = true) or resumes the input when the pbuf pool is running low */
+  typedef int (*InputFlowControlCallback)(bool suspend, void* ctx);
+  void setInputFlowControlCallback(InputFlowControlCallback cb, void* ctx);
+
   typedef void (*NotifyCallback)(Client* c, uint64_t ev, void* ctx);
 
   void setNotifyCallback(NotifyCallback cb, void* ctx);
@@ -138,6 +144,30 @@ private:
 
   void transition(State newState);
 
+  uint32_t inputAccm();
+  void updateInputFlow();
+
+  static err_t linkWriteCb(ppp_pcb* pcb, void* ctx, pbuf* p);
+  static err_t linkNetifOutputCb(ppp_pcb* pcb, void* ctx, pbuf* p, u_short protocol);
+  err_t linkOutput(pbuf* p, uint16_t protocol);
+
+  /* Collects the decoded frames into pbuf chains and passes them to lwIP */
+  class InputBuffer : public HdlcFrameBuffer {
+  public:
+    explicit InputBuffer(Client* client);
+    virtual ~InputBuffer();
+
+    virtual uint8_t* acquire(size_t* size) override;
+    virtual void commit(size_t size) override;
+    virtual void complete() override;
+    virtual void abort() override;
+
+  private:
+    Client* client_;
+    pbuf* head_ = nullptr;
+    pbuf* next_ = nullptr;
+  };
+
 private:
   netif if_ = {};
   ppp_pcb* pcb_ = nullptr;
@@ -164,6 +194,19 @@ private:
   OutputCallback oCb_ = nullptr;
   void* oCbCtx_ = nullptr;
 
+  InputFlowControlCallback ifcCb_ = nullptr;
+  void* ifcCbCtx_ = nullptr;
+  std::atomic_bool inputSuspended_;
+
+  /* Accessed with the TCPIP core lock held */
+  InputBuffer inputBuf_;
+  HdlcDecoder decoder_;
+  static const size_t OUTPUT_BUFFER_SIZE = 1024;
+  uint8_t outputBuf_[OUTPUT_BUFFER_SIZE];
+  HdlcEncoder encoder_;
+  link_callbacks linkCallbacks_ = {};
+  uint32_t lastOutput_ = 0;
+
   bool inited_ = false;
   std::atomic_bool running_;
   std::atomic_bool exit_;
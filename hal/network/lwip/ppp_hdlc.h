@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAL_NETWORK_LWIP_PPP_HDLC_H
+#define HAL_NETWORK_LWIP_PPP_HDLC_H
+
+#include <cstdint>
+#include <cstddef>
+
+#ifdef __cplusplus
+
+namespace particle { namespace net { namespace ppp {
+
+/* HDLC-like framing as defined by RFC 1662 */
+const uint8_t HDLC_FLAG = 0x7e;
+const uint8_t HDLC_ESCAPE = 0x7d;
+const uint8_t HDLC_TRANS = 0x20;
+const uint8_t HDLC_ALLSTATIONS = 0xff;
+const uint8_t HDLC_UI = 0x03;
+
+const uint16_t HDLC_INITFCS = 0xffff;
+const uint16_t HDLC_GOODFCS = 0xf0b8;
+
+uint16_t hdlcFcs(uint16_t fcs, const uint8_t* data, size_t size);
+
+/* Storage for the decoded frames, e.g. a chain of pbufs */
+class HdlcFrameBuffer {
+public:
+  virtual ~HdlcFrameBuffer() = default;
+
+  /* Returns a buffer for the next portion of the current frame, or nullptr if no memory is available */
+  virtual uint8_t* acquire(size_t* size) = 0;
+  /* Commits the data written to the last acquired buffer */
+  virtual void commit(size_t size) = 0;
+  /* Completes the current frame. The frame data starts with a 2-byte protocol field and ends
+   * with the 2-byte FCS, which should be removed by the implementation */
+  virtual void complete() = 0;
+  /* Discards the current frame */
+  virtual void abort() = 0;
+};
+
+struct HdlcDecoderStats {
+  unsigned frames;
+  unsigned fcsErrors;
+  unsigned formatErrors;
+  unsigned noMemory;
+};
+
+/*
+ * Incremental decoder of HDLC-framed PPP packets.
+ *
+ * The decoder removes the framing, escaping and compressed address/control fields, and unescapes
+ * the frame data straight into the buffers provided by HdlcFrameBuffer. The frames are passed
+ * on in the format expected by ppp_input(): a 2-byte protocol field followed by the information
+ * field.
+ *
+ * The input is scanned for flag, escape and control characters a word at a time, and runs of
+ * bytes that don't need unescaping are copied in bulk.
+ */
+class HdlcDecoder {
+public:
+  explicit HdlcDecoder(HdlcFrameBuffer* buffer);
+
+  void input(const uint8_t* data, size_t size);
+  void reset();
+
+  /* Control characters that should be discarded, the bit 0 corresponds to 0x00 */
+  void setAccm(uint32_t accm);
+  uint32_t accm() const;
+
+  const HdlcDecoderStats& stats() const;
+
+private:
+  enum State {
+    STATE_HUNT, /* Waiting for a flag */
+    STATE_ADDRESS,
+    STATE_CONTROL,
+    STATE_PROTOCOL1,
+    STATE_PROTOCOL2,
+    STATE_DATA
+  };
+
+  HdlcFrameBuffer* buffer_;
+  uint8_t* buf_;
+  size_t bufSize_;
+  size_t bufPos_;
+  size_t frameSize_;
+  HdlcDecoderStats stats_;
+  uint32_t accm_;
+  uint16_t fcs_;
+  uint16_t protocol_;
+  State state_;
+  bool escaped_;
+
+  void processByte(uint8_t c);
+  void endFrame();
+  bool put(uint8_t c);
+  bool putRun(const uint8_t* data, size_t size);
+  void abortFrame();
+};
+
+/*
+ * Encoder of HDLC-framed PPP packets.
+ *
+ * The encoded data is collected in the provided buffer, which is passed to the output callback
+ * every time it gets full, and at the end of each frame.
+ */
+class HdlcEncoder {
+public:
+  /* Returns the number of bytes written or an error code */
+  typedef int (*OutputCallback)(const uint8_t* data, size_t size, void* ctx);
+
+  HdlcEncoder(uint8_t* buf, size_t size, OutputCallback callback, void* ctx);
+
+  /* Starts a new frame, optionally with an opening flag */
+  void begin(bool flag = true);
+  /* Writes a portion of the frame data, starting with the address and control fields */
+  void write(const uint8_t* data, size_t size);
+  /* Completes the frame. Returns 0 or an error returned by the output callback */
+  int end();
+
+  /* Control characters that should be escaped, the bit 0 corresponds to 0x00 */
+  void setAccm(uint32_t accm);
+  uint32_t accm() const;
+
+private:
+  uint8_t* buf_;
+  size_t size_;
+  size_t pos_;
+  OutputCallback callback_;
+  void* ctx_;
+  uint32_t accm_;
+  int error_;
+  uint16_t fcs_;
+
+  void put(uint8_t c);
+  void putEscaped(uint8_t c);
+  void flush();
+};
+
+inline void HdlcDecoder::setAccm(uint32_t accm) {
+  accm_ = accm;
+}
+
+inline uint32_t HdlcDecoder::accm() const {
+  return accm_;
+}
+
+inline const HdlcDecoderStats& HdlcDecoder::stats() const {
+  return stats_;
+}
+
+inline void HdlcEncoder::setAccm(uint32_t accm) {
+  accm_ = accm;
+}
+
+inline uint32_t HdlcEncoder::accm() const {
+  return accm_;
+}
+
+} } } /* namespace particle::net::ppp */
+
+#endif /* __cplusplus */
+
+#endif /* HAL_NETWORK_LWIP_PPP_HDLC_H */
@@ -188,6 +188,10 @@ int PppNcpNetif::upImpl() {
         }
         return r;
     }, celMan_->ncpClient());
+    client_.setInputFlowControlCallback([](bool suspend, void* ctx) -> int {
+        auto c = (CellularNcpClient*)ctx;
+        return c->dataChannelFlowControl(0, suspend);
+    }, celMan_->ncpClient());
     client_.connect();
     r = celMan_->connect();
     if (r) {
@@ -600,7 +600,18 @@ int AtParserImpl::readMore(unsigned* timeout) {
     const auto strm = conf_.stream();
     size_t bytesRead = 0;
     for (;;) {
-        bytesRead = CHECK(strm->read(buf_ + bufPos_, INPUT_BUF_SIZE - bufPos_));
+        // Copy the data directly from the stream's buffer if the stream supports zero-copy reading
+        const char* data = nullptr;
+        const int n = strm->acquireRead(&data);
+        if (n > 0) {
+            bytesRead = std::min((size_t)n, INPUT_BUF_SIZE - bufPos_);
+            memcpy(buf_ + bufPos_, data, bytesRead);
+            CHECK(strm->commitRead(bytesRead));
+        } else if (n == SYSTEM_ERROR_NOT_SUPPORTED) {
+            bytesRead = CHECK(strm->read(buf_ + bufPos_, INPUT_BUF_SIZE - bufPos_));
+        } else {
+            bytesRead = CHECK(n);
+        }
         if (bytesRead > 0) {
             break;
         }
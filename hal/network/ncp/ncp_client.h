@@ -97,6 +97,8 @@ public:
     virtual int updateFirmware(InputStream* file, size_t size) = 0;
 
     virtual int dataChannelWrite(int id, const uint8_t* data, size_t size) = 0;
+    // Suspends (state = true) or resumes the incoming data on the data channel
+    virtual int dataChannelFlowControl(int id, bool state) = 0;
     virtual void processEvents() = 0;
 
     virtual AtParser* atParser();
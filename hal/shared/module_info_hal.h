@@ -35,6 +35,9 @@
             MODULE_VERIFY_FUNCTION | \
             MODULE_VERIFY_LENGTH)
 
+// Only the destination sectors that differ from the source data are erased and programmed
+#define MODULE_COPY_DIFFERENTIAL                        1<<4
+
 
 #endif	/* MODULE_INFO_HAL_H */
 
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ota_flash_hal.h"
+
+namespace particle {
+
+enum OtaImageDigestResult {
+    OTA_IMAGE_DIGEST_VALID,
+    OTA_IMAGE_DIGEST_INVALID,
+    OTA_IMAGE_DIGEST_NOT_APPLICABLE // The digest doesn't cover the module
+};
+
+/**
+ * Verifies an OTA module using the digest computed while it was being written, see
+ * `HAL_FLASH_OTA_Set_Image_Digest()`.
+ *
+ * The addresses in the digest are the flash addresses at which the image was written. They may
+ * differ from the address at which the module is read, e.g. on platforms that access the external
+ * flash via XIP. `flashAddress` is the flash address of the module, and `module` points to the
+ * module in memory. `length` is the length of the module without the trailing CRC.
+ *
+ * `crc32` is a function with the signature of `HAL_Core_Compute_CRC32()`.
+ */
+template<typename Crc32Fn>
+inline OtaImageDigestResult verifyOtaImageDigest(const hal_ota_image_digest_t& digest, uint32_t flashAddress,
+        const uint8_t* module, uint32_t length, Crc32Fn crc32) {
+    if (digest.address != flashAddress || digest.image_size != length) {
+        return OTA_IMAGE_DIGEST_NOT_APPLICABLE;
+    }
+    // The module CRC is stored in big-endian order
+    const uint8_t* const p = module + length;
+    const uint32_t expectedCrc = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    if (expectedCrc != digest.crc) {
+        return OTA_IMAGE_DIGEST_INVALID;
+    }
+    // Only the regions that might not have been written correctly are read back
+    for (unsigned i = 0; i < digest.region_count; ++i) {
+        const hal_ota_image_region_t& r = digest.regions[i];
+        if (r.address < flashAddress || r.address - flashAddress + r.size > length + 4) {
+            return OTA_IMAGE_DIGEST_INVALID;
+        }
+        if (crc32(module + (r.address - flashAddress), r.size) != r.crc) {
+            return OTA_IMAGE_DIGEST_INVALID;
+        }
+    }
+    return OTA_IMAGE_DIGEST_VALID;
+}
+
+} // namespace particle
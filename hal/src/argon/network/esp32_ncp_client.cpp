@@ -647,4 +647,21 @@ int Esp32NcpClient::dataChannelWrite(int id, const uint8_t* data, size_t size) {
     return SYSTEM_ERROR_INVALID_ARGUMENT;
 }
 
+int Esp32NcpClient::dataChannelFlowControl(int id, bool state) {
+    uint8_t channel = 0;
+    if (id == 0) {
+        channel = ESP32_NCP_STA_CHANNEL;
+    } else if (id == 1) {
+        channel = ESP32_NCP_AP_CHANNEL;
+    } else {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    if (state) {
+        muxer_.suspendChannel(channel);
+    } else {
+        muxer_.resumeChannel(channel);
+    }
+    return 0;
+}
+
 } // particle
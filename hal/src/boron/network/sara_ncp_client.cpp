@@ -303,6 +303,15 @@ int SaraNcpClient::dataChannelWrite(int id, const uint8_t* data, size_t size) {
     return muxer_.writeChannel(UBLOX_NCP_PPP_CHANNEL, data, size);
 }
 
+int SaraNcpClient::dataChannelFlowControl(int id, bool state) {
+    if (state) {
+        muxer_.suspendChannel(UBLOX_NCP_PPP_CHANNEL);
+    } else {
+        muxer_.resumeChannel(UBLOX_NCP_PPP_CHANNEL);
+    }
+    return 0;
+}
+
 void SaraNcpClient::processEvents() {
     const NcpClientLock lock(this);
     processEventsImpl();
@@ -49,6 +49,7 @@ public:
     int getFirmwareModuleVersion(uint16_t* ver) override;
     int updateFirmware(InputStream* file, size_t size) override;
     int dataChannelWrite(int id, const uint8_t* data, size_t size) override;
+    int dataChannelFlowControl(int id, bool state) override;
     void processEvents() override;
     AtParser* atParser() override;
     void lock() override;
@@ -28,6 +28,7 @@
 #include "gpio_hal.h"
 #include "pinmap_hal.h"
 #include "pinmap_impl.h"
+#include "system_error.h"
 
 /* Private typedef -----------------------------------------------------------*/
 
@@ -244,3 +245,23 @@ void HAL_ADC_DMA_Init()
   // Check the end of ADC2 calibration
   while(ADC_GetCalibrationStatus(ADC2));
 }
+
+int HAL_ADC_Sampler_Start(const HAL_ADC_Sampler_Config* config, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_ADC_Sampler_Stop(void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_ADC_Sampler_Release(const uint16_t* samples, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_ADC_Sampler_Get_Stats(HAL_ADC_Sampler_Stats* stats, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
@@ -75,6 +75,12 @@ hal_update_complete_t HAL_FLASH_End(hal_module_t* reserved)
     return HAL_UPDATE_APPLIED_PENDING_RESTART;
 }
 
+int HAL_FLASH_OTA_Set_Image_Digest(const hal_ota_image_digest_t* digest, void* reserved)
+{
+    // The image is not read back during validation, so there's nothing to skip
+    return 0;
+}
+
 void HAL_FLASH_Read_ServerAddress(ServerAddress* server_addr)
 {
     uint8_t buf[EXTERNAL_FLASH_SERVER_DOMAIN_LENGTH];
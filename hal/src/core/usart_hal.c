@@ -29,6 +29,7 @@
 #include "stm32f10x.h"
 #include <string.h>
 #include "interrupts_hal.h"
+#include "system_error.h"
 
 /* Private typedef -----------------------------------------------------------*/
 typedef enum USART_Num_Def {
@@ -601,6 +602,16 @@ uint8_t HAL_USART_Break_Detected(HAL_USART_Serial serial)
   return 0;
 }
 
+ssize_t HAL_USART_Acquire_Read(HAL_USART_Serial serial, const void** data, void* reserved)
+{
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_USART_Commit_Read(HAL_USART_Serial serial, size_t size, void* reserved)
+{
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
 // Shared Interrupt Handler for USART2/Serial1 and USART1/Serial2
 // WARNING: This function MUST remain reentrance compliant -- no local static variables etc.
 static void HAL_USART_Handler(HAL_USART_Serial serial)
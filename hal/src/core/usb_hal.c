@@ -35,6 +35,7 @@
 #include "usb_settings.h"
 #include "deviceid_hal.h"
 #include "bytes2hexbuf.h"
+#include "system_error.h"
 
 /* Private typedef -----------------------------------------------------------*/
 
@@ -317,6 +318,16 @@ bool HAL_USB_USART_Is_Connected(HAL_USB_USART_Serial serial)
   return true;
 }
 
+int32_t HAL_USB_USART_Acquire_Read(HAL_USB_USART_Serial serial, const void** data, void* reserved)
+{
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int32_t HAL_USB_USART_Commit_Read(HAL_USB_USART_Serial serial, size_t size, void* reserved)
+{
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
 #endif
 
 #ifdef USB_HID_ENABLE
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adc_hal.h"
+#include "adc_hal_impl.h"
+#include "timer_hal.h"
+#include "system_error.h"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+const uint16_t ADC_MAX_VALUE = 4095;
+
+// Pins that can have a waveform assigned: the digital pins followed by the analog pins
+const pin_t ADC_PIN_COUNT = FIRST_ANALOG_PIN + TOTAL_ANALOG_PINS;
+
+// Sample rate used to compute the samples returned by HAL_ADC_Read()
+const uint32_t ADC_READ_SAMPLE_RATE = 1000000;
+
+HAL_ADC_Waveform waveforms[ADC_PIN_COUNT] = {};
+
+// Deterministic noise in the range [-1, 1]
+float noise(pin_t pin, uint64_t index) {
+    uint64_t x = index * 0x9e3779b97f4a7c15ull + pin + 1;
+    x ^= x >> 31;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    return (float)(x >> 40) / (float)(1ull << 23) - 1.0f;
+}
+
+/*
+ * Thread producing the samples takes the place of the timer-triggered DMA. The callback is invoked
+ * from that thread, similarly to the DMA interrupt on the hardware platforms.
+ */
+class Sampler {
+public:
+    Sampler() :
+            active_(false),
+            paced_(true) {
+    }
+
+    ~Sampler() {
+        stop();
+    }
+
+    int start(const HAL_ADC_Sampler_Config& config) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (active_) {
+            return SYSTEM_ERROR_INVALID_STATE;
+        }
+        config_ = config;
+        halfSize_ = config.buffer_size / 2;
+        buffers_ = 0;
+        overruns_ = 0;
+        held_ = -1;
+        overwritten_ = false;
+        stop_ = false;
+        active_ = true;
+        thread_ = std::thread([this]() {
+            run();
+        });
+        return 0;
+    }
+
+    int stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_) {
+            return SYSTEM_ERROR_INVALID_STATE;
+        }
+        stop_ = true;
+        thread_.join();
+        active_ = false;
+        return 0;
+    }
+
+    int release(const uint16_t* samples) {
+        const int held = held_;
+        if (!active_) {
+            return SYSTEM_ERROR_INVALID_STATE;
+        }
+        if (held < 0 || samples != config_.buffer + held * halfSize_) {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+        const bool overwritten = overwritten_;
+        held_ = -1;
+        return overwritten ? SYSTEM_ERROR_TIMEOUT : 0;
+    }
+
+    void stats(HAL_ADC_Sampler_Stats* stats) const {
+        stats->sample_rate = active_ ? config_.sample_rate : 0;
+        stats->buffers = buffers_;
+        stats->overruns = overruns_;
+        stats->held_overwritten = held_ >= 0 && overwritten_;
+    }
+
+    bool isActive() const {
+        return active_;
+    }
+
+    void paced(bool paced) {
+        paced_ = paced;
+    }
+
+private:
+    HAL_ADC_Sampler_Config config_;
+    size_t halfSize_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::atomic<bool> active_;
+    std::atomic<bool> stop_;
+    std::atomic<bool> paced_;
+    std::atomic<uint32_t> buffers_;
+    std::atomic<uint32_t> overruns_;
+    std::atomic<int> held_; // Index of the half held by the application, or -1
+    std::atomic<bool> overwritten_; // Set if the held half is being overwritten
+
+    void run() {
+        typedef std::chrono::steady_clock clock;
+        const auto startTime = clock::now();
+        uint64_t index = 0;
+        int half = 0;
+        while (!stop_) {
+            uint16_t* const samples = config_.buffer + half * halfSize_;
+            for (size_t i = 0; i < halfSize_; ++i) {
+                samples[i] = HAL_ADC_Waveform_Sample(config_.pin, index + i, config_.sample_rate);
+            }
+            index += halfSize_;
+            if (paced_) {
+                std::this_thread::sleep_until(startTime + std::chrono::microseconds(
+                        index * 1000000 / config_.sample_rate));
+            }
+            if (held_ >= 0) {
+                // The held half is filled next
+                overwritten_ = true;
+                ++overruns_;
+            } else {
+                ++buffers_;
+                overwritten_ = false;
+                held_ = half;
+                if (config_.callback) {
+                    config_.callback(samples, halfSize_, config_.context);
+                }
+            }
+            half ^= 1;
+        }
+    }
+};
+
+Sampler sampler;
+
+} // namespace
+
+int HAL_ADC_Set_Waveform(pin_t pin, const HAL_ADC_Waveform* waveform, void* reserved)
+{
+    if (pin >= ADC_PIN_COUNT) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    if (waveform) {
+        waveforms[pin] = *waveform;
+    } else {
+        waveforms[pin] = HAL_ADC_Waveform();
+    }
+    return 0;
+}
+
+uint16_t HAL_ADC_Waveform_Sample(pin_t pin, uint64_t index, uint32_t sample_rate)
+{
+    if (pin >= ADC_PIN_COUNT || sample_rate == 0) {
+        return 0;
+    }
+    const HAL_ADC_Waveform& w = waveforms[pin];
+    // Phase in the range [0, 1)
+    const double cycles = (double)index * w.frequency / sample_rate;
+    const double phase = cycles - std::floor(cycles);
+    double v = w.offset;
+    switch (w.type) {
+    case HAL_ADC_WAVEFORM_SINE:
+        v += w.amplitude * std::sin(2 * M_PI * phase);
+        break;
+    case HAL_ADC_WAVEFORM_SQUARE:
+        v += (phase < 0.5) ? w.amplitude : -(double)w.amplitude;
+        break;
+    case HAL_ADC_WAVEFORM_SAWTOOTH:
+        v += w.amplitude * (2 * phase - 1);
+        break;
+    default:
+        break;
+    }
+    if (w.noise) {
+        v += w.noise * noise(pin, index);
+    }
+    v = std::round(v);
+    return (v < 0) ? 0 : (v > ADC_MAX_VALUE) ? ADC_MAX_VALUE : (uint16_t)v;
+}
+
+void HAL_ADC_Sampler_Set_Paced(bool paced)
+{
+    sampler.paced(paced);
+}
+
+void HAL_ADC_Set_Sample_Time(uint8_t ADC_SampleTime)
+{
+}
+
+int32_t HAL_ADC_Read(uint16_t pin)
+{
+    if (sampler.isActive()) {
+        return 0;
+    }
+    return HAL_ADC_Waveform_Sample(pin, HAL_Timer_Get_Micro_Seconds(), ADC_READ_SAMPLE_RATE);
+}
+
+void HAL_ADC_DMA_Init()
+{
+}
+
+int HAL_ADC_Sampler_Start(const HAL_ADC_Sampler_Config* config, void* reserved)
+{
+    if (!config || config->pin >= ADC_PIN_COUNT || !config->buffer || config->buffer_size < 2 ||
+            (config->buffer_size % 2) != 0 || config->sample_rate == 0) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    return sampler.start(*config);
+}
+
+int HAL_ADC_Sampler_Stop(void* reserved)
+{
+    return sampler.stop();
+}
+
+int HAL_ADC_Sampler_Release(const uint16_t* samples, void* reserved)
+{
+    return sampler.release(samples);
+}
+
+int HAL_ADC_Sampler_Get_Stats(HAL_ADC_Sampler_Stats* stats, void* reserved)
+{
+    if (!stats) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    sampler.stats(stats);
+    return 0;
+}
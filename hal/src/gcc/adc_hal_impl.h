@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "pinmap_hal.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Synthetic analog inputs of the virtual device.
+ *
+ * Each pin produces a waveform that is sampled by HAL_ADC_Read() and by the continuous sampler.
+ * The samples are computed from the sample index and the sample rate, so the sampled signal is
+ * the same in every run regardless of the host's timing.
+ */
+
+typedef enum HAL_ADC_Waveform_Type {
+    HAL_ADC_WAVEFORM_CONSTANT = 0, // offset
+    HAL_ADC_WAVEFORM_SINE = 1,
+    HAL_ADC_WAVEFORM_SQUARE = 2,
+    HAL_ADC_WAVEFORM_SAWTOOTH = 3
+} HAL_ADC_Waveform_Type;
+
+typedef struct HAL_ADC_Waveform {
+    uint16_t size; // sizeof(HAL_ADC_Waveform)
+    uint8_t type; // See HAL_ADC_Waveform_Type
+    float frequency; // Hz
+    uint16_t amplitude; // Peak amplitude in ADC units
+    uint16_t offset; // DC level in ADC units
+    uint16_t noise; // Peak amplitude of the pseudo-random noise added to the waveform
+} HAL_ADC_Waveform;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sets the waveform produced by a pin. Passing NULL makes the pin read 0
+int HAL_ADC_Set_Waveform(pin_t pin, const HAL_ADC_Waveform* waveform, void* reserved);
+
+// Returns the sample of the pin's waveform with the given index, clamped to the 12-bit range
+uint16_t HAL_ADC_Waveform_Sample(pin_t pin, uint64_t index, uint32_t sample_rate);
+
+/*
+ * Enables or disables the pacing of the continuous sampler. When pacing is disabled, the halves
+ * of the buffer are produced as fast as the host allows, which is useful for benchmarking the
+ * processing of the samples. Pacing is enabled by default.
+ */
+void HAL_ADC_Sampler_Set_Paced(bool paced);
+
+#ifdef __cplusplus
+}
+#endif
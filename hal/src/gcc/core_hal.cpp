@@ -34,6 +34,7 @@
 #include "filesystem.h"
 #include "service_debug.h"
 #include "device_config.h"
+#include "fleet.h"
 #include "hal_platform.h"
 #include "interrupts_hal.h"
 #include <boost/crc.hpp>  // for boost::crc_32_type
@@ -136,6 +137,9 @@ extern "C" int main(int argc, char* argv[])
 {
     log_set_callbacks(log_message_callback, log_write_callback, log_enabled_callback, nullptr);
     if (read_device_config(argc, argv)) {
+        if (deviceConfig.is_fleet()) {
+            return run_fleet(deviceConfig.fleet);
+        }
     		// init the eeprom so that a file of size 0 can be used to trigger the save.
     		HAL_EEPROM_Init();
     		if (exists_file(eeprom_bin)) {
@@ -95,6 +95,10 @@ public:
             ("server_key,sk", po::value<string>(&config.server_key)->default_value("server_key.der"), "the filename containing the server public key")
             ("state,s", po::value<string>(&config.periph_directory)->default_value("state"), "the directory where device state and peripherals is stored")
 			("protocol,p", po::value<ProtocolFactory>(&config.protocol)->default_value(PROTOCOL_LIGHTSSL), "the cloud communication protocol to use")
+            ("fleet", po::value<string>(&config.fleet), "the file listing the devices to simulate in fleet mode")
+            ("fleet_threads", po::value<uint16_t>(&config.fleet_threads)->default_value(0), "the number of threads running the fleet (0 - one per CPU core)")
+            ("fleet_publish_period", po::value<uint32_t>(&config.fleet_publish_period)->default_value(0), "the period in milliseconds at which each device in the fleet publishes an event (0 - disabled)")
+            ("fleet_stats_period", po::value<uint32_t>(&config.fleet_stats_period)->default_value(5000), "the period in milliseconds at which the fleet statistics are reported")
 			;
 
         command_line_options.add(program_options).add(device_options);
@@ -188,15 +192,23 @@ bool read_device_config(int argc, char* argv[])
 
 void DeviceConfig::read(Configuration& configuration)
 {
+    fleet.device_file = configuration.fleet;
+    fleet.threads = configuration.fleet_threads;
+    fleet.publish_period = configuration.fleet_publish_period;
+    fleet.stats_period = configuration.fleet_stats_period;
+
 #ifndef SPARK_NO_CLOUD
-    size_t length = configuration.device_id.length();
-    if (length!=24) {
-        throw std::invalid_argument(std::string("expected device ID of length 24 from config ") + DEVICE_ID + ", got: '"+configuration.device_id+ "'");
-    }
+    // In fleet mode, the device IDs and keys are read from the fleet file instead
+    if (!is_fleet()) {
+        size_t length = configuration.device_id.length();
+        if (length!=24) {
+            throw std::invalid_argument(std::string("expected device ID of length 24 from config ") + DEVICE_ID + ", got: '"+configuration.device_id+ "'");
+        }
 
-    hex2bin(configuration.device_id, device_id, sizeof(device_id));
+        hex2bin(configuration.device_id, device_id, sizeof(device_id));
 
-    read_file(configuration.device_key.c_str(), device_key, sizeof(device_key));
+        read_file(configuration.device_key.c_str(), device_key, sizeof(device_key));
+    }
     read_file(configuration.server_key.c_str(), server_key, sizeof(server_key));
 #endif
 
@@ -53,6 +53,22 @@ struct Configuration
     std::string periph_directory;
     uint16_t log_level = 0;
     ProtocolFactory protocol = PROTOCOL_LIGHTSSL;
+    std::string fleet;
+    uint16_t fleet_threads = 0;
+    uint32_t fleet_publish_period = 0;
+    uint32_t fleet_stats_period = 5000;
+};
+
+
+/**
+ * Fleet mode configuration, see fleet.h
+ */
+struct FleetConfig
+{
+    std::string device_file;
+    unsigned threads;
+    uint32_t publish_period;
+    uint32_t stats_period;
 };
 
 
@@ -65,6 +81,7 @@ struct DeviceConfig
     uint8_t device_key[1024];
     uint8_t server_key[1024];
     ProtocolFactory protocol;
+    FleetConfig fleet;
 
     size_t hex2bin(const std::string& hex, uint8_t* dest, size_t destLen);
 
@@ -80,6 +97,8 @@ struct DeviceConfig
     }
 
     ProtocolFactory get_protocol() { return protocol; }
+
+    bool is_fleet() const { return !fleet.device_file.empty(); }
 };
 
 
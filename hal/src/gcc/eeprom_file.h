@@ -1,8 +1,19 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
+const size_t GCC_EEPROM_SIZE = 2048;
+
 void GCC_EEPROM_Load(const char* filename);
 
 void GCC_EEPROM_Save(const char* filename);
 
+/**
+ * Selects the EEPROM image used by the EEPROM HAL in the calling thread. If `image` is null, the
+ * process-wide image is used again. If `filename` is not null, the whole image is written to that
+ * file whenever it's modified.
+ */
+void GCC_EEPROM_Select(uint8_t* image, const char* filename);
 
@@ -29,17 +29,33 @@
  *
  */
 
-static uint8_t eeprom[2048];
+static uint8_t eeprom[GCC_EEPROM_SIZE];
 
 std::string eeprom_file;
 
+/*
+ * EEPROM image selected by the calling thread with GCC_EEPROM_Select(). Fleet mode uses this
+ * to give each simulated device its own EEPROM.
+ */
+static thread_local uint8_t* selected_image = nullptr;
+static thread_local const char* selected_file = nullptr;
+
+static uint8_t* eeprom_image()
+{
+	return selected_image ? selected_image : eeprom;
+}
+
 /**
  * Write the eeprom state to the file.
  * This currently writes the entire file.
  */
 void GCC_EEPROM_Flush()
 {
-	if (eeprom_file.length()) {
+	if (selected_image) {
+		if (selected_file) {
+			write_file(selected_file, selected_image, GCC_EEPROM_SIZE);
+		}
+	} else if (eeprom_file.length()) {
 		GCC_EEPROM_Save(eeprom_file.c_str());
 	}
 }
@@ -51,7 +67,7 @@ void GCC_EEPROM_Flush()
  */
 void HAL_EEPROM_Init()
 {
-	if (!eeprom_file.length())
+	if (selected_image ? !selected_file : !eeprom_file.length())
 		HAL_EEPROM_Clear();
 }
 
@@ -69,23 +85,23 @@ void HAL_EEPROM_Write(uint32_t index, uint8_t data)
 
 void HAL_EEPROM_Get(uint32_t index, void *data, size_t length)
 {
-	memcpy(data, eeprom+index, length);
+	memcpy(data, eeprom_image()+index, length);
 }
 
 void HAL_EEPROM_Put(uint32_t index, const void *data, size_t length)
 {
-	memcpy(eeprom+index, data, length);
+	memcpy(eeprom_image()+index, data, length);
 	GCC_EEPROM_Flush();
 }
 
 size_t HAL_EEPROM_Length()
 {
-	return sizeof(eeprom);
+	return GCC_EEPROM_SIZE;
 }
 
 void HAL_EEPROM_Clear()
 {
-	memset(eeprom, 0xFF, sizeof(eeprom));
+	memset(eeprom_image(), 0xFF, GCC_EEPROM_SIZE);
 	GCC_EEPROM_Flush();
 }
 
@@ -109,4 +125,8 @@ void GCC_EEPROM_Save(const char* filename)
 	write_file(filename, eeprom, sizeof(eeprom));
 }
 
-
+void GCC_EEPROM_Select(uint8_t* image, const char* filename)
+{
+	selected_image = image;
+	selected_file = image ? filename : nullptr;
+}
@@ -0,0 +1,742 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fleet.h"
+
+#include <iostream>
+
+// The asio-based socket HAL can't be used from multiple threads concurrently, so fleet mode is
+// only available with the epoll-based one
+#if defined(HAL_GCC_SOCKET_HAL_EPOLL) && HAL_GCC_SOCKET_HAL_EPOLL
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "socket_hal.h"
+#include "socket_hal_epoll.h"
+#include "inet_hal.h"
+#include "ota_flash_hal.h"
+#include "timer_hal.h"
+#include "core_hal.h"
+#include "eeprom_file.h"
+#include "filesystem.h"
+#include "spark_protocol_functions.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <malloc.h>
+
+// Defined in communication_dynalib.cpp
+ProtocolFacade* create_protocol(ProtocolFactory factory);
+
+namespace {
+
+const size_t PRIVATE_KEY_SIZE = 612; // See HAL_FLASH_Read_CorePrivateKey()
+const uint16_t DEFAULT_SERVER_PORT = 5683;
+
+// Timeout for the socket reads while a handshake is in progress. The protocol implementation
+// polls the socket in a loop until a complete handshake message is received
+const system_tick_t HANDSHAKE_RECEIVE_TIMEOUT = 10;
+
+// Timeout for the first read after the worker has been notified that the socket is readable. The
+// socket HAL tracks the readiness of the socket in its own thread, which may not have seen the
+// data yet
+const system_tick_t READY_RECEIVE_TIMEOUT = 10;
+
+// Interval at which the protocol of an idle device is processed, so that its timers (keepalive
+// pings, acknowledgement timeouts) keep running
+const system_tick_t PROTOCOL_TICK = 1000;
+
+const system_tick_t RECONNECT_DELAY = 1000;
+const system_tick_t MAX_RECONNECT_DELAY = 30000;
+
+// Maximum number of events processed by a worker in one iteration
+const size_t MAX_EVENTS = 64;
+
+struct FleetStats {
+    std::atomic<unsigned> connected;
+    std::atomic<unsigned> handshakes;
+    std::atomic<unsigned> handshakeErrors;
+    std::atomic<unsigned> publishes;
+    std::atomic<unsigned> disconnects;
+};
+
+FleetStats stats;
+
+sockaddr_t serverAddr;
+
+inline bool isDue(system_tick_t now, system_tick_t time) {
+    return (int32_t)(now - time) >= 0;
+}
+
+const uint8_t* serverKey() {
+    return deviceConfig.server_key;
+}
+
+// Descriptor callbacks: simulated devices don't have any functions, variables or subscriptions
+int numFunctions() {
+    return 0;
+}
+
+const char* getFunctionKey(int index) {
+    return nullptr;
+}
+
+int callFunction(const char* key, const char* arg, SparkDescriptor::FunctionResultCallback callback, void* reserved) {
+    return -1;
+}
+
+int numVariables() {
+    return 0;
+}
+
+const char* getVariableKey(int index) {
+    return nullptr;
+}
+
+SparkReturnType::Enum variableType(const char* key) {
+    return SparkReturnType::INT;
+}
+
+const void* getVariable(const char* key) {
+    return nullptr;
+}
+
+bool otaUpgradeSuccessful() {
+    return false;
+}
+
+void otaUpgradeStatusSent() {
+}
+
+bool appendSystemInfo(appender_fn appender, void* append, void* reserved) {
+    return true;
+}
+
+bool appendMetrics(appender_fn appender, void* append, uint32_t flags, uint32_t page, void* reserved) {
+    return true;
+}
+
+void callEventHandler(uint16_t size, FilteringEventHandler* handler, const char* event, const char* data, void* reserved) {
+}
+
+uint32_t appStateSelectorInfo(SparkAppStateSelector::Enum selector, SparkAppStateUpdate::Enum operation, uint32_t data, void* reserved) {
+    return 0;
+}
+
+// Protocol callbacks that don't depend on the device
+int prepareForFirmwareUpdate(FileTransfer::Descriptor& data, uint32_t flags, void* reserved) {
+    return 1; // Firmware updates are not supported
+}
+
+int saveFirmwareChunk(FileTransfer::Descriptor& descriptor, const unsigned char* chunk, void* reserved) {
+    return 1;
+}
+
+int finishFirmwareUpdate(FileTransfer::Descriptor& data, uint32_t flags, void* reserved) {
+    return 1;
+}
+
+void signalCallback(bool on, unsigned param, void* reserved) {
+}
+
+void setTimeCallback(time_t t, unsigned param, void* reserved) {
+}
+
+class FleetWorker;
+
+// Selects the EEPROM image of a device in the calling thread for the lifetime of this object
+class EepromScope {
+public:
+    EepromScope(uint8_t* image, const std::string& fileName) {
+        GCC_EEPROM_Select(image, fileName.empty() ? nullptr : fileName.c_str());
+    }
+
+    ~EepromScope() {
+        GCC_EEPROM_Select(nullptr, nullptr);
+    }
+};
+
+/*
+ * Simulated device. The state of a device is only accessed by the worker owning it, except while
+ * a handshake is in progress: the device is then handed over to a handshake thread, and the worker
+ * doesn't touch it until the handshake thread hands it back.
+ */
+class FleetDevice {
+public:
+    enum State {
+        DISCONNECTED,
+        HANDSHAKE,
+        CONNECTED
+    };
+
+    FleetDevice() :
+            worker_(nullptr),
+            protocol_(nullptr),
+            sock_(socket_handle_invalid()),
+            state_(DISCONNECTED),
+            nextConnect_(0),
+            nextPublish_(0),
+            nextTick_(0),
+            connectAttempts_(0),
+            handshake_(false),
+            readable_(false) {
+        memset(id_, 0, sizeof(id_));
+        memset(privateKey_, 0xff, sizeof(privateKey_));
+        memset(eeprom_, 0xff, sizeof(eeprom_));
+    }
+
+    bool init(const std::string& id, const std::string& keyFile, const std::string& eepromFile) {
+        if (id.length() != sizeof(id_) * 2) {
+            std::cerr << "invalid device ID: " << id << std::endl;
+            return false;
+        }
+        deviceConfig.hex2bin(id, id_, sizeof(id_));
+        try {
+            read_file(keyFile.c_str(), privateKey_, sizeof(privateKey_));
+            if (!eepromFile.empty()) {
+                read_file(eepromFile.c_str(), eeprom_, sizeof(eeprom_));
+                eepromFile_ = eepromFile;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return false;
+        }
+        protocol_ = create_protocol(PROTOCOL_LIGHTSSL);
+        if (!protocol_) {
+            return false;
+        }
+
+        SparkCallbacks callbacks = {};
+        callbacks.size = sizeof(callbacks);
+        callbacks.protocolFactory = PROTOCOL_LIGHTSSL;
+        callbacks.send = send;
+        callbacks.receive = receive;
+        callbacks.transport_context = this;
+        callbacks.prepare_for_firmware_update = prepareForFirmwareUpdate;
+        callbacks.save_firmware_chunk = saveFirmwareChunk;
+        callbacks.finish_firmware_update = finishFirmwareUpdate;
+        callbacks.calculate_crc = HAL_Core_Compute_CRC32;
+        callbacks.signal = signalCallback;
+        callbacks.millis = HAL_Timer_Get_Milli_Seconds;
+        callbacks.set_time = setTimeCallback;
+
+        SparkDescriptor descriptor = {};
+        descriptor.size = sizeof(descriptor);
+        descriptor.num_functions = numFunctions;
+        descriptor.get_function_key = getFunctionKey;
+        descriptor.call_function = callFunction;
+        descriptor.num_variables = numVariables;
+        descriptor.get_variable_key = getVariableKey;
+        descriptor.variable_type = variableType;
+        descriptor.get_variable = getVariable;
+        descriptor.was_ota_upgrade_successful = otaUpgradeSuccessful;
+        descriptor.ota_upgrade_status_sent = otaUpgradeStatusSent;
+        descriptor.append_system_info = appendSystemInfo;
+        descriptor.append_metrics = appendMetrics;
+        descriptor.call_event_handler = callEventHandler;
+        descriptor.app_state_selector_info = appStateSelectorInfo;
+
+        SparkKeys keys = {};
+        keys.size = sizeof(keys);
+        keys.core_private = privateKey_;
+        keys.server_public = const_cast<uint8_t*>(serverKey());
+
+        const EepromScope eeprom(eeprom_, eepromFile_);
+        spark_protocol_init(protocol_, (const char*)id_, keys, callbacks, descriptor);
+        return true;
+    }
+
+    // Connects to the server and performs the handshake. Called from a handshake thread
+    bool handshake() {
+        sock_ = socket_create(AF_INET, SOCK_STREAM, IPPROTO_TCP, 0, 0);
+        if (!socket_handle_valid(sock_) || socket_connect(sock_, &serverAddr, sizeof(serverAddr)) != 0) {
+            return false;
+        }
+        const EepromScope eeprom(eeprom_, eepromFile_);
+        handshake_ = true;
+        const int ret = spark_protocol_handshake(protocol_);
+        handshake_ = false;
+        return ret == 0;
+    }
+
+    // Completes the connection after the device has been handed back by the handshake thread
+    void connected(system_tick_t now) {
+        ++stats.handshakes;
+        ++stats.connected;
+        state_ = CONNECTED;
+        connectAttempts_ = 0;
+        nextPublish_ = now;
+        nextTick_ = now;
+    }
+
+    // Processes the protocol and publishes an event if it's due. Returns false if the device got
+    // disconnected
+    bool process(system_tick_t now, system_tick_t publishPeriod) {
+        nextTick_ = now + PROTOCOL_TICK;
+        const EepromScope eeprom(eeprom_, eepromFile_);
+        if (!spark_protocol_event_loop(protocol_)) {
+            disconnect(now);
+            return false;
+        }
+        if (publishPeriod && isDue(now, nextPublish_)) {
+            nextPublish_ = now + publishPeriod;
+            if (spark_protocol_send_event(protocol_, "fleet", nullptr, 60, EventType::PRIVATE | EventType::NO_ACK, nullptr)) {
+                ++stats.publishes;
+            }
+        }
+        return true;
+    }
+
+    void disconnect(system_tick_t now) {
+        if (socket_handle_valid(sock_)) {
+            socket_close(sock_);
+            sock_ = socket_handle_invalid();
+        }
+        if (state_ == CONNECTED) {
+            --stats.connected;
+            ++stats.disconnects;
+        }
+        state_ = DISCONNECTED;
+        // Back off linearly, up to MAX_RECONNECT_DELAY
+        if (connectAttempts_ * RECONNECT_DELAY < MAX_RECONNECT_DELAY) {
+            ++connectAttempts_;
+        }
+        nextConnect_ = now + connectAttempts_ * RECONNECT_DELAY;
+    }
+
+    // Time at which the device needs to be processed by the worker next
+    system_tick_t deadline(system_tick_t publishPeriod) const {
+        if (state_ == DISCONNECTED) {
+            return nextConnect_;
+        }
+        if (publishPeriod && isDue(nextTick_, nextPublish_)) {
+            return nextPublish_;
+        }
+        return nextTick_;
+    }
+
+    bool needsProcessing(system_tick_t now, system_tick_t publishPeriod) const {
+        return state_ != HANDSHAKE && isDue(now, deadline(publishPeriod));
+    }
+
+    void setHandshake() {
+        state_ = HANDSHAKE;
+    }
+
+    void setReadable() {
+        readable_ = true;
+    }
+
+    State state() const {
+        return state_;
+    }
+
+    int fd() const {
+        return socket_native_fd(sock_);
+    }
+
+    FleetWorker* worker() const {
+        return worker_;
+    }
+
+    void worker(FleetWorker* worker) {
+        worker_ = worker;
+    }
+
+private:
+    uint8_t id_[12];
+    uint8_t privateKey_[PRIVATE_KEY_SIZE];
+    uint8_t eeprom_[GCC_EEPROM_SIZE];
+    std::string eepromFile_;
+    FleetWorker* worker_;
+    ProtocolFacade* protocol_;
+    sock_handle_t sock_;
+    State state_;
+    system_tick_t nextConnect_;
+    system_tick_t nextPublish_;
+    system_tick_t nextTick_;
+    unsigned connectAttempts_;
+    bool handshake_;
+    bool readable_;
+
+    static int send(const unsigned char* buf, uint32_t buflen, void* ctx) {
+        const auto d = static_cast<FleetDevice*>(ctx);
+        return socket_send(d->sock_, buf, buflen);
+    }
+
+    static int receive(unsigned char* buf, uint32_t buflen, void* ctx) {
+        const auto d = static_cast<FleetDevice*>(ctx);
+        system_tick_t timeout = 0;
+        if (d->handshake_) {
+            timeout = HANDSHAKE_RECEIVE_TIMEOUT;
+        } else if (d->readable_) {
+            timeout = READY_RECEIVE_TIMEOUT;
+            d->readable_ = false;
+        }
+        return socket_receive(d->sock_, buf, buflen, timeout);
+    }
+};
+
+/*
+ * Pool of threads performing the handshakes. A handshake blocks until the server responds and is
+ * CPU-intensive, so it's performed outside of the workers to keep the other devices of the shard
+ * responsive.
+ */
+class HandshakePool {
+public:
+    void start(unsigned threads) {
+        for (unsigned i = 0; i < threads; ++i) {
+            std::thread([this]() { run(); }).detach();
+        }
+    }
+
+    void push(FleetDevice* d) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(d);
+        }
+        cond_.notify_one();
+    }
+
+private:
+    std::deque<FleetDevice*> queue_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    void run();
+};
+
+/*
+ * Worker thread running the devices of one shard. The worker sleeps in epoll_wait() until one of
+ * the connected devices has data to read, a handshake is completed or a timer of one of the
+ * devices expires.
+ */
+class FleetWorker {
+public:
+    FleetWorker(HandshakePool* handshakes, system_tick_t publishPeriod) :
+            handshakes_(handshakes),
+            publishPeriod_(publishPeriod),
+            epfd_(-1),
+            eventFd_(-1),
+            nextTimer_(0) {
+    }
+
+    ~FleetWorker() {
+        if (eventFd_ >= 0) {
+            close(eventFd_);
+        }
+        if (epfd_ >= 0) {
+            close(epfd_);
+        }
+    }
+
+    bool init() {
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        eventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epfd_ < 0 || eventFd_ < 0) {
+            return false;
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr; // Handshake completion
+        return epoll_ctl(epfd_, EPOLL_CTL_ADD, eventFd_, &ev) == 0;
+    }
+
+    void add(FleetDevice* d) {
+        d->worker(this);
+        devices_.push_back(d);
+    }
+
+    // Hands a device back to the worker after a handshake. Called from a handshake thread
+    void handshakeDone(FleetDevice* d, bool ok) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.push_back(std::make_pair(d, ok));
+        }
+        const uint64_t one = 1;
+        if (write(eventFd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            std::cerr << "unable to notify the worker: " << errno << std::endl;
+        }
+    }
+
+    void run() {
+        epoll_event events[MAX_EVENTS];
+        nextTimer_ = HAL_Timer_Get_Milli_Seconds();
+        for (;;) {
+            system_tick_t now = HAL_Timer_Get_Milli_Seconds();
+            const int timeout = isDue(now, nextTimer_) ? 0 : (int)(nextTimer_ - now);
+            const int n = epoll_wait(epfd_, events, MAX_EVENTS, timeout);
+            if (n < 0 && errno != EINTR) {
+                std::cerr << "epoll_wait() failed: " << errno << std::endl;
+                return;
+            }
+            now = HAL_Timer_Get_Milli_Seconds();
+            for (int i = 0; i < n; ++i) {
+                const auto d = static_cast<FleetDevice*>(events[i].data.ptr);
+                if (!d) {
+                    completeHandshakes(now);
+                } else if (d->state() == FleetDevice::CONNECTED) {
+                    d->setReadable();
+                    process(d, now);
+                }
+            }
+            if (isDue(now, nextTimer_)) {
+                runTimers(now);
+            }
+        }
+    }
+
+private:
+    HandshakePool* handshakes_;
+    system_tick_t publishPeriod_;
+    std::vector<FleetDevice*> devices_;
+    std::vector<std::pair<FleetDevice*, bool>> done_;
+    std::mutex mutex_;
+    int epfd_;
+    int eventFd_;
+    system_tick_t nextTimer_;
+
+    void process(FleetDevice* d, system_tick_t now) {
+        // If the device gets disconnected, closing the socket also removes it from the epoll set
+        d->process(now, publishPeriod_);
+        schedule(d);
+    }
+
+    void completeHandshakes(system_tick_t now) {
+        uint64_t count = 0;
+        if (read(eventFd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+            std::cerr << "unable to read the worker's event: " << errno << std::endl;
+        }
+        std::vector<std::pair<FleetDevice*, bool>> done;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done.swap(done_);
+        }
+        for (const auto& p: done) {
+            FleetDevice* const d = p.first;
+            if (p.second) {
+                epoll_event ev = {};
+                ev.events = EPOLLIN | EPOLLRDHUP;
+                ev.data.ptr = d;
+                if (epoll_ctl(epfd_, EPOLL_CTL_ADD, d->fd(), &ev) == 0) {
+                    d->connected(now);
+                } else {
+                    ++stats.handshakeErrors;
+                    d->disconnect(now);
+                }
+            } else {
+                ++stats.handshakeErrors;
+                d->disconnect(now);
+            }
+            schedule(d);
+        }
+    }
+
+    void runTimers(system_tick_t now) {
+        nextTimer_ = now + PROTOCOL_TICK;
+        for (FleetDevice* d: devices_) {
+            if (d->needsProcessing(now, publishPeriod_)) {
+                if (d->state() == FleetDevice::DISCONNECTED) {
+                    d->setHandshake();
+                    handshakes_->push(d);
+                    continue;
+                }
+                process(d, now);
+            }
+            if (d->state() != FleetDevice::HANDSHAKE) {
+                schedule(d);
+            }
+        }
+    }
+
+    void schedule(FleetDevice* d) {
+        const system_tick_t t = d->deadline(publishPeriod_);
+        if ((int32_t)(t - nextTimer_) < 0) {
+            nextTimer_ = t;
+        }
+    }
+};
+
+void HandshakePool::run() {
+    for (;;) {
+        FleetDevice* d = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this]() { return !queue_.empty(); });
+            d = queue_.front();
+            queue_.pop_front();
+        }
+        const bool ok = d->handshake();
+        d->worker()->handshakeDone(d, ok);
+    }
+}
+
+// Reads the device list. Each line contains a device ID, the name of the file with the device's
+// private key and, optionally, the name of the device's EEPROM file
+bool loadDevices(const std::string& fileName, std::vector<std::unique_ptr<FleetDevice>>& devices) {
+    std::ifstream in(fileName.c_str());
+    if (!in) {
+        std::cerr << "unable to read file '" << fileName << "'" << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream s(line);
+        std::string id, keyFile, eepromFile;
+        if (!(s >> id) || id[0] == '#') {
+            continue;
+        }
+        if (!(s >> keyFile)) {
+            std::cerr << "missing key file for device " << id << std::endl;
+            return false;
+        }
+        s >> eepromFile;
+        std::unique_ptr<FleetDevice> d(new(std::nothrow) FleetDevice);
+        if (!d || !d->init(id, keyFile, eepromFile)) {
+            return false;
+        }
+        devices.push_back(std::move(d));
+    }
+    return true;
+}
+
+bool resolveServerAddress() {
+    ServerAddress addr = {};
+    HAL_FLASH_Read_ServerAddress(&addr);
+    HAL_IPAddress ip = {};
+    if (addr.addr_type == IP_ADDRESS) {
+        ip.ipv4 = addr.ip;
+    } else if (addr.addr_type == DOMAIN_NAME) {
+        if (inet_gethostbyname(addr.domain, strlen(addr.domain), &ip, 0, nullptr) != 0) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    const uint16_t port = addr.port ? addr.port : DEFAULT_SERVER_PORT;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sa_family = AF_INET;
+    serverAddr.sa_data[0] = (port >> 8) & 0xff;
+    serverAddr.sa_data[1] = port & 0xff;
+    serverAddr.sa_data[2] = (ip.ipv4 >> 24) & 0xff;
+    serverAddr.sa_data[3] = (ip.ipv4 >> 16) & 0xff;
+    serverAddr.sa_data[4] = (ip.ipv4 >> 8) & 0xff;
+    serverAddr.sa_data[5] = ip.ipv4 & 0xff;
+    return true;
+}
+
+size_t heapUsed() {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    return (unsigned)mallinfo().uordblks;
+#pragma GCC diagnostic pop
+}
+
+} // namespace
+
+int run_fleet(const FleetConfig& config)
+{
+    if (deviceConfig.get_protocol() != PROTOCOL_LIGHTSSL) {
+        // DTLS session persistence in the communication library is global to the process
+        std::cerr << "fleet mode only supports the tcp protocol" << std::endl;
+        return -1;
+    }
+    if (!resolveServerAddress()) {
+        std::cerr << "unable to resolve the server address" << std::endl;
+        return -1;
+    }
+    const size_t heapBase = heapUsed();
+    std::vector<std::unique_ptr<FleetDevice>> devices;
+    if (!loadDevices(config.device_file, devices) || devices.empty()) {
+        std::cerr << "unable to load the fleet from '" << config.device_file << "'" << std::endl;
+        return -1;
+    }
+    unsigned threads = config.threads;
+    if (!threads) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    if (threads > devices.size()) {
+        threads = devices.size();
+    }
+    // Workers and handshake threads are never stopped, as this function doesn't return
+    HandshakePool* const handshakes = new HandshakePool;
+    std::vector<FleetWorker*> workers;
+    for (unsigned i = 0; i < threads; ++i) {
+        std::unique_ptr<FleetWorker> w(new FleetWorker(handshakes, config.publish_period));
+        if (!w->init()) {
+            std::cerr << "unable to create a worker: " << errno << std::endl;
+            return -1;
+        }
+        workers.push_back(w.release());
+    }
+    for (size_t i = 0; i < devices.size(); ++i) {
+        workers[i % threads]->add(devices[i].get());
+    }
+    handshakes->start(threads);
+    for (FleetWorker* w: workers) {
+        std::thread([w]() { w->run(); }).detach();
+    }
+    std::cout << "fleet started: " << devices.size() << " devices, " << threads << " threads" << std::endl;
+
+    const system_tick_t period = config.stats_period ? config.stats_period : 5000;
+    unsigned handshakeCount = 0;
+    unsigned publishes = 0;
+    system_tick_t t = HAL_Timer_Get_Milli_Seconds();
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(period));
+        const system_tick_t now = HAL_Timer_Get_Milli_Seconds();
+        const double secs = (now - t) / 1000.0;
+        const unsigned h = stats.handshakes;
+        const unsigned p = stats.publishes;
+        const size_t heap = heapUsed();
+        std::cout << "devices: " << devices.size()
+                << ", connected: " << stats.connected
+                << ", handshakes/s: " << (h - handshakeCount) / secs
+                << ", publishes/s: " << (p - publishes) / secs
+                << ", handshake errors: " << stats.handshakeErrors
+                << ", disconnects: " << stats.disconnects
+                << ", memory/device: " << (heap > heapBase ? heap - heapBase : 0) / devices.size() << " bytes"
+                << std::endl;
+        handshakeCount = h;
+        publishes = p;
+        t = now;
+    }
+    return 0;
+}
+
+#else // !HAL_GCC_SOCKET_HAL_EPOLL
+
+int run_fleet(const FleetConfig& config)
+{
+    std::cerr << "fleet mode requires the epoll-based socket HAL (VIRTUAL_DEVICE_SOCKET_HAL=epoll)" << std::endl;
+    return -1;
+}
+
+#endif // HAL_GCC_SOCKET_HAL_EPOLL
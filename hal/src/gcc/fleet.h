@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "device_config.h"
+
+/**
+ * Runs a fleet of simulated devices in this process.
+ *
+ * Each device has its own ID, keys, EEPROM image, cloud connection and protocol instance. The
+ * devices are distributed among a pool of threads, each running an epoll-driven event loop for its
+ * share of the devices, while the handshakes are performed by a separate pool of threads. Aggregate
+ * statistics are periodically written to the standard output.
+ *
+ * This function only returns if the fleet cannot be started. Fleet mode requires the epoll-based
+ * socket HAL.
+ *
+ * @param config The fleet configuration.
+ * @return 0 on success, or a negative value in case of an error.
+ */
+int run_fleet(const FleetConfig& config);
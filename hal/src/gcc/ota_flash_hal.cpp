@@ -58,6 +58,12 @@ int HAL_FLASH_OTA_Validate(hal_module_t* mod, bool userDepsOptional, module_vali
      return HAL_UPDATE_APPLIED;
 }
 
+int HAL_FLASH_OTA_Set_Image_Digest(const hal_ota_image_digest_t* digest, void* reserved)
+{
+    // The image is not read back during validation, so there's nothing to skip
+    return 0;
+}
+
 
 
 /**
@@ -49,6 +49,10 @@ const sock_handle_t SOCKET_MAX =  SOCKET_COUNT*2;
 const sock_handle_t SOCKET_INVALID = (sock_handle_t)-1;
 
 boost::asio::io_service device_io_service;
+
+// The epoll-based implementation is in socket_hal_epoll.cpp
+#if !defined(HAL_GCC_SOCKET_HAL_EPOLL) || !HAL_GCC_SOCKET_HAL_EPOLL
+
 boost::system::error_code ec;
 
 boost::array<ip::tcp::socket, SOCKET_COUNT> tcp_handles = {
@@ -518,3 +522,5 @@ sock_result_t socket_peer(sock_handle_t sd, sock_peer_t* peer, void* reserved)
 {
     return -1;
 }
+
+#endif // !defined(HAL_GCC_SOCKET_HAL_EPOLL) || !HAL_GCC_SOCKET_HAL_EPOLL
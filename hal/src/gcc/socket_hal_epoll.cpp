@@ -0,0 +1,690 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Socket HAL for the virtual device based on non-blocking POSIX sockets and epoll (Linux only).
+ *
+ * Unlike the asio-based implementation, which is limited to a fixed number of sockets and makes
+ * a system call every time a socket is polled, this implementation keeps a dynamically growing
+ * handle table and a dedicated thread that tracks readiness of all sockets via a single epoll
+ * instance. Polling an idle socket from the system loop doesn't involve any system calls, and
+ * blocking calls sleep until the socket becomes ready instead of spinning.
+ *
+ * Enabled with VIRTUAL_DEVICE_SOCKET_HAL=epoll, see readme.md
+ */
+
+#if defined(HAL_GCC_SOCKET_HAL_EPOLL) && HAL_GCC_SOCKET_HAL_EPOLL
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+
+// Avoid defining sockaddr twice
+#define HAL_SOCKET_HAL_COMPAT_NO_SOCKADDR (1)
+#include "socket_hal.h"
+#include "socket_hal_epoll.h"
+#include "inet_hal.h"
+#include "timer_hal.h"
+#include "core_msg.h"
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+
+namespace {
+
+const sock_handle_t SOCKET_INVALID = (sock_handle_t)-1;
+
+// Handle table is grown in chunks, up to CHUNK_COUNT * CHUNK_SIZE sockets
+const size_t CHUNK_SIZE = 64;
+const size_t CHUNK_COUNT = 256;
+
+// Maximum number of events processed by the poller thread in one iteration
+const size_t MAX_EVENTS = 64;
+
+const system_tick_t CONNECT_TIMEOUT = 20000;
+const system_tick_t WAIT_FOREVER = (system_tick_t)-1;
+
+enum class SocketType {
+    TCP,
+    UDP,
+    SERVER
+};
+
+// Readiness flags
+enum SocketEvent: unsigned {
+    EVENT_READABLE = 0x01,
+    EVENT_WRITABLE = 0x02,
+    EVENT_HANGUP = 0x04, // Peer has closed the connection, unread data may still be available
+    EVENT_ERROR = 0x08,
+    EVENT_END_OF_STREAM = 0x10 // End of stream has been received by the application
+};
+
+struct Socket {
+    std::atomic<int> fd;
+    std::atomic<unsigned> events;
+    SocketType type;
+    sock_handle_t nextFree;
+    uint32_t generation; // Incremented every time the entry is reused for a new socket
+
+    Socket() :
+            fd(-1),
+            events(0),
+            type(SocketType::TCP),
+            nextFree(SOCKET_INVALID),
+            generation(0) {
+    }
+};
+
+/*
+ * Table of open sockets. Allocation and deallocation take O(1) time via a free list, lookups
+ * are lock-free: chunks are never deallocated, so a pointer to an entry stays valid for the
+ * lifetime of the process.
+ */
+class SocketTable {
+public:
+    SocketTable() :
+            chunks_(),
+            size_(0),
+            freeHead_(SOCKET_INVALID) {
+    }
+
+    sock_handle_t alloc(int fd, SocketType type) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sock_handle_t handle = freeHead_;
+        Socket* s = nullptr;
+        if (handle != SOCKET_INVALID) {
+            s = entry(handle);
+            freeHead_ = s->nextFree;
+        } else {
+            if (size_ == CHUNK_COUNT * CHUNK_SIZE) {
+                return SOCKET_INVALID;
+            }
+            handle = size_;
+            const size_t chunk = handle / CHUNK_SIZE;
+            if (!chunks_[chunk].load(std::memory_order_relaxed)) {
+                const auto p = new(std::nothrow) Socket[CHUNK_SIZE];
+                if (!p) {
+                    return SOCKET_INVALID;
+                }
+                chunks_[chunk].store(p, std::memory_order_release);
+            }
+            ++size_;
+            s = entry(handle);
+        }
+        s->type = type;
+        ++s->generation;
+        s->events.store(0, std::memory_order_relaxed);
+        s->fd.store(fd, std::memory_order_release);
+        return handle;
+    }
+
+    void free(sock_handle_t handle) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Socket* const s = entry(handle);
+        s->fd.store(-1, std::memory_order_release);
+        s->nextFree = freeHead_;
+        freeHead_ = handle;
+    }
+
+    // Returns the entry for an open socket, or nullptr if the handle is not valid
+    Socket* get(sock_handle_t handle) const {
+        if (handle >= CHUNK_COUNT * CHUNK_SIZE) {
+            return nullptr;
+        }
+        Socket* const chunk = chunks_[handle / CHUNK_SIZE].load(std::memory_order_acquire);
+        if (!chunk) {
+            return nullptr;
+        }
+        Socket* const s = chunk + handle % CHUNK_SIZE;
+        if (s->fd.load(std::memory_order_acquire) < 0) {
+            return nullptr;
+        }
+        return s;
+    }
+
+    // Same as above, but also checks the generation of the entry. Must be called with the table
+    // locked, see mutex()
+    Socket* get(sock_handle_t handle, uint32_t generation) const {
+        Socket* const s = get(handle);
+        if (!s || s->generation != generation) {
+            return nullptr;
+        }
+        return s;
+    }
+
+    // Locking the table prevents sockets from being allocated or freed
+    std::mutex& mutex() {
+        return mutex_;
+    }
+
+private:
+    std::atomic<Socket*> chunks_[CHUNK_COUNT];
+    size_t size_;
+    sock_handle_t freeHead_;
+    std::mutex mutex_;
+
+    Socket* entry(sock_handle_t handle) const {
+        return chunks_[handle / CHUNK_SIZE].load(std::memory_order_relaxed) + handle % CHUNK_SIZE;
+    }
+};
+
+SocketTable sockets;
+
+/*
+ * Poller thread. Sockets are registered in edge-triggered mode, so the thread only wakes up when
+ * the state of a socket changes, and records the change in the socket's readiness flags.
+ */
+class Poller {
+public:
+    Poller() :
+            epfd_(-1),
+            waiters_(0) {
+    }
+
+    bool add(sock_handle_t handle, uint32_t generation, int fd) {
+        std::call_once(init_, [this]() {
+            epfd_ = epoll_create1(EPOLL_CLOEXEC);
+            if (epfd_ >= 0) {
+                std::thread([this]() { run(); }).detach();
+            }
+        });
+        if (epfd_ < 0) {
+            return false;
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        // The generation allows to discard stale events reported for a closed socket after its
+        // handle has been reused
+        ev.data.u64 = ((uint64_t)generation << 32) | handle;
+        return epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) == 0;
+    }
+
+    void remove(int fd) {
+        if (epfd_ >= 0) {
+            epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+        }
+    }
+
+    // Waits until any of the specified flags, or an error, is set for the socket
+    bool wait(Socket* s, unsigned flags, system_tick_t timeout) {
+        flags |= EVENT_HANGUP | EVENT_ERROR;
+        if (s->events.load() & flags) {
+            return true;
+        }
+        const auto ready = [s, flags]() {
+            return s->events.load() & flags;
+        };
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++waiters_;
+        bool ok = true;
+        if (timeout == WAIT_FOREVER) {
+            cond_.wait(lock, ready);
+        } else {
+            ok = cond_.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+        }
+        --waiters_;
+        return ok;
+    }
+
+private:
+    int epfd_;
+    unsigned waiters_;
+    std::once_flag init_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    void run() {
+        epoll_event events[MAX_EVENTS];
+        for (;;) {
+            const int n = epoll_wait(epfd_, events, MAX_EVENTS, -1);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                DEBUG("epoll_wait() failed: %d", errno);
+                break;
+            }
+            std::unique_lock<std::mutex> tableLock(sockets.mutex());
+            for (int i = 0; i < n; ++i) {
+                const uint64_t data = events[i].data.u64;
+                Socket* const s = sockets.get((sock_handle_t)(data & 0xffffffff), (uint32_t)(data >> 32));
+                if (!s) {
+                    continue; // Closed in the meantime
+                }
+                const uint32_t ev = events[i].events;
+                unsigned flags = 0;
+                if (ev & EPOLLIN) {
+                    flags |= EVENT_READABLE;
+                }
+                if (ev & EPOLLOUT) {
+                    flags |= EVENT_WRITABLE;
+                }
+                if (ev & (EPOLLRDHUP | EPOLLHUP)) {
+                    flags |= EVENT_HANGUP | EVENT_READABLE;
+                }
+                if (ev & EPOLLERR) {
+                    flags |= EVENT_ERROR;
+                }
+                s->events.fetch_or(flags);
+            }
+            tableLock.unlock();
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (waiters_) {
+                cond_.notify_all();
+            }
+        }
+    }
+};
+
+Poller poller;
+
+Socket* socket_from(sock_handle_t sd, SocketType type) {
+    Socket* const s = sockets.get(sd);
+    if (!s || s->type != type) {
+        return nullptr;
+    }
+    return s;
+}
+
+sock_handle_t add_socket(int fd, SocketType type) {
+    const sock_handle_t handle = sockets.alloc(fd, type);
+    if (handle == SOCKET_INVALID) {
+        close(fd);
+        return SOCKET_INVALID;
+    }
+    return handle;
+}
+
+bool register_socket(sock_handle_t handle, int fd) {
+    Socket* const s = sockets.get(handle);
+    if (!s || !poller.add(handle, s->generation, fd)) {
+        DEBUG("Unable to register socket: %d", errno);
+        return false;
+    }
+    return true;
+}
+
+void to_sockaddr_in(const sockaddr_t* addr, sockaddr_in* in) {
+    memset(in, 0, sizeof(sockaddr_in));
+    in->sin_family = AF_INET;
+    // 0-1 are the port number, 2-5 are IP address in network byte order
+    memcpy(&in->sin_port, addr->sa_data, 2);
+    memcpy(&in->sin_addr.s_addr, addr->sa_data + 2, 4);
+}
+
+void from_sockaddr_in(const sockaddr_in* in, sockaddr_t* addr) {
+    addr->sa_family = AF_INET;
+    memcpy(addr->sa_data, &in->sin_port, 2);
+    memcpy(addr->sa_data + 2, &in->sin_addr.s_addr, 4);
+}
+
+inline sock_result_t error_result() {
+    return -abs(errno);
+}
+
+} // namespace
+
+sock_handle_t socket_create(uint8_t family, uint8_t type, uint8_t protocol, uint16_t port, network_interface_t nif)
+{
+    const bool udp = (protocol == IPPROTO_UDP);
+    const int fd = socket(AF_INET, (udp ? SOCK_DGRAM : SOCK_STREAM) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return SOCKET_INVALID;
+    }
+    if (udp) {
+        const int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(fd, (const ::sockaddr*)&addr, sizeof(addr)) < 0) {
+            DEBUG("Unable to bind UDP socket to port %d: %d", port, errno);
+            close(fd);
+            return SOCKET_INVALID;
+        }
+    }
+    const sock_handle_t handle = add_socket(fd, udp ? SocketType::UDP : SocketType::TCP);
+    // TCP sockets are registered with the poller once connected, as an unconnected stream socket
+    // is reported as hung up
+    if (udp && handle != SOCKET_INVALID && !register_socket(handle, fd)) {
+        socket_close(handle);
+        return SOCKET_INVALID;
+    }
+    return handle;
+}
+
+int32_t socket_connect(sock_handle_t sd, const sockaddr_t *addr, long addrlen)
+{
+    Socket* const s = socket_from(sd, SocketType::TCP);
+    if (!s) {
+        return -1;
+    }
+    const int fd = s->fd;
+    sockaddr_in in;
+    to_sockaddr_in(addr, &in);
+    if (connect(fd, (const ::sockaddr*)&in, sizeof(in)) < 0) {
+        if (errno != EINPROGRESS) {
+            return error_result();
+        }
+        pollfd p = {};
+        p.fd = fd;
+        p.events = POLLOUT;
+        const int ret = poll(&p, 1, CONNECT_TIMEOUT);
+        if (ret <= 0) {
+            return (ret == 0) ? -ETIMEDOUT : error_result();
+        }
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+            return error_result();
+        }
+        if (err) {
+            return -abs(err);
+        }
+    }
+    return register_socket(sd, fd) ? 0 : -1;
+}
+
+sock_result_t socket_reset_blocking_call()
+{
+    return 0;
+}
+
+sock_result_t socket_receive(sock_handle_t sd, void* buffer, socklen_t len, system_tick_t _timeout)
+{
+    Socket* const s = socket_from(sd, SocketType::TCP);
+    if (!s) {
+        return -1;
+    }
+    if (!(s->events.load() & (EVENT_READABLE | EVENT_HANGUP | EVENT_ERROR))) {
+        // Nothing to read, don't bother the kernel
+        if (!_timeout || !poller.wait(s, EVENT_READABLE, _timeout)) {
+            return 0;
+        }
+    }
+    // The flag is cleared before reading, so that data arriving in the meantime sets it again
+    s->events.fetch_and(~EVENT_READABLE);
+    const ssize_t n = recv(s->fd, buffer, len, 0);
+    if (n > 0) {
+        if ((size_t)n == len) {
+            s->events.fetch_or(EVENT_READABLE); // More data may be available
+        }
+        return n;
+    }
+    if (n == 0) {
+        s->events.fetch_or(EVENT_END_OF_STREAM);
+        return -1;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 0;
+    }
+    DEBUG("socket receive error: %d", errno);
+    s->events.fetch_or(EVENT_ERROR);
+    return error_result();
+}
+
+sock_result_t socket_send_ex(sock_handle_t sd, const void* buffer, socklen_t len, uint32_t flags, system_tick_t timeout, void* reserved)
+{
+    Socket* const s = socket_from(sd, SocketType::TCP);
+    if (!s) {
+        return -1;
+    }
+    const system_tick_t start = HAL_Timer_Get_Milli_Seconds();
+    size_t sent = 0;
+    while (sent < len) {
+        s->events.fetch_and(~EVENT_WRITABLE);
+        const ssize_t n = send(s->fd, (const char*)buffer + sent, len - sent, MSG_NOSIGNAL);
+        if (n >= 0) {
+            sent += n;
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return sent ? (sock_result_t)sent : error_result();
+        }
+        // Wait until the socket's send buffer has some space available
+        system_tick_t t = WAIT_FOREVER;
+        if (timeout) {
+            const system_tick_t elapsed = HAL_Timer_Get_Milli_Seconds() - start;
+            if (elapsed >= timeout) {
+                break;
+            }
+            t = timeout - elapsed;
+        }
+        if (!poller.wait(s, EVENT_WRITABLE, t)) {
+            break; // Timeout
+        }
+    }
+    return sent;
+}
+
+sock_result_t socket_send(sock_handle_t sd, const void* buffer, socklen_t len)
+{
+    return socket_send_ex(sd, buffer, len, 0, 0, nullptr);
+}
+
+sock_result_t socket_receivefrom(sock_handle_t sd, void* buffer, socklen_t len, uint32_t flags, sockaddr_t* addr, socklen_t* addrsize)
+{
+    Socket* const s = socket_from(sd, SocketType::UDP);
+    if (!s) {
+        return -1;
+    }
+    if (!(s->events.load() & (EVENT_READABLE | EVENT_ERROR))) {
+        return 0;
+    }
+    s->events.fetch_and(~EVENT_READABLE);
+    sockaddr_in in = {};
+    socklen_t inLen = sizeof(in);
+    const ssize_t n = recvfrom(s->fd, buffer, len, 0, (::sockaddr*)&in, &inLen);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        DEBUG("socket receive error: %d", errno);
+        return error_result();
+    }
+    // More datagrams may be queued
+    s->events.fetch_or(EVENT_READABLE);
+    if (addr && addrsize && *addrsize >= 6u) {
+        from_sockaddr_in(&in, addr);
+    }
+    return n;
+}
+
+sock_result_t socket_sendto(sock_handle_t sd, const void* buffer, socklen_t len, uint32_t flags, sockaddr_t* addr, socklen_t addr_size)
+{
+    Socket* const s = socket_from(sd, SocketType::UDP);
+    if (!s) {
+        return -1;
+    }
+    sockaddr_in in;
+    to_sockaddr_in(addr, &in);
+    const ssize_t n = sendto(s->fd, buffer, len, MSG_NOSIGNAL, (const ::sockaddr*)&in, sizeof(in));
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : error_result();
+    }
+    return n;
+}
+
+sock_result_t socket_create_tcp_server(uint16_t port, network_interface_t nif)
+{
+    DEBUG("Creating TCP Server on port %d", port);
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return SOCKET_INVALID;
+    }
+    const int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (const ::sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        DEBUG("Unable to create TCP server: %d", errno);
+        close(fd);
+        return SOCKET_INVALID;
+    }
+    const sock_handle_t handle = add_socket(fd, SocketType::SERVER);
+    if (handle != SOCKET_INVALID && !register_socket(handle, fd)) {
+        socket_close(handle);
+        return SOCKET_INVALID;
+    }
+    return handle;
+}
+
+sock_result_t socket_accept(sock_handle_t sd)
+{
+    Socket* const s = socket_from(sd, SocketType::SERVER);
+    if (!s || !(s->events.load() & EVENT_READABLE)) {
+        return SOCKET_INVALID;
+    }
+    s->events.fetch_and(~EVENT_READABLE);
+    const int fd = accept4(s->fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        return SOCKET_INVALID;
+    }
+    // More connections may be pending
+    s->events.fetch_or(EVENT_READABLE);
+    const sock_handle_t handle = add_socket(fd, SocketType::TCP);
+    if (handle != SOCKET_INVALID && !register_socket(handle, fd)) {
+        socket_close(handle);
+        return SOCKET_INVALID;
+    }
+    return handle;
+}
+
+sock_result_t socket_create_nonblocking_server(sock_handle_t sock, uint16_t port)
+{
+    NOT_IMPLEMENTED("create nonblocking server");
+    return 0;
+}
+
+sock_result_t socket_bind(sock_handle_t sock, uint16_t port)
+{
+    NOT_IMPLEMENTED("socket_bind");
+    return 0;
+}
+
+uint8_t socket_active_status(sock_handle_t sd)
+{
+    Socket* const s = sockets.get(sd);
+    if (!s || (s->events.load() & (EVENT_END_OF_STREAM | EVENT_ERROR))) {
+        return SOCKET_STATUS_INACTIVE;
+    }
+    return SOCKET_STATUS_ACTIVE;
+}
+
+sock_result_t socket_close(sock_handle_t sd)
+{
+    Socket* const s = sockets.get(sd);
+    if (!s) {
+        return 0;
+    }
+    const int fd = s->fd;
+    poller.remove(fd);
+    sockets.free(sd);
+    close(fd);
+    return 0;
+}
+
+sock_result_t socket_shutdown(sock_handle_t sd, int how)
+{
+    Socket* const s = socket_from(sd, SocketType::TCP);
+    if (!s) {
+        return -1;
+    }
+    int shflags = SHUT_RDWR;
+    if (how == SHUT_WR) {
+        shflags = SHUT_WR;
+    } else if (how == SHUT_RD) {
+        shflags = SHUT_RD;
+    }
+    return (shutdown(s->fd, shflags) < 0) ? error_result() : 0;
+}
+
+uint8_t socket_handle_valid(sock_handle_t handle)
+{
+    return sockets.get(handle) != nullptr;
+}
+
+sock_handle_t socket_handle_invalid()
+{
+    return SOCKET_INVALID;
+}
+
+int socket_native_fd(sock_handle_t sd)
+{
+    Socket* const s = sockets.get(sd);
+    return s ? s->fd.load() : -1;
+}
+
+sock_result_t socket_join_multicast(const HAL_IPAddress* addr, network_interface_t nif, socket_multicast_info_t* info)
+{
+    if (!info) {
+        return -1;
+    }
+    Socket* const s = socket_from(info->sock_handle, SocketType::UDP);
+    if (!s) {
+        return -1;
+    }
+    const int one = 1;
+    setsockopt(s->fd, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
+    ip_mreq mreq = {};
+    mreq.imr_multiaddr.s_addr = htonl(addr->ipv4);
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    return (setsockopt(s->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) ? error_result() : 0;
+}
+
+sock_result_t socket_leave_multicast(const HAL_IPAddress* addr, network_interface_t nif, socket_multicast_info_t* info)
+{
+    if (!info) {
+        return -1;
+    }
+    Socket* const s = socket_from(info->sock_handle, SocketType::UDP);
+    if (!s) {
+        return -1;
+    }
+    ip_mreq mreq = {};
+    mreq.imr_multiaddr.s_addr = htonl(addr->ipv4);
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    return (setsockopt(s->fd, IPPROTO_IP, IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) ? error_result() : 0;
+}
+
+sock_result_t socket_peer(sock_handle_t sd, sock_peer_t* peer, void* reserved)
+{
+    Socket* const s = socket_from(sd, SocketType::TCP);
+    if (!s || !peer) {
+        return -1;
+    }
+    sockaddr_in in = {};
+    socklen_t len = sizeof(in);
+    if (getpeername(s->fd, (::sockaddr*)&in, &len) < 0) {
+        return error_result();
+    }
+    peer->address.ipv4 = ntohl(in.sin_addr.s_addr);
+    peer->port = ntohs(in.sin_port);
+    return 0;
+}
+
+#endif // defined(HAL_GCC_SOCKET_HAL_EPOLL) && HAL_GCC_SOCKET_HAL_EPOLL
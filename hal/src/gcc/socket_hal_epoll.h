@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "socket_hal.h"
+
+/*
+ * Extensions of the epoll-based socket HAL of the virtual device, only available when it's
+ * enabled with VIRTUAL_DEVICE_SOCKET_HAL=epoll.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Returns the native descriptor of an open socket, or -1 if the handle is not valid. The descriptor
+ * can be monitored for readiness, but must not be read, written or closed directly.
+ */
+int socket_native_fd(sock_handle_t sd);
+
+#ifdef __cplusplus
+}
+#endif
@@ -39,5 +39,13 @@ CPPSRC += $(call target_files,$(overridedir)/,*.cpp)
 ASRC +=
 
 CPPFLAGS += -DBOOST_ASIO_SEPARATE_COMPILATION
+# Socket HAL implementation: asio (default) or epoll (Linux only)
+VIRTUAL_DEVICE_SOCKET_HAL ?= asio
+ifeq ("$(VIRTUAL_DEVICE_SOCKET_HAL)","epoll")
+ifneq ("$(MAKE_OS)","LINUX")
+$(error "VIRTUAL_DEVICE_SOCKET_HAL=epoll is only supported on Linux")
+endif
+CPPFLAGS += -DHAL_GCC_SOCKET_HAL_EPOLL=1
+endif
 CFLAGS += -DBOOST_NO_AUTO_PTR
 CPPFLAGS += -std=gnu++11
@@ -1,6 +1,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "usart_hal.h"
 #include "socket_hal.h"
+#include "system_error.h"
 
 struct Usart {
     virtual void init(Ring_Buffer *rx_buffer, Ring_Buffer *tx_buffer)=0;
@@ -248,4 +249,14 @@ void HAL_USART_Send_Break(HAL_USART_Serial serial, void* reserved)
 uint8_t HAL_USART_Break_Detected(HAL_USART_Serial serial)
 {
   return 0;
-}
\ No newline at end of file
+}
+
+ssize_t HAL_USART_Acquire_Read(HAL_USART_Serial serial, const void** data, void* reserved)
+{
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_USART_Commit_Read(HAL_USART_Serial serial, size_t size, void* reserved)
+{
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
@@ -25,6 +25,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "usb_hal.h"
+#include "system_error.h"
 #include <stdint.h>
 #include <iostream>
 #include <stdio.h>
@@ -179,6 +180,16 @@ bool HAL_USB_USART_Is_Connected(HAL_USB_USART_Serial serial)
   return true;
 }
 
+int32_t HAL_USB_USART_Acquire_Read(HAL_USB_USART_Serial serial, const void** data, void* reserved)
+{
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int32_t HAL_USB_USART_Commit_Read(HAL_USB_USART_Serial serial, size_t size, void* reserved)
+{
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
 #ifdef USB_HID_ENABLE
 /*******************************************************************************
  * Function Name : USB_HID_Send_Report.
@@ -26,6 +26,7 @@
 #include "service_debug.h"
 #include "ringbuf_helper.h"
 #include "device_config.h"
+#include "system_error.h"
 
 namespace asio = boost::asio;
 
@@ -530,3 +531,11 @@ void HAL_USART_Send_Break(HAL_USART_Serial serial, void* reserved) {
 uint8_t HAL_USART_Break_Detected(HAL_USART_Serial serial) {
   return usartMap[serial]->breakDetected();
 }
+
+ssize_t HAL_USART_Acquire_Read(HAL_USART_Serial serial, const void** data, void* reserved) {
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_USART_Commit_Read(HAL_USART_Serial serial, size_t size, void* reserved) {
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
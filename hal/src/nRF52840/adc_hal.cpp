@@ -19,6 +19,7 @@
 #include "nrfx_saadc.h"
 #include "adc_hal.h"
 #include "pinmap_impl.h"
+#include "system_error.h"
 
 static volatile bool m_adc_initiated = false;
 
@@ -125,3 +126,23 @@ void HAL_ADC_DMA_Init()
     uint32_t err_code = nrfx_saadc_init(&saadc_config, analog_in_event_handler);
     SPARK_ASSERT(err_code == NRF_SUCCESS);
 }
+
+int HAL_ADC_Sampler_Start(const HAL_ADC_Sampler_Config* config, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_ADC_Sampler_Stop(void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_ADC_Sampler_Release(const uint16_t* samples, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_ADC_Sampler_Get_Stats(HAL_ADC_Sampler_Stats* stats, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
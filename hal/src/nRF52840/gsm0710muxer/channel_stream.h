@@ -47,6 +47,8 @@ public:
     virtual int read(char* data, size_t size) override;
     virtual int peek(char* data, size_t size) override;
     virtual int skip(size_t size) override;
+    virtual int acquireRead(const char** data) override;
+    virtual int commitRead(size_t size) override;
     virtual int availForRead() override;
 
     virtual int write(const char* data, size_t size) override;
@@ -152,6 +154,32 @@ inline int MuxerChannelStream<MuxerT>::skip(size_t size) {
     return read(nullptr, size);
 }
 
+template <typename MuxerT>
+inline int MuxerChannelStream<MuxerT>::acquireRead(const char** data) {
+    if (!enabled_) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    // Release the previously acquired block, if any
+    rxBuf_->consumeCommit(0, rxBuf_->consumePending());
+    const size_t size = rxBuf_->consumable();
+    if (size > 0) {
+        *data = rxBuf_->consume(size);
+    }
+    return size;
+}
+
+template <typename MuxerT>
+inline int MuxerChannelStream<MuxerT>::commitRead(size_t size) {
+    if (!enabled_) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    const size_t pending = rxBuf_->consumePending();
+    CHECK_TRUE(size <= pending, SYSTEM_ERROR_INVALID_ARGUMENT);
+    rxBuf_->consumeCommit(size, pending - size);
+    resume();
+    return size;
+}
+
 template <typename MuxerT>
 inline int MuxerChannelStream<MuxerT>::availForRead() {
     if (!enabled_) {
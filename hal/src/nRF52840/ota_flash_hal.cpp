@@ -42,6 +42,7 @@
 #include "hal_platform.h"
 #include "platform_ncp.h"
 #include "deviceid_hal.h"
+#include "ota_image_digest.h"
 #include <memory>
 
 #define OTA_CHUNK_SIZE                 (512)
@@ -381,11 +382,50 @@ static hal_update_complete_t flash_bootloader(hal_module_t* mod, uint32_t module
     return result;
 }
 
+namespace {
+
+// Digest of the OTA image computed while it was being written
+hal_ota_image_digest_t ota_image_digest = {};
+bool ota_image_digest_set = false;
+
+bool verify_ota_image_digest(const hal_module_t* module)
+{
+    const uint32_t length = module_length(module->info);
+    // The image is written to the external flash at HAL_OTA_FlashAddress() and read via XIP
+    const uint32_t flash_address = module->bounds.start_address - EXTERNAL_FLASH_XIP_BASE;
+    const auto result = particle::verifyOtaImageDigest(ota_image_digest, flash_address,
+            (const uint8_t*)module->bounds.start_address, length, HAL_Core_Compute_CRC32);
+    if (result == particle::OTA_IMAGE_DIGEST_NOT_APPLICABLE) {
+        // The digest doesn't cover this module, read back the entire image
+        return FLASH_VerifyCRC32(FLASH_INTERNAL, module->bounds.start_address, length);
+    }
+    return result == particle::OTA_IMAGE_DIGEST_VALID;
+}
+
+} // namespace
+
+int HAL_FLASH_OTA_Set_Image_Digest(const hal_ota_image_digest_t* digest, void* reserved)
+{
+    ota_image_digest_set = (digest != nullptr);
+    if (digest) {
+        ota_image_digest = *digest;
+    }
+    return 0;
+}
+
 int HAL_FLASH_OTA_Validate(hal_module_t* mod, bool userDepsOptional, module_validation_flags_t flags, void* reserved)
 {
     hal_module_t module;
 
-    bool module_fetched = fetch_module(&module, &module_ota, userDepsOptional, flags);
+    const bool use_digest = ota_image_digest_set && (flags & MODULE_VALIDATION_INTEGRITY);
+    bool module_fetched = fetch_module(&module, &module_ota, userDepsOptional,
+            use_digest ? (flags & ~MODULE_VALIDATION_INTEGRITY) : flags);
+    if (module_fetched && use_digest) {
+        module.validity_checked |= MODULE_VALIDATION_INTEGRITY;
+        if (verify_ota_image_digest(&module)) {
+            module.validity_result |= MODULE_VALIDATION_INTEGRITY;
+        }
+    }
 
     if (mod) 
     {
@@ -95,6 +95,20 @@ int SerialStream::skip(size_t size) {
     return read(nullptr, size);
 }
 
+int SerialStream::acquireRead(const char** data) {
+    if (!enabled_) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    return HAL_USART_Acquire_Read(serial_, (const void**)data, nullptr);
+}
+
+int SerialStream::commitRead(size_t size) {
+    if (!enabled_) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    return HAL_USART_Commit_Read(serial_, size, nullptr);
+}
+
 int SerialStream::write(const char* data, size_t size) {
     if (!enabled_) {
         return SYSTEM_ERROR_INVALID_STATE;
@@ -32,6 +32,8 @@ public:
     int read(char* data, size_t size) override;
     int peek(char* data, size_t size) override;
     int skip(size_t size) override;
+    int acquireRead(const char** data) override;
+    int commitRead(size_t size) override;
     int write(const char* data, size_t size) override;
     int flush() override;
     int availForRead() override;
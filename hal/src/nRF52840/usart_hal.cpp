@@ -308,6 +308,37 @@ public:
         return rxBuffer_.peek(buffer, peekSize);
     }
 
+    ssize_t acquireRead(const uint8_t** data) {
+        CHECK_TRUE(isEnabled(), SYSTEM_ERROR_INVALID_STATE);
+        {
+            // Release the previously acquired block, if any
+            RxLock lk(uarte_);
+            rxBuffer_.consumeCommit(0, rxBuffer_.consumePending());
+        }
+        // Commits the data that has been received into the current DMA buffer
+        if (CHECK(this->data()) == 0) {
+            return 0;
+        }
+        RxLock lk(uarte_);
+        const size_t size = rxBuffer_.consumable();
+        *data = rxBuffer_.consume(size);
+        return size;
+    }
+
+    ssize_t commitRead(size_t size) {
+        CHECK_TRUE(isEnabled(), SYSTEM_ERROR_INVALID_STATE);
+        {
+            RxLock lk(uarte_);
+            const size_t pending = rxBuffer_.consumePending();
+            CHECK_TRUE(size <= pending, SYSTEM_ERROR_INVALID_ARGUMENT);
+            rxBuffer_.consumeCommit(size, pending - size);
+        }
+        if (!receiving_) {
+            startReceiver();
+        }
+        return size;
+    }
+
     ssize_t write(const uint8_t* buffer, size_t size) {
         CHECK_TRUE(isEnabled(), SYSTEM_ERROR_INVALID_STATE);
         const ssize_t canWrite = CHECK(space());
@@ -734,6 +765,17 @@ ssize_t HAL_USART_Peek(HAL_USART_Serial serial, void* buffer, size_t size, size_
     return usart->peek((uint8_t*)buffer, size);
 }
 
+ssize_t HAL_USART_Acquire_Read(HAL_USART_Serial serial, const void** data, void* reserved) {
+    auto usart = CHECK_TRUE_RETURN(getInstance(serial), SYSTEM_ERROR_NOT_FOUND);
+    CHECK_TRUE(data, SYSTEM_ERROR_INVALID_ARGUMENT);
+    return usart->acquireRead((const uint8_t**)data);
+}
+
+int HAL_USART_Commit_Read(HAL_USART_Serial serial, size_t size, void* reserved) {
+    auto usart = CHECK_TRUE_RETURN(getInstance(serial), SYSTEM_ERROR_NOT_FOUND);
+    return usart->commitRead(size);
+}
+
 int32_t HAL_USART_Read_Data(HAL_USART_Serial serial) {
     auto usart = CHECK_TRUE_RETURN(getInstance(serial), SYSTEM_ERROR_NOT_FOUND);
     uint8_t c;
@@ -21,6 +21,7 @@
 #include "usb_hal.h"
 #include "usb_hal_cdc.h"
 #include "usb_settings.h"
+#include "system_error.h"
 #include <mutex>
 
 #ifdef USB_CDC_ENABLE
@@ -87,6 +88,20 @@ int32_t HAL_USB_USART_Receive_Data(HAL_USB_USART_Serial serial, uint8_t peek) {
     }
 }
 
+int32_t HAL_USB_USART_Acquire_Read(HAL_USB_USART_Serial serial, const void** data, void* reserved) {
+    if (!data) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    return usb_uart_acquire_rx_data((const uint8_t**)data);
+}
+
+int32_t HAL_USB_USART_Commit_Read(HAL_USB_USART_Serial serial, size_t size, void* reserved) {
+    if (usb_uart_commit_rx_data(size) < 0) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    return size;
+}
+
 int32_t HAL_USB_USART_Send_Data(HAL_USB_USART_Serial serial, uint8_t data) {
     return usb_uart_send(&data, 1);
 }
@@ -433,7 +433,8 @@ int usb_uart_available_rx_data(void) {
     return FIFO_LENGTH(&m_usb_instance.rx_fifo) + m_usb_instance.rx_data_size;
 }
 
-uint8_t usb_uart_get_rx_data(void) {
+// Moves the data received by the last transfer to the rx FIFO and sets up the next transfer
+static void rx_fifo_refill(void) {
     if (m_usb_instance.rx_done) {
         if (FIFO_LENGTH(&m_usb_instance.rx_fifo) + m_usb_instance.rx_data_size <= m_usb_instance.rx_fifo.buf_size_mask) {
             for (int i = 0; i < m_usb_instance.rx_data_size; i++) {
@@ -450,6 +451,10 @@ uint8_t usb_uart_get_rx_data(void) {
             app_usbd_cdc_acm_read_any(cdc_acm_class, m_rx_buffer, READ_SIZE);
         }
     }
+}
+
+uint8_t usb_uart_get_rx_data(void) {
+    rx_fifo_refill();
 
     uint8_t data = 0;
     if (FIFO_LENGTH(&m_usb_instance.rx_fifo)) {
@@ -459,6 +464,32 @@ uint8_t usb_uart_get_rx_data(void) {
     return data;
 }
 
+int usb_uart_acquire_rx_data(const uint8_t** data) {
+    rx_fifo_refill();
+
+    app_fifo_t* fifo = &m_usb_instance.rx_fifo;
+    const uint32_t len = FIFO_LENGTH(fifo);
+    if (len == 0) {
+        return 0;
+    }
+    // The FIFO positions are free-running, the data may wrap around the end of the buffer
+    const uint32_t pos = fifo->read_pos & fifo->buf_size_mask;
+    const uint32_t contiguous = fifo->buf_size_mask + 1 - pos;
+    *data = fifo->p_buf + pos;
+    return (len < contiguous) ? len : contiguous;
+}
+
+int usb_uart_commit_rx_data(size_t size) {
+    app_fifo_t* fifo = &m_usb_instance.rx_fifo;
+    if (size > FIFO_LENGTH(fifo)) {
+        return -1;
+    }
+    fifo->read_pos += size;
+
+    rx_fifo_refill();
+    return size;
+}
+
 uint8_t usb_uart_peek_rx_data(uint8_t index) {
     uint8_t data = 0;
     if (app_fifo_peek(&m_usb_instance.rx_fifo, index, &data)) {
@@ -2,6 +2,7 @@
 #define  _USB_HAL_CDC_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,6 +22,9 @@ void usb_hal_detach(void);
 int usb_uart_available_rx_data(void);
 uint8_t usb_uart_get_rx_data(void);
 uint8_t usb_uart_peek_rx_data(uint8_t index);
+// Returns a pointer to a contiguous block of data in the rx FIFO and the size of the block
+int usb_uart_acquire_rx_data(const uint8_t** data);
+int usb_uart_commit_rx_data(size_t size);
 void usb_uart_flush_rx_data(void);
 void usb_uart_flush_tx_data(void);
 int usb_uart_available_tx_data(void);
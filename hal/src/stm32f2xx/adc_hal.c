@@ -28,14 +28,34 @@
 #include "gpio_hal.h"
 #include "pinmap_hal.h"
 #include "pinmap_impl.h"
+#include "interrupts_hal.h"
+#include "system_error.h"
 
 /* Private typedef -----------------------------------------------------------*/
 
+typedef struct ADC_Sampler {
+    uint16_t* buffer;
+    size_t half_size;
+    HAL_ADC_Sampler_Callback callback;
+    void* context;
+    uint32_t sample_rate;
+    volatile uint32_t buffers;
+    volatile uint32_t overruns;
+    volatile int8_t held; // Index of the half held by the application, or -1
+    volatile uint8_t held_overwritten; // Set if the DMA has started overwriting the held half
+} ADC_Sampler;
+
 /* Private define ------------------------------------------------------------*/
 
 #define ADC_CDR_ADDRESS     ((uint32_t)0x40012308)
 #define ADC_DMA_BUFFERSIZE  10
 #define ADC_SAMPLING_TIME   ADC_SampleTime_480Cycles
+#define ADC1_DR_ADDRESS     ((uint32_t)0x4001204C)
+
+// ADC clock is PCLK2 / 2 and TIM8 clock is 2 * PCLK2
+#define ADC_SAMPLER_ADC_CLOCK       (SystemCoreClock / 4)
+#define ADC_SAMPLER_TIM_CLOCK       (SystemCoreClock)
+#define ADC_SAMPLER_MAX_BUFFER_SIZE 0xfffe
 
 /* Private macro -------------------------------------------------------------*/
 
@@ -46,6 +66,9 @@ uint8_t adcInitFirstTime = true;
 uint8_t adcChannelConfigured = ADC_CHANNEL_NONE;
 static uint8_t ADC_Sample_Time = ADC_SAMPLING_TIME;
 
+static ADC_Sampler adcSampler;
+static volatile uint8_t adcSamplerActive = false;
+
 /* Extern variables ----------------------------------------------------------*/
 
 /* Private function prototypes -----------------------------------------------*/
@@ -87,6 +110,12 @@ int32_t HAL_ADC_Read(uint16_t pin)
     int i = 0;
     STM32_Pin_Info* PIN_MAP = HAL_Pin_Map();
 
+    if (adcSamplerActive)
+    {
+        // ADC1 and DMA2_Stream0 are owned by the continuous sampler
+        return 0;
+    }
+
     if (PIN_MAP[pin].pin_mode != AN_INPUT)
     {
         HAL_GPIO_Save_Pin_Mode(pin);
@@ -223,3 +252,247 @@ void HAL_ADC_DMA_Init()
     ADC_InitStructure.ADC_NbrOfConversion = 1;
     ADC_Init(ADC2, &ADC_InitStructure);
 }
+
+/*
+ * @brief Returns the longest ADC sample time that allows to complete a conversion
+ * within the sampling period, or -1 if the sample rate is too high.
+ */
+static int ADC_Sampler_Sample_Time(uint32_t sample_rate)
+{
+    // ADC_SampleTime_3Cycles ... ADC_SampleTime_480Cycles
+    static const uint16_t cycles[] = { 3, 15, 28, 56, 84, 112, 144, 480 };
+    int i = 0;
+    for (i = sizeof(cycles) / sizeof(cycles[0]) - 1; i >= 0; --i)
+    {
+        // 12 cycles are needed for the 12-bit conversion itself
+        if ((uint64_t)(cycles[i] + 12) * sample_rate <= ADC_SAMPLER_ADC_CLOCK)
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+static void ADC_Sampler_Half_Complete(int8_t half)
+{
+    if (adcSampler.held >= 0)
+    {
+        // The application is still processing the previously delivered half, which is now
+        // being overwritten by the DMA
+        adcSampler.held_overwritten = true;
+        ++adcSampler.overruns;
+        return;
+    }
+    ++adcSampler.buffers;
+    adcSampler.held_overwritten = false;
+    adcSampler.held = half;
+    if (adcSampler.callback)
+    {
+        adcSampler.callback(adcSampler.buffer + half * adcSampler.half_size, adcSampler.half_size,
+                adcSampler.context);
+    }
+}
+
+static void ADC_Sampler_DMA_Handler(void)
+{
+    if (DMA_GetITStatus(DMA2_Stream0, DMA_IT_HTIF0) != RESET)
+    {
+        DMA_ClearITPendingBit(DMA2_Stream0, DMA_IT_HTIF0);
+        ADC_Sampler_Half_Complete(0);
+    }
+    if (DMA_GetITStatus(DMA2_Stream0, DMA_IT_TCIF0) != RESET)
+    {
+        DMA_ClearITPendingBit(DMA2_Stream0, DMA_IT_TCIF0);
+        ADC_Sampler_Half_Complete(1);
+    }
+}
+
+/*
+ * @brief Start continuous sampling of a pin.
+ * TIM8 update events trigger the conversions of ADC1, and DMA2_Stream0 transfers the
+ * results to the circular buffer. PWM is not available on the TIM8 pins while sampling.
+ */
+int HAL_ADC_Sampler_Start(const HAL_ADC_Sampler_Config* config, void* reserved)
+{
+    ADC_CommonInitTypeDef ADC_CommonInitStructure;
+    ADC_InitTypeDef ADC_InitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    STM32_Pin_Info* PIN_MAP = HAL_Pin_Map();
+
+    if (adcSamplerActive)
+    {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    if (!config || config->pin >= TOTAL_PINS || PIN_MAP[config->pin].adc_channel == ADC_CHANNEL_NONE ||
+            !config->buffer || config->buffer_size < 2 || config->buffer_size > ADC_SAMPLER_MAX_BUFFER_SIZE ||
+            (config->buffer_size % 2) != 0 || config->sample_rate == 0)
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    const int sample_time = ADC_Sampler_Sample_Time(config->sample_rate);
+    if (sample_time < 0)
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    // Timer period in TIM8 clock ticks, split into a prescaler and a 16-bit auto-reload value
+    uint32_t ticks = ADC_SAMPLER_TIM_CLOCK / config->sample_rate;
+    if (ticks == 0)
+    {
+        ticks = 1;
+    }
+    const uint32_t prescaler = (ticks - 1) / 0x10000;
+    if (prescaler > 0xffff)
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    const uint32_t period = ticks / (prescaler + 1);
+
+    if (PIN_MAP[config->pin].pin_mode != AN_INPUT)
+    {
+        HAL_GPIO_Save_Pin_Mode(config->pin);
+        HAL_Pin_Mode(config->pin, AN_INPUT);
+    }
+
+    adcSampler.buffer = config->buffer;
+    adcSampler.half_size = config->buffer_size / 2;
+    adcSampler.callback = config->callback;
+    adcSampler.context = config->context;
+    adcSampler.sample_rate = ADC_SAMPLER_TIM_CLOCK / ((prescaler + 1) * period);
+    adcSampler.buffers = 0;
+    adcSampler.overruns = 0;
+    adcSampler.held = -1;
+    adcSampler.held_overwritten = false;
+    adcSamplerActive = true;
+
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2, ENABLE);
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_ADC1 | RCC_APB2Periph_TIM8, ENABLE);
+
+    // The regular single-shot configuration is restored by the next HAL_ADC_Read()
+    ADC_Cmd(ADC1, DISABLE);
+    ADC_Cmd(ADC2, DISABLE);
+    DMA_Cmd(DMA2_Stream0, DISABLE);
+    while (DMA_GetCmdStatus(DMA2_Stream0) != DISABLE);
+
+    // DMA2 Stream0 channel0 configuration, circular transfers of single ADC1 conversions
+    DMA_DeInit(DMA2_Stream0);
+    DMA_InitStructure.DMA_Channel = DMA_Channel_0;
+    DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)config->buffer;
+    DMA_InitStructure.DMA_PeripheralBaseAddr = ADC1_DR_ADDRESS;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralToMemory;
+    DMA_InitStructure.DMA_BufferSize = config->buffer_size;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_InitStructure.DMA_FIFOMode = DMA_FIFOMode_Disable;
+    DMA_InitStructure.DMA_FIFOThreshold = DMA_FIFOThreshold_HalfFull;
+    DMA_InitStructure.DMA_MemoryBurst = DMA_MemoryBurst_Single;
+    DMA_InitStructure.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
+    DMA_Init(DMA2_Stream0, &DMA_InitStructure);
+    DMA_ClearITPendingBit(DMA2_Stream0, DMA_IT_HTIF0 | DMA_IT_TCIF0);
+    DMA_ITConfig(DMA2_Stream0, DMA_IT_HT | DMA_IT_TC, ENABLE);
+    // Same priority as the user interrupt handlers attached to EXTI lines
+    NVIC_SetPriority(DMA2_Stream0_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 14, 0));
+    HAL_Set_Direct_Interrupt_Handler(DMA2_Stream0_IRQn, ADC_Sampler_DMA_Handler, HAL_DIRECT_INTERRUPT_FLAG_ENABLE, NULL);
+    DMA_Cmd(DMA2_Stream0, ENABLE);
+
+    /* ADC Common Init */
+    ADC_CommonInitStructure.ADC_Mode = ADC_Mode_Independent;
+    ADC_CommonInitStructure.ADC_Prescaler = ADC_Prescaler_Div2;
+    ADC_CommonInitStructure.ADC_DMAAccessMode = ADC_DMAAccessMode_Disabled;
+    ADC_CommonInitStructure.ADC_TwoSamplingDelay = ADC_TwoSamplingDelay_5Cycles;
+    ADC_CommonInit(&ADC_CommonInitStructure);
+
+    // ADC1 configuration, one conversion per rising edge of TIM8 TRGO
+    ADC_InitStructure.ADC_Resolution = ADC_Resolution_12b;
+    ADC_InitStructure.ADC_ScanConvMode = DISABLE;
+    ADC_InitStructure.ADC_ContinuousConvMode = DISABLE;
+    ADC_InitStructure.ADC_ExternalTrigConvEdge = ADC_ExternalTrigConvEdge_Rising;
+    ADC_InitStructure.ADC_ExternalTrigConv = ADC_ExternalTrigConv_T8_TRGO;
+    ADC_InitStructure.ADC_DataAlign = ADC_DataAlign_Right;
+    ADC_InitStructure.ADC_NbrOfConversion = 1;
+    ADC_Init(ADC1, &ADC_InitStructure);
+    ADC_RegularChannelConfig(ADC1, PIN_MAP[config->pin].adc_channel, 1, (uint8_t)sample_time);
+    ADC_DMARequestAfterLastTransferCmd(ADC1, ENABLE);
+    ADC_DMACmd(ADC1, ENABLE);
+    ADC_Cmd(ADC1, ENABLE);
+
+    // TIM8 configuration, the update event is the trigger output
+    TIM_TimeBaseStructure.TIM_Period = period - 1;
+    TIM_TimeBaseStructure.TIM_Prescaler = prescaler;
+    TIM_TimeBaseStructure.TIM_ClockDivision = 0;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+    TIM_TimeBaseInit(TIM8, &TIM_TimeBaseStructure);
+    TIM_SelectOutputTrigger(TIM8, TIM_TRGOSource_Update);
+    TIM_Cmd(TIM8, ENABLE);
+
+    return 0;
+}
+
+int HAL_ADC_Sampler_Stop(void* reserved)
+{
+    if (!adcSamplerActive)
+    {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+
+    TIM_Cmd(TIM8, DISABLE);
+    TIM_SelectOutputTrigger(TIM8, TIM_TRGOSource_Reset);
+
+    ADC_Cmd(ADC1, DISABLE);
+    ADC_DMACmd(ADC1, DISABLE);
+    ADC_DMARequestAfterLastTransferCmd(ADC1, DISABLE);
+
+    DMA_ITConfig(DMA2_Stream0, DMA_IT_HT | DMA_IT_TC, DISABLE);
+    DMA_Cmd(DMA2_Stream0, DISABLE);
+    while (DMA_GetCmdStatus(DMA2_Stream0) != DISABLE);
+    DMA_ClearITPendingBit(DMA2_Stream0, DMA_IT_HTIF0 | DMA_IT_TCIF0);
+    HAL_Set_Direct_Interrupt_Handler(DMA2_Stream0_IRQn, NULL,
+            HAL_DIRECT_INTERRUPT_FLAG_RESTORE | HAL_DIRECT_INTERRUPT_FLAG_DISABLE, NULL);
+
+    // Make HAL_ADC_Read() reinitialize the ADC in the dual regular simultaneous mode
+    adcInitFirstTime = true;
+    adcChannelConfigured = ADC_CHANNEL_NONE;
+    adcSamplerActive = false;
+
+    return 0;
+}
+
+int HAL_ADC_Sampler_Release(const uint16_t* samples, void* reserved)
+{
+    if (!adcSamplerActive)
+    {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    // The DMA interrupt may mark the held half as overwritten at any time, so the flag is read and
+    // the half is released atomically
+    const int state = HAL_disable_irq();
+    const int8_t held = adcSampler.held;
+    if (held < 0 || samples != adcSampler.buffer + held * adcSampler.half_size)
+    {
+        HAL_enable_irq(state);
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    const uint8_t overwritten = adcSampler.held_overwritten;
+    adcSampler.held = -1;
+    HAL_enable_irq(state);
+    return overwritten ? SYSTEM_ERROR_TIMEOUT : 0;
+}
+
+int HAL_ADC_Sampler_Get_Stats(HAL_ADC_Sampler_Stats* stats, void* reserved)
+{
+    if (!stats)
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    stats->sample_rate = adcSamplerActive ? adcSampler.sample_rate : 0;
+    stats->buffers = adcSampler.buffers;
+    stats->overruns = adcSampler.overruns;
+    stats->held_overwritten = adcSampler.held >= 0 && adcSampler.held_overwritten;
+    return 0;
+}
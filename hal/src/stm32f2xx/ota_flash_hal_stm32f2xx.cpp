@@ -40,6 +40,7 @@
 #include "delay_hal.h"
 // For ATOMIC_BLOCK
 #include "spark_wiring_interrupts.h"
+#include "ota_image_digest.h"
 
 #include <memory>
 
@@ -287,10 +288,48 @@ static hal_update_complete_t flash_bootloader(hal_module_t* mod, uint32_t module
     return result;
 }
 
+namespace {
+
+// Digest of the OTA image computed while it was being written
+hal_ota_image_digest_t ota_image_digest = {};
+bool ota_image_digest_set = false;
+
+bool verify_ota_image_digest(const hal_module_t* module)
+{
+    const uint32_t length = module_length(module->info);
+    // The OTA section is in the internal flash, so the image is read at the address it was written to
+    const auto result = particle::verifyOtaImageDigest(ota_image_digest, module->bounds.start_address,
+            (const uint8_t*)module->bounds.start_address, length, HAL_Core_Compute_CRC32);
+    if (result == particle::OTA_IMAGE_DIGEST_NOT_APPLICABLE) {
+        // The digest doesn't cover this module, read back the entire image
+        return FLASH_VerifyCRC32(FLASH_INTERNAL, module->bounds.start_address, length);
+    }
+    return result == particle::OTA_IMAGE_DIGEST_VALID;
+}
+
+} // namespace
+
+int HAL_FLASH_OTA_Set_Image_Digest(const hal_ota_image_digest_t* digest, void* reserved)
+{
+    ota_image_digest_set = (digest != nullptr);
+    if (digest) {
+        ota_image_digest = *digest;
+    }
+    return 0;
+}
+
 int HAL_FLASH_OTA_Validate(hal_module_t* mod, bool userDepsOptional, module_validation_flags_t flags, void* reserved) {
     hal_module_t module;
 
-    bool module_fetched = fetch_module(&module, &module_ota, userDepsOptional, flags);
+    const bool use_digest = ota_image_digest_set && (flags & MODULE_VALIDATION_INTEGRITY);
+    bool module_fetched = fetch_module(&module, &module_ota, userDepsOptional,
+            use_digest ? (flags & ~MODULE_VALIDATION_INTEGRITY) : flags);
+    if (module_fetched && use_digest) {
+        module.validity_checked |= MODULE_VALIDATION_INTEGRITY;
+        if (verify_ota_image_digest(&module)) {
+            module.validity_result |= MODULE_VALIDATION_INTEGRITY;
+        }
+    }
 
     if (mod) {
         memcpy(mod, &module, sizeof(hal_module_t));
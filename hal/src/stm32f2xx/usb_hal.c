@@ -44,6 +44,7 @@
 #include "usbd_desc_device.h"
 #include <stdlib.h>
 #include "ringbuf_helper.h"
+#include "system_error.h"
 
 LOG_SOURCE_CATEGORY("usb.hal")
 
@@ -561,6 +562,16 @@ bool HAL_USB_USART_Is_Connected(HAL_USB_USART_Serial serial)
                 USB_OTG_dev.dev.device_status == USB_OTG_CONFIGURED &&
                 usbUsartMap[serial].data->serial_open;
 }
+
+int32_t HAL_USB_USART_Acquire_Read(HAL_USB_USART_Serial serial, const void** data, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int32_t HAL_USB_USART_Commit_Read(HAL_USB_USART_Serial serial, size_t size, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
 #endif /* USB_CDC_ENABLE */
 
 #ifdef USB_HID_ENABLE
@@ -24,6 +24,7 @@
  */
 
 #include "adc_hal.h"
+#include "system_error.h"
 
 void HAL_ADC_Set_Sample_Time(uint8_t ADC_SampleTime)
 {
@@ -45,3 +46,23 @@ int32_t HAL_ADC_Read(uint16_t pin)
 void HAL_ADC_DMA_Init()
 {
 }
+
+int HAL_ADC_Sampler_Start(const HAL_ADC_Sampler_Config* config, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_ADC_Sampler_Stop(void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_ADC_Sampler_Release(const uint16_t* samples, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_ADC_Sampler_Get_Stats(HAL_ADC_Sampler_Stats* stats, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
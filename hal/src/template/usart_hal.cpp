@@ -25,6 +25,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "usart_hal.h"
+#include "system_error.h"
 
 void HAL_USART_Init(HAL_USART_Serial serial, Ring_Buffer *rx_buffer, Ring_Buffer *tx_buffer)
 {
@@ -75,3 +76,13 @@ int32_t HAL_USART_Available_Data_For_Write(HAL_USART_Serial serial)
 {
     return 0;
 }
+
+ssize_t HAL_USART_Acquire_Read(HAL_USART_Serial serial, const void** data, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int HAL_USART_Commit_Read(HAL_USART_Serial serial, size_t size, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
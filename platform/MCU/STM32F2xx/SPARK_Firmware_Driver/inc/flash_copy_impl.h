@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLASH_COPY_IMPL_H
+#define FLASH_COPY_IMPL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size of the buffers used to read the source and destination data
+#define FLASH_COPY_BLOCK_SIZE 256
+
+/**
+ * Flash device accessors used by the copy and compare routines. All functions return 0 on
+ * success or a negative value on error.
+ */
+typedef struct flash_copy_device_t {
+    int (*read)(uint32_t address, void* data, uint32_t size, void* ctx);
+    int (*write)(uint32_t address, const void* data, uint32_t size, void* ctx);
+    // Erases the sectors spanning the specified range
+    int (*erase)(uint32_t address, uint32_t size, void* ctx);
+    // Returns the end address (exclusive) of the sector containing the specified address
+    uint32_t (*sector_end)(uint32_t address, void* ctx);
+    void* ctx;
+} flash_copy_device_t;
+
+typedef struct flash_copy_stats_t {
+    uint32_t sectors; // Number of destination sectors processed
+    uint32_t sectors_skipped; // Number of sectors that were left intact
+    uint32_t bytes_compared;
+    uint32_t bytes_written;
+} flash_copy_stats_t;
+
+/**
+ * Compares two memory ranges. Returns 0 if the contents are equal, 1 if they differ, or -1 on
+ * error.
+ */
+int Compare_FlashMemory_Impl(const flash_copy_device_t* src, uint32_t src_addr,
+        const flash_copy_device_t* dest, uint32_t dest_addr, uint32_t length);
+
+/**
+ * Copies a memory range sector by sector. In the differential mode, the contents of each
+ * destination sector are compared with the source data first, and the sector is only erased
+ * and programmed if it has changed. Returns 0 on success or -1 on error.
+ *
+ * The `stats` argument is optional.
+ */
+int Copy_FlashMemory_Impl(const flash_copy_device_t* src, uint32_t src_addr,
+        const flash_copy_device_t* dest, uint32_t dest_addr, uint32_t length, int differential,
+        flash_copy_stats_t* stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // FLASH_COPY_IMPL_H
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flash_copy_impl.h"
+
+#include <string.h>
+
+static int compare_block(const flash_copy_device_t* src, uint32_t src_addr,
+        const flash_copy_device_t* dest, uint32_t dest_addr, uint32_t length, uint32_t* compared) {
+    uint8_t src_buf[FLASH_COPY_BLOCK_SIZE];
+    uint8_t dest_buf[FLASH_COPY_BLOCK_SIZE];
+    while (length > 0) {
+        const uint32_t n = (length < FLASH_COPY_BLOCK_SIZE) ? length : FLASH_COPY_BLOCK_SIZE;
+        if (src->read(src_addr, src_buf, n, src->ctx) != 0 ||
+                dest->read(dest_addr, dest_buf, n, dest->ctx) != 0) {
+            return -1;
+        }
+        if (compared) {
+            *compared += n;
+        }
+        if (memcmp(src_buf, dest_buf, n) != 0) {
+            return 1;
+        }
+        src_addr += n;
+        dest_addr += n;
+        length -= n;
+    }
+    return 0;
+}
+
+static int copy_block(const flash_copy_device_t* src, uint32_t src_addr,
+        const flash_copy_device_t* dest, uint32_t dest_addr, uint32_t length, uint32_t* written) {
+    uint8_t buf[FLASH_COPY_BLOCK_SIZE];
+    if (dest->erase(dest_addr, length, dest->ctx) != 0) {
+        return -1;
+    }
+    while (length > 0) {
+        const uint32_t n = (length < FLASH_COPY_BLOCK_SIZE) ? length : FLASH_COPY_BLOCK_SIZE;
+        if (src->read(src_addr, buf, n, src->ctx) != 0 ||
+                dest->write(dest_addr, buf, n, dest->ctx) != 0) {
+            return -1;
+        }
+        if (written) {
+            *written += n;
+        }
+        src_addr += n;
+        dest_addr += n;
+        length -= n;
+    }
+    return 0;
+}
+
+int Compare_FlashMemory_Impl(const flash_copy_device_t* src, uint32_t src_addr,
+        const flash_copy_device_t* dest, uint32_t dest_addr, uint32_t length) {
+    return compare_block(src, src_addr, dest, dest_addr, length, NULL);
+}
+
+int Copy_FlashMemory_Impl(const flash_copy_device_t* src, uint32_t src_addr,
+        const flash_copy_device_t* dest, uint32_t dest_addr, uint32_t length, int differential,
+        flash_copy_stats_t* stats) {
+    flash_copy_stats_t s;
+    memset(&s, 0, sizeof(s));
+    int ret = 0;
+    while (length > 0) {
+        const uint32_t end = dest->sector_end(dest_addr, dest->ctx);
+        if (end <= dest_addr) {
+            ret = -1;
+            break;
+        }
+        uint32_t n = end - dest_addr;
+        if (n > length) {
+            n = length;
+        }
+        ++s.sectors;
+        // The destination sector is compared with the source data in bulk, which is much cheaper
+        // than erasing and programming a sector that hasn't changed
+        int changed = 1;
+        if (differential) {
+            changed = compare_block(src, src_addr, dest, dest_addr, n, &s.bytes_compared);
+            if (changed < 0) {
+                ret = -1;
+                break;
+            }
+        }
+        if (changed) {
+            if (copy_block(src, src_addr, dest, dest_addr, n, &s.bytes_written) != 0) {
+                ret = -1;
+                break;
+            }
+        } else {
+            ++s.sectors_skipped;
+        }
+        src_addr += n;
+        dest_addr += n;
+        length -= n;
+    }
+    if (stats) {
+        *stats = s;
+    }
+    return ret;
+}
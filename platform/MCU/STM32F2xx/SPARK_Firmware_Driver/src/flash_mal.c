@@ -28,6 +28,7 @@
 #include "flash_mal.h"
 #include "dct.h"
 #include "module_info.h"
+#include "flash_copy_impl.h"
 #include <string.h>
 
 /* Private functions ---------------------------------------------------------*/
@@ -303,91 +304,91 @@ int FLASH_CheckCopyMemory(flash_device_t sourceDeviceID, uint32_t sourceAddress,
     return FLASH_ACCESS_RESULT_OK;
 }
 
-bool CopyFlashBlock(flash_device_t sourceDeviceID, uint32_t sourceAddress, flash_device_t destinationDeviceID, uint32_t destinationAddress, uint32_t length)
+static int InternalFlashRead(uint32_t address, void* data, uint32_t size, void* ctx)
 {
-#ifdef USE_SERIAL_FLASH
-    uint8_t serialFlashData[4];
-#endif
+    memcpy(data, (const void*)address, size);
+    return 0;
+}
 
-	uint32_t endAddress = sourceAddress+length;
+static int InternalFlashWrite(uint32_t address, const void* data, uint32_t size, void* ctx)
+{
+    const uint8_t* src = (const uint8_t*)data;
+    int result = 0;
 
-    if (!FLASH_EraseMemory(destinationDeviceID, destinationAddress, length))
+    /* Unlocks the internal flash program erase controller */
+    FLASH_Unlock();
+
+    while (size)
     {
-        return false;
+        /* Pad the last partial word with the erased value */
+        uint32_t word = 0xFFFFFFFF;
+        uint32_t n = (size < 4) ? size : 4;
+        memcpy(&word, src, n);
+
+        /* Programming an erased word is not necessary */
+        if (word != 0xFFFFFFFF && FLASH_ProgramWord(address, word) != FLASH_COMPLETE)
+        {
+            result = -1;
+            break;
+        }
+
+        src += n;
+        address += 4;
+        size -= n;
     }
 
-	if (destinationDeviceID == FLASH_INTERNAL)
-	{
-	    /* Locks the internal flash program erase controller */
-	    FLASH_Unlock();
-	}
+    /* Locks the internal flash program erase controller */
+    FLASH_Lock();
 
-	bool success = true;
+    return result;
+}
 
-	/* Program source to destination */
-	while (sourceAddress < endAddress)
-	{
-	    uint32_t internalFlashData = 0;
-
-		if (sourceDeviceID == FLASH_INTERNAL)
-		{
-			/* Read data from internal flash source address */
-			internalFlashData = (*(__IO uint32_t*) sourceAddress);
-		}
-	#ifdef USE_SERIAL_FLASH
-		else if (sourceDeviceID == FLASH_SERIAL)
-		{
-			/* Read data from serial flash source address */
-			sFLASH_ReadBuffer(serialFlashData, sourceAddress, 4);
-		}
-	#endif
-
-		if (destinationDeviceID == FLASH_INTERNAL)
-		{
-	#ifdef USE_SERIAL_FLASH
-			if (sourceDeviceID == FLASH_SERIAL)
-			{
-				internalFlashData = (uint32_t)(serialFlashData[0] | (serialFlashData[1] << 8) | (serialFlashData[2] << 16) | (serialFlashData[3] << 24));
-			}
-	#endif
-
-			/* Program data to internal flash destination address */
-			FLASH_Status status = FLASH_ProgramWord(destinationAddress, internalFlashData);
-
-			/* If program operation fails, return Failure */
-			if (status != FLASH_COMPLETE)
-			{
-				success = false;
-				break;
-			}
-		}
-	#ifdef USE_SERIAL_FLASH
-		else if (destinationDeviceID == FLASH_SERIAL)
-		{
-			if (sourceDeviceID == FLASH_INTERNAL)
-			{
-				serialFlashData[0] = (uint8_t)(internalFlashData & 0xFF);
-				serialFlashData[1] = (uint8_t)((internalFlashData & 0xFF00) >> 8);
-				serialFlashData[2] = (uint8_t)((internalFlashData & 0xFF0000) >> 16);
-				serialFlashData[3] = (uint8_t)((internalFlashData & 0xFF000000) >> 24);
-			}
-
-			/* Program data to serial flash destination address */
-			sFLASH_WriteBuffer(serialFlashData, destinationAddress, 4);
-		}
-	#endif
-
-		sourceAddress += 4;
-		destinationAddress += 4;
-	}
+#ifdef USE_SERIAL_FLASH
+static int SerialFlashRead(uint32_t address, void* data, uint32_t size, void* ctx)
+{
+    sFLASH_ReadBuffer((uint8_t*)data, address, size);
+    return 0;
+}
 
-	if (destinationDeviceID == FLASH_INTERNAL)
-	{
-	    /* Locks the internal flash program erase controller */
-	    FLASH_Lock();
-	}
+static int SerialFlashWrite(uint32_t address, const void* data, uint32_t size, void* ctx)
+{
+    sFLASH_WriteBuffer((const uint8_t*)data, address, size);
+    return 0;
+}
+#endif
+
+static int FlashErase(uint32_t address, uint32_t size, void* ctx)
+{
+    return FLASH_EraseMemory((flash_device_t)(uintptr_t)ctx, address, size) ? 0 : -1;
+}
 
-	return success;
+static uint32_t FlashSectorEnd(uint32_t address, void* ctx)
+{
+    return EndOfFlashSector((flash_device_t)(uintptr_t)ctx, address);
+}
+
+static bool GetFlashCopyDevice(flash_device_t flashDeviceID, flash_copy_device_t* device)
+{
+    if (flashDeviceID == FLASH_INTERNAL)
+    {
+        device->read = InternalFlashRead;
+        device->write = InternalFlashWrite;
+    }
+#ifdef USE_SERIAL_FLASH
+    else if (flashDeviceID == FLASH_SERIAL)
+    {
+        device->read = SerialFlashRead;
+        device->write = SerialFlashWrite;
+    }
+#endif
+    else
+    {
+        return false;
+    }
+    device->erase = FlashErase;
+    device->sector_end = FlashSectorEnd;
+    device->ctx = (void*)(uintptr_t)flashDeviceID;
+    return true;
 }
 
 int FLASH_CopyMemory(flash_device_t sourceDeviceID, uint32_t sourceAddress,
@@ -399,7 +400,13 @@ int FLASH_CopyMemory(flash_device_t sourceDeviceID, uint32_t sourceAddress,
         return FLASH_ACCESS_RESULT_BADARG;
     }
 
-    if (sourceDeviceID == FLASH_SERIAL)
+    flash_copy_device_t source, destination;
+    if (!GetFlashCopyDevice(sourceDeviceID, &source) || !GetFlashCopyDevice(destinationDeviceID, &destination))
+    {
+        return FLASH_ACCESS_RESULT_BADARG;
+    }
+
+    if (sourceDeviceID == FLASH_SERIAL || destinationDeviceID == FLASH_SERIAL)
     {
 #ifdef USE_SERIAL_FLASH
         /* Initialize SPI Flash */
@@ -407,17 +414,11 @@ int FLASH_CopyMemory(flash_device_t sourceDeviceID, uint32_t sourceAddress,
 #endif
     }
 
-    while (length)
+    /* In the differential mode, only the destination sectors that differ from the source data are erased and programmed */
+    if (Copy_FlashMemory_Impl(&source, sourceAddress, &destination, destinationAddress, length,
+            (flags & MODULE_COPY_DIFFERENTIAL) != 0, NULL) != 0)
     {
-        uint32_t endBlockAddress = EndOfFlashSector(destinationDeviceID, destinationAddress);
-    		uint32_t blockLength = endBlockAddress-destinationAddress;
-    		if (blockLength>length)
-    			blockLength = length;
-    		if (!CopyFlashBlock(sourceDeviceID, sourceAddress, destinationDeviceID, destinationAddress, blockLength))
-    			return FLASH_ACCESS_RESULT_ERROR;
-    		length -= blockLength;
-    		sourceAddress += blockLength;
-    		destinationAddress += blockLength;
+        return FLASH_ACCESS_RESULT_ERROR;
     }
     return FLASH_ACCESS_RESULT_OK;
 }
@@ -426,8 +427,6 @@ bool FLASH_CompareMemory(flash_device_t sourceDeviceID, uint32_t sourceAddress,
                          flash_device_t destinationDeviceID, uint32_t destinationAddress,
                          uint32_t length)
 {
-	uint32_t endAddress = sourceAddress + length;
-
     if (FLASH_CheckValidAddressRange(sourceDeviceID, sourceAddress, length) != true)
     {
         return false;
@@ -438,59 +437,22 @@ bool FLASH_CompareMemory(flash_device_t sourceDeviceID, uint32_t sourceAddress,
         return false;
     }
 
-    if (sourceDeviceID == FLASH_SERIAL || destinationDeviceID == FLASH_SERIAL)
+    flash_copy_device_t source, destination;
+    if (!GetFlashCopyDevice(sourceDeviceID, &source) || !GetFlashCopyDevice(destinationDeviceID, &destination))
     {
-#ifdef USE_SERIAL_FLASH
-        /* Initialize SPI Flash */
-        sFLASH_Init();
-#endif
+        return false;
     }
 
-    /* Program source to destination */
-    while (sourceAddress < endAddress)
+    if (sourceDeviceID == FLASH_SERIAL || destinationDeviceID == FLASH_SERIAL)
     {
-    		uint32_t sourceDeviceData = 0;
-        if (sourceDeviceID == FLASH_INTERNAL)
-        {
-            /* Read data from internal flash source address */
-            sourceDeviceData = (*(__IO uint32_t*) sourceAddress);
-        }
-#ifdef USE_SERIAL_FLASH
-        else if (sourceDeviceID == FLASH_SERIAL)
-        {
-            /* Read data from serial flash source address */
-            sFLASH_ReadBuffer(serialFlashData, sourceAddress, 4);
-            sourceDeviceData = (uint32_t)(serialFlashData[0] | (serialFlashData[1] << 8) | (serialFlashData[2] << 16) | (serialFlashData[3] << 24));
-        }
-#endif
-
-        uint32_t destinationDeviceData = 0;
-        if (destinationDeviceID == FLASH_INTERNAL)
-        {
-            /* Read data from internal flash destination address */
-            destinationDeviceData = (*(__IO uint32_t*) destinationAddress);
-        }
 #ifdef USE_SERIAL_FLASH
-        else if (destinationDeviceID == FLASH_SERIAL)
-        {
-            /* Read data from serial flash destination address */
-            sFLASH_ReadBuffer(serialFlashData, destinationAddress, 4);
-            destinationDeviceData = (uint32_t)(serialFlashData[0] | (serialFlashData[1] << 8) | (serialFlashData[2] << 16) | (serialFlashData[3] << 24));
-        }
+        /* Initialize SPI Flash */
+        sFLASH_Init();
 #endif
-
-        if (sourceDeviceData != destinationDeviceData)
-        {
-            /* Failed comparison check */
-            return false;
-        }
-
-        sourceAddress += 4;
-        destinationAddress += 4;
     }
 
-    /* Passed comparison check */
-    return true;
+    /* Both ranges are read in blocks rather than word by word */
+    return Compare_FlashMemory_Impl(&source, sourceAddress, &destination, destinationAddress, length) == 0;
 }
 
 bool FLASH_AddToNextAvailableModulesSlot(flash_device_t sourceDeviceID, uint32_t sourceAddress,
@@ -646,9 +608,11 @@ bool FLASH_UpdateModules(void (*flashModulesCallback)(bool isUpdating))
         if (flashModulesCallback) {
             flashModulesCallback(true);
         }
-        // Copy memory from source to destination based on flash device id
+        // Copy memory from source to destination based on flash device id. Only the sectors that
+        // have changed are erased and programmed
         FLASH_CopyMemory(module->sourceDeviceID, module->sourceAddress, module->destinationDeviceID,
-                module->destinationAddress, module->length, module->module_function, module->flags);
+                module->destinationAddress, module->length, module->module_function,
+                module->flags | MODULE_COPY_DIFFERENTIAL);
         // Turn Off RGB_COLOR_MAGENTA toggling
         if (flashModulesCallback) {
             flashModulesCallback(false);
@@ -10,6 +10,7 @@ TARGET_SPARK_SRC_PATH = $(TARGET_SPARK_PATH)/src
 CSRC += $(TARGET_SPARK_SRC_PATH)/system_stm32f2xx.c
 CSRC += $(TARGET_SPARK_SRC_PATH)/hw_config.c
 CSRC += $(TARGET_SPARK_SRC_PATH)/flash_mal.c
+CSRC += $(TARGET_SPARK_SRC_PATH)/flash_copy_impl.c
 CSRC += $(TARGET_SPARK_SRC_PATH)/usb_bsp.c
 CSRC += $(TARGET_SPARK_SRC_PATH)/usbd_usr.c
 CSRC += $(TARGET_SPARK_SRC_PATH)/usbd_composite.c
@@ -139,6 +139,63 @@ private:
     size_t dataSize_;
 };
 
+/**
+ * Appender that only stores a window of the appended data, starting at the specified offset.
+ * The data outside of the window is discarded but counted, which allows producing a large
+ * document in portions of fixed size, e.g. for a block-wise transfer.
+ */
+class WindowAppender: public Appender {
+public:
+    WindowAppender(char* buf, size_t size, size_t offset) :
+            buf_(buf),
+            bufSize_(size),
+            offset_(offset),
+            dataSize_(0) {
+    }
+
+    using Appender::append;
+
+    virtual bool append(const uint8_t* data, size_t size) override {
+        // Copy the part of the data that overlaps with the window
+        const size_t begin = (dataSize_ > offset_) ? dataSize_ : offset_;
+        const size_t end = (dataSize_ + size < offset_ + bufSize_) ? dataSize_ + size : offset_ + bufSize_;
+        if (begin < end) {
+            memcpy(buf_ + (begin - offset_), data + (begin - dataSize_), end - begin);
+        }
+        dataSize_ += size;
+        return true;
+    }
+
+    char* buffer() const {
+        return buf_;
+    }
+
+    // Returns the number of bytes stored in the buffer
+    size_t windowSize() const {
+        if (dataSize_ <= offset_) {
+            return 0;
+        }
+        const size_t n = dataSize_ - offset_;
+        return (n < bufSize_) ? n : bufSize_;
+    }
+
+    // Returns the total size of the appended data
+    size_t dataSize() const {
+        return dataSize_;
+    }
+
+    // Returns true if there's more data after the window
+    bool hasMore() const {
+        return dataSize_ > offset_ + bufSize_;
+    }
+
+private:
+    char* const buf_;
+    const size_t bufSize_;
+    const size_t offset_;
+    size_t dataSize_;
+};
+
 } // namespace particle
 
 #endif // defined(__cplusplus)
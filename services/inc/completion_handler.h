@@ -24,7 +24,10 @@
 #include "spark_wiring_vector.h"
 #include "system_tick_hal.h"
 
+#include <algorithm>
+#include <functional>
 #include <limits>
+#include <cstdint>
 
 extern "C" {
 #endif // defined(__cplusplus)
@@ -233,7 +236,14 @@ private:
 };
 
 // Container class storing CompletionHandler instances arranged by key. This class manages handler
-// timeouts, see update() method for details
+// timeouts, see update() method for details.
+//
+// Handlers are looked up via a hash table, and their expiration times are tracked by a hierarchical
+// timer wheel: a handler is placed into a slot of the coarsest level at which its expiration time
+// differs from the current time, and is moved to finer levels as the time advances. Adding and
+// taking a handler take constant time, and update() only visits the handlers that expire or move
+// to a finer level of the wheel. A handler added with a key that is already in use replaces the
+// existing handler, which is then invoked with SYSTEM_ERROR_INTERNAL error
 template<typename KeyT>
 class CompletionHandlerMap {
 public:
@@ -241,21 +251,34 @@ public:
 
     explicit CompletionHandlerMap(system_tick_t defaultTimeout = 60000) :
             defaultTimeout_(defaultTimeout),
-            timeoutTicks_(MAX_TIMEOUT),
-            ticks_(0) {
+            now_(0),
+            freeNodes_(NIL),
+            count_(0) {
+        clearSlots();
     }
 
     bool addHandler(const KeyT& key, CompletionHandler&& handler, system_tick_t timeout) {
-        if (handler) {
-            const system_tick_t t = ticks_ + timeout; // Handler expiration time
-            if (handlers_.append(Handler(key, std::move(handler), t))) {
-                if (t < timeoutTicks_) {
-                    timeoutTicks_ = t; // Update nearest expiration time
-                }
-                return true;
-            }
+        if (!handler) {
+            return false;
         }
-        return false;
+        if (lists_.isEmpty() && !initLists()) {
+            return false;
+        }
+        if (count_ >= buckets_.size() && !rehash(buckets_.isEmpty() ? MIN_BUCKET_COUNT : buckets_.size() * 2)) {
+            return false;
+        }
+        const Index i = allocNode(key, std::move(handler), now_ + timeout);
+        if (i == NIL) {
+            return false;
+        }
+        // The existing handler is only replaced once the new one has been stored
+        CompletionHandler oldHandler = takeHandler(key);
+        Index& bucket = buckets_.at(bucketIndex(key));
+        nodes_.at(i).nextInBucket = bucket;
+        bucket = i;
+        schedule(i);
+        ++count_;
+        return true;
     }
 
     bool addHandler(const KeyT& key, CompletionHandler&& handler) {
@@ -264,49 +287,64 @@ public:
 
     CompletionHandler takeHandler(const KeyT& key) {
         CompletionHandler handler;
-        timeoutTicks_ = MAX_TIMEOUT;
-        int i = 0;
-        while (i < handlers_.size()) {
-            const Handler& h = handlers_.at(i);
-            if (h.key == key) {
-                handler = handlers_.takeAt(i).handler;
-                if (handlers_.isEmpty()) {
-                    ticks_ = 0;
+        if (count_ > 0) {
+            Index* p = &buckets_.at(bucketIndex(key));
+            while (*p != NIL) {
+                const Index i = *p;
+                Node& n = nodes_.at(i);
+                if (n.key == key) {
+                    *p = n.nextInBucket;
+                    unschedule(i);
+                    handler = std::move(n.handler);
+                    freeNode(i);
+                    --count_;
+                    break;
                 }
-            } else {
-                if (h.ticks < timeoutTicks_) {
-                    timeoutTicks_ = h.ticks;
-                }
-                ++i;
+                p = &n.nextInBucket;
             }
         }
         return handler;
     }
 
     bool hasHandler(const KeyT& key) const {
-        for (const Handler& h: handlers_) {
-            if (h.key == key) {
-                return true;
+        if (count_ > 0) {
+            Index i = buckets_.at(bucketIndex(key));
+            while (i != NIL) {
+                const Node& n = nodes_.at(i);
+                if (n.key == key) {
+                    return true;
+                }
+                i = n.nextInBucket;
             }
         }
         return false;
     }
 
     void clear() {
-        for (Handler& h: handlers_) {
-            h.handler.setError(SYSTEM_ERROR_ABORTED);
+        spark::Vector<Node> nodes(std::move(nodes_));
+        nodes_ = spark::Vector<Node>();
+        for (Index& i: buckets_) {
+            i = NIL;
+        }
+        for (Index& i: lists_) {
+            i = NIL;
+        }
+        clearSlots();
+        freeNodes_ = NIL;
+        count_ = 0;
+        now_ = 0;
+        // Handlers are invoked after the map has been reset, so that they can safely modify it
+        for (Node& n: nodes) {
+            n.handler.setError(SYSTEM_ERROR_ABORTED);
         }
-        handlers_.clear();
-        timeoutTicks_ = MAX_TIMEOUT;
-        ticks_ = 0;
     }
 
     int size() const {
-        return handlers_.size();
+        return count_;
     }
 
     bool isEmpty() const {
-        return handlers_.isEmpty();
+        return count_ == 0;
     }
 
     template<typename T>
@@ -325,62 +363,277 @@ public:
     // This method needs to be called periodically in order to invoke expired handlers.
     // `ticks` argument specifies a number of milliseconds passed since previous update
     int update(system_tick_t ticks) {
-        if (!handlers_.isEmpty()) {
-            ticks_ += ticks;
-            if (ticks_ >= timeoutTicks_) {
-                timeoutTicks_ = MAX_TIMEOUT;
-                int count = 0; // Number of expired handlers
-                int i = 0;
-                do {
-                    Handler& h = handlers_.at(i);
-                    if (ticks_ >= h.ticks) {
-                        // Remove expired handler
-                        CompletionHandler handler = handlers_.takeAt(i).handler;
-                        handler.setError(SYSTEM_ERROR_TIMEOUT);
-                        ++count;
-                    } else {
-                        // Update handler expiration time
-                        h.ticks -= ticks_;
-                        if (h.ticks < timeoutTicks_) {
-                            timeoutTicks_ = h.ticks;
-                        }
-                        ++i;
-                    }
-                } while (i < handlers_.size());
-                ticks_ = 0;
-                return count;
+        const uint64_t t = now_ + ticks;
+        int count = 0; // Number of expired handlers
+        for (;;) {
+            const uint64_t next = nextEventTime();
+            if (next > t) {
+                break;
             }
+            now_ = next;
+            count += processEvents();
         }
-        return 0;
+        now_ = t;
+        return count;
     }
 
     system_tick_t nearestTimeout() const {
-        return timeoutTicks_ - ticks_;
+        if (count_ == 0) {
+            return MAX_TIMEOUT;
+        }
+        // The nearest handler is in the first non-empty slot of the finest non-empty level
+        int list = OVERFLOW_LIST;
+        for (unsigned level = 0; level < LEVEL_COUNT; ++level) {
+            if (slots_[level]) {
+                list = level * SLOT_COUNT + __builtin_ctzll(slots_[level]);
+                break;
+            }
+        }
+        uint64_t t = std::numeric_limits<uint64_t>::max();
+        for (Index i = lists_.at(list); i != NIL; i = nodes_.at(i).next) {
+            t = std::min(t, nodes_.at(i).expires);
+        }
+        return std::min<uint64_t>(t - now_, MAX_TIMEOUT);
     }
 
 private:
-    struct Handler {
+    typedef uint16_t Index;
+
+    struct Node {
         KeyT key;
         CompletionHandler handler;
-        system_tick_t ticks; // Expiration time
+        uint64_t expires; // Expiration time
+        Index nextInBucket; // Next node in the hash bucket or in the list of free nodes
+        Index prev, next; // Adjacent nodes in the timer list
+        Index list; // Timer list
 
-        Handler(KeyT key, CompletionHandler handler, system_tick_t ticks) :
+        Node(KeyT key, CompletionHandler handler, uint64_t expires) :
                 key(std::move(key)),
                 handler(std::move(handler)),
-                ticks(ticks) {
+                expires(expires),
+                nextInBucket(NIL),
+                prev(NIL),
+                next(NIL),
+                list(NIL) {
         }
     };
 
+    static const Index NIL = std::numeric_limits<Index>::max();
+    static const int MIN_BUCKET_COUNT = 16;
+
+    // Each level of the wheel has 64 slots, so that a set of non-empty slots fits into a 64-bit mask
+    static const unsigned SLOT_BITS = 6;
+    static const unsigned SLOT_COUNT = 1 << SLOT_BITS;
+    static const unsigned LEVEL_COUNT = 4;
+    static const unsigned WHEEL_BITS = SLOT_BITS * LEVEL_COUNT; // ~4.6 hours
+
+    // Handlers expiring beyond the range of the wheel are kept in a separate list, which is
+    // rescheduled each time the wheel completes a full turn
+    static const int OVERFLOW_LIST = LEVEL_COUNT * SLOT_COUNT;
+    // Handlers being invoked by update()
+    static const int PENDING_LIST = OVERFLOW_LIST + 1;
+    static const int LIST_COUNT = PENDING_LIST + 1;
+
     const system_tick_t defaultTimeout_;
 
-    spark::Vector<Handler> handlers_;
-    system_tick_t timeoutTicks_; // Nearest handler expiration time
-    system_tick_t ticks_;
+    spark::Vector<Node> nodes_;
+    spark::Vector<Index> buckets_; // Hash table
+    spark::Vector<Index> lists_; // Timer lists
+    uint64_t slots_[LEVEL_COUNT]; // Non-empty slots of each level
+    uint64_t now_; // Current time
+    Index freeNodes_;
+    int count_;
+
+    bool initLists() {
+        if (!lists_.resize(LIST_COUNT)) {
+            return false;
+        }
+        lists_.fill(NIL);
+        return true;
+    }
+
+    void clearSlots() {
+        for (unsigned i = 0; i < LEVEL_COUNT; ++i) {
+            slots_[i] = 0;
+        }
+    }
+
+    int bucketIndex(const KeyT& key) const {
+        const uint32_t h = std::hash<KeyT>()(key);
+        return (h * 0x9e3779b1u) & (buckets_.size() - 1); // Fibonacci hashing
+    }
+
+    bool rehash(int bucketCount) {
+        spark::Vector<Index> buckets(bucketCount, NIL);
+        if (buckets.size() != bucketCount) {
+            return false;
+        }
+        std::swap(buckets_, buckets);
+        for (Index b: buckets) {
+            while (b != NIL) {
+                Node& n = nodes_.at(b);
+                const Index next = n.nextInBucket;
+                Index& bucket = buckets_.at(bucketIndex(n.key));
+                n.nextInBucket = bucket;
+                bucket = b;
+                b = next;
+            }
+        }
+        return true;
+    }
+
+    Index allocNode(const KeyT& key, CompletionHandler&& handler, uint64_t expires) {
+        if (freeNodes_ != NIL) {
+            const Index i = freeNodes_;
+            Node& n = nodes_.at(i);
+            freeNodes_ = n.nextInBucket;
+            n.key = key;
+            n.handler = std::move(handler);
+            n.expires = expires;
+            n.nextInBucket = NIL;
+            return i;
+        }
+        if (nodes_.size() >= NIL || !nodes_.append(Node(key, std::move(handler), expires))) {
+            return NIL;
+        }
+        return nodes_.size() - 1;
+    }
+
+    void freeNode(Index i) {
+        nodes_.at(i).nextInBucket = freeNodes_;
+        freeNodes_ = i;
+    }
+
+    void removeFromBucket(Index i) {
+        Index* p = &buckets_.at(bucketIndex(nodes_.at(i).key));
+        while (*p != i) {
+            p = &nodes_.at(*p).nextInBucket;
+        }
+        *p = nodes_.at(i).nextInBucket;
+    }
+
+    void pushToList(Index list, Index i) {
+        Node& n = nodes_.at(i);
+        Index& head = lists_.at(list);
+        n.list = list;
+        n.prev = NIL;
+        n.next = head;
+        if (head != NIL) {
+            nodes_.at(head).prev = i;
+        }
+        head = i;
+    }
+
+    // Adds a node to the wheel
+    void schedule(Index i) {
+        const uint64_t t = nodes_.at(i).expires;
+        const uint64_t diff = t ^ now_;
+        if (diff >> WHEEL_BITS) {
+            pushToList(OVERFLOW_LIST, i);
+            return;
+        }
+        const unsigned level = diff ? (63 - __builtin_clzll(diff)) / SLOT_BITS : 0;
+        const unsigned slot = (t >> (level * SLOT_BITS)) & (SLOT_COUNT - 1);
+        slots_[level] |= 1ull << slot;
+        pushToList(level * SLOT_COUNT + slot, i);
+    }
+
+    // Removes a node from the wheel
+    void unschedule(Index i) {
+        Node& n = nodes_.at(i);
+        if (n.prev != NIL) {
+            nodes_.at(n.prev).next = n.next;
+        } else {
+            lists_.at(n.list) = n.next;
+            if (n.next == NIL && n.list < OVERFLOW_LIST) {
+                slots_[n.list / SLOT_COUNT] &= ~(1ull << (n.list % SLOT_COUNT));
+            }
+        }
+        if (n.next != NIL) {
+            nodes_.at(n.next).prev = n.prev;
+        }
+    }
+
+    // Detaches a list and returns its first node
+    Index takeList(int list) {
+        Index& head = lists_.at(list);
+        const Index i = head;
+        head = NIL;
+        if (list < OVERFLOW_LIST) {
+            slots_[list / SLOT_COUNT] &= ~(1ull << (list % SLOT_COUNT));
+        }
+        return i;
+    }
+
+    // Returns the time of the next slot that needs to be processed
+    uint64_t nextEventTime() const {
+        uint64_t t = std::numeric_limits<uint64_t>::max();
+        for (unsigned level = 0; level < LEVEL_COUNT; ++level) {
+            if (slots_[level]) {
+                // Slots preceding the current one are empty, and so is the current slot of the higher
+                // levels, as its contents are moved to the lower levels when the slot is reached
+                const unsigned shift = level * SLOT_BITS;
+                const uint64_t base = (now_ >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+                t = std::min(t, base + ((uint64_t)__builtin_ctzll(slots_[level]) << shift));
+            }
+        }
+        if (lists_.size() > 0 && lists_.at(OVERFLOW_LIST) != NIL) {
+            t = std::min(t, ((now_ >> WHEEL_BITS) + 1) << WHEEL_BITS);
+        }
+        return t;
+    }
+
+    // Moves the handlers of the slots starting at the current time to the lower levels of the
+    // wheel, and invokes the expired handlers
+    int processEvents() {
+        if (!(now_ & ((1ull << WHEEL_BITS) - 1))) {
+            reschedule(takeList(OVERFLOW_LIST));
+        }
+        for (unsigned level = LEVEL_COUNT - 1; level > 0; --level) {
+            const unsigned shift = level * SLOT_BITS;
+            if (!(now_ & ((1ull << shift) - 1))) {
+                reschedule(takeList(level * SLOT_COUNT + ((now_ >> shift) & (SLOT_COUNT - 1))));
+            }
+        }
+        const unsigned slot = now_ & (SLOT_COUNT - 1);
+        if (!(slots_[0] & (1ull << slot))) {
+            return 0;
+        }
+        // Expired handlers may modify the map, so they are moved to a separate list first
+        Index i = takeList(slot);
+        while (i != NIL) {
+            const Index next = nodes_.at(i).next;
+            pushToList(PENDING_LIST, i);
+            i = next;
+        }
+        int count = 0;
+        while ((i = lists_.at(PENDING_LIST)) != NIL) {
+            unschedule(i);
+            removeFromBucket(i);
+            CompletionHandler handler = std::move(nodes_.at(i).handler);
+            freeNode(i);
+            --count_;
+            handler.setError(SYSTEM_ERROR_TIMEOUT);
+            ++count;
+        }
+        return count;
+    }
+
+    void reschedule(Index i) {
+        while (i != NIL) {
+            const Index next = nodes_.at(i).next;
+            schedule(i);
+            i = next;
+        }
+    }
 };
 
 template<typename KeyT>
 const system_tick_t CompletionHandlerMap<KeyT>::MAX_TIMEOUT;
 
+template<typename KeyT>
+const typename CompletionHandlerMap<KeyT>::Index CompletionHandlerMap<KeyT>::NIL;
+
 } // namespace particle
 
 #endif // defined(__cplusplus)
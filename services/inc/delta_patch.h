@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace particle {
+
+/*
+ * Binary delta format used for incremental firmware updates.
+ *
+ * A patch consists of a fixed-size header followed by a sequence of commands. All integers are
+ * stored in little endian byte order.
+ *
+ * Header (24 bytes):
+ *
+ *   magic (4 bytes): DELTA_PATCH_MAGIC
+ *   version (1 byte): DELTA_PATCH_VERSION
+ *   module function (1 byte): Function of the source module (`module_function_t`)
+ *   module index (1 byte): Index of the source module
+ *   reserved (1 byte)
+ *   source size (4 bytes): Size of the source image
+ *   source CRC (4 bytes): CRC-32 of the source image
+ *   target size (4 bytes): Size of the target image
+ *   target CRC (4 bytes): CRC-32 of the target image
+ *
+ * Commands:
+ *
+ *   END (0x00): End of the patch.
+ *   COPY (0x01) offset (4 bytes) length (4 bytes): Copies `length` bytes of the source image
+ *       starting at `offset` to the target image.
+ *   ADD (0x02) offset (4 bytes) length (4 bytes) data (`length` bytes): Adds the data bytes to
+ *       the respective bytes of the source image starting at `offset` (modulo 256) and writes the
+ *       result to the target image. This allows encoding the small differences in code that was
+ *       moved to another address with mostly zero bytes, which compress well.
+ *   INSERT (0x03) length (4 bytes) data (`length` bytes): Writes the data bytes to the target
+ *       image.
+ *
+ * CRC-32 is the one used by zlib (IEEE 802.3).
+ */
+const uint32_t DELTA_PATCH_MAGIC = 0x544c4450; // "PDLT"
+const uint8_t DELTA_PATCH_VERSION = 1;
+
+struct DeltaPatchHeader {
+    uint8_t moduleFunction;
+    uint8_t moduleIndex;
+    uint32_t sourceSize;
+    uint32_t sourceCrc;
+    uint32_t targetSize;
+    uint32_t targetCrc;
+};
+
+// Interface of an object providing the source image and receiving the reconstructed target image
+class DeltaPatchHandler {
+public:
+    virtual ~DeltaPatchHandler() = default;
+
+    // Called when the header of the patch is received. The handler needs to return a pointer to
+    // the source image, which needs to be at least `header.sourceSize` bytes long
+    virtual int source(const DeltaPatchHeader& header, const char** data) = 0;
+    // Called for each portion of the target image, in order
+    virtual int write(const char* data, size_t size) = 0;
+};
+
+// Streaming decoder for the delta format. The patch can be fed in portions of arbitrary size.
+// Memory usage is constant and doesn't depend on the size of the images
+class DeltaPatcher {
+public:
+    explicit DeltaPatcher(DeltaPatchHandler* handler);
+
+    // Processes a portion of the patch data. Returns 0 or an error code. The first error is
+    // sticky: all subsequent calls return the same error
+    int process(const char* data, size_t size);
+    // Verifies that the entire patch has been processed and the size and CRC of the target image
+    // match the ones specified in the header
+    int finish();
+    // Resets the decoder state
+    void reset();
+
+    size_t targetSize() const;
+    const DeltaPatchHeader& header() const;
+
+    // Updates a CRC-32 checksum. Start with 0
+    static uint32_t calcCrc32(uint32_t crc, const char* data, size_t size);
+
+private:
+    enum class State {
+        HEADER, // Receiving the header
+        COMMAND, // Receiving a command
+        DATA, // Receiving the data of an ADD or INSERT command
+        DONE // Received the END command
+    };
+
+    enum { HEADER_SIZE = 24 };
+
+    DeltaPatchHeader header_; // Patch header
+    DeltaPatchHandler* handler_; // Patch handler
+    const char* source_; // Source image
+    State state_; // Decoder state
+    char buf_[HEADER_SIZE]; // Buffer for the header and command arguments
+    size_t bufSize_; // Number of bytes in the buffer
+    uint8_t cmd_; // Current command
+    uint32_t srcOffs_; // Offset in the source image for the current ADD command
+    uint32_t dataLeft_; // Number of remaining data bytes of the current command
+    uint32_t targetSize_; // Number of bytes written to the target image
+    uint32_t targetCrc_; // CRC-32 of the target image
+    int error_; // Last error
+
+    int processData(const char* data, size_t size);
+    int parseHeader();
+    int parseCommand();
+    int writeTarget(const char* data, size_t size);
+    int checkSourceRange(uint32_t offs, uint32_t size) const;
+};
+
+inline size_t DeltaPatcher::targetSize() const {
+    return targetSize_;
+}
+
+inline const DeltaPatchHeader& DeltaPatcher::header() const {
+    return header_;
+}
+
+} // namespace particle
@@ -54,6 +54,10 @@
 #define DIAG_NAME_CLOUD_RATE_LIMITED_EVENTS "pub:limit"
 #define DIAG_NAME_SYSTEM_TOTAL_RAM "sys:tram"
 #define DIAG_NAME_SYSTEM_USED_RAM "sys:uram"
+#define DIAG_NAME_SYSTEM_LED_WAKEUPS "sys:ledwake"
+#define DIAG_NAME_SYSTEM_EVENT_QUEUE_DEPTH "sys:evtq"
+#define DIAG_NAME_SYSTEM_EVENT_HANDLER_LATENCY "sys:evtlat"
+#define DIAG_NAME_SYSTEM_ISR_TASK_QUEUE_MAX_SIZE "sys:isrqmax"
 
 #ifdef __cplusplus
 extern "C" {
@@ -95,12 +99,18 @@ typedef enum diag_id {
     DIAG_ID_CLOUD_RATE_LIMITED_EVENTS = 20, // pub:throttle
     DIAG_ID_SYSTEM_TOTAL_RAM = 25, // sys:tram
     DIAG_ID_SYSTEM_USED_RAM = 26, // sys:uram
+    DIAG_ID_SYSTEM_LED_WAKEUPS = 38, // sys:ledwake
+    DIAG_ID_SYSTEM_EVENT_QUEUE_DEPTH = 39, // sys:evtq
+    DIAG_ID_SYSTEM_EVENT_HANDLER_LATENCY = 40, // sys:evtlat
+    DIAG_ID_SYSTEM_ISR_TASK_QUEUE_MAX_SIZE = 41, // sys:isrqmax
     DIAG_ID_USER = 32768 // Base value for application-specific source IDs
 } diag_id;
 
 // Data types
 typedef enum diag_type {
-    DIAG_TYPE_INT = 1 // 32-bit integer
+    DIAG_TYPE_INT = 1, // 32-bit integer
+    DIAG_TYPE_STATS = 2, // Summary statistics (see `diag_stats`)
+    DIAG_TYPE_HISTOGRAM = 3 // Histogram (see `diag_histogram`)
 } diag_type;
 
 // Data source commands
@@ -111,7 +121,11 @@ typedef enum diag_source_cmd {
 // Service commands
 typedef enum diag_service_cmd {
     DIAG_SERVICE_CMD_RESET = 1, // Reset the service (this command is used only for testing purposes)
-    DIAG_SERVICE_CMD_START = 2 // Start the service
+    DIAG_SERVICE_CMD_START = 2, // Start the service
+    DIAG_SERVICE_CMD_SAMPLER_CONFIG = 3, // Configure the sampler (see `diag_sampler_config`)
+    DIAG_SERVICE_CMD_SAMPLER_UPDATE = 4, // Record a sample if the sampling period has elapsed (see `diag_sampler_update`)
+    DIAG_SERVICE_CMD_SAMPLER_ENCODE = 5, // Encode the oldest recorded samples (see `diag_sampler_encode`)
+    DIAG_SERVICE_CMD_SAMPLER_COMMIT = 6 // Remove the samples encoded by the last DIAG_SERVICE_CMD_SAMPLER_ENCODE command
 } diag_service_cmd;
 
 typedef struct diag_source diag_source;
@@ -136,6 +150,47 @@ typedef struct diag_source_get_cmd_data {
     size_t data_size; // Buffer size
 } diag_source_get_cmd_data;
 
+// Summary statistics of a series of integer values (DIAG_TYPE_STATS)
+typedef struct diag_stats {
+    int32_t min; // Minimum value
+    int32_t max; // Maximum value
+    int32_t avg; // Average value
+    uint32_t count; // Number of values
+} diag_stats;
+
+// Histogram of a series of integer values (DIAG_TYPE_HISTOGRAM). This structure is followed by
+// `bucket_count` 32-bit counters. Values below the range of the histogram are counted in the first
+// bucket, values above the range are counted in the last bucket
+typedef struct diag_histogram {
+    int32_t bucket_min; // Lower bound of the first bucket
+    int32_t bucket_width; // Width of a bucket
+    uint16_t bucket_count; // Number of buckets
+    uint16_t reserved; // Reserved (should be set to 0)
+} diag_histogram;
+
+typedef struct diag_sampler_config {
+    uint16_t size; // Size of this structure
+    uint16_t source_count; // Number of data sources (0 disables the sampler)
+    const uint16_t* source_ids; // IDs of the data sources. Only DIAG_TYPE_INT sources can be sampled
+    uint32_t period; // Sampling period in milliseconds
+    size_t buffer_size; // Size of the sample buffer in bytes
+} diag_sampler_config;
+
+typedef struct diag_sampler_update {
+    uint16_t size; // Size of this structure
+    uint16_t reserved; // Reserved (should be set to 0)
+    uint32_t time; // Current time in milliseconds
+} diag_sampler_update;
+
+typedef struct diag_sampler_encode {
+    uint16_t size; // Size of this structure
+    uint16_t reserved; // Reserved (should be set to 0)
+    char* buffer; // Destination buffer
+    size_t buffer_size; // Buffer size
+    size_t data_size; // Number of bytes written (set by the service)
+    size_t sample_count; // Number of samples written (set by the service)
+} diag_sampler_encode;
+
 // Registers a new data source. Note that in order for the data source to be registered, the service
 // needs to be in its initial stopped state
 int diag_register_source(const diag_source* src, void* reserved);
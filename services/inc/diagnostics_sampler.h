@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace particle {
+
+/**
+ * Records values of integer diagnostic sources at a fixed period.
+ *
+ * Samples are stored in a ring buffer allocated when the sampler is configured. When the buffer
+ * is full, the oldest sample is overwritten. Recorded samples are encoded in the following format:
+ *
+ * ```
+ * varint   Format version (1)
+ * varint   Number of sources (N)
+ * varint   Source IDs (N times)
+ * varint   Number of samples (M)
+ * varint   Sampling period in milliseconds
+ * varint   Number of samples overwritten since the last committed batch
+ * varint   Time of the first sample in milliseconds
+ * zigzag   Difference between the actual and nominal time between samples (M - 1 times)
+ * zigzag   For each source: first value, followed by differences between consecutive values (M - 1 times)
+ * ```
+ *
+ * Varints use the LEB128 encoding. Signed values are zigzag-encoded, so that slowly changing
+ * values take a single byte per sample.
+ */
+class DiagnosticsSampler {
+public:
+    static const unsigned FORMAT_VERSION = 1;
+
+    DiagnosticsSampler();
+    ~DiagnosticsSampler();
+
+    /**
+     * Configures the sampler. Previously recorded samples are discarded.
+     *
+     * @param ids Source IDs.
+     * @param count Number of sources. Passing 0 disables the sampler.
+     * @param period Sampling period in milliseconds.
+     * @param bufferSize Size of the sample buffer in bytes.
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int init(const uint16_t* ids, size_t count, uint32_t period, size_t bufferSize);
+    void reset();
+
+    /**
+     * Records a sample if the sampling period has elapsed.
+     *
+     * @return 1 if a sample was recorded, 0 if not, or a negative result code in case of an error.
+     */
+    int update(uint32_t time);
+    /**
+     * Records a sample unconditionally.
+     */
+    int sample(uint32_t time);
+
+    /**
+     * Encodes as many of the oldest recorded samples as fit in the buffer. The encoded samples are
+     * kept in the sampler until `commit()` is called, so that the same batch can be encoded again
+     * if it doesn't reach its destination.
+     *
+     * @param buf Destination buffer.
+     * @param size Buffer size.
+     * @param[out] sampleCount Number of encoded samples.
+     * @return Number of bytes written, or a negative result code in case of an error.
+     */
+    int encode(char* buf, size_t size, size_t* sampleCount = nullptr);
+    /**
+     * Removes the samples encoded by the last call to `encode()`.
+     */
+    void commit();
+
+    size_t sampleCount() const;
+    size_t capacity() const;
+    size_t sourceCount() const;
+    uint32_t period() const;
+    unsigned overwrittenCount() const;
+
+private:
+    std::unique_ptr<uint16_t[]> ids_;
+    std::unique_ptr<int32_t[]> rows_; // Each row is a timestamp followed by a value for each source
+    size_t srcCount_;
+    size_t capacity_;
+    size_t first_;
+    size_t count_;
+    size_t pending_; // Number of samples encoded but not committed yet
+    uint32_t period_;
+    uint32_t nextTime_;
+    unsigned overwritten_;
+    bool sampled_;
+
+    int32_t* row(size_t index) const;
+    size_t encodeSamples(char* buf, size_t size, size_t sampleCount) const;
+};
+
+inline size_t DiagnosticsSampler::sampleCount() const {
+    return count_;
+}
+
+inline size_t DiagnosticsSampler::capacity() const {
+    return capacity_;
+}
+
+inline size_t DiagnosticsSampler::sourceCount() const {
+    return srcCount_;
+}
+
+inline uint32_t DiagnosticsSampler::period() const {
+    return period_;
+}
+
+inline unsigned DiagnosticsSampler::overwrittenCount() const {
+    return overwritten_;
+}
+
+} // namespace particle
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace particle {
+
+/*
+ * Running digest of a firmware image that is being written to flash.
+ *
+ * The digest is updated with each portion of the image as it is written, so that the image
+ * doesn't need to be read back from flash in order to verify its integrity. A module image ends
+ * with a 4-byte CRC, which is why the CRC-32 of all data except the last 4 bytes is maintained.
+ *
+ * The portions that failed to be written, or were written more than once, are recorded as
+ * regions that need to be read back and verified separately. The digest becomes invalid if the
+ * image is not written in order, or if there are too many such regions.
+ */
+class ImageDigest {
+public:
+    struct Region {
+        uint32_t address;
+        uint32_t size;
+        uint32_t crc; // CRC-32 of the data that was supposed to be written
+    };
+
+    enum { MAX_REGIONS = 8 };
+
+    ImageDigest();
+
+    // Starts a new image at the specified address
+    void reset(uint32_t address);
+    // Updates the digest with a portion of the image. `written` is false if the data could not be
+    // written to flash
+    void update(uint32_t address, const char* data, size_t size, bool written);
+    // Invalidates the digest
+    void invalidate();
+
+    // Returns true if the digest can be used to verify the image
+    bool isValid() const;
+
+    uint32_t address() const;
+    // Number of bytes covered by the CRC, i.e. the size of the image without the last 4 bytes
+    uint32_t size() const;
+    // CRC-32 of the image without the last 4 bytes
+    uint32_t crc() const;
+
+    // Regions that need to be read back
+    const Region* regions() const;
+    size_t regionCount() const;
+
+private:
+    Region regions_[MAX_REGIONS];
+    size_t regionCount_;
+    uint32_t address_; // Start address of the image
+    uint32_t size_; // Number of bytes covered by the CRC
+    uint32_t crc_;
+    uint8_t tail_[4]; // Last 4 bytes of the image
+    size_t tailSize_;
+    bool valid_;
+
+    void append(const char* data, size_t size);
+    void addRegion(uint32_t address, const char* data, size_t size);
+};
+
+inline void ImageDigest::invalidate() {
+    valid_ = false;
+}
+
+inline bool ImageDigest::isValid() const {
+    return valid_;
+}
+
+inline uint32_t ImageDigest::address() const {
+    return address_;
+}
+
+inline uint32_t ImageDigest::size() const {
+    return size_;
+}
+
+inline uint32_t ImageDigest::crc() const {
+    return crc_;
+}
+
+inline const ImageDigest::Region* ImageDigest::regions() const {
+    return regions_;
+}
+
+inline size_t ImageDigest::regionCount() const {
+    return regionCount_;
+}
+
+} // namespace particle
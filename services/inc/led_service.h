@@ -63,6 +63,12 @@ typedef struct LEDStatusData {
     };
 } LEDStatusData;
 
+// Value returned by led_process() when the LED doesn't need to be updated until its state changes
+#define LED_UPDATE_IDLE ((system_tick_t)0xffffffff)
+
+// Update interval for custom patterns, in milliseconds
+#define LED_CUSTOM_PATTERN_UPDATE_INTERVAL 25
+
 // Starts/stops LED status indication
 void led_set_status_active(LEDStatusData* status, int active, void* reserved);
 
@@ -80,6 +86,27 @@ int led_update_enabled(void* reserved);
 // requires real time LED updates
 void led_update(system_tick_t ticks, LEDStatusData* status, void* reserved);
 
+// Event-driven alternative to led_update(). Updates LED color according to a number of ticks passed
+// since previous update and returns a number of milliseconds until the next scheduled change of the
+// LED color, or LED_UPDATE_IDLE if the LED doesn't need to be updated until the LED state changes
+// (e.g. when a solid color is shown)
+system_tick_t led_process(system_tick_t ticks, void* reserved);
+
+// Returns 1 if the LED state has changed since the last call to led_process(), or 0 otherwise.
+// In this case led_process() needs to be called as soon as possible
+int led_update_pending(void* reserved);
+
+// Notifies the LED service that parameters of an active status, or the LED brightness, have changed
+void led_notify_changed(void* reserved);
+
+// Callback invoked when led_process() needs to be called before its next scheduled update. The
+// callback can be invoked from an ISR
+typedef void (*led_wakeup_handler_fn)(void* data);
+
+// Sets a callback that is invoked whenever the LED state changes. This allows running led_process()
+// from a one-shot timer, instead of polling led_update_pending()
+void led_set_wakeup_handler(led_wakeup_handler_fn fn, void* data, void* reserved);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -19,6 +19,7 @@
 #define SERVICES_RINGBUFFER_H
 
 #include <cstddef>
+#include <algorithm>
 #include "system_error.h"
 #include "check.h"
 
@@ -155,18 +156,16 @@ inline ssize_t RingBuffer<T>::put(const T* v, size_t size) {
     CHECK_TRUE(v && size, SYSTEM_ERROR_INVALID_ARGUMENT);
     CHECK_TRUE(space() >= (ssize_t)size, SYSTEM_ERROR_TOO_LARGE);
 
-    size_t head = head_;
+    const size_t head = head_;
 
     if (v != nullptr) {
-        for (size_t i = 0; i < size; i++) {
-            buffer_[head] = v[i];
-            head = wrap(head + 1, curSize_);
-        }
-    } else {
-        head = wrap(head + size, curSize_);
+        // Copy the data in at most two contiguous blocks
+        const size_t n = std::min(size, curSize_ - head);
+        std::copy(v, v + n, buffer_ + head);
+        std::copy(v + n, v + size, buffer_);
     }
 
-    head_ = head;
+    head_ = wrap(head + size, curSize_);
     full_ = (head_ == tail_);
 
     return size;
@@ -184,18 +183,15 @@ inline ssize_t RingBuffer<T>::get(T* v, size_t size) {
     }
     CHECK_TRUE(data() >= (ssize_t)size, SYSTEM_ERROR_TOO_LARGE);
 
-    size_t tail = tail_;
+    const size_t tail = tail_;
 
     if (v != nullptr) {
-        for (size_t i = 0; i < size; i++) {
-            v[i] = buffer_[tail];
-            tail = wrap((tail + 1), curSize_);
-        }
-    } else {
-        tail = wrap(tail + size, curSize_);
+        const size_t n = std::min(size, curSize_ - tail);
+        std::copy(buffer_ + tail, buffer_ + tail + n, v);
+        std::copy(buffer_, buffer_ + size - n, v + n);
     }
 
-    tail_ = tail;
+    tail_ = wrap(tail + size, curSize_);
     full_ = false;
 
     return size;
@@ -214,9 +210,10 @@ inline ssize_t RingBuffer<T>::peek(T* v, size_t size) {
     CHECK_TRUE(data() >= (ssize_t)size, SYSTEM_ERROR_TOO_LARGE);
     CHECK_TRUE(v, SYSTEM_ERROR_INVALID_ARGUMENT);
 
-    for (size_t i = 0; i < size; i++) {
-        v[i] = buffer_[wrap((tail_ + i), curSize_)];
-    }
+    const size_t tail = tail_;
+    const size_t n = std::min(size, curSize_ - tail);
+    std::copy(buffer_ + tail, buffer_ + tail + n, v);
+    std::copy(buffer_, buffer_ + size - n, v + n);
 
     return size;
 }
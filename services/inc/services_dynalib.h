@@ -110,6 +110,13 @@ DYNALIB_FN(55, services, pb_encode_varint, bool(pb_ostream_t*, pb_uint64_t))
 # define BASE_IDX 40
 #endif
 
+DYNALIB_FN(BASE_IDX + 0, services, led_process, system_tick_t(system_tick_t, void*))
+DYNALIB_FN(BASE_IDX + 1, services, led_update_pending, int(void*))
+DYNALIB_FN(BASE_IDX + 2, services, led_notify_changed, void(void*))
+DYNALIB_FN(BASE_IDX + 3, services, led_set_wakeup_handler, void(led_wakeup_handler_fn, void*, void*))
+
 DYNALIB_END(services)
 
+#undef BASE_IDX
+
 #endif	/* SERVICES_DYNALIB_H */
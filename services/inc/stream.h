@@ -42,6 +42,14 @@ public:
     virtual int skip(size_t size) = 0;
     virtual int availForRead() = 0;
 
+    // Returns a pointer to a contiguous block of buffered data without copying it. The block remains
+    // valid until it's released with commitRead(); acquiring the data again without committing it
+    // returns the same block. Returns the size of the block, 0 if no data is available, or
+    // SYSTEM_ERROR_NOT_SUPPORTED if the stream doesn't support zero-copy reading
+    virtual int acquireRead(const char** data);
+    // Consumes `size` bytes of the block returned by acquireRead()
+    virtual int commitRead(size_t size);
+
     int readAll(char* data, size_t size, unsigned timeout = 0);
     int skipAll(size_t size, unsigned timeout = 0);
 };
@@ -19,16 +19,25 @@
 #define SERVICES_TLV_FILE_H
 
 #include "filesystem.h"
+#include "spark_wiring_vector.h"
 #include <stdio.h>
 
 namespace particle { namespace services { namespace settings {
 
 static constexpr uint32_t TLV_FILE_MAGICK = 0x714f11e5;
+/* Magic number of a file containing records written in the log mode. Older firmware versions
+ * don't recognize it and start with an empty file instead of reading superseded or deleted values
+ */
+static constexpr uint32_t TLV_FILE_LOG_MAGICK = 0x714f11e6;
 static constexpr uint32_t TLV_HEADER_MAGICK = 0x4ead;
 
+/* Default total size of superseded records at which a file in the log mode is compacted */
+static constexpr size_t TLV_FILE_DEFAULT_COMPACT_THRESHOLD = 4096;
+
 class TlvFile {
 public:
-    TlvFile(const char* path);
+    /* If `fs` is not specified, the default filesystem instance is used */
+    explicit TlvFile(const char* path, filesystem_t* fs = nullptr);
     ~TlvFile();
 
     int init();
@@ -47,6 +56,20 @@ public:
     int add(uint16_t key, const uint8_t* value, uint16_t length);
     int del(uint16_t key, int index = -1);
 
+    /* Removes superseded records from the file */
+    int compact();
+
+    /* In the log mode, set() and del() append a record superseding all previous values of the key
+     * instead of rewriting the file. The file is compacted once the superseded records take more
+     * than `compactThreshold` bytes. Only a compacted file can be read by older firmware versions,
+     * see TLV_FILE_LOG_MAGICK.
+     */
+    void logMode(bool enabled, size_t compactThreshold = TLV_FILE_DEFAULT_COMPACT_THRESHOLD);
+    bool logMode() const;
+
+    /* Total size of superseded records */
+    size_t staleSize() const;
+
 private:
     struct FileFooter {
         uint32_t reserved;  /* CRC32? */
@@ -61,10 +84,24 @@ private:
         uint16_t magick;
         uint16_t key;
         uint16_t length;
-        uint16_t reserved;
+        uint16_t flags;
     } __attribute__((__packed__));
     static_assert(sizeof(TlvHeader) == sizeof(uint32_t) * 2, "sizeof(TlvHeader) != 8");
 
+    enum TlvFlag {
+        /* Supersedes all previous records with the same key */
+        TLV_FLAG_REPLACE = 0x0001,
+        /* Supersedes all previous records with the same key and has no value of its own */
+        TLV_FLAG_DELETE = 0x0002
+    };
+
+    /* Location of a live record in the file */
+    struct IndexEntry {
+        uint32_t pos;
+        uint16_t key;
+        uint16_t length;
+    };
+
 private:
     lfs_t* lfs();
 
@@ -75,6 +112,12 @@ private:
     int mkdir(char* dir);
 
     ssize_t find(uint16_t key, int index, uint16_t* dataSize);
+    int findEntry(uint16_t key, int index);
+    int buildIndex();
+    int append(uint16_t key, const uint8_t* value, uint16_t length, uint16_t flags);
+    int rewrite(int key, int index);
+    int copy(lfs_file_t* src, size_t srcPos, size_t destPos, size_t length, uint8_t* buf, size_t bufSize);
+    size_t copyBufferSize();
     int readFooter(FileFooter& footer);
 
     ssize_t seek(ssize_t offset, int whence = SEEK_SET);
@@ -87,6 +130,13 @@ private:
     bool open_ = false;
     filesystem_t* fs_ = nullptr;
     lfs_file_t file_ = {};
+
+    spark::Vector<IndexEntry> index_;
+    bool indexValid_ = false;
+    size_t staleSize_ = 0;
+    ssize_t tornPos_ = -1; /* Position of an incomplete record at the end of the file */
+    bool logMode_ = false;
+    size_t compactThreshold_ = TLV_FILE_DEFAULT_COMPACT_THRESHOLD;
 };
 
 } } } /* namespace particle::services::settings */
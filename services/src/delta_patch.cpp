@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logging.h"
+LOG_SOURCE_CATEGORY("delta")
+
+#include "delta_patch.h"
+
+#include "system_error.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace particle {
+
+namespace {
+
+enum Command {
+    END = 0x00,
+    COPY = 0x01,
+    ADD = 0x02,
+    INSERT = 0x03
+};
+
+// Size of the buffer used to apply the ADD command
+const size_t ADD_BUF_SIZE = 64;
+
+// CRC-32 lookup table for 4-bit indices
+const uint32_t CRC32_TABLE[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+inline uint32_t readUint32Le(const char* data) {
+    const uint8_t* d = (const uint8_t*)data;
+    return (uint32_t)d[0] | ((uint32_t)d[1] << 8) | ((uint32_t)d[2] << 16) | ((uint32_t)d[3] << 24);
+}
+
+// Returns the size of a command including its fixed-size arguments
+inline size_t commandSize(uint8_t cmd) {
+    switch (cmd) {
+    case END:
+        return 1;
+    case COPY:
+    case ADD:
+        return 9;
+    case INSERT:
+        return 5;
+    default:
+        return 0;
+    }
+}
+
+} // unnamed
+
+DeltaPatcher::DeltaPatcher(DeltaPatchHandler* handler) :
+        handler_(handler) {
+    reset();
+}
+
+int DeltaPatcher::process(const char* data, size_t size) {
+    if (error_ < 0) {
+        return error_;
+    }
+    const int ret = processData(data, size);
+    if (ret < 0) {
+        error_ = ret;
+    }
+    return ret;
+}
+
+int DeltaPatcher::finish() {
+    if (error_ < 0) {
+        return error_;
+    }
+    if (state_ != State::DONE) {
+        LOG(ERROR, "Incomplete patch");
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    if (targetSize_ != header_.targetSize || targetCrc_ != header_.targetCrc) {
+        LOG(ERROR, "Target image mismatch");
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    return 0;
+}
+
+void DeltaPatcher::reset() {
+    header_ = DeltaPatchHeader();
+    source_ = nullptr;
+    state_ = State::HEADER;
+    bufSize_ = 0;
+    cmd_ = END;
+    srcOffs_ = 0;
+    dataLeft_ = 0;
+    targetSize_ = 0;
+    targetCrc_ = 0;
+    error_ = 0;
+}
+
+uint32_t DeltaPatcher::calcCrc32(uint32_t crc, const char* data, size_t size) {
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= (uint8_t)data[i];
+        crc = (crc >> 4) ^ CRC32_TABLE[crc & 0x0f];
+        crc = (crc >> 4) ^ CRC32_TABLE[crc & 0x0f];
+    }
+    return ~crc;
+}
+
+int DeltaPatcher::processData(const char* data, size_t size) {
+    while (size > 0) {
+        switch (state_) {
+        case State::HEADER:
+        case State::COMMAND: {
+            size_t needed = HEADER_SIZE;
+            if (state_ == State::COMMAND) {
+                if (bufSize_ == 0) {
+                    needed = commandSize(*data);
+                    if (needed == 0) {
+                        LOG(ERROR, "Unknown command: 0x%02x", (unsigned)(uint8_t)*data);
+                        return SYSTEM_ERROR_BAD_DATA;
+                    }
+                } else {
+                    needed = commandSize(buf_[0]);
+                }
+            }
+            const size_t n = std::min(needed - bufSize_, size);
+            memcpy(buf_ + bufSize_, data, n);
+            bufSize_ += n;
+            data += n;
+            size -= n;
+            if (bufSize_ == needed) {
+                const int ret = (state_ == State::HEADER) ? parseHeader() : parseCommand();
+                if (ret < 0) {
+                    return ret;
+                }
+                bufSize_ = 0;
+            }
+            break;
+        }
+        case State::DATA: {
+            const size_t n = std::min((size_t)dataLeft_, size);
+            if (cmd_ == ADD) {
+                char buf[ADD_BUF_SIZE];
+                for (size_t offs = 0; offs < n;) {
+                    const size_t m = std::min(n - offs, sizeof(buf));
+                    for (size_t i = 0; i < m; ++i) {
+                        buf[i] = source_[srcOffs_ + i] + data[offs + i];
+                    }
+                    const int ret = writeTarget(buf, m);
+                    if (ret < 0) {
+                        return ret;
+                    }
+                    srcOffs_ += m;
+                    offs += m;
+                }
+            } else { // INSERT
+                const int ret = writeTarget(data, n);
+                if (ret < 0) {
+                    return ret;
+                }
+            }
+            data += n;
+            size -= n;
+            dataLeft_ -= n;
+            if (dataLeft_ == 0) {
+                state_ = State::COMMAND;
+            }
+            break;
+        }
+        case State::DONE:
+        default: {
+            LOG(ERROR, "Unexpected data after the end of the patch");
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        }
+    }
+    return 0;
+}
+
+int DeltaPatcher::parseHeader() {
+    if (readUint32Le(buf_) != DELTA_PATCH_MAGIC || (uint8_t)buf_[4] != DELTA_PATCH_VERSION) {
+        LOG(ERROR, "Invalid patch header");
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    header_.moduleFunction = buf_[5];
+    header_.moduleIndex = buf_[6];
+    header_.sourceSize = readUint32Le(buf_ + 8);
+    header_.sourceCrc = readUint32Le(buf_ + 12);
+    header_.targetSize = readUint32Le(buf_ + 16);
+    header_.targetCrc = readUint32Le(buf_ + 20);
+    const char* source = nullptr;
+    const int ret = handler_->source(header_, &source);
+    if (ret < 0) {
+        return ret;
+    }
+    if (!source) {
+        return SYSTEM_ERROR_NOT_FOUND;
+    }
+    // Make sure the patch is applied to the same image it was created for
+    if (calcCrc32(0, source, header_.sourceSize) != header_.sourceCrc) {
+        LOG(ERROR, "Source image mismatch");
+        return SYSTEM_ERROR_NOT_FOUND;
+    }
+    source_ = source;
+    state_ = State::COMMAND;
+    return 0;
+}
+
+int DeltaPatcher::parseCommand() {
+    cmd_ = buf_[0];
+    switch (cmd_) {
+    case END: {
+        state_ = State::DONE;
+        break;
+    }
+    case COPY: {
+        const uint32_t offs = readUint32Le(buf_ + 1);
+        const uint32_t size = readUint32Le(buf_ + 5);
+        const int ret = checkSourceRange(offs, size);
+        if (ret < 0) {
+            return ret;
+        }
+        return writeTarget(source_ + offs, size);
+    }
+    case ADD: {
+        srcOffs_ = readUint32Le(buf_ + 1);
+        dataLeft_ = readUint32Le(buf_ + 5);
+        const int ret = checkSourceRange(srcOffs_, dataLeft_);
+        if (ret < 0) {
+            return ret;
+        }
+        if (dataLeft_ > 0) {
+            state_ = State::DATA;
+        }
+        break;
+    }
+    case INSERT: {
+        dataLeft_ = readUint32Le(buf_ + 1);
+        if (dataLeft_ > 0) {
+            state_ = State::DATA;
+        }
+        break;
+    }
+    default:
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    return 0;
+}
+
+int DeltaPatcher::writeTarget(const char* data, size_t size) {
+    if (size > header_.targetSize - targetSize_) {
+        LOG(ERROR, "Target image is too large");
+        return SYSTEM_ERROR_OUT_OF_RANGE;
+    }
+    if (size == 0) {
+        return 0;
+    }
+    const int ret = handler_->write(data, size);
+    if (ret < 0) {
+        return ret;
+    }
+    targetCrc_ = calcCrc32(targetCrc_, data, size);
+    targetSize_ += size;
+    return 0;
+}
+
+int DeltaPatcher::checkSourceRange(uint32_t offs, uint32_t size) const {
+    if (offs > header_.sourceSize || size > header_.sourceSize - offs) {
+        LOG(ERROR, "Invalid source range");
+        return SYSTEM_ERROR_OUT_OF_RANGE;
+    }
+    return 0;
+}
+
+} // particle
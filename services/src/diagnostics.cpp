@@ -16,16 +16,63 @@
  */
 
 #include "diagnostics.h"
+#include "diagnostics_sampler.h"
 
 #include "spark_wiring_vector.h"
 
 #include "system_error.h"
 
+#if PLATFORM_THREADING
+#include "concurrent_hal.h"
+#endif
+
 #include <algorithm>
+#include <mutex>
 
 namespace {
 
 using namespace spark;
+using particle::DiagnosticsSampler;
+
+#if PLATFORM_THREADING
+
+// The sampler is configured from the application thread and updated from the system thread
+class SamplerMutex {
+public:
+    SamplerMutex() :
+            mutex_(nullptr) {
+        os_mutex_create(&mutex_);
+    }
+
+    ~SamplerMutex() {
+        os_mutex_destroy(mutex_);
+    }
+
+    void lock() {
+        os_mutex_lock(mutex_);
+    }
+
+    void unlock() {
+        os_mutex_unlock(mutex_);
+    }
+
+private:
+    os_mutex_t mutex_;
+};
+
+#else
+
+// The application and the system run in the same thread
+class SamplerMutex {
+public:
+    void lock() {
+    }
+
+    void unlock() {
+    }
+};
+
+#endif // !PLATFORM_THREADING
 
 class Diagnostics {
 public:
@@ -78,14 +125,54 @@ public:
     int command(int cmd, void* data) {
         switch (cmd) {
 #if PLATFORM_ID == 3
-        case DIAG_SERVICE_CMD_RESET:
+        case DIAG_SERVICE_CMD_RESET: {
+            std::lock_guard<SamplerMutex> lock(samplerMutex_);
             srcs_.clear();
+            sampler_.reset();
             started_ = 0;
             break;
+        }
 #endif
         case DIAG_SERVICE_CMD_START:
             started_ = 1;
             break;
+        case DIAG_SERVICE_CMD_SAMPLER_CONFIG: {
+            const auto d = (const diag_sampler_config*)data;
+            if (!d) {
+                return SYSTEM_ERROR_INVALID_ARGUMENT;
+            }
+            std::lock_guard<SamplerMutex> lock(samplerMutex_);
+            return sampler_.init(d->source_ids, d->source_count, d->period, d->buffer_size);
+        }
+        case DIAG_SERVICE_CMD_SAMPLER_UPDATE: {
+            const auto d = (const diag_sampler_update*)data;
+            if (!d) {
+                return SYSTEM_ERROR_INVALID_ARGUMENT;
+            }
+            if (!started_) {
+                return SYSTEM_ERROR_INVALID_STATE;
+            }
+            std::lock_guard<SamplerMutex> lock(samplerMutex_);
+            return sampler_.update(d->time);
+        }
+        case DIAG_SERVICE_CMD_SAMPLER_ENCODE: {
+            const auto d = (diag_sampler_encode*)data;
+            if (!d) {
+                return SYSTEM_ERROR_INVALID_ARGUMENT;
+            }
+            std::lock_guard<SamplerMutex> lock(samplerMutex_);
+            const int ret = sampler_.encode(d->buffer, d->buffer_size, &d->sample_count);
+            if (ret < 0) {
+                return ret;
+            }
+            d->data_size = ret;
+            break;
+        }
+        case DIAG_SERVICE_CMD_SAMPLER_COMMIT: {
+            std::lock_guard<SamplerMutex> lock(samplerMutex_);
+            sampler_.commit();
+            break;
+        }
         default:
             return SYSTEM_ERROR_NOT_SUPPORTED;
         }
@@ -99,6 +186,8 @@ public:
 
 private:
     Vector<const diag_source*> srcs_;
+    DiagnosticsSampler sampler_;
+    SamplerMutex samplerMutex_;
     volatile uint8_t started_;
 
     Diagnostics() :
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "diagnostics_sampler.h"
+
+#include "diagnostics.h"
+#include "system_error.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace particle {
+
+namespace {
+
+class Encoder {
+public:
+    Encoder(char* buf, size_t size) :
+            buf_(buf),
+            size_(size),
+            pos_(0) {
+    }
+
+    void writeVarint(uint64_t val) {
+        do {
+            uint8_t b = val & 0x7f;
+            val >>= 7;
+            if (val) {
+                b |= 0x80;
+            }
+            if (pos_ < size_) {
+                buf_[pos_] = b;
+            }
+            ++pos_;
+        } while (val);
+    }
+
+    void writeZigzag(int64_t val) {
+        writeVarint(((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+    }
+
+    // Returns the number of bytes that would have been written if the buffer was large enough
+    size_t size() const {
+        return pos_;
+    }
+
+private:
+    char* buf_;
+    size_t size_;
+    size_t pos_;
+};
+
+int readSource(uint16_t id, int32_t* val) {
+    const diag_source* src = nullptr;
+    int ret = diag_get_source(id, &src, nullptr);
+    if (ret != SYSTEM_ERROR_NONE) {
+        return ret;
+    }
+    if (src->type != DIAG_TYPE_INT) {
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+    diag_source_get_cmd_data d = {};
+    d.size = sizeof(d);
+    d.data = val;
+    d.data_size = sizeof(int32_t);
+    return src->callback(src, DIAG_SOURCE_CMD_GET, &d);
+}
+
+} // namespace
+
+DiagnosticsSampler::DiagnosticsSampler() :
+        srcCount_(0),
+        capacity_(0),
+        first_(0),
+        count_(0),
+        pending_(0),
+        period_(0),
+        nextTime_(0),
+        overwritten_(0),
+        sampled_(false) {
+}
+
+DiagnosticsSampler::~DiagnosticsSampler() {
+}
+
+int DiagnosticsSampler::init(const uint16_t* ids, size_t count, uint32_t period, size_t bufferSize) {
+    reset();
+    if (count == 0) {
+        return SYSTEM_ERROR_NONE;
+    }
+    if (!ids || period == 0) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    const size_t rowSize = (count + 1) * sizeof(int32_t);
+    const size_t capacity = bufferSize / rowSize;
+    if (capacity == 0) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    std::unique_ptr<uint16_t[]> idsCopy(new(std::nothrow) uint16_t[count]);
+    std::unique_ptr<int32_t[]> rows(new(std::nothrow) int32_t[capacity * (count + 1)]);
+    if (!idsCopy || !rows) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    memcpy(idsCopy.get(), ids, count * sizeof(uint16_t));
+    ids_ = std::move(idsCopy);
+    rows_ = std::move(rows);
+    srcCount_ = count;
+    capacity_ = capacity;
+    period_ = period;
+    return SYSTEM_ERROR_NONE;
+}
+
+void DiagnosticsSampler::reset() {
+    ids_.reset();
+    rows_.reset();
+    srcCount_ = 0;
+    capacity_ = 0;
+    first_ = 0;
+    count_ = 0;
+    pending_ = 0;
+    period_ = 0;
+    nextTime_ = 0;
+    overwritten_ = 0;
+    sampled_ = false;
+}
+
+int DiagnosticsSampler::update(uint32_t time) {
+    if (!capacity_) {
+        return 0;
+    }
+    if (sampled_ && (int32_t)(time - nextTime_) < 0) {
+        return 0;
+    }
+    const int ret = sample(time);
+    if (ret < 0) {
+        return ret;
+    }
+    // Keep the samples aligned to the period unless the sampler has fallen behind by a whole period
+    nextTime_ += period_;
+    if ((int32_t)(time - nextTime_) >= 0) {
+        nextTime_ = time + period_;
+    }
+    return 1;
+}
+
+int DiagnosticsSampler::sample(uint32_t time) {
+    if (!capacity_) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    const int32_t* prev = (count_ > 0) ? row(count_ - 1) : nullptr;
+    if (count_ == capacity_) {
+        first_ = (first_ + 1) % capacity_;
+        --count_;
+        ++overwritten_;
+        if (pending_ > 0) {
+            --pending_;
+        }
+    }
+    int32_t* r = row(count_);
+    r[0] = (int32_t)time;
+    for (size_t i = 0; i < srcCount_; ++i) {
+        int32_t val = 0;
+        if (readSource(ids_[i], &val) != SYSTEM_ERROR_NONE) {
+            // Repeat the previous value, which is encoded as a zero delta
+            val = prev ? prev[i + 1] : 0;
+        }
+        r[i + 1] = val;
+    }
+    ++count_;
+    if (!sampled_) {
+        nextTime_ = time;
+        sampled_ = true;
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+int DiagnosticsSampler::encode(char* buf, size_t size, size_t* sampleCount) {
+    if (!capacity_) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    size_t n = count_;
+    size_t needed = encodeSamples(buf, size, n);
+    if (needed > size && n > 0) {
+        // Start with an estimate and then step down until the batch fits
+        n = (size_t)((uint64_t)n * size / needed);
+        needed = encodeSamples(buf, size, n);
+        while (needed > size && n > 0) {
+            needed = encodeSamples(buf, size, --n);
+        }
+    }
+    if (needed > size) {
+        return SYSTEM_ERROR_TOO_LARGE;
+    }
+    pending_ = n;
+    if (sampleCount) {
+        *sampleCount = n;
+    }
+    return needed;
+}
+
+void DiagnosticsSampler::commit() {
+    if (!capacity_) {
+        return;
+    }
+    first_ = (first_ + pending_) % capacity_;
+    count_ -= pending_;
+    pending_ = 0;
+    overwritten_ = 0;
+}
+
+int32_t* DiagnosticsSampler::row(size_t index) const {
+    return rows_.get() + ((first_ + index) % capacity_) * (srcCount_ + 1);
+}
+
+size_t DiagnosticsSampler::encodeSamples(char* buf, size_t size, size_t sampleCount) const {
+    Encoder e(buf, size);
+    e.writeVarint(FORMAT_VERSION);
+    e.writeVarint(srcCount_);
+    for (size_t i = 0; i < srcCount_; ++i) {
+        e.writeVarint(ids_[i]);
+    }
+    e.writeVarint(sampleCount);
+    e.writeVarint(period_);
+    e.writeVarint(overwritten_);
+    if (sampleCount > 0) {
+        e.writeVarint((uint32_t)row(0)[0]);
+        for (size_t i = 1; i < sampleCount; ++i) {
+            const uint32_t dt = (uint32_t)row(i)[0] - (uint32_t)row(i - 1)[0];
+            e.writeZigzag((int64_t)dt - period_);
+        }
+        for (size_t j = 1; j <= srcCount_; ++j) {
+            int64_t prev = 0;
+            for (size_t i = 0; i < sampleCount; ++i) {
+                const int64_t val = row(i)[j];
+                e.writeZigzag(val - prev);
+                prev = val;
+            }
+        }
+    }
+    return e.size();
+}
+
+} // namespace particle
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "image_digest.h"
+
+#include "delta_patch.h"
+
+#include <cstring>
+
+namespace particle {
+
+ImageDigest::ImageDigest() {
+    reset(0);
+    valid_ = false;
+}
+
+void ImageDigest::reset(uint32_t address) {
+    regionCount_ = 0;
+    address_ = address;
+    size_ = 0;
+    crc_ = 0;
+    tailSize_ = 0;
+    valid_ = true;
+}
+
+void ImageDigest::update(uint32_t address, const char* data, size_t size, bool written) {
+    if (!valid_ || size == 0) {
+        return;
+    }
+    const uint32_t end = address_ + size_ + tailSize_; // Address of the next portion
+    if (address == end) {
+        append(data, size);
+        if (!written) {
+            addRegion(address, data, size);
+        }
+    } else if (address >= address_ && address + size <= end) {
+        // The data has been written before. Flash memory can't be reprogrammed without erasing it,
+        // so the region is verified separately
+        addRegion(address, data, size);
+    } else {
+        valid_ = false; // Out of order
+    }
+}
+
+void ImageDigest::append(const char* data, size_t size) {
+    // The last 4 bytes are held back, since they may turn out to be the CRC of the module
+    const size_t tailCapacity = sizeof(tail_);
+    if (size >= tailCapacity) {
+        crc_ = DeltaPatcher::calcCrc32(crc_, (const char*)tail_, tailSize_);
+        crc_ = DeltaPatcher::calcCrc32(crc_, data, size - tailCapacity);
+        size_ += tailSize_ + size - tailCapacity;
+        memcpy(tail_, data + size - tailCapacity, tailCapacity);
+        tailSize_ = tailCapacity;
+        return;
+    }
+    if (tailSize_ + size > tailCapacity) {
+        const size_t n = tailSize_ + size - tailCapacity;
+        crc_ = DeltaPatcher::calcCrc32(crc_, (const char*)tail_, n);
+        size_ += n;
+        memmove(tail_, tail_ + n, tailSize_ - n);
+        tailSize_ -= n;
+    }
+    memcpy(tail_ + tailSize_, data, size);
+    tailSize_ += size;
+}
+
+void ImageDigest::addRegion(uint32_t address, const char* data, size_t size) {
+    const uint32_t crc = DeltaPatcher::calcCrc32(0, data, size);
+    for (size_t i = 0; i < regionCount_; ++i) {
+        Region& r = regions_[i];
+        if (r.address == address && r.size == size) {
+            r.crc = crc; // Retransmitted portion
+            return;
+        }
+    }
+    if (regionCount_ == MAX_REGIONS) {
+        valid_ = false;
+        return;
+    }
+    Region& r = regions_[regionCount_++];
+    r.address = address;
+    r.size = size;
+    r.crc = crc;
+}
+
+} // namespace particle
@@ -104,6 +104,116 @@ private:
     LEDStatusData* front_;
 };
 
+// Precomputed brightness curve of a blinking or fading pattern. The curve consists of steps, and
+// the LED color only changes at the beginning of a step
+class PatternCurve {
+public:
+    enum {
+        LEVEL_MAX = 0x8000 // Full brightness
+    };
+
+    PatternCurve() :
+            pattern_(LED_PATTERN_INVALID),
+            period_(0),
+            half_(0),
+            interval_(0),
+            steps_(0) {
+    }
+
+    void init(uint8_t pattern, uint16_t period) {
+        pattern_ = pattern;
+        period_ = period;
+        half_ = period / 2;
+        interval_ = 0;
+        steps_ = 0;
+        if (pattern == LED_PATTERN_FADE && half_ > 0) {
+            // Fades are updated at the same interval as with led_update(), unless the period is too
+            // long for the lookup table
+            interval_ = (half_ + MAX_FADE_STEPS - 1) / MAX_FADE_STEPS;
+            if (interval_ < STEP_INTERVAL) {
+                interval_ = STEP_INTERVAL;
+            }
+            steps_ = (half_ + interval_ - 1) / interval_;
+            for (unsigned i = 0; i < steps_; ++i) {
+                levels_[i] = (uint32_t)LEVEL_MAX * (half_ - i * interval_) / half_;
+            }
+        }
+    }
+
+    // Returns the brightness level at the beginning of the step containing `ticks`
+    uint16_t level(uint16_t ticks) const {
+        switch (pattern_) {
+        case LED_PATTERN_BLINK: {
+            return (ticks < half_) ? LEVEL_MAX : 0;
+        }
+        case LED_PATTERN_FADE: {
+            if (steps_ == 0) {
+                return 0;
+            }
+            if (ticks < half_) {
+                return levels_[ticks / interval_]; // Fading out
+            }
+            // Fading in mirrors fading out. The last step can be longer by 1 ms if the period is odd
+            unsigned i = (ticks - half_) / interval_;
+            if (i >= steps_) {
+                i = steps_ - 1;
+            }
+            return LEVEL_MAX - levels_[i];
+        }
+        default:
+            return LEVEL_MAX;
+        }
+    }
+
+    // Returns the number of milliseconds until the next step, or LED_UPDATE_IDLE if the color never
+    // changes
+    system_tick_t nextChange(uint16_t ticks) const {
+        system_tick_t t = 0;
+        switch (pattern_) {
+        case LED_PATTERN_BLINK: {
+            if (half_ == 0) {
+                return LED_UPDATE_IDLE;
+            }
+            t = (ticks < half_) ? half_ : period_;
+            break;
+        }
+        case LED_PATTERN_FADE: {
+            if (steps_ == 0) {
+                return LED_UPDATE_IDLE;
+            }
+            if (ticks < half_) {
+                t = (ticks / interval_ + 1) * interval_;
+                if (t > half_) {
+                    t = half_;
+                }
+            } else {
+                t = half_ + ((ticks - half_) / interval_ + 1) * interval_;
+                if (t > period_) {
+                    t = period_; // The first step of the next period
+                }
+            }
+            break;
+        }
+        default:
+            return LED_UPDATE_IDLE;
+        }
+        return t - ticks;
+    }
+
+private:
+    enum {
+        STEP_INTERVAL = 25, // Minimum interval between color changes, in milliseconds
+        MAX_FADE_STEPS = 160 // Maximum number of steps per half of a fade period (8s fades still use 25ms steps)
+    };
+
+    uint16_t levels_[MAX_FADE_STEPS]; // Brightness levels of the steps while fading out
+    uint8_t pattern_; // Pattern type
+    uint16_t period_; // Pattern period in milliseconds
+    uint16_t half_; // Half of the pattern period
+    uint16_t interval_; // Step interval for fades
+    uint16_t steps_; // Number of steps per half of a fade period
+};
+
 class LEDService {
 public:
     LEDService() :
@@ -112,7 +222,10 @@ public:
             period_(0),
             ticks_(0),
             disabled_(0),
-            reset_(true) {
+            reset_(true),
+            changed_(true),
+            wakeupFn_(nullptr),
+            wakeupData_(nullptr) {
     }
 
     void setStatusActive(LEDStatusData* status, bool active) {
@@ -130,7 +243,9 @@ public:
                 // available, so cached LED color should be ignored for a next status activated later
                 reset_ = true;
             }
+            changed_ = true;
         }
+        wakeup();
     }
 
     void setUpdateEnabled(bool enabled) {
@@ -143,7 +258,25 @@ public:
             } else {
                 ++disabled_;
             }
+            changed_ = true;
         }
+        wakeup();
+    }
+
+    void notifyChanged() {
+        changed_ = true;
+        wakeup();
+    }
+
+    void setWakeupHandler(led_wakeup_handler_fn fn, void* data) {
+        LED_SERVICE_WITH_LOCK(lock_) {
+            wakeupFn_ = fn;
+            wakeupData_ = data;
+        }
+    }
+
+    bool isUpdatePending() const {
+        return changed_;
     }
 
     bool isUpdateEnabled() const {
@@ -154,7 +287,10 @@ public:
         return enabled;
     }
 
-    void update(system_tick_t ticks) {
+    // Returns the number of milliseconds until the next color change. If `stepped` is true, the
+    // color of blinking and fading patterns is taken from the precomputed curve, otherwise it's
+    // computed for the exact time within the pattern period
+    system_tick_t update(system_tick_t ticks, bool stepped) {
         uint32_t color = 0;
         uint16_t period = 0;
         uint8_t pattern = LED_PATTERN_INVALID;
@@ -178,23 +314,27 @@ public:
                 reset = reset_;
                 reset_ = false;
             }
+            // Changes made by the custom pattern callback don't require another update
+            changed_ = false;
         }
         if (pattern_ != pattern || period_ != period) {
             pattern_ = pattern;
             period_ = period;
             ticks_ = 0; // Restart pattern "animation"
+            curve_.init(pattern_, period_);
         } else if (period_ > 0) {
-            ticks_ += ticks;
-            if (ticks_ >= period_) {
-                ticks_ %= period_;
-            }
+            ticks_ = ((system_tick_t)ticks_ + ticks) % period_;
         }
         if (enabled) {
             Color c = { 0 }; // Black
             if (!(flags & LED_STATUS_FLAG_OFF)) {
                 scaleColor(color, led_rgb_brightness, &c); // Use global LED brightness
                 if (period_ > 0) {
-                    updatePatternColor(pattern_, ticks_, period_, &c);
+                    if (stepped) {
+                        scaleColor(curve_.level(ticks_), &c);
+                    } else {
+                        updatePatternColor(pattern_, ticks_, period_, &c);
+                    }
                 }
             }
             if (reset || color_.r != c.r || color_.g != c.g || color_.b != c.b) {
@@ -202,6 +342,13 @@ public:
                 color_ = c;
             }
         }
+        if (!enabled || (flags & LED_STATUS_FLAG_OFF)) {
+            return LED_UPDATE_IDLE;
+        }
+        if (pattern_ == LED_PATTERN_CUSTOM) {
+            return LED_CUSTOM_PATTERN_UPDATE_INTERVAL;
+        }
+        return curve_.nextChange(ticks_);
     }
 
 private:
@@ -210,6 +357,7 @@ private:
     };
 
     StatusQueue queue_; // Status queue
+    PatternCurve curve_; // Brightness curve of current pattern
 
     Color color_; // Current LED color
     uint8_t pattern_; // Current pattern type
@@ -218,6 +366,10 @@ private:
 
     volatile uint16_t disabled_; // The service is allowed to change LED color only if this counter is set to 0
     volatile bool reset_; // Flag signaling that cached LED color should be ignored
+    volatile bool changed_; // Flag signaling that LED state has changed since last update
+
+    led_wakeup_handler_fn wakeupFn_; // Callback invoked when LED state changes
+    void* wakeupData_; // Callback data
 
     LED_SERVICE_DECLARE_LOCK(lock_); // Platform-specific lock
 
@@ -249,6 +401,22 @@ private:
         }
     }
 
+    // Scales color components by a brightness level of a pattern curve
+    static void scaleColor(uint16_t level, Color* color) {
+        color->r = ((uint32_t)color->r * level) / PatternCurve::LEVEL_MAX;
+        color->g = ((uint32_t)color->g * level) / PatternCurve::LEVEL_MAX;
+        color->b = ((uint32_t)color->b * level) / PatternCurve::LEVEL_MAX;
+    }
+
+    // Invokes the wakeup handler. Called outside of the lock, as the handler may need to interact
+    // with the scheduler
+    void wakeup() const {
+        const led_wakeup_handler_fn fn = wakeupFn_;
+        if (fn) {
+            fn(wakeupData_);
+        }
+    }
+
     // Splits 32-bit RGB value into 16-bit color components (as expected by HAL) and applies
     // brightness correction
     static void scaleColor(uint32_t color, uint8_t value, Color* scaled) {
@@ -289,5 +457,21 @@ int led_update_enabled(void* reserved) {
 }
 
 void led_update(system_tick_t ticks, LEDStatusData* status, void* reserved) {
-    ledService.update(ticks);
+    ledService.update(ticks, false);
+}
+
+system_tick_t led_process(system_tick_t ticks, void* reserved) {
+    return ledService.update(ticks, true);
+}
+
+int led_update_pending(void* reserved) {
+    return (ledService.isUpdatePending() ? 1 : 0);
+}
+
+void led_notify_changed(void* reserved) {
+    ledService.notifyChanged();
+}
+
+void led_set_wakeup_handler(led_wakeup_handler_fn fn, void* data, void* reserved) {
+    ledService.setWakeupHandler(fn, data);
 }
@@ -82,6 +82,7 @@ void LED_Signaling_Stop(void)
 void LED_SetBrightness(uint8_t brightness)
 {
     led_rgb_brightness = brightness;
+    led_notify_changed(NULL);
 }
 
 uint8_t Get_LED_Brightness()
@@ -60,6 +60,14 @@ private:
 
 } // unnamed
 
+int InputStream::acquireRead(const char** data) {
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int InputStream::commitRead(size_t size) {
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
 int InputStream::readAll(char* data, size_t size, unsigned timeout) {
     const auto end = data + size;
     Timer t(timeout);
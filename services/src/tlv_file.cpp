@@ -24,6 +24,8 @@
 #include "service_debug.h"
 #include "system_error.h"
 #include <algorithm>
+#include <memory>
+#include <new>
 
 /* FIXME: once filesystem interface is finalized, convert the implementation not to use
  * LittleFS API.
@@ -32,7 +34,8 @@
 using namespace particle::services::settings;
 using namespace particle::fs;
 
-TlvFile::TlvFile(const char* path) {
+TlvFile::TlvFile(const char* path, filesystem_t* fs)
+        : fs_(fs) {
     SPARK_ASSERT(path != nullptr);
     path_ = strdup(path);
     SPARK_ASSERT(path_ != nullptr);
@@ -46,7 +49,7 @@ TlvFile::~TlvFile() {
 }
 
 int TlvFile::init() {
-    auto fs = filesystem_get_instance(nullptr);
+    auto fs = fs_ ? fs_ : filesystem_get_instance(nullptr);
     SPARK_ASSERT(fs);
 
     FsLock lk(fs);
@@ -143,6 +146,11 @@ int TlvFile::set(uint16_t key, const uint8_t* value, uint16_t length, int index)
         return SYSTEM_ERROR_INVALID_STATE;
     }
 
+    if (logMode_ && index < 0) {
+        /* Supersede all previous values instead of removing them */
+        return append(key, value, length, TLV_FLAG_REPLACE);
+    }
+
     /* Delete previous entry */
     int ret = del(key, index);
     if (!(ret == 0 || ret == SYSTEM_ERROR_NOT_FOUND)) {
@@ -159,133 +167,49 @@ int TlvFile::add(uint16_t key, const uint8_t* value, uint16_t length) {
         return SYSTEM_ERROR_INVALID_STATE;
     }
 
-    FileFooter footer;
-    int ret = readFooter(footer);
-    if (ret < 0) {
-        return ret;
-    }
-    ssize_t pos = footer.size;
+    return append(key, value, length, 0);
+}
 
-    if (pos < 0) {
-        return pos;
-    }
+int TlvFile::del(uint16_t key, int index) {
+    FsLock lk(fs_);
 
-    ret = seek(pos);
-    if (ret < 0) {
-        return ret;
+    if (!open_) {
+        return SYSTEM_ERROR_INVALID_STATE;
     }
 
-    TlvHeader header = {};
-    header.magick = TLV_HEADER_MAGICK;
-    header.key = key;
-    header.length = length;
-
-    /* Write entry header */
-    ret = write((const uint8_t*)&header, sizeof(header));
+    const int ret = findEntry(key, index);
     if (ret < 0) {
         return ret;
     }
-    /* Write data */
-    ret = write((const uint8_t*)value, length);
-    if (ret < 0) {
-        return ret;
-    }
-    /* Write file footer */
-    footer.magick = TLV_FILE_MAGICK;
-    footer.size += sizeof(header) + length;
-    ret = write((const uint8_t*)&footer, sizeof(footer));
-    if (ret < 0) {
-        return ret;
+
+    if (logMode_ && index < 0) {
+        return append(key, nullptr, 0, TLV_FLAG_DELETE);
     }
 
-    return sync();
+    return rewrite(key, index);
 }
 
-int TlvFile::del(uint16_t key, int index) {
+int TlvFile::compact() {
     FsLock lk(fs_);
 
     if (!open_) {
         return SYSTEM_ERROR_INVALID_STATE;
     }
 
-    int ret = 0;
-
-    for (;;) {
-        uint16_t dataSize = 0;
-        ssize_t pos = find(key, index, &dataSize);
-        if (pos < 0) {
-            return pos;
-        }
-
-        /* FIXME: this will only work on LittleFS. Provide a different implementation later
-         * when filesystem API is finalized and TlvFile implementation is refactored not to use
-         * LittleFS API.
-         */
-        const ssize_t fileSize = size();
-
-        FileFooter footer;
-        ret = readFooter(footer);
-
-        while (ret == 0) {
-            lfs_file_t f;
-            ret = lfs_file_open(lfs(), &f, path_, LFS_O_RDONLY);
-            if (ret) {
-                break;
-            }
-
-            size_t wpos = pos;
-            size_t rpos = wpos + sizeof(TlvHeader) + dataSize;
-
-            ret = seek(wpos);
-            if (ret < 0) {
-                break;
-            }
-
-            ret = lfs_file_seek(lfs(), &f, rpos, LFS_SEEK_SET);
-            if (ret < 0) {
-                break;
-            }
-
-            for (; rpos < footer.size && ret > 0; ++wpos, ++rpos) {
-                uint8_t tmp;
-                ret = lfs_file_read(lfs(), &f, &tmp, sizeof(tmp));
-                if (ret < 0) {
-                    break;
-                }
-
-                ret = write(&tmp, sizeof(tmp));
-                if (ret < 0) {
-                    break;
-                }
-            }
-
-            if (ret > 0) {
-                /* Write footer */
-                footer.size -= sizeof(TlvHeader) + dataSize;
-                ret = write((const uint8_t*)&footer, sizeof(footer));
-                if (ret < 0) {
-                    break;
-                }
-                /* Truncate */
-                ret = lfs_file_truncate(lfs(), &file_, fileSize - (sizeof(TlvHeader) + dataSize));
-                if (ret < 0) {
-                    break;
-                }
-                ret = sync();
-            }
-
-            lfs_file_close(lfs(), &f);
-
-            break;
-        }
+    return rewrite(-1, -1);
+}
 
+void TlvFile::logMode(bool enabled, size_t compactThreshold) {
+    logMode_ = enabled;
+    compactThreshold_ = compactThreshold;
+}
 
-        if (ret || index >= 0) {
-            break;
-        }
-    }
+bool TlvFile::logMode() const {
+    return logMode_;
+}
 
-    return ret;
+size_t TlvFile::staleSize() const {
+    return staleSize_;
 }
 
 lfs_t* TlvFile::lfs() {
@@ -338,6 +262,9 @@ open_done:
     if (r) {
         lfs_file_close(lfs(), &file_);
         open_ = false;
+    } else {
+        /* Not fatal, the index will be rebuilt on first access */
+        buildIndex();
     }
     return r;
 }
@@ -346,7 +273,7 @@ int TlvFile::validate() {
     FileFooter footer = {};
     int ret = readFooter(footer);
     if (!ret) {
-        if (footer.magick != TLV_FILE_MAGICK) {
+        if (footer.magick != TLV_FILE_MAGICK && footer.magick != TLV_FILE_LOG_MAGICK) {
             ret = SYSTEM_ERROR_BAD_DATA;
         }
     }
@@ -364,6 +291,10 @@ int TlvFile::close() {
     /* Close */
 
     open_ = false;
+    index_.clear();
+    indexValid_ = false;
+    staleSize_ = 0;
+    tornPos_ = -1;
 
     return lfs_file_close(lfs(), &file_);
 }
@@ -442,18 +373,58 @@ int TlvFile::readFooter(FileFooter& footer) {
 }
 
 ssize_t TlvFile::find(uint16_t key, int index, uint16_t* dataSize) {
+    const int i = findEntry(key, index);
+    if (i < 0) {
+        return i;
+    }
+
+    const IndexEntry& entry = index_[i];
+    if (dataSize) {
+        *dataSize = entry.length;
+    }
+
+    return entry.pos;
+}
+
+int TlvFile::findEntry(uint16_t key, int index) {
+    if (!indexValid_) {
+        const int r = buildIndex();
+        if (r < 0) {
+            return r;
+        }
+    }
+
+    int found = SYSTEM_ERROR_NOT_FOUND;
+    int count = 0;
+    for (int i = 0; i < index_.size(); ++i) {
+        if (index_[i].key == key) {
+            if (index < 0) {
+                /* Last entry with this key */
+                found = i;
+            } else if (count++ == index) {
+                return i;
+            }
+        }
+    }
+
+    return found;
+}
+
+int TlvFile::buildIndex() {
+    index_.clear();
+    indexValid_ = false;
+    staleSize_ = 0;
+    tornPos_ = -1;
+
     FileFooter footer;
     int r = readFooter(footer);
     if (r) {
         return r;
     }
 
-    ssize_t candidatePos = -1;
-    int candidateIdx = -1;
-    uint16_t candidateSize = 0;
-
     TlvHeader header;
-    for (ssize_t pos = 0; pos >= 0 && (pos + sizeof(TlvHeader)) <= footer.size;) {
+    size_t pos = 0;
+    while ((pos + sizeof(TlvHeader)) <= footer.size) {
         r = seek(pos);
         if (r < 0) {
             return r;
@@ -465,31 +436,289 @@ ssize_t TlvFile::find(uint16_t key, int index, uint16_t* dataSize) {
         }
 
         if (header.magick != TLV_HEADER_MAGICK) {
-            /* Attempt to recover */
+            /* Attempt to recover. Garbage is dropped by the next compaction */
             pos += sizeof(uint16_t);
+            staleSize_ += sizeof(uint16_t);
             continue;
         }
 
-        if (header.key == key) {
-            candidatePos = pos;
-            ++candidateIdx;
-            candidateSize = header.length;
-            if (index >= 0 && candidateIdx >= index) {
+        const size_t entrySize = sizeof(TlvHeader) + header.length;
+        if (pos + entrySize > footer.size) {
+            /* Truncated entry */
+            break;
+        }
+
+        if (header.flags & (TLV_FLAG_REPLACE | TLV_FLAG_DELETE)) {
+            for (int i = 0; i < index_.size();) {
+                if (index_[i].key == header.key) {
+                    staleSize_ += sizeof(TlvHeader) + index_[i].length;
+                    index_.removeAt(i);
+                } else {
+                    ++i;
+                }
+            }
+        }
+
+        if (header.flags & TLV_FLAG_DELETE) {
+            staleSize_ += entrySize;
+        } else if (!index_.append({ (uint32_t)pos, header.key, header.length })) {
+            index_.clear();
+            return SYSTEM_ERROR_NO_MEMORY;
+        }
+
+        pos += entrySize;
+    }
+
+    if (pos < footer.size) {
+        /* Incomplete record at the end of the file. It is dropped before anything is appended to
+         * the file, as it would otherwise swallow the new records
+         */
+        staleSize_ += footer.size - pos;
+        tornPos_ = pos;
+    }
+
+    indexValid_ = true;
+    return 0;
+}
+
+int TlvFile::append(uint16_t key, const uint8_t* value, uint16_t length, uint16_t flags) {
+    if (value == nullptr && length != 0) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (!indexValid_) {
+        int ret = buildIndex();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    if (tornPos_ >= 0) {
+        int ret = rewrite(-1, -1);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    FileFooter footer;
+    int ret = readFooter(footer);
+    if (ret < 0) {
+        return ret;
+    }
+    const size_t pos = footer.size;
+
+    ret = seek(pos);
+    if (ret < 0) {
+        return ret;
+    }
+
+    TlvHeader header = {};
+    header.magick = TLV_HEADER_MAGICK;
+    header.key = key;
+    header.length = length;
+    header.flags = flags;
+
+    for (;;) {
+        /* Write entry header */
+        ret = write((const uint8_t*)&header, sizeof(header));
+        if (ret < 0) {
+            break;
+        }
+        /* Write data */
+        ret = write((const uint8_t*)value, length);
+        if (ret < 0) {
+            break;
+        }
+        /* Write file footer */
+        if (flags & (TLV_FLAG_REPLACE | TLV_FLAG_DELETE)) {
+            footer.magick = TLV_FILE_LOG_MAGICK;
+        }
+        footer.size += sizeof(header) + length;
+        ret = write((const uint8_t*)&footer, sizeof(footer));
+        if (ret < 0) {
+            break;
+        }
+        ret = sync();
+        break;
+    }
+
+    if (ret) {
+        /* The file may have been reopened or left in an unknown state */
+        indexValid_ = false;
+        return ret;
+    }
+
+    /* Update the index */
+    if (flags & (TLV_FLAG_REPLACE | TLV_FLAG_DELETE)) {
+        for (int i = 0; i < index_.size();) {
+            if (index_[i].key == key) {
+                staleSize_ += sizeof(TlvHeader) + index_[i].length;
+                index_.removeAt(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+    if (flags & TLV_FLAG_DELETE) {
+        staleSize_ += sizeof(header) + length;
+    } else if (!index_.append({ (uint32_t)pos, key, length })) {
+        indexValid_ = false;
+    }
+
+    if (logMode_ && staleSize_ > compactThreshold_) {
+        /* The entry has been stored already, a failed compaction will be retried on next update */
+        rewrite(-1, -1);
+    }
+
+    return 0;
+}
+
+int TlvFile::rewrite(int key, int index) {
+    if (!indexValid_) {
+        int ret = buildIndex();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    FileFooter footer;
+    int ret = readFooter(footer);
+    if (ret < 0) {
+        return ret;
+    }
+
+    /* FIXME: this will only work on LittleFS. Provide a different implementation later
+     * when filesystem API is finalized and TlvFile implementation is refactored not to use
+     * LittleFS API.
+     */
+    lfs_file_t f;
+    ret = lfs_file_open(lfs(), &f, path_, LFS_O_RDONLY);
+    if (ret) {
+        return ret;
+    }
+
+    size_t bufSize = copyBufferSize();
+    std::unique_ptr<uint8_t[]> heapBuf(new(std::nothrow) uint8_t[bufSize]);
+    uint8_t stackBuf[32];
+    uint8_t* buf = heapBuf.get();
+    if (!buf) {
+        buf = stackBuf;
+        bufSize = sizeof(stackBuf);
+    }
+
+    /* Move the remaining entries towards the beginning of the file. Adjacent entries are copied
+     * as a single range, and entries that are in place already are not copied at all
+     */
+    size_t wpos = 0;
+    size_t runSrc = 0;
+    size_t runDest = 0;
+    size_t runSize = 0;
+    int count = 0;
+    for (int i = 0; i < index_.size();) {
+        IndexEntry& entry = index_[i];
+        if (key >= 0 && entry.key == key && (index < 0 || count++ == index)) {
+            index_.removeAt(i);
+            continue;
+        }
+
+        const size_t entrySize = sizeof(TlvHeader) + entry.length;
+        if (runSize > 0 && entry.pos == runSrc + runSize) {
+            runSize += entrySize;
+        } else {
+            if (runSize > 0 && runSrc != runDest) {
+                ret = copy(&f, runSrc, runDest, runSize, buf, bufSize);
+                if (ret) {
+                    /* The index may have been rebuilt */
+                    break;
+                }
+            }
+            runSrc = entry.pos;
+            runDest = wpos;
+            runSize = entrySize;
+        }
+        entry.pos = wpos;
+        wpos += entrySize;
+        ++i;
+    }
+    if (ret == 0 && runSize > 0 && runSrc != runDest) {
+        ret = copy(&f, runSrc, runDest, runSize, buf, bufSize);
+    }
+
+    /* The file has no superseded records anymore and can be read by older firmware versions */
+    if (ret == 0 && (wpos != footer.size || footer.magick != TLV_FILE_MAGICK)) {
+        for (;;) {
+            /* Write footer */
+            footer.size = wpos;
+            footer.magick = TLV_FILE_MAGICK;
+            ret = seek(wpos);
+            if (ret < 0) {
                 break;
             }
+            ret = write((const uint8_t*)&footer, sizeof(footer));
+            if (ret < 0) {
+                break;
+            }
+            /* Truncate */
+            ret = lfs_file_truncate(lfs(), &file_, wpos + sizeof(footer));
+            if (ret < 0) {
+                break;
+            }
+            ret = sync();
+            break;
         }
+    }
+
+    lfs_file_close(lfs(), &f);
 
-        pos += sizeof(TlvHeader) + header.length;
+    if (ret) {
+        indexValid_ = false;
+        return ret;
     }
 
-    if ((index >= 0 && candidateIdx == index) || (index < 0 && candidateIdx >= 0)) {
-        if (dataSize) {
-            *dataSize = candidateSize;
+    staleSize_ = 0;
+    tornPos_ = -1;
+    return 0;
+}
+
+int TlvFile::copy(lfs_file_t* src, size_t srcPos, size_t destPos, size_t length, uint8_t* buf, size_t bufSize) {
+    ssize_t r = lfs_file_seek(lfs(), src, srcPos, LFS_SEEK_SET);
+    if (r < 0) {
+        return r;
+    }
+    r = seek(destPos);
+    if (r < 0) {
+        return r;
+    }
+    while (length > 0) {
+        const size_t n = std::min(length, bufSize);
+        r = lfs_file_read(lfs(), src, buf, n);
+        if (r < 0) {
+            return r;
         }
-        return candidatePos;
+        if ((size_t)r != n) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        r = write(buf, n);
+        if (r < 0) {
+            return r;
+        }
+        length -= n;
     }
+    return 0;
+}
 
-    return SYSTEM_ERROR_NOT_FOUND;
+size_t TlvFile::copyBufferSize() {
+    /* Smallest size that is a multiple of both the read and program sizes */
+    const size_t readSize = lfs()->cfg->read_size;
+    const size_t progSize = lfs()->cfg->prog_size;
+    size_t a = readSize;
+    size_t b = progSize;
+    while (b) {
+        const size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return readSize / a * progSize;
 }
 
 #endif /* HAL_PLATFORM_FILESYSTEM == 1 */
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <cstddef>
+#include <atomic>
 
 #if PLATFORM_THREADING
 
@@ -297,15 +298,20 @@ public:
         return started;
     }
 
-    template<typename R> void invoke_async(const std::function<R(void)>& work)
+    /**
+     * Queues a function for asynchronous execution. Returns false if the function couldn't be queued.
+     */
+    template<typename R> bool invoke_async(const std::function<R(void)>& work)
     {
         auto task = new AsyncTask<R>(work);
         if (task)
         {
 			Item message = task;
-			if (!put(message))
-				delete task;
+			if (put(message))
+				return true;
+			delete task;
         }
+        return false;
 	}
 
     template<typename R> SystemPromise<R>* invoke_future(const std::function<R(void)>& work)
@@ -443,6 +449,11 @@ public:
 /**
  * This class implements a queue of asynchronous calls that can be scheduled from an ISR and then
  * invoked from an event loop running in a regular thread.
+ *
+ * The queue is an intrusive multi-producer single-consumer queue based on D. Vyukov's algorithm.
+ * A task is enqueued with a single atomic exchange, so interrupts are never disabled, and tasks
+ * can be enqueued from several ISRs and threads concurrently. The queue can only be processed by
+ * one thread.
  */
 class ISRTaskQueue {
 public:
@@ -454,15 +465,38 @@ public:
         Task* next; // Next element in the queue
     };
 
-    ISRTaskQueue() :
-            firstTask_(nullptr),
-            lastTask_(nullptr) {
-    }
+    // Maximum number of tasks invoked by `processBatch()` by default
+    static const size_t DEFAULT_BATCH_SIZE = 8;
 
+    ISRTaskQueue();
+
+    // Adds a task to the queue. This method can be called from an ISR
     void enqueue(Task* task);
+    // Invokes the next task in the queue. Returns false if there are no tasks ready for processing
     bool process();
+    // Invokes up to `maxCount` tasks. Returns the number of invoked tasks
+    size_t processBatch(size_t maxCount = DEFAULT_BATCH_SIZE);
+
+    // Returns the number of tasks in the queue
+    size_t size() const;
+    // Returns the maximum number of tasks that have been in the queue at the same time
+    size_t maxSize() const;
 
 private:
-    Task* volatile firstTask_;
-    Task* lastTask_;
+    std::atomic<Task*> head_; // Most recently enqueued task
+    Task* tail_; // Oldest task in the queue, accessed only by the consumer
+    Task stub_;
+    std::atomic<size_t> size_;
+    std::atomic<size_t> maxSize_;
+
+    void push(Task* task);
+    Task* pop();
 };
+
+inline size_t ISRTaskQueue::size() const {
+    return size_.load(std::memory_order_relaxed);
+}
+
+inline size_t ISRTaskQueue::maxSize() const {
+    return maxSize_.load(std::memory_order_relaxed);
+}
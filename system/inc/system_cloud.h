@@ -76,11 +76,6 @@ const CloudVariableTypeInt INT;
 const CloudVariableTypeString STRING;
 const CloudVariableTypeDouble DOUBLE;
 
-#if PLATFORM_ID==3
-// avoid a c-linkage incompatible with C error on newer versions of gcc
-String spark_deviceID(void);
-#endif
-
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -93,9 +88,26 @@ typedef enum cloud_disconnect_reason {
     CLOUD_DISCONNECT_REASON_LISTENING = 4 // Disconnected due to the listening mode
 } cloud_disconnect_reason;
 
-#if PLATFORM_ID!=3
-String spark_deviceID(void);
-#endif
+/**
+ * Writes the device ID as a null-terminated hex string to the buffer. Returns the length of the
+ * string, which can be larger than the size of the buffer, similarly to snprintf().
+ */
+size_t spark_device_id(char* buf, size_t size, void* reserved);
+
+/**
+ * Layout of String before short strings were stored inline. Applications built against older
+ * headers call spark_deviceID() through the dynalib and provide a return slot of this size, so
+ * String can't be returned by value across the module boundary. Use spark_device_id() instead.
+ */
+typedef struct spark_legacy_string_t {
+    char* buffer;
+    unsigned capacity;
+    unsigned len;
+    unsigned char flags;
+} spark_legacy_string_t;
+
+// Exported at the index of the old spark_deviceID(). The buffer is freed by the application
+spark_legacy_string_t spark_deviceID_legacy(void);
 
 void cloud_disconnect(bool closeSocket=true, bool graceful=false, cloud_disconnect_reason reason = CLOUD_DISCONNECT_REASON_NONE);
 void cloud_disconnect_graceful(bool closeSocket=true, cloud_disconnect_reason reason = CLOUD_DISCONNECT_REASON_NONE);
@@ -115,6 +127,9 @@ const uint32_t PUBLISH_EVENT_FLAG_PUBLIC = 0x0;
 const uint32_t PUBLISH_EVENT_FLAG_PRIVATE = 0x1;
 const uint32_t PUBLISH_EVENT_FLAG_NO_ACK = 0x2;
 const uint32_t PUBLISH_EVENT_FLAG_WITH_ACK = 0x8;
+// Don't wait for the event to be passed to the protocol layer. spark_send_event() returns as soon as
+// the event is queued for the system thread, and the result is reported via the completion callback
+const uint32_t PUBLISH_EVENT_FLAG_ASYNC = 0x10;
 
 PARTICLE_STATIC_ASSERT(publish_no_ack_flag_matches, PUBLISH_EVENT_FLAG_NO_ACK==EventType::NO_ACK);
 
@@ -253,3 +268,10 @@ extern const unsigned char backup_tcp_public_server_address[18];
 #ifdef __cplusplus
 }
 #endif
+
+inline String spark_deviceID(void)
+{
+    char id[spark_device_id(nullptr, 0, nullptr) + 1];
+    spark_device_id(id, sizeof(id), nullptr);
+    return String(id);
+}
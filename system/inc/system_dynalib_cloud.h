@@ -40,7 +40,7 @@ DYNALIB_FN(3, system_cloud, spark_cloud_flag_connect, void(void))
 DYNALIB_FN(4, system_cloud, spark_cloud_flag_disconnect, void(void))
 DYNALIB_FN(5, system_cloud, spark_cloud_flag_connected, bool(void))
 DYNALIB_FN(6, system_cloud, system_cloud_protocol_instance, ProtocolFacade*(void))
-DYNALIB_FN(7, system_cloud, spark_deviceID, String(void))
+DYNALIB_FN(7, system_cloud, spark_deviceID_legacy, spark_legacy_string_t(void))
 DYNALIB_FN(8, system_cloud, spark_send_event, bool(const char*, const char*, int, uint32_t, void*))
 DYNALIB_FN(9, system_cloud, spark_subscribe, bool(const char*, EventHandler, void*, Spark_Subscription_Scope_TypeDef, const char*, void*))
 DYNALIB_FN(10, system_cloud, spark_unsubscribe, void(void*))
@@ -49,6 +49,7 @@ DYNALIB_FN(12, system_cloud, spark_sync_time_pending, bool(void*))
 DYNALIB_FN(13, system_cloud, spark_sync_time_last, system_tick_t(time_t*, void*))
 DYNALIB_FN(14, system_cloud, spark_set_connection_property, int(unsigned, unsigned, particle::protocol::connection_properties_t*, void*))
 DYNALIB_FN(15, system_cloud, spark_set_random_seed_from_cloud_handler, int(void (*handler)(unsigned int), void*))
+DYNALIB_FN(16, system_cloud, spark_device_id, size_t(char*, size_t, void*))
 
 DYNALIB_END(system_cloud)
 
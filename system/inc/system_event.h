@@ -104,18 +104,42 @@ enum SystemNotifyEventFlag {
     NOTIFY_SYNCHRONOUSLY = 0x01
 };
 
+/**
+ * Delivery modes of system event subscriptions.
+ */
+typedef enum system_event_delivery_mode {
+    // The handler is called in the context of the application thread (default)
+    SYSTEM_EVENT_DELIVERY_QUEUED = 0,
+    // The handler is called synchronously by the thread that generated the event, which is usually
+    // the system thread. Such a handler should return quickly and must not block
+    SYSTEM_EVENT_DELIVERY_INLINE = 1,
+    // Same as SYSTEM_EVENT_DELIVERY_QUEUED, but if the handler falls behind, only the latest
+    // notification of each event is delivered. Useful for high-rate events like `network_status`
+    SYSTEM_EVENT_DELIVERY_COALESCED = 2
+} system_event_delivery_mode;
+
+/**
+ * Subscription options.
+ */
+typedef struct system_event_subscribe_options {
+    uint16_t size; // Size of this structure
+    uint8_t delivery_mode; // Delivery mode (see `system_event_delivery_mode`)
+    uint8_t reserved;
+} system_event_subscribe_options;
+
 /**
  * Subscribes to the system events given
  * @param events    One or more system events. Multiple system events are specified using the + operator.
  * @param handler   The system handler function to call.
- * @param reserved  Set to NULL.
+ * @param options   Subscription options (see `system_event_subscribe_options`), or NULL.
  * @return {@code 0} if the system event handlers were registered successfully. Non-zero otherwise.
  */
-int system_subscribe_event(system_event_t events, system_event_handler_t* handler, void* reserved);
+int system_subscribe_event(system_event_t events, system_event_handler_t* handler, void* options);
 
 /**
  * Unsubscribes a handler from the given events.
- * @param handler   The handler that will be unsubscribed.
+ * @param events    One or more system events.
+ * @param handler   The handler that will be unsubscribed, or NULL to unsubscribe all handlers.
  * @param reserved  Set to NULL.
  */
 void system_unsubscribe_event(system_event_t events, system_event_handler_t* handler, void* reserved);
@@ -129,9 +153,15 @@ void system_notify_time_changed(uint32_t data, void* reserved, void* reserved1);
 
 /**
  * Notifies all subscribers about an event. It is safe to call this function from an ISR.
+ *
+ * If `NOTIFY_SYNCHRONOUSLY` is set, all subscribed handlers are called by the current thread,
+ * regardless of their delivery mode.
+ *
  * @param event
  * @param data
  * @param pointer
+ * @param fn Function to call once the handlers with the default delivery mode have been called.
+ * @param fndata
  * @param flags Event flags as defined by the `SystemNotifyEventFlag` enum.
  */
 void system_notify_event(system_event_t event, uint32_t data = 0, void* pointer = nullptr,
@@ -19,7 +19,6 @@
 
 #include "active_object.h"
 
-#include "spark_wiring_interrupts.h"
 #include "debug.h"
 
 #if PLATFORM_THREADING
@@ -82,33 +81,77 @@ void ActiveObjectBase::run_active_object(ActiveObjectBase* object)
 
 #endif // PLATFORM_THREADING
 
+const size_t ISRTaskQueue::DEFAULT_BATCH_SIZE;
+
+ISRTaskQueue::ISRTaskQueue() :
+        head_(&stub_),
+        tail_(&stub_),
+        stub_(),
+        size_(0),
+        maxSize_(0) {
+}
+
 void ISRTaskQueue::enqueue(Task* task) {
-    ATOMIC_BLOCK() {
-        // Add task object to the queue
-        if (lastTask_) {
-            lastTask_->next = task;
-        } else { // The queue is empty
-            firstTask_ = task;
-        }
-        task->next = nullptr;
-        lastTask_ = task;
+    const size_t n = size_.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t max = maxSize_.load(std::memory_order_relaxed);
+    while (n > max && !maxSize_.compare_exchange_weak(max, n, std::memory_order_relaxed)) {
     }
+    push(task);
 }
 
 bool ISRTaskQueue::process() {
-    Task* task = nullptr;
-    if (!firstTask_) {
+    // Take task object from the queue
+    Task* const task = pop();
+    if (!task) {
         return false;
     }
-    ATOMIC_BLOCK() {
-        // Take task object from the queue
-        task = firstTask_;
-        firstTask_ = task->next;
-        if (!firstTask_) {
-            lastTask_ = nullptr;
-        }
-    }
+    size_.fetch_sub(1, std::memory_order_relaxed);
     // Invoke task function
     task->func(task);
     return true;
 }
+
+size_t ISRTaskQueue::processBatch(size_t maxCount) {
+    size_t n = 0;
+    while (n < maxCount && process()) {
+        ++n;
+    }
+    return n;
+}
+
+void ISRTaskQueue::push(Task* task) {
+    __atomic_store_n(&task->next, nullptr, __ATOMIC_RELAXED);
+    Task* const prev = head_.exchange(task, std::memory_order_acq_rel);
+    // Until the previous task is linked to this one, the consumer sees the queue as empty
+    __atomic_store_n(&prev->next, task, __ATOMIC_RELEASE);
+}
+
+ISRTaskQueue::Task* ISRTaskQueue::pop() {
+    Task* tail = tail_;
+    Task* next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (tail == &stub_) {
+        if (!next) {
+            return nullptr; // The queue is empty
+        }
+        tail_ = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        tail_ = next;
+        return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire)) {
+        // A producer has been preempted in the middle of enqueueing a task. The remaining tasks
+        // will become available once it completes
+        return nullptr;
+    }
+    // The stub is reinserted so that the last task can be detached from the queue
+    push(&stub_);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        tail_ = next;
+        return tail;
+    }
+    return nullptr;
+}
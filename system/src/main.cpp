@@ -353,14 +353,21 @@ void HAL_Notify_Button_State(uint8_t button, uint8_t pressed)
  *******************************/
 extern "C" void HAL_SysTick_Handler(void)
 {
-    // Update LED color
-    static const uint16_t LED_UPDATE_INTERVAL = 25; // Milliseconds
-    static uint16_t ledUpdateTicks = LED_UPDATE_INTERVAL;
+#if !PLATFORM_THREADING
+    // Update LED color. Without an RTOS there's no timer to schedule the updates, so the LED service
+    // is checked on every tick, but the color is only recomputed when it needs to change. Threaded
+    // platforms run the LED service from a one-shot timer instead (see startLedTimer())
+    static system_tick_t ledUpdateTicks = 0; // Milliseconds passed since the last update
+    static system_tick_t ledUpdateDelay = 0; // Milliseconds until the next scheduled update
 
-    if (--ledUpdateTicks == 0) {
-        led_update(LED_UPDATE_INTERVAL, nullptr, nullptr);
-        ledUpdateTicks = LED_UPDATE_INTERVAL;
+    if (ledUpdateDelay != LED_UPDATE_IDLE) {
+        ++ledUpdateTicks;
     }
+    if (ledUpdateTicks >= ledUpdateDelay || led_update_pending(nullptr)) {
+        ledUpdateDelay = led_process(ledUpdateTicks, nullptr);
+        ledUpdateTicks = 0;
+    }
+#endif // !PLATFORM_THREADING
 
     // Check cloud inactivity timeout
     static const uint16_t CLOUD_CHECK_INTERVAL = 1000; // Milliseconds
@@ -516,6 +523,47 @@ void app_loop(bool threaded)
 
 #if PLATFORM_THREADING
 
+namespace {
+
+// One-shot timer running the LED service. The timer is only armed until the next change of the
+// LED color, so it doesn't expire at all while a solid color is shown
+os_timer_t g_ledTimer = nullptr;
+system_tick_t g_ledUpdateTime = 0; // Time of the last LED update
+volatile uint32_t g_ledWakeups = 0; // Number of times the LED timer has expired
+
+void ledTimerExpired(os_timer_t timer) {
+    const system_tick_t now = HAL_Timer_Get_Milli_Seconds();
+    const system_tick_t delay = led_process(now - g_ledUpdateTime, nullptr);
+    g_ledUpdateTime = now;
+    ++g_ledWakeups;
+    if (delay != LED_UPDATE_IDLE) {
+        os_timer_change(timer, OS_TIMER_CHANGE_PERIOD, false, delay ? delay : 1, 0, nullptr);
+    }
+    // A wakeup requested while the LED was being updated could have been overridden above
+    if (led_update_pending(nullptr)) {
+        os_timer_change(timer, OS_TIMER_CHANGE_PERIOD, false, 1, 0, nullptr);
+    }
+}
+
+// Invoked by the LED service when the LED state changes
+void ledWakeup(void* data) {
+    os_timer_change(g_ledTimer, OS_TIMER_CHANGE_PERIOD, HAL_IsISR(), 1, 0, nullptr);
+}
+
+void startLedTimer() {
+    if (os_timer_create(&g_ledTimer, 1, ledTimerExpired, nullptr, true /* one_shot */, nullptr) != 0) {
+        g_ledTimer = nullptr;
+        LOG(ERROR, "Unable to create LED timer");
+        return;
+    }
+    g_ledUpdateTime = HAL_Timer_Get_Milli_Seconds();
+    led_set_wakeup_handler(ledWakeup, nullptr, nullptr);
+    // Show the statuses that have been activated so far
+    os_timer_change(g_ledTimer, OS_TIMER_CHANGE_START, false, 0, 0, nullptr);
+}
+
+} // namespace
+
 // This is the application loop ActiveObject.
 
 void app_thread_idle()
@@ -613,6 +661,43 @@ public:
     }
 };
 
+#if PLATFORM_THREADING
+
+// Number of times per minute the LED timer has expired. The value is averaged over the time passed
+// since it was last recalculated, which happens at most once a minute
+class LedWakeupsDiagnosticData: public AbstractIntegerDiagnosticData {
+public:
+    LedWakeupsDiagnosticData() :
+            AbstractIntegerDiagnosticData(DIAG_ID_SYSTEM_LED_WAKEUPS, DIAG_NAME_SYSTEM_LED_WAKEUPS),
+            time_(0),
+            count_(0),
+            value_(0) {
+    }
+
+    virtual int get(IntType& val) override {
+        const system_tick_t now = HAL_Timer_Get_Milli_Seconds();
+        if (now - time_ >= WINDOW) {
+            const uint32_t count = g_ledWakeups;
+            value_ = (uint64_t)(count - count_) * WINDOW / (now - time_);
+            count_ = count;
+            time_ = now;
+        }
+        val = value_;
+        return 0; // OK
+    }
+
+private:
+    enum {
+        WINDOW = 60000 // Milliseconds
+    };
+
+    system_tick_t time_;
+    uint32_t count_;
+    IntType value_;
+};
+
+#endif // PLATFORM_THREADING
+
 class RunTimeInfoDiagnosticData: public AbstractIntegerDiagnosticData {
 public:
     typedef IntType(*func_t)(const runtime_info_t&);
@@ -682,6 +767,10 @@ HALEventHandler g_halEventHandler;
 
 UptimeDiagnosticData g_uptimeDiagData;
 
+#if PLATFORM_THREADING
+LedWakeupsDiagnosticData g_ledWakeupsDiagData;
+#endif
+
 RunTimeInfoDiagnosticData g_totalRamDiagData(DIAG_ID_SYSTEM_TOTAL_RAM, DIAG_NAME_SYSTEM_TOTAL_RAM,
     [](const runtime_info_t& info) -> RunTimeInfoDiagnosticData::IntType {
         return info.total_init_heap;
@@ -711,6 +800,10 @@ void app_setup_and_loop(void)
     // We have running firmware, otherwise we wouldn't have gotten here
     DECLARE_SYS_HEALTH(ENTERED_Main);
 
+#if PLATFORM_THREADING
+    startLedTimer();
+#endif
+
     LED_SIGNAL_START(NETWORK_OFF, BACKGROUND);
 
     // Reset all persistent settings to factory defaults if necessary
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logging.h"
+LOG_SOURCE_CATEGORY("sys.power")
+
+#include "power_state_machine.h"
+
+#include "system_error.h"
+
+#include <algorithm>
+
+using namespace particle::power;
+
+PowerStateMachine::PowerStateMachine(PowerManagerIo* io) :
+    io_(io),
+    update_(true),
+    batteryState_(BATTERY_STATE_UNKNOWN),
+    powerSource_(POWER_SOURCE_UNKNOWN),
+    faultSuppressed_(0),
+    faultSecondaryCounter_(0),
+    possibleFaultCounter_(0),
+    possibleFaultTimestamp_(0),
+    lowBatEnabled_(true),
+    chargingDisabledTimestamp_(0),
+    charge_(0.0f),
+    chargeTimestamp_(0),
+    chargeValid_(false) {
+}
+
+system_tick_t PowerStateMachine::process() {
+  handlePossibleFaultTimeout();
+  checkWatchdog();
+  // Interrupts received while the status is being read are coalesced into a single update
+  while (update_) {
+    update_ = false;
+    handleUpdate();
+  }
+  return nextTimeout();
+}
+
+void PowerStateMachine::sleep(bool s) {
+  // When going into sleep we do not want to exceed the default charging parameters set
+  // by initDefault(), which will be reset in case we are in a DISCONNECTED state with
+  // PMIC watchdog enabled. Reset to the defaults and disable watchdog before going into sleep.
+  if (s) {
+    // Going into sleep
+    if (batteryState_ == BATTERY_STATE_DISCONNECTED) {
+      initDefault();
+    }
+  } else {
+    // Wake up
+    initDefault();
+    update();
+  }
+}
+
+int PowerStateMachine::batteryCharge(float* charge) {
+  if (batteryState_ == BATTERY_STATE_DISCONNECTED) {
+    return SYSTEM_ERROR_INVALID_STATE;
+  }
+  const system_tick_t now = io_->millis();
+  // The value is stored before the timestamp, so a reader that sees a fresh timestamp also
+  // sees the respective value
+  if (chargeValid_ && now - chargeTimestamp_ < DEFAULT_BATTERY_CHARGE_MAX_AGE) {
+    *charge = charge_;
+    return 0;
+  }
+  const float val = io_->readBatteryCharge();
+  charge_ = val;
+  chargeTimestamp_ = now;
+  chargeValid_ = true;
+  *charge = val;
+  return 0;
+}
+
+void PowerStateMachine::handleUpdate() {
+  PmicStatus pmic = {};
+  io_->readPmicStatus(&pmic);
+
+  // Watchdog fault
+  if (pmic.fault & 0x80) {
+    // Restore parameters
+    initDefault();
+  }
+
+  battery_state_t state = BATTERY_STATE_UNKNOWN;
+
+  const uint8_t pwr_good = (pmic.status >> 2) & 0b01;
+
+  // Deduce current battery state
+  const uint8_t chrg_stat = (pmic.status >> 4) & 0b11;
+  if (chrg_stat) {
+    // Charging or charged
+    if (chrg_stat == 0b11) {
+      state = BATTERY_STATE_CHARGED;
+    } else {
+      state = BATTERY_STATE_CHARGING;
+    }
+  } else {
+    // For now we only know that the battery is not charging
+    state = BATTERY_STATE_NOT_CHARGING;
+    // Now we need to deduce whether it is NOT_CHARGING, DISCHARGING, or in a FAULT state
+    // const uint8_t chrg_fault = (pmic.fault >> 4) & 0b11;
+    const uint8_t bat_fault = (pmic.fault >> 3) & 0b01;
+    // const uint8_t ntc_fault = pmic.fault & 0b111;
+    if (bat_fault) {
+      state = BATTERY_STATE_FAULT;
+    } else if (!pwr_good) {
+      state = BATTERY_STATE_DISCHARGING;
+    }
+  }
+
+  if (batteryState_ == BATTERY_STATE_DISCONNECTED && state == BATTERY_STATE_NOT_CHARGING &&
+      chargingDisabledTimestamp_) {
+    // We are aware of the fact that charging has been disabled, stay in disconnected state
+    state = BATTERY_STATE_DISCONNECTED;
+  }
+
+  const bool lowBat = io_->readLowBatteryAlert();
+  handleStateChange(batteryState_, state, lowBat);
+
+  power_source_t src = powerSource_;
+  if (pwr_good) {
+    uint8_t vbus_stat = pmic.status >> 6;
+    switch (vbus_stat) {
+      case 0x01:
+        src = POWER_SOURCE_USB_HOST;
+        break;
+      case 0x02:
+        src = POWER_SOURCE_USB_ADAPTER;
+        break;
+      case 0x03:
+        src = POWER_SOURCE_USB_OTG;
+        break;
+      case 0x00:
+      default:
+        if ((pmic.misc & 0x80) == 0x00) {
+          // Not in DPDM detection anymore
+          src = POWER_SOURCE_VIN;
+          // It's not easy to detect when DPDM detection actually finishes,
+          // so just check input current source register whenever we are in this state
+          io_->restoreInputCurrentLimit();
+        }
+        break;
+    }
+  } else {
+    if (batteryState_ == BATTERY_STATE_DISCHARGING) {
+      src = POWER_SOURCE_BATTERY;
+    } else {
+      src = POWER_SOURCE_UNKNOWN;
+    }
+  }
+
+  if (powerSource_ != src) {
+    powerSource_ = src;
+    io_->notify(power_source, (int)powerSource_);
+  }
+
+  if (lowBat) {
+    io_->clearLowBatteryAlert();
+    if (lowBatEnabled_) {
+      lowBatEnabled_ = false;
+      io_->notify(low_battery, 0);
+    }
+  }
+
+  logStat(pmic.status, pmic.fault);
+}
+
+void PowerStateMachine::initDefault(bool dpdm) {
+  io_->initPmic(dpdm);
+  faultSuppressed_ = 0;
+}
+
+void PowerStateMachine::handleStateChange(battery_state_t from, battery_state_t to, bool low) {
+  switch (from) {
+    case BATTERY_STATE_CHARGING:
+    case BATTERY_STATE_CHARGED: {
+      if (!low) {
+        to = handlePossibleFault(from, to);
+      }
+    }
+    // NOTE: fall-through
+    default: {
+      if (from == to) {
+        // No state change occured
+        return;
+      }
+    }
+  }
+
+  switch (from) {
+    case BATTERY_STATE_DISCONNECTED: {
+      // When going from DISCONNECTED state to any other state quick start fuel gauge
+      io_->quickStartFuelGauge();
+      // The fuel gauge needs to re-estimate the state of charge
+      chargeValid_ = false;
+      initDefault();
+      break;
+    }
+    default:
+      break;
+  }
+
+  switch (to) {
+    case BATTERY_STATE_CHARGING: {
+      // When going into CHARGING state, enable low battery event
+      lowBatEnabled_ = true;
+      break;
+    }
+    case BATTERY_STATE_DISCONNECTED: {
+      // Disable charging
+      io_->disableCharging();
+      // Charging is re-enabled by checkWatchdog() after DEFAULT_WATCHDOG_TIMEOUT
+      chargingDisabledTimestamp_ = io_->millis();
+      break;
+    }
+    default:
+      break;
+  }
+
+  batteryState_ = to;
+
+  io_->notify(battery_state, (int)batteryState_);
+
+#if defined(DEBUG_BUILD)
+  static const char* states[] = {
+    "UNKNOWN",
+    "NOT_CHARGING",
+    "CHARGING",
+    "CHARGED",
+    "DISCHARGING",
+    "FAULT",
+    "DISCONNECTED"
+  };
+  LOG_DEBUG(TRACE, "Battery state %s -> %s", states[from], states[to]);
+#endif // defined(DEBUG_BUILD)
+}
+
+battery_state_t PowerStateMachine::handlePossibleFault(battery_state_t from, battery_state_t to) {
+  if (to == BATTERY_STATE_CHARGED || to == BATTERY_STATE_CHARGING) {
+    system_tick_t m = io_->millis();
+    if (m - possibleFaultTimestamp_ > DEFAULT_FAULT_WINDOW) {
+      possibleFaultTimestamp_ = m;
+      possibleFaultCounter_ = 0;
+      faultSecondaryCounter_ = 0;
+    } else {
+      possibleFaultCounter_++;
+      if (possibleFaultCounter_ >= DEFAULT_FAULT_COUNT_THRESHOLD &&
+         (faultSuppressed_ == 0 || (m - faultSuppressed_ >= DEFAULT_FAULT_SUPPRESSION_PERIOD))) {
+        if (faultSecondaryCounter_ > 0) {
+          faultSecondaryCounter_ = 0;
+          return BATTERY_STATE_DISCONNECTED;
+        } else {
+          io_->setRechargeThreshold(300);
+          possibleFaultCounter_ = 0;
+          faultSecondaryCounter_ = 1;
+          possibleFaultTimestamp_ = io_->millis();
+        }
+      }
+    }
+  }
+  return to;
+}
+
+void PowerStateMachine::handlePossibleFaultTimeout() {
+  if (faultSecondaryCounter_ == 1 && (io_->millis() - possibleFaultTimestamp_ > DEFAULT_FAULT_WINDOW)) {
+    io_->setRechargeThreshold(100);
+    faultSecondaryCounter_ = 0;
+    faultSuppressed_ = io_->millis();
+  }
+}
+
+void PowerStateMachine::checkWatchdog() {
+  if (batteryState_ == BATTERY_STATE_DISCONNECTED && chargingDisabledTimestamp_ &&
+      ((io_->millis() - chargingDisabledTimestamp_) >= DEFAULT_WATCHDOG_TIMEOUT)) {
+    // Re-enable charging, do not run DPDM detection
+    LOG_DEBUG(TRACE, "re-enabling charging");
+    chargingDisabledTimestamp_ = 0;
+    initDefault(false);
+    // Re-evaluate the battery state, since the PMIC doesn't necessarily generate an interrupt
+    update();
+  }
+}
+
+system_tick_t PowerStateMachine::nextTimeout() {
+  system_tick_t timeout = WAIT_FOREVER;
+  const system_tick_t now = io_->millis();
+  if (faultSecondaryCounter_ == 1) {
+    const system_tick_t elapsed = now - possibleFaultTimestamp_;
+    timeout = (elapsed > DEFAULT_FAULT_WINDOW) ? 0 : DEFAULT_FAULT_WINDOW - elapsed + 1;
+  }
+  if (batteryState_ == BATTERY_STATE_DISCONNECTED && chargingDisabledTimestamp_) {
+    const system_tick_t elapsed = now - chargingDisabledTimestamp_;
+    timeout = std::min(timeout, (elapsed >= DEFAULT_WATCHDOG_TIMEOUT) ? 0 : DEFAULT_WATCHDOG_TIMEOUT - elapsed);
+  }
+  if (update_) {
+    timeout = 0;
+  }
+  return timeout;
+}
+
+void PowerStateMachine::logStat(uint8_t stat, uint8_t fault) {
+#if defined(DEBUG_BUILD) && 0
+  uint8_t vbus_stat = stat >> 6; // 0 – Unknown (no input, or DPDM detection incomplete), 1 – USB host, 2 – Adapter port, 3 – OTG
+  uint8_t chrg_stat = (stat >> 4) & 0x03; // 0 – Not Charging, 1 – Pre-charge (<VBATLOWV), 2 – Fast Charging, 3 – Charge Termination Done
+  bool dpm_stat = stat & 0x08;   // 0 – Not DPM, 1 – VINDPM or IINDPM
+  bool pg_stat = stat & 0x04;    // 0 – Not Power Good, 1 – Power Good
+  bool therm_stat = stat & 0x02; // 0 – Normal, 1 – In Thermal Regulation
+  bool vsys_stat = stat & 0x01;  // 0 – Not in VSYSMIN regulation (BAT > VSYSMIN), 1 – In VSYSMIN regulation (BAT < VSYSMIN)
+  bool wd_fault = fault & 0x80;  // 0 – Normal, 1- Watchdog timer expiration
+  uint8_t chrg_fault = (fault >> 4) & 0x03; // 0 – Normal, 1 – Input fault (VBUS OVP or VBAT < VBUS < 3.8 V),
+                                            // 2 - Thermal shutdown, 3 – Charge Safety Timer Expiration
+  bool bat_fault = fault & 0x08;    // 0 – Normal, 1 – BATOVP
+  uint8_t ntc_fault = fault & 0x07; // 0 – Normal, 5 – Cold, 6 – Hot
+  LOG_DEBUG(TRACE, "[ PMIC STAT ] VBUS:%d CHRG:%d DPM:%d PG:%d THERM:%d VSYS:%d", vbus_stat, chrg_stat, dpm_stat, pg_stat, therm_stat, vsys_stat);
+  LOG_DEBUG(TRACE, "[ PMIC FAULT ] WATCHDOG:%d CHRG:%d BAT:%d NTC:%d", wd_fault, chrg_fault, bat_fault, ntc_fault);
+#endif
+}
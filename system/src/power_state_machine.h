@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_power.h"
+#include "system_event.h"
+#include "system_tick_hal.h"
+#include "hal_platform.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace particle { namespace power {
+
+static const uint16_t DEFAULT_INPUT_CURRENT_LIMIT = 900;
+static const system_tick_t DEFAULT_FAULT_WINDOW = 1000;
+static const uint32_t DEFAULT_FAULT_COUNT_THRESHOLD = HAL_PLATFORM_PMIC_BQ24195_FAULT_COUNT_THRESHOLD;
+static const system_tick_t DEFAULT_FAULT_SUPPRESSION_PERIOD = 60000;
+static const system_tick_t DEFAULT_WATCHDOG_TIMEOUT = 60000;
+// Maximum age of the cached state of charge
+static const system_tick_t DEFAULT_BATTERY_CHARGE_MAX_AGE = 10000;
+
+// Contents of the PMIC status registers
+struct PmicStatus {
+  uint8_t misc; // MISC_CONTROL_REGISTER (REG07)
+  uint8_t status; // SYSTEM_STATUS_REGISTER (REG08)
+  uint8_t fault; // FAULT_REGISTER (REG09)
+};
+
+// Interface to the PMIC and fuel gauge used by the power management state machine
+class PowerManagerIo {
+public:
+  virtual ~PowerManagerIo() = default;
+
+  // Reads the status registers of the PMIC. The fault register latches the fault conditions
+  // until it's read, so the current fault status is obtained by reading it twice
+  virtual void readPmicStatus(PmicStatus* status) = 0;
+  // Restores the default PMIC parameters and optionally restarts the input current limit detection
+  virtual void initPmic(bool dpdm) = 0;
+  virtual void setRechargeThreshold(uint16_t voltage) = 0;
+  virtual void disableCharging() = 0;
+  // Restores the default input current limit if it has been changed by the PMIC
+  virtual void restoreInputCurrentLimit() = 0;
+  // Returns true if the fuel gauge has raised the low battery alert
+  virtual bool readLowBatteryAlert() = 0;
+  virtual void clearLowBatteryAlert() = 0;
+  // Returns the normalized state of charge (0-100%)
+  virtual float readBatteryCharge() = 0;
+  virtual void quickStartFuelGauge() = 0;
+  // Called when the battery state or power source changes, or when the battery runs low
+  virtual void notify(system_event_t event, int data) = 0;
+  virtual system_tick_t millis() = 0;
+};
+
+/**
+ * Power management state machine.
+ *
+ * The state of the PMIC and fuel gauge is only read when either of them signals an interrupt,
+ * or when one of the fault handling timeouts expires. Between these events the owning thread
+ * sleeps for the time returned by `process()`, which is `WAIT_FOREVER` in the steady state.
+ * The state of charge is cached and only read from the fuel gauge once the cached value gets
+ * older than `DEFAULT_BATTERY_CHARGE_MAX_AGE`.
+ */
+class PowerStateMachine {
+public:
+  static const system_tick_t WAIT_FOREVER = (system_tick_t)-1;
+
+  explicit PowerStateMachine(PowerManagerIo* io);
+
+  // Requests a status update. This method can be called from an ISR
+  void update();
+  // Processes the pending updates and timeouts. Returns the number of milliseconds until the
+  // next timeout, or `WAIT_FOREVER`
+  system_tick_t process();
+  void sleep(bool s);
+
+  // Returns the normalized state of charge. This method can be called from any thread
+  int batteryCharge(float* charge);
+
+  bool isUpdatePending() const;
+  battery_state_t batteryState() const;
+  power_source_t powerSource() const;
+
+private:
+  PowerManagerIo* io_;
+  volatile bool update_;
+  battery_state_t batteryState_;
+  power_source_t powerSource_;
+  system_tick_t faultSuppressed_;
+  uint32_t faultSecondaryCounter_;
+  uint32_t possibleFaultCounter_;
+  system_tick_t possibleFaultTimestamp_;
+  bool lowBatEnabled_;
+  system_tick_t chargingDisabledTimestamp_;
+  std::atomic<float> charge_;
+  std::atomic<system_tick_t> chargeTimestamp_;
+  std::atomic_bool chargeValid_;
+
+  void handleUpdate();
+  void initDefault(bool dpdm = true);
+  void handleStateChange(battery_state_t from, battery_state_t to, bool low);
+  battery_state_t handlePossibleFault(battery_state_t from, battery_state_t to);
+  void handlePossibleFaultTimeout();
+  void checkWatchdog();
+  system_tick_t nextTimeout();
+  void logStat(uint8_t stat, uint8_t fault);
+};
+
+inline void PowerStateMachine::update() {
+  update_ = true;
+}
+
+inline bool PowerStateMachine::isUpdatePending() const {
+  return update_;
+}
+
+inline battery_state_t PowerStateMachine::batteryState() const {
+  return batteryState_;
+}
+
+inline power_source_t PowerStateMachine::powerSource() const {
+  return powerSource_;
+}
+
+} } // particle::power
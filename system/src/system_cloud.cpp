@@ -37,6 +37,11 @@
 #include "events.h"
 #include "deviceid_hal.h"
 #include "system_mode.h"
+#include "bytes2hexbuf.h"
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
 
 extern void (*random_seed_from_cloud_handler)(unsigned int);
 
@@ -111,8 +116,58 @@ inline uint32_t convert(uint32_t flags) {
 	return flags;
 }
 
+#if PLATFORM_THREADING
+
+namespace {
+
+// Copies the event and queues it for the system thread without waiting for the result. The completion
+// callback is invoked by the protocol layer once the event is sent, unless the function returns false
+bool send_event_async(const char* name, const char* data, int ttl, uint32_t flags, void* reserved)
+{
+    const size_t nameSize = strlen(name) + 1;
+    const size_t dataSize = data ? strlen(data) + 1 : 0;
+    const auto buf = new(std::nothrow) char[nameSize + dataSize];
+    if (!buf) {
+        return false;
+    }
+    memcpy(buf, name, nameSize);
+    char* const dataCopy = data ? buf + nameSize : nullptr;
+    if (data) {
+        memcpy(dataCopy, data, dataSize);
+    }
+    spark_send_event_data d = { sizeof(spark_send_event_data) };
+    if (reserved) {
+        auto r = static_cast<const spark_send_event_data*>(reserved);
+        d.handler_callback = r->handler_callback;
+        d.handler_data = r->handler_data;
+    }
+    auto lambda = [=]() {
+        auto dd = d;
+        spark_send_event(buf, dataCopy, ttl, flags, &dd);
+        delete[] buf;
+    };
+    if (!SystemThread.invoke_async(FFL(lambda))) {
+        delete[] buf;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+#endif // PLATFORM_THREADING
+
 bool spark_send_event(const char* name, const char* data, int ttl, uint32_t flags, void* reserved)
 {
+    const bool async = (flags & PUBLISH_EVENT_FLAG_ASYNC);
+    flags &= ~PUBLISH_EVENT_FLAG_ASYNC;
+#if PLATFORM_THREADING
+    if (async && SystemThread.isStarted() && !SystemThread.isCurrentThread()) {
+        return send_event_async(name, data, ttl, flags, reserved);
+    }
+#else
+    (void)async;
+#endif
     SYSTEM_THREAD_CONTEXT_SYNC(spark_send_event(name, data, ttl, flags, reserved));
 
     spark_protocol_send_event_data d = { sizeof(spark_protocol_send_event_data) };
@@ -185,12 +240,38 @@ void spark_process(void)
     Spark_Idle_Events(true);
 }
 
-String spark_deviceID(void)
+size_t spark_device_id(char* buf, size_t size, void* reserved)
 {
-    unsigned len = HAL_device_ID(NULL, 0);
+    const unsigned len = HAL_device_ID(NULL, 0);
     uint8_t id[len];
     HAL_device_ID(id, len);
-    return bytes2hex(id, len);
+    char hex[len * 2];
+    bytes2hexbuf_lower_case(id, len, hex);
+    if (size > 0) {
+        const size_t n = std::min(size - 1, sizeof(hex));
+        memcpy(buf, hex, n);
+        buf[n] = '\0';
+    }
+    return sizeof(hex);
+}
+
+#ifdef __arm__
+static_assert(sizeof(spark_legacy_string_t) == 16, "The legacy String layout has changed");
+#endif
+
+spark_legacy_string_t spark_deviceID_legacy(void)
+{
+    spark_legacy_string_t s = {};
+    const size_t len = spark_device_id(nullptr, 0, nullptr);
+    // Allocated on the heap since the inline buffer of the new String layout doesn't exist in the
+    // application's String
+    s.buffer = (char*)malloc(len + 1);
+    if (s.buffer) {
+        spark_device_id(s.buffer, len + 1, nullptr);
+        s.capacity = len;
+        s.len = len;
+    }
+    return s;
 }
 
 int spark_set_connection_property(unsigned property_id, unsigned data, particle::protocol::connection_properties_t* conn_prop, void* reserved)
@@ -18,61 +18,93 @@
  */
 
 #include "system_event.h"
+#include "system_event_bus.h"
 #include "system_threading.h"
 #include "interrupts_hal.h"
+#include "timer_hal.h"
 #include "system_task.h"
+#include "spark_wiring_thread.h"
+#include "spark_wiring_diagnostics.h"
 #include <stdint.h>
-#include <vector>
+
+using namespace particle;
+using namespace particle::system;
 
 namespace {
 
-struct SystemEventSubscription {
+class SystemEventBusIo: public EventBusIo {
+public:
+    virtual bool post(std::function<void()> fn) override {
+#if PLATFORM_THREADING
+        if (ApplicationThread.isStarted() && !ApplicationThread.isCurrentThread()) {
+            return ApplicationThread.invoke_async(fn);
+        }
+#endif
+        return false;
+    }
 
-    system_event_t events;
-    system_event_handler_t* handler;
+    virtual uint32_t micros() override {
+        return HAL_Timer_Get_Micro_Seconds();
+    }
 
-    SystemEventSubscription() : SystemEventSubscription(0, nullptr) {}
-    SystemEventSubscription(system_event_t e, system_event_handler_t* h) :
-    events(e), handler(h) {}
+    virtual void lock() override {
+#if PLATFORM_THREADING
+        mutex().lock();
+#endif
+    }
 
-    inline bool matchesHandler(system_event_handler_t* matchHandler) const
-    {
-        return (matchHandler==nullptr) || (matchHandler==handler);
+    virtual void unlock() override {
+#if PLATFORM_THREADING
+        mutex().unlock();
+#endif
     }
 
-    inline bool matchesEvent(system_event_t matchEvents) const
-    {
-        return (events&matchEvents)!=0;
+private:
+#if PLATFORM_THREADING
+    static RecursiveMutex& mutex() {
+        static RecursiveMutex m;
+        return m;
     }
+#endif
+};
+
+SystemEventBusIo g_eventBusIo;
+EventBus g_eventBus(&g_eventBusIo);
 
-    bool matches(const SystemEventSubscription& subscription) const
-    {
-        return matchesHandler(subscription.handler) && matchesEvent(subscription.events);
+class EventQueueDepthDiagnosticData: public AbstractIntegerDiagnosticData {
+public:
+    EventQueueDepthDiagnosticData() :
+            AbstractIntegerDiagnosticData(DIAG_ID_SYSTEM_EVENT_QUEUE_DEPTH, DIAG_NAME_SYSTEM_EVENT_QUEUE_DEPTH) {
     }
 
-    void notify(system_event_t event, uint32_t data, void* pointer) const
-    {
-        if (matchesEvent(event))
-            handler(event, data, pointer);
+    virtual int get(IntType& val) override {
+        val = g_eventBus.stats().queueDepth;
+        return 0; // OK
     }
 };
 
-// for now a simple implementation
-std::vector<SystemEventSubscription> subscriptions;
-
-void system_notify_event_impl(system_event_t event, uint32_t data, void* pointer, void (*fn)(void* data), void* fndata) {
-    for (const SystemEventSubscription& subscription : subscriptions) {
-        subscription.notify(event, data, pointer);
+class EventHandlerLatencyDiagnosticData: public AbstractIntegerDiagnosticData {
+public:
+    EventHandlerLatencyDiagnosticData() :
+            AbstractIntegerDiagnosticData(DIAG_ID_SYSTEM_EVENT_HANDLER_LATENCY, DIAG_NAME_SYSTEM_EVENT_HANDLER_LATENCY) {
     }
-    if (fn) {
-        fn(fndata);
+
+    virtual int get(IntType& val) override {
+        val = g_eventBus.stats().maxLatency;
+        return 0; // OK
     }
+};
+
+EventQueueDepthDiagnosticData g_eventQueueDepthDiagData;
+EventHandlerLatencyDiagnosticData g_eventHandlerLatencyDiagData;
+
+void system_notify_event_impl(system_event_t event, uint32_t data, void* pointer, void (*fn)(void* data), void* fndata) {
+    g_eventBus.notifySync(event, data, pointer, fn, fndata);
 }
 
 void system_notify_event_async(system_event_t event, uint32_t data, void* pointer, void (*fn)(void* data), void* fndata) {
-    // run event notifications on the application thread
-    APPLICATION_THREAD_CONTEXT_ASYNC(system_notify_event_async(event, data, pointer, fn, fndata));
-    system_notify_event_impl(event, data, pointer, fn, fndata);
+    // inline handlers are called by the current thread, the others on the application thread
+    g_eventBus.notify(event, data, pointer, fn, fndata);
 }
 
 class SystemEventTask : public ISRTaskQueue::Task {
@@ -116,23 +148,28 @@ public:
  * Subscribes to the system events given
  * @param events    One or more system events. Multiple system events are specified using the + operator.
  * @param handler   The system handler function to call.
- * @param reserved  Set to NULL.
+ * @param options   Subscription options (see `system_event_subscribe_options`), or NULL.
  * @return {@code 0} if the system event handlers were registered successfully. Non-zero otherwise.
  */
-int system_subscribe_event(system_event_t events, system_event_handler_t* handler, void* reserved)
+int system_subscribe_event(system_event_t events, system_event_handler_t* handler, void* options)
 {
-    size_t count = subscriptions.size();
-    subscriptions.push_back(SystemEventSubscription(events, handler));
-    return subscriptions.size()==count+1 ? 0 : -1;
+    auto mode = SYSTEM_EVENT_DELIVERY_QUEUED;
+    const auto opts = static_cast<const system_event_subscribe_options*>(options);
+    if (opts && opts->size >= offsetof(system_event_subscribe_options, delivery_mode) + sizeof(opts->delivery_mode)) {
+        mode = (system_event_delivery_mode)opts->delivery_mode;
+    }
+    return g_eventBus.subscribe(events, handler, mode);
 }
 
 /**
  * Unsubscribes a handler from the given events.
- * @param handler   The handler that will be unsubscribed.
+ * @param events    One or more system events.
+ * @param handler   The handler that will be unsubscribed, or NULL to unsubscribe all handlers.
  * @param reserved  Set to NULL.
  */
 void system_unsubscribe_event(system_event_t events, system_event_handler_t* handler, void* reserved)
 {
+    g_eventBus.unsubscribe(events, handler);
 }
 
 void system_notify_event(system_event_t event, uint32_t data, void* pointer, void (*fn)(void* data), void* fndata,
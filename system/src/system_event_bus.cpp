@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "system_event_bus.h"
+
+#include "system_error.h"
+
+#include <new>
+
+namespace particle { namespace system {
+
+namespace {
+
+unsigned eventBitCount(system_event_t events) {
+    unsigned n = 0;
+    for (; events; events &= events - 1) {
+        ++n;
+    }
+    return n;
+}
+
+// Returns the index of the event bit, or -1 if more than one bit is set
+int singleEventBit(system_event_t event) {
+    if (!event || (event & (event - 1))) {
+        return -1;
+    }
+    int bit = 0;
+    while (!(event & 1)) {
+        event >>= 1;
+        ++bit;
+    }
+    return bit;
+}
+
+inline system_event_t eventMask(unsigned bit) {
+    return (system_event_t)1 << bit;
+}
+
+class EventBusLock {
+public:
+    explicit EventBusLock(EventBusIo* io) :
+            io_(io) {
+        io_->lock();
+    }
+
+    ~EventBusLock() {
+        io_->unlock();
+    }
+
+private:
+    EventBusIo* io_;
+};
+
+} // unnamed
+
+struct EventBus::Subscription {
+    system_event_t events;
+    system_event_handler_t* handler; // Null if the subscription has been removed
+    uint32_t seq;
+    uint8_t mode;
+    bool wide; // Set if the subscription is not in the per-event lists
+    Subscription* next;
+    Subscription* nextWide;
+    Subscription* nextFree;
+};
+
+struct EventBus::Node {
+    Subscription* sub; // Null if the node has been removed
+    Node* next;
+    Node* nextFree;
+    // Latest notification for a coalesced subscription
+    system_event_t event;
+    uint32_t data;
+    void* pointer;
+    uint32_t time;
+    bool pending;
+};
+
+struct EventBus::Delivery {
+    system_event_t event;
+    uint32_t data;
+    void* pointer;
+    void (*fn)(void*);
+    void* fndata;
+    uint32_t time;
+    int flushBit; // Event bit to deliver to the coalesced handlers, or -1
+    bool queued; // Set if the notification needs to be delivered to the queued handlers
+};
+
+EventBus::EventBus(EventBusIo* io) :
+        lists_(),
+        subs_(nullptr),
+        wide_(nullptr),
+        freeNodes_(nullptr),
+        freeSubs_(nullptr),
+        flushPending_(0),
+        seq_(0),
+        dispatchDepth_(0),
+        io_(io),
+        stats_() {
+}
+
+EventBus::~EventBus() {
+    for (Node* list: lists_) {
+        while (list) {
+            Node* n = list;
+            list = list->next;
+            delete n;
+        }
+    }
+    while (subs_) {
+        Subscription* s = subs_;
+        subs_ = subs_->next;
+        delete s;
+    }
+}
+
+int EventBus::subscribe(system_event_t events, system_event_handler_t* handler, system_event_delivery_mode mode) {
+    if (!events || !handler || mode > SYSTEM_EVENT_DELIVERY_COALESCED) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    const EventBusLock lock(io_);
+    const auto sub = new(std::nothrow) Subscription();
+    if (!sub) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    sub->events = events;
+    sub->handler = handler;
+    sub->seq = ++seq_;
+    sub->mode = mode;
+    // Coalesced notifications are tracked per event, so such subscriptions are always listed
+    sub->wide = (mode != SYSTEM_EVENT_DELIVERY_COALESCED && eventBitCount(events) > MAX_LISTED_EVENTS);
+    if (!sub->wide) {
+        for (unsigned bit = 0; bit < EVENT_BITS; ++bit) {
+            if ((events & eventMask(bit)) && addNode(bit, sub) != 0) {
+                for (unsigned i = 0; i < bit; ++i) {
+                    if (events & eventMask(i)) {
+                        removeNode(i, sub);
+                    }
+                }
+                delete sub;
+                return SYSTEM_ERROR_NO_MEMORY;
+            }
+        }
+    }
+    Subscription** s = &subs_;
+    while (*s) {
+        s = &(*s)->next;
+    }
+    *s = sub;
+    if (sub->wide) {
+        s = &wide_;
+        while (*s) {
+            s = &(*s)->nextWide;
+        }
+        *s = sub;
+    }
+    return 0;
+}
+
+void EventBus::unsubscribe(system_event_t events, system_event_handler_t* handler) {
+    const EventBusLock lock(io_);
+    Subscription* sub = subs_;
+    while (sub) {
+        Subscription* const next = sub->next;
+        const system_event_t e = sub->events & events;
+        if (e && (!handler || sub->handler == handler)) {
+            if (!sub->wide) {
+                for (unsigned bit = 0; bit < EVENT_BITS; ++bit) {
+                    if (e & eventMask(bit)) {
+                        removeNode(bit, sub);
+                    }
+                }
+            }
+            sub->events &= ~events;
+            if (!sub->events) {
+                removeSubscription(sub);
+            }
+        }
+        sub = next;
+    }
+}
+
+void EventBus::notify(system_event_t event, uint32_t data, void* pointer, void (*fn)(void*), void* fndata) {
+    Delivery d = {};
+    d.event = event;
+    d.data = data;
+    d.pointer = pointer;
+    d.fn = fn;
+    d.fndata = fndata;
+    d.time = io_->micros();
+    d.flushBit = -1;
+    d.queued = (fn != nullptr);
+    if (!dispatch(&d)) {
+        return;
+    }
+    if (!io_->post([this, d]() { deliver(d); })) {
+        deliver(d);
+    }
+}
+
+void EventBus::notifySync(system_event_t event, uint32_t data, void* pointer, void (*fn)(void*), void* fndata) {
+    dispatchSync(event, data, pointer, io_->micros());
+    if (fn) {
+        fn(fndata);
+    }
+}
+
+size_t EventBus::subscriberCount(system_event_t events) const {
+    const EventBusLock lock(io_);
+    size_t n = 0;
+    for (const Subscription* sub = subs_; sub; sub = sub->next) {
+        if (sub->events & events) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+// Calls the inline handlers and updates the pending notifications of the coalesced handlers.
+// Returns true if the notification needs to be posted to the application thread
+bool EventBus::dispatch(Delivery* d) {
+    const EventBusLock lock(io_);
+    beginDispatch();
+    const int bit = singleEventBit(d->event);
+    if (bit >= 0) {
+        forEach(bit, [&](Subscription* sub, Node* node) {
+            if (sub->mode == SYSTEM_EVENT_DELIVERY_INLINE) {
+                call(sub, d->event, d->data, d->pointer, d->time);
+            } else if (sub->mode == SYSTEM_EVENT_DELIVERY_COALESCED) {
+                if (node->pending) {
+                    ++stats_.coalesced;
+                }
+                node->event = d->event;
+                node->data = d->data;
+                node->pointer = d->pointer;
+                node->time = d->time;
+                node->pending = true;
+                if (!(flushPending_ & eventMask(bit))) {
+                    flushPending_ |= eventMask(bit);
+                    d->flushBit = bit;
+                }
+            } else {
+                d->queued = true;
+            }
+        });
+    } else {
+        // Notifications about several events at once are not coalesced
+        for (Subscription* sub = subs_; sub; sub = sub->next) {
+            if (sub->handler && (sub->events & d->event)) {
+                if (sub->mode == SYSTEM_EVENT_DELIVERY_INLINE) {
+                    call(sub, d->event, d->data, d->pointer, d->time);
+                } else {
+                    d->queued = true;
+                }
+            }
+        }
+    }
+    endDispatch();
+    if (!d->queued && d->flushBit < 0) {
+        return false;
+    }
+    if (++stats_.queueDepth > stats_.maxQueueDepth) {
+        stats_.maxQueueDepth = stats_.queueDepth;
+    }
+    return true;
+}
+
+void EventBus::dispatchSync(system_event_t event, uint32_t data, void* pointer, uint32_t time) {
+    const EventBusLock lock(io_);
+    beginDispatch();
+    const int bit = singleEventBit(event);
+    if (bit >= 0) {
+        forEach(bit, [&](Subscription* sub, Node* node) {
+            call(sub, event, data, pointer, time);
+        });
+    } else {
+        for (Subscription* sub = subs_; sub; sub = sub->next) {
+            if (sub->handler && (sub->events & event)) {
+                call(sub, event, data, pointer, time);
+            }
+        }
+    }
+    endDispatch();
+}
+
+void EventBus::deliver(const Delivery& d) {
+    {
+        const EventBusLock lock(io_);
+        --stats_.queueDepth;
+        beginDispatch();
+        if (d.queued) {
+            deliverQueued(d);
+        }
+        if (d.flushBit >= 0) {
+            flush(d.flushBit);
+        }
+        endDispatch();
+    }
+    if (d.fn) {
+        d.fn(d.fndata);
+    }
+}
+
+void EventBus::deliverQueued(const Delivery& d) {
+    const int bit = singleEventBit(d.event);
+    if (bit >= 0) {
+        forEach(bit, [&](Subscription* sub, Node* node) {
+            if (sub->mode == SYSTEM_EVENT_DELIVERY_QUEUED) {
+                call(sub, d.event, d.data, d.pointer, d.time);
+            }
+        });
+    } else {
+        for (Subscription* sub = subs_; sub; sub = sub->next) {
+            if (sub->handler && (sub->events & d.event) && sub->mode != SYSTEM_EVENT_DELIVERY_INLINE) {
+                call(sub, d.event, d.data, d.pointer, d.time);
+            }
+        }
+    }
+}
+
+void EventBus::flush(unsigned bit) {
+    flushPending_ &= ~eventMask(bit);
+    for (Node* node = lists_[bit]; node; node = node->next) {
+        if (node->sub && node->pending) {
+            node->pending = false;
+            call(node->sub, node->event, node->data, node->pointer, node->time);
+        }
+    }
+}
+
+void EventBus::call(Subscription* sub, system_event_t event, uint32_t data, void* pointer, uint32_t time) {
+    const auto handler = sub->handler;
+    io_->unlock();
+    handler(event, data, pointer);
+    io_->lock();
+    const uint32_t latency = io_->micros() - time;
+    ++stats_.handlerCalls;
+    stats_.lastLatency = latency;
+    if (latency > stats_.maxLatency) {
+        stats_.maxLatency = latency;
+    }
+}
+
+// Calls a function for each subscription to the event bit in the order of subscription, merging
+// the per-event list with the list of wide subscriptions. The node is null for wide subscriptions
+template<typename F>
+void EventBus::forEach(unsigned bit, F fn) {
+    const system_event_t mask = eventMask(bit);
+    Node* node = lists_[bit];
+    Subscription* wide = wide_;
+    for (;;) {
+        while (node && !node->sub) {
+            node = node->next;
+        }
+        while (wide && (!wide->handler || !(wide->events & mask))) {
+            wide = wide->nextWide;
+        }
+        if (node && (!wide || node->sub->seq < wide->seq)) {
+            Node* const n = node;
+            node = node->next;
+            fn(n->sub, n);
+        } else if (wide) {
+            Subscription* const s = wide;
+            wide = wide->nextWide;
+            fn(s, nullptr);
+        } else {
+            break;
+        }
+    }
+}
+
+int EventBus::addNode(unsigned bit, Subscription* sub) {
+    const auto node = new(std::nothrow) Node();
+    if (!node) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    node->sub = sub;
+    Node** n = &lists_[bit];
+    while (*n) {
+        n = &(*n)->next;
+    }
+    *n = node;
+    return 0;
+}
+
+void EventBus::removeNode(unsigned bit, Subscription* sub) {
+    for (Node** n = &lists_[bit]; *n; n = &(*n)->next) {
+        Node* const node = *n;
+        if (node->sub == sub) {
+            *n = node->next;
+            // A node that is being iterated over is only marked as removed, and its `next` field
+            // is left intact until the dispatch completes
+            node->sub = nullptr;
+            if (dispatchDepth_ > 0) {
+                node->nextFree = freeNodes_;
+                freeNodes_ = node;
+            } else {
+                delete node;
+            }
+            break;
+        }
+    }
+}
+
+void EventBus::removeSubscription(Subscription* sub) {
+    for (Subscription** s = &subs_; *s; s = &(*s)->next) {
+        if (*s == sub) {
+            *s = sub->next;
+            break;
+        }
+    }
+    if (sub->wide) {
+        for (Subscription** s = &wide_; *s; s = &(*s)->nextWide) {
+            if (*s == sub) {
+                *s = sub->nextWide;
+                break;
+            }
+        }
+    }
+    sub->handler = nullptr;
+    if (dispatchDepth_ > 0) {
+        sub->nextFree = freeSubs_;
+        freeSubs_ = sub;
+    } else {
+        delete sub;
+    }
+}
+
+void EventBus::beginDispatch() {
+    ++dispatchDepth_;
+}
+
+void EventBus::endDispatch() {
+    if (--dispatchDepth_ > 0) {
+        return;
+    }
+    while (freeNodes_) {
+        Node* const n = freeNodes_;
+        freeNodes_ = n->nextFree;
+        delete n;
+    }
+    while (freeSubs_) {
+        Subscription* const s = freeSubs_;
+        freeSubs_ = s->nextFree;
+        delete s;
+    }
+}
+
+} } // namespace particle::system
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_event.h"
+
+#include <functional>
+#include <cstdint>
+
+namespace particle { namespace system {
+
+// Interface to the threading and timing facilities used by the event bus
+class EventBusIo {
+public:
+    virtual ~EventBusIo() = default;
+
+    // Schedules a function for execution in the context of the application thread. Returns false
+    // if the function can't be scheduled, in which case the event bus calls it synchronously
+    virtual bool post(std::function<void()> fn) = 0;
+    virtual uint32_t micros() = 0;
+    // Locks the state of the event bus. The lock needs to be recursive
+    virtual void lock() = 0;
+    virtual void unlock() = 0;
+};
+
+struct EventBusStats {
+    uint32_t queueDepth; // Number of notifications that are waiting for delivery
+    uint32_t maxQueueDepth;
+    uint32_t handlerCalls;
+    uint32_t coalesced; // Number of notifications replaced with a newer one before delivery
+    uint32_t lastLatency; // Microseconds between a notification and the return from its handler
+    uint32_t maxLatency;
+};
+
+/**
+ * System event bus.
+ *
+ * The subscriptions are kept in a separate list for each event bit, so that a notification only
+ * touches the handlers interested in it. Subscriptions to many events at once, such as
+ * `all_events`, are kept in a single list instead, which is checked for every notification.
+ *
+ * Each subscription has its own delivery mode (see `system_event_delivery_mode`): inline handlers
+ * are called by the notifying thread, while queued and coalesced handlers are called in the
+ * context of the application thread. A coalesced subscription keeps only the latest notification
+ * of each event while the delivery is pending.
+ *
+ * The state of the event bus is protected with the lock provided by `EventBusIo`, which is
+ * released while a handler is being called. Handlers can subscribe and unsubscribe, and other
+ * threads can do the same while a notification is being delivered: removed subscriptions are
+ * only freed once all deliveries in progress have completed.
+ */
+class EventBus {
+public:
+    static const unsigned EVENT_BITS = sizeof(system_event_t) * 8;
+    // Subscriptions to more events than this are not added to the per-event lists
+    static const unsigned MAX_LISTED_EVENTS = 8;
+
+    explicit EventBus(EventBusIo* io);
+    ~EventBus();
+
+    int subscribe(system_event_t events, system_event_handler_t* handler,
+            system_event_delivery_mode mode = SYSTEM_EVENT_DELIVERY_QUEUED);
+    // Unsubscribes a handler, or all handlers if `handler` is null, from the given events
+    void unsubscribe(system_event_t events, system_event_handler_t* handler);
+
+    // Delivers a notification to each handler according to its delivery mode. `fn` is called
+    // after the queued handlers
+    void notify(system_event_t event, uint32_t data, void* pointer, void (*fn)(void*) = nullptr,
+            void* fndata = nullptr);
+    // Calls all handlers synchronously, regardless of their delivery mode
+    void notifySync(system_event_t event, uint32_t data, void* pointer, void (*fn)(void*) = nullptr,
+            void* fndata = nullptr);
+
+    // Returns the number of handlers subscribed to any of the given events
+    size_t subscriberCount(system_event_t events) const;
+
+    const EventBusStats& stats() const;
+
+private:
+    struct Subscription;
+    struct Node;
+    struct Delivery;
+
+    Node* lists_[EVENT_BITS]; // Subscriptions per event bit, in the order of subscription
+    Subscription* subs_; // All subscriptions, in the order of subscription
+    Subscription* wide_; // Subscriptions that are not in the per-event lists
+    Node* freeNodes_; // Nodes and subscriptions removed during a dispatch
+    Subscription* freeSubs_;
+    uint64_t flushPending_; // Event bits with a pending delivery to the coalesced handlers
+    uint32_t seq_; // Sequence number of the last subscription
+    unsigned dispatchDepth_;
+    EventBusIo* io_;
+    EventBusStats stats_;
+
+    bool dispatch(Delivery* d);
+    void dispatchSync(system_event_t event, uint32_t data, void* pointer, uint32_t time);
+    void deliver(const Delivery& d);
+    void deliverQueued(const Delivery& d);
+    void flush(unsigned bit);
+    void call(Subscription* sub, system_event_t event, uint32_t data, void* pointer, uint32_t time);
+    int addNode(unsigned bit, Subscription* sub);
+    void removeNode(unsigned bit, Subscription* sub);
+    void removeSubscription(Subscription* sub);
+    template<typename F> void forEach(unsigned bit, F fn);
+    void beginDispatch();
+    void endDispatch();
+};
+
+inline const EventBusStats& EventBus::stats() const {
+    return stats_;
+}
+
+} } // namespace particle::system
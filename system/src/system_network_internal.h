@@ -376,7 +376,7 @@ protected:
                 console.loop();
             }
 #if PLATFORM_THREADING
-            SystemISRTaskQueue.process();
+            SystemISRTaskQueue.processBatch();
             if (!APPLICATION_THREAD_CURRENT()) {
                 SystemThread.process();
             }
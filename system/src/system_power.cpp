@@ -16,11 +16,12 @@ BatteryChargeDiagnosticData::BatteryChargeDiagnosticData(uint16_t id, const char
 }
 
 int BatteryChargeDiagnosticData::get(IntType& val) {
-    if (g_batteryState == BATTERY_STATE_DISCONNECTED) {
-        return SYSTEM_ERROR_INVALID_STATE;
+    // The state of charge is cached by the power manager
+    float soc = 0.0f;
+    const int ret = PowerManager::instance()->batteryCharge(&soc);
+    if (ret < 0) {
+        return ret;
     }
-    FuelGauge fuel(true);
-    float soc = fuel.getNormalizedSoC();
     val = particle::FixedPointUQ<8, 8>(soc);
     return SYSTEM_ERROR_NONE;
 }
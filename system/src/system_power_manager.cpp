@@ -31,10 +31,9 @@ LOG_SOURCE_CATEGORY("sys.power")
 
 using namespace particle::power;
 
-volatile bool PowerManager::update_ = true;
-
-PowerManager::PowerManager() {
-  os_queue_create(&queue_, sizeof(update_), 1, nullptr);
+PowerManager::PowerManager() :
+    state_(this) {
+  os_queue_create(&queue_, sizeof(uint8_t), 1, nullptr);
   SPARK_ASSERT(queue_ != nullptr);
 }
 
@@ -54,135 +53,20 @@ void PowerManager::init() {
 }
 
 void PowerManager::update() {
-  update_ = true;
-  os_queue_put(queue_, (const void*)&update_, 0, nullptr);
+  state_.update();
+  const uint8_t dummy = 0;
+  os_queue_put(queue_, &dummy, 0, nullptr);
 }
 
 void PowerManager::sleep(bool s) {
-  // When going into sleep we do not want to exceed the default charging parameters set
-  // by initDefault(), which will be reset in case we are in a DISCONNECTED state with
-  // PMIC watchdog enabled. Reset to the defaults and disable watchdog before going into sleep.
-  if (s) {
-    // Going into sleep
-    if (g_batteryState == BATTERY_STATE_DISCONNECTED) {
-      initDefault();
-    }
-  } else {
-    // Wake up
-    initDefault();
+  state_.sleep(s);
+  if (state_.isUpdatePending()) {
     update();
   }
 }
 
-void PowerManager::handleUpdate() {
-  if (!update_) {
-    return;
-  }
-
-  update_ = false;
-
-  PMIC power(true);
-  FuelGauge fuel(true);
-
-  // In order to read the current fault status, the host has to read REG09 two times
-  // consecutively. The 1st reads fault register status from the last read and the 2nd
-  // reads the current fault register status.
-  const uint8_t lastFault = power.getFault();
-  (void)lastFault;
-  const uint8_t curFault = power.getFault();
-  const uint8_t status = power.getSystemStatus();
-  const uint8_t misc = power.readOpControlRegister();
-
-  // Watchdog fault
-  if ((curFault) & 0x80) {
-    // Restore parameters
-    initDefault();
-  }
-
-  battery_state_t state = BATTERY_STATE_UNKNOWN;
-
-  const uint8_t pwr_good = (status >> 2) & 0b01;
-
-  // Deduce current battery state
-  const uint8_t chrg_stat = (status >> 4) & 0b11;
-  if (chrg_stat) {
-    // Charging or charged
-    if (chrg_stat == 0b11) {
-      state = BATTERY_STATE_CHARGED;
-    } else {
-      state = BATTERY_STATE_CHARGING;
-    }
-  } else {
-    // For now we only know that the battery is not charging
-    state = BATTERY_STATE_NOT_CHARGING;
-    // Now we need to deduce whether it is NOT_CHARGING, DISCHARGING, or in a FAULT state
-    // const uint8_t chrg_fault = (curFault >> 4) & 0b11;
-    const uint8_t bat_fault = (curFault >> 3) & 0b01;
-    // const uint8_t ntc_fault = curFault & 0b111;
-    if (bat_fault) {
-      state = BATTERY_STATE_FAULT;
-    } else if (!pwr_good) {
-      state = BATTERY_STATE_DISCHARGING;
-    }
-  }
-
-  if (g_batteryState == BATTERY_STATE_DISCONNECTED && state == BATTERY_STATE_NOT_CHARGING &&
-      chargingDisabledTimestamp_) {
-    // We are aware of the fact that charging has been disabled, stay in disconnected state
-    state = BATTERY_STATE_DISCONNECTED;
-  }
-
-  const bool lowBat = fuel.getAlert();
-  handleStateChange(g_batteryState, state, lowBat);
-
-  power_source_t src = g_powerSource;
-  if (pwr_good) {
-    uint8_t vbus_stat = status >> 6;
-    switch (vbus_stat) {
-      case 0x01:
-        src = POWER_SOURCE_USB_HOST;
-        break;
-      case 0x02:
-        src = POWER_SOURCE_USB_ADAPTER;
-        break;
-      case 0x03:
-        src = POWER_SOURCE_USB_OTG;
-        break;
-      case 0x00:
-      default:
-        if ((misc & 0x80) == 0x00) {
-          // Not in DPDM detection anymore
-          src = POWER_SOURCE_VIN;
-          // It's not easy to detect when DPDM detection actually finishes,
-          // so just check input current source register whenever we are in this state
-          if (power.getInputCurrentLimit() != DEFAULT_INPUT_CURRENT_LIMIT) {
-            power.setInputCurrentLimit(DEFAULT_INPUT_CURRENT_LIMIT);
-          }
-        }
-        break;
-    }
-  } else {
-    if (g_batteryState == BATTERY_STATE_DISCHARGING) {
-      src = POWER_SOURCE_BATTERY;
-    } else {
-      src = POWER_SOURCE_UNKNOWN;
-    }
-  }
-
-  if (g_powerSource != src) {
-    g_powerSource = src;
-    system_notify_event(power_source, (int)g_powerSource);
-  }
-
-  if (lowBat) {
-    fuel.clearAlert();
-    if (lowBatEnabled_) {
-      lowBatEnabled_ = false;
-      system_notify_event(low_battery);
-    }
-  }
-
-  logStat(status, curFault);
+int PowerManager::batteryCharge(float* charge) {
+  return state_.batteryCharge(charge);
 }
 
 void PowerManager::loop(void* arg) {
@@ -191,7 +75,7 @@ void PowerManager::loop(void* arg) {
     LOG_DEBUG(INFO, "Power Management Initializing.");
     // IMPORTANT: attach the interrupt handler first
     attachInterrupt(LOW_BAT_UC, &PowerManager::isrHandler, FALLING);
-    self->initDefault();
+    self->initPmic(true);
     FuelGauge fuel(true);
     fuel.wakeup();
     fuel.setAlertThreshold(20); // Low Battery alert at 10% (about 3.6V)
@@ -200,14 +84,16 @@ void PowerManager::loop(void* arg) {
     LOG_DEBUG(INFO, "Battery Voltage: %-4.2fV", fuel.getVCell());
   }
 
-  uint32_t tmp;
+  // The thread only wakes up on an interrupt from the PMIC or fuel gauge, or when one of the
+  // timeouts of the state machine expires
+  system_tick_t timeout = 0;
+  uint8_t tmp;
   while (true) {
-    os_queue_take(self->queue_, &tmp, DEFAULT_QUEUE_WAIT, nullptr);
-    while (self->update_) {
-      self->handleUpdate();
+    os_queue_take(self->queue_, &tmp, timeout, nullptr);
+    timeout = self->state_.process();
+    if (timeout == PowerStateMachine::WAIT_FOREVER) {
+      timeout = CONCURRENT_WAIT_FOREVER;
     }
-    self->handlePossibleFaultLoop();
-    self->checkWatchdog();
   }
 }
 
@@ -216,7 +102,18 @@ void PowerManager::isrHandler() {
   self->update();
 }
 
-void PowerManager::initDefault(bool dpdm) {
+void PowerManager::readPmicStatus(PmicStatus* status) {
+  PMIC power(true);
+  // In order to read the current fault status, the host has to read REG09 two times
+  // consecutively. The 1st reads fault register status from the last read and the 2nd
+  // reads the current fault register status.
+  const uint8_t lastFault = power.getFault();
+  (void)lastFault;
+  // REG07-REG09 are read in a single transfer
+  power.getStatusRegisters(status->misc, status->status, status->fault);
+}
+
+void PowerManager::initPmic(bool dpdm) {
   PMIC power(true);
   power.begin();
   // Enters host-managed mode
@@ -235,8 +132,6 @@ void PowerManager::initDefault(bool dpdm) {
   // Enable charging
   power.enableCharging();
 
-  faultSuppressed_ = 0;
-
   /* This only disables currently running detection, whenever the power source changes,
    * the DPDM detection will run again
    */
@@ -249,157 +144,54 @@ void PowerManager::initDefault(bool dpdm) {
   // power.setInputCurrentLimit(900);     // 900mA
 }
 
-void PowerManager::handleStateChange(battery_state_t from, battery_state_t to, bool low) {
-  switch (from) {
-    case BATTERY_STATE_CHARGING:
-    case BATTERY_STATE_CHARGED: {
-      if (!low) {
-        to = handlePossibleFault(from, to);
-      }
-    }
-    // NOTE: fall-through
-    default: {
-      if (from == to) {
-        // No state change occured
-        return;
-      }
-    }
-  }
-
-  switch (from) {
-    case BATTERY_STATE_UNKNOWN:
-      break;
-    case BATTERY_STATE_NOT_CHARGING:
-      break;
-    case BATTERY_STATE_CHARGING:
-      break;
-    case BATTERY_STATE_CHARGED:
-      break;
-    case BATTERY_STATE_DISCHARGING:
-      break;
-    case BATTERY_STATE_FAULT:
-      break;
-    case BATTERY_STATE_DISCONNECTED: {
-      // When going from DISCONNECTED state to any other state quick start fuel gauge
-      FuelGauge fuel;
-      fuel.quickStart();
-
-      initDefault();
-    }
-    break;
-  }
+void PowerManager::setRechargeThreshold(uint16_t voltage) {
+  PMIC power(true);
+  power.setRechargeThreshold(voltage);
+}
 
-  switch (to) {
-    case BATTERY_STATE_CHARGING: {
-      // When going into CHARGING state, enable low battery event
-      lowBatEnabled_ = true;
-      break;
-    }
-    case BATTERY_STATE_CHARGED:
-      break;
-    case BATTERY_STATE_UNKNOWN:
-      break;
-    case BATTERY_STATE_NOT_CHARGING:
-      break;
-    case BATTERY_STATE_DISCHARGING:
-      break;
-    case BATTERY_STATE_FAULT:
-      break;
-    case BATTERY_STATE_DISCONNECTED: {
-      PMIC power;
-      // Disable charging
-      power.disableCharging();
-      // Enable watchdog that should re-enable charging in 40 seconds
-      // power.setWatchdog(0b01);
-      chargingDisabledTimestamp_ = millis();
-      break;
-    }
-  }
+void PowerManager::disableCharging() {
+  PMIC power(true);
+  power.disableCharging();
+}
 
-  if (from == to) {
-      return;
+void PowerManager::restoreInputCurrentLimit() {
+  PMIC power(true);
+  if (power.getInputCurrentLimit() != DEFAULT_INPUT_CURRENT_LIMIT) {
+    power.setInputCurrentLimit(DEFAULT_INPUT_CURRENT_LIMIT);
   }
+}
 
-  g_batteryState = to;
-
-  system_notify_event(battery_state, (int)g_batteryState);
+bool PowerManager::readLowBatteryAlert() {
+  FuelGauge fuel(true);
+  return fuel.getAlert();
+}
 
-#if defined(DEBUG_BUILD)
-  static const char* states[] = {
-    "UNKNOWN",
-    "NOT_CHARGING",
-    "CHARGING",
-    "CHARGED",
-    "DISCHARGING",
-    "FAULT",
-    "DISCONNECTED"
-  };
-  LOG_DEBUG(TRACE, "Battery state %s -> %s", states[from], states[to]);
-#endif // defined(DEBUG_BUILD)
+void PowerManager::clearLowBatteryAlert() {
+  FuelGauge fuel(true);
+  fuel.clearAlert();
 }
 
-battery_state_t PowerManager::handlePossibleFault(battery_state_t from, battery_state_t to) {
-  if (to == BATTERY_STATE_CHARGED || to == BATTERY_STATE_CHARGING) {
-    system_tick_t m = millis();
-    if (m - possibleFaultTimestamp_ > DEFAULT_FAULT_WINDOW) {
-      possibleFaultTimestamp_ = m;
-      possibleFaultCounter_ = 0;
-      faultSecondaryCounter_ = 0;
-    } else {
-      possibleFaultCounter_++;
-      if (possibleFaultCounter_ >= DEFAULT_FAULT_COUNT_THRESHOLD &&
-         (faultSuppressed_ == 0 || (m - faultSuppressed_ >= DEFAULT_FAULT_SUPPRESSION_PERIOD))) {
-        if (faultSecondaryCounter_ > 0) {
-          faultSecondaryCounter_ = 0;
-          return BATTERY_STATE_DISCONNECTED;
-        } else {
-          PMIC power;
-          power.setRechargeThreshold(300);
-          possibleFaultCounter_ = 0;
-          faultSecondaryCounter_ = 1;
-          possibleFaultTimestamp_ = millis();
-        }
-      }
-    }
-  }
-  return to;
+float PowerManager::readBatteryCharge() {
+  FuelGauge fuel(true);
+  return fuel.getNormalizedSoC();
 }
 
-void PowerManager::handlePossibleFaultLoop() {
-  if (faultSecondaryCounter_ == 1 && (millis() - possibleFaultTimestamp_ > DEFAULT_FAULT_WINDOW)) {
-      PMIC power;
-      power.setRechargeThreshold(100);
-      faultSecondaryCounter_ = 0;
-      faultSuppressed_ = millis();
-  }
+void PowerManager::quickStartFuelGauge() {
+  FuelGauge fuel(true);
+  fuel.quickStart();
 }
 
-void PowerManager::checkWatchdog() {
-  if (g_batteryState == BATTERY_STATE_DISCONNECTED &&
-      ((millis() - chargingDisabledTimestamp_) >= DEFAULT_WATCHDOG_TIMEOUT)) {
-    // Re-enable charging, do not run DPDM detection
-    LOG_DEBUG(TRACE, "re-enabling charging");
-    chargingDisabledTimestamp_ = 0;
-    initDefault(false);
+void PowerManager::notify(system_event_t event, int data) {
+  if (event == battery_state) {
+    g_batteryState = (battery_state_t)data;
+  } else if (event == power_source) {
+    g_powerSource = (power_source_t)data;
   }
+  system_notify_event(event, data);
 }
 
-void PowerManager::logStat(uint8_t stat, uint8_t fault) {
-#if defined(DEBUG_BUILD) && 0
-  uint8_t vbus_stat = stat >> 6; // 0 – Unknown (no input, or DPDM detection incomplete), 1 – USB host, 2 – Adapter port, 3 – OTG
-  uint8_t chrg_stat = (stat >> 4) & 0x03; // 0 – Not Charging, 1 – Pre-charge (<VBATLOWV), 2 – Fast Charging, 3 – Charge Termination Done
-  bool dpm_stat = stat & 0x08;   // 0 – Not DPM, 1 – VINDPM or IINDPM
-  bool pg_stat = stat & 0x04;    // 0 – Not Power Good, 1 – Power Good
-  bool therm_stat = stat & 0x02; // 0 – Normal, 1 – In Thermal Regulation
-  bool vsys_stat = stat & 0x01;  // 0 – Not in VSYSMIN regulation (BAT > VSYSMIN), 1 – In VSYSMIN regulation (BAT < VSYSMIN)
-  bool wd_fault = fault & 0x80;  // 0 – Normal, 1- Watchdog timer expiration
-  uint8_t chrg_fault = (fault >> 4) & 0x03; // 0 – Normal, 1 – Input fault (VBUS OVP or VBAT < VBUS < 3.8 V),
-                                            // 2 - Thermal shutdown, 3 – Charge Safety Timer Expiration
-  bool bat_fault = fault & 0x08;    // 0 – Normal, 1 – BATOVP
-  uint8_t ntc_fault = fault & 0x07; // 0 – Normal, 5 – Cold, 6 – Hot
-  LOG_DEBUG(TRACE, "[ PMIC STAT ] VBUS:%d CHRG:%d DPM:%d PG:%d THERM:%d VSYS:%d", vbus_stat, chrg_stat, dpm_stat, pg_stat, therm_stat, vsys_stat);
-  LOG_DEBUG(TRACE, "[ PMIC FAULT ] WATCHDOG:%d CHRG:%d BAT:%d NTC:%d", wd_fault, chrg_fault, bat_fault, ntc_fault);
-#endif
+system_tick_t PowerManager::millis() {
+  return ::millis();
 }
 
 #endif /* (HAL_PLATFORM_PMIC_BQ24195 && HAL_PLATFORM_FUELGAUGE_MAX17043) */
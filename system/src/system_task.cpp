@@ -47,7 +47,9 @@
 #include "system_threading.h"
 #include "spark_wiring_interrupts.h"
 #include "spark_wiring_led.h"
+#include "spark_wiring_diagnostics.h"
 #include "system_commands.h"
+#include "diagnostics.h"
 
 #if HAL_PLATFORM_BLE
 #include "ble_hal.h"
@@ -83,6 +85,24 @@ static struct SetThreadCurrentFunctionPointers {
 
 ISRTaskQueue SystemISRTaskQueue;
 
+namespace {
+
+class IsrTaskQueueDiagnosticData: public particle::AbstractIntegerDiagnosticData {
+public:
+    IsrTaskQueueDiagnosticData() :
+            AbstractIntegerDiagnosticData(DIAG_ID_SYSTEM_ISR_TASK_QUEUE_MAX_SIZE, DIAG_NAME_SYSTEM_ISR_TASK_QUEUE_MAX_SIZE) {
+    }
+
+    virtual int get(IntType& val) override {
+        val = SystemISRTaskQueue.maxSize();
+        return 0; // OK
+    }
+};
+
+IsrTaskQueueDiagnosticData g_isrTaskQueueDiagData;
+
+} // namespace
+
 void Network_Setup(bool threaded)
 {
 #if !PARTICLE_NO_NETWORK
@@ -430,13 +450,20 @@ void manage_cloud_connection(bool force_events)
 
 static void process_isr_task_queue()
 {
-    SystemISRTaskQueue.process();
+    SystemISRTaskQueue.processBatch();
 }
 
 #if Wiring_SetupButtonUX
 extern void system_handle_button_clicks(bool isIsr);
 #endif
 
+static void manage_diagnostics_sampler()
+{
+    // The sampler is a no-op unless the application has configured it
+    const diag_sampler_update d = { sizeof(diag_sampler_update), 0 /* reserved */, HAL_Timer_Get_Milli_Seconds() };
+    diag_command(DIAG_SERVICE_CMD_SAMPLER_UPDATE, (void*)&d, nullptr);
+}
+
 void Spark_Idle_Events(bool force_events/*=false*/)
 {
     HAL_Notify_WDT();
@@ -446,6 +473,8 @@ void Spark_Idle_Events(bool force_events/*=false*/)
 
     process_isr_task_queue();
 
+    manage_diagnostics_sampler();
+
     if (!SYSTEM_POWEROFF) {
 
 #if Wiring_SetupButtonUX
@@ -18,6 +18,8 @@
  */
 
 #include <stddef.h>
+#include <algorithm>
+#include <memory>
 #include "spark_wiring_cloud.h"
 #include "spark_wiring_system.h"
 #include "spark_wiring_stream.h"
@@ -43,6 +45,9 @@
 #include "system_network_internal.h"
 #include "bytes2hexbuf.h"
 #include "system_threading.h"
+#include "system_update_decoder.h"
+#include "image_digest.h"
+#include "scope_guard.h"
 
 #ifdef START_DFU_FLASHER_SERIAL_SPEED
 static uint32_t start_dfu_flasher_serial_speed = START_DFU_FLASHER_SERIAL_SPEED;
@@ -213,6 +218,42 @@ void set_flag(void* flag)
 	*p = true;
 }
 
+namespace {
+
+// Decoder for compressed and delta-encoded firmware images
+std::unique_ptr<particle::system::FirmwareUpdateDecoder> g_updateDecoder;
+
+// Digest of the firmware image, updated as the image is written to the OTA section
+particle::ImageDigest g_imageDigest;
+hal_ota_image_region_t g_imageRegions[particle::ImageDigest::MAX_REGIONS];
+
+// Passes the digest of the firmware image to the HAL, so that the image doesn't need to be read
+// back in its entirety in order to validate it
+void setImageDigest(bool set)
+{
+    if (!set || !g_imageDigest.isValid()) {
+        HAL_FLASH_OTA_Set_Image_Digest(nullptr, nullptr);
+        return;
+    }
+    const size_t count = g_imageDigest.regionCount();
+    for (size_t i = 0; i < count; ++i) {
+        const auto& r = g_imageDigest.regions()[i];
+        g_imageRegions[i].address = r.address;
+        g_imageRegions[i].size = r.size;
+        g_imageRegions[i].crc = r.crc;
+    }
+    hal_ota_image_digest_t d = {};
+    d.size = sizeof(d);
+    d.region_count = count;
+    d.address = g_imageDigest.address();
+    d.image_size = g_imageDigest.size();
+    d.crc = g_imageDigest.crc();
+    d.regions = g_imageRegions;
+    HAL_FLASH_OTA_Set_Image_Digest(&d, nullptr);
+}
+
+} // namespace
+
 int Spark_Prepare_For_Firmware_Update(FileTransfer::Descriptor& file, uint32_t flags, void* reserved)
 {
     if (file.store==FileTransfer::Store::FIRMWARE)
@@ -227,6 +268,11 @@ int Spark_Prepare_For_Firmware_Update(FileTransfer::Descriptor& file, uint32_t f
         }
     }
     int result = 0;
+    const bool encoded = (file.store==FileTransfer::Store::FIRMWARE && file.encoding!=FileTransfer::Encoding::NONE);
+    if (encoded && !particle::system::FirmwareUpdateDecoder::isEncodingSupported(file.encoding)) {
+        LOG(ERROR, "Unsupported firmware encoding: 0x%02x", (unsigned)file.encoding);
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
     if (flags & 1) {
         // only check address
     }
@@ -242,6 +288,25 @@ int Spark_Prepare_For_Firmware_Update(FileTransfer::Descriptor& file, uint32_t f
         system_set_flag(SYSTEM_FLAG_OTA_UPDATE_PENDING, 0, nullptr);
         	if (System.updatesEnabled())		// application event is handled asynchronously
         {
+            uint32_t length = file.file_length;
+            g_updateDecoder.reset();
+            g_imageDigest.reset(file.file_address);
+            setImageDigest(false);
+            if (encoded) {
+                // The size of the decoded image is not known in advance, so the entire OTA section
+                // is erased
+                length = HAL_OTA_FlashLength() - (file.file_address - HAL_OTA_FlashAddress());
+                g_updateDecoder.reset(new(std::nothrow) particle::system::FirmwareUpdateDecoder);
+                if (!g_updateDecoder) {
+                    return SYSTEM_ERROR_NO_MEMORY;
+                }
+                result = g_updateDecoder->init(file.encoding, file.file_address, length, file.file_length,
+                        &g_imageDigest);
+                if (result != 0) {
+                    g_updateDecoder.reset();
+                    return result;
+                }
+            }
             RGB.control(true);
             // Get base color used for the update process indication
             const LEDStatusData* status = led_signal_status(LED_SIGNAL_FIRMWARE_UPDATE, nullptr);
@@ -249,7 +314,7 @@ int Spark_Prepare_For_Firmware_Update(FileTransfer::Descriptor& file, uint32_t f
             SPARK_FLASH_UPDATE = 1;
             TimingFlashUpdateTimeout = 0;
             system_notify_event(firmware_update, firmware_update_begin, &file);
-            HAL_FLASH_Begin(file.file_address, file.file_length, NULL);
+            HAL_FLASH_Begin(file.file_address, length, NULL);
         }
         else
         {
@@ -322,14 +387,30 @@ int Spark_Finish_Firmware_Update(FileTransfer::Descriptor& file, uint32_t flags,
 
     hal_module_t mod;
 
+    // Make sure an encoded image has been reconstructed completely before validating it
+    const int decodeResult = ((flags & UpdateFlag::SUCCESS) && g_updateDecoder) ? g_updateDecoder->finish() : 0;
+
     if ((flags & (UpdateFlag::VALIDATE_ONLY | UpdateFlag::SUCCESS)) == (UpdateFlag::VALIDATE_ONLY | UpdateFlag::SUCCESS)) {
+        setImageDigest(true);
         res = HAL_FLASH_OTA_Validate(module ? (hal_module_t*)module : &mod, true, (module_validation_flags_t)(MODULE_VALIDATION_INTEGRITY | MODULE_VALIDATION_DEPENDENCIES_FULL), NULL);
-        return res;
+        setImageDigest(false);
+        return (decodeResult != 0) ? decodeResult : res;
     }
 
-    if (flags & UpdateFlag::SUCCESS) {    // update successful
+    g_updateDecoder.reset();
+    SCOPE_GUARD({
+        setImageDigest(false);
+        g_imageDigest.invalidate();
+    });
+
+    if (decodeResult != 0) {
+        system_notify_event(firmware_update, firmware_update_failed, &file);
+        res = decodeResult;
+    }
+    else if (flags & UpdateFlag::SUCCESS) {    // update successful
         if (file.store==FileTransfer::Store::FIRMWARE)
         {
+            setImageDigest(true);
             hal_update_complete_t result = HAL_FLASH_End(module ? (hal_module_t*)module : &mod);
             system_notify_event(firmware_update, result!=HAL_UPDATE_ERROR ? firmware_update_complete : firmware_update_failed, &file);
             res = (result == HAL_UPDATE_ERROR);
@@ -358,7 +439,18 @@ int Spark_Save_Firmware_Chunk(FileTransfer::Descriptor& file, const uint8_t* chu
     system_notify_event(firmware_update, firmware_update_progress, &file);
     if (file.store==FileTransfer::Store::FIRMWARE)
     {
-        result = HAL_FLASH_Update(chunk, file.chunk_address, file.chunk_size, NULL);
+        if (g_updateDecoder) {
+            // Encoded data is decoded as a stream and needs to be received in order
+            if (file.chunk_address - file.file_address != g_updateDecoder->inputSize()) {
+                LOG(ERROR, "Unexpected chunk address: 0x%08x", (unsigned)file.chunk_address);
+                result = SYSTEM_ERROR_INVALID_STATE;
+            } else {
+                result = g_updateDecoder->decode((const char*)chunk, file.chunk_size);
+            }
+        } else {
+            result = HAL_FLASH_Update(chunk, file.chunk_address, file.chunk_size, NULL);
+            g_imageDigest.update(file.chunk_address, (const char*)chunk, file.chunk_size, result == 0);
+        }
         LED_Toggle(LED_RGB);
     }
     return result;
@@ -656,6 +748,9 @@ namespace {
 
 using namespace particle;
 
+// Maximum size of an encoded batch of diagnostic samples
+const size_t DIAG_SAMPLER_MAX_BATCH_SIZE = 512;
+
 template <typename T>
 class AbstractDiagnosticsFormatter {
 
@@ -688,12 +783,47 @@ protected:
 	        }
 	        break;
 	    }
+	    case DIAG_TYPE_STATS: {
+	        diag_stats stats = {};
+	        size_t size = sizeof(stats);
+	        const int ret = AbstractDiagnosticData::get(src, &stats, size);
+	        if ((ret == 0 && !fmt.formatSourceStats(src, stats)) || (ret != 0 && !fmt.formatSourceError(src, ret))) {
+	            return SYSTEM_ERROR_TOO_LARGE;
+	        }
+	        break;
+	    }
+	    case DIAG_TYPE_HISTOGRAM: {
+	        size_t size = 0;
+	        int ret = AbstractDiagnosticData::get(src, nullptr, size);
+	        std::unique_ptr<char[]> buf;
+	        if (ret == 0) {
+	            buf.reset(new(std::nothrow) char[size]);
+	            ret = buf ? AbstractDiagnosticData::get(src, buf.get(), size) : SYSTEM_ERROR_NO_MEMORY;
+	        }
+	        if (ret == 0 && size < sizeof(diag_histogram)) {
+	            ret = SYSTEM_ERROR_BAD_DATA;
+	        }
+	        if ((ret == 0 && !fmt.formatSourceHistogram(src, *(const diag_histogram*)buf.get(), size)) ||
+	                (ret != 0 && !fmt.formatSourceError(src, ret))) {
+	            return SYSTEM_ERROR_TOO_LARGE;
+	        }
+	        break;
+	    }
 	    default:
 	        return SYSTEM_ERROR_NOT_SUPPORTED;
 	    }
 	    return 0;
 	}
 
+	// Formatters that don't support aggregated data types filter them out in isSourceOk()
+	inline bool formatSourceStats(const diag_source* src, const diag_stats& stats) {
+		return true;
+	}
+
+	inline bool formatSourceHistogram(const diag_source* src, const diag_histogram& hist, size_t size) {
+		return true;
+	}
+
 	static int formatSources(T& formatter, const uint16_t* id, size_t count, unsigned flags) {
 	    if (!formatter.openDocument()) {
 			return SYSTEM_ERROR_TOO_LARGE;
@@ -763,6 +893,39 @@ public:
 	inline bool formatSourceInt(const diag_source* src, AbstractIntegerDiagnosticData::IntType val) {
 		return json.write_value(src->name, val);
 	}
+
+	bool formatSourceStats(const diag_source* src, const diag_stats& stats) {
+		return json.write_attribute(src->name) &&
+				json.write('{') &&
+				json.write_value("min", stats.min) &&
+				json.write_value("max", stats.max) &&
+				json.write_value("avg", stats.avg) &&
+				json.write_attribute("cnt") &&
+				json.write((int)stats.count) &&
+				json.write('}') &&
+				json.next();
+	}
+
+	bool formatSourceHistogram(const diag_source* src, const diag_histogram& hist, size_t size) {
+		const size_t count = std::min<size_t>(hist.bucket_count, (size - sizeof(diag_histogram)) / sizeof(uint32_t));
+		const uint32_t* counts = (const uint32_t*)(&hist + 1);
+		if (!(json.write_attribute(src->name) &&
+				json.write('{') &&
+				json.write_value("min", hist.bucket_min) &&
+				json.write_value("width", hist.bucket_width) &&
+				json.write_attribute("cnt") &&
+				json.write('['))) {
+			return false;
+		}
+		for (size_t i = 0; i < count; ++i) {
+			if ((i > 0 && !json.write(',')) || !json.write((int)counts[i])) {
+				return false;
+			}
+		}
+		return json.write(']') &&
+				json.write('}') &&
+				json.next();
+	}
 };
 
 
@@ -794,7 +957,8 @@ public:
 	}
 
 	inline bool isSourceOk(const diag_source* src) {
-	    return true;
+		// Every record in the binary format has the same size
+	    return (src->type == DIAG_TYPE_INT);
 	}
 
 	inline bool formatSourceInt(const diag_source* src, AbstractIntegerDiagnosticData::IntType val) {
@@ -823,6 +987,23 @@ int system_format_diag_data(const uint16_t* id, size_t count, unsigned flags, ap
 }
 
 bool system_metrics(appender_fn appender, void* append_data, uint32_t flags, uint32_t page, void* reserved) {
+    if (page == 2) {
+        // The cloud has received the last batch of recorded samples
+        return diag_command(DIAG_SERVICE_CMD_SAMPLER_COMMIT, nullptr, nullptr) == 0;
+    }
+    if (page == 1) {
+        // Batch of samples recorded by the diagnostics sampler. The samples stay in the sampler
+        // until the cloud confirms the delivery of the batch (page 2), so the same batch is sent
+        // again if the response gets lost. The batch is kept small enough to fit in a describe
+        // message
+        char buf[DIAG_SAMPLER_MAX_BATCH_SIZE];
+        diag_sampler_encode d = {};
+        d.size = sizeof(d);
+        d.buffer = buf;
+        d.buffer_size = sizeof(buf);
+        const int ret = diag_command(DIAG_SERVICE_CMD_SAMPLER_ENCODE, &d, nullptr);
+        return ret == 0 && appender(append_data, (const uint8_t*)buf, d.data_size);
+    }
     const int ret = system_format_diag_data(nullptr, 0, flags, appender, append_data, nullptr);
     return ret == 0;
 };
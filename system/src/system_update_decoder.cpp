@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logging.h"
+LOG_SOURCE_CATEGORY("system.ota")
+
+#include "system_update_decoder.h"
+
+#include "file_transfer.h"
+#include "ota_flash_hal.h"
+#include "scope_guard.h"
+#include "system_error.h"
+#include "platforms.h"
+
+#include <new>
+
+namespace particle {
+
+namespace system {
+
+FirmwareUpdateDecoder::FirmwareUpdateDecoder() {
+    destroy();
+}
+
+int FirmwareUpdateDecoder::init(unsigned encoding, uint32_t address, size_t maxSize, size_t inputSize, ImageDigest* digest) {
+    destroy();
+    if (!isEncodingSupported(encoding)) {
+        return SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+    NAMED_SCOPE_GUARD(guard, {
+        destroy();
+    });
+#if HAL_PLATFORM_COMPRESSED_BINARIES
+    if (encoding & FileTransfer::Encoding::COMPRESSED) {
+        decomp_.reset(new(std::nothrow) tinfl_decompressor);
+        if (!decomp_) {
+            return SYSTEM_ERROR_NO_MEMORY;
+        }
+        tinfl_init(decomp_.get());
+        decompBuf_.reset(new(std::nothrow) char[TINFL_LZ_DICT_SIZE]);
+        if (!decompBuf_) {
+            return SYSTEM_ERROR_NO_MEMORY;
+        }
+    }
+#endif // HAL_PLATFORM_COMPRESSED_BINARIES
+    if (encoding & FileTransfer::Encoding::DELTA) {
+        patcher_.reset(new(std::nothrow) DeltaPatcher(this));
+        if (!patcher_) {
+            return SYSTEM_ERROR_NO_MEMORY;
+        }
+    }
+    encoding_ = encoding;
+    address_ = address;
+    maxSize_ = maxSize;
+    inputTotal_ = inputSize;
+    digest_ = digest;
+    guard.dismiss();
+    return 0;
+}
+
+void FirmwareUpdateDecoder::destroy() {
+#if HAL_PLATFORM_COMPRESSED_BINARIES
+    decomp_.reset();
+    decompBuf_.reset();
+    decompBufOffs_ = 0;
+    decompDone_ = false;
+#endif // HAL_PLATFORM_COMPRESSED_BINARIES
+    patcher_.reset();
+    digest_ = nullptr;
+    encoding_ = FileTransfer::Encoding::NONE;
+    address_ = 0;
+    maxSize_ = 0;
+    inputTotal_ = 0;
+    inputSize_ = 0;
+    outputSize_ = 0;
+    error_ = 0;
+}
+
+int FirmwareUpdateDecoder::decode(const char* data, size_t size) {
+    if (error_ < 0) {
+        return error_;
+    }
+    const int ret = decodeImpl(data, size);
+    if (ret < 0) {
+        LOG(ERROR, "Unable to decode firmware image: %d", ret);
+        error_ = ret;
+    }
+    return ret;
+}
+
+int FirmwareUpdateDecoder::finish() {
+    if (error_ < 0) {
+        return error_;
+    }
+    if (inputSize_ != inputTotal_) {
+        LOG(ERROR, "Incomplete firmware image");
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+#if HAL_PLATFORM_COMPRESSED_BINARIES
+    if (decomp_ && !decompDone_) {
+        LOG(ERROR, "Incomplete compressed data");
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+#endif // HAL_PLATFORM_COMPRESSED_BINARIES
+    if (patcher_) {
+        const int ret = patcher_->finish();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    LOG(INFO, "Decoded firmware image: %u bytes received, %u bytes written", (unsigned)inputSize_,
+            (unsigned)outputSize_);
+    return 0;
+}
+
+bool FirmwareUpdateDecoder::isEncodingSupported(unsigned encoding) {
+    if (encoding & ~(FileTransfer::Encoding::COMPRESSED | FileTransfer::Encoding::DELTA)) {
+        return false;
+    }
+#if !HAL_PLATFORM_COMPRESSED_BINARIES
+    if (encoding & FileTransfer::Encoding::COMPRESSED) {
+        return false;
+    }
+#endif
+#if PLATFORM_ID == PLATFORM_GCC
+    // Modules of the virtual device are not mapped into memory
+    if (encoding & FileTransfer::Encoding::DELTA) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+int FirmwareUpdateDecoder::decodeImpl(const char* data, size_t size) {
+    if (size > inputTotal_ - inputSize_) {
+        return SYSTEM_ERROR_OUT_OF_RANGE;
+    }
+#if HAL_PLATFORM_COMPRESSED_BINARIES
+    if (decomp_) {
+        size_t srcOffs = 0;
+        for (;;) {
+            if (decompDone_) {
+                if (srcOffs < size) {
+                    LOG(ERROR, "Unexpected data after the end of the compressed stream");
+                    return SYSTEM_ERROR_BAD_DATA;
+                }
+                break;
+            }
+            size_t srcBytes = size - srcOffs;
+            size_t destBytes = TINFL_LZ_DICT_SIZE - decompBufOffs_;
+            const bool hasMore = (inputTotal_ - inputSize_ > srcBytes);
+            const auto stat = tinfl_decompress(decomp_.get(), (const mz_uint8*)data + srcOffs, &srcBytes,
+                    (mz_uint8*)decompBuf_.get(), (mz_uint8*)decompBuf_.get() + decompBufOffs_, &destBytes,
+                    hasMore ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+            if (stat < 0) {
+                return SYSTEM_ERROR_BAD_DATA;
+            }
+            srcOffs += srcBytes;
+            inputSize_ += srcBytes;
+            if (destBytes > 0) {
+                const int ret = processDecompressed(decompBuf_.get() + decompBufOffs_, destBytes);
+                if (ret < 0) {
+                    return ret;
+                }
+                decompBufOffs_ = (decompBufOffs_ + destBytes) % TINFL_LZ_DICT_SIZE;
+            }
+            if (stat == TINFL_STATUS_DONE) {
+                decompDone_ = true;
+            } else if (stat != TINFL_STATUS_HAS_MORE_OUTPUT) {
+                break; // Needs more input
+            }
+        }
+        return 0;
+    }
+#endif // HAL_PLATFORM_COMPRESSED_BINARIES
+    inputSize_ += size;
+    return processDecompressed(data, size);
+}
+
+int FirmwareUpdateDecoder::processDecompressed(const char* data, size_t size) {
+    if (patcher_) {
+        return patcher_->process(data, size);
+    }
+    return writeImage(data, size);
+}
+
+int FirmwareUpdateDecoder::writeImage(const char* data, size_t size) {
+    if (size > maxSize_ - outputSize_) {
+        LOG(ERROR, "Firmware image is too large");
+        return SYSTEM_ERROR_OUT_OF_RANGE;
+    }
+    const int ret = HAL_FLASH_Update((const uint8_t*)data, address_ + outputSize_, size, nullptr);
+    if (digest_) {
+        digest_->update(address_ + outputSize_, data, size, ret == 0);
+    }
+    if (ret != 0) {
+        return SYSTEM_ERROR_IO;
+    }
+    outputSize_ += size;
+    return 0;
+}
+
+int FirmwareUpdateDecoder::source(const DeltaPatchHeader& header, const char** data) {
+    hal_system_info_t info = {};
+    info.size = sizeof(info);
+    HAL_System_Info(&info, true, nullptr);
+    SCOPE_GUARD({
+        HAL_System_Info(&info, false, nullptr);
+    });
+    for (size_t i = 0; i < info.module_count; ++i) {
+        const hal_module_t& module = info.modules[i];
+        if (module.bounds.store != MODULE_STORE_MAIN || module.bounds.module_function != header.moduleFunction ||
+                module.bounds.module_index != header.moduleIndex) {
+            continue;
+        }
+        if (header.sourceSize > module.bounds.maximum_size) {
+            return SYSTEM_ERROR_OUT_OF_RANGE;
+        }
+        // Modules are stored in the internal flash, which is mapped into memory
+        *data = (const char*)(uintptr_t)module.bounds.start_address;
+        return 0;
+    }
+    LOG(ERROR, "Source module not found; function: %u, index: %u", (unsigned)header.moduleFunction,
+            (unsigned)header.moduleIndex);
+    return SYSTEM_ERROR_NOT_FOUND;
+}
+
+int FirmwareUpdateDecoder::write(const char* data, size_t size) {
+    return writeImage(data, size);
+}
+
+} // namespace system
+
+} // namespace particle
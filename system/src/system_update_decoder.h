@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "delta_patch.h"
+#include "image_digest.h"
+#include "hal_platform.h"
+
+#if HAL_PLATFORM_COMPRESSED_BINARIES
+#include "miniz.h"
+#endif // HAL_PLATFORM_COMPRESSED_BINARIES
+
+#include <memory>
+
+namespace particle {
+
+namespace system {
+
+// Decodes a compressed and/or delta-encoded firmware image as it is received and writes the
+// reconstructed image to the OTA section. The encoding is defined by a combination of the
+// `FileTransfer::Encoding` flags.
+//
+// The decoder needs the encoded data to be received in order. Apart from the decompression
+// dictionary (32KB, only allocated for compressed images), its memory usage is constant
+class FirmwareUpdateDecoder: private DeltaPatchHandler {
+public:
+    FirmwareUpdateDecoder();
+
+    // `address` and `maxSize` define the flash region for the decoded image, `inputSize` is the
+    // size of the encoded data. The optional digest is updated with the decoded image as it is
+    // written
+    int init(unsigned encoding, uint32_t address, size_t maxSize, size_t inputSize, ImageDigest* digest = nullptr);
+    void destroy();
+
+    // Decodes a portion of the encoded data. The first error is sticky
+    int decode(const char* data, size_t size);
+    // Verifies that the entire image has been decoded successfully
+    int finish();
+
+    size_t inputSize() const;
+    size_t outputSize() const;
+
+    // Returns true if the encoding is supported on this platform
+    static bool isEncodingSupported(unsigned encoding);
+
+private:
+#if HAL_PLATFORM_COMPRESSED_BINARIES
+    std::unique_ptr<tinfl_decompressor> decomp_; // Decompressor context
+    std::unique_ptr<char[]> decompBuf_; // Decompression dictionary
+    size_t decompBufOffs_; // Offset in the dictionary for decompressed data
+    bool decompDone_; // Set to true when the end of the compressed stream is reached
+#endif // HAL_PLATFORM_COMPRESSED_BINARIES
+    std::unique_ptr<DeltaPatcher> patcher_; // Delta decoder
+    ImageDigest* digest_; // Digest of the decoded image
+    unsigned encoding_; // Encoding flags
+    uint32_t address_; // Address of the OTA section
+    size_t maxSize_; // Maximum size of the decoded image
+    size_t inputTotal_; // Total size of the encoded data
+    size_t inputSize_; // Number of processed bytes of the encoded data
+    size_t outputSize_; // Number of written bytes of the decoded image
+    int error_; // Last error
+
+    int decodeImpl(const char* data, size_t size);
+    int processDecompressed(const char* data, size_t size);
+    int writeImage(const char* data, size_t size);
+
+    // DeltaPatchHandler
+    int source(const DeltaPatchHeader& header, const char** data) override;
+    int write(const char* data, size_t size) override;
+};
+
+inline size_t FirmwareUpdateDecoder::inputSize() const {
+    return inputSize_;
+}
+
+inline size_t FirmwareUpdateDecoder::outputSize() const {
+    return outputSize_;
+}
+
+} // namespace system
+
+} // namespace particle
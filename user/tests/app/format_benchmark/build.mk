@@ -0,0 +1,5 @@
+INCLUDE_DIRS += $(SOURCE_PATH)/$(USRSRC)
+CPPSRC += $(call target_files,$(USRSRC_SLASH),*.cpp)
+
+# Heap allocations are counted by wrapping the allocator functions
+LDFLAGS += -Wl,--wrap=malloc -Wl,--wrap=realloc
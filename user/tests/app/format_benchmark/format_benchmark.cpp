@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Telemetry formatting benchmark for the virtual device.
+ *
+ * Formats a typical telemetry message with Print::printf(), String::format() and String
+ * concatenation, and logs the throughput and the number of heap allocations per message. Each
+ * case is compared with an equivalent of the previous implementation: two-pass vsnprintf()
+ * formatting and String buffers that are reallocated on every append.
+ *
+ * Build: make PLATFORM=gcc APP=../tests/app/format_benchmark
+ */
+
+#include "application.h"
+#include "string_convert.h"
+
+#if PLATFORM_ID != PLATFORM_GCC
+#error "This application is only supported on the gcc platform"
+#endif
+
+#include <time.h>
+
+SYSTEM_MODE(MANUAL);
+
+SerialLogHandler logHandler(LOG_LEVEL_WARN, {
+    { "app", LOG_LEVEL_ALL }
+});
+
+namespace {
+
+const unsigned ITERATIONS = 100000;
+
+const char* const TELEMETRY_FORMAT = "{\"t\":%lu,\"dev\":\"%s\",\"temp\":%.2f,\"hum\":%.1f,\"bat\":%d,\"rssi\":%d}";
+const char* const DEVICE_NAME = "sensor-0042";
+
+unsigned allocCount = 0;
+
+uint64_t cpuTimeUs() {
+    timespec ts = {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Discards all data, counting the bytes
+class NullPrint: public Print {
+public:
+    size_t write(uint8_t c) override {
+        ++size_;
+        return 1;
+    }
+
+    size_t write(const uint8_t* data, size_t size) override {
+        size_ += size;
+        return size;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    size_t size_ = 0;
+};
+
+// Previous implementation of Print::printf()
+size_t legacyPrintf(Print* p, const char* format, ...) {
+    const int bufsize = 20;
+    char test[bufsize];
+    va_list marker;
+    va_start(marker, format);
+    size_t n = vsnprintf(test, bufsize, format, marker);
+    va_end(marker);
+    if (n < bufsize) {
+        n = p->print(test);
+    } else {
+        char bigger[n + 1];
+        va_start(marker, format);
+        n = vsnprintf(bigger, n + 1, format, marker);
+        va_end(marker);
+        n = p->print(bigger);
+    }
+    return n;
+}
+
+// Previous implementation of String::format()
+size_t legacyFormat(const char* format, ...) {
+    va_list marker;
+    va_start(marker, format);
+    char test[5];
+    size_t n = vsnprintf(test, sizeof(test), format, marker);
+    va_end(marker);
+    char* const buf = (char*)malloc(n + 1);
+    if (!buf) {
+        return 0;
+    }
+    va_start(marker, format);
+    n = vsnprintf(buf, n + 1, format, marker);
+    va_end(marker);
+    free(buf);
+    return n;
+}
+
+// String buffer that is reallocated on every append, as the previous String implementation did
+class LegacyString {
+public:
+    LegacyString() :
+            buf_((char*)malloc(1)),
+            len_(0) {
+        buf_[0] = '\0';
+    }
+
+    ~LegacyString() {
+        free(buf_);
+    }
+
+    LegacyString& operator+=(const char* str) {
+        const size_t n = strlen(str);
+        buf_ = (char*)realloc(buf_, len_ + n + 1);
+        memcpy(buf_ + len_, str, n + 1);
+        len_ += n;
+        return *this;
+    }
+
+    LegacyString& operator+=(long val) {
+        char buf[12];
+        return *this += ltoa(val, buf, 10);
+    }
+
+    size_t length() const {
+        return len_;
+    }
+
+private:
+    char* buf_;
+    size_t len_;
+};
+
+struct Sample {
+    unsigned long time;
+    double temp;
+    double hum;
+    int bat;
+    int rssi;
+};
+
+Sample makeSample(unsigned i) {
+    Sample s;
+    s.time = 1540000000ul + i;
+    s.temp = 21.5 + (i % 100) * 0.037;
+    s.hum = 40.0 + (i % 50) * 0.31;
+    s.bat = 100 - i % 100;
+    s.rssi = -50 - (int)(i % 40);
+    return s;
+}
+
+// Runs a benchmark case and logs its throughput and allocation rate
+template<typename F>
+void runCase(const char* name, F fn) {
+    fn(0); // Warm up
+    allocCount = 0;
+    size_t bytes = 0;
+    const auto start = cpuTimeUs();
+    for (unsigned i = 0; i < ITERATIONS; ++i) {
+        bytes += fn(i);
+    }
+    const auto elapsed = cpuTimeUs() - start;
+    const unsigned allocs = allocCount;
+    const double bytesPerSec = (elapsed > 0) ? bytes * 1000000.0 / elapsed : 0.0;
+    Log.info("%-28s %8u KB/s, %6.2f allocations/message", name, (unsigned)(bytesPerSec / 1024),
+            (double)allocs / ITERATIONS);
+}
+
+} // namespace
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    ++allocCount;
+    return __real_malloc(size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    ++allocCount;
+    return __real_realloc(ptr, size);
+}
+
+} // extern "C"
+
+void setup() {
+    runCase("Print::printf() (legacy)", [](unsigned i) {
+        NullPrint p;
+        const Sample s = makeSample(i);
+        legacyPrintf(&p, TELEMETRY_FORMAT, s.time, DEVICE_NAME, s.temp, s.hum, s.bat, s.rssi);
+        return p.size();
+    });
+    runCase("Print::printf()", [](unsigned i) {
+        NullPrint p;
+        const Sample s = makeSample(i);
+        p.printf(TELEMETRY_FORMAT, s.time, DEVICE_NAME, s.temp, s.hum, s.bat, s.rssi);
+        return p.size();
+    });
+    runCase("String::format() (legacy)", [](unsigned i) {
+        const Sample s = makeSample(i);
+        return legacyFormat(TELEMETRY_FORMAT, s.time, DEVICE_NAME, s.temp, s.hum, s.bat, s.rssi);
+    });
+    runCase("String::format()", [](unsigned i) {
+        const Sample s = makeSample(i);
+        const String str = String::format(TELEMETRY_FORMAT, s.time, DEVICE_NAME, s.temp, s.hum, s.bat, s.rssi);
+        return (size_t)str.length();
+    });
+    runCase("String concatenation (legacy)", [](unsigned i) {
+        const Sample s = makeSample(i);
+        LegacyString str;
+        str += "{\"t\":";
+        str += (long)s.time;
+        str += ",\"dev\":\"";
+        str += DEVICE_NAME;
+        str += "\",\"bat\":";
+        str += (long)s.bat;
+        str += ",\"rssi\":";
+        str += (long)s.rssi;
+        str += "}";
+        return str.length();
+    });
+    runCase("String concatenation", [](unsigned i) {
+        const Sample s = makeSample(i);
+        String str;
+        str += "{\"t\":";
+        str += s.time;
+        str += ",\"dev\":\"";
+        str += DEVICE_NAME;
+        str += "\",\"bat\":";
+        str += s.bat;
+        str += ",\"rssi\":";
+        str += s.rssi;
+        str += "}";
+        return (size_t)str.length();
+    });
+}
+
+void loop() {
+}
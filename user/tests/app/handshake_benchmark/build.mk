@@ -0,0 +1,7 @@
+INCLUDE_DIRS += $(SOURCE_PATH)/$(USRSRC)
+CPPSRC += $(call target_files,$(USRSRC_SLASH),*.cpp)
+
+# mbedTLS is linked into the gcc image, only its headers and configuration are needed here
+include $(PROJECT_ROOT)/crypto/inc/include.mk
+INCLUDE_DIRS += $(PROJECT_ROOT)/third_party/mbedtls/mbedtls/include
+CFLAGS += -DMBEDTLS_CONFIG_FILE="<mbedtls_config.h>"
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * DTLS handshake CPU time benchmark for the virtual device.
+ *
+ * Runs the public key operations the device performs during an ECDHE-ECDSA handshake with the
+ * cloud and logs the CPU time they take, along with the RAM and flash cost of each crypto
+ * profile. Every iteration loads its own group instances, as a real handshake does.
+ *
+ * Build: make PLATFORM=gcc APP=../tests/app/handshake_benchmark [CRYPTO_PROFILE=fast_handshake]
+ */
+
+#include "application.h"
+
+#if PLATFORM_ID != PLATFORM_GCC
+#error "This application is only supported on the gcc platform"
+#endif
+
+#include "mbedtls_ecp_comb.h"
+#include "mbedtls_util.h"
+#include "mbedtls/ecdh.h"
+#include "mbedtls/ecdsa.h"
+#include "mbedtls/sha256.h"
+
+#include <malloc.h>
+#include <time.h>
+
+SYSTEM_MODE(MANUAL);
+
+SerialLogHandler logHandler(LOG_LEVEL_WARN, {
+    { "app", LOG_LEVEL_ALL }
+});
+
+namespace {
+
+const unsigned ITERATIONS = 20;
+
+// Keys of the server side, generated once
+struct ServerKeys {
+    mbedtls_ecdsa_context sign; // Long-term key
+    mbedtls_ecdh_context ecdh; // Ephemeral key
+    mbedtls_mpi r, s; // ServerKeyExchange signature
+    unsigned char hash[32];
+};
+
+uint64_t cpuTimeUs() {
+    timespec ts = {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+size_t heapUsed() {
+    return mallinfo().uordblks;
+}
+
+int initServer(ServerKeys* keys) {
+    mbedtls_ecdsa_init(&keys->sign);
+    mbedtls_ecdh_init(&keys->ecdh);
+    mbedtls_mpi_init(&keys->r);
+    mbedtls_mpi_init(&keys->s);
+    mbedtls_sha256((const unsigned char*)"ServerKeyExchange", 17, keys->hash, 0);
+    int ret = mbedtls_ecdsa_genkey(&keys->sign, MBEDTLS_ECP_DP_SECP256R1, mbedtls_default_rng, nullptr);
+    if (ret == 0) {
+        ret = mbedtls_ecp_group_load(&keys->ecdh.grp, MBEDTLS_ECP_DP_SECP256R1);
+    }
+    if (ret == 0) {
+        ret = mbedtls_ecdh_gen_public(&keys->ecdh.grp, &keys->ecdh.d, &keys->ecdh.Q, mbedtls_default_rng, nullptr);
+    }
+    if (ret == 0) {
+        ret = mbedtls_ecdsa_sign(&keys->sign.grp, &keys->r, &keys->s, &keys->sign.d, keys->hash, sizeof(keys->hash),
+                mbedtls_default_rng, nullptr);
+    }
+    return ret;
+}
+
+// Public key operations of the device side of a handshake
+int runHandshake(const ServerKeys& server, const mbedtls_ecdsa_context& device, size_t* heap) {
+    mbedtls_ecdh_context ecdh;
+    mbedtls_ecdh_init(&ecdh);
+    mbedtls_ecdsa_context verify;
+    mbedtls_ecdsa_init(&verify);
+    mbedtls_ecdsa_context sign;
+    mbedtls_ecdsa_init(&sign);
+    mbedtls_mpi r, s;
+    mbedtls_mpi_init(&r);
+    mbedtls_mpi_init(&s);
+    const size_t heapBefore = heapUsed();
+    // ServerKeyExchange: verify the signature of the server's parameters
+    int ret = mbedtls_ecp_group_load(&verify.grp, MBEDTLS_ECP_DP_SECP256R1);
+    if (ret == 0) {
+        ret = mbedtls_ecp_copy(&verify.Q, &server.sign.Q);
+    }
+    if (ret == 0) {
+        ret = mbedtls_ecdsa_verify(&verify.grp, server.hash, sizeof(server.hash), &verify.Q, &server.r, &server.s);
+    }
+    // ClientKeyExchange: generate an ephemeral key and compute the shared secret
+    if (ret == 0) {
+        ret = mbedtls_ecp_group_load(&ecdh.grp, MBEDTLS_ECP_DP_SECP256R1);
+    }
+    if (ret == 0) {
+        ret = mbedtls_ecdh_gen_public(&ecdh.grp, &ecdh.d, &ecdh.Q, mbedtls_default_rng, nullptr);
+    }
+    if (ret == 0) {
+        ret = mbedtls_ecdh_compute_shared(&ecdh.grp, &ecdh.z, &server.ecdh.Q, &ecdh.d, mbedtls_default_rng, nullptr);
+    }
+    // CertificateVerify: sign the handshake messages with the device key
+    if (ret == 0) {
+        ret = mbedtls_ecp_group_load(&sign.grp, MBEDTLS_ECP_DP_SECP256R1);
+    }
+    if (ret == 0) {
+        ret = mbedtls_mpi_copy(&sign.d, &device.d);
+    }
+    if (ret == 0) {
+        ret = mbedtls_ecdsa_sign(&sign.grp, &r, &s, &sign.d, server.hash, sizeof(server.hash), mbedtls_default_rng,
+                nullptr);
+    }
+    if (heap) {
+        *heap = heapUsed() - heapBefore;
+    }
+    mbedtls_mpi_free(&s);
+    mbedtls_mpi_free(&r);
+    mbedtls_ecdsa_free(&sign);
+    mbedtls_ecdsa_free(&verify);
+    mbedtls_ecdh_free(&ecdh);
+    return ret;
+}
+
+// Checks that the precomputed table gives the same results as the one computed by mbedTLS
+bool checkCombTable(const mbedtls_ecdsa_context& device) {
+    mbedtls_ecp_point q[2];
+    bool ok = true;
+    for (int i = 0; i < 2; ++i) {
+        mbedtls_ecp_comb_table_enable(i);
+        mbedtls_ecp_group grp;
+        mbedtls_ecp_group_init(&grp);
+        mbedtls_ecp_point_init(&q[i]);
+        if (mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_SECP256R1) != 0 ||
+                mbedtls_ecp_mul(&grp, &q[i], &device.d, &grp.G, mbedtls_default_rng, nullptr) != 0) {
+            ok = false;
+        }
+        mbedtls_ecp_group_free(&grp);
+    }
+    if (ok) {
+        ok = (mbedtls_ecp_point_cmp(&q[0], &q[1]) == 0 && mbedtls_ecp_point_cmp(&q[1], &device.Q) == 0);
+    }
+    mbedtls_ecp_point_free(&q[1]);
+    mbedtls_ecp_point_free(&q[0]);
+    return ok;
+}
+
+void runBenchmark(const char* profile, const ServerKeys& server, const mbedtls_ecdsa_context& device) {
+    size_t heap = 0;
+    // Warm up
+    if (runHandshake(server, device, &heap) != 0) {
+        Log.error("%s: handshake failed", profile);
+        return;
+    }
+    const auto start = cpuTimeUs();
+    for (unsigned i = 0; i < ITERATIONS; ++i) {
+        runHandshake(server, device, nullptr);
+    }
+    const auto elapsed = cpuTimeUs() - start;
+    Log.info("%-15s CPU time: %6u us/handshake, RAM: %5u bytes, flash: %5u bytes", profile,
+            (unsigned)(elapsed / ITERATIONS), (unsigned)heap,
+            (unsigned)(mbedtls_ecp_comb_table_enabled() ? mbedtls_ecp_comb_table_size() : 0));
+}
+
+} // namespace
+
+void setup() {
+    static ServerKeys server;
+    static mbedtls_ecdsa_context device;
+    mbedtls_ecdsa_init(&device);
+    if (initServer(&server) != 0 ||
+            mbedtls_ecdsa_genkey(&device, MBEDTLS_ECP_DP_SECP256R1, mbedtls_default_rng, nullptr) != 0) {
+        Log.error("Unable to generate keys");
+        return;
+    }
+    // RAM is the heap held by the groups at the end of a handshake, flash is the size of the
+    // precomputed tables
+    mbedtls_ecp_comb_table_enable(0);
+    runBenchmark("default", server, device);
+    if (mbedtls_ecp_comb_table_size() == 0) {
+        Log.info("Rebuild with CRYPTO_PROFILE=fast_handshake to benchmark the fast handshake profile");
+        return;
+    }
+    if (!checkCombTable(device)) {
+        Log.error("Precomputed table mismatch");
+        return;
+    }
+    mbedtls_ecp_comb_table_enable(1);
+    runBenchmark("fast_handshake", server, device);
+}
+
+void loop() {
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Mesh.publish() benchmark: number of datagrams sent per delivered event.
+ *
+ * Flash the application to two or more devices on the same mesh network. Each device subscribes
+ * to "bench/sub" and periodically publishes a burst of events, half of which no device is
+ * subscribed to. Aggregation is toggled every BENCHMARK_PERIOD, and the statistics of each
+ * period are logged. Note that suppression of the events without subscribers only takes effect
+ * after the subscription advertisements have been collected for a while.
+ *
+ * Build: make PLATFORM=xenon APP=../tests/app/mesh/publish_benchmark
+ */
+
+#include "application.h"
+
+#if !Wiring_Mesh
+#error "This application is only supported on mesh platforms"
+#endif
+
+SYSTEM_MODE(MANUAL);
+
+SerialLogHandler logHandler(LOG_LEVEL_WARN, {
+    { "app", LOG_LEVEL_ALL }
+});
+
+namespace {
+
+const unsigned BURST_SIZE = 10;
+const system_tick_t BURST_INTERVAL = 1000;
+const system_tick_t BENCHMARK_PERIOD = 5 * 60 * 1000;
+
+unsigned received = 0;
+unsigned sent = 0;
+bool aggregation = false;
+system_tick_t lastBurst = 0;
+system_tick_t periodStart = 0;
+MeshPublishStats lastStats = {};
+
+void onEvent(const char* name, const char* data) {
+    ++received;
+}
+
+void publishBurst() {
+    char name[32] = {};
+    for (unsigned i = 0; i < BURST_SIZE; ++i) {
+        snprintf(name, sizeof(name), (i % 2 == 0) ? "bench/sub/%u" : "bench/nobody/%u", sent);
+        Mesh.publish(name, "data");
+        ++sent;
+    }
+}
+
+void logStats() {
+    const MeshPublishStats stats = Mesh.publishStats();
+    const unsigned published = stats.eventsPublished - lastStats.eventsPublished;
+    const unsigned packets = (stats.eventPackets - lastStats.eventPackets) +
+            (stats.advertisements - lastStats.advertisements);
+    // Only the events that have subscribers are delivered
+    const unsigned delivered = published / 2;
+    Log.info("Aggregation: %s, published: %u, suppressed: %u, packets: %u, packets per delivered event: %.3f",
+            aggregation ? "on" : "off", published, stats.eventsSuppressed - lastStats.eventsSuppressed,
+            packets, delivered ? (double)packets / delivered : 0.0);
+    Log.info("Events received from other devices: %u", received);
+    lastStats = stats;
+    received = 0;
+}
+
+} // namespace
+
+void setup() {
+    Mesh.on();
+    Mesh.connect();
+    waitUntil(Mesh.ready);
+    Mesh.subscribe("bench/sub", onEvent);
+    periodStart = millis();
+}
+
+void loop() {
+    const system_tick_t now = millis();
+    if (now - lastBurst >= BURST_INTERVAL) {
+        publishBurst();
+        lastBurst = now;
+    }
+    if (now - periodStart >= BENCHMARK_PERIOD) {
+        logStats();
+        aggregation = !aggregation;
+        if (aggregation) {
+            Mesh.enableAggregation();
+        } else {
+            Mesh.disableAggregation();
+        }
+        periodStart = now;
+    }
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * TCPClient receive throughput benchmark for the virtual device.
+ *
+ * A loopback server running in a separate host thread streams newline-terminated lines to the
+ * device, which reads them using different strategies and logs the throughput of each.
+ *
+ * Build: make PLATFORM=gcc APP=../tests/app/tcp_client_benchmark
+ */
+
+#include "application.h"
+
+#if PLATFORM_ID != PLATFORM_GCC
+#error "This application is only supported on the gcc platform"
+#endif
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <thread>
+#include <cstring>
+
+SYSTEM_MODE(MANUAL);
+
+SerialLogHandler logHandler(LOG_LEVEL_WARN, {
+    { "app", LOG_LEVEL_ALL }
+});
+
+namespace {
+
+const uint16_t PORT = 5555;
+const size_t TOTAL_SIZE = 16 * 1024 * 1024;
+const size_t LINE_SIZE = 80;
+
+// Sends TOTAL_SIZE bytes to every accepted connection
+void runServer(int listenSock) {
+    char line[LINE_SIZE];
+    memset(line, 'x', sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\n';
+    for (;;) {
+        const int sock = accept(listenSock, nullptr, nullptr);
+        if (sock < 0) {
+            break;
+        }
+        size_t sent = 0;
+        while (sent < TOTAL_SIZE) {
+            const ssize_t n = send(sock, line, sizeof(line), MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            sent += n;
+        }
+        close(sock);
+    }
+}
+
+int startServer() {
+    const int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    const int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(sock, (const sockaddr*)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+        close(sock);
+        return -1;
+    }
+    std::thread(runServer, sock).detach();
+    return 0;
+}
+
+enum class Mode {
+    BYTE, // read()
+    CHUNK, // read(buf, TCPCLIENT_BUF_MAX_SIZE)
+    DIRECT, // read(buf, sizeof(buf)), receives directly into the caller's buffer
+    LINE // readBytesUntil('\n', ...)
+};
+
+const char* modeName(Mode mode) {
+    switch (mode) {
+    case Mode::BYTE:
+        return "read()";
+    case Mode::CHUNK:
+        return "read(128)";
+    case Mode::DIRECT:
+        return "read(4096)";
+    case Mode::LINE:
+        return "readBytesUntil()";
+    default:
+        return "";
+    }
+}
+
+void runBenchmark(Mode mode, size_t bufferSize) {
+    TCPClient client;
+    if (!client.connect(IPAddress(127, 0, 0, 1), PORT) || !client.setBufferSize(bufferSize)) {
+        Log.error("Unable to connect to the server");
+        return;
+    }
+    static char buf[4096];
+    size_t total = 0;
+    const auto start = micros();
+    while (total < TOTAL_SIZE && client.connected()) {
+        int n = 0;
+        switch (mode) {
+        case Mode::BYTE:
+            n = (client.read() >= 0) ? 1 : 0;
+            break;
+        case Mode::CHUNK:
+            n = client.read((uint8_t*)buf, TCPCLIENT_BUF_MAX_SIZE);
+            break;
+        case Mode::DIRECT:
+            n = client.read((uint8_t*)buf, sizeof(buf));
+            break;
+        case Mode::LINE:
+            n = client.readBytesUntil('\n', buf, sizeof(buf));
+            if (n > 0) {
+                ++n; // Terminator
+            }
+            break;
+        }
+        if (n > 0) {
+            total += n;
+        }
+    }
+    const auto elapsed = micros() - start;
+    client.stop();
+    Log.info("%-18s buffer: %5u bytes, received: %u bytes, %u KB/s", modeName(mode), (unsigned)bufferSize,
+            (unsigned)total, (unsigned)((uint64_t)total * 1000000 / 1024 / (elapsed ? elapsed : 1)));
+}
+
+} // namespace
+
+void setup() {
+    WiFi.connect();
+    waitUntil(WiFi.ready);
+    if (startServer() < 0) {
+        Log.error("Unable to start the loopback server");
+        return;
+    }
+    for (const size_t bufferSize: { (size_t)TCPCLIENT_BUF_MAX_SIZE, (size_t)1024, (size_t)4096 }) {
+        for (const Mode mode: { Mode::BYTE, Mode::CHUNK, Mode::DIRECT, Mode::LINE }) {
+            runBenchmark(mode, bufferSize);
+        }
+    }
+}
+
+void loop() {
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * TlvFile set/get/del benchmark.
+ *
+ * The file is stored on a LittleFS instance backed by a RAM block device, so that the results
+ * don't depend on the external flash. For each operation, the time and the number of block device
+ * reads, programs and erases are logged, with and without the log mode.
+ *
+ * Build: make PLATFORM=xenon MODULAR=n APP=../tests/app/tlv_file_benchmark
+ */
+
+#include "application.h"
+
+#if !HAL_PLATFORM_FILESYSTEM
+#error "This application requires a platform with a filesystem"
+#endif
+
+#include "tlv_file.h"
+
+SYSTEM_MODE(MANUAL);
+
+SerialLogHandler logHandler(LOG_LEVEL_WARN, {
+    { "app", LOG_LEVEL_ALL }
+});
+
+namespace {
+
+using particle::services::settings::TlvFile;
+
+const size_t BLOCK_SIZE = 512;
+const size_t BLOCK_COUNT = 64;
+const unsigned KEY_COUNT = 32;
+const size_t VALUE_SIZE = 16;
+const unsigned ITERATIONS = 64;
+
+uint8_t g_storage[BLOCK_SIZE * BLOCK_COUNT];
+
+struct Counters {
+    unsigned reads;
+    unsigned progs;
+    unsigned erases;
+};
+
+Counters g_counters = {};
+
+int bdRead(const lfs_config* c, lfs_block_t block, lfs_off_t off, void* buf, lfs_size_t size) {
+    memcpy(buf, g_storage + block * c->block_size + off, size);
+    ++g_counters.reads;
+    return 0;
+}
+
+int bdProg(const lfs_config* c, lfs_block_t block, lfs_off_t off, const void* buf, lfs_size_t size) {
+    memcpy(g_storage + block * c->block_size + off, buf, size);
+    ++g_counters.progs;
+    return 0;
+}
+
+int bdErase(const lfs_config* c, lfs_block_t block) {
+    memset(g_storage + block * c->block_size, 0xff, c->block_size);
+    ++g_counters.erases;
+    return 0;
+}
+
+int bdSync(const lfs_config* c) {
+    return 0;
+}
+
+filesystem_t g_fs = {};
+
+int mountRamFs() {
+    memset(g_storage, 0xff, sizeof(g_storage));
+    g_fs.config.read = bdRead;
+    g_fs.config.prog = bdProg;
+    g_fs.config.erase = bdErase;
+    g_fs.config.sync = bdSync;
+    g_fs.config.read_size = FILESYSTEM_READ_SIZE;
+    g_fs.config.prog_size = FILESYSTEM_PROG_SIZE;
+    g_fs.config.block_size = BLOCK_SIZE;
+    g_fs.config.block_count = BLOCK_COUNT;
+    g_fs.config.lookahead = BLOCK_COUNT;
+    int ret = lfs_format(&g_fs.instance, &g_fs.config);
+    if (!ret) {
+        ret = lfs_mount(&g_fs.instance, &g_fs.config);
+    }
+    if (!ret) {
+        /* filesystem_mount() is a no-op for a mounted instance */
+        g_fs.state = true;
+    }
+    return ret;
+}
+
+void unmountRamFs() {
+    if (g_fs.state) {
+        lfs_unmount(&g_fs.instance);
+        g_fs.state = false;
+    }
+}
+
+class Measurement {
+public:
+    explicit Measurement(const char* name) :
+            name_(name),
+            start_(micros()) {
+        g_counters = {};
+    }
+
+    ~Measurement() {
+        const auto elapsed = micros() - start_;
+        Log.info("%-28s %6u us/op, reads: %4u, progs: %4u, erases: %3u", name_, (unsigned)(elapsed / ITERATIONS),
+                g_counters.reads / ITERATIONS, g_counters.progs / ITERATIONS, g_counters.erases / ITERATIONS);
+    }
+
+private:
+    const char* name_;
+    system_tick_t start_;
+};
+
+void runBenchmark(bool logMode) {
+    if (mountRamFs() != 0) {
+        Log.error("Unable to mount the filesystem");
+        return;
+    }
+    TlvFile file("/bench/settings.dat", &g_fs);
+    if (file.init() != 0) {
+        Log.error("Unable to open the file");
+        unmountRamFs();
+        return;
+    }
+    file.logMode(logMode);
+    Log.info("Log mode: %s", logMode ? "on" : "off");
+    uint8_t value[VALUE_SIZE] = {};
+    for (unsigned i = 0; i < KEY_COUNT; ++i) {
+        file.set(i, value, sizeof(value));
+    }
+    {
+        Measurement m("get()");
+        for (unsigned i = 0; i < ITERATIONS; ++i) {
+            file.get(i % KEY_COUNT, value, sizeof(value));
+        }
+    }
+    {
+        Measurement m("set(), first key");
+        for (unsigned i = 0; i < ITERATIONS; ++i) {
+            value[0] = i;
+            file.set(0, value, sizeof(value));
+        }
+    }
+    {
+        Measurement m("set(), random key");
+        for (unsigned i = 0; i < ITERATIONS; ++i) {
+            value[0] = i;
+            file.set(random(KEY_COUNT), value, sizeof(value));
+        }
+    }
+    {
+        Measurement m("del() + add()");
+        for (unsigned i = 0; i < ITERATIONS; ++i) {
+            const unsigned key = random(KEY_COUNT);
+            file.del(key);
+            file.add(key, value, sizeof(value));
+        }
+    }
+    {
+        Measurement m("init() (index rebuild)");
+        for (unsigned i = 0; i < ITERATIONS; ++i) {
+            file.deInit();
+            file.init();
+        }
+    }
+    Log.info("File size: %d bytes, stale: %u bytes", (int)file.size(), (unsigned)file.staleSize());
+    file.deInit();
+    unmountRamFs();
+}
+
+} // namespace
+
+void setup() {
+    waitUntil(Serial.isConnected);
+    runBenchmark(false);
+    runBenchmark(true);
+}
+
+void loop() {
+}
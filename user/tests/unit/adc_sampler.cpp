@@ -0,0 +1,230 @@
+#include "spark_wiring_adc_sampler.h"
+#include "spark_wiring_dsp.h"
+#include "adc_hal_impl.h"
+#include "system_error.h"
+
+#include "tools/catch.h"
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+using namespace particle;
+
+const pin_t PIN = A0;
+
+void setWaveform(uint8_t type, float frequency, uint16_t amplitude, uint16_t offset, uint16_t noise = 0) {
+    HAL_ADC_Waveform w = {};
+    w.size = sizeof(w);
+    w.type = type;
+    w.frequency = frequency;
+    w.amplitude = amplitude;
+    w.offset = offset;
+    w.noise = noise;
+    REQUIRE(HAL_ADC_Set_Waveform(PIN, &w, nullptr) == 0);
+}
+
+template<typename F>
+bool waitFor(F condition, unsigned timeoutMs = 5000) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("Synthetic ADC waveforms") {
+    SECTION("sine") {
+        setWaveform(HAL_ADC_WAVEFORM_SINE, 100, 1000, 2048);
+        // 40 samples per period
+        CHECK(HAL_ADC_Waveform_Sample(PIN, 0, 4000) == 2048);
+        CHECK(HAL_ADC_Waveform_Sample(PIN, 10, 4000) == 3048);
+        CHECK(HAL_ADC_Waveform_Sample(PIN, 20, 4000) == 2048);
+        CHECK(HAL_ADC_Waveform_Sample(PIN, 30, 4000) == 1048);
+        CHECK(HAL_ADC_Waveform_Sample(PIN, 40 * 1000 + 10, 4000) == 3048);
+    }
+
+    SECTION("square") {
+        setWaveform(HAL_ADC_WAVEFORM_SQUARE, 1000, 500, 1000);
+        CHECK(HAL_ADC_Waveform_Sample(PIN, 0, 8000) == 1500);
+        CHECK(HAL_ADC_Waveform_Sample(PIN, 3, 8000) == 1500);
+        CHECK(HAL_ADC_Waveform_Sample(PIN, 4, 8000) == 500);
+        CHECK(HAL_ADC_Waveform_Sample(PIN, 7, 8000) == 500);
+    }
+
+    SECTION("samples are clamped to the 12-bit range") {
+        setWaveform(HAL_ADC_WAVEFORM_SAWTOOTH, 1, 4000, 1000);
+        CHECK(HAL_ADC_Waveform_Sample(PIN, 0, 100) == 0);
+        CHECK(HAL_ADC_Waveform_Sample(PIN, 99, 100) == 4095);
+    }
+
+    SECTION("noise is bounded and deterministic") {
+        setWaveform(HAL_ADC_WAVEFORM_CONSTANT, 0, 0, 2000, 50);
+        bool bounded = true;
+        bool varies = false;
+        for (uint64_t i = 0; i < 1000; ++i) {
+            const int v = HAL_ADC_Waveform_Sample(PIN, i, 1000);
+            if (v < 1950 || v > 2050) {
+                bounded = false;
+            }
+            if (v != 2000) {
+                varies = true;
+            }
+            if (v != HAL_ADC_Waveform_Sample(PIN, i, 1000)) {
+                bounded = false;
+            }
+        }
+        CHECK(bounded);
+        CHECK(varies);
+    }
+
+    SECTION("analogRead() samples the waveform") {
+        setWaveform(HAL_ADC_WAVEFORM_CONSTANT, 0, 0, 1234);
+        CHECK(HAL_ADC_Read(PIN) == 1234);
+    }
+
+    HAL_ADC_Set_Waveform(PIN, nullptr, nullptr);
+}
+
+TEST_CASE("ADCSampler") {
+    const uint32_t RATE = 100000;
+    const size_t SIZE = 200;
+    std::vector<uint16_t> buf(SIZE);
+    ADCSampler sampler;
+    setWaveform(HAL_ADC_WAVEFORM_SINE, 1000, 1500, 2048, 20);
+
+    SECTION("invalid arguments are rejected") {
+        CHECK(sampler.begin(PIN, RATE, buf.data(), SIZE - 1) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(sampler.begin(PIN, 0, buf.data(), SIZE) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(sampler.begin(PIN, RATE, nullptr, SIZE) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(!sampler.isRunning());
+    }
+
+    SECTION("only one sampler can be running") {
+        REQUIRE(sampler.begin(PIN, RATE, buf.data(), SIZE) == 0);
+        std::vector<uint16_t> buf2(SIZE);
+        ADCSampler sampler2;
+        CHECK(sampler2.begin(PIN, RATE, buf2.data(), SIZE) == SYSTEM_ERROR_INVALID_STATE);
+        CHECK(sampler.sampleRate() == RATE);
+        // analogRead() is not available while sampling
+        CHECK(HAL_ADC_Read(PIN) == 0);
+        sampler.end();
+        CHECK(sampler.sampleRate() == 0);
+        CHECK(sampler2.begin(PIN, RATE, buf2.data(), SIZE) == 0);
+    }
+
+    SECTION("callback receives consecutive halves of the buffer") {
+        std::mutex mutex;
+        std::vector<uint16_t> received;
+        std::vector<const uint16_t*> halves;
+        REQUIRE(sampler.begin(PIN, RATE, buf.data(), SIZE, [&](const uint16_t* samples, size_t count) {
+            std::lock_guard<std::mutex> lock(mutex);
+            received.insert(received.end(), samples, samples + count);
+            halves.push_back(samples);
+        }) == 0);
+        CHECK(waitFor([&]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return halves.size() >= 10;
+        }));
+        sampler.end();
+        const uint32_t buffers = sampler.buffers();
+        CHECK(buffers >= 10);
+        CHECK(sampler.overruns() == 0);
+        REQUIRE(halves.size() == buffers);
+        REQUIRE(received.size() == buffers * SIZE / 2);
+        for (size_t i = 0; i < halves.size(); ++i) {
+            CHECK(halves[i] == buf.data() + (i % 2) * SIZE / 2);
+        }
+        bool match = true;
+        for (size_t i = 0; i < received.size(); ++i) {
+            if (received[i] != HAL_ADC_Waveform_Sample(PIN, i, RATE)) {
+                match = false;
+            }
+        }
+        CHECK(match);
+    }
+
+    SECTION("halves are dropped and the held half is overwritten while the application holds it") {
+        HAL_ADC_Sampler_Set_Paced(false);
+        REQUIRE(sampler.begin(PIN, RATE, buf.data(), SIZE) == 0);
+        REQUIRE(waitFor([&]() {
+            return sampler.available();
+        }));
+        size_t count = 0;
+        const uint16_t* samples = sampler.read(&count);
+        CHECK(samples == buf.data());
+        CHECK(count == SIZE / 2);
+        CHECK(waitFor([&]() {
+            return sampler.overruns() >= 5;
+        }));
+        CHECK(sampler.buffers() == 1);
+        CHECK(sampler.read() == samples);
+        HAL_ADC_Sampler_Stats stats = {};
+        stats.size = sizeof(stats);
+        REQUIRE(HAL_ADC_Sampler_Get_Stats(&stats, nullptr) == 0);
+        CHECK(stats.held_overwritten);
+        // The half is released but the application is told that its samples are not valid
+        CHECK(sampler.release() == SYSTEM_ERROR_TIMEOUT);
+        CHECK(!sampler.available());
+        CHECK(sampler.release() == SYSTEM_ERROR_INVALID_STATE);
+        REQUIRE(HAL_ADC_Sampler_Get_Stats(&stats, nullptr) == 0);
+        CHECK(!stats.held_overwritten);
+        CHECK(waitFor([&]() {
+            return sampler.buffers() >= 2;
+        }));
+        sampler.end();
+        HAL_ADC_Sampler_Set_Paced(true);
+    }
+
+    SECTION("samples are converted and processed in blocks") {
+        std::vector<dsp::q15_t> block(SIZE / 2);
+        REQUIRE(sampler.begin(PIN, RATE, buf.data(), SIZE) == 0);
+        REQUIRE(waitFor([&]() {
+            return sampler.available();
+        }));
+        size_t count = 0;
+        const uint16_t* samples = sampler.read(&count);
+        dsp::adcToQ15(samples, block.data(), count);
+        sampler.release();
+        sampler.end();
+        // One full period of the 1 kHz sine wave with an amplitude of 1500 / 2048 of the full scale
+        const double rms = (double)dsp::rms(block.data(), block.size()) / 32768;
+        CHECK(std::abs(rms - 1500.0 / 2048 / std::sqrt(2.0)) <= 0.005);
+    }
+
+    HAL_ADC_Set_Waveform(PIN, nullptr, nullptr);
+}
+
+// Sample throughput of the sampler pipeline on the host, run with the [benchmark] tag
+TEST_CASE("ADCSampler throughput", "[.][benchmark]") {
+    const size_t SIZE = 2048;
+    std::vector<uint16_t> buf(SIZE);
+    std::vector<dsp::q15_t> block(SIZE / 2);
+    setWaveform(HAL_ADC_WAVEFORM_SINE, 1000, 1500, 2048, 20);
+    HAL_ADC_Sampler_Set_Paced(false);
+    ADCSampler sampler;
+    volatile dsp::q15_t sink = 0;
+    const auto t1 = std::chrono::steady_clock::now();
+    REQUIRE(sampler.begin(PIN, 1000000, buf.data(), SIZE, [&](const uint16_t* samples, size_t count) {
+        dsp::adcToQ15(samples, block.data(), count);
+        sink = dsp::rms(block.data(), count);
+    }) == 0);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    sampler.end();
+    const auto t2 = std::chrono::steady_clock::now();
+    HAL_ADC_Sampler_Set_Paced(true);
+    HAL_ADC_Set_Waveform(PIN, nullptr, nullptr);
+    const double time = std::chrono::duration<double>(t2 - t1).count();
+    const double rate = sampler.buffers() * (SIZE / 2) / time;
+    CATCH_WARN("Delivered samples: " << rate / 1e6 << " MS/s, overruns: " << sampler.overruns());
+    CHECK(sampler.overruns() == 0);
+}
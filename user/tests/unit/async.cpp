@@ -1,4 +1,5 @@
 #include "spark_wiring_async.h"
+#include "spark_wiring_coroutine.h"
 
 #include "completion_handler.h"
 
@@ -8,6 +9,10 @@
 
 #include <thread>
 #include <deque>
+#include <vector>
+#include <map>
+#include <set>
+#include <random>
 
 namespace {
 
@@ -411,6 +416,201 @@ TEST_CASE("AdaptedFuture<int>") {
     }
 }
 
+TEST_CASE("Future::then()") {
+    resetContext();
+
+    SECTION("continuation is invoked with the result of the operation") {
+        ::Promise<int> p;
+        ::Future<int> f = p.future().then([](int r) {
+            return r * 2;
+        });
+        CHECK(f.isDone() == false);
+        p.setResult(2);
+        CHECK(f.isSucceeded() == true);
+        CHECK(f.result() == 4);
+    }
+
+    SECTION("continuations can be chained") {
+        ::Promise<void> p;
+        std::vector<int> log;
+        ::Future<void> f = p.future().then([&log]() {
+            log.push_back(1);
+            return 2;
+        }).then([&log](int r) {
+            log.push_back(r);
+        }).then([&log]() {
+            log.push_back(3);
+        });
+        CHECK(log.empty());
+        p.setResult();
+        CHECK(f.isSucceeded() == true);
+        CHECK((log == std::vector<int>{ 1, 2, 3 }));
+    }
+
+    SECTION("continuation returning a future completes with that future") {
+        ::Promise<int> p1;
+        ::Promise<int> p2;
+        ::Future<int> f = p1.future().then([&p2](int r) {
+            return p2.future();
+        });
+        p1.setResult(1);
+        CHECK(f.isDone() == false);
+        p2.setResult(2);
+        CHECK(f.result() == 2);
+        // Error of the inner future
+        ::Promise<void> p3;
+        ::Promise<void> p4;
+        ::Future<void> f2 = p3.future().then([&p4]() {
+            return p4.future();
+        });
+        p3.setResult();
+        p4.setError(Error::TIMEOUT);
+        CHECK(f2.isFailed() == true);
+        CHECK(f2.error() == Error::TIMEOUT);
+    }
+
+    SECTION("errors are passed on without invoking continuations") {
+        ::Promise<int> p;
+        bool invoked = false;
+        ::Future<int> f = p.future().then([&invoked](int r) {
+            invoked = true;
+            return r;
+        }).then([&invoked](int r) {
+            invoked = true;
+            return r;
+        });
+        p.setError(Error::UNKNOWN);
+        CHECK(f.isFailed() == true);
+        CHECK(f.error() == Error::UNKNOWN);
+        CHECK(invoked == false);
+    }
+
+    SECTION("continuation is invoked for already completed future") {
+        ::Future<int> f = ::Future<int>(3).then([](int r) {
+            return r + 1;
+        });
+        CHECK(f.result() == 4);
+    }
+}
+
+namespace {
+
+// Coroutine awaiting a sequence of operations
+class TestCoroutine: public Coroutine {
+public:
+    ::Promise<int> promise;
+    bool ready = false;
+    std::vector<int> log;
+
+protected:
+    bool run() override {
+        COROUTINE_BEGIN();
+        log.push_back(1);
+        COROUTINE_YIELD();
+        log.push_back(2);
+        COROUTINE_AWAIT(ready);
+        log.push_back(3);
+        future_ = promise.future();
+        COROUTINE_AWAIT(future_);
+        log.push_back(future_.result());
+        COROUTINE_END();
+    }
+
+private:
+    ::Future<int> future_;
+};
+
+// Coroutine running for a number of iterations
+class CountingCoroutine: public Coroutine {
+public:
+    explicit CountingCoroutine(int count, std::vector<int>* log) :
+            count_(count),
+            log_(log),
+            i_(0) {
+    }
+
+protected:
+    bool run() override {
+        COROUTINE_BEGIN();
+        for (i_ = 0; i_ < count_; ++i_) {
+            log_->push_back(count_);
+            COROUTINE_YIELD();
+        }
+        COROUTINE_END();
+    }
+
+private:
+    int count_;
+    std::vector<int>* log_;
+    int i_;
+};
+
+} // namespace
+
+TEST_CASE("CoroutineScheduler") {
+    resetContext();
+    CoroutineScheduler s;
+    CHECK(s.isEmpty());
+    CHECK(s.process() == 0);
+
+    SECTION("coroutine is resumed at the point where it was suspended") {
+        TestCoroutine c;
+        s.start(&c);
+        CHECK(s.process() == 1);
+        CHECK((c.log == std::vector<int>{ 1 }));
+        CHECK(s.process() == 1);
+        CHECK(s.process() == 1);
+        CHECK((c.log == std::vector<int>{ 1, 2 })); // Waiting for the condition
+        c.ready = true;
+        CHECK(s.process() == 1);
+        CHECK(s.process() == 1);
+        CHECK((c.log == std::vector<int>{ 1, 2, 3 })); // Waiting for the future
+        postEvent([&c]() {
+            c.promise.setResult(4);
+        });
+        Context::processApplicationEvents();
+        CHECK(s.process() == 0);
+        CHECK((c.log == std::vector<int>{ 1, 2, 3, 4 }));
+        CHECK(c.isDone());
+        CHECK(s.isEmpty());
+    }
+
+    SECTION("coroutines are resumed in the order they were started") {
+        std::vector<int> log;
+        CountingCoroutine c1(1, &log), c2(2, &log), c3(3, &log);
+        s.start(&c1);
+        s.start(&c2);
+        s.start(&c3);
+        CHECK(s.process() == 3);
+        CHECK(s.process() == 2); // c1 is done
+        CHECK(s.process() == 1);
+        CHECK(s.process() == 0);
+        CHECK((log == std::vector<int>{ 1, 2, 3, 2, 3, 3 }));
+        CHECK(s.isEmpty());
+        // Restarting a completed coroutine
+        log.clear();
+        s.start(&c2);
+        CHECK(s.process() == 1);
+        CHECK(s.process() == 1);
+        CHECK(s.process() == 0);
+        CHECK((log == std::vector<int>{ 2, 2 }));
+    }
+
+    SECTION("coroutine can be stopped") {
+        std::vector<int> log;
+        CountingCoroutine c1(3, &log), c2(3, &log);
+        s.start(&c1);
+        s.start(&c2);
+        CHECK(s.process() == 2);
+        s.stop(&c1);
+        CHECK(s.process() == 1);
+        s.stop(&c2);
+        CHECK(s.isEmpty());
+        CHECK((log == std::vector<int>{ 3, 3, 3 }));
+        CHECK(!c1.isDone());
+    }
+}
+
 TEST_CASE("CompletionHandler") {
     SECTION("using default-constructed handler") {
         CHECK((bool)CompletionHandler() == false);
@@ -777,4 +977,173 @@ TEST_CASE("CompletionHandlerMap") {
         CHECK(m.size() == 0);
         CHECK(m.nearestTimeout() == CompletionHandlerMap::MAX_TIMEOUT);
     }
+
+    SECTION("adding a handler with an existing key replaces the existing handler") {
+        CompletionHandlerMap m;
+        CompletionData<int> d1, d2;
+        m.addHandler(1, d1.handler(), 10);
+        m.addHandler(1, d2.handler(), 20);
+        CHECK(d1.error() == Error::INTERNAL);
+        CHECK(m.size() == 1);
+        CHECK(m.nearestTimeout() == 20);
+        m.setResult(1, 1);
+        CHECK(d2.result() == 1);
+        CHECK(m.size() == 0);
+    }
+
+    SECTION("handlers with long timeouts") {
+        CompletionHandlerMap m;
+        CompletionData<int> d1, d2, d3;
+        m.addHandler(1, d1.handler(), 100000000); // Handler 1, timeout: ~28 hours
+        m.addHandler(2, d2.handler(), 3600000); // Handler 2, timeout: 1 hour
+        m.addHandler(3, d3.handler(), CompletionHandlerMap::MAX_TIMEOUT); // Handler 3, timeout: ~49 days
+        CHECK(m.nearestTimeout() == 3600000);
+        CHECK(m.update(3599999) == 0);
+        CHECK(m.nearestTimeout() == 1);
+        CHECK(m.update(1) == 1);
+        CHECK(d2.error() == Error::TIMEOUT);
+        CHECK(m.nearestTimeout() == 96400000);
+        CHECK(m.update(96399999) == 0);
+        CHECK(m.update(1) == 1);
+        CHECK(d1.error() == Error::TIMEOUT);
+        CHECK(m.update(CompletionHandlerMap::MAX_TIMEOUT) == 1);
+        CHECK(d3.error() == Error::TIMEOUT);
+        CHECK(m.isEmpty());
+    }
+}
+
+TEST_CASE("CompletionHandlerMap stress test") {
+    using CompletionHandlerMap = ::CompletionHandlerMap<int>;
+
+    // Result of a handler
+    struct Result {
+        int error = 0;
+        int count = 0; // Number of times the handler has been invoked
+
+        static void callback(int error, const void* data, void* callbackData, void* reserved) {
+            const auto r = static_cast<Result*>(callbackData);
+            r->error = error;
+            ++r->count;
+        }
+    };
+
+    // Expected state of the map
+    struct Model {
+        struct Entry {
+            uint64_t expires;
+            int result;
+        };
+        std::map<int, Entry> entries;
+        std::multiset<uint64_t> expires;
+        uint64_t now = 0;
+
+        void remove(std::map<int, Entry>::iterator it) {
+            expires.erase(expires.find(it->second.expires));
+            entries.erase(it);
+        }
+
+        system_tick_t nearestTimeout() const {
+            if (expires.empty()) {
+                return CompletionHandlerMap::MAX_TIMEOUT;
+            }
+            return *expires.begin() - now;
+        }
+    };
+
+    const int KEY_COUNT = 10000;
+    const int HANDLER_COUNT = 5000; // Initial number of outstanding handlers
+    const int OP_COUNT = 50000;
+
+    std::mt19937 rand(12345);
+    std::vector<Result> results(HANDLER_COUNT + OP_COUNT);
+    int resultCount = 0;
+    CompletionHandlerMap m;
+    Model model;
+
+    const auto addHandler = [&](system_tick_t timeout) {
+        const int key = rand() % KEY_COUNT;
+        const int r = resultCount++;
+        const auto it = model.entries.find(key);
+        int replaced = -1;
+        if (it != model.entries.end()) {
+            replaced = it->second.result;
+            model.remove(it);
+        }
+        REQUIRE(m.addHandler(key, CompletionHandler(Result::callback, &results[r]), timeout));
+        model.entries[key] = { model.now + timeout, r };
+        model.expires.insert(model.now + timeout);
+        if (replaced >= 0) {
+            REQUIRE(results[replaced].count == 1);
+            REQUIRE(results[replaced].error == SYSTEM_ERROR_INTERNAL);
+        }
+    };
+
+    const auto randomTimeout = [&]() -> system_tick_t {
+        switch (rand() % 4) {
+        case 0:
+            return rand() % 100;
+        case 1:
+            return 20000;
+        case 2:
+            return rand() % 100000;
+        default:
+            return rand() % 50000000; // Beyond the range of the wheel
+        }
+    };
+
+    for (int i = 0; i < HANDLER_COUNT; ++i) {
+        addHandler(randomTimeout());
+    }
+    CHECK(m.size() == (int)model.entries.size());
+    CHECK(m.size() > HANDLER_COUNT / 2); // Some keys are used more than once
+
+    for (int i = 0; i < OP_COUNT; ++i) {
+        const int op = rand() % 4;
+        if (op == 0) {
+            addHandler(randomTimeout());
+        } else if (op == 1) {
+            // Take a handler
+            const int key = rand() % KEY_COUNT;
+            const auto it = model.entries.find(key);
+            REQUIRE(m.hasHandler(key) == (it != model.entries.end()));
+            CompletionHandler h = m.takeHandler(key);
+            REQUIRE((bool)h == (it != model.entries.end()));
+            if (h) {
+                h.setResult();
+                REQUIRE(results[it->second.result].count == 1);
+                REQUIRE(results[it->second.result].error == SYSTEM_ERROR_NONE);
+                model.remove(it);
+            }
+        } else {
+            // Advance the time
+            const system_tick_t ticks = (op == 2) ? rand() % 500 : rand() % 200000;
+            model.now += ticks;
+            std::vector<int> expired;
+            for (auto it = model.entries.begin(); it != model.entries.end();) {
+                const auto next = std::next(it);
+                if (it->second.expires <= model.now) {
+                    expired.push_back(it->second.result);
+                    model.remove(it);
+                }
+                it = next;
+            }
+            REQUIRE(m.update(ticks) == (int)expired.size());
+            for (int r: expired) {
+                REQUIRE(results[r].count == 1);
+                REQUIRE(results[r].error == SYSTEM_ERROR_TIMEOUT);
+            }
+        }
+        REQUIRE(m.size() == (int)model.entries.size());
+        REQUIRE(m.nearestTimeout() == model.nearestTimeout());
+    }
+
+    const auto remaining = model.entries;
+    m.clear();
+    CHECK(m.isEmpty());
+    for (const auto& e: remaining) {
+        CHECK(results[e.second.result].error == SYSTEM_ERROR_ABORTED);
+    }
+    for (int i = 0; i < resultCount; ++i) {
+        CHECK(results[i].count == 1);
+    }
 }
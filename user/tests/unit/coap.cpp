@@ -0,0 +1,70 @@
+#include "coap.h"
+#include "appender.h"
+
+#include "tools/catch.h"
+
+#include <string>
+
+using namespace particle;
+using namespace particle::protocol;
+
+TEST_CASE("CoAP") {
+    SECTION("find_option() finds an option in a message") {
+        // ACK 2.05, 1-byte token, Uri-Path "d", Uri-Path "\x02", Block2 (num=2, szx=5), payload
+        const uint8_t msg[] = { 0x41, 0x01, 0x12, 0x34, 0xaa, 0xb1, 'd', 0x01, 0x02, 0xc1, 0x25, 0xff, 'x' };
+        const uint8_t* val = nullptr;
+        size_t len = 0;
+        REQUIRE(CoAP::find_option(msg, sizeof(msg), CoAPOption::BLOCK2, &val, &len));
+        REQUIRE(len == 1);
+        const CoAPBlock block = CoAP::decode_block(val, len);
+        CHECK(block.num == 2);
+        CHECK(!block.more);
+        CHECK(block.szx == 5);
+        CHECK(block.size() == 512);
+        REQUIRE(CoAP::find_option(msg, sizeof(msg), CoAPOption::URI_PATH, &val, &len));
+        CHECK(std::string((const char*)val, len) == "d");
+        CHECK(!CoAP::find_option(msg, sizeof(msg), CoAPOption::SIZE2, &val, &len));
+        // Truncated option
+        CHECK(!CoAP::find_option(msg, 9, CoAPOption::BLOCK2, &val, &len));
+    }
+
+    SECTION("block_option() encodes a Block2 option") {
+        uint8_t buf[16] = {};
+        const CoAPBlock block = { 300, true, 6 };
+        const size_t n = CoAP::block_option(buf, CoAPOption::NONE, block);
+        REQUIRE(n == 4); // Extended option delta, 2 bytes of value
+        CHECK(buf[0] == 0xd2);
+        CHECK(buf[1] == CoAPOption::BLOCK2 - 13);
+        const CoAPBlock b = CoAP::decode_block(buf + 2, 2);
+        CHECK(b.num == 300);
+        CHECK(b.more);
+        CHECK(b.szx == 6);
+        // Zero is encoded as an empty value
+        CHECK(CoAP::uint_option(buf, CoAPOption::BLOCK2, CoAPOption::SIZE2, 0) == 1);
+        CHECK(buf[0] == 0x50);
+    }
+}
+
+TEST_CASE("WindowAppender") {
+    const std::string data = "0123456789abcdefghij";
+    char buf[8] = {};
+
+    SECTION("stores a window of the appended data") {
+        WindowAppender a(buf, sizeof(buf), 5);
+        for (size_t i = 0; i < data.size(); i += 3) {
+            a.append((const uint8_t*)data.data() + i, std::min((size_t)3, data.size() - i));
+        }
+        CHECK(a.dataSize() == data.size());
+        CHECK(a.windowSize() == sizeof(buf));
+        CHECK(a.hasMore());
+        CHECK(std::string(buf, a.windowSize()) == data.substr(5, sizeof(buf)));
+    }
+
+    SECTION("handles the last window") {
+        WindowAppender a(buf, sizeof(buf), 16);
+        a.append(data.c_str());
+        CHECK(a.windowSize() == 4);
+        CHECK(!a.hasMore());
+        CHECK(std::string(buf, a.windowSize()) == data.substr(16));
+    }
+}
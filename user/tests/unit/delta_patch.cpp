@@ -0,0 +1,275 @@
+#include "delta_patch.h"
+
+#include "system_error.h"
+
+#include "tools/catch.h"
+
+#include <boost/crc.hpp>
+
+#include <string>
+#include <random>
+#include <algorithm>
+
+namespace {
+
+using namespace particle;
+
+// Collects the target image
+class TestHandler: public DeltaPatchHandler {
+public:
+    explicit TestHandler(const std::string& source) :
+            source_(source),
+            sourceCalled_(false) {
+    }
+
+    int source(const DeltaPatchHeader& header, const char** data) override {
+        sourceCalled_ = true;
+        header_ = header;
+        *data = source_.data();
+        return 0;
+    }
+
+    int write(const char* data, size_t size) override {
+        target_.append(data, size);
+        return 0;
+    }
+
+    const std::string& target() const {
+        return target_;
+    }
+
+    const DeltaPatchHeader& header() const {
+        return header_;
+    }
+
+    bool sourceCalled() const {
+        return sourceCalled_;
+    }
+
+private:
+    std::string source_;
+    std::string target_;
+    DeltaPatchHeader header_;
+    bool sourceCalled_;
+};
+
+// Helper class for creating patches
+class PatchBuilder {
+public:
+    PatchBuilder(const std::string& source, const std::string& target) {
+        appendUint32(DELTA_PATCH_MAGIC);
+        data_ += (char)DELTA_PATCH_VERSION;
+        data_ += (char)4; // Module function
+        data_ += (char)1; // Module index
+        data_ += (char)0; // Reserved
+        appendUint32(source.size());
+        appendUint32(crc32(source));
+        appendUint32(target.size());
+        appendUint32(crc32(target));
+    }
+
+    PatchBuilder& copy(uint32_t offs, uint32_t size) {
+        data_ += (char)0x01;
+        appendUint32(offs);
+        appendUint32(size);
+        return *this;
+    }
+
+    PatchBuilder& add(uint32_t offs, const std::string& diff) {
+        data_ += (char)0x02;
+        appendUint32(offs);
+        appendUint32(diff.size());
+        data_ += diff;
+        return *this;
+    }
+
+    PatchBuilder& insert(const std::string& data) {
+        data_ += (char)0x03;
+        appendUint32(data.size());
+        data_ += data;
+        return *this;
+    }
+
+    PatchBuilder& end() {
+        data_ += (char)0x00;
+        return *this;
+    }
+
+    std::string& data() {
+        return data_;
+    }
+
+    static uint32_t crc32(const std::string& data) {
+        boost::crc_32_type crc;
+        crc.process_bytes(data.data(), data.size());
+        return crc.checksum();
+    }
+
+private:
+    std::string data_;
+
+    void appendUint32(uint32_t val) {
+        for (int i = 0; i < 4; ++i) {
+            data_ += (char)(val >> (i * 8));
+        }
+    }
+};
+
+std::string randomString(std::mt19937& gen, size_t size) {
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::string s;
+    s.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        s += (char)dist(gen);
+    }
+    return s;
+}
+
+// Feeds the patch to the decoder in portions of random size
+int applyPatch(DeltaPatcher* patcher, const std::string& patch, std::mt19937& gen) {
+    std::uniform_int_distribution<size_t> dist(1, 100);
+    size_t offs = 0;
+    while (offs < patch.size()) {
+        const size_t n = std::min(dist(gen), patch.size() - offs);
+        const int ret = patcher->process(patch.data() + offs, n);
+        if (ret < 0) {
+            return ret;
+        }
+        offs += n;
+    }
+    return patcher->finish();
+}
+
+} // namespace
+
+TEST_CASE("DeltaPatcher") {
+    std::mt19937 gen(12345);
+    const std::string source = randomString(gen, 10000);
+
+    SECTION("calcCrc32() computes CRC-32 compatible with zlib") {
+        const std::string s = "123456789";
+        CHECK(DeltaPatcher::calcCrc32(0, s.data(), s.size()) == 0xcbf43926);
+        // Incremental computation
+        const uint32_t crc = DeltaPatcher::calcCrc32(0, s.data(), 4);
+        CHECK(DeltaPatcher::calcCrc32(crc, s.data() + 4, s.size() - 4) == 0xcbf43926);
+        CHECK(DeltaPatcher::calcCrc32(0, source.data(), source.size()) == PatchBuilder::crc32(source));
+    }
+
+    SECTION("reconstructs the target image") {
+        // Target image: a moved block of the source with a few modified bytes, some new data and
+        // a copied block
+        std::string target = source.substr(100, 3000);
+        std::string diff(3000, '\0');
+        for (size_t i = 0; i < diff.size(); i += 97) {
+            target[i] += 3;
+            diff[i] = 3;
+        }
+        const std::string inserted = randomString(gen, 500);
+        target += inserted;
+        target += source.substr(5000, 5000);
+        PatchBuilder patch(source, target);
+        patch.add(100, diff).insert(inserted).copy(5000, 5000).end();
+        TestHandler handler(source);
+        DeltaPatcher patcher(&handler);
+        REQUIRE(applyPatch(&patcher, patch.data(), gen) == 0);
+        CHECK(handler.sourceCalled());
+        CHECK(handler.header().moduleFunction == 4);
+        CHECK(handler.header().moduleIndex == 1);
+        CHECK(handler.header().sourceSize == source.size());
+        CHECK(handler.header().targetSize == target.size());
+        CHECK(patcher.targetSize() == target.size());
+        CHECK(handler.target() == target);
+    }
+
+    SECTION("can be reused after reset()") {
+        const std::string target = source.substr(0, 1000);
+        PatchBuilder patch(source, target);
+        patch.copy(0, 1000).end();
+        TestHandler handler(source);
+        DeltaPatcher patcher(&handler);
+        const std::string garbage(30, 'x');
+        REQUIRE(patcher.process(garbage.data(), garbage.size()) < 0);
+        patcher.reset();
+        REQUIRE(applyPatch(&patcher, patch.data(), gen) == 0);
+        CHECK(handler.target() == target);
+    }
+
+    SECTION("rejects a patch created for a different source image") {
+        std::string other = source;
+        other[5000] ^= 0x01;
+        PatchBuilder patch(other, other);
+        patch.copy(0, other.size()).end();
+        TestHandler handler(source);
+        DeltaPatcher patcher(&handler);
+        CHECK(applyPatch(&patcher, patch.data(), gen) == SYSTEM_ERROR_NOT_FOUND);
+        CHECK(handler.target().empty());
+    }
+
+    SECTION("rejects an invalid header") {
+        PatchBuilder patch(source, source);
+        patch.copy(0, source.size()).end();
+        patch.data()[0] ^= 0xff;
+        TestHandler handler(source);
+        DeltaPatcher patcher(&handler);
+        CHECK(applyPatch(&patcher, patch.data(), gen) == SYSTEM_ERROR_BAD_DATA);
+        CHECK(!handler.sourceCalled());
+    }
+
+    SECTION("rejects a source range that is out of bounds") {
+        PatchBuilder patch(source, source);
+        patch.copy(1, source.size()).end();
+        TestHandler handler(source);
+        DeltaPatcher patcher(&handler);
+        CHECK(applyPatch(&patcher, patch.data(), gen) == SYSTEM_ERROR_OUT_OF_RANGE);
+        // Overflowing offset
+        PatchBuilder patch2(source, source);
+        patch2.add(0xffffff00, std::string(0x200, '\0')).end();
+        patcher.reset();
+        CHECK(applyPatch(&patcher, patch2.data(), gen) == SYSTEM_ERROR_OUT_OF_RANGE);
+    }
+
+    SECTION("rejects a target image that is larger than specified in the header") {
+        const std::string target = source.substr(0, 100);
+        PatchBuilder patch(source, target);
+        patch.copy(0, 100).insert("x").end();
+        TestHandler handler(source);
+        DeltaPatcher patcher(&handler);
+        CHECK(applyPatch(&patcher, patch.data(), gen) == SYSTEM_ERROR_OUT_OF_RANGE);
+    }
+
+    SECTION("rejects a target image with a wrong CRC") {
+        std::string target = source.substr(0, 100);
+        PatchBuilder patch(source, target);
+        patch.copy(0, 99).insert("x").end();
+        TestHandler handler(source);
+        DeltaPatcher patcher(&handler);
+        CHECK(applyPatch(&patcher, patch.data(), gen) == SYSTEM_ERROR_BAD_DATA);
+    }
+
+    SECTION("rejects an incomplete patch") {
+        PatchBuilder patch(source, source);
+        patch.copy(0, source.size());
+        TestHandler handler(source);
+        DeltaPatcher patcher(&handler);
+        CHECK(applyPatch(&patcher, patch.data(), gen) == SYSTEM_ERROR_BAD_DATA);
+    }
+
+    SECTION("rejects data after the end of the patch") {
+        PatchBuilder patch(source, source);
+        patch.copy(0, source.size()).end().end();
+        TestHandler handler(source);
+        DeltaPatcher patcher(&handler);
+        CHECK(applyPatch(&patcher, patch.data(), gen) == SYSTEM_ERROR_BAD_DATA);
+    }
+
+    SECTION("rejects an unknown command") {
+        PatchBuilder patch(source, source);
+        patch.data() += (char)0x7f;
+        TestHandler handler(source);
+        DeltaPatcher patcher(&handler);
+        CHECK(applyPatch(&patcher, patch.data(), gen) == SYSTEM_ERROR_BAD_DATA);
+        // Errors are sticky
+        CHECK(patcher.process("\0", 1) == SYSTEM_ERROR_BAD_DATA);
+        CHECK(patcher.finish() == SYSTEM_ERROR_BAD_DATA);
+    }
+}
@@ -4,6 +4,7 @@
 
 #include <functional>
 #include <unordered_set>
+#include <vector>
 #include <cassert>
 
 namespace {
@@ -404,6 +405,95 @@ void testPersistentEnumDiagnosticData(DiagService& diag) {
     }
 }
 
+// Decodes a batch of samples produced by the diagnostics sampler
+struct SampleBatch {
+    std::vector<uint16_t> ids;
+    uint32_t period = 0;
+    uint32_t overwritten = 0;
+    std::vector<uint32_t> times;
+    std::vector<std::vector<int32_t>> values; // Values of each source
+
+    static SampleBatch decode(const char* data, size_t size) {
+        size_t pos = 0;
+        const auto varint = [&]() {
+            uint64_t v = 0;
+            unsigned shift = 0;
+            uint8_t b = 0;
+            do {
+                REQUIRE(pos < size);
+                b = data[pos++];
+                v |= (uint64_t)(b & 0x7f) << shift;
+                shift += 7;
+            } while (b & 0x80);
+            return v;
+        };
+        const auto zigzag = [&]() {
+            const uint64_t v = varint();
+            return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+        };
+        SampleBatch b;
+        REQUIRE(varint() == 1); // Format version
+        const size_t srcCount = varint();
+        for (size_t i = 0; i < srcCount; ++i) {
+            b.ids.push_back(varint());
+        }
+        const size_t sampleCount = varint();
+        b.period = varint();
+        b.overwritten = varint();
+        if (sampleCount > 0) {
+            b.times.push_back(varint());
+            for (size_t i = 1; i < sampleCount; ++i) {
+                b.times.push_back(b.times.back() + b.period + zigzag());
+            }
+            for (size_t i = 0; i < srcCount; ++i) {
+                std::vector<int32_t> vals;
+                int64_t v = 0;
+                for (size_t j = 0; j < sampleCount; ++j) {
+                    v += zigzag();
+                    vals.push_back(v);
+                }
+                b.values.push_back(vals);
+            }
+        }
+        CHECK(pos == size);
+        return b;
+    }
+};
+
+int configSampler(const std::vector<uint16_t>& ids, uint32_t period, size_t bufSize) {
+    diag_sampler_config d = {};
+    d.size = sizeof(d);
+    d.source_count = ids.size();
+    d.source_ids = ids.data();
+    d.period = period;
+    d.buffer_size = bufSize;
+    return diag_command(DIAG_SERVICE_CMD_SAMPLER_CONFIG, &d, nullptr);
+}
+
+int updateSampler(uint32_t time) {
+    diag_sampler_update d = {};
+    d.size = sizeof(d);
+    d.time = time;
+    return diag_command(DIAG_SERVICE_CMD_SAMPLER_UPDATE, &d, nullptr);
+}
+
+SampleBatch encodeSamples(size_t bufSize = 1024) {
+    std::vector<char> buf(bufSize);
+    diag_sampler_encode d = {};
+    d.size = sizeof(d);
+    d.buffer = buf.data();
+    d.buffer_size = buf.size();
+    REQUIRE(diag_command(DIAG_SERVICE_CMD_SAMPLER_ENCODE, &d, nullptr) == 0);
+    REQUIRE(d.data_size <= bufSize);
+    const auto b = SampleBatch::decode(buf.data(), d.data_size);
+    CHECK(b.times.size() == d.sample_count);
+    return b;
+}
+
+int commitSamples() {
+    return diag_command(DIAG_SERVICE_CMD_SAMPLER_COMMIT, nullptr, nullptr);
+}
+
 } // namespace
 
 TEST_CASE("Service API") {
@@ -529,6 +619,131 @@ TEST_CASE("Service API") {
             CHECK(diag_command(DIAG_SERVICE_CMD_START, nullptr, nullptr) == 0);
         }
     }
+
+    SECTION("sampler") {
+        int32_t v1 = 0, v2 = 0;
+        bool fail = false;
+        auto d1 = DiagSource(1).get([&](GetData d) {
+            return fail ? SYSTEM_ERROR_UNKNOWN : d.setInt(v1);
+        }).add();
+        auto d2 = DiagSource(2).get([&](GetData d) {
+            return d.setInt(v2);
+        }).add();
+        diag.start();
+
+        SECTION("records samples at the configured period") {
+            REQUIRE(configSampler({ 1, 2 }, 1000, 1024) == 0);
+            CHECK(updateSampler(5000) == 1);
+            v1 = 10; v2 = -3;
+            CHECK(updateSampler(5500) == 0);
+            CHECK(updateSampler(6001) == 1);
+            v1 = 7;
+            CHECK(updateSampler(7000) == 1);
+            const auto b = encodeSamples();
+            CHECK(b.ids == std::vector<uint16_t>({ 1, 2 }));
+            CHECK(b.period == 1000);
+            CHECK(b.overwritten == 0);
+            CHECK(b.times == std::vector<uint32_t>({ 5000, 6001, 7000 }));
+            CHECK(b.values[0] == std::vector<int32_t>({ 0, 10, 7 }));
+            CHECK(b.values[1] == std::vector<int32_t>({ 0, -3, -3 }));
+            // Encoded samples are kept until the batch is committed
+            CHECK(encodeSamples().times == b.times);
+            REQUIRE(commitSamples() == 0);
+            CHECK(encodeSamples().times.empty());
+        }
+
+        SECTION("samples recorded after encoding are not committed") {
+            REQUIRE(configSampler({ 1 }, 1, 1024) == 0);
+            REQUIRE(updateSampler(0) == 1);
+            REQUIRE(updateSampler(1) == 1);
+            REQUIRE(encodeSamples().times.size() == 2);
+            REQUIRE(updateSampler(2) == 1);
+            REQUIRE(commitSamples() == 0);
+            CHECK(encodeSamples().times == std::vector<uint32_t>({ 2 }));
+        }
+
+        SECTION("encoded samples overwritten before the commit are not removed twice") {
+            REQUIRE(configSampler({ 1 }, 1, 2 * sizeof(int32_t) * 4) == 0);
+            for (int i = 0; i < 4; ++i) {
+                REQUIRE(updateSampler(i) == 1);
+            }
+            REQUIRE(encodeSamples().times.size() == 4);
+            REQUIRE(updateSampler(4) == 1);
+            REQUIRE(updateSampler(5) == 1);
+            REQUIRE(commitSamples() == 0);
+            const auto b = encodeSamples();
+            CHECK(b.times == std::vector<uint32_t>({ 4, 5 }));
+            CHECK(b.overwritten == 0);
+        }
+
+        SECTION("delta encoding keeps slowly changing values compact") {
+            REQUIRE(configSampler({ 1 }, 100, 4096) == 0);
+            v1 = 1000000;
+            for (int i = 0; i < 100; ++i) {
+                v1 += (i % 2) ? 1 : -1;
+                REQUIRE(updateSampler(i * 100) == 1);
+            }
+            std::vector<char> buf(1024);
+            diag_sampler_encode d = {};
+            d.size = sizeof(d);
+            d.buffer = buf.data();
+            d.buffer_size = buf.size();
+            REQUIRE(diag_command(DIAG_SERVICE_CMD_SAMPLER_ENCODE, &d, nullptr) == 0);
+            CHECK(d.sample_count == 100);
+            // Header and first value, followed by a byte per timestamp and value
+            CHECK(d.data_size < 20 + 2 * 100);
+        }
+
+        SECTION("overwrites the oldest samples when the buffer is full") {
+            // Each sample takes 3 words
+            REQUIRE(configSampler({ 1, 2 }, 1, 3 * sizeof(int32_t) * 4) == 0);
+            for (int i = 0; i < 6; ++i) {
+                v1 = i;
+                REQUIRE(updateSampler(i) == 1);
+            }
+            const auto b = encodeSamples();
+            CHECK(b.overwritten == 2);
+            CHECK(b.values[0] == std::vector<int32_t>({ 2, 3, 4, 5 }));
+        }
+
+        SECTION("encodes as many samples as fit in the buffer") {
+            REQUIRE(configSampler({ 1 }, 1, 1024) == 0);
+            for (int i = 0; i < 50; ++i) {
+                v1 = i * 1000;
+                REQUIRE(updateSampler(i) == 1);
+            }
+            auto b = encodeSamples(32);
+            REQUIRE(!b.times.empty());
+            CHECK(b.times.size() < 50);
+            const size_t n = b.times.size();
+            CHECK(b.values[0].back() == (int32_t)(n - 1) * 1000);
+            REQUIRE(commitSamples() == 0);
+            b = encodeSamples();
+            CHECK(b.times.size() == 50 - n);
+            CHECK(b.values[0].front() == (int32_t)n * 1000);
+        }
+
+        SECTION("repeats the previous value if a source cannot be read") {
+            REQUIRE(configSampler({ 1 }, 1, 1024) == 0);
+            v1 = 5;
+            REQUIRE(updateSampler(0) == 1);
+            fail = true;
+            v1 = 6;
+            REQUIRE(updateSampler(1) == 1);
+            CHECK(encodeSamples().values[0] == std::vector<int32_t>({ 5, 5 }));
+        }
+
+        SECTION("does nothing if not configured") {
+            CHECK(updateSampler(0) == 0);
+            REQUIRE(configSampler({ 1 }, 1, 1024) == 0);
+            REQUIRE(configSampler({}, 0, 0) == 0);
+            CHECK(updateSampler(0) == 0);
+        }
+
+        SECTION("fails to allocate a buffer smaller than a single sample") {
+            CHECK(configSampler({ 1, 2 }, 1, 8) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        }
+    }
 }
 
 TEST_CASE("Wiring API") {
@@ -624,4 +839,48 @@ TEST_CASE("Wiring API") {
         testPersistentEnumDiagnosticData<PersistentEnumDiagnosticData, NoConcurrency>(diag);
         // testPersistentEnumDiagnosticData<PersistentEnumDiagnosticData, AtomicConcurrency>(diag);
     }
+
+    SECTION("StatsDiagnosticData") {
+        StatsDiagnosticData<> d(1);
+        diag.start();
+        diag_stats s = {};
+        size_t size = sizeof(s);
+        CHECK(AbstractDiagnosticData::get(1, &s, size) == 0);
+        CHECK(size == sizeof(s));
+        CHECK(s.count == 0);
+        d.record(10);
+        d.record(-2);
+        d.record(4);
+        CHECK(AbstractDiagnosticData::get(1, &s, size) == 0);
+        CHECK(s.min == -2);
+        CHECK(s.max == 10);
+        CHECK(s.avg == 4);
+        CHECK(s.count == 3);
+        d.reset();
+        CHECK(d.stats().count == 0);
+    }
+
+    SECTION("HistogramDiagnosticData") {
+        HistogramDiagnosticData<4> d(1, 0 /* bucketMin */, 10 /* bucketWidth */);
+        diag.start();
+        d.record(-5); // Counted in the first bucket
+        d.record(0);
+        d.record(15);
+        d.record(39);
+        d.record(1000); // Counted in the last bucket
+        size_t size = 0;
+        CHECK(AbstractDiagnosticData::get(1, nullptr, size) == 0);
+        REQUIRE(size == sizeof(diag_histogram) + 4 * sizeof(uint32_t));
+        std::vector<char> buf(size);
+        CHECK(AbstractDiagnosticData::get(1, buf.data(), size) == 0);
+        const auto h = (const diag_histogram*)buf.data();
+        CHECK(h->bucket_min == 0);
+        CHECK(h->bucket_width == 10);
+        CHECK(h->bucket_count == 4);
+        const auto counts = (const uint32_t*)(h + 1);
+        CHECK(counts[0] == 2);
+        CHECK(counts[1] == 1);
+        CHECK(counts[2] == 0);
+        CHECK(counts[3] == 2);
+    }
 }
@@ -0,0 +1,468 @@
+#include "spark_wiring_dsp.h"
+
+#include "tools/catch.h"
+
+#include <vector>
+#include <complex>
+#include <random>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+using namespace particle::dsp;
+
+template<typename T>
+double toDouble(T v) {
+    return (double)v / ((sizeof(T) == sizeof(q15_t)) ? 32768.0 : 2147483648.0);
+}
+
+template<typename T>
+T fromDouble(double v);
+
+template<>
+q15_t fromDouble<q15_t>(double v) {
+    return saturateQ15((int32_t)std::lround(v * 32768.0));
+}
+
+template<>
+q31_t fromDouble<q31_t>(double v) {
+    return saturateQ31(std::llround(v * 2147483648.0));
+}
+
+// Random samples in the range [-amplitude, amplitude)
+template<typename T>
+std::vector<T> randomSamples(size_t n, double amplitude, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-amplitude, amplitude);
+    std::vector<T> v(n);
+    for (auto& x: v) {
+        x = fromDouble<T>(dist(gen));
+    }
+    return v;
+}
+
+// Random FIR coefficients with the sum of absolute values below 1
+template<typename T>
+std::vector<T> randomCoeffs(size_t taps, unsigned seed) {
+    return randomSamples<T>(taps, 0.99 / taps, seed);
+}
+
+// Largest difference between a fixed-point result and a reference, in least significant bits of Q15
+template<typename T>
+double maxError(const std::vector<T>& v, const std::vector<double>& ref) {
+    double err = 0;
+    for (size_t i = 0; i < v.size(); ++i) {
+        err = std::max(err, std::abs(toDouble(v[i]) - ref[i]) * 32768.0);
+    }
+    return err;
+}
+
+template<typename T>
+std::vector<double> firReference(const std::vector<T>& x, const std::vector<T>& h) {
+    std::vector<double> y(x.size());
+    for (size_t n = 0; n < x.size(); ++n) {
+        double acc = 0;
+        for (size_t k = 0; k < h.size() && k <= n; ++k) {
+            acc += toDouble(h[k]) * toDouble(x[n - k]);
+        }
+        y[n] = acc;
+    }
+    return y;
+}
+
+// DFT divided by the size
+std::vector<std::complex<double>> dftReference(const std::vector<std::complex<double>>& x, bool inverse) {
+    const size_t n = x.size();
+    const double sign = inverse ? 1 : -1;
+    std::vector<std::complex<double>> y(n);
+    for (size_t k = 0; k < n; ++k) {
+        std::complex<double> acc;
+        for (size_t i = 0; i < n; ++i) {
+            acc += x[i] * std::polar(1.0, sign * 2 * M_PI * ((k * i) % n) / n);
+        }
+        y[k] = acc / (double)n;
+    }
+    return y;
+}
+
+template<typename T>
+std::vector<std::complex<double>> toComplex(const std::vector<T>& v) {
+    std::vector<std::complex<double>> c(v.size() / 2);
+    for (size_t i = 0; i < c.size(); ++i) {
+        c[i] = std::complex<double>(toDouble(v[2 * i]), toDouble(v[2 * i + 1]));
+    }
+    return c;
+}
+
+template<typename T>
+double maxError(const std::vector<T>& v, const std::vector<std::complex<double>>& ref) {
+    double err = 0;
+    const auto c = toComplex(v);
+    for (size_t i = 0; i < c.size(); ++i) {
+        err = std::max(err, std::abs(c[i] - ref[i]) * 32768.0);
+    }
+    return err;
+}
+
+// Random complex samples with the magnitude below 1
+template<typename T>
+std::vector<T> randomComplexSamples(size_t n, unsigned seed) {
+    return randomSamples<T>(n * 2, 0.7, seed);
+}
+
+template<typename T>
+void checkFir() {
+    const auto x = randomSamples<T>(1000, 1.0, 1);
+    const auto h = randomCoeffs<T>(31, 2);
+    const auto ref = firReference(x, h);
+
+    SECTION("output matches the reference") {
+        std::vector<T> state(FirFilter<T>::stateSize(h.size(), 64));
+        FirFilter<T> fir(h.data(), h.size(), state.data(), 64);
+        std::vector<T> y(x.size());
+        fir.process(x.data(), y.data(), x.size());
+        CHECK(maxError(y, ref) <= 1.0);
+    }
+
+    SECTION("output doesn't depend on the block size") {
+        std::vector<T> y1(x.size());
+        std::vector<T> state1(FirFilter<T>::stateSize(h.size(), x.size()));
+        FirFilter<T> fir1(h.data(), h.size(), state1.data(), x.size());
+        fir1.process(x.data(), y1.data(), x.size());
+        for (size_t blockSize: { 1, 2, 7, 31, 32, 100 }) {
+            std::vector<T> y2(x.size());
+            std::vector<T> state2(FirFilter<T>::stateSize(h.size(), 16));
+            FirFilter<T> fir2(h.data(), h.size(), state2.data(), 16);
+            for (size_t i = 0; i < x.size(); i += blockSize) {
+                const size_t n = std::min(blockSize, x.size() - i);
+                fir2.process(x.data() + i, y2.data() + i, n);
+            }
+            CHECK(y1 == y2);
+        }
+    }
+
+    SECTION("filter with an even number of coefficients") {
+        const auto h2 = randomCoeffs<T>(16, 3);
+        std::vector<T> state(FirFilter<T>::stateSize(h2.size(), 100));
+        FirFilter<T> fir(h2.data(), h2.size(), state.data(), 100);
+        std::vector<T> y(x.size());
+        fir.process(x.data(), y.data(), x.size());
+        CHECK(maxError(y, firReference(x, h2)) <= 1.0);
+    }
+
+    SECTION("decimator keeps every n-th output sample") {
+        const size_t factor = 3;
+        std::vector<T> state(FirDecimator<T>::stateSize(h.size(), 50));
+        FirDecimator<T> dec(h.data(), h.size(), factor, state.data(), 50);
+        std::vector<T> y;
+        for (size_t i = 0; i < x.size(); i += 77) {
+            const size_t n = std::min<size_t>(77, x.size() - i);
+            std::vector<T> out((n + factor - 1) / factor);
+            const size_t count = dec.process(x.data() + i, out.data(), n);
+            CHECK(count <= out.size());
+            y.insert(y.end(), out.begin(), out.begin() + count);
+        }
+        REQUIRE(y.size() == (x.size() + factor - 1) / factor);
+        std::vector<double> decRef;
+        for (size_t i = 0; i < ref.size(); i += factor) {
+            decRef.push_back(ref[i]);
+        }
+        CHECK(maxError(y, decRef) <= 1.0);
+    }
+}
+
+template<typename T>
+void checkBiquad() {
+    // 2nd order Butterworth low-pass filters with the cutoff at 0.1 and 0.2 of the sample rate
+    const double c[2][5] = {
+        { 0.0674552738890719, 0.1349105477781438, 0.0674552738890719, -1.1429805025399011, 0.4128015980961886 },
+        { 0.2065720838261707, 0.4131441676523414, 0.2065720838261707, -0.3695273773512413, 0.1958157126558242 }
+    };
+    std::vector<T> coeffs;
+    std::vector<double> qc; // Quantized coefficients
+    for (size_t s = 0; s < 2; ++s) {
+        for (size_t i = 0; i < 5; ++i) {
+            const T v = fromDouble<T>(c[s][i] / 2); // Post-shift of 1
+            coeffs.push_back(v);
+            qc.push_back(toDouble(v) * 2);
+        }
+    }
+    const auto x = randomSamples<T>(1000, 0.5, 4);
+    // Reference output
+    std::vector<double> ref(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        ref[i] = toDouble(x[i]);
+    }
+    for (size_t s = 0; s < 2; ++s) {
+        const double* k = &qc[s * 5];
+        double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+        for (auto& v: ref) {
+            const double y = k[0] * v + k[1] * x1 + k[2] * x2 - k[3] * y1 - k[4] * y2;
+            x2 = x1;
+            x1 = v;
+            y2 = y1;
+            y1 = y;
+            v = y;
+        }
+    }
+
+    std::vector<T> state(2 * BiquadCascade<T>::STATE_PER_STAGE);
+    BiquadCascade<T> iir(coeffs.data(), 2, state.data());
+    std::vector<T> y(x.size());
+    // In-place processing in blocks of different sizes
+    y = x;
+    size_t offs = 0;
+    for (size_t n: { 1, 10, 100, 889 }) {
+        iir.process(y.data() + offs, y.data() + offs, n);
+        offs += n;
+    }
+    REQUIRE(offs == x.size());
+    // Truncation errors are amplified by the feedback of each stage
+    CHECK(maxError(y, ref) <= 8.0);
+
+    // Processing after a reset produces the same output
+    iir.reset();
+    std::vector<T> y2(x.size());
+    iir.process(x.data(), y2.data(), x.size());
+    CHECK(y == y2);
+}
+
+template<typename T>
+void checkFft() {
+    for (size_t size: { 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 }) {
+        const auto x = randomComplexSamples<T>(size, size);
+        const auto ref = dftReference(toComplex(x), false);
+        auto y = x;
+        REQUIRE(fft(y.data(), size));
+        // Each radix-2 step truncates the output by up to one LSB
+        const double tolerance = std::log2(size) + 1;
+        CHECK(maxError(y, ref) <= tolerance);
+        const auto iref = dftReference(toComplex(x), true);
+        y = x;
+        REQUIRE(ifft(y.data(), size));
+        CHECK(maxError(y, iref) <= tolerance);
+    }
+}
+
+} // namespace
+
+TEST_CASE("DSP helpers") {
+    SECTION("saturation") {
+        CHECK(saturateQ15(40000) == Q15_MAX);
+        CHECK(saturateQ15(-40000) == Q15_MIN);
+        CHECK(saturateQ15(123) == 123);
+        CHECK(saturateQ31(INT64_C(1) << 40) == Q31_MAX);
+        CHECK(saturateQ31(-(INT64_C(1) << 40)) == Q31_MIN);
+        CHECK(mulQ15(Q15_MIN, Q15_MIN) == Q15_MAX);
+        CHECK(mulQ15(16384, 16384) == 8192);
+        CHECK(mulQ31(1 << 30, 1 << 30) == (1 << 29));
+        CHECK(floatToQ15(0.5f) == 16384);
+        CHECK(floatToQ15(1.0f) == Q15_MAX);
+        CHECK(floatToQ31(-1.0) == Q31_MIN);
+    }
+
+    SECTION("conversion of ADC readings") {
+        const std::vector<uint16_t> in = { 0, 2048, 4095, 1024 };
+        std::vector<q15_t> out(in.size());
+        adcToQ15(in.data(), out.data(), in.size());
+        CHECK((out == std::vector<q15_t>{ -32768, 0, 32752, -16384 }));
+        std::vector<uint16_t> in2 = { 0, 512, 1023 };
+        adcToQ15(in2.data(), (q15_t*)in2.data(), in2.size(), 10);
+        CHECK((q15_t)in2[0] == -32768);
+        CHECK((q15_t)in2[1] == 0);
+        CHECK((q15_t)in2[2] == 32704);
+    }
+
+    SECTION("mean and RMS") {
+        const auto x = randomSamples<q15_t>(1001, 1.0, 5);
+        double sum = 0, sumSq = 0;
+        for (auto v: x) {
+            sum += toDouble(v);
+            sumSq += toDouble(v) * toDouble(v);
+        }
+        CHECK(std::abs(toDouble(mean(x.data(), x.size())) - sum / x.size()) <= 1.0 / 32768);
+        CHECK(std::abs(toDouble(rms(x.data(), x.size())) - std::sqrt(sumSq / x.size())) <= 1.0 / 32768);
+        const auto x31 = randomSamples<q31_t>(1001, 1.0, 5);
+        sum = 0;
+        sumSq = 0;
+        for (auto v: x31) {
+            sum += toDouble(v);
+            sumSq += toDouble(v) * toDouble(v);
+        }
+        CHECK(std::abs(toDouble(mean(x31.data(), x31.size())) - sum / x31.size()) < 1e-9);
+        CHECK(std::abs(toDouble(rms(x31.data(), x31.size())) - std::sqrt(sumSq / x31.size())) < 1e-9);
+        CHECK(mean((const q15_t*)nullptr, 0) == 0);
+        CHECK(rms((const q15_t*)nullptr, 0) == 0);
+        // Full-scale square wave
+        const std::vector<q15_t> sq = { Q15_MIN, Q15_MIN, Q15_MIN };
+        CHECK(rms(sq.data(), sq.size()) == Q15_MAX);
+    }
+
+    SECTION("magnitude") {
+        const std::vector<q15_t> x = { 16384, 0, 0, -16384, 9830, 13107, Q15_MIN, Q15_MIN };
+        std::vector<q15_t> m(4);
+        magnitude(x.data(), m.data(), 4);
+        CHECK((m == std::vector<q15_t>{ 16384, 16384, 16383, Q15_MAX }));
+        const std::vector<q31_t> x31 = { 1 << 30, 0, 644245094, 858993459 };
+        std::vector<q31_t> m31(2);
+        magnitude(x31.data(), m31.data(), 2);
+        CHECK(m31[0] == (1 << 30));
+        CHECK(std::abs(toDouble(m31[1]) - 0.5) < 1e-9);
+    }
+}
+
+TEST_CASE("FirFilter<q15_t>") {
+    checkFir<q15_t>();
+}
+
+TEST_CASE("FirFilter<q31_t>") {
+    checkFir<q31_t>();
+}
+
+TEST_CASE("BiquadCascade<q15_t>") {
+    checkBiquad<q15_t>();
+}
+
+TEST_CASE("BiquadCascade<q31_t>") {
+    checkBiquad<q31_t>();
+}
+
+TEST_CASE("MovingStatistics") {
+    const auto x = randomSamples<q15_t>(500, 1.0, 6);
+    const size_t size = 64;
+    std::vector<q15_t> window(size);
+    MovingStatistics<q15_t> stats(window.data(), size);
+    CHECK(stats.count() == 0);
+    CHECK(stats.mean() == 0);
+    CHECK(stats.rms() == 0);
+    for (size_t i = 0; i < x.size(); ++i) {
+        stats.add(x[i]);
+        const size_t n = std::min(i + 1, size);
+        REQUIRE(stats.count() == n);
+        if (i % 50 == 0 || i == x.size() - 1) {
+            const auto begin = x.begin() + (i + 1 - n);
+            const std::vector<q15_t> w(begin, begin + n);
+            CHECK(stats.mean() == mean(w.data(), w.size()));
+            CHECK(stats.rms() == rms(w.data(), w.size()));
+            double m = 0, v = 0;
+            for (auto s: w) {
+                m += toDouble(s);
+            }
+            m /= n;
+            for (auto s: w) {
+                v += (toDouble(s) - m) * (toDouble(s) - m);
+            }
+            CHECK(std::abs(toDouble(stats.standardDeviation()) - std::sqrt(v / n)) <= 2.0 / 32768);
+        }
+    }
+    // Adding a block of samples
+    std::vector<q31_t> window31(size);
+    MovingStatistics<q31_t> stats31(window31.data(), size);
+    const auto x31 = randomSamples<q31_t>(100, 0.5, 7);
+    stats31.add(x31.data(), x31.size());
+    CHECK(stats31.count() == size);
+    CHECK(stats31.mean() == mean(x31.data() + 100 - size, size));
+    CHECK(stats31.rms() == rms(x31.data() + 100 - size, size));
+    stats31.reset();
+    CHECK(stats31.count() == 0);
+}
+
+TEST_CASE("FFT") {
+    SECTION("Q15 transform matches the reference") {
+        checkFft<q15_t>();
+    }
+
+    SECTION("Q31 transform matches the reference") {
+        checkFft<q31_t>();
+    }
+
+    SECTION("unsupported sizes") {
+        std::vector<q15_t> x(4096);
+        CHECK(!fft(x.data(), 0));
+        CHECK(!fft(x.data(), 1));
+        CHECK(!fft(x.data(), 48));
+        CHECK(!fft(x.data(), 2048));
+        CHECK(!ifft(x.data(), 3));
+    }
+
+    SECTION("spectrum of a sampled tone") {
+        // 12-bit ADC readings of a sine wave at the frequency of bin 10
+        const size_t size = 256;
+        std::vector<uint16_t> adc(size);
+        for (size_t i = 0; i < size; ++i) {
+            adc[i] = 2048 + (uint16_t)std::lround(1000 * std::sin(2 * M_PI * 10 * i / size));
+        }
+        std::vector<q15_t> samples(size);
+        adcToQ15(adc.data(), samples.data(), size);
+        std::vector<q15_t> x(size * 2);
+        for (size_t i = 0; i < size; ++i) {
+            x[2 * i] = samples[i];
+        }
+        REQUIRE(fft(x.data(), size));
+        std::vector<q15_t> m(size);
+        magnitude(x.data(), m.data(), size);
+        const size_t peak = std::max_element(m.begin(), m.begin() + size / 2) - m.begin();
+        CHECK(peak == 10);
+        // Amplitude of 1000 / 2048 split between the positive and negative frequencies
+        CHECK(std::abs(toDouble(m[peak]) - 1000.0 / 2048 / 2) < 0.001);
+    }
+}
+
+// Throughput of the portable kernels on the host, run with the [benchmark] tag
+TEST_CASE("DSP kernel throughput", "[.][benchmark]") {
+    const size_t SAMPLES = 1 << 20;
+    const auto x = randomSamples<q15_t>(SAMPLES, 1.0, 8);
+    std::vector<q15_t> y(SAMPLES);
+
+    const auto h = randomCoeffs<q15_t>(64, 9);
+    std::vector<q15_t> state(FirFilter<q15_t>::stateSize(h.size(), 256));
+    FirFilter<q15_t> fir(h.data(), h.size(), state.data(), 256);
+    auto t1 = std::chrono::steady_clock::now();
+    fir.process(x.data(), y.data(), SAMPLES);
+    auto t2 = std::chrono::steady_clock::now();
+    const double firTime = std::chrono::duration<double>(t2 - t1).count();
+
+    // Per-sample floating-point filter for comparison
+    std::vector<float> hf(h.size());
+    for (size_t i = 0; i < h.size(); ++i) {
+        hf[i] = toDouble(h[i]);
+    }
+    std::vector<float> hist(h.size());
+    volatile float sink = 0;
+    t1 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < SAMPLES; ++i) {
+        std::rotate(hist.rbegin(), hist.rbegin() + 1, hist.rend());
+        hist[0] = toDouble(x[i]);
+        float acc = 0;
+        for (size_t k = 0; k < hf.size(); ++k) {
+            acc += hf[k] * hist[k];
+        }
+        sink = acc;
+    }
+    t2 = std::chrono::steady_clock::now();
+    const double floatTime = std::chrono::duration<double>(t2 - t1).count();
+
+    const q15_t coeffs[5] = { 2210, 4420, 2210, -18727, 6763 };
+    q15_t iirState[4] = {};
+    BiquadCascade<q15_t> iir(coeffs, 1, iirState);
+    t1 = std::chrono::steady_clock::now();
+    iir.process(x.data(), y.data(), SAMPLES);
+    t2 = std::chrono::steady_clock::now();
+    const double iirTime = std::chrono::duration<double>(t2 - t1).count();
+
+    const size_t FFT_SIZE = 1024;
+    const size_t FFT_COUNT = 1000;
+    auto buf = randomComplexSamples<q15_t>(FFT_SIZE, 10);
+    t1 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < FFT_COUNT; ++i) {
+        fft(buf.data(), FFT_SIZE);
+    }
+    t2 = std::chrono::steady_clock::now();
+    const double fftTime = std::chrono::duration<double>(t2 - t1).count();
+
+    CATCH_WARN("64-tap Q15 FIR: " << SAMPLES / firTime / 1e6 << " MS/s (per-sample float FIR: " <<
+            SAMPLES / floatTime / 1e6 << " MS/s), Q15 biquad: " << SAMPLES / iirTime / 1e6 << " MS/s, " <<
+            "1024-point Q15 FFT: " << fftTime / FFT_COUNT * 1e6 << " us");
+    (void)sink;
+}
@@ -0,0 +1,292 @@
+#include "flash_copy_impl.h"
+
+#include "tools/catch.h"
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+namespace {
+
+// Approximate timings of the STM32F2xx internal flash, in microseconds
+struct FlashTimings {
+    double eraseBase; // Per erased sector
+    double erasePerByte;
+    double programPerWord;
+    double readCall; // Per read operation
+    double readPerByte;
+};
+
+const FlashTimings STM32F2XX_TIMINGS = { 200000.0, 7.0, 16.0, 1.0, 0.01 };
+
+// Simulated NOR flash device with a configurable sector layout
+class SimFlash {
+public:
+    SimFlash(uint32_t base, const std::vector<uint32_t>& sectorSizes, const FlashTimings& timings = STM32F2XX_TIMINGS) :
+            base_(base),
+            timings_(timings),
+            eraseFailures_(false) {
+        uint32_t addr = base;
+        for (uint32_t size: sectorSizes) {
+            addr += size;
+            sectorEnds_.push_back(addr);
+        }
+        mem_.resize(addr - base);
+        for (auto& b: mem_) {
+            b = rand();
+        }
+        resetStats();
+    }
+
+    flash_copy_device_t device() {
+        flash_copy_device_t d = {};
+        d.read = read;
+        d.write = write;
+        d.erase = erase;
+        d.sector_end = sectorEnd;
+        d.ctx = this;
+        return d;
+    }
+
+    uint8_t* data(uint32_t addr) {
+        return &mem_.at(addr - base_);
+    }
+
+    uint32_t base() const {
+        return base_;
+    }
+
+    uint32_t size() const {
+        return mem_.size();
+    }
+
+    void failErase(bool fail) {
+        eraseFailures_ = fail;
+    }
+
+    void resetStats() {
+        erases = 0;
+        readCalls = 0;
+        bytesRead = 0;
+        bytesWritten = 0;
+        time = 0;
+    }
+
+    unsigned erases;
+    unsigned readCalls;
+    unsigned bytesRead;
+    unsigned bytesWritten;
+    double time; // Simulated time in microseconds
+
+private:
+    std::vector<uint8_t> mem_;
+    std::vector<uint32_t> sectorEnds_;
+    uint32_t base_;
+    FlashTimings timings_;
+    bool eraseFailures_;
+
+    bool valid(uint32_t addr, uint32_t size) const {
+        return addr >= base_ && addr - base_ + size <= mem_.size();
+    }
+
+    uint32_t sectorStart(uint32_t addr) const {
+        const auto it = std::upper_bound(sectorEnds_.begin(), sectorEnds_.end(), addr);
+        return (it == sectorEnds_.begin()) ? base_ : *(it - 1);
+    }
+
+    static int read(uint32_t addr, void* data, uint32_t size, void* ctx) {
+        const auto f = static_cast<SimFlash*>(ctx);
+        if (!f->valid(addr, size)) {
+            return -1;
+        }
+        memcpy(data, f->data(addr), size);
+        ++f->readCalls;
+        f->bytesRead += size;
+        f->time += f->timings_.readCall + f->timings_.readPerByte * size;
+        return 0;
+    }
+
+    static int write(uint32_t addr, const void* data, uint32_t size, void* ctx) {
+        const auto f = static_cast<SimFlash*>(ctx);
+        if (!f->valid(addr, size)) {
+            return -1;
+        }
+        auto src = static_cast<const uint8_t*>(data);
+        auto dest = f->data(addr);
+        for (uint32_t i = 0; i < size; ++i) {
+            dest[i] &= src[i]; // Programming can only clear bits
+        }
+        f->bytesWritten += size;
+        f->time += f->timings_.programPerWord * ((size + 3) / 4);
+        return 0;
+    }
+
+    static int erase(uint32_t addr, uint32_t size, void* ctx) {
+        const auto f = static_cast<SimFlash*>(ctx);
+        if (!f->valid(addr, size) || f->eraseFailures_) {
+            return -1;
+        }
+        uint32_t start = f->sectorStart(addr);
+        const uint32_t end = addr + size;
+        while (start < end) {
+            const uint32_t sectorEnd = sectorEndImpl(f, start);
+            memset(f->data(start), 0xff, sectorEnd - start);
+            ++f->erases;
+            f->time += f->timings_.eraseBase + f->timings_.erasePerByte * (sectorEnd - start);
+            start = sectorEnd;
+        }
+        return 0;
+    }
+
+    static uint32_t sectorEndImpl(SimFlash* f, uint32_t addr) {
+        const auto it = std::upper_bound(f->sectorEnds_.begin(), f->sectorEnds_.end(), addr);
+        return (it == f->sectorEnds_.end()) ? 0 : *it;
+    }
+
+    static uint32_t sectorEnd(uint32_t addr, void* ctx) {
+        return sectorEndImpl(static_cast<SimFlash*>(ctx), addr);
+    }
+};
+
+bool equal(SimFlash& f1, uint32_t addr1, SimFlash& f2, uint32_t addr2, uint32_t size) {
+    return memcmp(f1.data(addr1), f2.data(addr2), size) == 0;
+}
+
+} // namespace
+
+TEST_CASE("Compare_FlashMemory_Impl()") {
+    SimFlash src(0x1000, std::vector<uint32_t>(4, 0x1000));
+    SimFlash dest(0x8000, std::vector<uint32_t>(4, 0x1000));
+    auto s = src.device();
+    auto d = dest.device();
+    memcpy(dest.data(0x8000), src.data(0x1000), src.size());
+
+    SECTION("equal ranges") {
+        CHECK(Compare_FlashMemory_Impl(&s, 0x1000, &d, 0x8000, 0x4000) == 0);
+        CHECK(Compare_FlashMemory_Impl(&s, 0x1003, &d, 0x8003, 1001) == 0);
+    }
+
+    SECTION("ranges that differ in the last byte") {
+        *dest.data(0x8000 + 0x3fff) ^= 1;
+        CHECK(Compare_FlashMemory_Impl(&s, 0x1000, &d, 0x8000, 0x4000) == 1);
+        CHECK(Compare_FlashMemory_Impl(&s, 0x1000, &d, 0x8000, 0x3fff) == 0);
+    }
+
+    SECTION("data is read in blocks") {
+        REQUIRE(Compare_FlashMemory_Impl(&s, 0x1000, &d, 0x8000, 0x4000) == 0);
+        CHECK(src.readCalls == 0x4000 / FLASH_COPY_BLOCK_SIZE);
+        CHECK(dest.readCalls == 0x4000 / FLASH_COPY_BLOCK_SIZE);
+    }
+
+    SECTION("comparison stops at the first difference") {
+        *dest.data(0x8000) ^= 1;
+        CHECK(Compare_FlashMemory_Impl(&s, 0x1000, &d, 0x8000, 0x4000) == 1);
+        CHECK(src.readCalls == 1);
+    }
+
+    SECTION("read errors are reported") {
+        CHECK(Compare_FlashMemory_Impl(&s, 0x1000, &d, 0x8000, 0x5000) == -1);
+    }
+}
+
+TEST_CASE("Copy_FlashMemory_Impl()") {
+    // Sector layout of the first 256K of the STM32F2xx internal flash
+    const std::vector<uint32_t> layout = { 0x4000, 0x4000, 0x4000, 0x4000, 0x10000, 0x20000 };
+    SimFlash src(0x80000, std::vector<uint32_t>(2, 0x20000));
+    SimFlash dest(0x8000000, layout);
+    auto s = src.device();
+    auto d = dest.device();
+    const uint32_t size = 0x40000;
+    flash_copy_stats_t stats = {};
+
+    SECTION("full copy erases and programs all sectors") {
+        REQUIRE(Copy_FlashMemory_Impl(&s, 0x80000, &d, 0x8000000, size, 0, &stats) == 0);
+        CHECK(equal(src, 0x80000, dest, 0x8000000, size));
+        CHECK(dest.erases == layout.size());
+        CHECK(stats.sectors == layout.size());
+        CHECK(stats.sectors_skipped == 0);
+        CHECK(stats.bytes_written == size);
+        CHECK(stats.bytes_compared == 0);
+    }
+
+    SECTION("differential copy of identical data doesn't modify the destination") {
+        memcpy(dest.data(0x8000000), src.data(0x80000), size);
+        REQUIRE(Copy_FlashMemory_Impl(&s, 0x80000, &d, 0x8000000, size, 1, &stats) == 0);
+        CHECK(dest.erases == 0);
+        CHECK(dest.bytesWritten == 0);
+        CHECK(stats.sectors_skipped == layout.size());
+        CHECK(stats.bytes_compared == size);
+    }
+
+    SECTION("differential copy only erases the sectors that have changed") {
+        memcpy(dest.data(0x8000000), src.data(0x80000), size);
+        *dest.data(0x8004000 + 100) ^= 0x80; // Sector 1
+        *dest.data(0x8020000 + 0x1ffff) ^= 0x01; // Last byte of sector 5
+        REQUIRE(Copy_FlashMemory_Impl(&s, 0x80000, &d, 0x8000000, size, 1, &stats) == 0);
+        CHECK(equal(src, 0x80000, dest, 0x8000000, size));
+        CHECK(dest.erases == 2);
+        CHECK(stats.sectors_skipped == layout.size() - 2);
+        CHECK(stats.bytes_written == (0x4000 + 0x20000));
+    }
+
+    SECTION("ranges that don't end at a sector boundary") {
+        const uint32_t n = 0x4000 + 1234;
+        memcpy(dest.data(0x8000000), src.data(0x80000), n);
+        *dest.data(0x8000000 + n - 1) ^= 0xff;
+        REQUIRE(Copy_FlashMemory_Impl(&s, 0x80000, &d, 0x8000000, n, 1, &stats) == 0);
+        CHECK(equal(src, 0x80000, dest, 0x8000000, n));
+        CHECK(stats.sectors == 2);
+        CHECK(stats.sectors_skipped == 1);
+        CHECK(stats.bytes_written == 1234);
+    }
+
+    SECTION("erase errors are reported") {
+        dest.failErase(true);
+        CHECK(Copy_FlashMemory_Impl(&s, 0x80000, &d, 0x8000000, size, 0, &stats) == -1);
+    }
+
+    SECTION("invalid destination ranges are reported") {
+        CHECK(Copy_FlashMemory_Impl(&s, 0x80000, &d, 0x8000000 + size, 0x100, 0, &stats) == -1);
+    }
+}
+
+// Simulated update of a 384K system module, 5% of which has changed in a single region. Run with
+// the [benchmark] tag
+TEST_CASE("Module update time", "[.][benchmark]") {
+    const uint32_t size = 0x60000;
+    SimFlash src(0x80000, std::vector<uint32_t>(3, 0x20000));
+    SimFlash dest(0x8020000, std::vector<uint32_t>(3, 0x20000));
+    auto s = src.device();
+    auto d = dest.device();
+    memcpy(dest.data(0x8020000), src.data(0x80000), size);
+    const uint32_t changed = size / 20;
+    for (uint32_t i = 0; i < changed; ++i) {
+        *src.data(0x80000 + 0x30000 + i) = rand();
+    }
+
+    // Legacy copy: each sector is erased and programmed, data is read 4 bytes at a time
+    const double legacyTime = dest.time + STM32F2XX_TIMINGS.readCall * (size / 4) +
+            3 * (STM32F2XX_TIMINGS.eraseBase + STM32F2XX_TIMINGS.erasePerByte * 0x20000) +
+            STM32F2XX_TIMINGS.programPerWord * (size / 4);
+
+    REQUIRE(Copy_FlashMemory_Impl(&s, 0x80000, &d, 0x8020000, size, 0, nullptr) == 0);
+    const double fullTime = src.time + dest.time;
+    const unsigned fullErases = dest.erases;
+
+    memcpy(dest.data(0x8020000), src.data(0x80000), size);
+    for (uint32_t i = 0; i < changed; ++i) {
+        *dest.data(0x8020000 + 0x30000 + i) = 0;
+    }
+    src.resetStats();
+    dest.resetStats();
+    REQUIRE(Copy_FlashMemory_Impl(&s, 0x80000, &d, 0x8020000, size, 1, nullptr) == 0);
+    CHECK(equal(src, 0x80000, dest, 0x8020000, size));
+    const double diffTime = src.time + dest.time;
+    const unsigned diffErases = dest.erases;
+
+    CATCH_WARN("Legacy copy: " << legacyTime / 1000 << " ms, full copy: " << fullTime / 1000 << " ms (" <<
+            fullErases << " erases), differential copy: " << diffTime / 1000 << " ms (" << diffErases << " erases)");
+    CHECK(diffErases < fullErases);
+    CHECK(diffTime < fullTime);
+}
@@ -0,0 +1,303 @@
+#include "spark_wiring_format.h"
+#include "spark_wiring_print.h"
+#include "spark_wiring_string.h"
+
+#include "tools/catch.h"
+
+#include <string>
+#include <cstdio>
+#include <cstdarg>
+#include <climits>
+#include <cmath>
+
+namespace {
+
+using namespace particle;
+
+size_t appendToString(const char* data, size_t size, void* ctx) {
+    static_cast<std::string*>(ctx)->append(data, size);
+    return size;
+}
+
+// Formats a string using vformat()
+std::string format(const char* fmt, ...) {
+    std::string s;
+    va_list args;
+    va_start(args, fmt);
+    vformat(appendToString, &s, fmt, args);
+    va_end(args);
+    return s;
+}
+
+// Formats a string using the C library
+std::string cformat(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    char buf[2048];
+    const int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    REQUIRE((n >= 0 && (size_t)n < sizeof(buf)));
+    return buf;
+}
+
+std::string fixed(double value, unsigned precision, FormatRounding rounding = FORMAT_ROUND_HALF_UP) {
+    char buf[64];
+    const int n = formatFixed(buf, sizeof(buf), value, precision, rounding);
+    return (n >= 0) ? std::string(buf, n) : std::string("<error>");
+}
+
+std::string unsignedToString(unsigned long long value, unsigned base, bool upperCase = false) {
+    char buf[FORMAT_UNSIGNED_MAX_SIZE];
+    char* const end = buf + sizeof(buf);
+    const char* const p = formatUnsigned(end, value, base, upperCase);
+    return std::string(p, (const char*)end);
+}
+
+// Collects the output of a Print in chunks
+class ChunkPrint: public Print {
+public:
+    size_t write(uint8_t c) override {
+        data_ += (char)c;
+        ++writes_;
+        return 1;
+    }
+
+    size_t write(const uint8_t* data, size_t size) override {
+        data_.append((const char*)data, size);
+        ++writes_;
+        return size;
+    }
+
+    const std::string& data() const {
+        return data_;
+    }
+
+    unsigned writes() const {
+        return writes_;
+    }
+
+private:
+    std::string data_;
+    unsigned writes_ = 0;
+};
+
+} // namespace
+
+#define CHECK_FORMAT(...) \
+        CHECK(format(__VA_ARGS__) == cformat(__VA_ARGS__))
+
+TEST_CASE("formatUnsigned()") {
+    SECTION("formats decimal numbers") {
+        CHECK(unsignedToString(0, 10) == "0");
+        CHECK(unsignedToString(7, 10) == "7");
+        CHECK(unsignedToString(42, 10) == "42");
+        CHECK(unsignedToString(100, 10) == "100");
+        CHECK(unsignedToString(4294967295u, 10) == "4294967295");
+        CHECK(unsignedToString(4294967296ull, 10) == "4294967296");
+        CHECK(unsignedToString(1000000000000000000ull, 10) == "1000000000000000000");
+        CHECK(unsignedToString(ULLONG_MAX, 10) == "18446744073709551615");
+    }
+    SECTION("formats numbers in other bases") {
+        CHECK(unsignedToString(255, 16) == "ff");
+        CHECK(unsignedToString(255, 16, true) == "FF");
+        CHECK(unsignedToString(8, 8) == "10");
+        CHECK(unsignedToString(5, 2) == "101");
+        CHECK(unsignedToString(35, 36) == "z");
+        CHECK(unsignedToString(ULLONG_MAX, 16) == "ffffffffffffffff");
+        CHECK(unsignedToString(ULLONG_MAX, 2) == std::string(64, '1'));
+        CHECK(unsignedToString(ULLONG_MAX, 3) == "11112220022122120101211020120210210211220");
+    }
+    SECTION("treats invalid bases as 10") {
+        CHECK(unsignedToString(123, 0) == "123");
+        CHECK(unsignedToString(123, 1) == "123");
+        CHECK(unsignedToString(123, 37) == "123");
+    }
+}
+
+TEST_CASE("formatFixed()") {
+    SECTION("formats numbers with the requested precision") {
+        CHECK(fixed(0, 0) == "0");
+        CHECK(fixed(0, 2) == "0.00");
+        CHECK(fixed(1, 6) == "1.000000");
+        CHECK(fixed(123.123, 3) == "123.123");
+        CHECK(fixed(123456789.0, 3) == "123456789.000");
+        CHECK(fixed(0.001, 3) == "0.001");
+        CHECK(fixed(1.5, 25) == "1.5000000000000000000000000");
+    }
+    SECTION("rounds halfway cases up by default") {
+        CHECK(fixed(123.5, 0) == "124");
+        CHECK(fixed(0.125, 2) == "0.13");
+        CHECK(fixed(1.005, 2) == "1.01");
+        CHECK(fixed(1.999, 2) == "2.00");
+        CHECK(fixed(9.9999999, 3) == "10.000");
+    }
+    SECTION("rejects ambiguous values in the exact rounding mode") {
+        CHECK(fixed(2.5, 0, FORMAT_ROUND_EXACT) == "<error>");
+        CHECK(fixed(0.125, 2, FORMAT_ROUND_EXACT) == "<error>");
+        CHECK(fixed(2.4, 0, FORMAT_ROUND_EXACT) == "2");
+        CHECK(fixed(0.126, 2, FORMAT_ROUND_EXACT) == "0.13");
+        CHECK(fixed(1.5, 10, FORMAT_ROUND_EXACT) == "<error>");
+    }
+    SECTION("rejects values that are out of range") {
+        CHECK(fixed(-1, 2) == "<error>");
+        CHECK(fixed(1e20, 2) == "<error>");
+        CHECK(fixed(NAN, 2) == "<error>");
+        CHECK(fixed(INFINITY, 2) == "<error>");
+        char buf[4];
+        CHECK(formatFixed(buf, sizeof(buf), 1.5, 2) < 0);
+        CHECK(formatFixed(buf, sizeof(buf), 1.5, 1) == 3);
+    }
+}
+
+TEST_CASE("vformat()") {
+    SECTION("formats integers") {
+        CHECK_FORMAT("%d %i %u", 0, -1, 1u);
+        CHECK_FORMAT("%d %d", INT_MIN, INT_MAX);
+        CHECK_FORMAT("%ld %lu", LONG_MIN, ULONG_MAX);
+        CHECK_FORMAT("%lld %llu", LLONG_MIN, ULLONG_MAX);
+        CHECK_FORMAT("%hhd %hhu %hd %hu", 300, 300, 70000, 70000);
+        CHECK_FORMAT("%zu %zd %jd %td", (size_t)123, (ssize_t)-123, (intmax_t)-5, (ptrdiff_t)-7);
+        CHECK_FORMAT("%x %X %o", 0xbeefu, 0xbeefu, 8u);
+        CHECK_FORMAT("%#x %#X %#o %#x %#o", 255u, 255u, 8u, 0u, 0u);
+    }
+    SECTION("supports flags, width and precision") {
+        CHECK_FORMAT("[%5d] [%-5d] [%05d] [%+d] [% d] [%+05d]", 42, 42, -42, 42, 42, 42);
+        CHECK_FORMAT("[%.3d] [%8.3d] [%-8.3d] [%08.3d]", 7, -7, 7, 7);
+        CHECK_FORMAT("[%.0d] [%5.0d] [%#.0o] [%#.0x]", 0, 0, 0u, 0u);
+        CHECK_FORMAT("[%*d] [%-*d] [%*d] [%.*d] [%.*d]", 6, 1, 6, 1, -6, 1, 3, 1, -3, 1);
+        CHECK_FORMAT("[%#08x] [%-#8x]", 0xabu, 0xabu);
+    }
+    SECTION("formats strings and characters") {
+        CHECK_FORMAT("%s %c%c", "abc", 'd', 'e');
+        CHECK_FORMAT("[%8s] [%-8s] [%.2s] [%8.2s]", "abc", "abc", "abc", "abc");
+        CHECK_FORMAT("[%3c] [%-3c]", 'x', 'y');
+        CHECK_FORMAT("%s", "");
+        const char unterminated[3] = { 'a', 'b', 'c' };
+        CHECK(format("%.3s", unterminated) == "abc");
+        const std::string longStr(1000, 'x');
+        CHECK_FORMAT("<%s>", longStr.c_str());
+        CHECK(format("<%s>", longStr.c_str()) == "<" + longStr + ">");
+    }
+    SECTION("formats floating point numbers") {
+        CHECK_FORMAT("%f %f %f", 0.0, 1.0, -1.0);
+        CHECK_FORMAT("%.2f %.0f %.9f", 3.14159, 2.71828, 1.0 / 3);
+        CHECK_FORMAT("%.0f %.0f %.0f %.2f %.1f", 0.5, 1.5, 2.5, 0.125, 0.25);
+        CHECK_FORMAT("%.2f %.3f", 1.005, 2.0005);
+        CHECK_FORMAT("[%10.3f] [%-10.3f] [%010.3f] [%+.1f] [% .1f]", -1.5, 1.5, -1.5, 1.25, 1.75);
+        CHECK_FORMAT("%#.0f %f", 3.0, -0.0);
+        CHECK_FORMAT("%f %f", 1e18, 123456789012345.678);
+        CHECK_FORMAT("%.12f %f %f", 0.1, 1e30, -1e300);
+        CHECK_FORMAT("%f %f %F", INFINITY, -INFINITY, NAN);
+        CHECK_FORMAT("%e %g %G %.3e %a", 12345.678, 0.0001, 1e-10, 1e100, 1.0);
+        CHECK_FORMAT("%Lf %Lg", (long double)1.5, (long double)2.5);
+    }
+    SECTION("formats other conversions") {
+        int x = 0;
+        CHECK_FORMAT("%p %%", (void*)&x);
+        CHECK_FORMAT("%s", (const char*)nullptr);
+        int n = 0;
+        CHECK(format("abc%ndef", &n) == "abcdef");
+        CHECK(n == 3);
+        long long ln = 0;
+        CHECK(format("%s%lln", "abcde", &ln) == "abcde");
+        CHECK(ln == 5);
+    }
+    SECTION("writes invalid specifications as is") {
+        CHECK(format("abc %") == "abc %");
+        CHECK(format("abc %5") == "abc %5");
+        CHECK(format("%y %d", 1) == "%y 1");
+    }
+    SECTION("writes data to the callback in chunks") {
+        ChunkPrint p;
+        const std::string s(200, 'a');
+        p.printf("%s %d %s", "abc", 123, s.c_str());
+        CHECK(p.data() == "abc 123 " + s);
+        // The leading part is buffered, the long string is written directly
+        CHECK(p.writes() == 2);
+    }
+}
+
+TEST_CASE("Print uses the shared number formatting routines") {
+    ChunkPrint p;
+    SECTION("integers") {
+        p.print(255, HEX);
+        p.print(' ');
+        p.print(-123);
+        p.print(' ');
+        p.print(5, BIN);
+        p.print(' ');
+        p.print(10ul, 1);
+        CHECK(p.data() == "FF -123 101 10");
+    }
+    SECTION("floating point numbers") {
+        p.print(1.999, 2);
+        p.print(' ');
+        p.print(-0.125, 2);
+        p.print(' ');
+        p.print(2.5, 0);
+        p.print(' ');
+        p.print(1.5, 21);
+        p.print(' ');
+        p.print(1e10, 2);
+        p.print(' ');
+        p.print(NAN, 2);
+        CHECK(p.data() == "2.00 -0.13 3 1.500000000000000000000 ovf nan");
+    }
+}
+
+TEST_CASE("String storage") {
+    SECTION("short strings are stored inline and can be moved") {
+        String s("short");
+        String t(std::move(s));
+        CHECK(t == "short");
+        CHECK(s == "");
+        String u;
+        u = std::move(t);
+        CHECK(u == "short");
+    }
+    SECTION("strings can outgrow the inline buffer") {
+        String s("0123456789");
+        s += "abcdefghij";
+        CHECK(s == "0123456789abcdefghij");
+        String t(std::move(s));
+        CHECK(t == "0123456789abcdefghij");
+        CHECK(s.c_str() == nullptr); // The buffer has been stolen
+        String u("abc");
+        u = t;
+        CHECK(u == "0123456789abcdefghij");
+    }
+    SECTION("strings can be appended to themselves") {
+        String s("abcdefghij");
+        s += s;
+        CHECK(s == "abcdefghijabcdefghij");
+        s += s;
+        CHECK(s == "abcdefghijabcdefghijabcdefghijabcdefghij");
+    }
+    SECTION("appending a number of characters produces the right result") {
+        String s;
+        std::string expected;
+        for (int i = 0; i < 1000; ++i) {
+            s += (char)('a' + i % 26);
+            expected += (char)('a' + i % 26);
+        }
+        CHECK(s.length() == 1000);
+        CHECK(std::string(s.c_str()) == expected);
+    }
+    SECTION("String::format() formats strings of any length") {
+        CHECK(String::format("%d", 1) == "1");
+        const std::string longStr(300, 'z');
+        const String s = String::format("%s-%d", longStr.c_str(), 42);
+        CHECK(std::string(s.c_str()) == longStr + "-42");
+    }
+    SECTION("numbers are converted using the shared routines") {
+        String s;
+        s += -123;
+        s += ' ';
+        s += 4294967295ul;
+        s += ' ';
+        s.concat(1.5);
+        s += ' ';
+        s.concat(-2.0f);
+        CHECK(s == "-123 4294967295 1.500000 -2.000000");
+    }
+}
@@ -0,0 +1,209 @@
+#include "image_digest.h"
+#include "ota_image_digest.h"
+
+#include "tools/catch.h"
+
+#include <boost/crc.hpp>
+
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+using namespace particle;
+
+const uint32_t BASE_ADDRESS = 0x80c0000;
+
+std::string randomImage(size_t size) {
+    std::mt19937 gen(size);
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::string s;
+    s.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        s += (char)dist(gen);
+    }
+    return s;
+}
+
+uint32_t crc32(const char* data, size_t size) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data, size);
+    return crc.checksum();
+}
+
+// Feeds the image to the digest in chunks of the specified size
+void writeImage(ImageDigest* digest, const std::string& image, size_t chunkSize) {
+    for (size_t offs = 0; offs < image.size(); offs += chunkSize) {
+        const size_t n = std::min(chunkSize, image.size() - offs);
+        digest->update(BASE_ADDRESS + offs, image.data() + offs, n, true);
+    }
+}
+
+// Converts the digest to the structure passed to HAL_FLASH_OTA_Set_Image_Digest()
+hal_ota_image_digest_t halDigest(const ImageDigest& d, std::vector<hal_ota_image_region_t>* regions) {
+    regions->clear();
+    for (size_t i = 0; i < d.regionCount(); ++i) {
+        const auto& r = d.regions()[i];
+        regions->push_back({ r.address, r.size, r.crc });
+    }
+    hal_ota_image_digest_t hd = {};
+    hd.size = sizeof(hd);
+    hd.region_count = regions->size();
+    hd.address = d.address();
+    hd.image_size = d.size();
+    hd.crc = d.crc();
+    hd.regions = regions->data();
+    return hd;
+}
+
+uint32_t halCrc32(const uint8_t* data, uint32_t size) {
+    return crc32((const char*)data, size);
+}
+
+} // namespace
+
+TEST_CASE("ImageDigest") {
+    ImageDigest d;
+    CHECK(!d.isValid());
+    d.reset(BASE_ADDRESS);
+    const auto image = randomImage(10000);
+
+    SECTION("CRC covers all data except the last 4 bytes") {
+        for (size_t chunkSize: { 1, 2, 3, 4, 5, 512, 10000 }) {
+            d.reset(BASE_ADDRESS);
+            writeImage(&d, image, chunkSize);
+            REQUIRE(d.isValid());
+            CHECK(d.address() == BASE_ADDRESS);
+            CHECK(d.size() == image.size() - 4);
+            CHECK(d.crc() == crc32(image.data(), image.size() - 4));
+            CHECK(d.regionCount() == 0);
+        }
+    }
+
+    SECTION("portions that failed to be written are recorded as regions") {
+        d.update(BASE_ADDRESS, image.data(), 512, true);
+        d.update(BASE_ADDRESS + 512, image.data() + 512, 512, false);
+        d.update(BASE_ADDRESS + 1024, image.data() + 1024, image.size() - 1024, true);
+        REQUIRE(d.isValid());
+        CHECK(d.crc() == crc32(image.data(), image.size() - 4));
+        REQUIRE(d.regionCount() == 1);
+        CHECK(d.regions()[0].address == BASE_ADDRESS + 512);
+        CHECK(d.regions()[0].size == 512);
+        CHECK(d.regions()[0].crc == crc32(image.data() + 512, 512));
+    }
+
+    SECTION("retransmitted portions are recorded once") {
+        writeImage(&d, image, 512);
+        d.update(BASE_ADDRESS + 1024, image.data() + 1024, 512, true);
+        d.update(BASE_ADDRESS + 1024, image.data() + 1024, 512, true);
+        REQUIRE(d.isValid());
+        CHECK(d.regionCount() == 1);
+        CHECK(d.crc() == crc32(image.data(), image.size() - 4));
+    }
+
+    SECTION("digest is invalidated by out of order data") {
+        d.update(BASE_ADDRESS, image.data(), 512, true);
+        d.update(BASE_ADDRESS + 1024, image.data() + 1024, 512, true);
+        CHECK(!d.isValid());
+        d.reset(BASE_ADDRESS);
+        CHECK(d.isValid());
+        d.update(BASE_ADDRESS - 512, image.data(), 512, true);
+        CHECK(!d.isValid());
+    }
+
+    SECTION("digest is invalidated by too many regions") {
+        for (size_t i = 0; i < ImageDigest::MAX_REGIONS; ++i) {
+            d.update(BASE_ADDRESS + i * 512, image.data() + i * 512, 512, false);
+        }
+        CHECK(d.isValid());
+        d.update(BASE_ADDRESS + ImageDigest::MAX_REGIONS * 512, image.data(), 512, false);
+        CHECK(!d.isValid());
+    }
+}
+
+TEST_CASE("verifyOtaImageDigest()") {
+    // nRF52840 layout: the image is written to the external flash at EXTERNAL_FLASH_OTA_ADDRESS
+    // and the module is read via XIP at EXTERNAL_FLASH_OTA_XIP_ADDRESS
+    const uint32_t XIP_BASE = 0x12000000;
+    const uint32_t OTA_ADDRESS = 0x400000 - 1500 * 1024;
+    const uint32_t OTA_XIP_ADDRESS = OTA_ADDRESS + XIP_BASE;
+    // Image with the module CRC in big-endian order at the end
+    auto image = randomImage(10000);
+    const uint32_t moduleCrc = crc32(image.data(), image.size() - 4);
+    for (size_t i = 0; i < 4; ++i) {
+        image[image.size() - 4 + i] = (char)(moduleCrc >> (24 - i * 8));
+    }
+    const uint32_t length = image.size() - 4;
+    ImageDigest d;
+    d.reset(OTA_ADDRESS);
+    d.update(OTA_ADDRESS, image.data(), 512, true);
+    d.update(OTA_ADDRESS + 512, image.data() + 512, 512, false);
+    d.update(OTA_ADDRESS + 1024, image.data() + 1024, image.size() - 1024, true);
+    REQUIRE(d.isValid());
+    REQUIRE(d.regionCount() == 1);
+    std::vector<hal_ota_image_region_t> regions;
+    const auto hd = halDigest(d, &regions);
+    // Contents of the external flash as seen via XIP
+    std::string xip = image;
+    const auto module = (const uint8_t*)xip.data();
+
+    SECTION("the digest is used when the flash address of the module matches") {
+        // The HAL translates the XIP address of the module to its flash address
+        CHECK(verifyOtaImageDigest(hd, OTA_XIP_ADDRESS - XIP_BASE, module, length, halCrc32) == OTA_IMAGE_DIGEST_VALID);
+        // Only the recorded regions are read back
+        xip[100] ^= 0xff;
+        CHECK(verifyOtaImageDigest(hd, OTA_ADDRESS, module, length, halCrc32) == OTA_IMAGE_DIGEST_VALID);
+        xip[600] ^= 0xff;
+        CHECK(verifyOtaImageDigest(hd, OTA_ADDRESS, module, length, halCrc32) == OTA_IMAGE_DIGEST_INVALID);
+    }
+
+    SECTION("the module CRC is compared with the digest") {
+        xip[length] ^= 0xff;
+        CHECK(verifyOtaImageDigest(hd, OTA_ADDRESS, module, length, halCrc32) == OTA_IMAGE_DIGEST_INVALID);
+    }
+
+    SECTION("the digest is not used for a different module") {
+        CHECK(verifyOtaImageDigest(hd, OTA_XIP_ADDRESS, module, length, halCrc32) == OTA_IMAGE_DIGEST_NOT_APPLICABLE);
+        CHECK(verifyOtaImageDigest(hd, OTA_ADDRESS, module, length - 4, halCrc32) == OTA_IMAGE_DIGEST_NOT_APPLICABLE);
+    }
+}
+
+// Time spent validating a 512K image received in 512-byte chunks, run with the [benchmark] tag.
+// The read-back time is estimated for an external flash readable at 8 MB/s, and the CRC time is
+// measured on the host
+TEST_CASE("OTA validation time", "[.][benchmark]") {
+    const size_t IMAGE_SIZE = 512 * 1024;
+    const size_t CHUNK_SIZE = 512;
+    const double FLASH_READ_RATE = 8.0 * 1024 * 1024; // Bytes per second
+    const auto image = randomImage(IMAGE_SIZE);
+
+    // Incremental digest, updated as the chunks are written
+    auto t1 = std::chrono::steady_clock::now();
+    ImageDigest d;
+    d.reset(BASE_ADDRESS);
+    writeImage(&d, image, CHUNK_SIZE);
+    auto t2 = std::chrono::steady_clock::now();
+    REQUIRE(d.isValid());
+    const double digestTime = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+    // Full pass over the image after the transfer
+    t1 = std::chrono::steady_clock::now();
+    std::vector<char> buf(CHUNK_SIZE);
+    boost::crc_32_type crc;
+    for (size_t offs = 0; offs + 4 < IMAGE_SIZE; offs += CHUNK_SIZE) {
+        const size_t n = std::min(CHUNK_SIZE, IMAGE_SIZE - 4 - offs);
+        memcpy(buf.data(), image.data() + offs, n);
+        crc.process_bytes(buf.data(), n);
+    }
+    t2 = std::chrono::steady_clock::now();
+    REQUIRE(crc.checksum() == d.crc());
+    const double readBackTime = std::chrono::duration<double, std::milli>(t2 - t1).count() +
+            IMAGE_SIZE / FLASH_READ_RATE * 1000;
+
+    CATCH_WARN("Validation after transfer, read-back: " << readBackTime << " ms, running digest: 0 ms (" <<
+            digestTime << " ms spread over the transfer)");
+    CHECK(d.regionCount() == 0);
+}
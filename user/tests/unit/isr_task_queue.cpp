@@ -0,0 +1,157 @@
+#include "active_object.h"
+
+#include "tools/catch.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+namespace {
+
+struct TestTask: ISRTaskQueue::Task {
+    unsigned producer;
+    unsigned seq;
+    std::vector<TestTask*>* log;
+
+    TestTask(unsigned producer = 0, unsigned seq = 0, std::vector<TestTask*>* log = nullptr) :
+            producer(producer),
+            seq(seq),
+            log(log) {
+        func = execute;
+    }
+
+    static void execute(ISRTaskQueue::Task* task) {
+        const auto t = static_cast<TestTask*>(task);
+        t->log->push_back(t);
+    }
+};
+
+} // namespace
+
+TEST_CASE("ISRTaskQueue") {
+    ISRTaskQueue queue;
+    std::vector<TestTask*> log;
+    std::vector<TestTask> tasks;
+    for (unsigned i = 0; i < 20; ++i) {
+        tasks.emplace_back(0, i, &log);
+    }
+
+    SECTION("empty queue") {
+        CHECK(!queue.process());
+        CHECK(queue.processBatch() == 0);
+        CHECK(queue.size() == 0);
+    }
+
+    SECTION("tasks are invoked in the order they were enqueued") {
+        for (auto& t: tasks) {
+            queue.enqueue(&t);
+        }
+        CHECK(queue.size() == tasks.size());
+        while (queue.process()) {
+        }
+        REQUIRE(log.size() == tasks.size());
+        for (size_t i = 0; i < log.size(); ++i) {
+            CHECK(log[i] == &tasks[i]);
+        }
+        CHECK(queue.size() == 0);
+        CHECK(queue.maxSize() == tasks.size());
+    }
+
+    SECTION("queue can be emptied and refilled") {
+        for (unsigned round = 0; round < 3; ++round) {
+            queue.enqueue(&tasks[0]);
+            CHECK(queue.process());
+            CHECK(!queue.process());
+            queue.enqueue(&tasks[1]);
+            queue.enqueue(&tasks[2]);
+            CHECK(queue.process());
+            queue.enqueue(&tasks[0]);
+            CHECK(queue.process());
+            CHECK(queue.process());
+            CHECK(!queue.process());
+        }
+        CHECK(log.size() == 12);
+        CHECK(queue.maxSize() == 2);
+    }
+
+    SECTION("batch size is limited") {
+        for (auto& t: tasks) {
+            queue.enqueue(&t);
+        }
+        CHECK(queue.processBatch() == ISRTaskQueue::DEFAULT_BATCH_SIZE);
+        CHECK(queue.processBatch(5) == 5);
+        CHECK(queue.processBatch(100) == tasks.size() - ISRTaskQueue::DEFAULT_BATCH_SIZE - 5);
+        CHECK(log.size() == tasks.size());
+    }
+
+    SECTION("task can be reenqueued while it is being invoked") {
+        struct Requeue: ISRTaskQueue::Task {
+            ISRTaskQueue* queue;
+            int count;
+        } t;
+        t.queue = &queue;
+        t.count = 0;
+        t.func = [](ISRTaskQueue::Task* task) {
+            const auto t = static_cast<Requeue*>(task);
+            if (++t->count < 3) {
+                t->queue->enqueue(t);
+            }
+        };
+        queue.enqueue(&t);
+        CHECK(queue.processBatch(100) == 3);
+        CHECK(t.count == 3);
+    }
+}
+
+// Producer threads take the place of ISRs enqueueing tasks while the consumer thread processes them
+TEST_CASE("ISRTaskQueue concurrent producers") {
+    const unsigned PRODUCERS = 4;
+    const unsigned TASKS_PER_PRODUCER = 50000;
+    ISRTaskQueue queue;
+    std::vector<TestTask*> log;
+    log.reserve(PRODUCERS * TASKS_PER_PRODUCER);
+    std::vector<std::vector<TestTask>> tasks(PRODUCERS);
+    for (unsigned p = 0; p < PRODUCERS; ++p) {
+        for (unsigned i = 0; i < TASKS_PER_PRODUCER; ++i) {
+            tasks[p].emplace_back(p, i, &log);
+        }
+    }
+
+    std::atomic_bool start(false);
+    std::vector<std::thread> producers;
+    for (unsigned p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&, p]() {
+            while (!start) {
+            }
+            for (auto& t: tasks[p]) {
+                queue.enqueue(&t);
+            }
+        });
+    }
+    start = true;
+    while (log.size() < PRODUCERS * TASKS_PER_PRODUCER) {
+        if (!queue.processBatch()) {
+            std::this_thread::yield();
+        }
+    }
+    for (auto& t: producers) {
+        t.join();
+    }
+
+    CHECK(!queue.process());
+    CHECK(queue.size() == 0);
+    CHECK(queue.maxSize() > 0);
+    CHECK(queue.maxSize() <= PRODUCERS * TASKS_PER_PRODUCER);
+    // Every task is invoked once, in the order it was enqueued by its producer
+    std::vector<unsigned> next(PRODUCERS, 0);
+    bool ordered = true;
+    for (const TestTask* t: log) {
+        if (t->seq != next[t->producer]++) {
+            ordered = false;
+        }
+    }
+    CHECK(ordered);
+    for (unsigned p = 0; p < PRODUCERS; ++p) {
+        CHECK(next[p] == TASKS_PER_PRODUCER);
+    }
+}
@@ -552,6 +552,134 @@ TEST_CASE("LEDStatus") {
 
         LED_RGB_SetChangeHandler(nullptr, nullptr);
     }
+
+    SECTION("event-driven updates") {
+        SECTION("LED is not updated while solid color is shown") {
+            LEDStatus s(Color::RED);
+            s.setActive();
+            CHECK(led_update_pending(nullptr) == 1);
+            CHECK(led_process(0, nullptr) == LED_UPDATE_IDLE);
+            CHECK(led.color() == Color::RED);
+            CHECK(led_update_pending(nullptr) == 0);
+            s.setColor(Color::GREEN); // Changing status parameters schedules an update
+            CHECK(led_update_pending(nullptr) == 1);
+            CHECK(led_process(0, nullptr) == LED_UPDATE_IDLE);
+            CHECK(led.color() == Color::GREEN);
+            LED_SetBrightness(128); // ditto for LED brightness
+            CHECK(led_update_pending(nullptr) == 1);
+            CHECK(led_process(0, nullptr) == LED_UPDATE_IDLE);
+            CHECK(led.color() == Color(0, 128, 0));
+            LED_SetBrightness(255);
+            s.off();
+            CHECK(led_update_pending(nullptr) == 1);
+            CHECK(led_process(0, nullptr) == LED_UPDATE_IDLE);
+            CHECK(led.color() == Color::BLACK);
+        }
+
+        SECTION("blinking LED is updated twice per period") {
+            LEDStatus s(Color::BLUE, LED_PATTERN_BLINK);
+            s.setPeriod(1000);
+            s.setActive();
+            CHECK(led_process(0, nullptr) == 500);
+            CHECK(led.color() == Color::BLUE);
+            CHECK(led_process(500, nullptr) == 500);
+            CHECK(led.color() == Color::BLACK);
+            CHECK(led_process(500, nullptr) == 500);
+            CHECK(led.color() == Color::BLUE);
+            CHECK(led_process(600, nullptr) == 400); // Delayed update
+            CHECK(led.color() == Color::BLACK);
+            CHECK(led_update_pending(nullptr) == 0);
+        }
+
+        SECTION("fading LED is updated in steps") {
+            const auto checkFade = [&](int period, system_tick_t step) {
+                LEDStatus s(Color::WHITE, LED_PATTERN_FADE);
+                s.setPeriod(period);
+                s.setActive();
+                int ticks = 0;
+                int wakeups = 0;
+                system_tick_t delay = led_process(0, nullptr);
+                while (ticks < period * 2) {
+                    REQUIRE(delay == step);
+                    ticks += delay;
+                    delay = led_process(delay, nullptr);
+                    ++wakeups;
+                    const double t = (ticks % period) / (double)period;
+                    const Color c = (t < 0.5) ? Color::WHITE.scaled(1.0 - t / 0.5) : Color::WHITE.scaled((t - 0.5) / 0.5);
+                    REQUIRE(led.color() == c);
+                }
+                CHECK(ticks == period * 2);
+                CHECK(wakeups == period * 2 / step);
+            };
+            SECTION("fast") {
+                checkFade(1000, 25);
+            }
+            SECTION("3s period") {
+                checkFade(3000, 25);
+            }
+            SECTION("slow") {
+                checkFade(8000, 25); // Slowest theme speed
+            }
+            SECTION("longer than the lookup table") {
+                checkFade(16000, 50);
+            }
+        }
+
+        SECTION("delayed update shows the color of the current step") {
+            LEDStatus s(Color::WHITE, LED_PATTERN_FADE);
+            s.setPeriod(1000);
+            s.setActive();
+            CHECK(led_process(0, nullptr) == 25);
+            CHECK(led_process(140, nullptr) == 10); // Step starting at 125ms
+            CHECK(led.color() == Color::WHITE.scaled(0.75));
+        }
+
+        SECTION("wakeup handler is invoked when LED state changes") {
+            int wakeups = 0;
+            led_set_wakeup_handler([](void* data) {
+                ++*static_cast<int*>(data);
+            }, &wakeups, nullptr);
+            LEDStatus s(Color::RED);
+            s.setActive();
+            CHECK(wakeups == 1);
+            led_process(0, nullptr);
+            s.setColor(Color::GREEN);
+            CHECK(wakeups == 2);
+            LED_SetBrightness(128);
+            CHECK(wakeups == 3);
+            LED_SetBrightness(255);
+            led_process(0, nullptr);
+            led_set_update_enabled(0, nullptr);
+            led_set_update_enabled(1, nullptr);
+            CHECK(wakeups == 6);
+            led_set_wakeup_handler(nullptr, nullptr, nullptr);
+            s.setActive(false);
+            CHECK(wakeups == 6);
+        }
+
+        SECTION("custom pattern is updated periodically") {
+            CustomStatus s(300, [](double t) {
+                return (t < 0.5) ? Color::RED : Color::GREEN;
+            });
+            s.setActive();
+            CHECK(led_process(0, nullptr) == LED_CUSTOM_PATTERN_UPDATE_INTERVAL);
+            CHECK(led.color() == Color::RED);
+            // Changing color in the pattern callback doesn't trigger another update
+            CHECK(led_update_pending(nullptr) == 0);
+        }
+
+        SECTION("LED is not updated while updates are disabled") {
+            LEDStatus s(Color::WHITE, LED_PATTERN_BLINK);
+            s.setActive();
+            led_process(0, nullptr);
+            led_set_update_enabled(0, nullptr);
+            CHECK(led_update_pending(nullptr) == 1);
+            CHECK(led_process(0, nullptr) == LED_UPDATE_IDLE);
+            led_set_update_enabled(1, nullptr);
+            CHECK(led_update_pending(nullptr) == 1);
+            CHECK(led_process(0, nullptr) != LED_UPDATE_IDLE);
+        }
+    }
 }
 
 TEST_CASE("LEDSystemTheme") {
@@ -0,0 +1,243 @@
+#include "spark_wiring_mesh_publish.h"
+
+#include "system_error.h"
+
+#include "tools/catch.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdio>
+
+namespace {
+
+using namespace spark::mesh;
+
+typedef std::vector<std::pair<std::string, std::string>> Events;
+
+void addEvent(const char* name, const char* data, void* ctx) {
+    static_cast<Events*>(ctx)->push_back(std::make_pair(name, data));
+}
+
+Events parse(const std::string& packet) {
+    Events events;
+    const int n = parseEventPacket(packet.data(), packet.size(), addEvent, &events);
+    REQUIRE(n == (int)events.size());
+    return events;
+}
+
+int parseError(const std::string& packet) {
+    Events events;
+    const int ret = parseEventPacket(packet.data(), packet.size(), addEvent, &events);
+    CHECK(events.empty());
+    return ret;
+}
+
+} // namespace
+
+TEST_CASE("SubscriptionFilter") {
+    SECTION("empty filter matches nothing") {
+        SubscriptionFilter f;
+        CHECK(f.isEmpty());
+        CHECK(!f.mayMatch("a"));
+        CHECK(!f.mayMatch(""));
+    }
+
+    SECTION("prefixes match the events that start with them") {
+        SubscriptionFilter f;
+        f.add("temp");
+        f.add("door/");
+        CHECK(!f.isEmpty());
+        CHECK(f.mayMatch("temp"));
+        CHECK(f.mayMatch("temperature"));
+        CHECK(f.mayMatch("door/open"));
+        CHECK(!f.mayMatch("tem"));
+        CHECK(!f.mayMatch("door"));
+    }
+
+    SECTION("empty prefix matches every event") {
+        SubscriptionFilter f;
+        f.add("");
+        CHECK(f.mayMatch("a"));
+        CHECK(f.mayMatch("any/event"));
+    }
+
+    SECTION("merged filter matches the prefixes of both filters") {
+        SubscriptionFilter f1, f2;
+        f1.add("a/");
+        f2.add("b/");
+        f1.merge(f2);
+        CHECK(f1.mayMatch("a/1"));
+        CHECK(f1.mayMatch("b/1"));
+        f1.clear();
+        CHECK(f1.isEmpty());
+    }
+
+    SECTION("false positive rate is low for a few subscriptions") {
+        SubscriptionFilter f;
+        char name[32] = {};
+        for (int i = 0; i < 5; ++i) {
+            snprintf(name, sizeof(name), "sub%d/", i);
+            f.add(name);
+        }
+        int falsePositives = 0;
+        for (int i = 0; i < 1000; ++i) {
+            snprintf(name, sizeof(name), "other%d/event", i);
+            if (f.mayMatch(name)) {
+                ++falsePositives;
+            }
+        }
+        CHECK(falsePositives < 50);
+    }
+}
+
+TEST_CASE("EventPacketWriter") {
+    char buf[64] = {};
+    EventPacketWriter w(buf, sizeof(buf));
+
+    SECTION("events can be parsed back") {
+        REQUIRE(w.add("a", "1") == 0);
+        REQUIRE(w.add("bb", nullptr) == 0);
+        REQUIRE(w.add("ccc", "333") == 0);
+        CHECK(w.count() == 3);
+        CHECK(w.size() == 1 + 4 + 4 + 8);
+        const auto events = parse(std::string(w.data(), w.size()));
+        REQUIRE(events.size() == 3);
+        CHECK(events[0] == std::make_pair(std::string("a"), std::string("1")));
+        CHECK(events[1] == std::make_pair(std::string("bb"), std::string("")));
+        CHECK(events[2] == std::make_pair(std::string("ccc"), std::string("333")));
+    }
+
+    SECTION("events that don't fit are rejected") {
+        const std::string data(50, 'x');
+        REQUIRE(w.add("a", data.c_str()) == 0);
+        const size_t size = w.size();
+        CHECK(w.add("b", data.c_str()) == SYSTEM_ERROR_TOO_LARGE);
+        CHECK(w.size() == size);
+        CHECK(w.count() == 1);
+        w.reset();
+        CHECK(w.count() == 0);
+        CHECK(w.add("b", data.c_str()) == 0);
+    }
+
+    SECTION("packetSize() returns the size of a single event packet") {
+        CHECK(EventPacketWriter::packetSize("abc", "de") == 1 + 4 + 3);
+        CHECK(EventPacketWriter::packetSize("abc", nullptr) == 1 + 4 + 1);
+    }
+}
+
+TEST_CASE("parseEventPacket()") {
+    SECTION("single event packets are compatible with older firmware") {
+        auto events = parse(std::string("\0abc\0def\0", 9));
+        REQUIRE(events.size() == 1);
+        CHECK(events[0] == std::make_pair(std::string("abc"), std::string("def")));
+        // Data is optional
+        events = parse(std::string("\0abc\0", 5));
+        REQUIRE(events.size() == 1);
+        CHECK(events[0] == std::make_pair(std::string("abc"), std::string("")));
+    }
+
+    SECTION("malformed packets are rejected") {
+        CHECK(parseError(std::string()) == SYSTEM_ERROR_BAD_DATA);
+        CHECK(parseError(std::string("\0", 1)) == SYSTEM_ERROR_BAD_DATA);
+        CHECK(parseError(std::string("\0abc", 4)) == SYSTEM_ERROR_BAD_DATA);
+        CHECK(parseError(std::string("\0\0", 2)) == SYSTEM_ERROR_BAD_DATA);
+        CHECK(parseError(std::string("\0a\0b\0c\0", 7)) == SYSTEM_ERROR_BAD_DATA);
+        // An invalid event in the middle of a packet
+        CHECK(parseError(std::string("\1a\0\0\0b\0", 7)) == SYSTEM_ERROR_BAD_DATA);
+        // Missing data
+        CHECK(parseError(std::string("\1a\0b\0c\0", 7)) == SYSTEM_ERROR_BAD_DATA);
+        // Unknown packet type
+        CHECK(parseError(std::string("\7a\0b\0", 5)) == SYSTEM_ERROR_BAD_DATA);
+    }
+}
+
+TEST_CASE("SubscriptionSummary") {
+    const system_tick_t GEN = 1000;
+    SubscriptionSummary s(GEN);
+    s.reset(0);
+    SubscriptionFilter f;
+    f.add("a/");
+
+    SECTION("all events have subscribers until the first generation is complete") {
+        CHECK(s.mayHaveSubscribers("b/1", 0));
+        CHECK(s.mayHaveSubscribers("b/1", GEN - 1));
+        CHECK(!s.mayHaveSubscribers("b/1", GEN));
+    }
+
+    SECTION("advertised subscriptions expire after two generations") {
+        s.update(f, 500);
+        CHECK(s.mayHaveSubscribers("a/1", 1500));
+        CHECK(!s.mayHaveSubscribers("b/1", 1500));
+        CHECK(s.mayHaveSubscribers("a/1", 2400));
+        CHECK(!s.mayHaveSubscribers("a/1", 2600));
+    }
+
+    SECTION("periodic advertisements keep the subscriptions") {
+        for (system_tick_t t = 100; t < 10000; t += GEN / 2) {
+            s.update(f, t);
+            CHECK(s.mayHaveSubscribers("a/1", t + 1));
+        }
+    }
+
+    SECTION("subscriptions are forgotten after a long period of inactivity") {
+        s.update(f, 100);
+        CHECK(!s.mayHaveSubscribers("a/1", 10000));
+    }
+}
+
+// Number of datagrams sent per delivered event, run with the [benchmark] tag. Half of the
+// published events have subscribers, the events are published in bursts that fit into the
+// aggregation window
+TEST_CASE("Mesh.publish() packets per delivered event", "[.][benchmark]") {
+    const unsigned BURSTS = 1000;
+    const unsigned BURST_SIZE = 10;
+    const system_tick_t BURST_INTERVAL = 1000;
+    const system_tick_t ADVERTISEMENT_INTERVAL = 60000;
+
+    SubscriptionFilter subscriber;
+    subscriber.add("bench/sub");
+    SubscriptionSummary summary(ADVERTISEMENT_INTERVAL * 2);
+    summary.reset(0);
+
+    char buf[1232] = {};
+    EventPacketWriter batch(buf, sizeof(buf));
+    unsigned immediatePackets = 0;
+    unsigned aggregatedPackets = 0;
+    unsigned delivered = 0;
+    system_tick_t lastAdvertisement = 0;
+    summary.update(subscriber, 0);
+    ++aggregatedPackets;
+    char name[32] = {};
+    for (unsigned i = 0; i < BURSTS; ++i) {
+        const system_tick_t t = i * BURST_INTERVAL;
+        if (t - lastAdvertisement >= ADVERTISEMENT_INTERVAL) {
+            summary.update(subscriber, t);
+            lastAdvertisement = t;
+            ++aggregatedPackets;
+        }
+        for (unsigned j = 0; j < BURST_SIZE; ++j) {
+            const bool sub = (j % 2 == 0);
+            snprintf(name, sizeof(name), sub ? "bench/sub/%u" : "bench/nobody/%u", j);
+            ++immediatePackets;
+            if (sub) {
+                ++delivered;
+            }
+            if (summary.mayHaveSubscribers(name, t)) {
+                if (batch.add(name, "data") != 0) {
+                    ++aggregatedPackets;
+                    batch.reset();
+                    REQUIRE(batch.add(name, "data") == 0);
+                }
+            }
+        }
+        if (batch.count() > 0) {
+            ++aggregatedPackets;
+            batch.reset();
+        }
+    }
+    const double r1 = (double)immediatePackets / delivered;
+    const double r2 = (double)aggregatedPackets / delivered;
+    CATCH_WARN("Packets per delivered event, immediate: " << r1 << ", aggregated: " << r2);
+    CHECK(r2 < r1);
+}
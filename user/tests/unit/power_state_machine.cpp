@@ -0,0 +1,279 @@
+#include "power_state_machine.h"
+
+#include "system_error.h"
+
+#include "tools/catch.h"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace {
+
+using namespace particle::power;
+
+const system_tick_t HOUR = 60 * 60 * 1000;
+
+// PMIC status register values
+const uint8_t STATUS_DISCHARGING = 0x00;
+const uint8_t STATUS_USB_CHARGING = (0x01 << 6) | (0x01 << 4) | 0x04;
+const uint8_t STATUS_USB_CHARGED = (0x01 << 6) | (0x03 << 4) | 0x04;
+const uint8_t STATUS_USB_NOT_CHARGING = (0x01 << 6) | 0x04;
+
+// Simulated PMIC and fuel gauge. Counts the I2C transactions that the respective operations
+// take on the actual hardware
+class MockPmic: public PowerManagerIo {
+public:
+    uint8_t status = STATUS_DISCHARGING;
+    uint8_t fault = 0;
+    uint8_t misc = 0;
+    bool lowBatteryAlert = false;
+    float charge = 50.0f;
+    bool chargingEnabled = true;
+    uint16_t rechargeThreshold = 100;
+    system_tick_t time = 1000;
+
+    unsigned transactions = 0;
+    unsigned chargeReads = 0;
+    unsigned pmicInits = 0;
+    std::vector<std::pair<system_event_t, int>> events;
+
+    void readPmicStatus(PmicStatus* s) override {
+        transactions += 2; // REG09, then REG07-REG09 in a single transfer
+        s->misc = misc;
+        s->status = chargingEnabled ? status : (status & ~0x30);
+        s->fault = fault;
+    }
+
+    void initPmic(bool dpdm) override {
+        transactions += dpdm ? 10 : 8; // Read-modify-write of each configuration register
+        chargingEnabled = true;
+        rechargeThreshold = 100;
+        ++pmicInits;
+    }
+
+    void setRechargeThreshold(uint16_t voltage) override {
+        transactions += 2;
+        rechargeThreshold = voltage;
+    }
+
+    void disableCharging() override {
+        transactions += 2;
+        chargingEnabled = false;
+    }
+
+    void restoreInputCurrentLimit() override {
+        transactions += 1;
+    }
+
+    bool readLowBatteryAlert() override {
+        transactions += 1;
+        return lowBatteryAlert;
+    }
+
+    void clearLowBatteryAlert() override {
+        transactions += 2;
+        lowBatteryAlert = false;
+    }
+
+    float readBatteryCharge() override {
+        transactions += 2; // SOC register and charge voltage of the PMIC
+        ++chargeReads;
+        return charge;
+    }
+
+    void quickStartFuelGauge() override {
+        transactions += 1;
+    }
+
+    void notify(system_event_t event, int data) override {
+        events.push_back(std::make_pair(event, data));
+    }
+
+    system_tick_t millis() override {
+        return time;
+    }
+
+    bool hasEvent(system_event_t event, int data) const {
+        return std::find(events.begin(), events.end(), std::make_pair(event, data)) != events.end();
+    }
+};
+
+// Runs the state machine the same way the power manager thread does: the thread wakes up
+// when an interrupt is signaled or when the timeout returned by the state machine expires
+class Simulator {
+public:
+    explicit Simulator(MockPmic* pmic) :
+            sm(pmic),
+            wakeups(0),
+            pmic_(pmic),
+            wakeupTime_(pmic->time),
+            wakeupPending_(true) {
+    }
+
+    void interrupt() {
+        sm.update();
+        wakeupTime_ = pmic_->time;
+        wakeupPending_ = true;
+    }
+
+    // Advances the simulated time. If `chargeReadInterval` is not 0, the state of charge is
+    // requested with the specified interval, the way the diagnostics service would do it
+    void run(system_tick_t duration, system_tick_t chargeReadInterval = 0) {
+        const system_tick_t end = pmic_->time + duration;
+        system_tick_t nextRead = pmic_->time;
+        for (;;) {
+            system_tick_t t = end;
+            if (wakeupPending_) {
+                t = std::min(t, wakeupTime_);
+            }
+            if (chargeReadInterval) {
+                t = std::min(t, nextRead);
+            }
+            if (t >= end) {
+                break;
+            }
+            pmic_->time = t;
+            if (wakeupPending_ && wakeupTime_ == t) {
+                wakeupPending_ = false;
+                const system_tick_t timeout = sm.process();
+                ++wakeups;
+                if (timeout != PowerStateMachine::WAIT_FOREVER) {
+                    wakeupTime_ = t + timeout;
+                    wakeupPending_ = true;
+                }
+            } else {
+                float charge = 0.0f;
+                if (sm.batteryCharge(&charge) == 0) {
+                    lastCharge = charge;
+                }
+                nextRead += chargeReadInterval;
+            }
+        }
+        pmic_->time = end;
+    }
+
+    PowerStateMachine sm;
+    unsigned wakeups;
+    float lastCharge = 0.0f;
+
+private:
+    MockPmic* pmic_;
+    system_tick_t wakeupTime_;
+    bool wakeupPending_;
+};
+
+} // namespace
+
+TEST_CASE("PowerStateMachine") {
+    MockPmic pmic;
+
+    SECTION("the PMIC is only accessed on interrupts") {
+        Simulator sim(&pmic);
+        sim.run(HOUR);
+        CHECK(sim.sm.batteryState() == BATTERY_STATE_DISCHARGING);
+        CHECK(sim.sm.powerSource() == POWER_SOURCE_BATTERY);
+        CHECK(pmic.hasEvent(battery_state, BATTERY_STATE_DISCHARGING));
+        CHECK(pmic.hasEvent(power_source, POWER_SOURCE_BATTERY));
+        // Initial update only
+        CHECK(sim.wakeups == 1);
+        CHECK(pmic.transactions == 3);
+    }
+
+    SECTION("state changes are handled in a single update") {
+        Simulator sim(&pmic);
+        sim.run(10 * 60 * 1000);
+        const unsigned transactions = pmic.transactions;
+        pmic.status = STATUS_USB_CHARGING;
+        sim.interrupt();
+        sim.run(HOUR);
+        CHECK(sim.sm.batteryState() == BATTERY_STATE_CHARGING);
+        CHECK(sim.sm.powerSource() == POWER_SOURCE_USB_HOST);
+        CHECK(sim.wakeups == 2);
+        CHECK((pmic.transactions - transactions) == 3);
+    }
+
+    SECTION("interrupts received before the thread wakes up are coalesced") {
+        Simulator sim(&pmic);
+        sim.run(1000);
+        const unsigned transactions = pmic.transactions;
+        pmic.status = STATUS_USB_CHARGING;
+        sim.interrupt();
+        sim.interrupt();
+        sim.interrupt();
+        sim.run(1000);
+        CHECK(sim.wakeups == 2);
+        CHECK((pmic.transactions - transactions) == 3);
+    }
+
+    SECTION("low battery alert is reported once") {
+        Simulator sim(&pmic);
+        sim.run(1000);
+        pmic.lowBatteryAlert = true;
+        sim.interrupt();
+        sim.run(1000);
+        CHECK(!pmic.lowBatteryAlert);
+        pmic.lowBatteryAlert = true;
+        sim.interrupt();
+        sim.run(1000);
+        CHECK(std::count(pmic.events.begin(), pmic.events.end(), std::make_pair((system_event_t)low_battery, 0)) == 1);
+    }
+
+    SECTION("state of charge is cached") {
+        Simulator sim(&pmic);
+        // Request the state of charge every second for an hour
+        sim.run(HOUR, 1000);
+        CHECK(sim.lastCharge == 50.0f);
+        CHECK(pmic.chargeReads == HOUR / DEFAULT_BATTERY_CHARGE_MAX_AGE);
+        CHECK(pmic.transactions == 3 + pmic.chargeReads * 2);
+        // Cached value is never older than DEFAULT_BATTERY_CHARGE_MAX_AGE
+        pmic.charge = 49.0f;
+        sim.run(DEFAULT_BATTERY_CHARGE_MAX_AGE, 1000);
+        CHECK(sim.lastCharge == 49.0f);
+    }
+
+    SECTION("state of charge is not available while the battery is disconnected") {
+        Simulator sim(&pmic);
+        pmic.status = STATUS_USB_CHARGING;
+        sim.run(1000);
+        // Toggle between the charging and charged states until the state machine detects a
+        // missing battery
+        for (int i = 0; i < 20 && pmic.chargingEnabled; ++i) {
+            pmic.status = (i % 2) ? STATUS_USB_CHARGING : STATUS_USB_CHARGED;
+            sim.interrupt();
+            sim.run(50);
+        }
+        REQUIRE(sim.sm.batteryState() == BATTERY_STATE_DISCONNECTED);
+        float charge = 0.0f;
+        CHECK(sim.sm.batteryCharge(&charge) == SYSTEM_ERROR_INVALID_STATE);
+    }
+
+    SECTION("charging is re-enabled after a timeout when battery is disconnected") {
+        Simulator sim(&pmic);
+        pmic.status = STATUS_USB_CHARGING;
+        sim.run(1000);
+        CHECK(sim.sm.batteryState() == BATTERY_STATE_CHARGING);
+        for (int i = 0; i < 20 && pmic.chargingEnabled; ++i) {
+            pmic.status = (i % 2) ? STATUS_USB_CHARGING : STATUS_USB_CHARGED;
+            sim.interrupt();
+            sim.run(50);
+        }
+        REQUIRE(sim.sm.batteryState() == BATTERY_STATE_DISCONNECTED);
+        CHECK(!pmic.chargingEnabled);
+        CHECK(pmic.hasEvent(battery_state, BATTERY_STATE_DISCONNECTED));
+        // Charging is disabled: the PMIC reports that the battery is not charging
+        pmic.status = STATUS_USB_NOT_CHARGING;
+        sim.interrupt();
+        const unsigned wakeups = sim.wakeups;
+        sim.run(DEFAULT_WATCHDOG_TIMEOUT - 100);
+        CHECK(sim.sm.batteryState() == BATTERY_STATE_DISCONNECTED);
+        CHECK(!pmic.chargingEnabled);
+        // The thread sleeps until the timeout expires
+        CHECK((sim.wakeups - wakeups) == 1);
+        pmic.status = STATUS_USB_CHARGING;
+        sim.run(HOUR);
+        CHECK(pmic.chargingEnabled);
+        CHECK(sim.sm.batteryState() == BATTERY_STATE_CHARGING);
+        CHECK((sim.wakeups - wakeups) == 2);
+    }
+}
@@ -0,0 +1,544 @@
+#include "ppp_hdlc.h"
+
+#include "tools/catch.h"
+
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+using namespace particle::net::ppp;
+
+const size_t POOL_BUFFER_SIZE = 1516; // PBUF_POOL_BUFSIZE on the Boron
+const size_t MUXER_FRAME_SIZE = 1509; // UBLOX_NCP_MAX_MUXER_FRAME_SIZE
+
+// Collects the decoded frames, the buffers are allocated from a fixed-size pool the same way
+// pbufs are allocated from PBUF_POOL
+class TestFrameBuffer: public HdlcFrameBuffer {
+public:
+    explicit TestFrameBuffer(size_t bufSize = POOL_BUFFER_SIZE, size_t poolSize = 16) :
+            bufSize_(bufSize),
+            poolSize_(poolSize),
+            used_(0) {
+    }
+
+    uint8_t* acquire(size_t* size) override {
+        if (used_ + bufs_.size() >= poolSize_) {
+            return nullptr;
+        }
+        bufs_.push_back(std::string(bufSize_, '\0'));
+        *size = bufSize_;
+        return (uint8_t*)&bufs_.back()[0];
+    }
+
+    void commit(size_t size) override {
+        frame_.append(bufs_.back().data(), size);
+    }
+
+    void complete() override {
+        REQUIRE(frame_.size() >= 4);
+        frames.push_back(frame_.substr(0, frame_.size() - 2));
+        reset();
+    }
+
+    void abort() override {
+        ++aborted;
+        reset();
+    }
+
+    // Number of buffers held by the application
+    void use(size_t count) {
+        used_ = count;
+    }
+
+    std::vector<std::string> frames;
+    unsigned aborted = 0;
+
+private:
+    std::vector<std::string> bufs_;
+    std::string frame_;
+    size_t bufSize_;
+    size_t poolSize_;
+    size_t used_;
+
+    void reset() {
+        bufs_.clear();
+        frame_.clear();
+    }
+};
+
+// Conventional byte-wise FCS computation
+uint16_t referenceFcs(uint16_t fcs, const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        fcs ^= data[i];
+        for (int j = 0; j < 8; ++j) {
+            fcs = (fcs & 1) ? (fcs >> 1) ^ 0x8408 : (fcs >> 1);
+        }
+    }
+    return fcs;
+}
+
+bool needsEscape(uint8_t c, uint32_t accm) {
+    return c == HDLC_FLAG || c == HDLC_ESCAPE || (c < 0x20 && (accm & (1ul << c)));
+}
+
+// Encodes a PPP frame, `data` is the protocol field followed by the information field
+std::string encode(const std::string& data, uint32_t accm = 0xffffffff, bool acfc = false, bool pfc = false) {
+    std::string frame;
+    if (!acfc) {
+        frame += (char)HDLC_ALLSTATIONS;
+        frame += (char)HDLC_UI;
+    }
+    size_t offs = 0;
+    if (pfc && data.size() >= 2 && data[0] == 0 && (data[1] & 1)) {
+        offs = 1;
+    }
+    frame.append(data, offs, std::string::npos);
+    const uint16_t fcs = ~hdlcFcs(HDLC_INITFCS, (const uint8_t*)frame.data(), frame.size());
+    frame += (char)(fcs & 0xff);
+    frame += (char)(fcs >> 8);
+    std::string out;
+    out += (char)HDLC_FLAG;
+    for (char c: frame) {
+        if (needsEscape(c, accm)) {
+            out += (char)HDLC_ESCAPE;
+            out += (char)(c ^ HDLC_TRANS);
+        } else {
+            out += c;
+        }
+    }
+    out += (char)HDLC_FLAG;
+    return out;
+}
+
+int appendOutput(const uint8_t* data, size_t size, void* ctx) {
+    static_cast<std::string*>(ctx)->append((const char*)data, size);
+    return size;
+}
+
+std::string randomBytes(std::mt19937& gen, size_t size) {
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::string s;
+    s.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        s += (char)dist(gen);
+    }
+    return s;
+}
+
+// IPv4 packet with the PPP protocol field
+std::string ipFrame(std::mt19937& gen, size_t size) {
+    return std::string("\x00\x21", 2) + randomBytes(gen, size);
+}
+
+void feed(HdlcDecoder* d, const std::string& data) {
+    d->input((const uint8_t*)data.data(), data.size());
+}
+
+// Random data in which the specified fraction of bytes needs escaping
+std::string escapeDensityData(std::mt19937& gen, size_t size, double density) {
+    std::uniform_real_distribution<double> p(0.0, 1.0);
+    std::uniform_int_distribution<int> clean(0x20, 0xff);
+    std::string s;
+    s.reserve(size);
+    while (s.size() < size) {
+        if (p(gen) < density) {
+            s += (char)((s.size() % 2) ? HDLC_FLAG : HDLC_ESCAPE);
+        } else {
+            const int c = clean(gen);
+            if (c != HDLC_FLAG && c != HDLC_ESCAPE) {
+                s += (char)c;
+            }
+        }
+    }
+    return s;
+}
+
+// Simulated traffic captured on the PPP channel of the muxer: HDLC-encoded IP packets of
+// typical sizes split into muxer frames
+std::vector<std::string> captureTraffic(std::mt19937& gen, size_t total, std::vector<std::string>* packets) {
+    const size_t sizes[] = { 40, 52, 576, 1200, 1460, 1460, 1460, 1500 };
+    std::uniform_int_distribution<size_t> dist(0, sizeof(sizes) / sizeof(sizes[0]) - 1);
+    std::string stream;
+    while (stream.size() < total) {
+        const auto p = ipFrame(gen, sizes[dist(gen)]);
+        if (packets) {
+            packets->push_back(p);
+        }
+        stream += encode(p);
+    }
+    std::vector<std::string> frames;
+    for (size_t offs = 0; offs < stream.size(); offs += MUXER_FRAME_SIZE) {
+        frames.push_back(stream.substr(offs, MUXER_FRAME_SIZE));
+    }
+    return frames;
+}
+
+} // namespace
+
+TEST_CASE("HdlcDecoder") {
+    std::mt19937 gen(12345);
+    TestFrameBuffer buf;
+    HdlcDecoder d(&buf);
+
+    SECTION("decodes frames with escaped characters") {
+        std::string p = ipFrame(gen, 300);
+        p[10] = (char)HDLC_FLAG;
+        p[11] = (char)HDLC_ESCAPE;
+        p[12] = 0x01;
+        feed(&d, encode(p));
+        REQUIRE(buf.frames.size() == 1);
+        CHECK(buf.frames[0] == p);
+        CHECK(d.stats().frames == 1);
+    }
+
+    SECTION("frames split into arbitrary chunks are decoded") {
+        std::vector<std::string> packets;
+        std::string stream;
+        for (int i = 0; i < 20; ++i) {
+            packets.push_back(ipFrame(gen, 1 + i * 70));
+            stream += encode(packets.back());
+        }
+        std::uniform_int_distribution<size_t> dist(1, 200);
+        for (size_t offs = 0; offs < stream.size();) {
+            const size_t n = std::min(dist(gen), stream.size() - offs);
+            feed(&d, stream.substr(offs, n));
+            offs += n;
+        }
+        CHECK(buf.frames == packets);
+        CHECK(buf.aborted == 0);
+    }
+
+    SECTION("frames spanning multiple buffers are decoded") {
+        TestFrameBuffer small(64);
+        HdlcDecoder d2(&small);
+        const auto p = ipFrame(gen, 500);
+        feed(&d2, encode(p));
+        REQUIRE(small.frames.size() == 1);
+        CHECK(small.frames[0] == p);
+    }
+
+    SECTION("compressed address, control and protocol fields are expanded") {
+        const auto p = ipFrame(gen, 100);
+        feed(&d, encode(p, 0xffffffff, true /* acfc */, true /* pfc */));
+        // LCP frames are never compressed
+        const std::string lcp = std::string("\xc0\x21", 2) + "\x01\x01\x00\x04";
+        feed(&d, encode(lcp, 0xffffffff, true /* acfc */, false /* pfc */));
+        REQUIRE(buf.frames.size() == 2);
+        CHECK(buf.frames[0] == p);
+        CHECK(buf.frames[1] == lcp);
+    }
+
+    SECTION("frames with invalid FCS are dropped") {
+        const auto p1 = ipFrame(gen, 100);
+        auto f = encode(p1);
+        f[20] ^= 0x40;
+        const auto p2 = ipFrame(gen, 100);
+        feed(&d, f + encode(p2));
+        REQUIRE(buf.frames.size() == 1);
+        CHECK(buf.frames[0] == p2);
+        CHECK(d.stats().fcsErrors == 1);
+        CHECK(buf.aborted == 1);
+    }
+
+    SECTION("control characters in the receive ACCM are discarded") {
+        const auto p = ipFrame(gen, 100);
+        d.setAccm(0x000a0000);
+        auto f = encode(p, 0x000a0000);
+        f.insert(30, "\x11\x13\x11");
+        feed(&d, f);
+        REQUIRE(buf.frames.size() == 1);
+        CHECK(buf.frames[0] == p);
+    }
+
+    SECTION("data outside frames is ignored") {
+        const auto p = ipFrame(gen, 100);
+        feed(&d, "\r\nCONNECT\r\n" + encode(p));
+        REQUIRE(buf.frames.size() == 1);
+        CHECK(buf.frames[0] == p);
+    }
+
+    SECTION("aborted frames are dropped") {
+        auto f = encode(ipFrame(gen, 100));
+        f.insert(50, "\x7d\x7e");
+        f.resize(52);
+        const auto p = ipFrame(gen, 100);
+        feed(&d, f + encode(p));
+        REQUIRE(buf.frames.size() == 1);
+        CHECK(buf.frames[0] == p);
+        CHECK(d.stats().formatErrors == 1);
+    }
+
+    SECTION("frames are dropped when no buffers are available") {
+        const auto p = ipFrame(gen, 100);
+        buf.use(16);
+        feed(&d, encode(p));
+        CHECK(buf.frames.empty());
+        CHECK(d.stats().noMemory == 1);
+        buf.use(0);
+        feed(&d, encode(p));
+        REQUIRE(buf.frames.size() == 1);
+        CHECK(buf.frames[0] == p);
+    }
+
+    SECTION("captured muxer traffic is decoded") {
+        std::vector<std::string> packets;
+        const auto traffic = captureTraffic(gen, 256 * 1024, &packets);
+        for (const auto& f: traffic) {
+            feed(&d, f);
+        }
+        CHECK(buf.frames == packets);
+        CHECK(d.stats().frames == packets.size());
+    }
+}
+
+TEST_CASE("hdlcFcs()") {
+    std::mt19937 gen(1);
+    for (size_t size = 0; size < 64; ++size) {
+        const auto d = randomBytes(gen, size);
+        const auto p = (const uint8_t*)d.data();
+        CHECK(hdlcFcs(HDLC_INITFCS, p, size) == referenceFcs(HDLC_INITFCS, p, size));
+        // Incremental computation
+        const size_t half = size / 2;
+        CHECK(hdlcFcs(hdlcFcs(HDLC_INITFCS, p, half), p + half, size - half) == referenceFcs(HDLC_INITFCS, p, size));
+    }
+}
+
+TEST_CASE("HdlcEncoder") {
+    std::mt19937 gen(12345);
+    std::string out;
+    uint8_t buf[64];
+    HdlcEncoder e(buf, sizeof(buf), appendOutput, &out);
+
+    auto encodeFrame = [&](const std::string& data) {
+        std::string frame = std::string("\xff\x03", 2) + data;
+        e.begin();
+        // Write the frame in portions of different size
+        std::uniform_int_distribution<size_t> dist(1, 100);
+        for (size_t offs = 0; offs < frame.size();) {
+            const size_t n = std::min(dist(gen), frame.size() - offs);
+            e.write((const uint8_t*)frame.data() + offs, n);
+            offs += n;
+        }
+        REQUIRE(e.end() == 0);
+    };
+
+    SECTION("output matches the reference encoder") {
+        for (int i = 0; i < 50; ++i) {
+            const auto p = ipFrame(gen, i * 30);
+            out.clear();
+            encodeFrame(p);
+            CHECK(out == encode(p));
+        }
+    }
+
+    SECTION("only flag and escape characters are escaped with an empty ACCM") {
+        e.setAccm(0);
+        std::string p = ipFrame(gen, 500);
+        p[3] = 0x01;
+        p[4] = (char)HDLC_FLAG;
+        encodeFrame(p);
+        CHECK(out == encode(p, 0));
+    }
+
+    SECTION("encoded frames can be decoded") {
+        TestFrameBuffer fb;
+        HdlcDecoder d(&fb);
+        std::vector<std::string> packets;
+        for (int i = 0; i < 20; ++i) {
+            packets.push_back(std::string("\x00\x21", 2) + escapeDensityData(gen, 1 + i * 70, 0.1));
+            encodeFrame(packets.back());
+        }
+        feed(&d, out);
+        CHECK(fb.frames == packets);
+    }
+
+    SECTION("output errors are reported") {
+        HdlcEncoder e2(buf, sizeof(buf), [](const uint8_t* data, size_t size, void* ctx) -> int {
+            return -1;
+        }, nullptr);
+        e2.begin();
+        const auto p = ipFrame(gen, 10);
+        e2.write((const uint8_t*)p.data(), p.size());
+        CHECK(e2.end() == -1);
+    }
+}
+
+// Replays the captured muxer traffic through the decoder, run with the [benchmark] tag.
+// The previous implementation copied each muxer frame into a temporary pbuf chain before
+// unescaping it into the final pbufs (pppos_input_tcpip())
+TEST_CASE("HdlcDecoder throughput", "[.][benchmark]") {
+    std::mt19937 gen(1);
+    const auto traffic = captureTraffic(gen, 4 * 1024 * 1024, nullptr);
+    size_t total = 0;
+    for (const auto& f: traffic) {
+        total += f.size();
+    }
+    const unsigned ROUNDS = 16;
+    TestFrameBuffer buf1;
+    HdlcDecoder d1(&buf1);
+    std::vector<char> tmp(POOL_BUFFER_SIZE * 2);
+    const auto t1 = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < ROUNDS; ++i) {
+        for (const auto& f: traffic) {
+            memcpy(tmp.data(), f.data(), f.size());
+            d1.input((const uint8_t*)tmp.data(), f.size());
+        }
+        buf1.frames.clear();
+    }
+    const auto t2 = std::chrono::steady_clock::now();
+    TestFrameBuffer buf2;
+    HdlcDecoder d2(&buf2);
+    for (unsigned i = 0; i < ROUNDS; ++i) {
+        for (const auto& f: traffic) {
+            d2.input((const uint8_t*)f.data(), f.size());
+        }
+        buf2.frames.clear();
+    }
+    const auto t3 = std::chrono::steady_clock::now();
+    const double r1 = total * ROUNDS / std::chrono::duration<double>(t2 - t1).count();
+    const double r2 = total * ROUNDS / std::chrono::duration<double>(t3 - t2).count();
+    CATCH_WARN("Copy then decode: " << (uint64_t)r1 << " bytes/s, direct decode: " << (uint64_t)r2 << " bytes/s");
+    CHECK(d2.stats().frames == d1.stats().frames);
+}
+
+namespace {
+
+// Byte-wise table-driven FCS computation (PPP_FCS() in lwIP)
+class ByteFcs {
+public:
+    ByteFcs() {
+        for (unsigned i = 0; i < 256; ++i) {
+            const uint8_t c = i;
+            table_[i] = referenceFcs(0, &c, 1);
+        }
+    }
+
+    uint16_t update(uint16_t fcs, uint8_t c) const {
+        return (fcs >> 8) ^ table_[(fcs ^ c) & 0xff];
+    }
+
+private:
+    uint16_t table_[256];
+};
+
+// Byte-wise framing, the way the pppos implementation in lwIP does it
+class ReferenceCodec {
+public:
+    std::string encode(const std::string& frame) {
+        std::string out;
+        out += (char)HDLC_FLAG;
+        uint16_t fcs = HDLC_INITFCS;
+        for (char c: frame) {
+            fcs = fcs_.update(fcs, c);
+            putEscaped(&out, c);
+        }
+        fcs = ~fcs;
+        putEscaped(&out, fcs & 0xff);
+        putEscaped(&out, fcs >> 8);
+        out += (char)HDLC_FLAG;
+        return out;
+    }
+
+    size_t decode(const std::string& data, std::string* frame) {
+        size_t frames = 0;
+        for (char ch: data) {
+            uint8_t c = ch;
+            if (c == HDLC_FLAG) {
+                if (rxFcs_ == HDLC_GOODFCS && frame->size() >= 4) {
+                    ++frames;
+                }
+                frame->clear();
+                rxFcs_ = HDLC_INITFCS;
+                continue;
+            }
+            if (c == HDLC_ESCAPE) {
+                escaped_ = true;
+                continue;
+            }
+            if (escaped_) {
+                escaped_ = false;
+                c ^= HDLC_TRANS;
+            }
+            rxFcs_ = fcs_.update(rxFcs_, c);
+            *frame += (char)c;
+        }
+        return frames;
+    }
+
+private:
+    ByteFcs fcs_;
+    uint16_t rxFcs_ = HDLC_INITFCS;
+    bool escaped_ = false;
+
+    static void putEscaped(std::string* out, uint8_t c) {
+        if (needsEscape(c, 0)) {
+            *out += (char)HDLC_ESCAPE;
+            *out += (char)(c ^ HDLC_TRANS);
+        } else {
+            *out += (char)c;
+        }
+    }
+};
+
+} // namespace
+
+// Framing throughput at different escape densities, run with the [benchmark] tag. The ACCM is
+// empty, as negotiated by the modem
+TEST_CASE("HDLC framing throughput", "[.][benchmark]") {
+    const size_t FRAME_SIZE = 1500;
+    const size_t TOTAL = 16 * 1024 * 1024;
+    const double densities[] = { 0.0, 0.01, 2.0 / 256, 0.1 };
+    for (double density: densities) {
+        std::mt19937 gen(1);
+        const std::string frame = std::string("\xff\x03\x00\x21", 4) + escapeDensityData(gen, FRAME_SIZE, density);
+        const size_t count = TOTAL / frame.size();
+        ReferenceCodec ref;
+        std::string refOut;
+        auto t1 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            refOut = ref.encode(frame);
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        std::string out;
+        uint8_t buf[1024];
+        HdlcEncoder e(buf, sizeof(buf), appendOutput, &out);
+        e.setAccm(0);
+        for (size_t i = 0; i < count; ++i) {
+            out.clear();
+            e.begin();
+            e.write((const uint8_t*)frame.data(), frame.size());
+            e.end();
+        }
+        auto t3 = std::chrono::steady_clock::now();
+        REQUIRE(out == refOut);
+        const double enc1 = TOTAL / std::chrono::duration<double>(t2 - t1).count();
+        const double enc2 = TOTAL / std::chrono::duration<double>(t3 - t2).count();
+
+        std::string refFrame;
+        size_t refFrames = 0;
+        t1 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            refFrames += ref.decode(out, &refFrame);
+        }
+        t2 = std::chrono::steady_clock::now();
+        TestFrameBuffer fb;
+        HdlcDecoder d(&fb);
+        d.setAccm(0);
+        for (size_t i = 0; i < count; ++i) {
+            feed(&d, out);
+            fb.frames.clear();
+        }
+        t3 = std::chrono::steady_clock::now();
+        REQUIRE(refFrames == count);
+        REQUIRE(d.stats().frames == count);
+        const double dec1 = TOTAL / std::chrono::duration<double>(t2 - t1).count();
+        const double dec2 = TOTAL / std::chrono::duration<double>(t3 - t2).count();
+        CATCH_WARN("Escape density " << density << ", encoding: " << (uint64_t)enc1 << " -> " << (uint64_t)enc2 <<
+                " bytes/s, decoding: " << (uint64_t)dec1 << " -> " << (uint64_t)dec2 << " bytes/s");
+    }
+}
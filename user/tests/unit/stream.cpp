@@ -0,0 +1,206 @@
+#include "spark_wiring_stream.h"
+#include "ringbuffer.h"
+#include "system_error.h"
+
+// ringbuffer.h pulls in the firmware's CHECK() macros, which clash with the Catch ones
+#undef CHECK
+#undef CHECK_FALSE
+#include "tools/catch.h"
+
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+namespace {
+
+using particle::services::RingBuffer;
+
+// Stream that returns the data written to it. Zero-copy reading can be disabled to test the
+// default byte-wise implementation of the parsing methods
+class LoopbackStream: public Stream {
+public:
+    explicit LoopbackStream(size_t size, bool zeroCopy = true) :
+            readCount(0),
+            acquireCount(0),
+            data_(size),
+            zeroCopy_(zeroCopy) {
+        buf_.init(data_.data(), data_.size());
+        setTimeout(0);
+    }
+
+    size_t put(const char* data, size_t size) {
+        size = std::min(size, (size_t)buf_.space());
+        buf_.put(data, size);
+        return size;
+    }
+
+    size_t put(const std::string& s) {
+        return put(s.data(), s.size());
+    }
+
+    int available() override {
+        return buf_.data();
+    }
+
+    int read() override {
+        ++readCount;
+        char c = 0;
+        if (buf_.get(&c) != 1) {
+            return -1;
+        }
+        return (unsigned char)c;
+    }
+
+    int peek() override {
+        char c = 0;
+        if (buf_.peek(&c) != 1) {
+            return -1;
+        }
+        return (unsigned char)c;
+    }
+
+    void flush() override {
+    }
+
+    size_t write(uint8_t c) override {
+        return put((const char*)&c, 1);
+    }
+
+    int acquireRead(const char** data) override {
+        if (!zeroCopy_) {
+            return SYSTEM_ERROR_NOT_SUPPORTED;
+        }
+        ++acquireCount;
+        buf_.consumeCommit(0, buf_.consumePending());
+        const size_t size = buf_.consumable();
+        if (size > 0) {
+            *data = buf_.consume(size);
+        }
+        return size;
+    }
+
+    int commitRead(size_t size) override {
+        if (!zeroCopy_) {
+            return SYSTEM_ERROR_NOT_SUPPORTED;
+        }
+        buf_.consumeCommit(size, buf_.consumePending() - size);
+        return 0;
+    }
+
+    unsigned readCount;
+    unsigned acquireCount;
+
+private:
+    std::vector<char> data_;
+    RingBuffer<char> buf_;
+    bool zeroCopy_;
+};
+
+std::string randomString(std::mt19937& gen, size_t size) {
+    std::uniform_int_distribution<int> dist('a', 'z');
+    std::string s;
+    s.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        s += (char)dist(gen);
+    }
+    return s;
+}
+
+// Pumps `total` bytes through the stream in portions of the specified size and returns the
+// throughput in bytes per second
+double loopbackThroughput(LoopbackStream* strm, size_t total, size_t portion) {
+    std::mt19937 gen(1);
+    const std::string data = randomString(gen, portion);
+    std::string buf(portion, '\0');
+    size_t n = 0;
+    const auto t1 = std::chrono::steady_clock::now();
+    while (n < total) {
+        strm->put(data);
+        const size_t r = strm->readBytes(&buf[0], buf.size());
+        REQUIRE(r == portion);
+        n += r;
+    }
+    const auto t2 = std::chrono::steady_clock::now();
+    REQUIRE(buf == data);
+    const double sec = std::chrono::duration<double>(t2 - t1).count();
+    return (sec > 0) ? n / sec : 0;
+}
+
+} // namespace
+
+TEST_CASE("Stream") {
+    std::mt19937 gen(12345);
+
+    SECTION("readBytes() copies the data in blocks") {
+        LoopbackStream strm(100);
+        const std::string s1 = randomString(gen, 70);
+        REQUIRE(strm.put(s1) == 70);
+        std::string buf(50, '\0');
+        REQUIRE(strm.readBytes(&buf[0], buf.size()) == 50);
+        CHECK(buf == s1.substr(0, 50));
+        // The data wraps around the end of the ring buffer
+        const std::string s2 = randomString(gen, 60);
+        REQUIRE(strm.put(s2) == 60);
+        buf.assign(100, '\0');
+        REQUIRE(strm.readBytes(&buf[0], buf.size()) == 80);
+        CHECK(buf.substr(0, 80) == s1.substr(50) + s2);
+        // Only the last byte-wise read after the end of the data times out
+        CHECK(strm.readCount == 2);
+        CHECK(strm.available() == 0);
+    }
+
+    SECTION("readBytesUntil() stops at the terminator") {
+        LoopbackStream strm(100);
+        strm.put("abc\ndef\n");
+        char buf[16] = {};
+        REQUIRE(strm.readBytesUntil('\n', buf, sizeof(buf)) == 3);
+        CHECK(std::string(buf, 3) == "abc");
+        // The terminator is consumed
+        REQUIRE(strm.readBytesUntil('\n', buf, sizeof(buf)) == 3);
+        CHECK(std::string(buf, 3) == "def");
+        CHECK(strm.available() == 0);
+        CHECK(strm.readCount == 0);
+        // The buffer is filled before the terminator is found
+        strm.put("0123456789\n");
+        REQUIRE(strm.readBytesUntil('\n', buf, 4) == 4);
+        CHECK(std::string(buf, 4) == "0123");
+        CHECK(strm.available() == 7);
+    }
+
+    SECTION("readString() and readStringUntil() read strings of arbitrary length") {
+        LoopbackStream strm(1000);
+        const std::string s = randomString(gen, 300);
+        strm.put(s + "|" + s);
+        CHECK(strm.readStringUntil('|') == String(s.c_str()));
+        CHECK(strm.readString() == String(s.c_str()));
+        CHECK(strm.available() == 0);
+    }
+
+    SECTION("byte-wise streams produce the same results") {
+        LoopbackStream strm(100, false /* zeroCopy */);
+        strm.put("abc\ndef\n");
+        char buf[16] = {};
+        REQUIRE(strm.readBytesUntil('\n', buf, sizeof(buf)) == 3);
+        CHECK(std::string(buf, 3) == "abc");
+        CHECK(strm.readString() == "def\n");
+        strm.put("12,-34");
+        CHECK(strm.parseInt() == 12);
+        CHECK(strm.parseInt() == -34);
+        CHECK(strm.acquireCount == 0);
+        CHECK(strm.readCount > 0);
+    }
+}
+
+// Sustained loopback throughput, run with the [benchmark] tag
+TEST_CASE("Stream loopback throughput", "[.][benchmark]") {
+    const size_t total = 64 * 1024 * 1024;
+    const size_t portion = 1024;
+    LoopbackStream byteWise(4096, false);
+    LoopbackStream zeroCopy(4096, true);
+    const double r1 = loopbackThroughput(&byteWise, total, portion);
+    const double r2 = loopbackThroughput(&zeroCopy, total, portion);
+    CATCH_WARN("Byte-wise: " << (uint64_t)r1 << " bytes/s, zero-copy: " << (uint64_t)r2 << " bytes/s");
+    CHECK(r2 > r1);
+}
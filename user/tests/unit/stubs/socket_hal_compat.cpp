@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "socket_hal.h"
+
+uint8_t socket_active_status(sock_handle_t socket) {
+    return SOCKET_STATUS_INACTIVE;
+}
+
+uint8_t socket_handle_valid(sock_handle_t handle) {
+    return handle != socket_handle_invalid();
+}
+
+sock_handle_t socket_create(uint8_t family, uint8_t type, uint8_t protocol, uint16_t port, network_interface_t nif) {
+    return socket_handle_invalid();
+}
+
+sock_result_t socket_connect(sock_handle_t sd, const sockaddr_t *addr, long addrlen) {
+    return -1;
+}
+
+sock_result_t socket_receive(sock_handle_t sd, void* buffer, socklen_t len, system_tick_t _timeout) {
+    return 0;
+}
+
+sock_result_t socket_receivefrom(sock_handle_t sd, void* buffer, socklen_t len, uint32_t flags, sockaddr_t* address, socklen_t* addr_size) {
+    return 0;
+}
+
+sock_result_t socket_send(sock_handle_t sd, const void* buffer, socklen_t len) {
+    return len;
+}
+
+sock_result_t socket_send_ex(sock_handle_t sd, const void* buffer, socklen_t len, uint32_t flags, system_tick_t timeout, void* reserved) {
+    return len;
+}
+
+sock_result_t socket_sendto(sock_handle_t sd, const void* buffer, socklen_t len, uint32_t flags, sockaddr_t* addr, socklen_t addr_size) {
+    return len;
+}
+
+sock_result_t socket_close(sock_handle_t sd) {
+    return 0;
+}
+
+sock_handle_t socket_handle_invalid() {
+    return (sock_handle_t)-1;
+}
+
+sock_result_t socket_join_multicast(const HAL_IPAddress* address, network_interface_t nif, socket_multicast_info_t* reserved) {
+    return 0;
+}
+
+sock_result_t socket_leave_multicast(const HAL_IPAddress* address, network_interface_t nif, socket_multicast_info_t* reserved) {
+    return 0;
+}
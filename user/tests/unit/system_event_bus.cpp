@@ -0,0 +1,289 @@
+#include "system_event_bus.h"
+
+#include "tools/catch.h"
+
+#include <vector>
+#include <deque>
+#include <chrono>
+
+namespace {
+
+using namespace particle::system;
+
+class TestEventBusIo: public EventBusIo {
+public:
+    TestEventBusIo() :
+            async(true),
+            time(0),
+            lockCount(0) {
+    }
+
+    virtual bool post(std::function<void()> fn) override {
+        if (!async) {
+            return false;
+        }
+        queue.push_back(fn);
+        return true;
+    }
+
+    virtual uint32_t micros() override {
+        return time;
+    }
+
+    virtual void lock() override {
+        ++lockCount;
+    }
+
+    virtual void unlock() override {
+        --lockCount;
+    }
+
+    // Runs the functions posted to the application thread
+    void run() {
+        while (!queue.empty()) {
+            const auto fn = queue.front();
+            queue.pop_front();
+            fn();
+        }
+    }
+
+    std::deque<std::function<void()>> queue;
+    bool async;
+    uint32_t time;
+    int lockCount;
+};
+
+struct Call {
+    int handler;
+    system_event_t event;
+    int data;
+    bool locked; // Set if the handler was called with the lock held
+
+    bool operator==(const Call& c) const {
+        return handler == c.handler && event == c.event && data == c.data;
+    }
+};
+
+std::vector<Call> g_calls;
+TestEventBusIo* g_io = nullptr;
+EventBus* g_bus = nullptr;
+
+template<int N>
+void handler(system_event_t event, int data, void* pointer) {
+    g_calls.push_back({ N, event, data, g_io && g_io->lockCount > 0 });
+}
+
+// Unsubscribes handler<2> when called
+void unsubscribingHandler(system_event_t event, int data, void* pointer) {
+    g_calls.push_back({ 9, event, data, false });
+    g_bus->unsubscribe(all_events, handler<2>);
+    g_bus->unsubscribe(all_events, unsubscribingHandler);
+}
+
+void completion(void* data) {
+    g_calls.push_back({ 0, 0, *static_cast<int*>(data), false });
+}
+
+} // namespace
+
+TEST_CASE("EventBus") {
+    TestEventBusIo io;
+    EventBus bus(&io);
+    g_io = &io;
+    g_bus = &bus;
+    g_calls.clear();
+
+    SECTION("handlers are only called for the events they are subscribed to") {
+        REQUIRE(bus.subscribe(network_status, handler<1>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        REQUIRE(bus.subscribe(cloud_status + network_status, handler<2>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        CHECK(bus.subscriberCount(network_status) == 2);
+        CHECK(bus.subscriberCount(cloud_status) == 1);
+        CHECK(bus.subscriberCount(button_status) == 0);
+        bus.notify(cloud_status, 1, nullptr);
+        bus.notify(button_status, 2, nullptr);
+        bus.notify(network_status, 3, nullptr);
+        CHECK(g_calls == std::vector<Call>({ { 2, cloud_status, 1 }, { 1, network_status, 3 }, { 2, network_status, 3 } }));
+        CHECK(io.queue.empty());
+    }
+
+    SECTION("handlers are called in the order of subscription") {
+        REQUIRE(bus.subscribe(network_status, handler<1>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        REQUIRE(bus.subscribe(all_events, handler<2>, SYSTEM_EVENT_DELIVERY_INLINE) == 0); // Not listed
+        REQUIRE(bus.subscribe(network_status, handler<3>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        REQUIRE(bus.subscribe(all_events, handler<4>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        bus.notify(network_status, 0, nullptr);
+        CHECK(g_calls == std::vector<Call>({ { 1, network_status, 0 }, { 2, network_status, 0 },
+                { 3, network_status, 0 }, { 4, network_status, 0 } }));
+        g_calls.clear();
+        bus.notify(network_status | cloud_status, 0, nullptr);
+        CHECK(g_calls.size() == 4);
+    }
+
+    SECTION("handlers are called without holding the lock") {
+        REQUIRE(bus.subscribe(network_status, handler<1>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        REQUIRE(bus.subscribe(network_status, handler<2>) == 0);
+        bus.notify(network_status, 0, nullptr);
+        io.run();
+        REQUIRE(g_calls.size() == 2);
+        CHECK(!g_calls[0].locked);
+        CHECK(!g_calls[1].locked);
+        CHECK(io.lockCount == 0);
+    }
+
+    SECTION("queued handlers are called on the application thread, followed by the completion function") {
+        int fndata = 123;
+        REQUIRE(bus.subscribe(network_status, handler<1>) == 0);
+        REQUIRE(bus.subscribe(network_status, handler<2>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        bus.notify(network_status, 1, nullptr, completion, &fndata);
+        CHECK(g_calls == std::vector<Call>({ { 2, network_status, 1 } }));
+        CHECK(bus.stats().queueDepth == 1);
+        io.run();
+        CHECK(g_calls == std::vector<Call>({ { 2, network_status, 1 }, { 1, network_status, 1 }, { 0, 0, 123 } }));
+        CHECK(bus.stats().queueDepth == 0);
+        CHECK(bus.stats().maxQueueDepth == 1);
+    }
+
+    SECTION("nothing is posted if there are no queued handlers") {
+        REQUIRE(bus.subscribe(network_status, handler<1>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        bus.notify(network_status, 1, nullptr);
+        bus.notify(cloud_status, 1, nullptr);
+        CHECK(io.queue.empty());
+        int fndata = 1;
+        bus.notify(cloud_status, 1, nullptr, completion, &fndata);
+        CHECK(io.queue.size() == 1);
+    }
+
+    SECTION("notifications are delivered synchronously if they can't be posted") {
+        io.async = false;
+        REQUIRE(bus.subscribe(network_status, handler<1>) == 0);
+        bus.notify(network_status, 1, nullptr);
+        CHECK(g_calls == std::vector<Call>({ { 1, network_status, 1 } }));
+        CHECK(bus.stats().queueDepth == 0);
+    }
+
+    SECTION("coalesced handlers only receive the latest notification") {
+        REQUIRE(bus.subscribe(network_status, handler<1>, SYSTEM_EVENT_DELIVERY_COALESCED) == 0);
+        REQUIRE(bus.subscribe(network_status, handler<2>) == 0);
+        for (int i = 1; i <= 3; ++i) {
+            bus.notify(network_status, i, nullptr);
+        }
+        io.run();
+        CHECK(g_calls == std::vector<Call>({ { 2, network_status, 1 }, { 1, network_status, 3 },
+                { 2, network_status, 2 }, { 2, network_status, 3 } }));
+        CHECK(bus.stats().coalesced == 2);
+        g_calls.clear();
+        bus.notify(network_status, 4, nullptr);
+        io.run();
+        CHECK(g_calls == std::vector<Call>({ { 2, network_status, 4 }, { 1, network_status, 4 } }));
+    }
+
+    SECTION("coalescing is done per event") {
+        REQUIRE(bus.subscribe(network_status + cloud_status, handler<1>, SYSTEM_EVENT_DELIVERY_COALESCED) == 0);
+        bus.notify(network_status, 1, nullptr);
+        bus.notify(cloud_status, 2, nullptr);
+        bus.notify(network_status, 3, nullptr);
+        io.run();
+        CHECK(g_calls == std::vector<Call>({ { 1, network_status, 3 }, { 1, cloud_status, 2 } }));
+    }
+
+    SECTION("synchronous notifications ignore the delivery mode") {
+        int fndata = 1;
+        REQUIRE(bus.subscribe(network_status, handler<1>, SYSTEM_EVENT_DELIVERY_COALESCED) == 0);
+        REQUIRE(bus.subscribe(network_status, handler<2>) == 0);
+        bus.notifySync(network_status, 1, nullptr, completion, &fndata);
+        CHECK(g_calls == std::vector<Call>({ { 1, network_status, 1 }, { 2, network_status, 1 }, { 0, 0, 1 } }));
+        CHECK(io.queue.empty());
+    }
+
+    SECTION("handlers can be unsubscribed") {
+        REQUIRE(bus.subscribe(network_status + cloud_status, handler<1>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        REQUIRE(bus.subscribe(all_events, handler<2>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        bus.unsubscribe(network_status, handler<1>);
+        CHECK(bus.subscriberCount(network_status) == 1);
+        CHECK(bus.subscriberCount(cloud_status) == 2);
+        bus.unsubscribe(cloud_status, handler<2>);
+        bus.notify(cloud_status, 0, nullptr);
+        bus.notify(network_status, 0, nullptr);
+        CHECK(g_calls == std::vector<Call>({ { 1, cloud_status, 0 }, { 2, network_status, 0 } }));
+        bus.unsubscribe(all_events, nullptr);
+        CHECK(bus.subscriberCount(all_events) == 0);
+    }
+
+    SECTION("handlers can unsubscribe while a notification is being delivered") {
+        REQUIRE(bus.subscribe(network_status, unsubscribingHandler, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        REQUIRE(bus.subscribe(network_status, handler<2>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        REQUIRE(bus.subscribe(network_status, handler<3>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        bus.notify(network_status, 0, nullptr);
+        CHECK(g_calls == std::vector<Call>({ { 9, network_status, 0 }, { 3, network_status, 0 } }));
+        CHECK(bus.subscriberCount(network_status) == 1);
+    }
+
+    SECTION("invalid arguments") {
+        CHECK(bus.subscribe(0, handler<1>) != 0);
+        CHECK(bus.subscribe(network_status, nullptr) != 0);
+        CHECK(bus.subscribe(network_status, handler<1>, (system_event_delivery_mode)3) != 0);
+    }
+
+    SECTION("handler latency is measured from the time of the notification") {
+        REQUIRE(bus.subscribe(network_status, handler<1>) == 0);
+        io.time = 1000;
+        bus.notify(network_status, 0, nullptr);
+        io.time = 1500;
+        io.run();
+        CHECK(bus.stats().handlerCalls == 1);
+        CHECK(bus.stats().lastLatency == 500);
+        CHECK(bus.stats().maxLatency == 500);
+    }
+
+    g_bus = nullptr;
+    g_io = nullptr;
+}
+
+// Dispatch of notifications to 128 inline handlers, each subscribed to one of 16 events, compared
+// with a linear scan of all subscriptions. Run with the [benchmark] tag
+TEST_CASE("System event dispatch time", "[.][benchmark]") {
+    const unsigned SUBSCRIBERS = 128;
+    const unsigned EVENTS = 16;
+    const unsigned NOTIFICATIONS = 100000;
+    TestEventBusIo io;
+    EventBus bus(&io);
+    g_io = nullptr;
+
+    struct Subscription {
+        system_event_t events;
+        system_event_handler_t* handler;
+    };
+    std::vector<Subscription> subs;
+    for (unsigned i = 0; i < SUBSCRIBERS; ++i) {
+        const system_event_t e = (system_event_t)1 << (i % EVENTS + 1);
+        REQUIRE(bus.subscribe(e, handler<1>, SYSTEM_EVENT_DELIVERY_INLINE) == 0);
+        subs.push_back({ e, handler<1> });
+    }
+
+    g_calls.clear();
+    g_calls.reserve(NOTIFICATIONS * SUBSCRIBERS / EVENTS);
+    auto t1 = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < NOTIFICATIONS; ++i) {
+        const system_event_t e = (system_event_t)1 << (i % EVENTS + 1);
+        for (const auto& s: subs) {
+            if (s.events & e) {
+                s.handler(e, i, nullptr);
+            }
+        }
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    const double scanTime = std::chrono::duration<double, std::milli>(t2 - t1).count();
+    const size_t scanCalls = g_calls.size();
+
+    g_calls.clear();
+    t1 = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < NOTIFICATIONS; ++i) {
+        bus.notify((system_event_t)1 << (i % EVENTS + 1), i, nullptr);
+    }
+    t2 = std::chrono::steady_clock::now();
+    const double busTime = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+    CATCH_WARN("Linear scan: " << scanTime << " ms, event bus: " << busTime << " ms (" << NOTIFICATIONS <<
+            " notifications, " << SUBSCRIBERS << " subscribers)");
+    CHECK(g_calls.size() == scanCalls);
+}
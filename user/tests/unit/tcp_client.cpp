@@ -0,0 +1,162 @@
+#include "spark_wiring_tcpclient.h"
+#include "system_network.h"
+
+#include "hippomocks.h"
+#include "tools/catch.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+const sock_handle_t SOCK = 1;
+
+// Feeds data to TCPClient through the socket HAL
+class SocketMocks {
+public:
+    SocketMocks() {
+        mocks_.OnCallFunc(network_ready).Return(true);
+        mocks_.OnCallFunc(socket_receive).Do([&](sock_handle_t sd, void* buffer, socklen_t len, system_tick_t timeout) -> sock_result_t {
+            sizes_.push_back(len);
+            const size_t n = std::min(data_.size(), (size_t)len);
+            memcpy(buffer, data_.data(), n);
+            data_.erase(0, n);
+            return n;
+        });
+    }
+
+    void data(const std::string& data) {
+        data_ = data;
+    }
+
+    // Sizes of the buffers passed to socket_receive()
+    const std::vector<size_t>& sizes() const {
+        return sizes_;
+    }
+
+private:
+    MockRepository mocks_;
+    std::string data_;
+    std::vector<size_t> sizes_;
+};
+
+std::string makeData(size_t size) {
+    std::string s;
+    for (size_t i = 0; i < size; ++i) {
+        s += (char)('a' + i % 26);
+    }
+    return s;
+}
+
+} // namespace
+
+TEST_CASE("TCPClient") {
+    SocketMocks mocks;
+
+    SECTION("uses the default buffer size") {
+        TCPClient client(SOCK);
+        CHECK(client.bufferSize() == TCPCLIENT_BUF_MAX_SIZE);
+        const auto data = makeData(1000);
+        mocks.data(data);
+        CHECK(client.available() == TCPCLIENT_BUF_MAX_SIZE);
+        CHECK(mocks.sizes().back() == TCPCLIENT_BUF_MAX_SIZE);
+    }
+
+    SECTION("receive buffer size can be changed") {
+        TCPClient client(SOCK, 1024);
+        CHECK(client.bufferSize() == 1024);
+        const auto data = makeData(2000);
+        mocks.data(data);
+        CHECK(client.available() == 1024);
+        CHECK(client.read() == 'a');
+        // Buffered data is preserved when the buffer shrinks
+        CHECK_FALSE(client.setBufferSize(16));
+        CHECK(client.setBufferSize(1023));
+        CHECK(client.bufferSize() == 1023);
+        std::string s(1023, '\0');
+        CHECK(client.read((uint8_t*)&s[0], 512) == 512);
+        CHECK(client.read((uint8_t*)&s[512], 511) == 511);
+        CHECK(s == data.substr(1, 1023));
+    }
+
+    SECTION("large reads bypass the receive buffer") {
+        TCPClient client(SOCK);
+        const auto data = makeData(1000);
+        mocks.data(data);
+        std::string s(1000, '\0');
+        CHECK(client.read((uint8_t*)&s[0], s.size()) == 1000);
+        CHECK(s == data);
+        REQUIRE(mocks.sizes().size() == 1);
+        CHECK(mocks.sizes()[0] == 1000);
+        CHECK(client.available() == 0);
+    }
+
+    SECTION("large reads drain buffered data first") {
+        TCPClient client(SOCK);
+        const auto data = makeData(1000);
+        mocks.data(data);
+        CHECK(client.peek() == 'a');
+        std::string s(1000, '\0');
+        CHECK(client.read((uint8_t*)&s[0], s.size()) == 1000);
+        CHECK(s == data);
+    }
+
+    SECTION("small reads are staged through the receive buffer") {
+        TCPClient client(SOCK);
+        mocks.data("abcdef");
+        char s[4] = {};
+        CHECK(client.read((uint8_t*)s, 3) == 3);
+        CHECK(std::string(s) == "abc");
+        CHECK(client.read((uint8_t*)s, 3) == 3);
+        CHECK(std::string(s) == "def");
+        CHECK(client.read((uint8_t*)s, 3) == -1);
+    }
+
+    SECTION("readBytes() reads the requested number of bytes") {
+        TCPClient client(SOCK);
+        client.setTimeout(0);
+        const auto data = makeData(700);
+        mocks.data(data);
+        std::string s(1000, '\0');
+        CHECK(client.readBytes(&s[0], 600) == 600);
+        CHECK(s.substr(0, 600) == data.substr(0, 600));
+        CHECK(client.readBytes(&s[0], 1000) == 100);
+        CHECK(s.substr(0, 100) == data.substr(600));
+    }
+
+    SECTION("readBytes() called through Stream reads directly") {
+        TCPClient client(SOCK);
+        client.setTimeout(0);
+        const auto data = makeData(1000);
+        mocks.data(data);
+        Stream& stream = client;
+        std::string s(1000, '\0');
+        CHECK(stream.readBytes(&s[0], s.size()) == 1000);
+        CHECK(s == data);
+        REQUIRE(mocks.sizes().size() == 1);
+        CHECK(mocks.sizes()[0] == 1000);
+    }
+
+    SECTION("readBytesUntil() stops at the terminator") {
+        TCPClient client(SOCK);
+        client.setTimeout(0);
+        const auto line = makeData(300);
+        mocks.data(line + "\n" + "tail");
+        std::string s(1000, '\0');
+        CHECK(client.readBytesUntil('\n', &s[0], s.size()) == 300);
+        CHECK(s.substr(0, 300) == line);
+        CHECK(client.readBytesUntil('\n', &s[0], s.size()) == 4);
+        CHECK(s.substr(0, 4) == "tail");
+    }
+
+    SECTION("readBytesUntil() stops when the buffer is full") {
+        TCPClient client(SOCK);
+        client.setTimeout(0);
+        mocks.data("abc\n");
+        char s[4] = {};
+        CHECK(client.readBytesUntil('\n', s, 3) == 3);
+        CHECK(std::string(s) == "abc");
+        // The terminator has not been consumed
+        CHECK(client.read() == '\n');
+    }
+}
@@ -0,0 +1,205 @@
+#include "spark_wiring_udp.h"
+#include "system_network.h"
+
+#include "hippomocks.h"
+#include "tools/catch.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace {
+
+const sock_handle_t SOCK = 1;
+
+struct Datagram {
+    std::string data;
+    IPAddress ip;
+    uint16_t port;
+};
+
+// Feeds datagrams to UDP through the socket HAL
+class SocketMocks {
+public:
+    SocketMocks() {
+        mocks_.OnCallFunc(network_ready).Return(true);
+        mocks_.OnCallFunc(socket_create).Return(SOCK);
+        mocks_.OnCallFunc(socket_receivefrom).Do([&](sock_handle_t sd, void* buffer, socklen_t len, uint32_t flags,
+                sockaddr_t* addr, socklen_t* addrSize) -> sock_result_t {
+            ++receiveCount_;
+            if (received_.empty()) {
+                return 0;
+            }
+            const auto d = received_.front();
+            received_.pop_front();
+            addr->sa_data[0] = d.port >> 8;
+            addr->sa_data[1] = d.port & 0xff;
+            for (int i = 0; i < 4; ++i) {
+                addr->sa_data[2 + i] = d.ip[i];
+            }
+            const size_t n = std::min(d.data.size(), (size_t)len);
+            memcpy(buffer, d.data.data(), n);
+            return n;
+        });
+        mocks_.OnCallFunc(socket_sendto).Do([&](sock_handle_t sd, const void* buffer, socklen_t len, uint32_t flags,
+                sockaddr_t* addr, socklen_t addrSize) -> sock_result_t {
+            if (!sendsLeft_) {
+                return -1;
+            }
+            --sendsLeft_;
+            Datagram d;
+            d.data = std::string((const char*)buffer, len);
+            d.port = (uint16_t)addr->sa_data[0] << 8 | addr->sa_data[1];
+            d.ip = IPAddress(addr->sa_data[2], addr->sa_data[3], addr->sa_data[4], addr->sa_data[5]);
+            sent_.push_back(d);
+            return len;
+        });
+    }
+
+    void receive(const std::string& data, IPAddress ip = IPAddress(10, 0, 0, 1), uint16_t port = 1234) {
+        received_.push_back({ data, ip, port });
+    }
+
+    const std::vector<Datagram>& sent() const {
+        return sent_;
+    }
+
+    // Number of packets that can be sent before socket_sendto() starts failing
+    void sendLimit(size_t n) {
+        sendsLeft_ = n;
+    }
+
+    unsigned receiveCount() const {
+        return receiveCount_;
+    }
+
+private:
+    MockRepository mocks_;
+    std::deque<Datagram> received_;
+    std::vector<Datagram> sent_;
+    size_t sendsLeft_ = (size_t)-1;
+    unsigned receiveCount_ = 0;
+};
+
+} // namespace
+
+TEST_CASE("UDP receive queue") {
+    SocketMocks mocks;
+    UDP udp;
+    REQUIRE(udp.begin(5000));
+
+    SECTION("datagrams are returned in the order they were received") {
+        REQUIRE(udp.setPacketQueue(4, 64));
+        mocks.receive("abc", IPAddress(10, 0, 0, 1), 1000);
+        mocks.receive("defg", IPAddress(10, 0, 0, 2), 2000);
+        CHECK(udp.receivePackets() == 2);
+        CHECK(udp.packetsQueued() == 2);
+        CHECK(udp.parsePacket() == 3);
+        CHECK(udp.remoteIP() == IPAddress(10, 0, 0, 1));
+        CHECK(udp.remotePort() == 1000);
+        CHECK(udp.read() == 'a');
+        CHECK(udp.parsePacket() == 4);
+        CHECK(udp.remoteIP() == IPAddress(10, 0, 0, 2));
+        CHECK(udp.remotePort() == 2000);
+        CHECK(udp.packetsQueued() == 0);
+        CHECK(udp.parsePacket() == 0);
+    }
+
+    SECTION("a burst is queued by a single receive batch") {
+        REQUIRE(udp.setPacketQueue(8, 16));
+        for (int i = 0; i < 5; ++i) {
+            mocks.receive(std::string(1, '0' + i));
+        }
+        CHECK(udp.receivePackets() == 5);
+        // One extra call finds the socket empty
+        CHECK(mocks.receiveCount() == 6);
+        for (int i = 0; i < 5; ++i) {
+            char c = 0;
+            CHECK(udp.receivePacket(&c, 1) == 1);
+            CHECK(c == '0' + i);
+        }
+    }
+
+    SECTION("datagrams are left in the socket when the queue is full") {
+        REQUIRE(udp.setPacketQueue(2, 16));
+        mocks.receive("1");
+        mocks.receive("2");
+        mocks.receive("3");
+        CHECK(udp.receivePackets() == 2);
+        CHECK(udp.packetQueueOverflows() == 1);
+        CHECK(udp.parsePacket() == 1);
+        CHECK(udp.read() == '1');
+        // The slot is reused for the remaining datagram
+        CHECK(udp.receivePackets() == 1);
+        CHECK(udp.parsePacket() == 1);
+        CHECK(udp.read() == '2');
+        CHECK(udp.parsePacket() == 1);
+        CHECK(udp.read() == '3');
+        CHECK(udp.parsePacket() == 0);
+    }
+
+    SECTION("large datagrams are truncated to the slot size") {
+        REQUIRE(udp.setPacketQueue(2, 4));
+        mocks.receive("abcdefgh");
+        CHECK(udp.receivePackets() == 1);
+        CHECK(udp.parsePacket() == 4);
+    }
+
+    SECTION("empty datagrams are queued") {
+        REQUIRE(udp.setPacketQueue(4, 16));
+        mocks.receive("a");
+        mocks.receive("");
+        mocks.receive("b");
+        CHECK(udp.receivePackets() == 3);
+        char c = 0;
+        CHECK(udp.receivePacket(&c, 1) == 1);
+        CHECK(c == 'a');
+        CHECK(udp.receivePacket(&c, 1) == 0);
+        CHECK(udp.packetsQueued() == 1);
+        CHECK(udp.receivePacket(&c, 1) == 1);
+        CHECK(c == 'b');
+    }
+
+    SECTION("the socket is only read by receivePackets() while the queue is enabled") {
+        REQUIRE(udp.setPacketQueue(4, 16));
+        mocks.receive("abc");
+        CHECK(udp.parsePacket() == 0);
+        CHECK(mocks.receiveCount() == 0);
+        CHECK(udp.receivePackets() == 1);
+        CHECK(udp.parsePacket() == 3);
+    }
+
+    SECTION("the queue can be released") {
+        REQUIRE(udp.setPacketQueue(2, 4));
+        udp.releasePacketQueue();
+        CHECK(udp.receivePackets() < 0);
+        mocks.receive("abc");
+        CHECK(udp.parsePacket() == 3);
+    }
+}
+
+TEST_CASE("UDP::sendPackets()") {
+    SocketMocks mocks;
+    UDP udp;
+    REQUIRE(udp.begin(5000));
+    const UDPPacket packets[] = {
+        { (const uint8_t*)"abc", 3, IPAddress(10, 0, 0, 1), 1000, 0 },
+        { (const uint8_t*)"de", 2, IPAddress(10, 0, 0, 2), 2000, 0 },
+        { (const uint8_t*)"f", 1, IPAddress(10, 0, 0, 3), 3000, 0 }
+    };
+
+    SECTION("all packets are sent") {
+        CHECK(udp.sendPackets(packets, 3) == 3);
+        REQUIRE(mocks.sent().size() == 3);
+        CHECK(mocks.sent()[1].data == "de");
+        CHECK(mocks.sent()[1].ip == IPAddress(10, 0, 0, 2));
+        CHECK(mocks.sent()[1].port == 2000);
+    }
+
+    SECTION("sending stops at the first error") {
+        mocks.sendLimit(2);
+        CHECK(udp.sendPackets(packets, 3) == 2);
+        mocks.sendLimit(0);
+        CHECK(udp.sendPackets(packets, 3) < 0);
+    }
+}
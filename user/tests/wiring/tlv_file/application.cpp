@@ -0,0 +1,10 @@
+#include "application.h"
+#include "unit-test/unit-test.h"
+
+SYSTEM_MODE(MANUAL)
+
+#if USE_THREADING == 1
+SYSTEM_THREAD(ENABLED)
+#endif
+
+UNIT_TEST_APP()
@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * TlvFile tests. The files are stored on a LittleFS instance backed by a RAM block device, so that
+ * the tests don't modify the external flash. LittleFS is not exported to the application in the
+ * modular builds:
+ *
+ * make PLATFORM=xenon MODULAR=n TEST=wiring/tlv_file
+ */
+
+#include "application.h"
+#include "unit-test/unit-test.h"
+
+#if HAL_PLATFORM_FILESYSTEM
+
+#include "tlv_file.h"
+
+namespace {
+
+using namespace particle::services::settings;
+
+const char* const FILE_PATH = "/tlv/test.dat";
+
+const size_t BLOCK_SIZE = 512;
+const size_t BLOCK_COUNT = 32;
+
+// On-disk layout of the records and the footer
+struct RawHeader {
+    uint16_t magick;
+    uint16_t key;
+    uint16_t length;
+    uint16_t flags;
+} __attribute__((__packed__));
+
+struct RawFooter {
+    uint32_t reserved;
+    uint32_t size;
+    uint16_t reserved1;
+    uint16_t version;
+    uint32_t magick;
+} __attribute__((__packed__));
+
+uint8_t g_storage[BLOCK_SIZE * BLOCK_COUNT];
+filesystem_t g_fs = {};
+
+int bdRead(const lfs_config* c, lfs_block_t block, lfs_off_t off, void* buf, lfs_size_t size) {
+    memcpy(buf, g_storage + block * c->block_size + off, size);
+    return 0;
+}
+
+int bdProg(const lfs_config* c, lfs_block_t block, lfs_off_t off, const void* buf, lfs_size_t size) {
+    memcpy(g_storage + block * c->block_size + off, buf, size);
+    return 0;
+}
+
+int bdErase(const lfs_config* c, lfs_block_t block) {
+    memset(g_storage + block * c->block_size, 0xff, c->block_size);
+    return 0;
+}
+
+int bdSync(const lfs_config* c) {
+    return 0;
+}
+
+int mountRamFs() {
+    if (g_fs.state) {
+        lfs_unmount(&g_fs.instance);
+        g_fs.state = false;
+    }
+    memset(g_storage, 0xff, sizeof(g_storage));
+    g_fs.config.read = bdRead;
+    g_fs.config.prog = bdProg;
+    g_fs.config.erase = bdErase;
+    g_fs.config.sync = bdSync;
+    g_fs.config.read_size = FILESYSTEM_READ_SIZE;
+    g_fs.config.prog_size = FILESYSTEM_PROG_SIZE;
+    g_fs.config.block_size = BLOCK_SIZE;
+    g_fs.config.block_count = BLOCK_COUNT;
+    g_fs.config.lookahead = BLOCK_COUNT;
+    int ret = lfs_format(&g_fs.instance, &g_fs.config);
+    if (!ret) {
+        ret = lfs_mount(&g_fs.instance, &g_fs.config);
+    }
+    if (!ret) {
+        // filesystem_mount() is a no-op for a mounted instance
+        g_fs.state = true;
+    }
+    return ret;
+}
+
+// Writes a file bypassing TlvFile
+int writeRawFile(const void* data, size_t size) {
+    int ret = lfs_mkdir(&g_fs.instance, "/tlv");
+    if (ret < 0 && ret != LFS_ERR_EXIST) {
+        return ret;
+    }
+    lfs_file_t f = {};
+    ret = lfs_file_open(&g_fs.instance, &f, FILE_PATH, LFS_O_CREAT | LFS_O_TRUNC | LFS_O_WRONLY);
+    if (ret < 0) {
+        return ret;
+    }
+    const ssize_t n = lfs_file_write(&g_fs.instance, &f, data, size);
+    ret = lfs_file_close(&g_fs.instance, &f);
+    return (n != (ssize_t)size) ? -1 : ret;
+}
+
+// Returns the magic number of a closed file
+uint32_t fileMagick() {
+    lfs_file_t f = {};
+    if (lfs_file_open(&g_fs.instance, &f, FILE_PATH, LFS_O_RDONLY) < 0) {
+        return 0;
+    }
+    RawFooter footer = {};
+    lfs_file_seek(&g_fs.instance, &f, -(lfs_soff_t)sizeof(footer), LFS_SEEK_END);
+    lfs_file_read(&g_fs.instance, &f, &footer, sizeof(footer));
+    lfs_file_close(&g_fs.instance, &f);
+    return footer.magick;
+}
+
+int setString(TlvFile& file, uint16_t key, const char* str) {
+    return file.set(key, (const uint8_t*)str, strlen(str));
+}
+
+int addString(TlvFile& file, uint16_t key, const char* str) {
+    return file.add(key, (const uint8_t*)str, strlen(str));
+}
+
+String getString(TlvFile& file, uint16_t key, int index = 0) {
+    char buf[64] = {};
+    const ssize_t n = file.get(key, (uint8_t*)buf, sizeof(buf) - 1, index);
+    if (n < 0) {
+        return String::format("error %d", (int)n);
+    }
+    return String(buf);
+}
+
+size_t recordSize(const char* str) {
+    return sizeof(RawHeader) + strlen(str);
+}
+
+} // namespace
+
+test(TLV_FILE_01_set_replaces_the_previous_value) {
+    for (int logMode = 0; logMode <= 1; ++logMode) {
+        assertEqual(mountRamFs(), 0);
+        TlvFile file(FILE_PATH, &g_fs);
+        assertEqual(file.init(), 0);
+        file.logMode(logMode);
+        assertEqual(setString(file, 1, "first"), 0);
+        assertEqual(setString(file, 2, "other"), 0);
+        assertEqual(setString(file, 1, "second"), 0);
+        assertEqual(getString(file, 1), String("second"));
+        assertEqual(getString(file, 2), String("other"));
+        // The first value is gone
+        assertEqual(file.get(1, nullptr, 0, 1), (ssize_t)SYSTEM_ERROR_NOT_FOUND);
+        assertEqual(file.staleSize(), logMode ? recordSize("first") : 0);
+        file.deInit();
+    }
+}
+
+test(TLV_FILE_02_del_removes_all_values_of_a_key) {
+    for (int logMode = 0; logMode <= 1; ++logMode) {
+        assertEqual(mountRamFs(), 0);
+        TlvFile file(FILE_PATH, &g_fs);
+        assertEqual(file.init(), 0);
+        file.logMode(logMode);
+        assertEqual(addString(file, 1, "a"), 0);
+        assertEqual(addString(file, 2, "b"), 0);
+        assertEqual(addString(file, 1, "c"), 0);
+        assertEqual(file.del(1), 0);
+        assertEqual(file.get(1, nullptr, 0), (ssize_t)SYSTEM_ERROR_NOT_FOUND);
+        assertEqual(getString(file, 2), String("b"));
+        assertEqual(file.del(1), (int)SYSTEM_ERROR_NOT_FOUND);
+        file.deInit();
+    }
+}
+
+test(TLV_FILE_03_del_removes_a_value_by_index) {
+    assertEqual(mountRamFs(), 0);
+    TlvFile file(FILE_PATH, &g_fs);
+    assertEqual(file.init(), 0);
+    assertEqual(addString(file, 1, "a"), 0);
+    assertEqual(addString(file, 1, "b"), 0);
+    assertEqual(addString(file, 1, "c"), 0);
+    assertEqual(file.del(1, 1), 0);
+    assertEqual(getString(file, 1, 0), String("a"));
+    assertEqual(getString(file, 1, 1), String("c"));
+    assertEqual(file.get(1, nullptr, 0, 2), (ssize_t)SYSTEM_ERROR_NOT_FOUND);
+    file.deInit();
+}
+
+test(TLV_FILE_04_compaction_removes_superseded_records) {
+    assertEqual(mountRamFs(), 0);
+    TlvFile file(FILE_PATH, &g_fs);
+    assertEqual(file.init(), 0);
+    file.logMode(true);
+    for (int i = 0; i < 10; ++i) {
+        assertEqual(setString(file, 1, String(i).c_str()), 0);
+    }
+    assertEqual(setString(file, 2, "two"), 0);
+    assertEqual(setString(file, 3, "three"), 0);
+    assertEqual(file.del(3), 0);
+    assertMore(file.staleSize(), 0);
+    assertEqual(file.compact(), 0);
+    assertEqual(file.staleSize(), 0);
+    assertEqual(file.size(), (ssize_t)(recordSize("9") + recordSize("two") + sizeof(RawFooter)));
+    assertEqual(getString(file, 1), String("9"));
+    assertEqual(getString(file, 2), String("two"));
+    assertEqual(file.get(3, nullptr, 0), (ssize_t)SYSTEM_ERROR_NOT_FOUND);
+    file.deInit();
+}
+
+test(TLV_FILE_05_values_survive_reopening_after_compaction) {
+    assertEqual(mountRamFs(), 0);
+    {
+        TlvFile file(FILE_PATH, &g_fs);
+        assertEqual(file.init(), 0);
+        file.logMode(true);
+        assertEqual(setString(file, 1, "one"), 0);
+        assertEqual(setString(file, 2, "two"), 0);
+        assertEqual(setString(file, 1, "uno"), 0);
+        assertEqual(setString(file, 3, "three"), 0);
+        assertEqual(file.del(2), 0);
+        assertEqual(file.compact(), 0);
+        assertEqual(setString(file, 3, "tres"), 0);
+        file.deInit();
+    }
+    TlvFile file(FILE_PATH, &g_fs);
+    assertEqual(file.init(), 0);
+    assertEqual(getString(file, 1), String("uno"));
+    assertEqual(file.get(2, nullptr, 0), (ssize_t)SYSTEM_ERROR_NOT_FOUND);
+    assertEqual(getString(file, 3), String("tres"));
+    assertEqual(file.staleSize(), recordSize("three"));
+    file.deInit();
+}
+
+test(TLV_FILE_06_log_mode_file_is_compacted_at_the_threshold) {
+    assertEqual(mountRamFs(), 0);
+    TlvFile file(FILE_PATH, &g_fs);
+    assertEqual(file.init(), 0);
+    const size_t threshold = 64;
+    file.logMode(true, threshold);
+    for (int i = 0; i < 20; ++i) {
+        assertEqual(setString(file, 1, "value"), 0);
+        assertLessOrEqual(file.staleSize(), threshold);
+    }
+    assertLessOrEqual(file.size(), (ssize_t)(threshold + recordSize("value") + sizeof(RawFooter)));
+    assertEqual(getString(file, 1), String("value"));
+    file.deInit();
+}
+
+test(TLV_FILE_07_recovers_from_a_torn_append) {
+    assertEqual(mountRamFs(), 0);
+    // A complete record, followed by a record whose value has been partially written
+    uint8_t data[64] = {};
+    size_t size = 0;
+    const RawHeader h1 = { (uint16_t)TLV_HEADER_MAGICK, 1, 3, 0 };
+    memcpy(data + size, &h1, sizeof(h1));
+    size += sizeof(h1);
+    memcpy(data + size, "abc", 3);
+    size += 3;
+    const RawHeader h2 = { (uint16_t)TLV_HEADER_MAGICK, 2, 16, 0 };
+    memcpy(data + size, &h2, sizeof(h2));
+    size += sizeof(h2);
+    memcpy(data + size, "xyzzy", 5);
+    size += 5;
+    const RawFooter footer = { 0, (uint32_t)size, 0, 0, TLV_FILE_MAGICK };
+    memcpy(data + size, &footer, sizeof(footer));
+    assertEqual(writeRawFile(data, size + sizeof(footer)), 0);
+    {
+        TlvFile file(FILE_PATH, &g_fs);
+        assertEqual(file.init(), 0);
+        assertEqual(getString(file, 1), String("abc"));
+        assertEqual(file.get(2, nullptr, 0), (ssize_t)SYSTEM_ERROR_NOT_FOUND);
+        assertEqual(file.staleSize(), sizeof(h2) + 5);
+        // The incomplete record doesn't swallow the records appended after it
+        assertEqual(setString(file, 2, "new"), 0);
+        assertEqual(setString(file, 3, "more"), 0);
+        file.deInit();
+    }
+    TlvFile file(FILE_PATH, &g_fs);
+    assertEqual(file.init(), 0);
+    assertEqual(getString(file, 1), String("abc"));
+    assertEqual(getString(file, 2), String("new"));
+    assertEqual(getString(file, 3), String("more"));
+    assertEqual(file.staleSize(), 0);
+    file.deInit();
+}
+
+test(TLV_FILE_08_log_mode_file_is_not_readable_by_older_firmware_until_compacted) {
+    assertEqual(mountRamFs(), 0);
+    TlvFile file(FILE_PATH, &g_fs);
+    assertEqual(file.init(), 0);
+    assertEqual(setString(file, 1, "one"), 0);
+    file.deInit();
+    assertEqual(fileMagick(), TLV_FILE_MAGICK);
+    assertEqual(file.init(), 0);
+    file.logMode(true);
+    assertEqual(setString(file, 1, "uno"), 0);
+    file.deInit();
+    assertEqual(fileMagick(), TLV_FILE_LOG_MAGICK);
+    assertEqual(file.init(), 0);
+    assertEqual(getString(file, 1), String("uno"));
+    assertEqual(file.compact(), 0);
+    file.deInit();
+    assertEqual(fileMagick(), TLV_FILE_MAGICK);
+}
+
+#endif // HAL_PLATFORM_FILESYSTEM
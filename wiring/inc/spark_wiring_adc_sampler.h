@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "adc_hal.h"
+
+#include <functional>
+#include <cstddef>
+
+namespace particle {
+
+/**
+ * Continuous sampling of an analog pin.
+ *
+ * The conversions are triggered by a hardware timer and the samples are written to the buffer by
+ * DMA, so sampling at a fixed rate doesn't take any CPU time. The buffer is split into two halves:
+ * while one half is being filled, the other half can be processed by the application. A half that
+ * is filled while the application is still processing the other half is dropped and counted as an
+ * overrun.
+ *
+ * The filled halves can be received in two ways:
+ *
+ * - If a callback is passed to `begin()`, it is invoked for each filled half in the ISR context.
+ *   The samples can only be accessed until the callback returns.
+ *
+ * - Otherwise, the application polls for filled halves using `read()`, and hands them back to the
+ *   sampler using `release()`. The sampling doesn't stop while the application holds a half, so
+ *   the half is overwritten if it's held for longer than it takes to fill the other half. In that
+ *   case `release()` returns an error and the results computed from the samples should be
+ *   discarded:
+ *
+ * ```
+ * uint16_t buf[512];
+ * ADCSampler sampler;
+ *
+ * void setup() {
+ *     sampler.begin(A0, 8000, buf, 512);
+ * }
+ *
+ * void loop() {
+ *     size_t count = 0;
+ *     const uint16_t* samples = sampler.read(&count);
+ *     if (samples) {
+ *         dsp::q15_t x[256];
+ *         dsp::adcToQ15(samples, x, count);
+ *         if (sampler.release() == 0) {
+ *             ...
+ *         }
+ *     }
+ * }
+ * ```
+ *
+ * `analogRead()` is not available while the sampler is running. Only one sampler can be running
+ * at a time.
+ */
+class ADCSampler {
+public:
+    typedef std::function<void(const uint16_t* samples, size_t count)> Callback;
+
+    ADCSampler();
+    ~ADCSampler();
+
+    /**
+     * Starts sampling.
+     *
+     * @param pin Analog pin.
+     * @param sampleRate Samples per second.
+     * @param buffer Sampling buffer. The buffer needs to stay valid until the sampling is stopped.
+     * @param size Number of samples in the buffer, must be even.
+     * @param callback Callback invoked in the ISR context for each filled half of the buffer.
+     *
+     * @return 0 on success, or a negative result code in case of an error.
+     */
+    int begin(pin_t pin, uint32_t sampleRate, uint16_t* buffer, size_t size, Callback callback = nullptr);
+    // Stops sampling
+    void end();
+
+    // Returns the filled half of the buffer, or nullptr if no half is available
+    const uint16_t* read(size_t* count = nullptr) const;
+    // Hands the half returned by read() back to the sampler. Returns SYSTEM_ERROR_TIMEOUT if the
+    // half has been overwritten while it was held
+    int release();
+    // Returns true if a filled half is available
+    bool available() const;
+
+    // Actual sample rate, which may differ from the requested rate due to the timer resolution
+    uint32_t sampleRate() const;
+    // Number of filled halves that were delivered to the application
+    uint32_t buffers() const;
+    // Number of filled halves that were dropped
+    uint32_t overruns() const;
+
+    bool isRunning() const {
+        return running_;
+    }
+
+private:
+    Callback callback_;
+    const uint16_t* volatile samples_;
+    volatile size_t count_;
+    bool running_;
+
+    HAL_ADC_Sampler_Stats stats() const;
+
+    static void halCallback(const uint16_t* samples, size_t count, void* context);
+};
+
+} // namespace particle
@@ -27,6 +27,7 @@
 #include <functional>
 #include <memory>
 #include <atomic>
+#include <type_traits>
 
 #if (ATOMIC_POINTER_LOCK_FREE != 2) || (ATOMIC_CHAR_LOCK_FREE != 2) || (ATOMIC_BOOL_LOCK_FREE != 2)
 #error "std::atomic is not always lock-free for required types"
@@ -448,6 +449,67 @@ public:
     }
 };
 
+namespace detail {
+
+// Completes a promise with the result of another future
+template<typename ResultT, typename ContextT>
+void forwardResult(Future<ResultT, ContextT>& future, Promise<ResultT, ContextT> promise) {
+    future.onSuccess([promise](const ResultT& result) mutable {
+        promise.setResult(result);
+    });
+    future.onError([promise](const Error& error) mutable {
+        promise.setError(error);
+    });
+}
+
+template<typename ContextT>
+void forwardResult(Future<void, ContextT>& future, Promise<void, ContextT> promise) {
+    future.onSuccess([promise]() mutable {
+        promise.setResult();
+    });
+    future.onError([promise](const Error& error) mutable {
+        promise.setError(error);
+    });
+}
+
+// Helper class completing a promise with the result of a continuation function (see Future::then())
+template<typename ResultT, typename ContextT>
+struct Continuation {
+    typedef ResultT Result;
+
+    template<typename FunctionT, typename... ArgsT>
+    static void complete(Promise<ResultT, ContextT>& promise, FunctionT& fn, ArgsT&&... args) {
+        promise.setResult(fn(std::forward<ArgsT>(args)...));
+    }
+};
+
+// Specialization for continuation functions that don't return a result
+template<typename ContextT>
+struct Continuation<void, ContextT> {
+    typedef void Result;
+
+    template<typename FunctionT, typename... ArgsT>
+    static void complete(Promise<void, ContextT>& promise, FunctionT& fn, ArgsT&&... args) {
+        fn(std::forward<ArgsT>(args)...);
+        promise.setResult();
+    }
+};
+
+// Specialization for continuation functions that start another asynchronous operation. The promise
+// is completed once that operation completes
+template<typename ResultT, typename ContextT>
+struct Continuation<Future<ResultT, ContextT>, ContextT> {
+    typedef ResultT Result;
+
+    template<typename FunctionT, typename... ArgsT>
+    static void complete(Promise<ResultT, ContextT>& promise, FunctionT& fn, ArgsT&&... args) {
+        Future<ResultT, ContextT> future = fn(std::forward<ArgsT>(args)...);
+        forwardResult(future, std::move(promise));
+    }
+};
+
+} // namespace particle::detail
+
 // Base class for Future. Future allows to access result of an asynchronous operation
 template<typename ResultT, typename ContextT>
 class FutureBase {
@@ -531,6 +593,24 @@ public:
         return this->p_->result(std::move(defaultValue));
     }
 
+    // Invokes a function with the result of the operation once it succeeds, without blocking the
+    // calling thread. Returns a future for the result of the function; if the function returns
+    // another future, the returned future completes once that future completes. Errors are passed
+    // on to the returned future without invoking the function. This method uses the completion
+    // callbacks of this future, see onSuccess() and onError()
+    template<typename FunctionT, typename RetT = typename std::result_of<FunctionT(const ResultT&)>::type>
+    Future<typename detail::Continuation<RetT, ContextT>::Result, ContextT> then(FunctionT fn) {
+        typedef detail::Continuation<RetT, ContextT> Continuation;
+        Promise<typename Continuation::Result, ContextT> p;
+        this->onSuccess([p, fn](const ResultT& result) mutable {
+            Continuation::complete(p, fn, result);
+        });
+        this->onError([p](const Error& error) mutable {
+            p.setError(error);
+        });
+        return p.future();
+    }
+
     operator ResultT() const {
         return result();
     }
@@ -547,6 +627,20 @@ public:
             FutureBase<void, ContextT>(std::make_shared<detail::FutureImpl<void, ContextT>>(State::SUCCEEDED)) {
     }
 
+    // See Future<ResultT, ContextT>::then()
+    template<typename FunctionT, typename RetT = typename std::result_of<FunctionT()>::type>
+    Future<typename detail::Continuation<RetT, ContextT>::Result, ContextT> then(FunctionT fn) {
+        typedef detail::Continuation<RetT, ContextT> Continuation;
+        Promise<typename Continuation::Result, ContextT> p;
+        this->onSuccess([p, fn]() mutable {
+            Continuation::complete(p, fn);
+        });
+        this->onError([p](const Error& error) mutable {
+            p.setError(error);
+        });
+        return p.future();
+    }
+
 private:
     using typename FutureBase<void, ContextT>::State;
 };
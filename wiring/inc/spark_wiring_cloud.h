@@ -237,6 +237,24 @@ public:
         return publish_event(eventName, eventData, ttl, flags1 | flags2);
     }
 
+    // Same as publish(), but returns without waiting for the system thread to process the event. The
+    // returned future completes once the event is sent, and can be chained with Future::then() or
+    // awaited in a coroutine (see spark_wiring_coroutine.h)
+    inline particle::Future<bool> publishAsync(const char *eventName, PublishFlags flags1, PublishFlags flags2 = PublishFlags())
+    {
+        return publishAsync(eventName, NULL, flags1, flags2);
+    }
+
+    inline particle::Future<bool> publishAsync(const char *eventName, const char *eventData, PublishFlags flags1, PublishFlags flags2 = PublishFlags())
+    {
+        return publishAsync(eventName, eventData, 60, flags1, flags2);
+    }
+
+    inline particle::Future<bool> publishAsync(const char *eventName, const char *eventData, int ttl, PublishFlags flags1, PublishFlags flags2 = PublishFlags())
+    {
+        return publish_event(eventName, eventData, ttl, flags1 | flags2 | PublishFlag(PUBLISH_EVENT_FLAG_ASYNC));
+    }
+
     // Deprecated methods
     particle::Future<bool> publish(const char* name) PARTICLE_DEPRECATED_API_DEFAULT_PUBLISH_SCOPE;
     particle::Future<bool> publish(const char* name, const char* data) PARTICLE_DEPRECATED_API_DEFAULT_PUBLISH_SCOPE;
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "spark_wiring_async.h"
+
+#include <cstddef>
+
+namespace particle {
+
+/**
+ * Lightweight coroutine running in the context of the application thread.
+ *
+ * Coroutines are stackless: the body of `run()` is resumed at the point where it last yielded, but
+ * local variables are not preserved across the yield points, so any state that needs to outlive a
+ * yield should be stored in the members of a derived class. The body is written using the
+ * `COROUTINE_*` macros:
+ *
+ * ```
+ * class Reporter: public Coroutine {
+ * protected:
+ *     bool run() override {
+ *         COROUTINE_BEGIN();
+ *         COROUTINE_AWAIT(Particle.connected());
+ *         published_ = Particle.publishAsync("status", "online", PRIVATE);
+ *         COROUTINE_AWAIT(published_);
+ *         if (published_.isSucceeded()) {
+ *             ...
+ *         }
+ *         COROUTINE_END();
+ *     }
+ *
+ * private:
+ *     Future<bool> published_;
+ * };
+ * ```
+ *
+ * Note that `switch` statements can't be used across the yield points.
+ */
+class Coroutine {
+public:
+    Coroutine() :
+            next_(nullptr),
+            state_(0),
+            done_(false) {
+    }
+
+    virtual ~Coroutine() = default;
+
+    // Returns true if the coroutine has run to completion
+    bool isDone() const {
+        return done_;
+    }
+
+    // Resumes the coroutine. Returns false if the coroutine has completed
+    bool resume() {
+        if (!done_ && !run()) {
+            done_ = true;
+        }
+        return !done_;
+    }
+
+    // Makes the coroutine start from the beginning the next time it's resumed
+    void reset() {
+        state_ = 0;
+        done_ = false;
+    }
+
+protected:
+    // Body of the coroutine. Returns false when the coroutine has completed
+    virtual bool run() = 0;
+
+    // State of the coroutine, used by the COROUTINE_* macros
+    int coroutineState() const {
+        return state_;
+    }
+
+    void setCoroutineState(int state) {
+        state_ = state;
+    }
+
+    // Readiness checks for COROUTINE_AWAIT()
+    static bool awaitReady(bool condition) {
+        return condition;
+    }
+
+    template<typename ResultT, typename ContextT>
+    static bool awaitReady(const Future<ResultT, ContextT>& future) {
+        return future.isDone();
+    }
+
+private:
+    Coroutine* next_;
+    int state_;
+    bool done_;
+
+    friend class CoroutineScheduler;
+};
+
+/**
+ * Cooperative scheduler for coroutines.
+ *
+ * The scheduler is meant to be run from `loop()` or any other code running in the context of the
+ * application thread. The future callbacks are invoked in the same context, so a coroutine that is
+ * waiting for an asynchronous operation can be resumed as soon as the scheduler runs again.
+ */
+class CoroutineScheduler {
+public:
+    CoroutineScheduler() :
+            head_(nullptr),
+            tail_(nullptr) {
+    }
+
+    // Adds a coroutine to the scheduler. The coroutine is started from the beginning. The scheduler
+    // doesn't take ownership over the coroutine object, which needs to stay valid until it's done or
+    // removed from the scheduler
+    void start(Coroutine* c) {
+        stop(c);
+        c->reset();
+        c->next_ = nullptr;
+        if (tail_) {
+            tail_->next_ = c;
+        } else {
+            head_ = c;
+        }
+        tail_ = c;
+    }
+
+    // Removes a coroutine from the scheduler
+    void stop(Coroutine* c) {
+        Coroutine* prev = nullptr;
+        for (Coroutine* it = head_; it; prev = it, it = it->next_) {
+            if (it == c) {
+                remove(prev, it);
+                break;
+            }
+        }
+    }
+
+    // Resumes each coroutine once, in the order they were started. Coroutines started while the
+    // scheduler is running are resumed in the same pass; stopping coroutines is only allowed outside
+    // of the scheduler. Returns the number of coroutines that are still running
+    size_t process() {
+        size_t count = 0;
+        Coroutine* prev = nullptr;
+        Coroutine* c = head_;
+        while (c) {
+            const bool running = c->resume();
+            const auto next = c->next_;
+            if (running) {
+                ++count;
+                prev = c;
+            } else {
+                remove(prev, c);
+            }
+            c = next;
+        }
+        return count;
+    }
+
+    // Returns true if there are no running coroutines
+    bool isEmpty() const {
+        return !head_;
+    }
+
+private:
+    Coroutine* head_;
+    Coroutine* tail_;
+
+    void remove(Coroutine* prev, Coroutine* c) {
+        if (prev) {
+            prev->next_ = c->next_;
+        } else {
+            head_ = c->next_;
+        }
+        if (tail_ == c) {
+            tail_ = prev;
+        }
+        c->next_ = nullptr;
+    }
+};
+
+} // namespace particle
+
+// Marks the beginning of the coroutine's body
+#define COROUTINE_BEGIN() \
+        switch (this->coroutineState()) { \
+        case 0:
+
+// Suspends the coroutine until the next time it's resumed
+#define COROUTINE_YIELD() \
+        do { \
+            this->setCoroutineState(__LINE__); \
+            return true; \
+        case __LINE__:; \
+        } while (false)
+
+// Suspends the coroutine until a condition becomes true or a future completes
+#define COROUTINE_AWAIT(_expr) \
+        do { \
+            this->setCoroutineState(__LINE__); \
+        case __LINE__: \
+            if (!this->awaitReady(_expr)) { \
+                return true; \
+            } \
+        } while (false)
+
+// Marks the end of the coroutine's body
+#define COROUTINE_END() \
+        } \
+        return false
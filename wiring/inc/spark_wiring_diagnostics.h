@@ -22,12 +22,16 @@
 #include "spark_wiring_global.h"
 
 #include "diagnostics.h"
+#include "system_tick_hal.h"
 #include "system_error.h"
 #include "combine_hash.h"
 #include "underlying_type.h"
 #include "debug.h"
 
+#include <algorithm>
 #include <atomic>
+#include <cstring>
+#include <initializer_list>
 
 #define PARTICLE_RETAINED_INTEGER_DIAGNOSTIC_DATA(_var, _id, _name, _val, ...) \
         PARTICLE_RETAINED ::particle::RetainedIntegerDiagnosticDataStorage _storage##_id; \
@@ -423,6 +427,175 @@ private:
     }
 };
 
+// Data source accumulating the minimum, maximum and average of recorded values
+template<typename ConcurrencyT = NoConcurrency>
+class StatsDiagnosticData:
+        public AbstractDiagnosticData,
+        private ConcurrencyT {
+public:
+    typedef int32_t IntType;
+
+    explicit StatsDiagnosticData(DiagnosticDataId id, const char* name = nullptr) :
+            AbstractDiagnosticData(id, name, DIAG_TYPE_STATS),
+            sum_(0),
+            min_(0),
+            max_(0),
+            count_(0) {
+    }
+
+    void record(IntType val) {
+        const auto lock = ConcurrencyT::lock();
+        if (count_ == 0 || val < min_) {
+            min_ = val;
+        }
+        if (count_ == 0 || val > max_) {
+            max_ = val;
+        }
+        sum_ += val;
+        ++count_;
+        ConcurrencyT::unlock(lock);
+    }
+
+    void reset() {
+        const auto lock = ConcurrencyT::lock();
+        sum_ = 0;
+        min_ = 0;
+        max_ = 0;
+        count_ = 0;
+        ConcurrencyT::unlock(lock);
+    }
+
+    diag_stats stats() const {
+        diag_stats s = {};
+        const auto lock = ConcurrencyT::lock();
+        if (count_ > 0) {
+            s.min = min_;
+            s.max = max_;
+            s.avg = (IntType)(sum_ / (int64_t)count_);
+            s.count = count_;
+        }
+        ConcurrencyT::unlock(lock);
+        return s;
+    }
+
+private:
+    int64_t sum_;
+    IntType min_;
+    IntType max_;
+    uint32_t count_;
+
+    virtual int get(void* data, size_t& size) override { // AbstractDiagnosticData
+        if (!data) {
+            size = sizeof(diag_stats);
+            return SYSTEM_ERROR_NONE;
+        }
+        if (size < sizeof(diag_stats)) {
+            return SYSTEM_ERROR_TOO_LARGE;
+        }
+        *(diag_stats*)data = stats();
+        size = sizeof(diag_stats);
+        return SYSTEM_ERROR_NONE;
+    }
+};
+
+// Data source counting recorded values in `N` buckets of equal width
+template<size_t N, typename ConcurrencyT = NoConcurrency>
+class HistogramDiagnosticData:
+        public AbstractDiagnosticData,
+        private ConcurrencyT {
+public:
+    typedef int32_t IntType;
+
+    static_assert(N > 0 && N <= 0xffff, "Invalid number of buckets");
+
+    HistogramDiagnosticData(DiagnosticDataId id, IntType bucketMin, IntType bucketWidth) :
+            HistogramDiagnosticData(id, nullptr, bucketMin, bucketWidth) {
+    }
+
+    HistogramDiagnosticData(DiagnosticDataId id, const char* name, IntType bucketMin, IntType bucketWidth) :
+            AbstractDiagnosticData(id, name, DIAG_TYPE_HISTOGRAM),
+            min_(bucketMin),
+            width_((bucketWidth > 0) ? bucketWidth : 1),
+            counts_() {
+    }
+
+    void record(IntType val) {
+        size_t i = 0;
+        if (val >= min_) {
+            i = std::min<int64_t>(((int64_t)val - min_) / width_, N - 1);
+        }
+        const auto lock = ConcurrencyT::lock();
+        ++counts_[i];
+        ConcurrencyT::unlock(lock);
+    }
+
+    void reset() {
+        const auto lock = ConcurrencyT::lock();
+        memset(counts_, 0, sizeof(counts_));
+        ConcurrencyT::unlock(lock);
+    }
+
+    uint32_t count(size_t bucket) const {
+        const auto lock = ConcurrencyT::lock();
+        const uint32_t n = (bucket < N) ? counts_[bucket] : 0;
+        ConcurrencyT::unlock(lock);
+        return n;
+    }
+
+    size_t bucketCount() const {
+        return N;
+    }
+
+private:
+    IntType min_;
+    IntType width_;
+    uint32_t counts_[N];
+
+    virtual int get(void* data, size_t& size) override { // AbstractDiagnosticData
+        const size_t dataSize = sizeof(diag_histogram) + sizeof(counts_);
+        if (!data) {
+            size = dataSize;
+            return SYSTEM_ERROR_NONE;
+        }
+        if (size < dataSize) {
+            return SYSTEM_ERROR_TOO_LARGE;
+        }
+        const auto h = (diag_histogram*)data;
+        h->bucket_min = min_;
+        h->bucket_width = width_;
+        h->bucket_count = N;
+        h->reserved = 0;
+        const auto lock = ConcurrencyT::lock();
+        memcpy((char*)data + sizeof(diag_histogram), counts_, sizeof(counts_));
+        ConcurrencyT::unlock(lock);
+        size = dataSize;
+        return SYSTEM_ERROR_NONE;
+    }
+};
+
+// Records values of integer data sources at a fixed period. The recorded samples are sent to the
+// cloud in compact batches on request
+class DiagnosticsHistory {
+public:
+    static int start(const DiagnosticDataId* ids, size_t count, system_tick_t period, size_t bufferSize) {
+        diag_sampler_config d = {};
+        d.size = sizeof(d);
+        d.source_count = count;
+        d.source_ids = ids;
+        d.period = period;
+        d.buffer_size = bufferSize;
+        return diag_command(DIAG_SERVICE_CMD_SAMPLER_CONFIG, &d, nullptr);
+    }
+
+    static int start(std::initializer_list<DiagnosticDataId> ids, system_tick_t period, size_t bufferSize) {
+        return start(ids.begin(), ids.size(), period, bufferSize);
+    }
+
+    static int stop() {
+        return start(nullptr, 0, 0, 0);
+    }
+};
+
 template<typename ValueT>
 class RetainedDiagnosticDataStorage {
 public:
@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Fixed-point signal processing on blocks of Q15 and Q31 samples.
+ *
+ * All filters process whole buffers at a time, so that blocks of ADC samples can be filtered
+ * without a call per sample. The state and coefficient buffers are owned by the caller and the
+ * filters don't allocate memory. On MCUs with the DSP extension (Cortex-M4) the Q15 kernels use
+ * the dual 16-bit SIMD instructions, other platforms use portable implementations. The results of
+ * the two implementations may differ in rounding.
+ */
+
+namespace particle {
+
+namespace dsp {
+
+// Signed fractional samples in the range [-1, 1)
+typedef int16_t q15_t; // Q1.15
+typedef int32_t q31_t; // Q1.31
+
+const q15_t Q15_MAX = INT16_MAX;
+const q15_t Q15_MIN = INT16_MIN;
+const q31_t Q31_MAX = INT32_MAX;
+const q31_t Q31_MIN = INT32_MIN;
+
+// Largest FFT size supported by fft() and ifft()
+const size_t MAX_FFT_SIZE = 1024;
+
+inline q15_t saturateQ15(int32_t v) {
+    return (v > Q15_MAX) ? Q15_MAX : (v < Q15_MIN) ? Q15_MIN : (q15_t)v;
+}
+
+inline q31_t saturateQ31(int64_t v) {
+    return (v > Q31_MAX) ? Q31_MAX : (v < Q31_MIN) ? Q31_MIN : (q31_t)v;
+}
+
+inline q15_t mulQ15(q15_t a, q15_t b) {
+    return saturateQ15(((int32_t)a * b) >> 15);
+}
+
+inline q31_t mulQ31(q31_t a, q31_t b) {
+    return saturateQ31(((int64_t)a * b) >> 31);
+}
+
+inline q15_t floatToQ15(float v) {
+    return saturateQ15((int32_t)(v * 32768.0f));
+}
+
+inline q31_t floatToQ31(double v) {
+    return saturateQ31((int64_t)(v * 2147483648.0));
+}
+
+/**
+ * Converts unsigned ADC readings to Q15 samples centered around zero.
+ *
+ * @param in Readings.
+ * @param out Output buffer. Can be the same buffer as `in`.
+ * @param n Number of readings.
+ * @param bits Resolution of the ADC.
+ */
+void adcToQ15(const uint16_t* in, q15_t* out, size_t n, unsigned bits = 12);
+
+// Mean value of a block of samples
+q15_t mean(const q15_t* x, size_t n);
+q31_t mean(const q31_t* x, size_t n);
+
+// Root mean square of a block of samples
+q15_t rms(const q15_t* x, size_t n);
+q31_t rms(const q31_t* x, size_t n);
+
+// Magnitudes of `n` complex samples stored as interleaved real and imaginary parts
+void magnitude(const q15_t* x, q15_t* out, size_t n);
+void magnitude(const q31_t* x, q31_t* out, size_t n);
+
+/**
+ * In-place complex FFT.
+ *
+ * The samples are stored as interleaved real and imaginary parts. The transform is computed using
+ * radix-4 stages, preceded by a radix-2 stage if the size is not a power of 4. The output of each
+ * stage is scaled down to avoid overflows, so the result is the DFT divided by `size`. The
+ * magnitude of the input samples should not exceed 1.
+ *
+ * @param x Samples.
+ * @param size Number of complex samples, a power of 2 not greater than `MAX_FFT_SIZE`.
+ *
+ * @return `false` if the size is not supported.
+ */
+bool fft(q15_t* x, size_t size);
+bool fft(q31_t* x, size_t size);
+
+// In-place inverse FFT. The result is scaled down by `size`, see fft()
+bool ifft(q15_t* x, size_t size);
+bool ifft(q31_t* x, size_t size);
+
+namespace detail {
+
+// Block kernels used by the filter classes
+void firBlock(const q15_t* x, const q15_t* h, size_t taps, q15_t* out, size_t n, size_t step);
+void firBlock(const q31_t* x, const q31_t* h, size_t taps, q31_t* out, size_t n, size_t step);
+void biquadBlock(const q15_t* coeffs, q15_t* state, unsigned postShift, const q15_t* in, q15_t* out, size_t n);
+void biquadBlock(const q31_t* coeffs, q31_t* state, unsigned postShift, const q31_t* in, q31_t* out, size_t n);
+
+// Square of a sample in the same format, accumulated by MovingStatistics
+inline uint32_t square(q15_t x) {
+    return (int32_t)x * x;
+}
+
+inline uint64_t square(q31_t x) {
+    return (uint64_t)((int64_t)x * x) >> 31;
+}
+
+uint32_t sqrt64(uint64_t v);
+
+} // namespace particle::dsp::detail
+
+/**
+ * FIR filter.
+ *
+ * Output sample `y[n]` is the sum of `h[k] * x[n - k]` for each of the coefficients `h`. To avoid
+ * overflows, the sum of the absolute values of the coefficients should not exceed 1.
+ */
+template<typename T>
+class FirFilter {
+public:
+    /**
+     * Constructor.
+     *
+     * @param coeffs Coefficients. The buffer needs to stay valid for the lifetime of the filter.
+     * @param taps Number of coefficients.
+     * @param state State buffer of the size returned by `stateSize(taps, maxBlockSize)`.
+     * @param maxBlockSize Number of samples processed in one pass. Larger blocks are split.
+     */
+    FirFilter(const T* coeffs, size_t taps, T* state, size_t maxBlockSize) :
+            FirFilter(coeffs, taps, 1, state, maxBlockSize) {
+    }
+
+    void process(const T* in, T* out, size_t n) {
+        processBlocks(in, out, n);
+    }
+
+    // Clears the input history
+    void reset() {
+        memset(state_, 0, (taps_ - 1) * sizeof(T));
+        phase_ = 0;
+    }
+
+    static size_t stateSize(size_t taps, size_t maxBlockSize) {
+        return taps + maxBlockSize - 1;
+    }
+
+protected:
+    FirFilter(const T* coeffs, size_t taps, size_t factor, T* state, size_t maxBlockSize) :
+            coeffs_(coeffs),
+            state_(state),
+            taps_(taps),
+            factor_(factor),
+            blockSize_(maxBlockSize),
+            phase_(0) {
+        reset();
+    }
+
+    // Returns the number of output samples
+    size_t processBlocks(const T* in, T* out, size_t n) {
+        size_t count = 0;
+        while (n > 0) {
+            const size_t size = (n < blockSize_) ? n : blockSize_;
+            // The state buffer contains the last `taps - 1` input samples followed by the new block
+            memcpy(state_ + taps_ - 1, in, size * sizeof(T));
+            if (phase_ < size) {
+                const size_t outCount = (size - phase_ + factor_ - 1) / factor_;
+                detail::firBlock(state_ + phase_, coeffs_, taps_, out + count, outCount, factor_);
+                count += outCount;
+                phase_ += outCount * factor_;
+            }
+            phase_ -= size;
+            memmove(state_, state_ + size, (taps_ - 1) * sizeof(T));
+            in += size;
+            n -= size;
+        }
+        return count;
+    }
+
+private:
+    const T* coeffs_;
+    T* state_;
+    size_t taps_;
+    size_t factor_;
+    size_t blockSize_;
+    size_t phase_; // Input samples to skip before the next output sample
+};
+
+/**
+ * Decimating FIR filter.
+ *
+ * Keeps every `factor`-th output sample of the FIR filter. Only the kept samples are computed.
+ */
+template<typename T>
+class FirDecimator: public FirFilter<T> {
+public:
+    FirDecimator(const T* coeffs, size_t taps, size_t factor, T* state, size_t maxBlockSize) :
+            FirFilter<T>(coeffs, taps, factor, state, maxBlockSize) {
+    }
+
+    // Returns the number of output samples. The output buffer needs to have room for
+    // `(n + factor - 1) / factor` samples
+    size_t process(const T* in, T* out, size_t n) {
+        return this->processBlocks(in, out, n);
+    }
+};
+
+/**
+ * Cascade of biquad IIR filters in direct form I.
+ *
+ * Each stage computes `y[n] = b0 * x[n] + b1 * x[n-1] + b2 * x[n-2] - a1 * y[n-1] - a2 * y[n-2]`.
+ * The coefficients of each stage are stored as `{ b0, b1, b2, a1, a2 }` and are scaled down by
+ * `2 ^ postShift`, so that coefficients in the range [-2, 2) can be represented with the default
+ * shift of 1.
+ */
+template<typename T>
+class BiquadCascade {
+public:
+    static const size_t COEFFS_PER_STAGE = 5;
+    static const size_t STATE_PER_STAGE = 4;
+
+    /**
+     * Constructor.
+     *
+     * @param coeffs Coefficients, `COEFFS_PER_STAGE` per stage. The buffer needs to stay valid for
+     *        the lifetime of the filter.
+     * @param stages Number of stages.
+     * @param state State buffer, `STATE_PER_STAGE` samples per stage.
+     * @param postShift Scaling of the coefficients.
+     */
+    BiquadCascade(const T* coeffs, size_t stages, T* state, unsigned postShift = 1) :
+            coeffs_(coeffs),
+            state_(state),
+            stages_(stages),
+            postShift_(postShift) {
+        reset();
+    }
+
+    // Filters a block of samples. The input and output buffers can be the same buffer
+    void process(const T* in, T* out, size_t n) {
+        for (size_t i = 0; i < stages_; ++i) {
+            detail::biquadBlock(coeffs_ + i * COEFFS_PER_STAGE, state_ + i * STATE_PER_STAGE, postShift_,
+                    in, out, n);
+            in = out;
+        }
+    }
+
+    void reset() {
+        memset(state_, 0, stages_ * STATE_PER_STAGE * sizeof(T));
+    }
+
+private:
+    const T* coeffs_;
+    T* state_;
+    size_t stages_;
+    unsigned postShift_;
+};
+
+/**
+ * Statistics of the last samples in a sliding window.
+ *
+ * The sums are updated incrementally, so adding a sample takes constant time regardless of the
+ * window size.
+ */
+template<typename T>
+class MovingStatistics {
+public:
+    // The window buffer needs to hold `size` samples
+    MovingStatistics(T* window, size_t size) :
+            window_(window),
+            size_(size) {
+        reset();
+    }
+
+    void add(T x) {
+        if (count_ == size_) {
+            const T old = window_[pos_];
+            sum_ -= old;
+            sumSq_ -= detail::square(old);
+        } else {
+            ++count_;
+        }
+        window_[pos_] = x;
+        sum_ += x;
+        sumSq_ += detail::square(x);
+        if (++pos_ == size_) {
+            pos_ = 0;
+        }
+    }
+
+    void add(const T* x, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            add(x[i]);
+        }
+    }
+
+    // Number of samples in the window
+    size_t count() const {
+        return count_;
+    }
+
+    T mean() const {
+        return count_ ? (T)(sum_ / (int64_t)count_) : 0;
+    }
+
+    T rms() const {
+        return count_ ? (T)detail::sqrt64(meanSquare() << SHIFT) : 0;
+    }
+
+    T standardDeviation() const {
+        if (!count_) {
+            return 0;
+        }
+        const uint64_t m = detail::square(mean());
+        const uint64_t ms = meanSquare();
+        return (ms > m) ? (T)detail::sqrt64((ms - m) << SHIFT) : 0;
+    }
+
+    void reset() {
+        sum_ = 0;
+        sumSq_ = 0;
+        count_ = 0;
+        pos_ = 0;
+    }
+
+private:
+    // Shift converting a mean square to the input format of sqrt64()
+    static const unsigned SHIFT = (sizeof(T) == sizeof(q15_t)) ? 0 : 31;
+
+    T* window_;
+    size_t size_;
+    int64_t sum_;
+    uint64_t sumSq_;
+    size_t count_;
+    size_t pos_;
+
+    uint64_t meanSquare() const {
+        return sumSq_ / count_;
+    }
+};
+
+} // namespace particle::dsp
+
+} // namespace particle
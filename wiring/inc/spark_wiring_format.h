@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARK_WIRING_FORMAT_H
+#define SPARK_WIRING_FORMAT_H
+
+#include <cstdarg>
+#include <cstddef>
+
+namespace particle {
+
+/**
+ * Maximum number of characters produced by `formatUnsigned()`.
+ */
+const size_t FORMAT_UNSIGNED_MAX_SIZE = 64;
+
+/**
+ * Maximum number of fractional digits computed by `formatFixed()`. Further digits are filled
+ * with zeros.
+ */
+const unsigned FORMAT_FIXED_MAX_PRECISION = 19;
+
+/**
+ * Rounding modes supported by `formatFixed()`.
+ */
+enum FormatRounding {
+    /**
+     * Halfway cases are rounded away from zero. Values that are within a rounding error from
+     * a halfway case are treated as such, so that, for example, 1.005 is rounded to 1.01.
+     */
+    FORMAT_ROUND_HALF_UP,
+    /**
+     * Exact rounding of the binary value, as done by `printf()`. Values that are too close to
+     * a halfway case to be rounded reliably are rejected.
+     */
+    FORMAT_ROUND_EXACT
+};
+
+/**
+ * Output callback.
+ *
+ * @param data Formatted data.
+ * @param size Data size.
+ * @param ctx User data.
+ * @return Number of bytes written.
+ */
+typedef size_t(*FormatCallback)(const char* data, size_t size, void* ctx);
+
+/**
+ * Formats a string and writes it to a callback.
+ *
+ * Unlike `vsnprintf()`, this function formats the string in a single pass and writes it out in
+ * small chunks as it goes, so the size of the output doesn't need to be known in advance.
+ * Integer, string, character and fixed-point conversions are formatted natively, other
+ * conversions are delegated to the C library.
+ *
+ * @param callback Output callback.
+ * @param ctx User data passed to the callback.
+ * @param fmt Format string.
+ * @param args Arguments.
+ * @return Total number of bytes written, as returned by the callback.
+ */
+size_t vformat(FormatCallback callback, void* ctx, const char* fmt, va_list args);
+
+/**
+ * Formats an unsigned integer.
+ *
+ * The digits are written backwards, so that the last digit is stored right before `end`.
+ * The buffer needs to have room for at least `FORMAT_UNSIGNED_MAX_SIZE` characters. The
+ * output is not null-terminated.
+ *
+ * @param end End of the destination buffer.
+ * @param value Value.
+ * @param base Base (2 to 36). Invalid values are treated as 10.
+ * @param upperCase Use upper case letters for digits above 9.
+ * @return Pointer to the first digit.
+ */
+char* formatUnsigned(char* end, unsigned long long value, unsigned base = 10, bool upperCase = false);
+
+/**
+ * Formats a non-negative floating point number in fixed-point notation.
+ *
+ * @param buf Destination buffer.
+ * @param size Buffer size.
+ * @param value Value. Must be a finite number less than 2^64.
+ * @param precision Number of digits after the decimal point.
+ * @param rounding Rounding mode.
+ * @return Number of characters written, not counting the terminating null, or a negative value
+ *         if the number cannot be formatted.
+ */
+int formatFixed(char* buf, size_t size, double value, unsigned precision, FormatRounding rounding = FORMAT_ROUND_HALF_UP);
+
+} // namespace particle
+
+#endif // SPARK_WIRING_FORMAT_H
@@ -76,6 +76,8 @@ protected:
 private:
     LEDStatusData d_;
 
+    void notifyChanged();
+
     static void updateCallback(system_tick_t ticks, void* data);
 };
 
@@ -148,6 +150,7 @@ inline particle::LEDStatus::~LEDStatus() {
 
 inline void particle::LEDStatus::setColor(uint32_t color) {
     d_.color = color;
+    notifyChanged();
 }
 
 inline uint32_t particle::LEDStatus::color() const {
@@ -158,6 +161,7 @@ inline void particle::LEDStatus::setPattern(LEDPattern pattern) {
     // Custom pattern type can be set only at constuction time
     if (pattern != LED_PATTERN_CUSTOM && d_.pattern != LED_PATTERN_CUSTOM) {
         d_.pattern = pattern;
+        notifyChanged();
     }
 }
 
@@ -173,6 +177,7 @@ inline void particle::LEDStatus::setPeriod(uint16_t period) {
     // Pattern period cannot be set for custom pattern type
     if (d_.pattern != LED_PATTERN_CUSTOM) {
         d_.period = period;
+        notifyChanged();
     }
 }
 
@@ -190,14 +195,17 @@ inline LEDPriority particle::LEDStatus::priority() const {
 
 inline void particle::LEDStatus::on() {
     d_.flags &= ~LED_STATUS_FLAG_OFF;
+    notifyChanged();
 }
 
 inline void particle::LEDStatus::off() {
     d_.flags |= LED_STATUS_FLAG_OFF;
+    notifyChanged();
 }
 
 inline void particle::LEDStatus::toggle() {
     d_.flags ^= LED_STATUS_FLAG_OFF;
+    notifyChanged();
 }
 
 inline bool particle::LEDStatus::isOn() {
@@ -225,6 +233,13 @@ inline void particle::LEDStatus::update(system_tick_t ticks) {
     // Default implementation does nothing
 }
 
+inline void particle::LEDStatus::notifyChanged() {
+    // Let the LED service know that it needs to update the LED color
+    if (d_.flags & LED_STATUS_FLAG_ACTIVE) {
+        led_notify_changed(nullptr);
+    }
+}
+
 // particle::LEDSystemTheme
 inline particle::LEDSystemTheme::LEDSystemTheme() :
         d_{ LED_SIGNAL_THEME_VERSION } {
@@ -35,6 +35,8 @@
 #include "scope_guard.h"
 
 #include "spark_wiring_thread.h"
+#include "spark_wiring_timer.h"
+#include "spark_wiring_mesh_publish.h"
 
 namespace spark {
 
@@ -75,6 +77,15 @@ public:
 
 int mesh_loop();
 
+struct MeshPublishStats {
+    unsigned eventsPublished; // Events passed to publish()
+    unsigned eventsSuppressed; // Events that were not sent because no node is subscribed to them
+    unsigned eventPackets; // Datagrams with events sent
+    unsigned advertisements; // Subscription advertisements sent
+    unsigned packetsReceived;
+    unsigned eventsReceived;
+};
+
 class MeshPublish {
 private:
     class Subscriptions {
@@ -97,12 +108,23 @@ private:
         int add(const char* name, EventHandler handler);
 
         void send(const char* event_name, const char* data);
+
+        /**
+         * Adds the prefixes of all handlers to the given filter.
+         */
+        void filter(mesh::SubscriptionFilter* filter) const;
+
+        bool empty() const;
     };
 
 
     static const uint16_t PORT = 36969;
     static constexpr const char* MULTICAST_ADDR = "ff03::1:1001";
     static const uint16_t MAX_PACKET_LEN = 1232;
+    static const system_tick_t POLL_TIMEOUT = 1000;
+    // Nodes with subscriptions advertise them with this interval. The advertisements are
+    // collected for two intervals, so that a single lost advertisement is tolerated
+    static const system_tick_t ADVERTISEMENT_INTERVAL = 60000;
 
     std::unique_ptr<UDP> udp;
     Subscriptions subscriptions;
@@ -116,10 +138,29 @@ private:
     std::unique_ptr<Thread> thread_;
     RecursiveMutex mutex_;
     std::unique_ptr<uint8_t[]> buffer_;
+    std::unique_ptr<char[]> txBuffer_;
+    std::unique_ptr<mesh::EventPacketWriter> batch_;
+    std::unique_ptr<Timer> flushTimer_;
+    mesh::SubscriptionSummary summary_;
+    system_tick_t aggregationWindow_;
+    system_tick_t lastAdvertisement_;
+    MeshPublishStats stats_;
+
+    int startThread();
+    int receive(system_tick_t timeout);
+    system_tick_t advertiseIfNeeded();
+    int advertise();
+    int sendPacket(const char* data, size_t size);
 
 public:
-
-    MeshPublish() : udp(nullptr) {
+    static const system_tick_t DEFAULT_AGGREGATION_WINDOW = 100;
+
+    MeshPublish() :
+            udp(nullptr),
+            summary_(ADVERTISEMENT_INTERVAL * 2),
+            aggregationWindow_(0),
+            lastAdvertisement_(0),
+            stats_() {
         // System thread gets blocked while connecting to cloud, while it's connecting to it
         // RX packet buffer pool may easily get exhausted, because nobody is reading the data
         // out of the socket. Create a separate thread here with a higher priority than application
@@ -130,6 +171,22 @@ public:
 
     int subscribe(const char* prefix, EventHandler handler);
 
+    /**
+     * Enables aggregated publishing. Events published within the specified window are packed
+     * into a single datagram, and events that no node on the network has advertised a matching
+     * subscription for are not sent at all. All nodes on the network should run a firmware
+     * version that supports aggregated packets.
+     */
+    int enableAggregation(system_tick_t window = DEFAULT_AGGREGATION_WINDOW);
+    void disableAggregation();
+
+    /**
+     * Sends the aggregated events immediately.
+     */
+    int flush();
+
+    MeshPublishStats publishStats();
+
     /**
      * Pull data from the socket and handle as required.
      */
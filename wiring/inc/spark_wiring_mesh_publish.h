@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_tick_hal.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace spark {
+
+namespace mesh {
+
+/**
+ * Type of a Mesh.publish() datagram. Stored in the first byte of the datagram.
+ */
+enum PublishPacketType {
+    // Single event: event name and optional data, each terminated by '\0'. This is the only
+    // packet type supported by older firmware versions
+    PUBLISH_PACKET_EVENT = 0,
+    // Multiple events: a sequence of event name and data pairs, each terminated by '\0'
+    PUBLISH_PACKET_EVENTS = 1,
+    // Summary of the subscriptions of the sending node (see SubscriptionFilter)
+    PUBLISH_PACKET_SUBSCRIPTIONS = 2
+};
+
+/**
+ * Bloom filter of the event name prefixes a node is subscribed to.
+ *
+ * An event may have subscribers if any of its prefixes, including the empty one, is found in
+ * the filter. False positives are possible, false negatives are not.
+ */
+class SubscriptionFilter {
+public:
+    static const size_t SIZE = 32; // Size of the filter in bytes
+
+    SubscriptionFilter();
+
+    void add(const char* prefix);
+    void merge(const SubscriptionFilter& filter);
+    void clear();
+
+    // Returns false if none of the prefixes in the filter matches the event name
+    bool mayMatch(const char* name) const;
+    bool isEmpty() const;
+
+    const uint8_t* data() const;
+    uint8_t* data();
+
+private:
+    uint8_t bits_[SIZE];
+
+    void set(uint32_t hash);
+    bool test(uint32_t hash) const;
+};
+
+/**
+ * Serializes events into a `PUBLISH_PACKET_EVENTS` datagram.
+ */
+class EventPacketWriter {
+public:
+    EventPacketWriter(char* buf, size_t size);
+
+    // Returns SYSTEM_ERROR_TOO_LARGE if the event doesn't fit into the packet
+    int add(const char* name, const char* data);
+    void reset();
+
+    const char* data() const;
+    size_t size() const;
+    unsigned count() const;
+
+    // Returns the size of a packet containing a single event
+    static size_t packetSize(const char* name, const char* data);
+
+private:
+    char* buf_;
+    size_t bufSize_;
+    size_t size_;
+    unsigned count_;
+};
+
+typedef void(*PublishEventCallback)(const char* name, const char* data, void* ctx);
+
+/**
+ * Parses a `PUBLISH_PACKET_EVENT` or `PUBLISH_PACKET_EVENTS` datagram. The callback is invoked
+ * for each event once the entire packet has been validated.
+ *
+ * Returns the number of events or SYSTEM_ERROR_BAD_DATA.
+ */
+int parseEventPacket(const char* data, size_t size, PublishEventCallback callback, void* ctx);
+
+/**
+ * Parses a `PUBLISH_PACKET_SUBSCRIPTIONS` datagram.
+ */
+int parseSubscriptionPacket(const char* data, size_t size, SubscriptionFilter* filter);
+
+/**
+ * Subscriptions advertised by other nodes.
+ *
+ * Nodes with subscriptions advertise them periodically. The advertisements received within the
+ * last one to two generations are taken into account, so that a subscriber is not forgotten
+ * when a single advertisement is lost. Until the summary has been collected for at least one
+ * full generation, every event is assumed to have subscribers.
+ */
+class SubscriptionSummary {
+public:
+    explicit SubscriptionSummary(system_tick_t generation);
+
+    // Starts collecting the advertisements
+    void reset(system_tick_t now);
+    void update(const SubscriptionFilter& filter, system_tick_t now);
+
+    bool mayHaveSubscribers(const char* name, system_tick_t now);
+
+private:
+    SubscriptionFilter cur_;
+    SubscriptionFilter prev_;
+    system_tick_t generation_;
+    system_tick_t genStart_;
+    bool complete_;
+
+    void rotate(system_tick_t now);
+};
+
+inline const uint8_t* SubscriptionFilter::data() const {
+    return bits_;
+}
+
+inline uint8_t* SubscriptionFilter::data() {
+    return bits_;
+}
+
+inline const char* EventPacketWriter::data() const {
+    return buf_;
+}
+
+inline size_t EventPacketWriter::size() const {
+    return size_;
+}
+
+inline unsigned EventPacketWriter::count() const {
+    return count_;
+}
+
+} // namespace mesh
+
+} // namespace spark
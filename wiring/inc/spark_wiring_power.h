@@ -59,6 +59,7 @@ public:
     byte getVersion();
     byte getSystemStatus();
     byte getFault();
+    bool getStatusRegisters(byte& misc, byte& status, byte& fault);
 
     // Input source control register
     byte readInputSourceRegister(void);
@@ -145,6 +146,7 @@ public:
 private:
 
     byte readRegister(byte startAddress);
+    bool readRegisters(byte startAddress, byte* data, size_t size);
     void writeRegister(byte address, byte DATA);
 
     bool lock_;
@@ -30,6 +30,7 @@
 #include <stddef.h>
 #include <string.h>
 #include <stdint.h> // for uint8_t
+#include <stdarg.h>
 #include "system_tick_hal.h"
 
 #include "spark_wiring_string.h"
@@ -90,6 +91,9 @@ class Print
     size_t println(void);
     size_t println(const __FlashStringHelper*);
 
+    // Formats directly into this stream, without an intermediate buffer for the whole output
+    size_t vprintf(bool newline, const char* format, va_list args);
+
     template <typename... Args>
     inline size_t printf(const char* format, Args... args)
     {
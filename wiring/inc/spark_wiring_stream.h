@@ -49,6 +49,8 @@ class Stream : public Print
     int timedRead();    // private method to read stream with timeout
     int timedPeek();    // private method to peek stream with timeout
     int peekNextDigit(); // returns the next numeric digit in the stream or -1 if timeout
+    size_t readBytesImpl(char *buffer, size_t length, int terminator, bool *found); // reads a block of characters, see readBytesUntil()
+    String readStringImpl(int terminator); // reads a string, see readStringUntil()
 
   public:
     virtual int available() = 0;
@@ -56,6 +58,13 @@ class Stream : public Print
     virtual int peek() = 0;
     virtual void flush() = 0;
 
+    // Zero-copy reading, see particle::InputStream. acquireRead() returns a pointer to a contiguous
+    // block of buffered data and the size of the block, 0 if no data is available, or
+    // SYSTEM_ERROR_NOT_SUPPORTED, in which case the data is read one character at a time. The data
+    // is then consumed with commitRead()
+    virtual int acquireRead(const char** data);
+    virtual int commitRead(size_t size);
+
     Stream() {_timeout=1000;}
 
 // parsing methods
@@ -79,11 +88,11 @@ class Stream : public Print
 
   float parseFloat();               // float version of parseInt
 
-  size_t readBytes( char *buffer, size_t length); // read chars from stream into buffer
+  virtual size_t readBytes( char *buffer, size_t length); // read chars from stream into buffer
   // terminates if length characters have been read or timeout (see setTimeout)
   // returns the number of characters placed in the buffer (0 means no valid data found)
 
-  size_t readBytesUntil( char terminator, char *buffer, size_t length); // as readBytes with terminator character
+  virtual size_t readBytesUntil( char terminator, char *buffer, size_t length); // as readBytes with terminator character
   // terminates if length characters have been read, timeout, or if the terminator character  detected
   // returns the number of characters placed in the buffer (0 means no valid data found)
 
@@ -200,15 +200,24 @@ public:
         static String format(const char* format, ...);
 
 protected:
+	// strings of up to this length are stored in the String object itself, without allocating
+	// memory on the heap
+	enum { INLINE_CAPACITY = 15 };
+
 	char *buffer;	        // the actual char array
 	unsigned int capacity;  // the array length minus one (for the '\0')
 	unsigned int len;       // the String length (not counting the '\0')
 	unsigned char flags;    // unused, for future features
+	// inline storage for short strings. Note that it makes String larger than it used to be, so
+	// String must not be passed by value across the dynalib boundary (see spark_deviceID_legacy())
+	char sso[INLINE_CAPACITY + 1];
 protected:
 	void init(void);
 	void invalidate(void);
 	unsigned char changeBuffer(unsigned int maxStrLen);
+	unsigned char grow(unsigned int size);
 	unsigned char concat(const char *cstr, unsigned int length);
+	bool isInline() const { return buffer == sso; }
 
 	// copy and move
 	String & copy(const char *cstr, unsigned int length);
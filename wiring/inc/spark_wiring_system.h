@@ -217,6 +217,13 @@ public:
         return !system_subscribe_event(events, reinterpret_cast<system_event_handler_t*>(handler), nullptr);
     }
 
+    static bool on(system_event_t events, void(*handler)(system_event_t, int,void*), system_event_delivery_mode mode) {
+        system_event_subscribe_options opts = {};
+        opts.size = sizeof(opts);
+        opts.delivery_mode = mode;
+        return !system_subscribe_event(events, reinterpret_cast<system_event_handler_t*>(handler), &opts);
+    }
+
     static bool on(system_event_t events, void(*handler)(system_event_t, int)) {
         return system_subscribe_event(events, reinterpret_cast<system_event_handler_t*>(handler), NULL);
     }
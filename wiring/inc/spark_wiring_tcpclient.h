@@ -34,7 +34,9 @@
 
 #include <memory>
 
+#ifndef TCPCLIENT_BUF_MAX_SIZE
 #define TCPCLIENT_BUF_MAX_SIZE  128
+#endif
 /* 30 seconds */
 #define SPARK_WIRING_TCPCLIENT_DEFAULT_SEND_TIMEOUT (30000)
 
@@ -43,6 +45,7 @@ class TCPClient : public Client {
 public:
     TCPClient();
     TCPClient(sock_handle_t sock);
+    TCPClient(sock_handle_t sock, size_t bufferSize);
     virtual ~TCPClient() {};
 
     uint8_t status();
@@ -64,6 +67,31 @@ public:
 
     virtual IPAddress remoteIP();
 
+    /**
+     * Sets the size of the receive buffer.
+     *
+     * Buffers up to `TCPCLIENT_BUF_MAX_SIZE` bytes are stored inline, larger buffers are allocated
+     * on the heap. Data that is already buffered is preserved.
+     *
+     * @return `true` on success, or `false` if the buffer cannot be allocated or is too small to
+     *         hold the data that is currently buffered.
+     */
+    bool setBufferSize(size_t size);
+    size_t bufferSize() const;
+
+    /**
+     * Reads up to `length` bytes, or until the timeout expires (see `setTimeout()`).
+     *
+     * Reads that are at least as large as the receive buffer bypass it and receive directly into
+     * `buffer`.
+     */
+    virtual size_t readBytes(char* buffer, size_t length) override;
+    /**
+     * Same as `readBytes()` but also stops at the `terminator` character, which is consumed but
+     * not stored. The receive buffer is scanned in bulk rather than one character at a time.
+     */
+    virtual size_t readBytesUntil(char terminator, char* buffer, size_t length) override;
+
     friend class TCPServer;
 
     using Print::write;
@@ -74,18 +102,25 @@ protected:
 private:
     struct Data {
         sock_handle_t sock;
-        uint8_t buffer[TCPCLIENT_BUF_MAX_SIZE];
-        uint16_t offset;
-        uint16_t total;
+        uint8_t* buffer;
+        size_t size;
+        size_t offset;
+        size_t total;
         IPAddress remoteIP;
+        uint8_t defaultBuffer[TCPCLIENT_BUF_MAX_SIZE];
 
         explicit Data(sock_handle_t sock);
         ~Data();
+
+        bool resize(size_t size);
     };
 
     std::shared_ptr<Data> d_;
 
     inline int bufferCount();
+    size_t readBuffered(uint8_t* buffer, size_t size);
+    // Receives from the socket without blocking, returns the number of bytes received
+    int receive(uint8_t* buffer, size_t size);
 };
 
 #endif
@@ -32,6 +32,23 @@
 #include "spark_wiring_stream.h"
 #include "socket_hal.h"
 
+/**
+ * A datagram stored in the receive queue (see `UDP::setPacketQueue()`), or one of the datagrams
+ * passed to `UDP::sendPackets()`.
+ */
+struct UDPPacket {
+    const uint8_t* data;
+    size_t size;
+    IPAddress remoteIP;
+    uint16_t remotePort;
+    /**
+     * The value of `millis()` when the datagram was received. Not used when sending.
+     */
+    system_tick_t timestamp;
+};
+
+class UDPPacketQueue;
+
 class UDP : public Stream, public Printable {
 private:
     /**
@@ -88,11 +105,35 @@ private:
      */
     uint8_t _buffer_allocated;
 
+    /**
+     * The receive queue, or NULL if the queue is not enabled.
+     */
+    UDPPacketQueue* _queue;
+
+    /**
+     * The time when the received packet arrived. Available after parsePacket().
+     */
+    system_tick_t _timestamp;
+
+    /**
+     * Reads a datagram from the socket without modifying the state of the current packet.
+     */
+    int receiveFrom(uint8_t* buffer, size_t size, system_tick_t timeout, IPAddress* remoteIP, uint16_t* remotePort);
 
+    /**
+     * Reads a datagram from the socket without blocking. Unlike receiveFrom(), distinguishes an
+     * empty datagram (0) from an empty socket (SYSTEM_ERROR_WOULD_BLOCK).
+     */
+    int receiveNext(uint8_t* buffer, size_t size, IPAddress* remoteIP, uint16_t* remotePort);
+
+    /**
+     * Takes the oldest datagram from the receive queue.
+     */
+    int receiveQueued(uint8_t* buffer, size_t size);
 
 public:
     UDP();
-    virtual ~UDP() { stop(); releaseBuffer(); }
+    virtual ~UDP() { stop(); releaseBuffer(); releasePacketQueue(); }
     /**
      * @param buffer_size The size of the read/write buffer. Can be 0 if
      * only `readPacket()` and `sendPacket()` are used, as these methods
@@ -153,6 +194,56 @@ public:
         return receivePacket((uint8_t*)buffer, buf_size, timeout);
     }
 
+    /**
+     * Sends a batch of packets. Sending stops at the first packet that cannot be sent.
+     *
+     * @param packets   The packets to send. The `timestamp` field is ignored.
+     * @param count     The number of packets.
+     * @return The number of packets sent, or a negative value if the first packet could not be sent.
+     */
+    int sendPackets(const UDPPacket* packets, size_t count);
+
+    /**
+     * Enables the receive queue. Datagrams are received in batches into a ring of preallocated
+     * slots, so bursts that arrive between calls to `parsePacket()` are not left waiting in the
+     * socket or dropped by the network stack. While the queue is enabled, `parsePacket()` and
+     * `receivePacket()` only return the queued datagrams, in the order they were received. The
+     * queue is filled by `receivePackets()`, which the application calls either before
+     * `parsePacket()` or from a separate thread.
+     *
+     * @param slots     The number of slots in the queue.
+     * @param slot_size The maximum size of a queued datagram. Larger datagrams are truncated.
+     * @return `true` on success.
+     */
+    bool setPacketQueue(size_t slots, size_t slot_size);
+
+    /**
+     * Disables the receive queue, discarding any queued datagrams.
+     */
+    void releasePacketQueue();
+
+    /**
+     * Drains the socket into the free slots of the receive queue.
+     *
+     * The queue has a single producer and a single consumer: this method is the only producer, which
+     * allows it to be called from a thread other than the one calling `parsePacket()`, so long as
+     * only one thread calls it at a time.
+     *
+     * @return The number of datagrams queued, or a negative value on error.
+     */
+    int receivePackets();
+
+    /**
+     * Retrieves the number of datagrams in the receive queue.
+     */
+    int packetsQueued() const;
+
+    /**
+     * Retrieves the number of times `receivePackets()` found the receive queue full. A non-zero
+     * value means the queue is drained slower than datagrams arrive.
+     */
+    unsigned packetQueueOverflows() const;
+
     /**
      * Begin writing a packet to the given destination.
      * @param ip        The IP address of the destination peer.
@@ -216,6 +307,10 @@ public:
 
     virtual IPAddress remoteIP() { return _remoteIP; };
     virtual uint16_t remotePort() { return _remotePort; };
+    /**
+     * The value of `millis()` when the received packet arrived. Available after parsePacket().
+     */
+    system_tick_t packetTimestamp() const { return _timestamp; };
 
     /**
      * Prints the current read parsed packet to the given output.
@@ -56,6 +56,8 @@ public:
 	virtual int availableForWrite(void);
 	virtual int available();
 	virtual void flush();
+	virtual int acquireRead(const char**);
+	virtual int commitRead(size_t);
 
 	virtual void blockOnOverrun(bool);
 
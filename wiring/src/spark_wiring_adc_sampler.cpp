@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_adc_sampler.h"
+
+#include "system_error.h"
+
+#include <utility>
+
+namespace particle {
+
+ADCSampler::ADCSampler() :
+        samples_(nullptr),
+        count_(0),
+        running_(false) {
+}
+
+ADCSampler::~ADCSampler() {
+    end();
+}
+
+int ADCSampler::begin(pin_t pin, uint32_t sampleRate, uint16_t* buffer, size_t size, Callback callback) {
+    end();
+    callback_ = std::move(callback);
+    samples_ = nullptr;
+    count_ = 0;
+    HAL_ADC_Sampler_Config conf = {};
+    conf.size = sizeof(conf);
+    conf.pin = pin;
+    conf.sample_rate = sampleRate;
+    conf.buffer = buffer;
+    conf.buffer_size = size;
+    conf.callback = halCallback;
+    conf.context = this;
+    const int ret = HAL_ADC_Sampler_Start(&conf, nullptr);
+    if (ret < 0) {
+        return ret;
+    }
+    running_ = true;
+    return 0;
+}
+
+void ADCSampler::end() {
+    if (running_) {
+        HAL_ADC_Sampler_Stop(nullptr);
+        running_ = false;
+        samples_ = nullptr;
+    }
+}
+
+const uint16_t* ADCSampler::read(size_t* count) const {
+    const uint16_t* const samples = samples_;
+    if (samples && count) {
+        *count = count_;
+    }
+    return samples;
+}
+
+int ADCSampler::release() {
+    const uint16_t* const samples = samples_;
+    if (!samples) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    samples_ = nullptr;
+    return HAL_ADC_Sampler_Release(samples, nullptr);
+}
+
+bool ADCSampler::available() const {
+    return samples_;
+}
+
+uint32_t ADCSampler::sampleRate() const {
+    return stats().sample_rate;
+}
+
+uint32_t ADCSampler::buffers() const {
+    return stats().buffers;
+}
+
+uint32_t ADCSampler::overruns() const {
+    return stats().overruns;
+}
+
+HAL_ADC_Sampler_Stats ADCSampler::stats() const {
+    HAL_ADC_Sampler_Stats s = {};
+    s.size = sizeof(s);
+    HAL_ADC_Sampler_Get_Stats(&s, nullptr);
+    return s;
+}
+
+void ADCSampler::halCallback(const uint16_t* samples, size_t count, void* context) {
+    const auto self = static_cast<ADCSampler*>(context);
+    if (self->callback_) {
+        self->callback_(samples, count);
+        HAL_ADC_Sampler_Release(samples, nullptr);
+    } else {
+        // The half is held by the application until it's released
+        self->count_ = count;
+        self->samples_ = samples;
+    }
+}
+
+} // namespace particle
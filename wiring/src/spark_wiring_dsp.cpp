@@ -0,0 +1,605 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_dsp.h"
+
+#include <algorithm>
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#define DSP_SIMD 1
+#else
+#define DSP_SIMD 0
+#endif
+
+namespace {
+
+using namespace particle::dsp;
+
+const size_t QUARTER_WAVE_SIZE = MAX_FFT_SIZE / 4;
+
+// sin(2 * pi * i / MAX_FFT_SIZE) for i in [0, MAX_FFT_SIZE / 4]
+const q15_t SIN_Q15[QUARTER_WAVE_SIZE + 1] = {
+    0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809, 2009, 2210,
+    2411, 2611, 2811, 3012, 3212, 3412, 3612, 3812, 4011, 4211, 4410, 4609,
+    4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195, 6393, 6590, 6787, 6983,
+    7180, 7376, 7571, 7767, 7962, 8157, 8351, 8546, 8740, 8933, 9127, 9319,
+    9512, 9704, 9896, 10088, 10279, 10469, 10660, 10850, 11039, 11228, 11417, 11605,
+    11793, 11980, 12167, 12354, 12540, 12725, 12910, 13095, 13279, 13463, 13646, 13828,
+    14010, 14192, 14373, 14553, 14733, 14912, 15091, 15269, 15447, 15624, 15800, 15976,
+    16151, 16326, 16500, 16673, 16846, 17018, 17190, 17361, 17531, 17700, 17869, 18037,
+    18205, 18372, 18538, 18703, 18868, 19032, 19195, 19358, 19520, 19681, 19841, 20001,
+    20160, 20318, 20475, 20632, 20788, 20943, 21097, 21251, 21403, 21555, 21706, 21856,
+    22006, 22154, 22302, 22449, 22595, 22740, 22884, 23028, 23170, 23312, 23453, 23593,
+    23732, 23870, 24008, 24144, 24279, 24414, 24548, 24680, 24812, 24943, 25073, 25202,
+    25330, 25457, 25583, 25708, 25833, 25956, 26078, 26199, 26320, 26439, 26557, 26674,
+    26791, 26906, 27020, 27133, 27246, 27357, 27467, 27576, 27684, 27791, 27897, 28002,
+    28106, 28209, 28311, 28411, 28511, 28610, 28707, 28803, 28899, 28993, 29086, 29178,
+    29269, 29359, 29448, 29535, 29622, 29707, 29792, 29875, 29957, 30038, 30118, 30196,
+    30274, 30350, 30425, 30499, 30572, 30644, 30715, 30784, 30853, 30920, 30986, 31050,
+    31114, 31177, 31238, 31298, 31357, 31415, 31471, 31527, 31581, 31634, 31686, 31737,
+    31786, 31834, 31881, 31927, 31972, 32015, 32058, 32099, 32138, 32177, 32214, 32251,
+    32286, 32319, 32352, 32383, 32413, 32442, 32470, 32496, 32522, 32546, 32568, 32590,
+    32610, 32629, 32647, 32664, 32679, 32693, 32706, 32718, 32729, 32738, 32746, 32753,
+    32758, 32762, 32766, 32767, 32767
+};
+
+const q31_t SIN_Q31[QUARTER_WAVE_SIZE + 1] = {
+    0, 13176712, 26352928, 39528151, 52701887, 65873638,
+    79042909, 92209205, 105372028, 118530885, 131685278, 144834714,
+    157978697, 171116733, 184248325, 197372981, 210490206, 223599506,
+    236700388, 249792358, 262874923, 275947592, 289009871, 302061269,
+    315101295, 328129457, 341145265, 354148230, 367137861, 380113669,
+    393075166, 406021865, 418953276, 431868915, 444768294, 457650927,
+    470516330, 483364019, 496193509, 509004318, 521795963, 534567963,
+    547319836, 560051104, 572761285, 585449903, 598116479, 610760536,
+    623381598, 635979190, 648552838, 661102068, 673626408, 686125387,
+    698598533, 711045377, 723465451, 735858287, 748223418, 760560380,
+    772868706, 785147934, 797397602, 809617249, 821806413, 833964638,
+    846091463, 858186435, 870249095, 882278992, 894275671, 906238681,
+    918167572, 930061894, 941921200, 953745043, 965532978, 977284562,
+    988999351, 1000676905, 1012316784, 1023918550, 1035481766, 1047005996,
+    1058490808, 1069935768, 1081340445, 1092704411, 1104027237, 1115308496,
+    1126547765, 1137744621, 1148898640, 1160009405, 1171076495, 1182099496,
+    1193077991, 1204011567, 1214899813, 1225742318, 1236538675, 1247288478,
+    1257991320, 1268646800, 1279254516, 1289814068, 1300325060, 1310787095,
+    1321199781, 1331562723, 1341875533, 1352137822, 1362349204, 1372509294,
+    1382617710, 1392674072, 1402678000, 1412629117, 1422527051, 1432371426,
+    1442161874, 1451898025, 1461579514, 1471205974, 1480777044, 1490292364,
+    1499751576, 1509154322, 1518500250, 1527789007, 1537020244, 1546193612,
+    1555308768, 1564365367, 1573363068, 1582301533, 1591180426, 1599999411,
+    1608758157, 1617456335, 1626093616, 1634669676, 1643184191, 1651636841,
+    1660027308, 1668355276, 1676620432, 1684822463, 1692961062, 1701035922,
+    1709046739, 1716993211, 1724875040, 1732691928, 1740443581, 1748129707,
+    1755750017, 1763304224, 1770792044, 1778213194, 1785567396, 1792854372,
+    1800073849, 1807225553, 1814309216, 1821324572, 1828271356, 1835149306,
+    1841958164, 1848697674, 1855367581, 1861967634, 1868497586, 1874957189,
+    1881346202, 1887664383, 1893911494, 1900087301, 1906191570, 1912224073,
+    1918184581, 1924072871, 1929888720, 1935631910, 1941302225, 1946899451,
+    1952423377, 1957873796, 1963250501, 1968553292, 1973781967, 1978936331,
+    1984016189, 1989021350, 1993951625, 1998806829, 2003586779, 2008291295,
+    2012920201, 2017473321, 2021950484, 2026351522, 2030676269, 2034924562,
+    2039096241, 2043191150, 2047209133, 2051150040, 2055013723, 2058800036,
+    2062508835, 2066139983, 2069693342, 2073168777, 2076566160, 2079885360,
+    2083126254, 2086288720, 2089372638, 2092377892, 2095304370, 2098151960,
+    2100920556, 2103610054, 2106220352, 2108751352, 2111202959, 2113575080,
+    2115867626, 2118080511, 2120213651, 2122266967, 2124240380, 2126133817,
+    2127947206, 2129680480, 2131333572, 2132906420, 2134398966, 2135811153,
+    2137142927, 2138394240, 2139565043, 2140655293, 2141664948, 2142593971,
+    2143442326, 2144209982, 2144896910, 2145503083, 2146028480, 2146473080,
+    2146836866, 2147119825, 2147321946, 2147443222, 2147483647
+};
+
+template<typename T>
+struct SampleTraits;
+
+template<>
+struct SampleTraits<q15_t> {
+    typedef int32_t Acc; // Holds sums of a few products of samples
+    static const unsigned FRAC_BITS = 15;
+
+    static const q15_t* sinTable() {
+        return SIN_Q15;
+    }
+
+    static q15_t saturate(int64_t v) {
+        return saturateQ15((v > INT32_MAX) ? INT32_MAX : (v < INT32_MIN) ? INT32_MIN : (int32_t)v);
+    }
+};
+
+template<>
+struct SampleTraits<q31_t> {
+    typedef int64_t Acc;
+    static const unsigned FRAC_BITS = 31;
+
+    static const q31_t* sinTable() {
+        return SIN_Q31;
+    }
+
+    static q31_t saturate(int64_t v) {
+        return saturateQ31(v);
+    }
+};
+
+#if DSP_SIMD
+
+// Wrappers for the DSP extension instructions. Pairs of Q15 samples are packed into a word with
+// the first sample in the lower halfword
+inline uint32_t load32(const q15_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v)); // Unaligned word access is supported by LDR
+    return v;
+}
+
+inline void store32(q15_t* p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+inline uint32_t pack16(int32_t lo, int32_t hi) {
+    return (uint16_t)lo | ((uint32_t)hi << 16);
+}
+
+inline int32_t ssat16(int32_t v) {
+    int32_t r;
+    asm ("ssat %0, #16, %1" : "=r" (r) : "r" (v));
+    return r;
+}
+
+// (a.lo + b.lo) / 2, (a.hi + b.hi) / 2
+inline uint32_t shadd16(uint32_t a, uint32_t b) {
+    uint32_t r;
+    asm ("shadd16 %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+    return r;
+}
+
+// (a.lo - b.lo) / 2, (a.hi - b.hi) / 2
+inline uint32_t shsub16(uint32_t a, uint32_t b) {
+    uint32_t r;
+    asm ("shsub16 %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+    return r;
+}
+
+// (a.lo - b.hi) / 2, (a.hi + b.lo) / 2
+inline uint32_t shasx(uint32_t a, uint32_t b) {
+    uint32_t r;
+    asm ("shasx %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+    return r;
+}
+
+// (a.lo + b.hi) / 2, (a.hi - b.lo) / 2
+inline uint32_t shsax(uint32_t a, uint32_t b) {
+    uint32_t r;
+    asm ("shsax %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+    return r;
+}
+
+// a.lo * b.lo - a.hi * b.hi
+inline int32_t smusd(uint32_t a, uint32_t b) {
+    int32_t r;
+    asm ("smusd %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+    return r;
+}
+
+// a.lo * b.hi + a.hi * b.lo
+inline int32_t smuadx(uint32_t a, uint32_t b) {
+    int32_t r;
+    asm ("smuadx %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+    return r;
+}
+
+// acc + a.lo * b.lo + a.hi * b.hi
+inline int64_t smlald(uint32_t a, uint32_t b, int64_t acc) {
+    uint32_t lo = (uint32_t)acc;
+    uint32_t hi = (uint32_t)((uint64_t)acc >> 32);
+    asm ("smlald %0, %1, %2, %3" : "+r" (lo), "+r" (hi) : "r" (a), "r" (b));
+    return (int64_t)(((uint64_t)hi << 32) | lo);
+}
+
+// acc + a.lo * b.hi + a.hi * b.lo
+inline int64_t smlaldx(uint32_t a, uint32_t b, int64_t acc) {
+    uint32_t lo = (uint32_t)acc;
+    uint32_t hi = (uint32_t)((uint64_t)acc >> 32);
+    asm ("smlaldx %0, %1, %2, %3" : "+r" (lo), "+r" (hi) : "r" (a), "r" (b));
+    return (int64_t)(((uint64_t)hi << 32) | lo);
+}
+
+// Complex multiplication of packed Q15 samples
+inline uint32_t cmul16(uint32_t x, uint32_t w) {
+    return pack16(ssat16(smusd(x, w) >> 15), ssat16(smuadx(x, w) >> 15));
+}
+
+#endif // DSP_SIMD
+
+// Twiddle factor exp(-2 * pi * i * k / MAX_FFT_SIZE), k < 3 * MAX_FFT_SIZE / 4
+template<typename T>
+inline void twiddle(size_t k, T* re, T* im) {
+    const T* const s = SampleTraits<T>::sinTable();
+    const size_t q = k / QUARTER_WAVE_SIZE;
+    const size_t r = k % QUARTER_WAVE_SIZE;
+    if (q == 0) {
+        *re = s[QUARTER_WAVE_SIZE - r];
+        *im = -s[r];
+    } else if (q == 1) {
+        *re = -s[r];
+        *im = -s[QUARTER_WAVE_SIZE - r];
+    } else {
+        *re = -s[QUARTER_WAVE_SIZE - r];
+        *im = s[r];
+    }
+}
+
+template<typename T>
+inline void cmul(typename SampleTraits<T>::Acc xr, typename SampleTraits<T>::Acc xi, T wr, T wi,
+        typename SampleTraits<T>::Acc* re, typename SampleTraits<T>::Acc* im) {
+    typedef typename SampleTraits<T>::Acc Acc;
+    const unsigned shift = SampleTraits<T>::FRAC_BITS;
+    *re = (Acc)(((int64_t)xr * wr - (int64_t)xi * wi) >> shift);
+    *im = (Acc)(((int64_t)xr * wi + (int64_t)xi * wr) >> shift);
+}
+
+template<typename T>
+void conjugate(T* x, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        x[2 * i + 1] = SampleTraits<T>::saturate(-(int64_t)x[2 * i + 1]);
+    }
+}
+
+template<typename T>
+void bitReverse(T* x, size_t n) {
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(x[2 * i], x[2 * j]);
+            std::swap(x[2 * i + 1], x[2 * j + 1]);
+        }
+    }
+}
+
+// Radix-2 butterflies with the span of 1 sample. The output is scaled down by 2
+template<typename T>
+void radix2Stage(T* x, size_t n) {
+    typedef typename SampleTraits<T>::Acc Acc;
+    for (size_t k = 0; k < n; k += 2) {
+        T* const p = x + 2 * k;
+        const Acc ar = p[0], ai = p[1], br = p[2], bi = p[3];
+        p[0] = (ar + br) >> 1;
+        p[1] = (ai + bi) >> 1;
+        p[2] = (ar - br) >> 1;
+        p[3] = (ai - bi) >> 1;
+    }
+}
+
+// Radix-4 butterflies combining two radix-2 stages with the spans of `m` and `2 * m` samples.
+// The output is scaled down by 4
+template<typename T>
+void radix4Stage(T* x, size_t n, size_t m) {
+    typedef typename SampleTraits<T>::Acc Acc;
+    const size_t step = MAX_FFT_SIZE / (4 * m);
+    for (size_t j = 0; j < m; ++j) {
+        T w1r, w1i, w2r, w2i, w3r, w3i;
+        twiddle(j * step, &w1r, &w1i);
+        twiddle(2 * j * step, &w2r, &w2i);
+        twiddle(3 * j * step, &w3r, &w3i);
+        for (size_t k = j; k < n; k += 4 * m) {
+            T* const p0 = x + 2 * k;
+            T* const p1 = p0 + 2 * m;
+            T* const p2 = p1 + 2 * m;
+            T* const p3 = p2 + 2 * m;
+            Acc t1r, t1i, t2r, t2i, t3r, t3i;
+            cmul(p1[0], p1[1], w2r, w2i, &t1r, &t1i);
+            cmul(p2[0], p2[1], w1r, w1i, &t2r, &t2i);
+            cmul(p3[0], p3[1], w3r, w3i, &t3r, &t3i);
+            const Acc ar = p0[0] + t1r, ai = p0[1] + t1i;
+            const Acc br = p0[0] - t1r, bi = p0[1] - t1i;
+            const Acc cr = t2r + t3r, ci = t2i + t3i;
+            const Acc dr = t2r - t3r, di = t2i - t3i;
+            p0[0] = SampleTraits<T>::saturate((ar + cr) >> 2);
+            p0[1] = SampleTraits<T>::saturate((ai + ci) >> 2);
+            p1[0] = SampleTraits<T>::saturate((br + di) >> 2);
+            p1[1] = SampleTraits<T>::saturate((bi - dr) >> 2);
+            p2[0] = SampleTraits<T>::saturate((ar - cr) >> 2);
+            p2[1] = SampleTraits<T>::saturate((ai - ci) >> 2);
+            p3[0] = SampleTraits<T>::saturate((br - di) >> 2);
+            p3[1] = SampleTraits<T>::saturate((bi + dr) >> 2);
+        }
+    }
+}
+
+#if DSP_SIMD
+
+template<>
+void radix2Stage<q15_t>(q15_t* x, size_t n) {
+    for (size_t k = 0; k < n; k += 2) {
+        q15_t* const p = x + 2 * k;
+        const uint32_t a = load32(p);
+        const uint32_t b = load32(p + 2);
+        store32(p, shadd16(a, b));
+        store32(p + 2, shsub16(a, b));
+    }
+}
+
+template<>
+void radix4Stage<q15_t>(q15_t* x, size_t n, size_t m) {
+    const size_t step = MAX_FFT_SIZE / (4 * m);
+    for (size_t j = 0; j < m; ++j) {
+        q15_t wr, wi;
+        twiddle(j * step, &wr, &wi);
+        const uint32_t w1 = pack16(wr, wi);
+        twiddle(2 * j * step, &wr, &wi);
+        const uint32_t w2 = pack16(wr, wi);
+        twiddle(3 * j * step, &wr, &wi);
+        const uint32_t w3 = pack16(wr, wi);
+        for (size_t k = j; k < n; k += 4 * m) {
+            q15_t* const p0 = x + 2 * k;
+            q15_t* const p1 = p0 + 2 * m;
+            q15_t* const p2 = p1 + 2 * m;
+            q15_t* const p3 = p2 + 2 * m;
+            const uint32_t x0 = load32(p0);
+            const uint32_t t1 = cmul16(load32(p1), w2);
+            const uint32_t t2 = cmul16(load32(p2), w1);
+            const uint32_t t3 = cmul16(load32(p3), w3);
+            const uint32_t a = shadd16(x0, t1);
+            const uint32_t b = shsub16(x0, t1);
+            const uint32_t c = shadd16(t2, t3);
+            const uint32_t d = shsub16(t2, t3);
+            store32(p0, shadd16(a, c));
+            store32(p1, shsax(b, d)); // b - i * d
+            store32(p2, shsub16(a, c));
+            store32(p3, shasx(b, d)); // b + i * d
+        }
+    }
+}
+
+#endif // DSP_SIMD
+
+template<typename T>
+bool transform(T* x, size_t n, bool inverse) {
+    if (n < 2 || n > MAX_FFT_SIZE || (n & (n - 1))) {
+        return false;
+    }
+    if (inverse) {
+        // ifft(x) = conj(fft(conj(x)))
+        conjugate(x, n);
+    }
+    bitReverse(x, n);
+    size_t m = 1;
+    unsigned log2n = 0;
+    while ((1u << log2n) < n) {
+        ++log2n;
+    }
+    if (log2n & 1) {
+        radix2Stage(x, n);
+        m = 2;
+    }
+    for (; m < n; m *= 4) {
+        radix4Stage(x, n, m);
+    }
+    if (inverse) {
+        conjugate(x, n);
+    }
+    return true;
+}
+
+template<typename T>
+void firBlockImpl(const T* x, const T* h, size_t taps, T* out, size_t n, size_t step) {
+    for (size_t i = 0; i < n; ++i, x += step) {
+        const T* const w = x + taps - 1; // Newest sample
+        int64_t acc = 0;
+        for (size_t k = 0; k < taps; ++k) {
+            acc += (int64_t)h[k] * *(w - k);
+        }
+        out[i] = SampleTraits<T>::saturate(acc >> SampleTraits<T>::FRAC_BITS);
+    }
+}
+
+template<typename T>
+void biquadBlockImpl(const T* coeffs, T* state, unsigned postShift, const T* in, T* out, size_t n) {
+    const int64_t b0 = coeffs[0], b1 = coeffs[1], b2 = coeffs[2], a1 = coeffs[3], a2 = coeffs[4];
+    T x1 = state[0], x2 = state[1], y1 = state[2], y2 = state[3];
+    const unsigned shift = SampleTraits<T>::FRAC_BITS - postShift;
+    for (size_t i = 0; i < n; ++i) {
+        const T x0 = in[i];
+        const int64_t acc = b0 * x0 + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        const T y0 = SampleTraits<T>::saturate(acc >> shift);
+        x2 = x1;
+        x1 = x0;
+        y2 = y1;
+        y1 = y0;
+        out[i] = y0;
+    }
+    state[0] = x1;
+    state[1] = x2;
+    state[2] = y1;
+    state[3] = y2;
+}
+
+template<typename T>
+T meanImpl(const T* x, size_t n) {
+    if (!n) {
+        return 0;
+    }
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += x[i];
+    }
+    return sum / (int64_t)n;
+}
+
+} // namespace
+
+namespace particle {
+
+namespace dsp {
+
+void adcToQ15(const uint16_t* in, q15_t* out, size_t n, unsigned bits) {
+    // Scaling a reading to 16 bits and flipping the most significant bit is the same as subtracting
+    // the mid-scale value
+    const unsigned shift = 16 - bits;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = (q15_t)(uint16_t)((in[i] << shift) ^ 0x8000);
+    }
+}
+
+q15_t mean(const q15_t* x, size_t n) {
+    return meanImpl(x, n);
+}
+
+q31_t mean(const q31_t* x, size_t n) {
+    return meanImpl(x, n);
+}
+
+q15_t rms(const q15_t* x, size_t n) {
+    if (!n) {
+        return 0;
+    }
+    uint64_t sum = 0;
+    size_t i = 0;
+#if DSP_SIMD
+    for (; i + 1 < n; i += 2) {
+        const uint32_t v = load32(x + i);
+        sum = smlald(v, v, sum);
+    }
+#endif
+    for (; i < n; ++i) {
+        sum += detail::square(x[i]);
+    }
+    const uint32_t r = detail::sqrt64(sum / n);
+    return (r > (uint32_t)Q15_MAX) ? Q15_MAX : r;
+}
+
+q31_t rms(const q31_t* x, size_t n) {
+    if (!n) {
+        return 0;
+    }
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += detail::square(x[i]);
+    }
+    const uint32_t r = detail::sqrt64((sum / n) << 31);
+    return (r > (uint32_t)Q31_MAX) ? Q31_MAX : r;
+}
+
+void magnitude(const q15_t* x, q15_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t r = detail::sqrt64(detail::square(x[2 * i]) + detail::square(x[2 * i + 1]));
+        out[i] = (r > (uint32_t)Q15_MAX) ? Q15_MAX : r;
+    }
+}
+
+void magnitude(const q31_t* x, q31_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t re = (uint64_t)((int64_t)x[2 * i] * x[2 * i]);
+        const uint64_t im = (uint64_t)((int64_t)x[2 * i + 1] * x[2 * i + 1]);
+        const uint32_t r = detail::sqrt64(re + im);
+        out[i] = (r > (uint32_t)Q31_MAX) ? Q31_MAX : r;
+    }
+}
+
+bool fft(q15_t* x, size_t size) {
+    return transform(x, size, false /* inverse */);
+}
+
+bool fft(q31_t* x, size_t size) {
+    return transform(x, size, false /* inverse */);
+}
+
+bool ifft(q15_t* x, size_t size) {
+    return transform(x, size, true /* inverse */);
+}
+
+bool ifft(q31_t* x, size_t size) {
+    return transform(x, size, true /* inverse */);
+}
+
+namespace detail {
+
+void firBlock(const q15_t* x, const q15_t* h, size_t taps, q15_t* out, size_t n, size_t step) {
+#if DSP_SIMD
+    for (size_t i = 0; i < n; ++i, x += step) {
+        int64_t acc = 0;
+        size_t k = 0;
+        // Coefficients h[k], h[k + 1] are multiplied by samples x[taps - 1 - k], x[taps - 2 - k]
+        for (; k + 1 < taps; k += 2) {
+            acc = smlaldx(load32(h + k), load32(x + taps - 2 - k), acc);
+        }
+        if (k < taps) {
+            acc += (int32_t)h[k] * x[0];
+        }
+        out[i] = SampleTraits<q15_t>::saturate(acc >> 15);
+    }
+#else
+    firBlockImpl(x, h, taps, out, n, step);
+#endif
+}
+
+void firBlock(const q31_t* x, const q31_t* h, size_t taps, q31_t* out, size_t n, size_t step) {
+    firBlockImpl(x, h, taps, out, n, step);
+}
+
+void biquadBlock(const q15_t* coeffs, q15_t* state, unsigned postShift, const q15_t* in, q15_t* out, size_t n) {
+#if DSP_SIMD
+    const int32_t b0 = coeffs[0];
+    const uint32_t b12 = load32(coeffs + 1);
+    const uint32_t a12 = load32(coeffs + 3);
+    uint32_t x12 = load32(state); // x[n-1], x[n-2]
+    uint32_t y12 = load32(state + 2); // y[n-1], y[n-2]
+    const unsigned shift = 15 - postShift;
+    for (size_t i = 0; i < n; ++i) {
+        const int32_t x0 = in[i];
+        const int64_t acc = smlald(b12, x12, (int64_t)b0 * x0) - smlald(a12, y12, 0);
+        const q15_t y0 = SampleTraits<q15_t>::saturate(acc >> shift);
+        x12 = (x12 << 16) | (uint16_t)x0;
+        y12 = (y12 << 16) | (uint16_t)y0;
+        out[i] = y0;
+    }
+    store32(state, x12);
+    store32(state + 2, y12);
+#else
+    biquadBlockImpl(coeffs, state, postShift, in, out, n);
+#endif
+}
+
+void biquadBlock(const q31_t* coeffs, q31_t* state, unsigned postShift, const q31_t* in, q31_t* out, size_t n) {
+    biquadBlockImpl(coeffs, state, postShift, in, out, n);
+}
+
+uint32_t sqrt64(uint64_t v) {
+    uint64_t r = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
+
+} // namespace particle::dsp::detail
+
+} // namespace particle::dsp
+
+} // namespace particle
@@ -0,0 +1,734 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <type_traits>
+
+namespace {
+
+using namespace particle;
+
+// Size of the chunks in which formatted data is passed to the callback
+const size_t FORMAT_CHUNK_SIZE = 64;
+
+// Size of the stack buffer used for conversions delegated to the C library
+const size_t FORMAT_FALLBACK_BUFFER_SIZE = 64;
+
+// Maximum precision for which FORMAT_ROUND_EXACT can be supported
+const unsigned FORMAT_EXACT_MAX_PRECISION = 9;
+
+// Values that are this close to a halfway case are considered ambiguous
+const double FORMAT_TIE_TOLERANCE = 1e-6;
+
+const char DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+const char DIGITS_UPPER[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+const char DIGIT_PAIRS[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+const unsigned long long POW10[FORMAT_FIXED_MAX_PRECISION + 1] = {
+    1ull,
+    10ull,
+    100ull,
+    1000ull,
+    10000ull,
+    100000ull,
+    1000000ull,
+    10000000ull,
+    100000000ull,
+    1000000000ull,
+    10000000000ull,
+    100000000000ull,
+    1000000000000ull,
+    10000000000000ull,
+    100000000000000ull,
+    1000000000000000ull,
+    10000000000000000ull,
+    100000000000000000ull,
+    1000000000000000000ull,
+    10000000000000000000ull
+};
+
+enum FormatFlag {
+    FLAG_LEFT = 0x01, // '-'
+    FLAG_PLUS = 0x02, // '+'
+    FLAG_SPACE = 0x04, // ' '
+    FLAG_ALT = 0x08, // '#'
+    FLAG_ZERO = 0x10 // '0'
+};
+
+enum FormatLength {
+    LENGTH_NONE,
+    LENGTH_HH,
+    LENGTH_H,
+    LENGTH_L,
+    LENGTH_LL,
+    LENGTH_J,
+    LENGTH_Z,
+    LENGTH_T,
+    LENGTH_BIG_L
+};
+
+const char* const LENGTH_STRINGS[] = { "", "hh", "h", "l", "ll", "j", "z", "t", "L" };
+
+struct FormatSpec {
+    unsigned flags;
+    unsigned width;
+    int precision; // -1 if not specified
+    FormatLength length;
+    char conv;
+};
+
+// va_list can be an array type, so it's wrapped into a structure in order to be passed by reference
+struct FormatArgs {
+    va_list ap;
+};
+
+// Buffers formatted data and passes it to the callback in chunks
+class FormatWriter {
+public:
+    FormatWriter(FormatCallback callback, void* ctx) :
+            callback_(callback),
+            ctx_(ctx),
+            size_(0),
+            count_(0),
+            written_(0) {
+    }
+
+    void write(char c) {
+        if (size_ == sizeof(buf_)) {
+            flush();
+        }
+        buf_[size_++] = c;
+        ++count_;
+    }
+
+    void write(const char* data, size_t size) {
+        if (size > sizeof(buf_) - size_) {
+            flush();
+            if (size >= sizeof(buf_)) {
+                // Pass large blocks of data directly to the callback
+                written_ += callback_(data, size, ctx_);
+                count_ += size;
+                return;
+            }
+        }
+        memcpy(buf_ + size_, data, size);
+        size_ += size;
+        count_ += size;
+    }
+
+    void fill(char c, size_t n) {
+        while (n > 0) {
+            if (size_ == sizeof(buf_)) {
+                flush();
+            }
+            const size_t k = std::min(n, sizeof(buf_) - size_);
+            memset(buf_ + size_, c, k);
+            size_ += k;
+            count_ += k;
+            n -= k;
+        }
+    }
+
+    void flush() {
+        if (size_ > 0) {
+            written_ += callback_(buf_, size_, ctx_);
+            size_ = 0;
+        }
+    }
+
+    // Number of characters produced so far
+    size_t count() const {
+        return count_;
+    }
+
+    // Number of bytes written by the callback
+    size_t written() const {
+        return written_;
+    }
+
+private:
+    char buf_[FORMAT_CHUNK_SIZE];
+    FormatCallback callback_;
+    void* ctx_;
+    size_t size_, count_, written_;
+};
+
+char* formatDecimal(char* end, uint32_t value) {
+    while (value >= 100) {
+        const uint32_t q = value / 100;
+        const unsigned r = value - q * 100;
+        end -= 2;
+        memcpy(end, DIGIT_PAIRS + r * 2, 2);
+        value = q;
+    }
+    if (value >= 10) {
+        end -= 2;
+        memcpy(end, DIGIT_PAIRS + value * 2, 2);
+    } else {
+        *--end = '0' + value;
+    }
+    return end;
+}
+
+// Writes a formatted field: padding, prefix (sign or base), leading zeros and data
+void writeField(FormatWriter* w, const FormatSpec& spec, const char* prefix, size_t prefixSize, size_t zeros,
+        const char* data, size_t size, bool zeroPad) {
+    const size_t n = prefixSize + zeros + size;
+    size_t pad = (spec.width > n) ? spec.width - n : 0;
+    if (!(spec.flags & FLAG_LEFT)) {
+        if (zeroPad && (spec.flags & FLAG_ZERO)) {
+            zeros += pad;
+        } else {
+            w->fill(' ', pad);
+        }
+        pad = 0;
+    }
+    w->write(prefix, prefixSize);
+    w->fill('0', zeros);
+    w->write(data, size);
+    w->fill(' ', pad);
+}
+
+// Returns the sign prefix of a signed conversion
+size_t signPrefix(const FormatSpec& spec, bool negative, char* prefix) {
+    if (negative) {
+        *prefix = '-';
+    } else if (spec.flags & FLAG_PLUS) {
+        *prefix = '+';
+    } else if (spec.flags & FLAG_SPACE) {
+        *prefix = ' ';
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+// Rebuilds the conversion specification with all arguments of the '*' fields resolved
+void makeSpecString(const FormatSpec& spec, char* str) {
+    *str++ = '%';
+    if (spec.flags & FLAG_LEFT) {
+        *str++ = '-';
+    }
+    if (spec.flags & FLAG_PLUS) {
+        *str++ = '+';
+    }
+    if (spec.flags & FLAG_SPACE) {
+        *str++ = ' ';
+    }
+    if (spec.flags & FLAG_ALT) {
+        *str++ = '#';
+    }
+    if (spec.flags & FLAG_ZERO) {
+        *str++ = '0';
+    }
+    char buf[FORMAT_UNSIGNED_MAX_SIZE];
+    char* const end = buf + sizeof(buf);
+    if (spec.width > 0) {
+        const char* const p = formatUnsigned(end, spec.width);
+        str = std::copy(p, (const char*)end, str);
+    }
+    if (spec.precision >= 0) {
+        *str++ = '.';
+        const char* const p = formatUnsigned(end, spec.precision);
+        str = std::copy(p, (const char*)end, str);
+    }
+    const char* const len = LENGTH_STRINGS[spec.length];
+    str = std::copy(len, len + strlen(len), str);
+    *str++ = spec.conv;
+    *str = '\0';
+}
+
+// Delegates a conversion to the C library
+template<typename T>
+void formatFallback(FormatWriter* w, const FormatSpec& spec, T value) {
+    char fmt[32];
+    makeSpecString(spec, fmt);
+    char buf[FORMAT_FALLBACK_BUFFER_SIZE];
+    const int n = snprintf(buf, sizeof(buf), fmt, value);
+    if (n <= 0) {
+        return;
+    }
+    if ((size_t)n < sizeof(buf)) {
+        w->write(buf, n);
+        return;
+    }
+    char* const b = (char*)malloc(n + 1);
+    if (b) {
+        snprintf(b, n + 1, fmt, value);
+        w->write(b, n);
+        free(b);
+    }
+}
+
+void formatInteger(FormatWriter* w, const FormatSpec& spec, unsigned long long value, bool negative) {
+    unsigned base = 10;
+    bool upperCase = false;
+    char prefix[2];
+    size_t prefixSize = 0;
+    switch (spec.conv) {
+    case 'd':
+    case 'i':
+        prefixSize = signPrefix(spec, negative, prefix);
+        break;
+    case 'o':
+        base = 8;
+        break;
+    case 'x':
+    case 'X':
+        base = 16;
+        upperCase = (spec.conv == 'X');
+        if ((spec.flags & FLAG_ALT) && value != 0) {
+            prefix[0] = '0';
+            prefix[1] = spec.conv;
+            prefixSize = 2;
+        }
+        break;
+    default:
+        break;
+    }
+    char buf[FORMAT_UNSIGNED_MAX_SIZE];
+    char* const end = buf + sizeof(buf);
+    char* digits = end;
+    if (value != 0 || spec.precision != 0) {
+        digits = formatUnsigned(end, value, base, upperCase);
+    }
+    const size_t size = end - digits;
+    size_t zeros = 0;
+    if (spec.precision > 0 && (size_t)spec.precision > size) {
+        zeros = spec.precision - size;
+    }
+    if (base == 8 && (spec.flags & FLAG_ALT) && zeros == 0 && (size == 0 || *digits != '0')) {
+        zeros = 1;
+    }
+    writeField(w, spec, prefix, prefixSize, zeros, digits, size, spec.precision < 0 /* zeroPad */);
+}
+
+void formatDouble(FormatWriter* w, const FormatSpec& spec, double value) {
+    const bool negative = std::signbit(value);
+    const double absValue = negative ? -value : value;
+    if ((spec.conv == 'f' || spec.conv == 'F') && absValue < 18446744073709551616.0 /* 2^64, false for NaN */) {
+        const unsigned precision = (spec.precision >= 0) ? spec.precision : 6;
+        char buf[32];
+        int n = formatFixed(buf, sizeof(buf) - 1, absValue, precision, FORMAT_ROUND_EXACT);
+        if (n >= 0) {
+            if (precision == 0 && (spec.flags & FLAG_ALT)) {
+                buf[n++] = '.';
+            }
+            char prefix[1];
+            const size_t prefixSize = signPrefix(spec, negative, prefix);
+            writeField(w, spec, prefix, prefixSize, 0, buf, n, true /* zeroPad */);
+            return;
+        }
+    }
+    formatFallback(w, spec, value);
+}
+
+template<typename T>
+T* argPointer(FormatArgs* args) {
+    return va_arg(args->ap, T*);
+}
+
+// Stores the number of characters produced so far
+void storeCount(FormatArgs* args, FormatLength length, size_t count) {
+    switch (length) {
+    case LENGTH_HH:
+        *argPointer<signed char>(args) = count;
+        break;
+    case LENGTH_H:
+        *argPointer<short>(args) = count;
+        break;
+    case LENGTH_L:
+        *argPointer<long>(args) = count;
+        break;
+    case LENGTH_LL:
+    case LENGTH_BIG_L:
+        *argPointer<long long>(args) = count;
+        break;
+    case LENGTH_J:
+        *argPointer<intmax_t>(args) = count;
+        break;
+    case LENGTH_Z:
+        *argPointer<size_t>(args) = count;
+        break;
+    case LENGTH_T:
+        *argPointer<ptrdiff_t>(args) = count;
+        break;
+    default:
+        *argPointer<int>(args) = count;
+        break;
+    }
+}
+
+long long signedArg(FormatArgs* args, FormatLength length) {
+    switch (length) {
+    case LENGTH_HH:
+        return (signed char)va_arg(args->ap, int);
+    case LENGTH_H:
+        return (short)va_arg(args->ap, int);
+    case LENGTH_L:
+        return va_arg(args->ap, long);
+    case LENGTH_LL:
+    case LENGTH_BIG_L:
+        return va_arg(args->ap, long long);
+    case LENGTH_J:
+        return va_arg(args->ap, intmax_t);
+    case LENGTH_Z:
+        return va_arg(args->ap, std::make_signed<size_t>::type);
+    case LENGTH_T:
+        return va_arg(args->ap, ptrdiff_t);
+    default:
+        return va_arg(args->ap, int);
+    }
+}
+
+unsigned long long unsignedArg(FormatArgs* args, FormatLength length) {
+    switch (length) {
+    case LENGTH_HH:
+        return (unsigned char)va_arg(args->ap, unsigned);
+    case LENGTH_H:
+        return (unsigned short)va_arg(args->ap, unsigned);
+    case LENGTH_L:
+        return va_arg(args->ap, unsigned long);
+    case LENGTH_LL:
+    case LENGTH_BIG_L:
+        return va_arg(args->ap, unsigned long long);
+    case LENGTH_J:
+        return va_arg(args->ap, uintmax_t);
+    case LENGTH_Z:
+        return va_arg(args->ap, size_t);
+    case LENGTH_T:
+        return (unsigned long long)va_arg(args->ap, ptrdiff_t);
+    default:
+        return va_arg(args->ap, unsigned);
+    }
+}
+
+// Parses a conversion specification, not including the leading '%'. Returns a pointer to the
+// character following the specification, or nullptr if the specification is incomplete
+const char* parseSpec(const char* fmt, FormatArgs* args, FormatSpec* spec) {
+    spec->flags = 0;
+    spec->width = 0;
+    spec->precision = -1;
+    spec->length = LENGTH_NONE;
+    for (;; ++fmt) {
+        switch (*fmt) {
+        case '-':
+            spec->flags |= FLAG_LEFT;
+            continue;
+        case '+':
+            spec->flags |= FLAG_PLUS;
+            continue;
+        case ' ':
+            spec->flags |= FLAG_SPACE;
+            continue;
+        case '#':
+            spec->flags |= FLAG_ALT;
+            continue;
+        case '0':
+            spec->flags |= FLAG_ZERO;
+            continue;
+        default:
+            break;
+        }
+        break;
+    }
+    if (*fmt == '*') {
+        const int width = va_arg(args->ap, int);
+        if (width < 0) {
+            spec->flags |= FLAG_LEFT;
+            spec->width = -(unsigned)width;
+        } else {
+            spec->width = width;
+        }
+        ++fmt;
+    } else {
+        for (; *fmt >= '0' && *fmt <= '9'; ++fmt) {
+            spec->width = spec->width * 10 + (*fmt - '0');
+        }
+    }
+    if (*fmt == '.') {
+        ++fmt;
+        if (*fmt == '*') {
+            const int prec = va_arg(args->ap, int);
+            spec->precision = (prec >= 0) ? prec : -1;
+            ++fmt;
+        } else {
+            spec->precision = 0;
+            for (; *fmt >= '0' && *fmt <= '9'; ++fmt) {
+                spec->precision = spec->precision * 10 + (*fmt - '0');
+            }
+        }
+    }
+    switch (*fmt) {
+    case 'h':
+        if (*++fmt == 'h') {
+            spec->length = LENGTH_HH;
+            ++fmt;
+        } else {
+            spec->length = LENGTH_H;
+        }
+        break;
+    case 'l':
+        if (*++fmt == 'l') {
+            spec->length = LENGTH_LL;
+            ++fmt;
+        } else {
+            spec->length = LENGTH_L;
+        }
+        break;
+    case 'q':
+        spec->length = LENGTH_LL;
+        ++fmt;
+        break;
+    case 'j':
+        spec->length = LENGTH_J;
+        ++fmt;
+        break;
+    case 'z':
+        spec->length = LENGTH_Z;
+        ++fmt;
+        break;
+    case 't':
+        spec->length = LENGTH_T;
+        ++fmt;
+        break;
+    case 'L':
+        spec->length = LENGTH_BIG_L;
+        ++fmt;
+        break;
+    default:
+        break;
+    }
+    if (!*fmt) {
+        return nullptr;
+    }
+    spec->conv = *fmt++;
+    return fmt;
+}
+
+} // namespace
+
+size_t particle::vformat(FormatCallback callback, void* ctx, const char* fmt, va_list ap) {
+    FormatWriter w(callback, ctx);
+    FormatArgs args;
+    va_copy(args.ap, ap);
+    for (;;) {
+        const char* p = strchr(fmt, '%');
+        if (!p) {
+            w.write(fmt, strlen(fmt));
+            break;
+        }
+        w.write(fmt, p - fmt);
+        FormatSpec spec;
+        const char* const next = parseSpec(p + 1, &args, &spec);
+        if (!next) {
+            // Incomplete specification
+            w.write(p, strlen(p));
+            break;
+        }
+        switch (spec.conv) {
+        case 'd':
+        case 'i': {
+            const long long val = signedArg(&args, spec.length);
+            const unsigned long long absVal = (val < 0) ? -(unsigned long long)val : val;
+            formatInteger(&w, spec, absVal, val < 0);
+            break;
+        }
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X': {
+            formatInteger(&w, spec, unsignedArg(&args, spec.length), false);
+            break;
+        }
+        case 'c': {
+            if (spec.length == LENGTH_L) {
+                formatFallback(&w, spec, va_arg(args.ap, wint_t));
+            } else {
+                const char c = va_arg(args.ap, int);
+                writeField(&w, spec, nullptr, 0, 0, &c, 1, false);
+            }
+            break;
+        }
+        case 's': {
+            if (spec.length == LENGTH_L) {
+                formatFallback(&w, spec, va_arg(args.ap, const wchar_t*));
+                break;
+            }
+            const char* const s = va_arg(args.ap, const char*);
+            if (!s) {
+                formatFallback(&w, spec, s);
+                break;
+            }
+            size_t size = 0;
+            if (spec.precision >= 0) {
+                const char* const end = (const char*)memchr(s, 0, spec.precision);
+                size = end ? end - s : spec.precision;
+            } else {
+                size = strlen(s);
+            }
+            writeField(&w, spec, nullptr, 0, 0, s, size, false);
+            break;
+        }
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A': {
+            if (spec.length == LENGTH_BIG_L) {
+                formatFallback(&w, spec, va_arg(args.ap, long double));
+            } else {
+                formatDouble(&w, spec, va_arg(args.ap, double));
+            }
+            break;
+        }
+        case 'p': {
+            formatFallback(&w, spec, va_arg(args.ap, void*));
+            break;
+        }
+        case 'n': {
+            storeCount(&args, spec.length, w.count());
+            break;
+        }
+        case '%': {
+            w.write('%');
+            break;
+        }
+        default:
+            // Unknown conversion, write the specification as is
+            w.write(p, next - p);
+            break;
+        }
+        fmt = next;
+    }
+    va_end(args.ap);
+    w.flush();
+    return w.written();
+}
+
+char* particle::formatUnsigned(char* end, unsigned long long value, unsigned base, bool upperCase) {
+    if (base == 10 || base < 2 || base > 36) {
+        // 64-bit division is expensive on 32-bit targets, so large values are split into groups
+        // of 9 digits first
+        while (value > 0xffffffffu) {
+            const unsigned long long q = value / 1000000000u;
+            const uint32_t r = value - q * 1000000000u;
+            char* const start = end - 9;
+            char* p = formatDecimal(end, r);
+            while (p > start) {
+                *--p = '0';
+            }
+            end = start;
+            value = q;
+        }
+        return formatDecimal(end, value);
+    }
+    const char* const digits = upperCase ? DIGITS_UPPER : DIGITS;
+    if ((base & (base - 1)) == 0) {
+        const unsigned shift = __builtin_ctz(base);
+        const unsigned mask = base - 1;
+        do {
+            *--end = digits[value & mask];
+            value >>= shift;
+        } while (value);
+        return end;
+    }
+    while (value > 0xffffffffu) {
+        const unsigned long long q = value / base;
+        *--end = digits[value - q * base];
+        value = q;
+    }
+    uint32_t v = value;
+    do {
+        const uint32_t q = v / base;
+        *--end = digits[v - q * base];
+        v = q;
+    } while (v);
+    return end;
+}
+
+int particle::formatFixed(char* buf, size_t size, double value, unsigned precision, FormatRounding rounding) {
+    if (!(value >= 0.0 && value < 18446744073709551616.0 /* 2^64 */)) {
+        return -1;
+    }
+    if (rounding == FORMAT_ROUND_EXACT && precision > FORMAT_EXACT_MAX_PRECISION) {
+        return -1;
+    }
+    const unsigned digits = std::min(precision, FORMAT_FIXED_MAX_PRECISION);
+    unsigned long long intPart = (unsigned long long)value;
+    // The fractional part is computed exactly, only its scaling below is subject to rounding errors
+    const double frac = value - (double)intPart;
+    const unsigned long long scale = POW10[digits];
+    const double scaled = frac * scale;
+    unsigned long long fracPart = (unsigned long long)scaled;
+    const double rem = scaled - (double)fracPart;
+    if (rem > 0.5 + FORMAT_TIE_TOLERANCE) {
+        ++fracPart;
+    } else if (rem >= 0.5 - FORMAT_TIE_TOLERANCE) {
+        if (rounding == FORMAT_ROUND_EXACT) {
+            return -1;
+        }
+        ++fracPart;
+    }
+    if (fracPart >= scale) {
+        fracPart -= scale;
+        ++intPart;
+    }
+    char tmp[FORMAT_UNSIGNED_MAX_SIZE];
+    char* const tmpEnd = tmp + sizeof(tmp);
+    const char* const intDigits = formatUnsigned(tmpEnd, intPart);
+    const size_t intSize = tmpEnd - intDigits;
+    const size_t n = intSize + (precision ? precision + 1 : 0);
+    if (n >= size) {
+        return -1;
+    }
+    memcpy(buf, intDigits, intSize);
+    if (precision > 0) {
+        char* const d = buf + intSize;
+        *d = '.';
+        char* const fracEnd = d + 1 + digits;
+        char* p = formatUnsigned(fracEnd, fracPart);
+        while (p > d + 1) {
+            *--p = '0';
+        }
+        memset(fracEnd, '0', precision - digits);
+    }
+    buf[n] = '\0';
+    return n;
+}
@@ -16,6 +16,7 @@
  */
 
 #include "spark_wiring_json.h"
+#include "spark_wiring_format.h"
 
 #include <algorithm>
 
@@ -484,22 +485,13 @@ spark::JSONWriter& spark::JSONWriter::nullValue() {
 }
 
 void spark::JSONWriter::printf(const char *fmt, ...) {
-    char buf[16];
     va_list args;
     va_start(args, fmt);
-    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    particle::vformat([](const char *data, size_t size, void *ctx) -> size_t {
+        static_cast<JSONWriter*>(ctx)->write(data, size);
+        return size;
+    }, this, fmt, args);
     va_end(args);
-    if ((size_t)n >= sizeof(buf)) {
-        char buf[n + 1]; // Use larger buffer
-        va_start(args, fmt);
-        n = vsnprintf(buf, sizeof(buf), fmt, args);
-        va_end(args);
-        if (n > 0) {
-            write(buf, n);
-        }
-    } else if (n > 0) {
-        write(buf, n);
-    }
 }
 
 void spark::JSONWriter::writeSeparator() {
@@ -24,6 +24,7 @@
 
 #include <arpa/inet.h>
 #include "delay_hal.h"
+#include "spark_wiring_ticks.h"
 
 namespace spark {
 
@@ -129,6 +130,27 @@ void MeshPublish::Subscriptions::send(const char* event_name, const char* data)
     }
 }
 
+void MeshPublish::Subscriptions::filter(mesh::SubscriptionFilter* filter) const
+{
+    const int NUM_HANDLERS = sizeof(event_handlers) / sizeof(FilteringEventHandler);
+    for (int i = 0; i < NUM_HANDLERS; i++)
+    {
+        if (NULL == event_handlers[i].handler)
+        {
+            break;
+        }
+        // The filter is not necessarily null-terminated
+        char prefix[sizeof(event_handlers[i].filter) + 1] = {};
+        memcpy(prefix, event_handlers[i].filter, sizeof(event_handlers[i].filter));
+        filter->add(prefix);
+    }
+}
+
+bool MeshPublish::Subscriptions::empty() const
+{
+    return !event_handlers[0].handler;
+}
+
 int MeshPublish::fetchMulticastAddress(IPAddress& mcastAddr) {
     HAL_IPAddress addr = {};
     addr.v = 6;
@@ -171,119 +193,219 @@ int MeshPublish::uninitialize_udp() {
     return SYSTEM_ERROR_NONE;
 }
 
+int MeshPublish::sendPacket(const char* data, size_t size) {
+    std::lock_guard<RecursiveMutex> lk(mutex_);
+    CHECK(initialize_udp());
+    IPAddress mcastAddr;
+    CHECK(fetchMulticastAddress(mcastAddr));
+    CHECK(udp->sendPacket((const uint8_t*)data, size, mcastAddr, PORT));
+    return SYSTEM_ERROR_NONE;
+}
+
 int MeshPublish::publish(const char* topic, const char* data) {
     // Topic should be defined
     CHECK_TRUE(topic && (strlen(topic) > 0), SYSTEM_ERROR_INVALID_ARGUMENT);
 
-    // Including null-terminator
-    const size_t topicLen = strlen(topic) + 1;
-    const size_t dataLen = data ? strlen(data) + 1 : 0;
-
     // topic + data + version should fit within MAX_PACKET_LEN
-    CHECK_TRUE(topicLen + dataLen + sizeof(uint8_t) <= MAX_PACKET_LEN,
+    CHECK_TRUE(mesh::EventPacketWriter::packetSize(topic, data) <= MAX_PACKET_LEN,
             SYSTEM_ERROR_TOO_LARGE);
 
     std::lock_guard<RecursiveMutex> lk(mutex_);
+    ++stats_.eventsPublished;
+    if (aggregationWindow_) {
+        if (!summary_.mayHaveSubscribers(topic, millis())) {
+            // None of the nodes has advertised a matching subscription
+            ++stats_.eventsSuppressed;
+            return SYSTEM_ERROR_NONE;
+        }
+        if (batch_->add(topic, data) != 0) {
+            // Send the pending events and start a new packet
+            CHECK(flush());
+            CHECK(batch_->add(topic, data));
+        }
+        if (batch_->count() == 1) {
+            flushTimer_->start();
+        }
+        return SYSTEM_ERROR_NONE;
+    }
+
     CHECK(initialize_udp());
     IPAddress mcastAddr;
     CHECK(fetchMulticastAddress(mcastAddr));
 
+    // Including null-terminator
+    const size_t topicLen = strlen(topic) + 1;
+    const size_t dataLen = data ? strlen(data) + 1 : 0;
+
     CHECK(udp->beginPacket(mcastAddr, PORT));
-    uint8_t version = 0;
+    uint8_t version = mesh::PUBLISH_PACKET_EVENT;
     udp->write(&version, 1);
     udp->write((const uint8_t*)topic, topicLen);
     if (dataLen > 0) {
         udp->write((const uint8_t*)data, dataLen);
     }
     CHECK(udp->endPacket());
+    ++stats_.eventPackets;
+    return SYSTEM_ERROR_NONE;
+}
+
+int MeshPublish::flush() {
+    std::lock_guard<RecursiveMutex> lk(mutex_);
+    if (!batch_ || batch_->count() == 0) {
+        return SYSTEM_ERROR_NONE;
+    }
+    char* const buf = txBuffer_.get();
+    if (batch_->count() == 1) {
+        // A single event is sent in a format that older firmware versions can parse
+        buf[0] = mesh::PUBLISH_PACKET_EVENT;
+    }
+    const int ret = sendPacket(buf, batch_->size());
+    batch_->reset();
+    CHECK(ret);
+    ++stats_.eventPackets;
+    return SYSTEM_ERROR_NONE;
+}
+
+int MeshPublish::enableAggregation(system_tick_t window) {
+    CHECK_TRUE(window > 0, SYSTEM_ERROR_INVALID_ARGUMENT);
+    std::lock_guard<RecursiveMutex> lk(mutex_);
+    if (!batch_) {
+        txBuffer_.reset(new (std::nothrow) char[MAX_PACKET_LEN]);
+        CHECK_TRUE(txBuffer_, SYSTEM_ERROR_NO_MEMORY);
+        batch_.reset(new (std::nothrow) mesh::EventPacketWriter(txBuffer_.get(), MAX_PACKET_LEN));
+        CHECK_TRUE(batch_, SYSTEM_ERROR_NO_MEMORY);
+    }
+    if (!flushTimer_) {
+        flushTimer_.reset(new (std::nothrow) Timer(window, [this]() {
+            flush();
+        }, true /* one_shot */));
+        CHECK_TRUE(flushTimer_ && flushTimer_->isValid(), SYSTEM_ERROR_NO_MEMORY);
+    } else if (window != aggregationWindow_) {
+        // The timer may be running, flush the pending events before changing the period
+        flush();
+        flushTimer_->changePeriod(window);
+    }
+    CHECK(initialize_udp());
+    // Advertisements from other nodes are needed to suppress events
+    CHECK(startThread());
+    aggregationWindow_ = window;
     return SYSTEM_ERROR_NONE;
 }
 
+void MeshPublish::disableAggregation() {
+    std::lock_guard<RecursiveMutex> lk(mutex_);
+    aggregationWindow_ = 0;
+    flush();
+}
+
+MeshPublishStats MeshPublish::publishStats() {
+    std::lock_guard<RecursiveMutex> lk(mutex_);
+    return stats_;
+}
+
 int MeshPublish::subscribe(const char* prefix, EventHandler handler) {
+    std::lock_guard<RecursiveMutex> lk(mutex_);
+    CHECK(initialize_udp());
+    CHECK(subscriptions.add(prefix, handler));
+    CHECK(startThread());
+    // Let the publishers know about the new subscription right away. If this fails, the
+    // subscriptions will be advertised again in ADVERTISEMENT_INTERVAL
+    advertise();
+    return SYSTEM_ERROR_NONE;
+}
+
+int MeshPublish::startThread() {
     std::lock_guard<RecursiveMutex> lk(mutex_);
     if (!thread_) {
+        summary_.reset(millis());
         thread_.reset(new (std::nothrow) Thread("meshpub", [](void* ptr) {
             auto self = (MeshPublish*)ptr;
             while (true) {
-                self->poll();
+                // The thread only wakes up when a packet is received or when it's time to
+                // advertise the subscriptions
+                const system_tick_t timeout = self->advertiseIfNeeded();
+                self->receive(timeout);
             }
         }, this, OS_THREAD_PRIORITY_DEFAULT + 1));
+        CHECK_TRUE(thread_, SYSTEM_ERROR_NO_MEMORY);
     }
-    CHECK(initialize_udp());
-    CHECK(subscriptions.add(prefix, handler));
+    return SYSTEM_ERROR_NONE;
+}
+
+int MeshPublish::advertise() {
+    std::lock_guard<RecursiveMutex> lk(mutex_);
+    mesh::SubscriptionFilter filter;
+    subscriptions.filter(&filter);
+    char buf[mesh::SubscriptionFilter::SIZE + 1];
+    buf[0] = mesh::PUBLISH_PACKET_SUBSCRIPTIONS;
+    memcpy(buf + 1, filter.data(), mesh::SubscriptionFilter::SIZE);
+    lastAdvertisement_ = millis();
+    CHECK(sendPacket(buf, sizeof(buf)));
+    ++stats_.advertisements;
     return SYSTEM_ERROR_NONE;
 }
 
 /**
- * Pull data from the socket and handle as required.
+ * Advertises the subscriptions if the advertisement interval has elapsed. Returns the time
+ * remaining until the next advertisement.
  */
-int MeshPublish::poll() {
-    int result = 0;
+system_tick_t MeshPublish::advertiseIfNeeded() {
+    std::lock_guard<RecursiveMutex> lk(mutex_);
+    if (subscriptions.empty()) {
+        // subscribe() advertises the first subscription by itself
+        return ADVERTISEMENT_INTERVAL;
+    }
+    const system_tick_t elapsed = millis() - lastAdvertisement_;
+    if (elapsed >= ADVERTISEMENT_INTERVAL) {
+        advertise();
+        return ADVERTISEMENT_INTERVAL;
+    }
+    return ADVERTISEMENT_INTERVAL - elapsed;
+}
+
+int MeshPublish::receive(system_tick_t timeout) {
     UDP* u = nullptr;
     {
         std::lock_guard<RecursiveMutex> lk(mutex_);
         u = udp.get();
     }
-    if (u) {
+    if (!u) {
+        HAL_Delay_Milliseconds(100);
+        return SYSTEM_ERROR_NONE;
+    }
+    if (!buffer_) {
+        buffer_.reset(new (std::nothrow) uint8_t[MAX_PACKET_LEN]);
         if (!buffer_) {
-            buffer_.reset(new (std::nothrow) uint8_t[MAX_PACKET_LEN]);
-            if (!buffer_) {
-                return SYSTEM_ERROR_NO_MEMORY;
-            }
-        }
-        int len = u->receivePacket(buffer_.get(), MAX_PACKET_LEN, 1000);
-        if (len > 0) {
-            LOG(TRACE, "parse packet %d", len);
-            const char* buffer = (const char*)buffer_.get();
-
-            // There should be a version and it should be "0"
-            const char version = *buffer++;
-            CHECK_TRUE(version == 0, SYSTEM_ERROR_BAD_DATA);
-            len -= sizeof(version);
-
-            // Topic should not be empty
-            const size_t topicLen = strnlen(buffer, len);
-            CHECK_TRUE(topicLen > 0, SYSTEM_ERROR_BAD_DATA);
-
-            const char* topic = buffer;
-
-            len -= topicLen;
-            buffer += topicLen;
-
-            // Topic should be terminated by '\0'
-            CHECK_TRUE(len > 0, SYSTEM_ERROR_BAD_DATA);
-            CHECK_TRUE(*buffer == 0, SYSTEM_ERROR_BAD_DATA);
-            // Skip it
-            --len;
-            buffer++;
-
-            size_t dataLen = 0;
-            const char* data = "";
-            if (len > 0) {
-                // There is data
-                dataLen = strnlen(buffer, len);
-                data = buffer;
-                // Data can be empty
-                len -= dataLen;
-                buffer += dataLen;
-                // Data should be terminated by '\0'
-                CHECK_TRUE(len > 0, SYSTEM_ERROR_BAD_DATA);
-                CHECK_TRUE(*buffer == 0, SYSTEM_ERROR_BAD_DATA);
-                // Skip it
-                --len;
-                buffer++;
-            }
-            CHECK_TRUE(len == 0, SYSTEM_ERROR_BAD_DATA);
-
-            std::lock_guard<RecursiveMutex> lk(mutex_);
-            subscriptions.send(topic, data);
-        } else {
-            result = len;
+            return SYSTEM_ERROR_NO_MEMORY;
         }
-    } else {
-        HAL_Delay_Milliseconds(100);
     }
-    return result;
+    const int len = u->receivePacket(buffer_.get(), MAX_PACKET_LEN, timeout);
+    if (len <= 0) {
+        return len;
+    }
+    LOG(TRACE, "parse packet %d", len);
+    const char* buffer = (const char*)buffer_.get();
+    std::lock_guard<RecursiveMutex> lk(mutex_);
+    ++stats_.packetsReceived;
+    if (buffer[0] == mesh::PUBLISH_PACKET_SUBSCRIPTIONS) {
+        mesh::SubscriptionFilter filter;
+        CHECK(mesh::parseSubscriptionPacket(buffer, len, &filter));
+        summary_.update(filter, millis());
+        return SYSTEM_ERROR_NONE;
+    }
+    const int count = CHECK(mesh::parseEventPacket(buffer, len, [](const char* name, const char* data, void* ctx) {
+        const auto self = (MeshPublish*)ctx;
+        self->subscriptions.send(name, data);
+    }, this));
+    stats_.eventsReceived += count;
+    return SYSTEM_ERROR_NONE;
+}
+
+/**
+ * Pull data from the socket and handle as required.
+ */
+int MeshPublish::poll() {
+    return receive(POLL_TIMEOUT);
 }
 
 IPAddress MeshClass::localIP() {
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_mesh_publish.h"
+
+#include "system_error.h"
+
+#include <cstring>
+
+namespace spark {
+
+namespace mesh {
+
+namespace {
+
+const uint32_t FNV_OFFSET_BASIS = 2166136261u;
+const uint32_t FNV_PRIME = 16777619u;
+
+inline uint32_t fnvUpdate(uint32_t h, char c) {
+    return (h ^ (uint8_t)c) * FNV_PRIME;
+}
+
+// Improves the distribution of the bits of the FNV-1a hash
+inline uint32_t mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    return h;
+}
+
+// Validates a sequence of '\0'-terminated strings. Returns the number of strings
+int countStrings(const char* data, size_t size) {
+    int count = 0;
+    while (size > 0) {
+        const size_t len = strnlen(data, size);
+        if (len == size) {
+            return SYSTEM_ERROR_BAD_DATA; // Not terminated
+        }
+        data += len + 1;
+        size -= len + 1;
+        ++count;
+    }
+    return count;
+}
+
+} // unnamed
+
+SubscriptionFilter::SubscriptionFilter() {
+    clear();
+}
+
+void SubscriptionFilter::add(const char* prefix) {
+    uint32_t h = FNV_OFFSET_BASIS;
+    for (; *prefix; ++prefix) {
+        h = fnvUpdate(h, *prefix);
+    }
+    set(mix(h));
+}
+
+void SubscriptionFilter::merge(const SubscriptionFilter& filter) {
+    for (size_t i = 0; i < SIZE; ++i) {
+        bits_[i] |= filter.bits_[i];
+    }
+}
+
+void SubscriptionFilter::clear() {
+    memset(bits_, 0, sizeof(bits_));
+}
+
+bool SubscriptionFilter::mayMatch(const char* name) const {
+    // The hash of each prefix of the name is computed incrementally
+    uint32_t h = FNV_OFFSET_BASIS;
+    if (test(mix(h))) {
+        return true; // Empty prefix
+    }
+    for (; *name; ++name) {
+        h = fnvUpdate(h, *name);
+        if (test(mix(h))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SubscriptionFilter::isEmpty() const {
+    for (size_t i = 0; i < SIZE; ++i) {
+        if (bits_[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Each prefix sets 3 bits of the filter, the bit indices are taken from the bytes of the hash
+void SubscriptionFilter::set(uint32_t hash) {
+    for (unsigned i = 0; i < 3; ++i) {
+        const unsigned bit = (hash >> (i * 8)) & 0xff;
+        bits_[bit / 8] |= 1 << (bit % 8);
+    }
+}
+
+bool SubscriptionFilter::test(uint32_t hash) const {
+    for (unsigned i = 0; i < 3; ++i) {
+        const unsigned bit = (hash >> (i * 8)) & 0xff;
+        if (!(bits_[bit / 8] & (1 << (bit % 8)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+EventPacketWriter::EventPacketWriter(char* buf, size_t size) :
+        buf_(buf),
+        bufSize_(size) {
+    reset();
+}
+
+int EventPacketWriter::add(const char* name, const char* data) {
+    if (!data) {
+        data = "";
+    }
+    const size_t nameLen = strlen(name) + 1;
+    const size_t dataLen = strlen(data) + 1;
+    if (nameLen + dataLen > bufSize_ - size_) {
+        return SYSTEM_ERROR_TOO_LARGE;
+    }
+    memcpy(buf_ + size_, name, nameLen);
+    size_ += nameLen;
+    memcpy(buf_ + size_, data, dataLen);
+    size_ += dataLen;
+    ++count_;
+    return 0;
+}
+
+void EventPacketWriter::reset() {
+    buf_[0] = PUBLISH_PACKET_EVENTS;
+    size_ = 1;
+    count_ = 0;
+}
+
+size_t EventPacketWriter::packetSize(const char* name, const char* data) {
+    return strlen(name) + (data ? strlen(data) : 0) + 3;
+}
+
+int parseEventPacket(const char* data, size_t size, PublishEventCallback callback, void* ctx) {
+    if (size < 1) {
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    const char type = *data++;
+    --size;
+    const int n = countStrings(data, size);
+    if (n < 0) {
+        return n;
+    }
+    if (type == PUBLISH_PACKET_EVENT) {
+        // Event name and optional data
+        if (n < 1 || n > 2 || !*data) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        const char* d = (n == 2) ? data + strlen(data) + 1 : "";
+        callback(data, d, ctx);
+        return 1;
+    }
+    if (type != PUBLISH_PACKET_EVENTS || n < 2 || n % 2 != 0) {
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    // Event names should not be empty
+    const char* p = data;
+    for (int i = 0; i < n; i += 2) {
+        if (!*p) {
+            return SYSTEM_ERROR_BAD_DATA;
+        }
+        p += strlen(p) + 1;
+        p += strlen(p) + 1;
+    }
+    p = data;
+    for (int i = 0; i < n; i += 2) {
+        const char* name = p;
+        p += strlen(p) + 1;
+        const char* d = p;
+        p += strlen(p) + 1;
+        callback(name, d, ctx);
+    }
+    return n / 2;
+}
+
+int parseSubscriptionPacket(const char* data, size_t size, SubscriptionFilter* filter) {
+    if (size != SubscriptionFilter::SIZE + 1 || data[0] != PUBLISH_PACKET_SUBSCRIPTIONS) {
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    memcpy(filter->data(), data + 1, SubscriptionFilter::SIZE);
+    return 0;
+}
+
+SubscriptionSummary::SubscriptionSummary(system_tick_t generation) :
+        generation_(generation),
+        genStart_(0),
+        complete_(false) {
+}
+
+void SubscriptionSummary::reset(system_tick_t now) {
+    cur_.clear();
+    prev_.clear();
+    genStart_ = now;
+    complete_ = false;
+}
+
+void SubscriptionSummary::update(const SubscriptionFilter& filter, system_tick_t now) {
+    rotate(now);
+    cur_.merge(filter);
+}
+
+bool SubscriptionSummary::mayHaveSubscribers(const char* name, system_tick_t now) {
+    rotate(now);
+    if (!complete_) {
+        return true;
+    }
+    return cur_.mayMatch(name) || prev_.mayMatch(name);
+}
+
+void SubscriptionSummary::rotate(system_tick_t now) {
+    const system_tick_t elapsed = now - genStart_;
+    if (elapsed < generation_) {
+        return;
+    }
+    if (elapsed < generation_ * 2) {
+        prev_ = cur_;
+    } else {
+        prev_.clear();
+    }
+    cur_.clear();
+    genStart_ = now;
+    complete_ = true;
+}
+
+} // namespace mesh
+
+} // namespace spark
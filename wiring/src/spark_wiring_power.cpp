@@ -977,6 +977,25 @@ byte PMIC::getFault() {
 
 }
 
+/*******************************************************************************
+ * Function Name  : getStatusRegisters
+ * Description    : Reads the MISC_CONTROL, SYSTEM_STATUS and FAULT registers
+ *                  in a single I2C transfer
+ * Input          : NONE
+ * Return         : false on error, true on success
+ *******************************************************************************/
+bool PMIC::getStatusRegisters(byte& misc, byte& status, byte& fault) {
+
+    byte DATA[3] = {};
+    if (!readRegisters(MISC_CONTROL_REGISTER, DATA, sizeof(DATA))) {
+        return false;
+    }
+    misc = DATA[0];
+    status = DATA[1];
+    fault = DATA[2];
+    return true;
+}
+
 /*
 
 //-----------------------------------------------------------------------------
@@ -1035,6 +1054,28 @@ byte PMIC::readRegister(byte startAddress) {
 }
 
 
+/*******************************************************************************
+ * Function Name  : readRegisters
+ * Description    : Reads consecutive registers. The register address is
+ *                  incremented automatically by the PMIC
+ * Input          :
+ * Return         : false on error, true on success
+ *******************************************************************************/
+bool PMIC::readRegisters(byte startAddress, byte* data, size_t size) {
+    std::lock_guard<PMIC> l(*this);
+    pmicWireInstance()->beginTransmission(PMIC_ADDRESS);
+    pmicWireInstance()->write(startAddress);
+    pmicWireInstance()->endTransmission(true);
+
+    if (pmicWireInstance()->requestFrom(PMIC_ADDRESS, (int)size, true) != size) {
+        return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = pmicWireInstance()->read();
+    }
+    return true;
+}
+
 /*******************************************************************************
  * Function Name  :
  * Description    :
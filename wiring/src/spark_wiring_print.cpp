@@ -30,6 +30,16 @@
 #include "spark_wiring_print.h"
 #include "spark_wiring_string.h"
 #include "spark_wiring_stream.h"
+#include "spark_wiring_format.h"
+
+namespace {
+
+size_t printCallback(const char* data, size_t size, void* ctx) {
+  const auto print = static_cast<Print*>(ctx);
+  return print->write((const uint8_t*)data, size);
+}
+
+} // namespace
 
 // Public Methods //////////////////////////////////////////////////////////////
 
@@ -190,22 +200,13 @@ size_t Print::println(const __FlashStringHelper* str)
 // Private Methods /////////////////////////////////////////////////////////////
 
 size_t Print::printNumber(unsigned long n, uint8_t base) {
-  char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus zero byte.
-  char *str = &buf[sizeof(buf) - 1];
-
-  *str = '\0';
+  char buf[8 * sizeof(long)]; // Assumes 8-bit chars
+  char* const end = buf + sizeof(buf);
 
-  // prevent crash if called with base == 1
-  if (base < 2) base = 10;
+  // formatUnsigned() treats base < 2 as 10, which prevents a crash if called with base == 1
+  const char* str = particle::formatUnsigned(end, n, base, true /* upperCase */);
 
-  do {
-    unsigned long m = n;
-    n /= base;
-    char c = m - base * n;
-    *--str = c < 10 ? c + '0' : c + 'A' - 10;
-  } while(n);
-
-  return write(str);
+  return write((const uint8_t*)str, end - str);
 }
 
 size_t Print::printFloat(double number, uint8_t digits)
@@ -225,29 +226,16 @@ size_t Print::printFloat(double number, uint8_t digits)
   }
 
   // Round correctly so that print(1.999, 2) prints as "2.00"
-  double rounding = 0.5;
-  for (uint8_t i=0; i<digits; ++i)
-    rounding /= 10.0;
-
-  number += rounding;
-
-  // Extract the integer part of the number and print it
-  unsigned long int_part = (unsigned long)number;
-  double remainder = number - (double)int_part;
-  n += print(int_part);
-
-  // Print the decimal point, but only if there are digits beyond
-  if (digits > 0) {
-    n += print(".");
+  char buf[32];
+  const unsigned prec = (digits <= particle::FORMAT_FIXED_MAX_PRECISION) ? digits : particle::FORMAT_FIXED_MAX_PRECISION;
+  const int len = particle::formatFixed(buf, sizeof(buf), number, prec, particle::FORMAT_ROUND_HALF_UP);
+  if (len > 0) {
+    n += write((const uint8_t*)buf, len);
   }
 
-  // Extract digits from the remainder one at a time
-  while (digits-- > 0)
-  {
-    remainder *= 10.0;
-    int toPrint = int(remainder);
-    n += print(toPrint);
-    remainder -= toPrint;
+  // Digits beyond the precision of a double
+  for (unsigned i = prec; i < digits; ++i) {
+    n += print('0');
   }
 
   return n;
@@ -255,27 +243,17 @@ size_t Print::printFloat(double number, uint8_t digits)
 
 size_t Print::printf_impl(bool newline, const char* format, ...)
 {
-    const int bufsize = 20;
-    char test[bufsize];
-    va_list marker;
-    va_start(marker, format);
-    size_t n = vsnprintf(test, bufsize, format, marker);
-    va_end(marker);
-
-    if (n<bufsize)
-    {
-        n = print(test);
-    }
-    else
-    {
-        char bigger[n+1];
-        va_start(marker, format);
-        n = vsnprintf(bigger, n+1, format, marker);
-        va_end(marker);
-        n = print(bigger);
-    }
+    va_list args;
+    va_start(args, format);
+    const size_t n = vprintf(newline, format, args);
+    va_end(args);
+    return n;
+}
+
+size_t Print::vprintf(bool newline, const char* format, va_list args)
+{
+    size_t n = particle::vformat(printCallback, this, format, args);
     if (newline)
         n += println();
     return n;
 }
-
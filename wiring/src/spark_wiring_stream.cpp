@@ -26,6 +26,10 @@
 
 #include "spark_wiring_stream.h"
 #include "spark_wiring.h"       // for millis())
+#include "system_error.h"
+
+#include <algorithm>
+#include <cstring>
 
 #define PARSE_TIMEOUT 1000  // default number of milli-seconds to wait
 #define NO_SKIP_CHAR  1  // a magic char not found in a valid ASCII numeric field
@@ -33,7 +37,8 @@
 // private method to read stream with timeout
 int Stream::timedRead()
 {
-  int c;
+  int c = read();
+  if (c >= 0) return c; // don't query the system time if the data is already available
   _startMillis = millis();
   do {
     c = read();
@@ -45,7 +50,8 @@ int Stream::timedRead()
 // private method to peek stream with timeout
 int Stream::timedPeek()
 {
-  int c;
+  int c = peek();
+  if (c >= 0) return c;
   _startMillis = millis();
   do {
     c = peek();
@@ -217,23 +223,55 @@ float Stream::parseFloat(char skipChar){
     return value;
 }
 
-// read characters from stream into buffer
-// terminates if length characters have been read, or timeout (see setTimeout)
-// returns the number of characters placed in the buffer
-// the buffer is NOT null terminated.
-//
-size_t Stream::readBytes(char *buffer, size_t length)
+// reads characters into the buffer until length characters have been read, the terminator
+// character is found (unless the terminator is negative), or a timeout occurs. the data is
+// copied in blocks if the stream supports zero-copy reading (see acquireRead())
+// returns the number of characters placed in the buffer, not including the terminator
+size_t Stream::readBytesImpl(char *buffer, size_t length, int terminator, bool *found)
 {
   size_t count = 0;
+  *found = false;
   while (count < length) {
+    const char* data = nullptr;
+    const int ret = acquireRead(&data);
+    if (ret > 0) {
+      size_t n = std::min((size_t)ret, length - count);
+      const char* term = (terminator >= 0) ? (const char*)memchr(data, terminator, n) : nullptr;
+      if (term) {
+        n = term - data;
+      }
+      memcpy(buffer + count, data, n);
+      count += n;
+      if (term) {
+        commitRead(n + 1); // consume the terminator
+        *found = true;
+        break;
+      }
+      commitRead(n);
+      continue;
+    }
     int c = timedRead();
     if (c < 0) break;
-    *buffer++ = (char)c;
-    count++;
+    if (c == terminator) {
+      *found = true;
+      break;
+    }
+    buffer[count++] = (char)c;
   }
   return count;
 }
 
+// read characters from stream into buffer
+// terminates if length characters have been read, or timeout (see setTimeout)
+// returns the number of characters placed in the buffer
+// the buffer is NOT null terminated.
+//
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+  bool found = false;
+  return readBytesImpl(buffer, length, -1, &found);
+}
+
 
 // as readBytes with terminator character
 // terminates if length characters have been read, timeout, or if the terminator character  detected
@@ -242,38 +280,43 @@ size_t Stream::readBytes(char *buffer, size_t length)
 size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
 {
   if (length < 1) return 0;
-  size_t index = 0;
-  while (index < length) {
-    int c = timedRead();
-    if (c < 0 || c == terminator) break;
-    *buffer++ = (char)c;
-    index++;
-  }
-  return index; // return number of characters, not including null terminator
+  bool found = false;
+  return readBytesImpl(buffer, length, (unsigned char)terminator, &found); // return number of characters, not including null terminator
 }
 
-String Stream::readString()
+int Stream::acquireRead(const char** data)
+{
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int Stream::commitRead(size_t size)
+{
+  return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+String Stream::readStringImpl(int terminator)
 {
   String ret;
-  int c = timedRead();
-  while (c >= 0)
-  {
-    ret += (char)c;
-    c = timedRead();
-  }
+  char buf[64];
+  bool found = false;
+  size_t n = 0;
+  do {
+    n = readBytesImpl(buf, sizeof(buf), terminator, &found);
+    if (n > 0) {
+      ret += String(buf, n);
+    }
+  } while (n == sizeof(buf) && !found);
   return ret;
 }
 
+String Stream::readString()
+{
+  return readStringImpl(-1);
+}
+
 String Stream::readStringUntil(char terminator)
 {
-  String ret;
-  int c = timedRead();
-  while (c >= 0 && c != terminator)
-  {
-    ret += (char)c;
-    c = timedRead();
-  }
-  return ret;
+  return readStringImpl((unsigned char)terminator);
 }
 
 void serialReadLine(Stream *serialObj, char *dst, int max_len, system_tick_t timeout)
@@ -33,34 +33,30 @@
 #include <stdlib.h>
 #include "string_convert.h"
 
-//These are very crude implementations - will refine later
-//------------------------------------------------------------------------------------------
+#include "spark_wiring_format.h"
 
-void dtoa (double val, unsigned char prec, char *sout) {
-    bool negative = val<0;
-    if (negative) {
+// Formats a floating point number in fixed-point notation, rounding halfway cases away from zero
+static void dtoa (double val, unsigned char prec, char *sout, size_t size) {
+    if (val < 0) {
         val = -val;
         *sout++ = '-';
+        --size;
     }
-    long scale = 1;
-    for (uint8_t i=0; i<prec; i++)
-        scale *= 10;
-    val *= scale;   // capture all the significant digits
-    uint64_t fixed = uint64_t(val);
-    if ((val-fixed)>=0.5)    // round last digit
-        fixed++;
-
-    unsigned long first = (unsigned long)(fixed / scale);
-    unsigned long second = (unsigned long)(fixed % scale);
-
-    ultoa(first, sout, 10, 1);
-    if (prec) {
-        sout += strlen(sout);
-        *sout++ = '.';
-        ultoa(second, sout, 10, prec);
+    if (particle::formatFixed(sout, size, val, prec, particle::FORMAT_ROUND_HALF_UP) < 0) {
+        strcpy(sout, "ovf");
     }
 }
 
+// Formats a signed integer in base 10 and returns a pointer to the first character
+static char* ltoa10 (long val, char *end) {
+    const unsigned long absVal = (val < 0) ? -(unsigned long)val : val;
+    char *str = particle::formatUnsigned(end, absVal);
+    if (val < 0) {
+        *--str = '-';
+    }
+    return str;
+}
+
 
 /*********************************************/
 /*  Constructors                             */
@@ -157,7 +153,7 @@ String::String(float value, int decimalPlaces)
 {
 	init();
 	char buf[33];
-	dtoa(value, decimalPlaces, buf);
+	dtoa(value, decimalPlaces, buf, sizeof(buf));
         *this = buf;
 }
 
@@ -165,12 +161,12 @@ String::String(double value, int decimalPlaces)
 {
 	init();
 	char buf[33];
-	dtoa(value, decimalPlaces, buf);
+	dtoa(value, decimalPlaces, buf, sizeof(buf));
         *this = buf;
 }
 String::~String()
 {
-	free(buffer);
+	if (!isInline()) free(buffer);
 }
 
 /*********************************************/
@@ -187,7 +183,7 @@ inline void String::init(void)
 
 void String::invalidate(void)
 {
-	if (buffer) free(buffer);
+	if (buffer && !isInline()) free(buffer);
 	buffer = NULL;
 	capacity = len = 0;
 }
@@ -204,6 +200,20 @@ unsigned char String::reserve(unsigned int size)
 
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
+	if (!buffer || isInline()) {
+		if (maxStrLen <= INLINE_CAPACITY) {
+			buffer = sso;
+			capacity = INLINE_CAPACITY;
+			return 1;
+		}
+		// moving out of the inline buffer
+		char *newbuffer = (char *)malloc(maxStrLen + 1);
+		if (!newbuffer) return 0;
+		if (buffer) memcpy(newbuffer, buffer, len + 1);
+		buffer = newbuffer;
+		capacity = maxStrLen;
+		return 1;
+	}
 	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
 	if (newbuffer) {
 		buffer = newbuffer;
@@ -213,6 +223,15 @@ unsigned char String::changeBuffer(unsigned int maxStrLen)
 	return 0;
 }
 
+// Like reserve(), but leaves extra room in the buffer, so that a series of appends
+// takes an amortized constant number of allocations
+unsigned char String::grow(unsigned int size)
+{
+	if (buffer && capacity >= size) return 1;
+	if (buffer && changeBuffer(size + (size >> 1))) return 1;
+	return reserve(size);
+}
+
 /*********************************************/
 /*  Copy and Move                            */
 /*********************************************/
@@ -236,16 +255,20 @@ String & String::copy(const __FlashStringHelper *pstr, unsigned int length) {
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
 void String::move(String &rhs)
 {
-	if (buffer) {
-		if (capacity >= rhs.len) {
-			strcpy(buffer, rhs.buffer);
-			len = rhs.len;
-			rhs.len = 0;
-			return;
-		} else {
-			free(buffer);
-		}
+	if (!rhs.buffer) {
+		invalidate();
+		return;
 	}
+	if (rhs.isInline() || (buffer && capacity >= rhs.len)) {
+		// inline strings can't be stolen and always fit into the inline buffer of this string
+		reserve(rhs.len);
+		memcpy(buffer, rhs.buffer, rhs.len + 1);
+		len = rhs.len;
+		rhs.len = 0;
+		rhs.buffer[0] = 0;
+		return;
+	}
+	if (buffer && !isInline()) free(buffer);
 	buffer = rhs.buffer;
 	capacity = rhs.capacity;
 	len = rhs.len;
@@ -309,9 +332,17 @@ unsigned char String::concat(const char *cstr, unsigned int length)
 	unsigned int newlen = len + length;
 	if (!cstr) return 0;
 	if (length == 0) return 1;
-	if (!reserve(newlen)) return 0;
-	strcpy(buffer + len, cstr);
+	if (buffer && cstr >= buffer && cstr <= buffer + len) {
+		// appending a part of this string to itself
+		const unsigned int offset = cstr - buffer;
+		if (!grow(newlen)) return 0;
+		cstr = buffer + offset;
+	} else if (!grow(newlen)) {
+		return 0;
+	}
+	memcpy(buffer + len, cstr, length);
 	len = newlen;
+	buffer[len] = 0;
 	return 1;
 }
 
@@ -335,50 +366,46 @@ unsigned char String::concat(char c)
 
 unsigned char String::concat(unsigned char num)
 {
-	char buf[4];
-	itoa(num, buf, 10);
-	return concat(buf, strlen(buf));
+	return concat((unsigned long)num);
 }
 
 unsigned char String::concat(int num)
 {
-	char buf[7];
-	itoa(num, buf, 10);
-	return concat(buf, strlen(buf));
+	return concat((long)num);
 }
 
 unsigned char String::concat(unsigned int num)
 {
-	char buf[6];
-	utoa(num, buf, 10);
-	return concat(buf, strlen(buf));
+	return concat((unsigned long)num);
 }
 
 unsigned char String::concat(long num)
 {
-	char buf[12];
-	ltoa(num, buf, 10);
-	return concat(buf, strlen(buf));
+	char buf[24];
+	char *end = buf + sizeof(buf);
+	const char *str = ltoa10(num, end);
+	return concat(str, end - str);
 }
 
 unsigned char String::concat(unsigned long num)
 {
-	char buf[11];
-	ultoa(num, buf, DEC);
-	return concat(buf, strlen(buf));
+	char buf[24];
+	char *end = buf + sizeof(buf);
+	const char *str = particle::formatUnsigned(end, num);
+	return concat(str, end - str);
 }
 
 unsigned char String::concat(float num)
 {
-	char buf[20];
-	dtoa(num, 6, buf);
+	char buf[33];
+	dtoa(num, 6, buf, sizeof(buf));
 	return concat(buf, strlen(buf));
 }
 
 unsigned char String::concat(double num)
 {
-	char buf[20];
-	dtoa(num, 6, buf);
+	char buf[33];
+	dtoa(num, 6, buf, sizeof(buf));
 	return concat(buf, strlen(buf));
 }
 
@@ -791,45 +818,41 @@ class StringPrintableHelper : public Print
 public:
 
     StringPrintableHelper(String& s_) : s(s_) {
-        s.reserve(20);
     }
 
     virtual size_t write(const uint8_t *buffer, size_t size) override
     {
-        unsigned len = s.length();
-        s.concat((const char*)buffer, size);
-        return s.length()-len;
+        if (!s.concat((const char*)buffer, size)) {
+            setWriteError();
+            return 0;
+        }
+        return size;
     }
 
     virtual size_t write(uint8_t c) override
     {
-        return s.concat((char)c);
+        return write(&c, 1);
     }
 };
 
 String::String(const Printable& printable)
 {
     init();
+    reserve(0);
     StringPrintableHelper help(*this);
     printable.printTo(help);
 }
 
 String String::format(const char* fmt, ...)
 {
+    String result;
+    StringPrintableHelper help(result);
     va_list marker;
     va_start(marker, fmt);
-    const int bufsize = 5;
-    char test[bufsize];
-    size_t n = vsnprintf(test, bufsize, fmt, marker);
+    help.vprintf(false, fmt, marker);
     va_end(marker);
-
-    String result;
-    result.reserve(n);  // internally adds +1 for null terminator
-    if (result.buffer) {
-        va_start(marker, fmt);
-        n = vsnprintf(result.buffer, n+1, fmt, marker);
-        va_end(marker);
-        result.len = n;
+    if (help.getWriteError()) {
+        result.invalidate();
     }
     return result;
 }
@@ -27,6 +27,193 @@
 
 #include "hal_platform.h"
 
+#if HAL_USE_SOCKET_HAL_COMPAT || HAL_USE_SOCKET_HAL_POSIX
+
+#include "spark_wiring_tcpclient.h"
+#include "spark_wiring_ticks.h"
+
+#include <algorithm>
+#include <new>
+
+/*
+ * Receive buffer handling shared by the compat and POSIX socket implementations. The socket
+ * specific part is limited to TCPClient::receive().
+ */
+
+TCPClient::TCPClient(sock_handle_t sock, size_t bufferSize) :
+        TCPClient(sock)
+{
+    setBufferSize(bufferSize);
+}
+
+bool TCPClient::setBufferSize(size_t size)
+{
+    return d_->resize(size);
+}
+
+size_t TCPClient::bufferSize() const
+{
+    return d_->size;
+}
+
+int TCPClient::bufferCount()
+{
+    return d_->total - d_->offset;
+}
+
+size_t TCPClient::readBuffered(uint8_t* buffer, size_t size)
+{
+    const size_t n = std::min((size_t)bufferCount(), size);
+    memcpy(buffer, d_->buffer + d_->offset, n);
+    d_->offset += n;
+    return n;
+}
+
+int TCPClient::available()
+{
+    // At EOB => Flush it
+    if (d_->total && (d_->offset == d_->total))
+    {
+        flush_buffer();
+    }
+
+    // Have room
+    if (d_->total < d_->size)
+    {
+        int ret = receive(d_->buffer + d_->total, d_->size - d_->total);
+        if (ret > 0)
+        {
+            if (d_->total == 0) d_->offset = 0;
+            d_->total += ret;
+        }
+    }
+    return bufferCount();
+}
+
+int TCPClient::read()
+{
+    return (bufferCount() || available()) ? d_->buffer[d_->offset++] : -1;
+}
+
+int TCPClient::read(uint8_t *buffer, size_t size)
+{
+    size_t n = readBuffered(buffer, size);
+    if (size - n >= d_->size)
+    {
+        // The remaining space is at least as large as the receive buffer: receive straight into
+        // the caller's buffer instead of staging the data
+        int ret = receive(buffer + n, size - n);
+        if (ret > 0)
+        {
+            n += ret;
+        }
+    }
+    else if (!n && available())
+    {
+        n = readBuffered(buffer, size);
+    }
+    return n ? n : -1;
+}
+
+int TCPClient::peek()
+{
+    return (bufferCount() || available()) ? d_->buffer[d_->offset] : -1;
+}
+
+void TCPClient::flush_buffer()
+{
+    d_->offset = 0;
+    d_->total = 0;
+}
+
+size_t TCPClient::readBytes(char* buffer, size_t length)
+{
+    size_t count = 0;
+    _startMillis = millis();
+    while (count < length)
+    {
+        int n = read((uint8_t*)buffer + count, length - count);
+        if (n > 0)
+        {
+            count += n;
+            _startMillis = millis();
+        }
+        else if (millis() - _startMillis >= _timeout)
+        {
+            break;
+        }
+    }
+    return count;
+}
+
+size_t TCPClient::readBytesUntil(char terminator, char* buffer, size_t length)
+{
+    size_t count = 0;
+    _startMillis = millis();
+    while (count < length)
+    {
+        if (!bufferCount() && !available())
+        {
+            if (millis() - _startMillis >= _timeout)
+            {
+                break;
+            }
+            continue;
+        }
+        const uint8_t* data = d_->buffer + d_->offset;
+        const size_t n = std::min((size_t)bufferCount(), length - count);
+        const uint8_t* end = (const uint8_t*)memchr(data, terminator, n);
+        if (end)
+        {
+            const size_t len = end - data;
+            memcpy(buffer + count, data, len);
+            d_->offset += len + 1; // Discard the terminator
+            return count + len;
+        }
+        memcpy(buffer + count, data, n);
+        d_->offset += n;
+        count += n;
+        _startMillis = millis();
+    }
+    return count;
+}
+
+TCPClient::Data::Data(sock_handle_t sock)
+        : sock(sock),
+          buffer(defaultBuffer),
+          size(sizeof(defaultBuffer)),
+          offset(0),
+          total(0) {
+}
+
+bool TCPClient::Data::resize(size_t newSize) {
+    const size_t count = total - offset;
+    if (!newSize || count > newSize) {
+        return false;
+    }
+    if (newSize == size) {
+        return true;
+    }
+    uint8_t* buf = defaultBuffer;
+    if (newSize > sizeof(defaultBuffer)) {
+        buf = new(std::nothrow) uint8_t[newSize];
+        if (!buf) {
+            return false;
+        }
+    }
+    memmove(buf, buffer + offset, count);
+    if (buffer != defaultBuffer) {
+        delete[] buffer;
+    }
+    buffer = buf;
+    size = newSize;
+    offset = 0;
+    total = count;
+    return true;
+}
+
+#endif // HAL_USE_SOCKET_HAL_COMPAT || HAL_USE_SOCKET_HAL_POSIX
+
 #if HAL_USE_SOCKET_HAL_COMPAT
 
 #include "spark_wiring_tcpclient.h"
@@ -140,65 +327,19 @@ size_t TCPClient::write(const uint8_t *buffer, size_t size, system_tick_t timeou
     return ret;
 }
 
-int TCPClient::bufferCount()
-{
-  return d_->total - d_->offset;
-}
-
-int TCPClient::available()
+int TCPClient::receive(uint8_t* buffer, size_t size)
 {
-    int avail = 0;
-
-    // At EOB => Flush it
-    if (d_->total && (d_->offset == d_->total))
+    if (!Network.from(nif).ready() || !isOpen(d_->sock))
     {
-        flush_buffer();
+        return 0;
     }
-
-    if(Network.from(nif).ready() && isOpen(d_->sock))
+    int ret = socket_receive(d_->sock, buffer, size, 0);
+    if (ret > 0)
     {
-        // Have room
-        if ( d_->total < arraySize(d_->buffer))
-        {
-            int ret = socket_receive(d_->sock, d_->buffer + d_->total , arraySize(d_->buffer)-d_->total, 0);
-            if (ret > 0)
-            {
-                DEBUG("recv(=%d)",ret);
-                if (d_->total == 0) d_->offset = 0;
-                d_->total += ret;
-            }
-        } // Have Space
-    } // WiFi.ready() && isOpen(d_->sock)
-    avail = bufferCount();
-    return avail;
-}
-
-int TCPClient::read()
-{
-  return (bufferCount() || available()) ? d_->buffer[d_->offset++] : -1;
-}
-
-int TCPClient::read(uint8_t *buffer, size_t size)
-{
-        int read = -1;
-        if (bufferCount() || available())
-        {
-          read = (size > (size_t) bufferCount()) ? bufferCount() : size;
-          memcpy(buffer, &d_->buffer[d_->offset], read);
-          d_->offset += read;
-        }
-        return read;
-}
-
-int TCPClient::peek()
-{
-  return  (bufferCount() || available()) ? d_->buffer[d_->offset] : -1;
-}
-
-void TCPClient::flush_buffer()
-{
-  d_->offset = 0;
-  d_->total = 0;
+        DEBUG("recv(=%d)",ret);
+        return ret;
+    }
+    return 0;
 }
 
 void TCPClient::flush()
@@ -249,16 +390,13 @@ IPAddress TCPClient::remoteIP()
     return d_->remoteIP;
 }
 
-TCPClient::Data::Data(sock_handle_t sock)
-        : sock(sock),
-          offset(0),
-          total(0) {
-}
-
 TCPClient::Data::~Data() {
     if (socket_handle_valid(sock)) {
         socket_close(sock);
     }
+    if (buffer != defaultBuffer) {
+        delete[] buffer;
+    }
 }
 
 #endif // HAL_USE_SOCKET_HAL_COMPAT
@@ -150,62 +150,20 @@ size_t TCPClient::write(const uint8_t *buffer, size_t size, system_tick_t timeou
     return ret;
 }
 
-int TCPClient::bufferCount() {
-    return d_->total - d_->offset;
-}
-
-int TCPClient::available()
-{
-    int avail = 0;
-
-    // At EOB => Flush it
-    if (d_->total && (d_->offset == d_->total)) {
-        flush_buffer();
+int TCPClient::receive(uint8_t* buffer, size_t size) {
+    if (!isOpen(d_->sock)) {
+        return 0;
     }
-
-    if (isOpen(d_->sock)) {
-        // Have room
-        if (d_->total < arraySize(d_->buffer)) {
-            int ret = sock_recv(d_->sock, d_->buffer + d_->total, arraySize(d_->buffer) - d_->total, MSG_DONTWAIT);
-            if (ret > 0) {
-                if (d_->total == 0) {
-                    d_->offset = 0;
-                }
-                d_->total += ret;
-            } else {
-                if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                    LOG(ERROR, "recv error = %d", errno);
-                    sock_close(d_->sock);
-                    d_->sock = -1;
-                }
-            }
-        } // Have Space
-    } // isOpen(d_->sock)
-    avail = bufferCount();
-    return avail;
-}
-
-int TCPClient::read() {
-    return (bufferCount() || available()) ? d_->buffer[d_->offset++] : -1;
-}
-
-int TCPClient::read(uint8_t *buffer, size_t size) {
-    int read = -1;
-    if (bufferCount() || available()) {
-        read = (size > (size_t) bufferCount()) ? bufferCount() : size;
-        memcpy(buffer, &d_->buffer[d_->offset], read);
-        d_->offset += read;
+    int ret = sock_recv(d_->sock, buffer, size, MSG_DONTWAIT);
+    if (ret > 0) {
+        return ret;
     }
-    return read;
-}
-
-int TCPClient::peek() {
-    return (bufferCount() || available()) ? d_->buffer[d_->offset] : -1;
-}
-
-void TCPClient::flush_buffer() {
-    d_->offset = 0;
-    d_->total = 0;
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOG(ERROR, "recv error = %d", errno);
+        sock_close(d_->sock);
+        d_->sock = -1;
+    }
+    return 0;
 }
 
 void TCPClient::flush() {
@@ -243,16 +201,13 @@ IPAddress TCPClient::remoteIP() {
     return d_->remoteIP;
 }
 
-TCPClient::Data::Data(sock_handle_t sock)
-        : sock(sock),
-          offset(0),
-          total(0) {
-}
-
 TCPClient::Data::~Data() {
     if (socket_handle_valid(sock)) {
         sock_close(sock);
     }
+    if (buffer != defaultBuffer) {
+        delete[] buffer;
+    }
 }
 
 #endif // HAL_USE_SOCKET_HAL_POSIX
@@ -28,6 +28,170 @@
 
 #include "hal_platform.h"
 
+#if HAL_USE_SOCKET_HAL_COMPAT || HAL_USE_SOCKET_HAL_POSIX
+
+#include "spark_wiring_udp.h"
+#include "spark_wiring_ticks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+/*
+ * Receive queue and batch APIs shared by the compat and POSIX socket implementations. They are
+ * built on the socket specific UDP::receiveFrom() (unqueued receivePacket()), UDP::receiveNext()
+ * (non-blocking reads of receivePackets()) and UDP::sendPacket() (one datagram per packet passed
+ * to sendPackets()).
+ */
+
+class UDPPacketQueue {
+public:
+    UDPPacket* packets;
+    uint8_t* data;
+    size_t slots;
+    size_t slotSize;
+    // Free-running counters, the slot index is the counter value modulo the number of slots.
+    // head is only modified by the producer (receivePackets()) and tail by the consumer
+    std::atomic<unsigned> head;
+    std::atomic<unsigned> tail;
+    unsigned overflows;
+
+    UDPPacketQueue() :
+            packets(nullptr),
+            data(nullptr),
+            slots(0),
+            slotSize(0),
+            head(0),
+            tail(0),
+            overflows(0) {
+    }
+
+    ~UDPPacketQueue() {
+        delete[] packets;
+        delete[] data;
+    }
+};
+
+bool UDP::setPacketQueue(size_t slots, size_t slot_size)
+{
+    releasePacketQueue();
+    if (!slots || !slot_size) {
+        return false;
+    }
+    UDPPacketQueue* queue = new(std::nothrow) UDPPacketQueue();
+    if (!queue) {
+        return false;
+    }
+    queue->packets = new(std::nothrow) UDPPacket[slots];
+    queue->data = new(std::nothrow) uint8_t[slots * slot_size];
+    if (!queue->packets || !queue->data) {
+        delete queue;
+        return false;
+    }
+    queue->slots = slots;
+    queue->slotSize = slot_size;
+    _queue = queue;
+    return true;
+}
+
+void UDP::releasePacketQueue()
+{
+    delete _queue;
+    _queue = nullptr;
+}
+
+int UDP::receivePackets()
+{
+    UDPPacketQueue* const q = _queue;
+    if (!q) {
+        return -1;
+    }
+    int count = 0;
+    for (;;) {
+        const unsigned head = q->head.load(std::memory_order_relaxed);
+        if (head - q->tail.load(std::memory_order_acquire) == q->slots) {
+            ++q->overflows;
+            break;
+        }
+        const size_t index = head % q->slots;
+        UDPPacket& packet = q->packets[index];
+        uint8_t* const data = q->data + index * q->slotSize;
+        // Zero-length datagrams are queued as empty packets
+        const int ret = receiveNext(data, q->slotSize, &packet.remoteIP, &packet.remotePort);
+        if (ret < 0) {
+            break;
+        }
+        packet.data = data;
+        packet.size = ret;
+        packet.timestamp = millis();
+        q->head.store(head + 1, std::memory_order_release);
+        ++count;
+    }
+    return count;
+}
+
+int UDP::receiveQueued(uint8_t* buffer, size_t size)
+{
+    UDPPacketQueue* const q = _queue;
+    const unsigned tail = q->tail.load(std::memory_order_relaxed);
+    if (tail == q->head.load(std::memory_order_acquire)) {
+        return 0;
+    }
+    const UDPPacket& packet = q->packets[tail % q->slots];
+    const size_t n = std::min(size, packet.size);
+    memcpy(buffer, packet.data, n);
+    _remoteIP = packet.remoteIP;
+    _remotePort = packet.remotePort;
+    _timestamp = packet.timestamp;
+    q->tail.store(tail + 1, std::memory_order_release);
+    return n;
+}
+
+int UDP::packetsQueued() const
+{
+    if (!_queue) {
+        return 0;
+    }
+    return _queue->head.load(std::memory_order_acquire) - _queue->tail.load(std::memory_order_acquire);
+}
+
+unsigned UDP::packetQueueOverflows() const
+{
+    return _queue ? _queue->overflows : 0;
+}
+
+int UDP::receivePacket(uint8_t* buffer, size_t size, system_tick_t timeout)
+{
+    if (!buffer) {
+        return -1;
+    }
+    if (_queue) {
+        // The queue is only filled by receivePackets(), reading the socket here would make this
+        // thread a second producer
+        return receiveQueued(buffer, size);
+    }
+    const int ret = receiveFrom(buffer, size, timeout, &_remoteIP, &_remotePort);
+    if (ret >= 0) {
+        _timestamp = millis();
+    }
+    return ret;
+}
+
+int UDP::sendPackets(const UDPPacket* packets, size_t count)
+{
+    size_t sent = 0;
+    for (; sent < count; ++sent) {
+        const UDPPacket& packet = packets[sent];
+        const int ret = sendPacket(packet.data, packet.size, packet.remoteIP, packet.remotePort);
+        if (ret < 0) {
+            return sent ? sent : ret;
+        }
+    }
+    return sent;
+}
+
+#endif // HAL_USE_SOCKET_HAL_COMPAT || HAL_USE_SOCKET_HAL_POSIX
+
 #if HAL_USE_SOCKET_HAL_COMPAT
 
 #include "spark_wiring_udp.h"
@@ -36,6 +200,7 @@
 #include "spark_macros.h"
 #include "spark_wiring_network.h"
 #include "spark_wiring_constants.h"
+#include "system_error.h"
 
 using namespace spark;
 
@@ -44,7 +209,7 @@ static bool inline isOpen(sock_handle_t sd)
    return sd != socket_handle_invalid();
 }
 
-UDP::UDP() : _sock(socket_handle_invalid()), _offset(0), _total(0), _buffer(0), _buffer_size(512)
+UDP::UDP() : _sock(socket_handle_invalid()), _offset(0), _total(0), _buffer(0), _buffer_size(512), _queue(0), _timestamp(0)
 {
 }
 
@@ -198,7 +363,7 @@ int UDP::parsePacket(system_tick_t timeout)
     return available();
 }
 
-int UDP::receivePacket(uint8_t* buffer, size_t size, system_tick_t timeout)
+int UDP::receiveFrom(uint8_t* buffer, size_t size, system_tick_t timeout, IPAddress* remoteIP, uint16_t* remotePort)
 {
     int ret = -1;
     if(Network.from(_nif).ready() && isOpen(_sock) && buffer)
@@ -209,13 +374,34 @@ int UDP::receivePacket(uint8_t* buffer, size_t size, system_tick_t timeout)
         ret = socket_receivefrom(_sock, buffer, size, 0, &remoteSockAddr, &remoteSockAddrLen);
         if (ret >= 0)
         {
-            _remotePort = remoteSockAddr.sa_data[0] << 8 | remoteSockAddr.sa_data[1];
-            _remoteIP = &remoteSockAddr.sa_data[2];
+            *remotePort = remoteSockAddr.sa_data[0] << 8 | remoteSockAddr.sa_data[1];
+            *remoteIP = &remoteSockAddr.sa_data[2];
         }
     }
     return ret;
 }
 
+int UDP::receiveNext(uint8_t* buffer, size_t size, IPAddress* remoteIP, uint16_t* remotePort)
+{
+    if (!Network.from(_nif).ready() || !isOpen(_sock)) {
+        return -1;
+    }
+    // socket_receivefrom() returns 0 if there's no data available, in which case the address is
+    // left unset. A received datagram always has a non-zero source port
+    sockaddr_t remoteSockAddr = {};
+    socklen_t remoteSockAddrLen = sizeof(remoteSockAddr);
+    const int ret = socket_receivefrom(_sock, buffer, size, 0, &remoteSockAddr, &remoteSockAddrLen);
+    if (ret < 0) {
+        return ret;
+    }
+    *remotePort = remoteSockAddr.sa_data[0] << 8 | remoteSockAddr.sa_data[1];
+    if (ret == 0 && *remotePort == 0) {
+        return SYSTEM_ERROR_WOULD_BLOCK;
+    }
+    *remoteIP = &remoteSockAddr.sa_data[2];
+    return ret;
+}
+
 int UDP::read()
 {
   return available() ? _buffer[_offset++] : -1;
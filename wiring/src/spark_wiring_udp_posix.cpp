@@ -25,6 +25,7 @@
 #include "spark_macros.h"
 #include "spark_wiring_network.h"
 #include "check.h"
+#include "system_error.h"
 #include "scope_guard.h"
 #if HAL_PLATFORM_IFAPI
 #include "ifapi.h"
@@ -96,7 +97,9 @@ UDP::UDP()
           _total(0),
           _buffer(0),
           _buffer_size(512),
-          _nif(0) {
+          _nif(0),
+          _queue(nullptr),
+          _timestamp(0) {
 }
 
 bool UDP::setBuffer(size_t buf_size, uint8_t* buffer) {
@@ -276,7 +279,7 @@ int UDP::parsePacket(system_tick_t timeout) {
     return available();
 }
 
-int UDP::receivePacket(uint8_t* buffer, size_t size, system_tick_t timeout) {
+int UDP::receiveFrom(uint8_t* buffer, size_t size, system_tick_t timeout, IPAddress* remoteIP, uint16_t* remotePort) {
     int ret = -1;
     if (isOpen(_sock) && buffer) {
         sockaddr_storage saddr = {};
@@ -295,13 +298,27 @@ int UDP::receivePacket(uint8_t* buffer, size_t size, system_tick_t timeout) {
         }
         ret = sock_recvfrom(_sock, buffer, size, flags, (struct sockaddr*)&saddr, &slen);
         if (ret >= 0) {
-            detail::sockaddrToIpAddressPort((const struct sockaddr*)&saddr, _remoteIP, &_remotePort);
-            LOG_DEBUG(TRACE, "received %d bytes from %s#%d", ret, _remoteIP.toString().c_str(), _remotePort);
+            detail::sockaddrToIpAddressPort((const struct sockaddr*)&saddr, *remoteIP, remotePort);
+            LOG_DEBUG(TRACE, "received %d bytes from %s#%d", ret, remoteIP->toString().c_str(), *remotePort);
         }
     }
     return ret;
 }
 
+int UDP::receiveNext(uint8_t* buffer, size_t size, IPAddress* remoteIP, uint16_t* remotePort) {
+    if (!isOpen(_sock)) {
+        return -1;
+    }
+    sockaddr_storage saddr = {};
+    socklen_t slen = sizeof(saddr);
+    const int ret = sock_recvfrom(_sock, buffer, size, MSG_DONTWAIT, (struct sockaddr*)&saddr, &slen);
+    if (ret < 0) {
+        return (errno == EWOULDBLOCK || errno == EAGAIN) ? SYSTEM_ERROR_WOULD_BLOCK : ret;
+    }
+    detail::sockaddrToIpAddressPort((const struct sockaddr*)&saddr, *remoteIP, remotePort);
+    return ret;
+}
+
 int UDP::read() {
     return available() ? _buffer[_offset++] : -1;
 }
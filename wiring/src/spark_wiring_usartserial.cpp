@@ -90,6 +90,16 @@ void USARTSerial::flush()
   HAL_USART_Flush_Data(_serial);
 }
 
+int USARTSerial::acquireRead(const char** data)
+{
+  return HAL_USART_Acquire_Read(_serial, (const void**)data, nullptr);
+}
+
+int USARTSerial::commitRead(size_t size)
+{
+  return HAL_USART_Commit_Read(_serial, size, nullptr);
+}
+
 size_t USARTSerial::write(uint8_t c)
 {
   // attempt a write if blocking, or for non-blocking if there is room.
@@ -92,6 +92,16 @@ void USBSerial::flush()
   HAL_USB_USART_Flush_Data(_serial);
 }
 
+int USBSerial::acquireRead(const char** data)
+{
+  return HAL_USB_USART_Acquire_Read(_serial, (const void**)data, nullptr);
+}
+
+int USBSerial::commitRead(size_t size)
+{
+  return HAL_USB_USART_Commit_Read(_serial, size, nullptr);
+}
+
 void USBSerial::blockOnOverrun(bool block)
 {
   _blocking = block;